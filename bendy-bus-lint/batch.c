@@ -0,0 +1,381 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "batch.h"
+#include "check.h"
+#include "json.h"
+
+/* Batch mode checks many pairs of simulation code and introspection XML files in one process, listed in a manifest file. Each non-empty line of the
+ * manifest which doesn't start with ‘#’ gives the simulation code file and introspection XML file for one pair, separated by whitespace and quoted
+ * as for the shell if necessary. Relative paths are resolved against the manifest's directory.
+ *
+ * Each introspection XML file is loaded and parsed once, however many pairs use it, and the parsed data is shared between the checks. The files are
+ * loaded and checked in parallel, with one thread per processor, but the results are output in manifest order as a single JSON object:
+ *     {
+ *       "files": [
+ *         {
+ *           "simulation": "…", "introspection": "…", (as given in the manifest)
+ *           "diagnostics": [ … ], (as formatted by lint_diagnostic_append_json())
+ *           "introspectionTime": 123, (time spent loading and parsing the introspection XML file, in microseconds; shared between pairs)
+ *           "checkTime": 456 (time spent loading and checking the simulation code file, in microseconds)
+ *         },
+ *         …
+ *       ],
+ *       "totalTime": 789 (wall clock time for the whole batch, in microseconds)
+ *     }
+ */
+
+typedef struct {
+	gchar *path;
+	GDBusNodeInfo *dbus_node_info; /* NULL if loading failed */
+	gchar *error_message; /* NULL if loading succeeded */
+	gboolean unreadable; /* TRUE if the file couldn't be read, rather than being invalid */
+	gint64 load_time; /* in microseconds */
+} IntrospectionFile;
+
+static void
+introspection_file_free (IntrospectionFile *file)
+{
+	if (file->dbus_node_info != NULL) {
+		g_dbus_node_info_unref (file->dbus_node_info);
+	}
+
+	g_free (file->error_message);
+	g_free (file->path);
+	g_slice_free (IntrospectionFile, file);
+}
+
+typedef struct {
+	gchar *simulation_filename; /* as given in the manifest */
+	gchar *introspection_filename; /* as given in the manifest */
+	gchar *simulation_path; /* resolved against the manifest's directory */
+	IntrospectionFile *introspection_file; /* unowned */
+	GPtrArray/*<LintDiagnostic>*/ *diagnostics; /* NULL until checked */
+	gboolean unreadable; /* TRUE if one of the files couldn't be read */
+	gint64 check_time; /* in microseconds */
+} ManifestEntry;
+
+static void
+manifest_entry_free (ManifestEntry *entry)
+{
+	if (entry->diagnostics != NULL) {
+		g_ptr_array_unref (entry->diagnostics);
+	}
+
+	g_free (entry->simulation_path);
+	g_free (entry->introspection_filename);
+	g_free (entry->simulation_filename);
+	g_slice_free (ManifestEntry, entry);
+}
+
+static gchar *
+resolve_path (const gchar *base_directory, const gchar *filename)
+{
+	GFile *file;
+	gchar *path;
+
+	if (g_path_is_absolute (filename) == TRUE) {
+		file = g_file_new_for_path (filename);
+	} else {
+		gchar *absolute_filename = g_build_filename (base_directory, filename, NULL);
+		file = g_file_new_for_path (absolute_filename);
+		g_free (absolute_filename);
+	}
+
+	/* GFile canonicalises the path, so that the same introspection XML file referenced in different ways can be shared. */
+	path = g_file_get_path (file);
+	g_object_unref (file);
+
+	return path;
+}
+
+/* Load the manifest, adding each unique introspection XML file to @introspection_files. */
+static GPtrArray/*<ManifestEntry>*/ *
+load_manifest (const gchar *manifest_filename, GHashTable/*<string, IntrospectionFile>*/ *introspection_files, GError **error)
+{
+	GPtrArray/*<ManifestEntry>*/ *entries;
+	gchar *contents, *current_directory, *base_directory, *absolute_manifest_filename;
+	gchar **lines;
+	guint i;
+	GError *child_error = NULL;
+
+	g_file_get_contents (manifest_filename, &contents, NULL, &child_error);
+
+	if (child_error != NULL) {
+		g_propagate_prefixed_error (error, child_error, _("Error loading manifest from file ‘%s’: "), manifest_filename);
+		return NULL;
+	}
+
+	current_directory = g_get_current_dir ();
+	absolute_manifest_filename = resolve_path (current_directory, manifest_filename);
+	base_directory = g_path_get_dirname (absolute_manifest_filename);
+	g_free (absolute_manifest_filename);
+	g_free (current_directory);
+
+	entries = g_ptr_array_new_with_free_func ((GDestroyNotify) manifest_entry_free);
+	lines = g_strsplit (contents, "\n", -1);
+
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar *line = g_strstrip (lines[i]);
+		gint argc;
+		gchar **argv = NULL;
+		ManifestEntry *entry;
+		gchar *introspection_path;
+		IntrospectionFile *introspection_file;
+
+		if (*line == '\0' || *line == '#') {
+			continue;
+		}
+
+		if (g_shell_parse_argv (line, &argc, &argv, NULL) == FALSE || argc != 2) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			             _("Error loading manifest from file ‘%s’: line %u must give a simulation code file and an introspection XML file."),
+			             manifest_filename, i + 1);
+
+			if (argv != NULL) {
+				g_strfreev (argv);
+			}
+
+			g_ptr_array_unref (entries);
+			entries = NULL;
+
+			break;
+		}
+
+		entry = g_slice_new0 (ManifestEntry);
+		entry->simulation_filename = g_strdup (argv[0]);
+		entry->introspection_filename = g_strdup (argv[1]);
+		entry->simulation_path = resolve_path (base_directory, argv[0]);
+
+		introspection_path = resolve_path (base_directory, argv[1]);
+		introspection_file = g_hash_table_lookup (introspection_files, introspection_path);
+
+		if (introspection_file == NULL) {
+			introspection_file = g_slice_new0 (IntrospectionFile);
+			introspection_file->path = introspection_path;
+			g_hash_table_insert (introspection_files, introspection_file->path, introspection_file);
+		} else {
+			g_free (introspection_path);
+		}
+
+		entry->introspection_file = introspection_file;
+		g_ptr_array_add (entries, entry);
+
+		g_strfreev (argv);
+	}
+
+	g_strfreev (lines);
+	g_free (base_directory);
+	g_free (contents);
+
+	return entries;
+}
+
+static void
+load_introspection_file_cb (IntrospectionFile *file, gpointer user_data)
+{
+	gchar *introspection_xml;
+	gint64 start_time;
+	GError *error = NULL;
+
+	start_time = g_get_monotonic_time ();
+
+	g_file_get_contents (file->path, &introspection_xml, NULL, &error);
+
+	if (error != NULL) {
+		file->error_message = g_strdup_printf (_("Error loading introspection XML from file ‘%s’: %s"), file->path, error->message);
+		file->unreadable = TRUE;
+		g_error_free (error);
+	} else {
+		file->dbus_node_info = g_dbus_node_info_new_for_xml (introspection_xml, &error);
+
+		if (error != NULL) {
+			file->error_message = g_strdup_printf (_("Error parsing introspection XML from file ‘%s’: %s"), file->path, error->message);
+			g_error_free (error);
+		}
+
+		g_free (introspection_xml);
+	}
+
+	file->load_time = g_get_monotonic_time () - start_time;
+}
+
+static void
+check_entry_cb (ManifestEntry *entry, gpointer user_data)
+{
+	gchar *simulation_code;
+	gint64 start_time;
+	GError *error = NULL;
+
+	start_time = g_get_monotonic_time ();
+
+	if (entry->introspection_file->dbus_node_info == NULL) {
+		/* The introspection XML couldn't be loaded, so there's no point checking the simulation code. */
+		entry->diagnostics = g_ptr_array_new_with_free_func ((GDestroyNotify) lint_diagnostic_free);
+		g_ptr_array_add (entry->diagnostics, lint_diagnostic_new (LINT_SEVERITY_ERROR, entry->introspection_file->error_message));
+		entry->unreadable = entry->introspection_file->unreadable;
+	} else if (g_file_get_contents (entry->simulation_path, &simulation_code, NULL, &error) == FALSE) {
+		gchar *message;
+
+		message = g_strdup_printf (_("Error loading simulation code from file ‘%s’: %s"), entry->simulation_path, error->message);
+		entry->diagnostics = g_ptr_array_new_with_free_func ((GDestroyNotify) lint_diagnostic_free);
+		g_ptr_array_add (entry->diagnostics, lint_diagnostic_new (LINT_SEVERITY_ERROR, message));
+		entry->unreadable = TRUE;
+		g_free (message);
+
+		g_error_free (error);
+	} else {
+		entry->diagnostics = lint_check_simulation_code (simulation_code, entry->introspection_file->dbus_node_info);
+		g_free (simulation_code);
+	}
+
+	entry->check_time = g_get_monotonic_time () - start_time;
+}
+
+/* Call @func on each of the @items on a thread pool with a thread per processor, and wait for them all to finish. */
+static void
+run_in_parallel (GPtrArray *items, GFunc func)
+{
+	GThreadPool *pool;
+	guint i;
+
+	pool = g_thread_pool_new (func, NULL, g_get_num_processors (), FALSE, NULL);
+
+	for (i = 0; i < items->len; i++) {
+		if (pool != NULL) {
+			g_thread_pool_push (pool, g_ptr_array_index (items, i), NULL);
+		} else {
+			func (g_ptr_array_index (items, i), NULL);
+		}
+	}
+
+	if (pool != NULL) {
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+}
+
+/*
+ * lint_batch_run:
+ * @manifest_filename: path of the manifest listing the files to check
+ * @output_stream: stream to write the JSON results to
+ * @result: (out): return location for flags summarising the problems found
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Check all the pairs of files listed in the manifest at @manifest_filename, and write the results to @output_stream as JSON. Problems with the
+ * files being checked are reported in the output and in @result, rather than as errors.
+ *
+ * Return value: %TRUE on success, %FALSE if the manifest couldn't be loaded or the results couldn't be written
+ */
+gboolean
+lint_batch_run (const gchar *manifest_filename, GOutputStream *output_stream, LintBatchResult *result, GError **error)
+{
+	GHashTable/*<string, IntrospectionFile>*/ *introspection_files;
+	GPtrArray/*<ManifestEntry>*/ *entries;
+	GPtrArray/*<IntrospectionFile>*/ *introspection_file_array;
+	GHashTableIter iter;
+	IntrospectionFile *introspection_file;
+	GString *output;
+	gint64 start_time;
+	guint i, j;
+	gboolean success;
+
+	g_return_val_if_fail (manifest_filename != NULL, FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (output_stream), FALSE);
+	g_return_val_if_fail (result != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	start_time = g_get_monotonic_time ();
+	*result = LINT_BATCH_RESULT_SUCCESS;
+
+	introspection_files = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) introspection_file_free);
+	entries = load_manifest (manifest_filename, introspection_files, error);
+
+	if (entries == NULL) {
+		g_hash_table_unref (introspection_files);
+		return FALSE;
+	}
+
+	/* Load all the introspection XML files, then check all the simulation code files against them. */
+	introspection_file_array = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, introspection_files);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &introspection_file) == TRUE) {
+		g_ptr_array_add (introspection_file_array, introspection_file);
+	}
+
+	run_in_parallel (introspection_file_array, (GFunc) load_introspection_file_cb);
+	g_ptr_array_unref (introspection_file_array);
+
+	run_in_parallel (entries, (GFunc) check_entry_cb);
+
+	/* Output the results in manifest order. */
+	output = g_string_new ("{\"files\":[");
+
+	for (i = 0; i < entries->len; i++) {
+		ManifestEntry *entry = g_ptr_array_index (entries, i);
+
+		if (i > 0) {
+			g_string_append_c (output, ',');
+		}
+
+		g_string_append (output, "{\"simulation\":");
+		lint_json_append_string (output, entry->simulation_filename);
+		g_string_append (output, ",\"introspection\":");
+		lint_json_append_string (output, entry->introspection_filename);
+		g_string_append (output, ",\"diagnostics\":[");
+
+		for (j = 0; j < entry->diagnostics->len; j++) {
+			LintDiagnostic *diagnostic = g_ptr_array_index (entry->diagnostics, j);
+
+			if (j > 0) {
+				g_string_append_c (output, ',');
+			}
+
+			lint_diagnostic_append_json (diagnostic, output);
+
+			if (entry->unreadable == TRUE) {
+				*result |= LINT_BATCH_RESULT_UNREADABLE_FILE;
+			} else if (diagnostic->severity == LINT_SEVERITY_ERROR) {
+				*result |= LINT_BATCH_RESULT_INVALID_CODE;
+			} else {
+				*result |= LINT_BATCH_RESULT_UNREACHABLE_STATES;
+			}
+		}
+
+		g_string_append_printf (output, "],\"introspectionTime\":%" G_GINT64_FORMAT ",\"checkTime\":%" G_GINT64_FORMAT "}",
+		                        entry->introspection_file->load_time, entry->check_time);
+	}
+
+	g_string_append_printf (output, "],\"totalTime\":%" G_GINT64_FORMAT "}\n", g_get_monotonic_time () - start_time);
+
+	success = g_output_stream_write_all (output_stream, output->str, output->len, NULL, NULL, error) &&
+	          g_output_stream_flush (output_stream, NULL, error);
+
+	g_string_free (output, TRUE);
+	g_ptr_array_unref (entries);
+	g_hash_table_unref (introspection_files);
+
+	return success;
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#ifndef LINT_BATCH_H
+#define LINT_BATCH_H
+
+G_BEGIN_DECLS
+
+/**
+ * LintBatchResult:
+ * @LINT_BATCH_RESULT_SUCCESS: All the files were valid.
+ * @LINT_BATCH_RESULT_UNREADABLE_FILE: At least one file couldn't be loaded.
+ * @LINT_BATCH_RESULT_INVALID_CODE: At least one simulation description was invalid.
+ * @LINT_BATCH_RESULT_UNREACHABLE_STATES: At least one simulation description had unreachable states.
+ *
+ * Flags summarising the problems found in a batch of files.
+ */
+typedef enum {
+	LINT_BATCH_RESULT_SUCCESS = 0,
+	LINT_BATCH_RESULT_UNREADABLE_FILE = 1 << 0,
+	LINT_BATCH_RESULT_INVALID_CODE = 1 << 1,
+	LINT_BATCH_RESULT_UNREACHABLE_STATES = 1 << 2,
+} LintBatchResult;
+
+gboolean lint_batch_run (const gchar *manifest_filename, GOutputStream *output_stream, LintBatchResult *result, GError **error);
+
+G_END_DECLS
+
+#endif /* !LINT_BATCH_H */
@@ -0,0 +1,203 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#include "check.h"
+#include "json.h"
+
+/*
+ * lint_diagnostic_new:
+ * @severity: severity of the problem
+ * @message: human-readable description of the problem
+ *
+ * Create a new #LintDiagnostic with an unknown position.
+ *
+ * Return value: (transfer full): a new #LintDiagnostic; free with lint_diagnostic_free()
+ */
+LintDiagnostic *
+lint_diagnostic_new (LintSeverity severity, const gchar *message)
+{
+	LintDiagnostic *diagnostic;
+
+	diagnostic = g_slice_new0 (LintDiagnostic);
+	diagnostic->severity = severity;
+	diagnostic->message = g_strdup (message);
+
+	return diagnostic;
+}
+
+/*
+ * lint_diagnostic_copy:
+ * @diagnostic: a #LintDiagnostic
+ *
+ * Return value: (transfer full): a copy of @diagnostic; free with lint_diagnostic_free()
+ */
+LintDiagnostic *
+lint_diagnostic_copy (const LintDiagnostic *diagnostic)
+{
+	LintDiagnostic *copy;
+
+	copy = g_slice_dup (LintDiagnostic, diagnostic);
+	copy->message = g_strdup (diagnostic->message);
+
+	return copy;
+}
+
+/*
+ * lint_diagnostic_free:
+ * @diagnostic: (transfer full): a #LintDiagnostic
+ *
+ * Free @diagnostic.
+ */
+void
+lint_diagnostic_free (LintDiagnostic *diagnostic)
+{
+	g_free (diagnostic->message);
+	g_slice_free (LintDiagnostic, diagnostic);
+}
+
+/*
+ * lint_diagnostic_append_json:
+ * @diagnostic: a #LintDiagnostic
+ * @buffer: buffer to append to
+ *
+ * Append @diagnostic to @buffer as a JSON object. Unknown positions are omitted.
+ */
+void
+lint_diagnostic_append_json (const LintDiagnostic *diagnostic, GString *buffer)
+{
+	g_string_append (buffer, "{\"severity\":");
+	lint_json_append_string (buffer, (diagnostic->severity == LINT_SEVERITY_ERROR) ? "error" : "warning");
+
+	if (diagnostic->start_line != 0) {
+		g_string_append_printf (buffer, ",\"startLine\":%u,\"endLine\":%u", diagnostic->start_line, diagnostic->end_line);
+	}
+
+	if (diagnostic->start_column != 0) {
+		g_string_append_printf (buffer, ",\"startColumn\":%u,\"endColumn\":%u", diagnostic->start_column, diagnostic->end_column);
+	}
+
+	g_string_append (buffer, ",\"message\":");
+	lint_json_append_string (buffer, diagnostic->message);
+	g_string_append_c (buffer, '}');
+}
+
+/* Syntax errors are the only ones with a position, which is only available in the error message. The position is formatted as
+ * ‘line:column–line:column’ regardless of the translation. */
+static void
+extract_error_position (LintDiagnostic *diagnostic, const GError *error)
+{
+	GRegex *regex;
+	GMatchInfo *match_info;
+
+	if (g_error_matches (error, DFSM_PARSE_ERROR, DFSM_PARSE_ERROR_SYNTAX) == FALSE) {
+		return;
+	}
+
+	regex = g_regex_new ("([0-9]+):([0-9]+)–([0-9]+):([0-9]+)", 0, 0, NULL);
+	g_assert (regex != NULL);
+
+	if (g_regex_match (regex, error->message, 0, &match_info) == TRUE) {
+		guint *fields[] = { &diagnostic->start_line, &diagnostic->start_column, &diagnostic->end_line, &diagnostic->end_column };
+		guint i;
+
+		for (i = 0; i < G_N_ELEMENTS (fields); i++) {
+			gchar *field = g_match_info_fetch (match_info, i + 1);
+			*(fields[i]) = (guint) strtoul (field, NULL, 10);
+			g_free (field);
+		}
+	}
+
+	g_match_info_free (match_info);
+	g_regex_unref (regex);
+}
+
+/*
+ * lint_check_simulation_code:
+ * @simulation_code: simulation code to check
+ * @dbus_node_info: parsed introspection data describing the interfaces referenced by @simulation_code
+ *
+ * Check @simulation_code, and return all the problems found in it. If the code is invalid, a single error is returned. Otherwise, a warning is
+ * returned for each unreachable state.
+ *
+ * This may be called from several threads at once.
+ *
+ * Return value: (transfer full): an array of #LintDiagnostic<!-- -->s, which may be empty
+ */
+GPtrArray/*<LintDiagnostic>*/ *
+lint_check_simulation_code (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info)
+{
+	GPtrArray/*<LintDiagnostic>*/ *diagnostics;
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	guint i;
+	GError *error = NULL;
+
+	diagnostics = g_ptr_array_new_with_free_func ((GDestroyNotify) lint_diagnostic_free);
+
+	/* Build the DfsmObjects and thus check the simulation code. */
+	simulated_objects = dfsm_object_factory_from_node_info (simulation_code, dbus_node_info, &error);
+
+	if (error != NULL) {
+		LintDiagnostic *diagnostic;
+
+		diagnostic = lint_diagnostic_new (LINT_SEVERITY_ERROR, error->message);
+		extract_error_position (diagnostic, error);
+		g_ptr_array_add (diagnostics, diagnostic);
+
+		g_error_free (error);
+
+		return diagnostics;
+	}
+
+	/* Check the reachability of all of the states in each object. */
+	for (i = 0; i < simulated_objects->len; i++) {
+		DfsmObject *simulated_object;
+		DfsmMachine *machine;
+		GArray/*<DfsmStateReachability>*/ *reachability;
+		DfsmMachineStateNumber state;
+
+		simulated_object = DFSM_OBJECT (g_ptr_array_index (simulated_objects, i));
+		machine = dfsm_object_get_machine (simulated_object);
+		reachability = dfsm_machine_calculate_state_reachability (machine);
+
+		for (state = 0; state < reachability->len; state++) {
+			if (g_array_index (reachability, DfsmStateReachability, state) == DFSM_STATE_UNREACHABLE) {
+				gchar *message;
+
+				message = g_strdup_printf (_("State ‘%s’ of object ‘%s’ is unreachable."), dfsm_machine_get_state_name (machine, state),
+				                           dfsm_object_get_object_path (simulated_object));
+				g_ptr_array_add (diagnostics, lint_diagnostic_new (LINT_SEVERITY_WARNING, message));
+				g_free (message);
+			}
+		}
+
+		g_array_unref (reachability);
+	}
+
+	g_ptr_array_unref (simulated_objects);
+
+	return diagnostics;
+}
@@ -0,0 +1,70 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#ifndef LINT_CHECK_H
+#define LINT_CHECK_H
+
+G_BEGIN_DECLS
+
+/**
+ * LintSeverity:
+ * @LINT_SEVERITY_ERROR: The simulation code is invalid.
+ * @LINT_SEVERITY_WARNING: The simulation code is valid, but probably not what was intended.
+ *
+ * Severity of a #LintDiagnostic.
+ */
+typedef enum {
+	LINT_SEVERITY_ERROR = 0,
+	LINT_SEVERITY_WARNING,
+} LintSeverity;
+
+/**
+ * LintDiagnostic:
+ * @severity: severity of the problem
+ * @start_line: one-based line the problem starts on, or 0 if unknown
+ * @start_column: one-based column the problem starts on, or 0 if unknown
+ * @end_line: one-based line the problem ends on, or 0 if unknown
+ * @end_column: one-based column the problem ends on, or 0 if unknown
+ * @message: human-readable description of the problem
+ *
+ * A single problem found in some simulation code.
+ */
+typedef struct {
+	LintSeverity severity;
+	guint start_line;
+	guint start_column;
+	guint end_line;
+	guint end_column;
+	gchar *message;
+} LintDiagnostic;
+
+LintDiagnostic *lint_diagnostic_new (LintSeverity severity, const gchar *message) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+LintDiagnostic *lint_diagnostic_copy (const LintDiagnostic *diagnostic) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void lint_diagnostic_free (LintDiagnostic *diagnostic);
+
+void lint_diagnostic_append_json (const LintDiagnostic *diagnostic, GString *buffer);
+
+GPtrArray *lint_check_simulation_code (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_END_DECLS
+
+#endif /* !LINT_CHECK_H */
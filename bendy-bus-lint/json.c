@@ -0,0 +1,597 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "json.h"
+
+/* A minimal JSON reader and writer, just enough for the lint server's requests and responses. Parsed JSON is represented as a GVariant:
+ *  • objects as a{sv};
+ *  • arrays as av;
+ *  • strings as s;
+ *  • numbers as d;
+ *  • true and false as b;
+ *  • null as an empty mv. */
+
+/* Limit the nesting depth so that malicious input can't overflow the stack. */
+#define MAX_DEPTH 64
+
+GQuark
+lint_json_error_quark (void)
+{
+	return g_quark_from_static_string ("lint-json-error-quark");
+}
+
+typedef struct {
+	const gchar *json; /* start of the input, for error positions */
+	const gchar *i; /* current position */
+} JsonParser;
+
+static GVariant *parse_value (JsonParser *parser, guint depth, GError **error);
+
+static void
+set_parse_error (JsonParser *parser, GError **error, const gchar *message)
+{
+	g_set_error (error, LINT_JSON_ERROR, LINT_JSON_ERROR_INVALID, _("Invalid JSON at offset %u: %s"), (guint) (parser->i - parser->json), message);
+}
+
+static void
+skip_whitespace (JsonParser *parser)
+{
+	while (*parser->i == ' ' || *parser->i == '\t' || *parser->i == '\n' || *parser->i == '\r') {
+		parser->i++;
+	}
+}
+
+static gboolean
+parse_literal (JsonParser *parser, const gchar *literal)
+{
+	gsize length = strlen (literal);
+
+	if (strncmp (parser->i, literal, length) != 0) {
+		return FALSE;
+	}
+
+	parser->i += length;
+
+	return TRUE;
+}
+
+/* Parse four hex digits of a \u escape. */
+static gboolean
+parse_hex4 (JsonParser *parser, gunichar *out)
+{
+	guint j;
+	gunichar c = 0;
+
+	for (j = 0; j < 4; j++) {
+		gint digit = g_ascii_xdigit_value (parser->i[j]);
+
+		if (digit < 0) {
+			return FALSE;
+		}
+
+		c = (c << 4) | (gunichar) digit;
+	}
+
+	parser->i += 4;
+	*out = c;
+
+	return TRUE;
+}
+
+static gchar *
+parse_string (JsonParser *parser, GError **error)
+{
+	GString *str;
+
+	/* Skip the opening quote. */
+	g_assert (*parser->i == '"');
+	parser->i++;
+
+	str = g_string_new (NULL);
+
+	while (*parser->i != '"') {
+		gunichar c;
+
+		if (*parser->i == '\0') {
+			set_parse_error (parser, error, _("Unterminated string."));
+			goto error;
+		} else if ((guchar) *parser->i < 0x20) {
+			set_parse_error (parser, error, _("Control character in string."));
+			goto error;
+		} else if (*parser->i != '\\') {
+			g_string_append_c (str, *parser->i);
+			parser->i++;
+			continue;
+		}
+
+		/* Escape sequence. */
+		parser->i++;
+
+		switch (*parser->i++) {
+			case '"':
+				g_string_append_c (str, '"');
+				break;
+			case '\\':
+				g_string_append_c (str, '\\');
+				break;
+			case '/':
+				g_string_append_c (str, '/');
+				break;
+			case 'b':
+				g_string_append_c (str, '\b');
+				break;
+			case 'f':
+				g_string_append_c (str, '\f');
+				break;
+			case 'n':
+				g_string_append_c (str, '\n');
+				break;
+			case 'r':
+				g_string_append_c (str, '\r');
+				break;
+			case 't':
+				g_string_append_c (str, '\t');
+				break;
+			case 'u':
+				if (parse_hex4 (parser, &c) == FALSE) {
+					set_parse_error (parser, error, _("Invalid Unicode escape."));
+					goto error;
+				}
+
+				/* Combine UTF-16 surrogate pairs. */
+				if (c >= 0xd800 && c <= 0xdbff) {
+					gunichar low;
+
+					if (parser->i[0] != '\\' || parser->i[1] != 'u') {
+						set_parse_error (parser, error, _("Unpaired UTF-16 surrogate."));
+						goto error;
+					}
+
+					parser->i += 2;
+
+					if (parse_hex4 (parser, &low) == FALSE || low < 0xdc00 || low > 0xdfff) {
+						set_parse_error (parser, error, _("Unpaired UTF-16 surrogate."));
+						goto error;
+					}
+
+					c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+				} else if ((c >= 0xdc00 && c <= 0xdfff) || c == 0) {
+					/* Nul characters can't be represented in a GVariant string. */
+					set_parse_error (parser, error, _("Invalid Unicode escape."));
+					goto error;
+				}
+
+				g_string_append_unichar (str, c);
+				break;
+			default:
+				parser->i--;
+				set_parse_error (parser, error, _("Invalid escape sequence."));
+				goto error;
+		}
+	}
+
+	/* Skip the closing quote. */
+	parser->i++;
+
+	return g_string_free (str, FALSE);
+
+error:
+	g_string_free (str, TRUE);
+
+	return NULL;
+}
+
+static GVariant *
+parse_number (JsonParser *parser, GError **error)
+{
+	const gchar *start = parser->i;
+	gchar *number_str;
+	gdouble number;
+
+	/* Check the number against the JSON grammar, since g_ascii_strtod() is more permissive. */
+	if (*parser->i == '-') {
+		parser->i++;
+	}
+
+	if (*parser->i == '0') {
+		parser->i++;
+	} else if (g_ascii_isdigit (*parser->i)) {
+		while (g_ascii_isdigit (*parser->i)) {
+			parser->i++;
+		}
+	} else {
+		set_parse_error (parser, error, _("Invalid number."));
+		return NULL;
+	}
+
+	if (*parser->i == '.') {
+		parser->i++;
+
+		if (g_ascii_isdigit (*parser->i) == FALSE) {
+			set_parse_error (parser, error, _("Invalid number."));
+			return NULL;
+		}
+
+		while (g_ascii_isdigit (*parser->i)) {
+			parser->i++;
+		}
+	}
+
+	if (*parser->i == 'e' || *parser->i == 'E') {
+		parser->i++;
+
+		if (*parser->i == '+' || *parser->i == '-') {
+			parser->i++;
+		}
+
+		if (g_ascii_isdigit (*parser->i) == FALSE) {
+			set_parse_error (parser, error, _("Invalid number."));
+			return NULL;
+		}
+
+		while (g_ascii_isdigit (*parser->i)) {
+			parser->i++;
+		}
+	}
+
+	number_str = g_strndup (start, parser->i - start);
+	number = g_ascii_strtod (number_str, NULL);
+	g_free (number_str);
+
+	return g_variant_new_double (number);
+}
+
+static GVariant *
+parse_object (JsonParser *parser, guint depth, GError **error)
+{
+	GVariantBuilder builder;
+
+	/* Skip the opening brace. */
+	parser->i++;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	skip_whitespace (parser);
+
+	if (*parser->i == '}') {
+		parser->i++;
+		return g_variant_builder_end (&builder);
+	}
+
+	while (TRUE) {
+		gchar *key;
+		GVariant *value;
+
+		skip_whitespace (parser);
+
+		if (*parser->i != '"') {
+			set_parse_error (parser, error, _("Expected a member name."));
+			goto error;
+		}
+
+		key = parse_string (parser, error);
+
+		if (key == NULL) {
+			goto error;
+		}
+
+		skip_whitespace (parser);
+
+		if (*parser->i != ':') {
+			set_parse_error (parser, error, _("Expected ‘:’."));
+			g_free (key);
+			goto error;
+		}
+
+		parser->i++;
+
+		value = parse_value (parser, depth + 1, error);
+
+		if (value == NULL) {
+			g_free (key);
+			goto error;
+		}
+
+		g_variant_builder_add (&builder, "{sv}", key, value);
+		g_free (key);
+
+		skip_whitespace (parser);
+
+		if (*parser->i == ',') {
+			parser->i++;
+		} else if (*parser->i == '}') {
+			parser->i++;
+			break;
+		} else {
+			set_parse_error (parser, error, _("Expected ‘,’ or ‘}’."));
+			goto error;
+		}
+	}
+
+	return g_variant_builder_end (&builder);
+
+error:
+	g_variant_builder_clear (&builder);
+
+	return NULL;
+}
+
+static GVariant *
+parse_array (JsonParser *parser, guint depth, GError **error)
+{
+	GVariantBuilder builder;
+
+	/* Skip the opening bracket. */
+	parser->i++;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("av"));
+	skip_whitespace (parser);
+
+	if (*parser->i == ']') {
+		parser->i++;
+		return g_variant_builder_end (&builder);
+	}
+
+	while (TRUE) {
+		GVariant *value;
+
+		value = parse_value (parser, depth + 1, error);
+
+		if (value == NULL) {
+			goto error;
+		}
+
+		g_variant_builder_add (&builder, "v", value);
+
+		skip_whitespace (parser);
+
+		if (*parser->i == ',') {
+			parser->i++;
+		} else if (*parser->i == ']') {
+			parser->i++;
+			break;
+		} else {
+			set_parse_error (parser, error, _("Expected ‘,’ or ‘]’."));
+			goto error;
+		}
+	}
+
+	return g_variant_builder_end (&builder);
+
+error:
+	g_variant_builder_clear (&builder);
+
+	return NULL;
+}
+
+/* Returns a floating reference. */
+static GVariant *
+parse_value (JsonParser *parser, guint depth, GError **error)
+{
+	skip_whitespace (parser);
+
+	if (depth > MAX_DEPTH) {
+		set_parse_error (parser, error, _("Too deeply nested."));
+		return NULL;
+	}
+
+	switch (*parser->i) {
+		case '{':
+			return parse_object (parser, depth, error);
+		case '[':
+			return parse_array (parser, depth, error);
+		case '"': {
+			gchar *str = parse_string (parser, error);
+
+			return (str != NULL) ? g_variant_new_take_string (str) : NULL;
+		}
+		case 't':
+			if (parse_literal (parser, "true") == TRUE) {
+				return g_variant_new_boolean (TRUE);
+			}
+			break;
+		case 'f':
+			if (parse_literal (parser, "false") == TRUE) {
+				return g_variant_new_boolean (FALSE);
+			}
+			break;
+		case 'n':
+			if (parse_literal (parser, "null") == TRUE) {
+				return g_variant_new_maybe (G_VARIANT_TYPE_VARIANT, NULL);
+			}
+			break;
+		default:
+			if (*parser->i == '-' || g_ascii_isdigit (*parser->i)) {
+				return parse_number (parser, error);
+			}
+			break;
+	}
+
+	set_parse_error (parser, error, _("Expected a value."));
+
+	return NULL;
+}
+
+/*
+ * lint_json_parse:
+ * @json: nul-terminated JSON text
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Parse a single JSON value from @json, which must contain nothing else except whitespace.
+ *
+ * Return value: (transfer full): the value as a non-floating #GVariant, or %NULL on error
+ */
+GVariant *
+lint_json_parse (const gchar *json, GError **error)
+{
+	JsonParser parser;
+	GVariant *value;
+
+	g_return_val_if_fail (json != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	parser.json = json;
+	parser.i = json;
+
+	if (g_utf8_validate (json, -1, NULL) == FALSE) {
+		set_parse_error (&parser, error, _("Invalid UTF-8."));
+		return NULL;
+	}
+
+	value = parse_value (&parser, 0, error);
+
+	if (value == NULL) {
+		return NULL;
+	}
+
+	g_variant_ref_sink (value);
+	skip_whitespace (&parser);
+
+	if (*parser.i != '\0') {
+		set_parse_error (&parser, error, _("Trailing characters after value."));
+		g_variant_unref (value);
+		return NULL;
+	}
+
+	return value;
+}
+
+/*
+ * lint_json_append_string:
+ * @buffer: buffer to append to
+ * @str: UTF-8 string to append
+ *
+ * Append @str to @buffer as a quoted, escaped JSON string.
+ */
+void
+lint_json_append_string (GString *buffer, const gchar *str)
+{
+	const gchar *i;
+
+	g_string_append_c (buffer, '"');
+
+	for (i = str; *i != '\0'; i++) {
+		switch (*i) {
+			case '"':
+				g_string_append (buffer, "\\\"");
+				break;
+			case '\\':
+				g_string_append (buffer, "\\\\");
+				break;
+			case '\n':
+				g_string_append (buffer, "\\n");
+				break;
+			case '\r':
+				g_string_append (buffer, "\\r");
+				break;
+			case '\t':
+				g_string_append (buffer, "\\t");
+				break;
+			default:
+				if ((guchar) *i < 0x20) {
+					g_string_append_printf (buffer, "\\u%04x", (guint) *i);
+				} else {
+					g_string_append_c (buffer, *i);
+				}
+				break;
+		}
+	}
+
+	g_string_append_c (buffer, '"');
+}
+
+/*
+ * lint_json_append_value:
+ * @buffer: buffer to append to
+ * @value: a #GVariant in the representation returned by lint_json_parse()
+ *
+ * Append @value to @buffer as JSON. Numbers with integral values are written without a fractional part.
+ */
+void
+lint_json_append_value (GString *buffer, GVariant *value)
+{
+	const GVariantType *type = g_variant_get_type (value);
+
+	if (g_variant_type_equal (type, G_VARIANT_TYPE_VARDICT) == TRUE) {
+		GVariantIter iter;
+		const gchar *key;
+		GVariant *child;
+		gboolean first = TRUE;
+
+		g_string_append_c (buffer, '{');
+		g_variant_iter_init (&iter, value);
+
+		while (g_variant_iter_loop (&iter, "{&sv}", &key, &child) == TRUE) {
+			if (first == FALSE) {
+				g_string_append_c (buffer, ',');
+			}
+
+			lint_json_append_string (buffer, key);
+			g_string_append_c (buffer, ':');
+			lint_json_append_value (buffer, child);
+			first = FALSE;
+		}
+
+		g_string_append_c (buffer, '}');
+	} else if (g_variant_type_equal (type, G_VARIANT_TYPE ("av")) == TRUE) {
+		GVariantIter iter;
+		GVariant *child;
+		gboolean first = TRUE;
+
+		g_string_append_c (buffer, '[');
+		g_variant_iter_init (&iter, value);
+
+		while (g_variant_iter_loop (&iter, "v", &child) == TRUE) {
+			if (first == FALSE) {
+				g_string_append_c (buffer, ',');
+			}
+
+			lint_json_append_value (buffer, child);
+			first = FALSE;
+		}
+
+		g_string_append_c (buffer, ']');
+	} else if (g_variant_type_equal (type, G_VARIANT_TYPE_STRING) == TRUE) {
+		lint_json_append_string (buffer, g_variant_get_string (value, NULL));
+	} else if (g_variant_type_equal (type, G_VARIANT_TYPE_DOUBLE) == TRUE) {
+		gdouble number = g_variant_get_double (value);
+
+		if (isfinite (number) == FALSE) {
+			/* JSON can't represent these. */
+			g_string_append (buffer, "null");
+		} else if (number == floor (number) && fabs (number) < 1e15) {
+			g_string_append_printf (buffer, "%" G_GINT64_FORMAT, (gint64) number);
+		} else {
+			gchar number_str[G_ASCII_DTOSTR_BUF_SIZE];
+
+			g_string_append (buffer, g_ascii_dtostr (number_str, sizeof (number_str), number));
+		}
+	} else if (g_variant_type_equal (type, G_VARIANT_TYPE_BOOLEAN) == TRUE) {
+		g_string_append (buffer, (g_variant_get_boolean (value) == TRUE) ? "true" : "false");
+	} else {
+		/* Null, or anything which can't be represented. */
+		g_string_append (buffer, "null");
+	}
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#ifndef LINT_JSON_H
+#define LINT_JSON_H
+
+G_BEGIN_DECLS
+
+/**
+ * LintJsonError:
+ * @LINT_JSON_ERROR_INVALID: The input wasn't valid JSON.
+ *
+ * Error codes for the #LINT_JSON_ERROR domain.
+ */
+typedef enum {
+	LINT_JSON_ERROR_INVALID = 0,
+} LintJsonError;
+
+#define LINT_JSON_ERROR lint_json_error_quark ()
+
+GQuark lint_json_error_quark (void) G_GNUC_PURE;
+
+GVariant *lint_json_parse (const gchar *json, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+void lint_json_append_string (GString *buffer, const gchar *str);
+void lint_json_append_value (GString *buffer, GVariant *value);
+
+G_END_DECLS
+
+#endif /* !LINT_JSON_H */
@@ -22,18 +22,196 @@
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
 #include <dfsm/dfsm.h>
 
+#include "batch.h"
+#include "server.h"
+
 enum StatusCodes {
 	STATUS_SUCCESS = 0,
 	STATUS_INVALID_OPTIONS = 1,
 	STATUS_UNREADABLE_FILE = 2,
 	STATUS_INVALID_CODE = 3,
 	STATUS_UNREACHABLE_STATES = 4,
+	STATUS_SERVER_ERROR = 5,
+};
+
+static gboolean server_mode = FALSE;
+static gchar *manifest_filename = NULL;
+static gboolean explore = FALSE;
+static gint explore_depth = 16;
+static gint explore_limit = 100000;
+static gboolean machine_cache = FALSE;
+
+static const GOptionEntry main_entries[] = {
+	{ "server", 0, 0, G_OPTION_ARG_NONE, &server_mode, N_("Run as a server, reading check requests from standard input"), NULL },
+	{ "manifest", 0, 0, G_OPTION_ARG_FILENAME, &manifest_filename,
+	  N_("Check all the pairs of simulation code and introspection XML files listed in a manifest file, outputting the results as JSON"),
+	  N_("FILE") },
+	{ "explore", 0, 0, G_OPTION_ARG_NONE, &explore, N_("Systematically explore the configurations of each object and report their coverage"),
+	  NULL },
+	{ "explore-depth", 0, 0, G_OPTION_ARG_INT, &explore_depth,
+	  N_("Maximum number of transitions to take from the starting state when exploring, or 0 for no limit (default: 16)"), N_("DEPTH") },
+	{ "explore-limit", 0, 0, G_OPTION_ARG_INT, &explore_limit,
+	  N_("Maximum number of configurations to explore per object, or 0 for no limit (default: 100000)"), N_("COUNT") },
+	{ "machine-cache", 0, 0, G_OPTION_ARG_NONE, &machine_cache,
+	  N_("Store the parsed simulation code in the compiled machine cache, and load it from there if it hasn't changed"), NULL },
+	{ NULL }
 };
 
+/* Cache the parsed simulation code between runs, to save re-parsing it if it hasn't changed, if requested. */
+static void
+set_up_machine_cache (void)
+{
+	gchar *cache_directory;
+
+	if (machine_cache == FALSE) {
+		return;
+	}
+
+	cache_directory = g_build_filename (g_get_user_cache_dir (), "bendy-bus", "machines", NULL);
+	dfsm_object_factory_set_cache_directory (cache_directory);
+	g_free (cache_directory);
+}
+
+/* Run the lint server on stdin and stdout until it's shut down. */
+static int
+run_server (void)
+{
+	GInputStream *input_stream;
+	GOutputStream *output_stream;
+	GError *error = NULL;
+
+	input_stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+	output_stream = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+
+	lint_server_run (input_stream, output_stream, &error);
+
+	g_object_unref (output_stream);
+	g_object_unref (input_stream);
+
+	if (error != NULL) {
+		g_printerr (_("Error running lint server: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+
+		return STATUS_SERVER_ERROR;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+/* Check all the files in the manifest, writing the results to stdout. */
+static int
+run_batch (void)
+{
+	GOutputStream *output_stream;
+	LintBatchResult result;
+	GError *error = NULL;
+
+	output_stream = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+	lint_batch_run (manifest_filename, output_stream, &result, &error);
+	g_object_unref (output_stream);
+
+	if (error != NULL) {
+		g_printerr (_("Error checking manifest: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+
+		return STATUS_UNREADABLE_FILE;
+	}
+
+	if (result & LINT_BATCH_RESULT_UNREADABLE_FILE) {
+		return STATUS_UNREADABLE_FILE;
+	} else if (result & LINT_BATCH_RESULT_INVALID_CODE) {
+		return STATUS_INVALID_CODE;
+	} else if (result & LINT_BATCH_RESULT_UNREACHABLE_STATES) {
+		return STATUS_UNREACHABLE_STATES;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+/* Explore the configurations of @simulated_object breadth-first, printing a summary of the states and transitions which were covered. This doesn't
+ * affect the exit status: since method and property inputs take default values while exploring, a state which isn't reached isn't necessarily
+ * unreachable. */
+static void
+explore_object (DfsmObject *simulated_object)
+{
+	DfsmMachine *machine;
+	DfsmExploration *exploration;
+	GArray/*<guint>*/ *state_coverage, *transition_coverage;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *transitions;
+	guint i, num_covered_states = 0, num_covered_transitions = 0;
+
+	machine = dfsm_object_get_machine (simulated_object);
+	exploration = dfsm_exploration_new (machine);
+
+	/* This can't fail, since we don't cancel it. */
+	dfsm_exploration_run (exploration, DFSM_EXPLORATION_BREADTH_FIRST, MAX (explore_depth, 0), MAX (explore_limit, 0), NULL, NULL);
+
+	state_coverage = dfsm_exploration_get_state_coverage (exploration);
+	transition_coverage = dfsm_exploration_get_transition_coverage (exploration);
+	transitions = dfsm_exploration_get_transitions (exploration);
+
+	for (i = 0; i < state_coverage->len; i++) {
+		if (g_array_index (state_coverage, guint, i) > 0) {
+			num_covered_states++;
+		}
+	}
+
+	for (i = 0; i < transition_coverage->len; i++) {
+		if (g_array_index (transition_coverage, guint, i) > 0) {
+			num_covered_transitions++;
+		}
+	}
+
+	if (dfsm_exploration_is_exhaustive (exploration) == TRUE) {
+		g_print (_("Exhaustively explored %u configurations of object ‘%s’ to depth %u: %u of %u states and %u of %u transitions "
+		           "covered."),
+		         dfsm_exploration_get_num_configurations (exploration), dfsm_object_get_object_path (simulated_object),
+		         dfsm_exploration_get_depth (exploration), num_covered_states, state_coverage->len, num_covered_transitions,
+		         transition_coverage->len);
+	} else {
+		g_print (_("Explored %u configurations of object ‘%s’ to depth %u: %u of %u states and %u of %u transitions covered."),
+		         dfsm_exploration_get_num_configurations (exploration), dfsm_object_get_object_path (simulated_object),
+		         dfsm_exploration_get_depth (exploration), num_covered_states, state_coverage->len, num_covered_transitions,
+		         transition_coverage->len);
+	}
+
+	g_print ("\n");
+
+	for (i = 0; i < state_coverage->len; i++) {
+		if (g_array_index (state_coverage, guint, i) == 0) {
+			g_print (_("State ‘%s’ of object ‘%s’ was not reached by exploration."), dfsm_machine_get_state_name (machine, i),
+			         dfsm_object_get_object_path (simulated_object));
+			g_print ("\n");
+		}
+	}
+
+	for (i = 0; i < transition_coverage->len; i++) {
+		DfsmAstObjectTransition *object_transition = g_ptr_array_index (transitions, i);
+
+		if (g_array_index (transition_coverage, guint, i) == 0) {
+			g_print (_("Transition %s from ‘%s’ to ‘%s’ of object ‘%s’ was not executed by exploration."),
+			         dfsm_ast_object_transition_get_friendly_name (object_transition),
+			         dfsm_machine_get_state_name (machine, object_transition->from_state),
+			         dfsm_machine_get_state_name (machine, object_transition->to_state),
+			         dfsm_object_get_object_path (simulated_object));
+			g_print ("\n");
+		}
+	}
+
+	g_object_unref (exploration);
+}
+
 static void
 print_help_text (GOptionContext *context)
 {
@@ -70,6 +248,7 @@ main (int argc, char *argv[])
 	context = g_option_context_new (_("[simulation code file] [introspection XML file]"));
 	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
 	g_option_context_set_summary (context, _("Checks the FSM simulation code for a D-Bus client–server conversation simulation."));
+	g_option_context_add_main_entries (context, main_entries, GETTEXT_PACKAGE);
 
 	if (g_option_context_parse (context, &argc, &argv, &error) == FALSE) {
 		g_printerr (_("Error parsing command line options: %s"), error->message);
@@ -83,6 +262,28 @@ main (int argc, char *argv[])
 		exit (STATUS_INVALID_OPTIONS);
 	}
 
+	/* In server mode, the files are passed in the requests. The server keeps its own in-memory cache, so doesn't use the compiled machine
+	 * cache. */
+	if (server_mode == TRUE) {
+		g_option_context_free (context);
+
+		return run_server ();
+	}
+
+	/* In batch mode, the files are listed in the manifest. */
+	if (manifest_filename != NULL) {
+		int status;
+
+		g_option_context_free (context);
+
+		set_up_machine_cache ();
+
+		status = run_batch ();
+		g_free (manifest_filename);
+
+		return status;
+	}
+
 	/* Extract the simulation and the introspection filenames. */
 	if (argc < 3) {
 		g_printerr (_("Error parsing command line options: %s"), _("Simulation and introspection filenames must be provided"));
@@ -124,6 +325,8 @@ main (int argc, char *argv[])
 		exit (STATUS_UNREADABLE_FILE);
 	}
 
+	set_up_machine_cache ();
+
 	/* Build the DfsmObjects and thus check the simulation code. */
 	simulated_objects = dfsm_object_factory_from_data (simulation_code, introspection_xml, &error);
 
@@ -171,6 +374,10 @@ main (int argc, char *argv[])
 		}
 
 		g_array_unref (reachability);
+
+		if (explore == TRUE) {
+			explore_object (simulated_object);
+		}
 	}
 
 	g_ptr_array_unref (simulated_objects);
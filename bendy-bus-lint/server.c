@@ -0,0 +1,574 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "check.h"
+#include "json.h"
+#include "server.h"
+
+/* The lint server reads JSON-RPC 2.0 requests from its input, one per line, and writes a response to each on a single line of its output. It
+ * supports two methods:
+ *  • ‘check’, whose parameters are an object with any of the members:
+ *     – ‘introspection’: the introspection XML, which must be given in the first request and is then kept until it's replaced;
+ *     – ‘simulation’: the full simulation code, replacing any previous code;
+ *     – ‘edits’: an array of ‘{"start": offset, "end": offset, "text": string}’ objects, each replacing the characters between the start and end
+ *       offsets (counted in Unicode characters) of the current simulation code with the given text, applied in order.
+ *    Its result is an object whose ‘diagnostics’ member is an array of the problems in the code, as formatted by lint_diagnostic_append_json().
+ *    ‘objectsChecked’ and ‘objectsReused’ give the number of objects which were re-checked and whose previous diagnostics were reused, and
+ *    ‘checkTime’ the time spent checking, in microseconds.
+ *  • ‘shutdown’, which takes no parameters and returns null, after which the server exits.
+ *
+ * Between requests, the server keeps the parsed introspection data and the diagnostics for each object block (‘object at … { … }’) in the code.
+ * Objects are checked independently of each other, so when the code changes, only the object blocks whose text has changed need to be re-checked.
+ * Each block is checked on its own, with padding in front of it so that the positions in its diagnostics are the same as they would be if the
+ * whole document were checked, other than being offset by a whole number of lines. If the code can't be split into object blocks (for example,
+ * because its braces are unbalanced), the whole document is checked as a single block. */
+
+/* JSON-RPC 2.0 error codes. */
+#define JSON_RPC_PARSE_ERROR -32700
+#define JSON_RPC_INVALID_REQUEST -32600
+#define JSON_RPC_METHOD_NOT_FOUND -32601
+#define JSON_RPC_INVALID_PARAMS -32602
+
+typedef struct {
+	gchar *text; /* the object's code, with padding in front of it */
+	guint line_offset; /* number of lines to add to a line number in @text to get the line number in the document */
+	guint start_line; /* one-based line in the document on which the block starts */
+	guint end_line; /* one-based line in the document on which the block ends */
+} ObjectBlock;
+
+static void
+object_block_free (ObjectBlock *block)
+{
+	g_free (block->text);
+	g_slice_free (ObjectBlock, block);
+}
+
+typedef struct {
+	GDBusNodeInfo *dbus_node_info; /* NULL until the introspection XML has been given */
+	gchar *introspection_xml; /* NULL until the introspection XML has been given */
+	gchar *simulation_code; /* NULL until the simulation code has been given */
+	GHashTable/*<string, GPtrArray<LintDiagnostic>>*/ *checked_blocks; /* padded block text → diagnostics relative to it */
+	gboolean shutting_down;
+} LintServer;
+
+static ObjectBlock *
+object_block_new (const gchar *simulation_code, const gchar *line_start, const gchar *block_start, const gchar *block_end, guint start_line,
+                  guint end_line)
+{
+	ObjectBlock *block;
+	GString *text;
+	const gchar *i;
+
+	text = g_string_sized_new (block_end - line_start + 1);
+
+	/* Pad the block so that it starts at the same column as in the document, and, unless it's on the first line, after a newline, since the
+	 * scanner counts columns differently on the first line. Tabs are kept since they affect column numbers differently to other characters. */
+	if (line_start != simulation_code) {
+		g_string_append_c (text, '\n');
+	}
+
+	for (i = line_start; i < block_start; i++) {
+		g_string_append_c (text, (*i == '\t') ? '\t' : ' ');
+	}
+
+	g_string_append_len (text, block_start, block_end - block_start);
+
+	block = g_slice_new (ObjectBlock);
+	block->text = g_string_free (text, FALSE);
+	block->line_offset = (line_start == simulation_code) ? 0 : start_line - 2;
+	block->start_line = start_line;
+	block->end_line = end_line;
+
+	return block;
+}
+
+/* Split @simulation_code into its object blocks. This only needs to scan enough of the syntax to find the ends of the blocks: comments, strings
+ * and type annotations (which may contain braces). Returns NULL if @simulation_code can't be split. */
+static GPtrArray/*<ObjectBlock>*/ *
+split_into_object_blocks (const gchar *simulation_code)
+{
+	GPtrArray/*<ObjectBlock>*/ *blocks;
+	const gchar *i, *line_start, *block_start = NULL, *block_line_start = NULL;
+	guint line = 1, block_start_line = 0, depth = 0;
+
+	blocks = g_ptr_array_new_with_free_func ((GDestroyNotify) object_block_free);
+	i = line_start = simulation_code;
+
+	while (*i != '\0') {
+		if (*i == '\n') {
+			i++;
+			line++;
+			line_start = i;
+		} else if (i[0] == '/' && i[1] == '*') {
+			const gchar *comment_end = strstr (i + 2, "*/");
+
+			if (comment_end == NULL) {
+				goto unsplittable;
+			}
+
+			for (; i < comment_end + 2; i++) {
+				if (*i == '\n') {
+					line++;
+					line_start = i + 1;
+				}
+			}
+		} else if (block_start == NULL) {
+			/* Between blocks, only whitespace and the start of the next block are allowed. */
+			if (g_ascii_isspace (*i)) {
+				i++;
+			} else if (strncmp (i, "object", strlen ("object")) == 0 && g_ascii_isalnum (i[strlen ("object")]) == FALSE &&
+			           i[strlen ("object")] != '_') {
+				block_start = i;
+				block_line_start = line_start;
+				block_start_line = line;
+				depth = 0;
+
+				i += strlen ("object");
+			} else {
+				goto unsplittable;
+			}
+		} else if (*i == '"') {
+			/* Strings can only span lines using escaped newlines. */
+			for (i++; *i != '"'; i++) {
+				if (*i == '\0' || *i == '\n') {
+					goto unsplittable;
+				} else if (*i == '\\') {
+					i++;
+
+					if (*i == '\0') {
+						goto unsplittable;
+					} else if (*i == '\n') {
+						line++;
+						line_start = i + 1;
+					}
+				}
+			}
+
+			i++;
+		} else if (*i == '@') {
+			/* Type annotation. */
+			for (i++; *i != '\0' && strchr ("(){}ybnqiuxtdsogarvehm*?@&^", *i) != NULL; i++);
+		} else if (*i == '{') {
+			depth++;
+			i++;
+		} else if (*i == '}') {
+			if (depth == 0) {
+				goto unsplittable;
+			}
+
+			depth--;
+			i++;
+
+			if (depth == 0) {
+				/* End of the block. */
+				g_ptr_array_add (blocks, object_block_new (simulation_code, block_line_start, block_start, i, block_start_line, line));
+				block_start = NULL;
+			}
+		} else {
+			i++;
+		}
+	}
+
+	if (block_start != NULL || blocks->len == 0) {
+		goto unsplittable;
+	}
+
+	return blocks;
+
+unsplittable:
+	g_ptr_array_unref (blocks);
+
+	return NULL;
+}
+
+static void
+append_error_response (GString *response, GVariant *id, gint code, const gchar *message)
+{
+	g_string_append (response, "{\"jsonrpc\":\"2.0\",\"id\":");
+
+	if (id != NULL) {
+		lint_json_append_value (response, id);
+	} else {
+		g_string_append (response, "null");
+	}
+
+	g_string_append_printf (response, ",\"error\":{\"code\":%i,\"message\":", code);
+	lint_json_append_string (response, message);
+	g_string_append (response, "}}");
+}
+
+/* Apply an array of edits to the current simulation code. */
+static gboolean
+apply_edits (LintServer *self, GVariant *edits, GError **error)
+{
+	GVariantIter iter;
+	GVariant *edit;
+
+	if (self->simulation_code == NULL) {
+		g_set_error_literal (error, LINT_JSON_ERROR, LINT_JSON_ERROR_INVALID, _("Edits given before any simulation code."));
+		return FALSE;
+	}
+
+	g_variant_iter_init (&iter, edits);
+
+	while (g_variant_iter_next (&iter, "v", &edit) == TRUE) {
+		gdouble start, end;
+		const gchar *text;
+		glong length;
+		const gchar *start_pointer, *end_pointer;
+		GString *new_simulation_code;
+
+		if (g_variant_is_of_type (edit, G_VARIANT_TYPE_VARDICT) == FALSE ||
+		    g_variant_lookup (edit, "start", "d", &start) == FALSE ||
+		    g_variant_lookup (edit, "end", "d", &end) == FALSE ||
+		    g_variant_lookup (edit, "text", "&s", &text) == FALSE) {
+			g_set_error_literal (error, LINT_JSON_ERROR, LINT_JSON_ERROR_INVALID, _("Edits must have ‘start’, ‘end’ and ‘text’ members."));
+			g_variant_unref (edit);
+			return FALSE;
+		}
+
+		length = g_utf8_strlen (self->simulation_code, -1);
+
+		if (start < 0 || end < start || end > length || start != (glong) start || end != (glong) end) {
+			g_set_error (error, LINT_JSON_ERROR, LINT_JSON_ERROR_INVALID, _("Invalid edit range %g–%g."), start, end);
+			g_variant_unref (edit);
+			return FALSE;
+		}
+
+		start_pointer = g_utf8_offset_to_pointer (self->simulation_code, (glong) start);
+		end_pointer = g_utf8_offset_to_pointer (start_pointer, (glong) (end - start));
+
+		new_simulation_code = g_string_new_len (self->simulation_code, start_pointer - self->simulation_code);
+		g_string_append (new_simulation_code, text);
+		g_string_append (new_simulation_code, end_pointer);
+
+		g_free (self->simulation_code);
+		self->simulation_code = g_string_free (new_simulation_code, FALSE);
+
+		g_variant_unref (edit);
+	}
+
+	return TRUE;
+}
+
+/* Check the current simulation code, re-using the diagnostics for any object blocks which haven't changed since the last check, and append the
+ * result to @response. */
+static void
+append_check_result (LintServer *self, GString *response)
+{
+	GPtrArray/*<ObjectBlock>*/ *blocks;
+	GHashTable/*<string, GPtrArray<LintDiagnostic>>*/ *checked_blocks;
+	guint i, j, num_checked = 0, num_reused = 0;
+	gint64 start_time;
+	gboolean first = TRUE;
+
+	start_time = g_get_monotonic_time ();
+
+	blocks = split_into_object_blocks (self->simulation_code);
+
+	if (blocks == NULL) {
+		const gchar *c;
+		guint num_lines = 1;
+
+		for (c = self->simulation_code; *c != '\0'; c++) {
+			if (*c == '\n') {
+				num_lines++;
+			}
+		}
+
+		blocks = g_ptr_array_new_with_free_func ((GDestroyNotify) object_block_free);
+		g_ptr_array_add (blocks, object_block_new (self->simulation_code, self->simulation_code, self->simulation_code,
+		                                           self->simulation_code + strlen (self->simulation_code), 1, num_lines));
+	}
+
+	/* Blocks which are no longer in the document are dropped from the cache by building a new one. */
+	checked_blocks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+	g_string_append (response, "{\"diagnostics\":[");
+
+	for (i = 0; i < blocks->len; i++) {
+		ObjectBlock *block = g_ptr_array_index (blocks, i);
+		GPtrArray/*<LintDiagnostic>*/ *diagnostics;
+
+		diagnostics = g_hash_table_lookup (checked_blocks, block->text);
+
+		if (diagnostics == NULL) {
+			diagnostics = g_hash_table_lookup (self->checked_blocks, block->text);
+
+			if (diagnostics != NULL) {
+				g_ptr_array_ref (diagnostics);
+				num_reused++;
+			} else {
+				diagnostics = lint_check_simulation_code (block->text, self->dbus_node_info);
+				num_checked++;
+			}
+
+			g_hash_table_insert (checked_blocks, g_strdup (block->text), diagnostics);
+		} else {
+			num_reused++;
+		}
+
+		for (j = 0; j < diagnostics->len; j++) {
+			LintDiagnostic *diagnostic;
+
+			diagnostic = lint_diagnostic_copy (g_ptr_array_index (diagnostics, j));
+
+			/* Move the diagnostic to its position in the document. Diagnostics without a position are given the block's lines. */
+			if (diagnostic->start_line != 0) {
+				diagnostic->start_line += block->line_offset;
+				diagnostic->end_line += block->line_offset;
+			} else {
+				diagnostic->start_line = block->start_line;
+				diagnostic->end_line = block->end_line;
+			}
+
+			if (first == FALSE) {
+				g_string_append_c (response, ',');
+			}
+
+			lint_diagnostic_append_json (diagnostic, response);
+			first = FALSE;
+
+			lint_diagnostic_free (diagnostic);
+		}
+	}
+
+	g_hash_table_unref (self->checked_blocks);
+	self->checked_blocks = checked_blocks;
+
+	g_ptr_array_unref (blocks);
+
+	g_string_append_printf (response, "],\"objectsChecked\":%u,\"objectsReused\":%u,\"checkTime\":%" G_GINT64_FORMAT "}", num_checked, num_reused,
+	                        g_get_monotonic_time () - start_time);
+}
+
+/* Handle a ‘check’ request, appending the result or error to @response. */
+static void
+handle_check (LintServer *self, GVariant *id, GVariant *params, GString *response)
+{
+	const gchar *introspection_xml = NULL, *simulation_code = NULL;
+	GVariant *edits = NULL;
+	GError *error = NULL;
+
+	if (params == NULL || g_variant_is_of_type (params, G_VARIANT_TYPE_VARDICT) == FALSE) {
+		append_error_response (response, id, JSON_RPC_INVALID_PARAMS, _("The parameters must be an object."));
+		return;
+	}
+
+	g_variant_lookup (params, "introspection", "&s", &introspection_xml);
+	g_variant_lookup (params, "simulation", "&s", &simulation_code);
+	edits = g_variant_lookup_value (params, "edits", G_VARIANT_TYPE ("av"));
+
+	/* Update the introspection data. All the cached diagnostics depend on it, so have to be dropped if it changes. */
+	if (introspection_xml != NULL && g_strcmp0 (introspection_xml, self->introspection_xml) != 0) {
+		GDBusNodeInfo *dbus_node_info;
+
+		dbus_node_info = g_dbus_node_info_new_for_xml (introspection_xml, &error);
+
+		if (error != NULL) {
+			gchar *message = g_strdup_printf (_("Error parsing introspection XML: %s"), error->message);
+			append_error_response (response, id, JSON_RPC_INVALID_PARAMS, message);
+			g_free (message);
+
+			g_error_free (error);
+			goto done;
+		}
+
+		if (self->dbus_node_info != NULL) {
+			g_dbus_node_info_unref (self->dbus_node_info);
+		}
+
+		self->dbus_node_info = dbus_node_info;
+
+		g_free (self->introspection_xml);
+		self->introspection_xml = g_strdup (introspection_xml);
+
+		g_hash_table_remove_all (self->checked_blocks);
+	}
+
+	/* Update the simulation code. */
+	if (simulation_code != NULL) {
+		g_free (self->simulation_code);
+		self->simulation_code = g_strdup (simulation_code);
+	}
+
+	if (edits != NULL && apply_edits (self, edits, &error) == FALSE) {
+		append_error_response (response, id, JSON_RPC_INVALID_PARAMS, error->message);
+		g_error_free (error);
+		goto done;
+	}
+
+	if (self->dbus_node_info == NULL || self->simulation_code == NULL) {
+		append_error_response (response, id, JSON_RPC_INVALID_PARAMS, _("Both introspection XML and simulation code must be given."));
+		goto done;
+	}
+
+	g_string_append (response, "{\"jsonrpc\":\"2.0\",\"id\":");
+	lint_json_append_value (response, id);
+	g_string_append (response, ",\"result\":");
+	append_check_result (self, response);
+	g_string_append_c (response, '}');
+
+done:
+	if (edits != NULL) {
+		g_variant_unref (edits);
+	}
+}
+
+/* Handle a single request line, appending the response (if any) to @response. */
+static void
+handle_request (LintServer *self, const gchar *line, GString *response)
+{
+	GVariant *request, *id, *params;
+	const gchar *method;
+	GString *method_response;
+	GError *error = NULL;
+
+	request = lint_json_parse (line, &error);
+
+	if (error != NULL) {
+		append_error_response (response, NULL, JSON_RPC_PARSE_ERROR, error->message);
+		g_error_free (error);
+		return;
+	}
+
+	if (g_variant_is_of_type (request, G_VARIANT_TYPE_VARDICT) == FALSE || g_variant_lookup (request, "method", "&s", &method) == FALSE) {
+		append_error_response (response, NULL, JSON_RPC_INVALID_REQUEST, _("Requests must be objects with a ‘method’ member."));
+		g_variant_unref (request);
+		return;
+	}
+
+	/* Requests without an ID are notifications, which don't get responses. */
+	id = g_variant_lookup_value (request, "id", NULL);
+	params = g_variant_lookup_value (request, "params", NULL);
+	method_response = g_string_new (NULL);
+
+	if (strcmp (method, "check") == 0) {
+		handle_check (self, id, params, method_response);
+	} else if (strcmp (method, "shutdown") == 0) {
+		self->shutting_down = TRUE;
+
+		g_string_append (method_response, "{\"jsonrpc\":\"2.0\",\"id\":");
+		lint_json_append_value (method_response, id);
+		g_string_append (method_response, ",\"result\":null}");
+	} else {
+		gchar *message = g_strdup_printf (_("Unknown method ‘%s’."), method);
+		append_error_response (method_response, id, JSON_RPC_METHOD_NOT_FOUND, message);
+		g_free (message);
+	}
+
+	if (id != NULL) {
+		g_string_append_len (response, method_response->str, method_response->len);
+	}
+
+	g_string_free (method_response, TRUE);
+
+	if (params != NULL) {
+		g_variant_unref (params);
+	}
+
+	if (id != NULL) {
+		g_variant_unref (id);
+	}
+
+	g_variant_unref (request);
+}
+
+/*
+ * lint_server_run:
+ * @input_stream: stream to read requests from
+ * @output_stream: stream to write responses to
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Run the lint server, handling requests read from @input_stream until it reaches end of file or a ‘shutdown’ request is handled. This blocks.
+ *
+ * Return value: %TRUE on a clean shutdown, %FALSE if reading or writing failed
+ */
+gboolean
+lint_server_run (GInputStream *input_stream, GOutputStream *output_stream, GError **error)
+{
+	LintServer server = { NULL, };
+	GDataInputStream *data_input_stream;
+	GString *response;
+	gboolean success = TRUE;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_INPUT_STREAM (input_stream), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (output_stream), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	server.checked_blocks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+	data_input_stream = g_data_input_stream_new (input_stream);
+	response = g_string_new (NULL);
+
+	while (server.shutting_down == FALSE) {
+		gchar *line;
+
+		line = g_data_input_stream_read_line (data_input_stream, NULL, NULL, &child_error);
+
+		if (child_error != NULL) {
+			/* Error! */
+			g_propagate_error (error, child_error);
+			success = FALSE;
+			break;
+		} else if (line == NULL) {
+			/* End of file. */
+			break;
+		}
+
+		g_string_truncate (response, 0);
+		handle_request (&server, line, response);
+		g_free (line);
+
+		if (response->len == 0) {
+			continue;
+		}
+
+		g_string_append_c (response, '\n');
+
+		if (g_output_stream_write_all (output_stream, response->str, response->len, NULL, NULL, &child_error) == FALSE ||
+		    g_output_stream_flush (output_stream, NULL, &child_error) == FALSE) {
+			/* Error! */
+			g_propagate_error (error, child_error);
+			success = FALSE;
+			break;
+		}
+	}
+
+	g_string_free (response, TRUE);
+	g_object_unref (data_input_stream);
+
+	g_hash_table_unref (server.checked_blocks);
+	g_free (server.simulation_code);
+	g_free (server.introspection_xml);
+
+	if (server.dbus_node_info != NULL) {
+		g_dbus_node_info_unref (server.dbus_node_info);
+	}
+
+	return success;
+}
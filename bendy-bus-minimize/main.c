@@ -0,0 +1,805 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <locale.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#include "bendy-bus/recorder.h"
+#include "bendy-bus/recording-output-sequence.h"
+
+enum StatusCodes {
+	STATUS_SUCCESS = 0,
+	STATUS_INVALID_OPTIONS = 1,
+	STATUS_UNREADABLE_FILE = 2,
+	STATUS_NO_CRASH = 3,
+	STATUS_SPAWN_ERROR = 4,
+	STATUS_TMP_DIR_ERROR = 5,
+	STATUS_UNWRITABLE_FILE = 6,
+};
+
+/* Time to wait for a candidate to die after sending it SIGTERM before sending it SIGKILL. */
+#define KILL_TIMEOUT 20 /* seconds */
+
+static gchar *output_file_path = NULL;
+static gint num_jobs = 0;
+static gint candidate_timeout = 60;
+static gchar *bendy_bus_path = NULL;
+static gchar **bendy_bus_options = NULL;
+
+static const GOptionEntry main_entries[] = {
+	{ "output-file", 'o', 0, G_OPTION_ARG_FILENAME, &output_file_path,
+	  N_("Path of the file to write the minimised recording to (default: the recording file with ‘.min’ appended)"), N_("FILE") },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &num_jobs,
+	  N_("Number of candidate recordings to replay in parallel (default: the number of processors)"), N_("COUNT") },
+	{ "timeout", 't', 0, G_OPTION_ARG_INT, &candidate_timeout,
+	  N_("Time (in seconds) after which a candidate replay is assumed not to crash (default: 60)"), N_("SECS") },
+	{ "bendy-bus", 0, 0, G_OPTION_ARG_FILENAME, &bendy_bus_path, N_("Path of the bendy-bus executable (default: bendy-bus)"), N_("FILE") },
+	{ "bendy-bus-option", 'O', 0, G_OPTION_ARG_STRING_ARRAY, &bendy_bus_options,
+	  N_("Additional option to pass to bendy-bus when replaying (may be given multiple times)"), N_("OPTION") },
+	{ NULL }
+};
+
+static void
+print_help_text (GOptionContext *context)
+{
+	gchar *help_text;
+
+	help_text = g_option_context_get_help (context, TRUE, NULL);
+	puts (help_text);
+	g_free (help_text);
+}
+
+typedef struct {
+	/* Command line */
+	const gchar *simulation_filename;
+	const gchar *introspection_filename;
+	gchar **test_program_argv;
+	GFile *tmp_dir;
+
+	/* The recording being minimised. */
+	GVariant *header_record; /* NULL if the recording had no header */
+	GPtrArray/*<GPtrArray<GVariant>>*/ *iterations; /* records for each test run, each starting with its iteration marker */
+	GArray/*<guint>*/ *kept_iterations; /* indices into iterations of the test runs kept so far, in order */
+
+	/* Signal the test program crashed with when replaying the original recording. */
+	gint crash_signal;
+
+	/* Statistics */
+	guint num_candidates_tested;
+} MinimizeData;
+
+/* Builds a candidate recording containing only the given units. */
+typedef GPtrArray/*<GVariant>*/ *(*BuildCandidateFunc) (MinimizeData *data, GArray/*<guint>*/ *units);
+
+static guint
+count_iterations (GPtrArray/*<GVariant>*/ *records)
+{
+	guint i, count = 0;
+
+	for (i = 0; i < records->len; i++) {
+		if (dsim_record_get_kind (g_ptr_array_index (records, i)) == DSIM_RECORD_ITERATION) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static GPid
+spawn_candidate (MinimizeData *data, GPtrArray/*<GVariant>*/ *records, GFile *candidate_file, GError **error)
+{
+	GPtrArray/*<string>*/ *argv;
+	gchar *candidate_path;
+	gchar **i;
+	GPid pid = 0;
+	GError *child_error = NULL;
+
+	/* Write out the candidate recording. */
+	if (dsim_recorder_save_records (candidate_file, records, &child_error) == FALSE) {
+		g_propagate_error (error, child_error);
+		return 0;
+	}
+
+	/* Build bendy-bus' command line. Only replay as many test runs as there are in the recording; once the replay's exhausted, bendy-bus would
+	 * just carry on simulating. */
+	candidate_path = g_file_get_path (candidate_file);
+
+	argv = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (argv, g_strdup ((bendy_bus_path != NULL) ? bendy_bus_path : "bendy-bus"));
+	g_ptr_array_add (argv, g_strdup_printf ("--replay-file=%s", candidate_path));
+	g_ptr_array_add (argv, g_strdup_printf ("--run-iters=%u", MAX (count_iterations (records), 1)));
+	g_ptr_array_add (argv, g_strdup ("--exit-with-crash-status"));
+
+	for (i = bendy_bus_options; i != NULL && *i != NULL; i++) {
+		g_ptr_array_add (argv, g_strdup (*i));
+	}
+
+	g_ptr_array_add (argv, g_strdup (data->simulation_filename));
+	g_ptr_array_add (argv, g_strdup (data->introspection_filename));
+	g_ptr_array_add (argv, g_strdup ("--"));
+
+	for (i = data->test_program_argv; *i != NULL; i++) {
+		g_ptr_array_add (argv, g_strdup (*i));
+	}
+
+	g_ptr_array_add (argv, NULL);
+
+	g_free (candidate_path);
+
+	g_spawn_async (NULL, (gchar **) argv->pdata, NULL,
+	               G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+	               NULL, NULL, &pid, &child_error);
+
+	g_ptr_array_unref (argv);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return 0;
+	}
+
+	data->num_candidates_tested++;
+
+	return pid;
+}
+
+typedef struct {
+	GPid pid; /* 0 once the process has been reaped */
+	GFile *candidate_file;
+	gint status;
+	gint64 deadline; /* monotonic time at which to send SIGTERM */
+	gboolean terminated; /* whether SIGTERM has been sent */
+} RunningCandidate;
+
+/* Replay the given candidate recordings, up to num_jobs at once, and return the index of the first one (in array order, regardless of which order
+ * they finish in) which causes the test program to crash with the same signal as the original recording; or -1 if none do. */
+static gint
+test_candidates (MinimizeData *data, GPtrArray/*<GPtrArray<GVariant>>*/ *candidates, GError **error)
+{
+	guint batch_start;
+	RunningCandidate *running;
+	gint crashing_index = -1;
+	GError *child_error = NULL;
+
+	running = g_new0 (RunningCandidate, num_jobs);
+
+	for (batch_start = 0; batch_start < candidates->len && crashing_index < 0 && child_error == NULL; batch_start += num_jobs) {
+		guint i, batch_length, num_running;
+
+		batch_length = MIN ((guint) num_jobs, candidates->len - batch_start);
+
+		/* Spawn the batch. */
+		for (i = 0; i < batch_length; i++) {
+			gchar *filename;
+
+			filename = g_strdup_printf ("candidate-%u.rec", i);
+			running[i].candidate_file = g_file_get_child (data->tmp_dir, filename);
+			g_free (filename);
+
+			running[i].deadline = g_get_monotonic_time () + (gint64) candidate_timeout * G_USEC_PER_SEC;
+			running[i].terminated = FALSE;
+			running[i].status = 0;
+			running[i].pid = spawn_candidate (data, g_ptr_array_index (candidates, batch_start + i), running[i].candidate_file,
+			                                  (child_error == NULL) ? &child_error : NULL);
+		}
+
+		/* Wait for the batch to finish. We poll, since the candidates need to be killed if they run for too long. */
+		do {
+			num_running = 0;
+
+			for (i = 0; i < batch_length; i++) {
+				pid_t wait_result;
+
+				if (running[i].pid == 0) {
+					continue;
+				}
+
+				wait_result = waitpid (running[i].pid, &running[i].status, WNOHANG);
+
+				if (wait_result == running[i].pid || (wait_result < 0 && errno != EINTR)) {
+					g_spawn_close_pid (running[i].pid);
+					running[i].pid = 0;
+					continue;
+				}
+
+				num_running++;
+
+				/* Timed out? Ask bendy-bus nicely to stop first, so that it can clean up its dbus-daemon. */
+				if (g_get_monotonic_time () > running[i].deadline) {
+					if (running[i].terminated == FALSE) {
+						kill (running[i].pid, SIGTERM);
+						running[i].terminated = TRUE;
+						running[i].deadline += KILL_TIMEOUT * G_USEC_PER_SEC;
+					} else {
+						kill (running[i].pid, SIGKILL);
+					}
+				}
+			}
+
+			if (num_running > 0) {
+				g_usleep (G_USEC_PER_SEC / 20);
+			}
+		} while (num_running > 0);
+
+		/* Check the results in order. Timed-out candidates don't count as crashing. If we don't know the crash signal yet (i.e. we're replaying
+		 * the original recording), any crash will do. */
+		for (i = 0; i < batch_length; i++) {
+			if (crashing_index < 0 && running[i].terminated == FALSE && WIFEXITED (running[i].status)) {
+				gint exit_status = WEXITSTATUS (running[i].status);
+
+				if (data->crash_signal == 0 && exit_status > 128 && exit_status < 128 + NSIG) {
+					data->crash_signal = exit_status - 128;
+				}
+
+				if (data->crash_signal != 0 && exit_status == 128 + data->crash_signal) {
+					crashing_index = batch_start + i;
+				}
+			}
+
+			g_file_delete (running[i].candidate_file, NULL, NULL);
+			g_clear_object (&running[i].candidate_file);
+		}
+	}
+
+	g_free (running);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return -1;
+	}
+
+	return crashing_index;
+}
+
+/* Split units into granularity roughly equal-sized contiguous chunks, and build the complement of each chunk. */
+static void
+split_units (GArray/*<guint>*/ *units, guint granularity, GPtrArray/*<GArray<guint>>*/ *subsets, GPtrArray/*<GArray<guint>>*/ *complements)
+{
+	guint i, start = 0;
+
+	for (i = 0; i < granularity; i++) {
+		GArray/*<guint>*/ *subset, *complement;
+		guint end;
+
+		end = start + (units->len - start) / (granularity - i);
+
+		subset = g_array_sized_new (FALSE, FALSE, sizeof (guint), end - start);
+		g_array_append_vals (subset, &g_array_index (units, guint, start), end - start);
+
+		complement = g_array_sized_new (FALSE, FALSE, sizeof (guint), units->len - (end - start));
+		g_array_append_vals (complement, &g_array_index (units, guint, 0), start);
+		g_array_append_vals (complement, &g_array_index (units, guint, end), units->len - end);
+
+		g_ptr_array_add (subsets, subset);
+		g_ptr_array_add (complements, complement);
+
+		start = end;
+	}
+}
+
+/* Test each of the given sets of units, returning the index of the first one which still crashes; or -1. */
+static gint
+test_unit_sets (MinimizeData *data, GPtrArray/*<GArray<guint>>*/ *unit_sets, BuildCandidateFunc build_candidate, GError **error)
+{
+	GPtrArray/*<GPtrArray<GVariant>>*/ *candidates;
+	guint i;
+	gint crashing_index;
+
+	candidates = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+
+	for (i = 0; i < unit_sets->len; i++) {
+		g_ptr_array_add (candidates, build_candidate (data, g_ptr_array_index (unit_sets, i)));
+	}
+
+	crashing_index = test_candidates (data, candidates, error);
+
+	g_ptr_array_unref (candidates);
+
+	return crashing_index;
+}
+
+/* Delta debugging (Zeller and Hildebrandt’s ddmin algorithm): find a 1-minimal subset of units whose candidate recording still crashes the test
+ * program. All the subsets (or complements) at a given granularity are tested in parallel; the first in order which crashes is chosen, so the result
+ * is independent of scheduling. */
+static GArray/*<guint>*/ *
+ddmin (MinimizeData *data, GArray/*<guint>*/ *units, BuildCandidateFunc build_candidate, gboolean allow_empty, GError **error)
+{
+	guint granularity = 2;
+	GError *child_error = NULL;
+
+	units = g_array_ref (units);
+
+	/* Try the trivial case first. */
+	if (allow_empty == TRUE && units->len > 0) {
+		GPtrArray/*<GArray<guint>>*/ *unit_sets;
+		gint crashing_index;
+
+		unit_sets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+		g_ptr_array_add (unit_sets, g_array_new (FALSE, FALSE, sizeof (guint)));
+
+		crashing_index = test_unit_sets (data, unit_sets, build_candidate, &child_error);
+
+		if (crashing_index == 0) {
+			g_array_unref (units);
+			units = g_array_ref (g_ptr_array_index (unit_sets, 0));
+		}
+
+		g_ptr_array_unref (unit_sets);
+	}
+
+	while (child_error == NULL && units->len >= 2) {
+		GPtrArray/*<GArray<guint>>*/ *subsets, *complements;
+		GArray/*<guint>*/ *new_units = NULL;
+		gint crashing_index;
+
+		granularity = MIN (granularity, units->len);
+
+		g_message (_("Trying to reduce %u units with granularity %u…"), units->len, granularity);
+
+		subsets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+		complements = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+		split_units (units, granularity, subsets, complements);
+
+		/* Reduce to subset? */
+		crashing_index = test_unit_sets (data, subsets, build_candidate, &child_error);
+
+		if (crashing_index >= 0) {
+			new_units = g_array_ref (g_ptr_array_index (subsets, crashing_index));
+			granularity = 2;
+		} else if (child_error == NULL && granularity > 2) {
+			/* Reduce to complement? (With a granularity of 2, the complements are the subsets, so have already been tested.) */
+			crashing_index = test_unit_sets (data, complements, build_candidate, &child_error);
+
+			if (crashing_index >= 0) {
+				new_units = g_array_ref (g_ptr_array_index (complements, crashing_index));
+				granularity = MAX (granularity - 1, 2);
+			}
+		}
+
+		g_ptr_array_unref (complements);
+		g_ptr_array_unref (subsets);
+
+		if (new_units != NULL) {
+			g_array_unref (units);
+			units = new_units;
+		} else if (granularity >= units->len) {
+			/* Done: units is 1-minimal. */
+			break;
+		} else {
+			/* Increase granularity. */
+			granularity = MIN (units->len, granularity * 2);
+		}
+	}
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		g_array_unref (units);
+		return NULL;
+	}
+
+	return units;
+}
+
+static GPtrArray/*<GVariant>*/ *
+build_iterations_candidate (MinimizeData *data, GArray/*<guint>*/ *kept_iterations)
+{
+	GPtrArray/*<GVariant>*/ *records;
+	guint i, j;
+
+	records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	if (data->header_record != NULL) {
+		g_ptr_array_add (records, g_variant_ref (data->header_record));
+	}
+
+	for (i = 0; i < kept_iterations->len; i++) {
+		GPtrArray/*<GVariant>*/ *iteration = g_ptr_array_index (data->iterations, g_array_index (kept_iterations, guint, i));
+
+		for (j = 0; j < iteration->len; j++) {
+			g_ptr_array_add (records, g_variant_ref (g_ptr_array_index (iteration, j)));
+		}
+	}
+
+	return records;
+}
+
+static gboolean
+entry_is_emit (GVariant *entry)
+{
+	guint8 entry_type;
+
+	g_variant_get_child (entry, 0, "y", &entry_type);
+
+	return (entry_type == DSIM_RECORDING_ENTRY_EMIT) ? TRUE : FALSE;
+}
+
+/* Count the signal emissions in the kept test runs. Each of these is a unit for the second stage of minimisation. Replies and errors are never
+ * removed, since the program under test is waiting for them. */
+static guint
+count_emit_units (MinimizeData *data)
+{
+	guint i, j, count = 0;
+
+	for (i = 0; i < data->kept_iterations->len; i++) {
+		GPtrArray/*<GVariant>*/ *iteration = g_ptr_array_index (data->iterations, g_array_index (data->kept_iterations, guint, i));
+
+		for (j = 0; j < iteration->len; j++) {
+			GVariant *entries, *entry;
+			GVariantIter iter;
+
+			entries = dsim_record_dup_entries (g_ptr_array_index (iteration, j));
+			g_variant_iter_init (&iter, entries);
+
+			while ((entry = g_variant_iter_next_value (&iter)) != NULL) {
+				if (entry_is_emit (entry) == TRUE) {
+					count++;
+				}
+
+				g_variant_unref (entry);
+			}
+
+			g_variant_unref (entries);
+		}
+	}
+
+	return count;
+}
+
+static GPtrArray/*<GVariant>*/ *
+build_emits_candidate (MinimizeData *data, GArray/*<guint>*/ *kept_emits)
+{
+	GPtrArray/*<GVariant>*/ *records;
+	gboolean *emit_kept;
+	guint i, j, unit = 0;
+
+	/* Build a lookup table from unit to whether it's kept. */
+	emit_kept = g_new0 (gboolean, count_emit_units (data));
+
+	for (i = 0; i < kept_emits->len; i++) {
+		emit_kept[g_array_index (kept_emits, guint, i)] = TRUE;
+	}
+
+	records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	if (data->header_record != NULL) {
+		g_ptr_array_add (records, g_variant_ref (data->header_record));
+	}
+
+	for (i = 0; i < data->kept_iterations->len; i++) {
+		GPtrArray/*<GVariant>*/ *iteration = g_ptr_array_index (data->iterations, g_array_index (data->kept_iterations, guint, i));
+
+		for (j = 0; j < iteration->len; j++) {
+			GVariant *record, *entries, *entry;
+			GVariantBuilder *builder;
+			GVariantIter iter;
+			guint num_entries = 0, num_kept_entries = 0;
+
+			record = g_ptr_array_index (iteration, j);
+			entries = dsim_record_dup_entries (record);
+			builder = g_variant_builder_new (G_VARIANT_TYPE ("a" DSIM_RECORDING_ENTRY_TYPE_STRING));
+
+			g_variant_iter_init (&iter, entries);
+
+			while ((entry = g_variant_iter_next_value (&iter)) != NULL) {
+				num_entries++;
+
+				if (entry_is_emit (entry) == FALSE || emit_kept[unit++] == TRUE) {
+					g_variant_builder_add_value (builder, entry);
+					num_kept_entries++;
+				}
+
+				g_variant_unref (entry);
+			}
+
+			g_variant_unref (entries);
+
+			if (num_kept_entries == num_entries) {
+				/* Unchanged. */
+				g_ptr_array_add (records, g_variant_ref (record));
+			} else if (num_kept_entries > 0 || dsim_record_get_kind (record) != DSIM_RECORD_ARBITRARY_TRANSITION) {
+				g_ptr_array_add (records, dsim_record_new_with_entries (record, g_variant_builder_end (builder)));
+			}
+
+			/* Otherwise, the record is an arbitrary transition which no longer does anything, so drop it. */
+
+			g_variant_builder_unref (builder);
+		}
+	}
+
+	g_free (emit_kept);
+
+	return records;
+}
+
+static GArray/*<guint>*/ *
+build_unit_range (guint num_units)
+{
+	GArray/*<guint>*/ *units;
+	guint i;
+
+	units = g_array_sized_new (FALSE, FALSE, sizeof (guint), num_units);
+
+	for (i = 0; i < num_units; i++) {
+		g_array_append_val (units, i);
+	}
+
+	return units;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GError *error = NULL;
+	GOptionContext *context;
+	const gchar *recording_filename;
+	gchar *tmp_dir_path, *default_output_file_path = NULL;
+	GFile *recording_file, *output_file;
+	GPtrArray/*<GVariant>*/ *records, *candidate;
+	GPtrArray/*<GPtrArray<GVariant>>*/ *candidates;
+	GPtrArray/*<GVariant>*/ *current_iteration = NULL;
+	GArray/*<guint>*/ *all_iterations, *all_emits, *kept_emits;
+	MinimizeData data = { NULL, };
+	guint i, num_emits;
+	gint status = STATUS_SUCCESS;
+	gint crashing_index;
+
+	/* Set up localisation. */
+	setlocale (LC_ALL, "");
+	bindtextdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+	g_set_application_name (_("D-Bus Simulator Minimiser"));
+
+	/* Parse command line options */
+	context = g_option_context_new (_("[recording file] [simulation code file] [introspection XML file] -- [executable-file] [arguments]"));
+	g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+	g_option_context_set_summary (context, _("Minimises a recorded D-Bus client–server conversation which crashes the client."));
+	g_option_context_add_main_entries (context, main_entries, GETTEXT_PACKAGE);
+
+	if (g_option_context_parse (context, &argc, &argv, &error) == FALSE) {
+		g_printerr (_("Error parsing command line options: %s"), error->message);
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_error_free (error);
+		g_option_context_free (context);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* Extract the recording, simulation and introspection filenames. */
+	if (argc < 4) {
+		g_printerr (_("Error parsing command line options: %s"), _("Recording, simulation and introspection filenames must be provided"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	recording_filename = argv[1];
+	data.simulation_filename = argv[2];
+	data.introspection_filename = argv[3];
+
+	/* Extract the test program's command line. g_option_context_parse() sometimes leaves the ‘--’ in argv. */
+	i = (argc > 4 && strcmp (argv[4], "--") == 0) ? 5 : 4;
+
+	if ((guint) argc <= i) {
+		g_printerr (_("Error parsing command line options: %s"), _("Test program must be provided"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	data.test_program_argv = argv + i;
+
+	g_option_context_free (context);
+
+	if (num_jobs <= 0) {
+		num_jobs = g_get_num_processors ();
+	}
+
+	if (output_file_path == NULL) {
+		default_output_file_path = g_strconcat (recording_filename, ".min", NULL);
+		output_file_path = default_output_file_path;
+	}
+
+	/* Load the recording and split it up into test runs. */
+	recording_file = g_file_new_for_commandline_arg (recording_filename);
+	records = dsim_recorder_load_records (recording_file, &error);
+	g_object_unref (recording_file);
+
+	if (error != NULL) {
+		g_printerr (_("Error loading recording from file ‘%s’: %s"), recording_filename, error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		g_free (default_output_file_path);
+
+		exit (STATUS_UNREADABLE_FILE);
+	}
+
+	data.iterations = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+
+	for (i = 0; i < records->len; i++) {
+		GVariant *record = g_ptr_array_index (records, i);
+
+		switch (dsim_record_get_kind (record)) {
+			case DSIM_RECORD_HEADER:
+				data.header_record = g_variant_ref (record);
+				break;
+			case DSIM_RECORD_ITERATION:
+				current_iteration = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+				g_ptr_array_add (data.iterations, current_iteration);
+				/* Fall through */
+			default:
+				if (current_iteration != NULL) {
+					g_ptr_array_add (current_iteration, g_variant_ref (record));
+				}
+
+				break;
+		}
+	}
+
+	g_ptr_array_unref (records);
+
+	/* Set up a temporary directory for the candidate recordings. */
+	tmp_dir_path = g_dir_make_tmp ("bendy-bus-minimize_XXXXXX", &error);
+
+	if (error != NULL) {
+		g_printerr (_("Error creating temporary directory: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		status = STATUS_TMP_DIR_ERROR;
+
+		goto done;
+	}
+
+	data.tmp_dir = g_file_new_for_path (tmp_dir_path);
+	g_free (tmp_dir_path);
+
+	/* Check that the original recording actually crashes, and find out which signal it crashes with. Later candidates must crash with the same
+	 * signal, so that minimisation doesn't wander off to a different bug. */
+	all_iterations = build_unit_range (data.iterations->len);
+
+	candidates = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+	g_ptr_array_add (candidates, build_iterations_candidate (&data, all_iterations));
+	crashing_index = test_candidates (&data, candidates, &error);
+	g_ptr_array_unref (candidates);
+
+	if (error != NULL) {
+		g_printerr (_("Error replaying recording: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		g_array_unref (all_iterations);
+		status = STATUS_SPAWN_ERROR;
+
+		goto done;
+	} else if (crashing_index < 0) {
+		g_printerr (_("Replaying recording ‘%s’ did not cause the test program to crash."), recording_filename);
+		g_printerr ("\n");
+
+		g_array_unref (all_iterations);
+		status = STATUS_NO_CRASH;
+
+		goto done;
+	}
+
+	g_message (_("Recording crashes the test program with signal %i (%s)."), data.crash_signal, g_strsignal (data.crash_signal));
+
+	/* Stage one: remove whole test runs. At least one test run must remain, since bendy-bus requires --run-iters to be positive. */
+	data.kept_iterations = ddmin (&data, all_iterations, build_iterations_candidate, FALSE, &error);
+	g_array_unref (all_iterations);
+
+	if (error != NULL) {
+		g_printerr (_("Error replaying recording: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		status = STATUS_SPAWN_ERROR;
+
+		goto done;
+	}
+
+	/* Stage two: remove signal emissions from the remaining test runs. */
+	num_emits = count_emit_units (&data);
+	all_emits = build_unit_range (num_emits);
+	kept_emits = ddmin (&data, all_emits, build_emits_candidate, TRUE, &error);
+	g_array_unref (all_emits);
+
+	if (error != NULL) {
+		g_printerr (_("Error replaying recording: %s"), error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		status = STATUS_SPAWN_ERROR;
+
+		goto done;
+	}
+
+	/* Write out the result. */
+	candidate = build_emits_candidate (&data, kept_emits);
+
+	output_file = g_file_new_for_commandline_arg (output_file_path);
+	dsim_recorder_save_records (output_file, candidate, &error);
+	g_object_unref (output_file);
+
+	g_ptr_array_unref (candidate);
+
+	if (error != NULL) {
+		g_printerr (_("Error writing minimised recording to file ‘%s’: %s"), output_file_path, error->message);
+		g_printerr ("\n");
+
+		g_error_free (error);
+		g_array_unref (kept_emits);
+		status = STATUS_UNWRITABLE_FILE;
+
+		goto done;
+	}
+
+	g_print (_("Reduced %u test runs to %u and %u signal emissions to %u in %u replays. Minimised recording written to ‘%s’."),
+	         data.iterations->len, data.kept_iterations->len, num_emits, kept_emits->len, data.num_candidates_tested, output_file_path);
+	g_print ("\n");
+
+	g_array_unref (kept_emits);
+
+done:
+	if (data.tmp_dir != NULL) {
+		g_file_delete (data.tmp_dir, NULL, NULL);
+		g_object_unref (data.tmp_dir);
+	}
+
+	if (data.kept_iterations != NULL) {
+		g_array_unref (data.kept_iterations);
+	}
+
+	g_ptr_array_unref (data.iterations);
+
+	if (data.header_record != NULL) {
+		g_variant_unref (data.header_record);
+	}
+
+	g_free (default_output_file_path);
+
+	return status;
+}
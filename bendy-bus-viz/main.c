@@ -37,11 +37,14 @@ enum StatusCodes {
 
 static const gchar *graph_id = NULL;
 static const gchar *object_path = NULL;
+static gboolean machine_cache = FALSE;
 
 const GOptionEntry main_entries[] = {
 	{ "graph-id", 'i', 0, G_OPTION_ARG_STRING, &graph_id, N_("ID of the outermost graph block (default: ‘bendy_bus’)"), N_("ID") },
 	{ "object-path", 'o', 0, G_OPTION_ARG_STRING, &object_path, N_("Object path of a single object to output (default: output all objects)"),
 	  N_("OBJECT PATH") },
+	{ "machine-cache", 0, 0, G_OPTION_ARG_NONE, &machine_cache,
+	  N_("Store the parsed simulation code in the compiled machine cache, and load it from there if it hasn't changed"), NULL },
 	{ NULL },
 };
 
@@ -261,6 +264,15 @@ main (int argc, char *argv[])
 		exit (STATUS_UNREADABLE_FILE);
 	}
 
+	/* Cache the parsed simulation code between runs, to save re-parsing it if it hasn't changed, if requested. */
+	if (machine_cache == TRUE) {
+		gchar *cache_directory;
+
+		cache_directory = g_build_filename (g_get_user_cache_dir (), "bendy-bus", "machines", NULL);
+		dfsm_object_factory_set_cache_directory (cache_directory);
+		g_free (cache_directory);
+	}
+
 	/* Build the DfsmObjects from which we can print the GraphViz code. */
 	ast_objects = dfsm_object_factory_asts_from_data (simulation_code, introspection_xml, &error);
 
@@ -0,0 +1,1129 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A minimal in-process D-Bus message bus, used in place of spawning a dbus-daemon for each simulation. It implements just enough of the
+ * org.freedesktop.DBus interface for typical clients (and GDBus in particular): Hello, RequestName, ReleaseName, GetNameOwner, NameHasOwner,
+ * ListNames, AddMatch, RemoveMatch, GetId and the GetConnectionUnix* methods, plus the NameOwnerChanged, NameAcquired and NameLost signals.
+ *
+ * There is no policy, no service activation, no eavesdropping and no queueing for names: a RequestName call for a name which is already owned,
+ * and which can't be replaced, fails with DBUS_REQUEST_NAME_REPLY_EXISTS.
+ *
+ * Messages are routed from the GDBus worker thread using a filter on each peer's connection, so they never pass through the main context. All the
+ * routing state is therefore kept in a separately reference counted BrokerCore, protected by a lock, which the filters hold references to.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "bus-broker.h"
+
+#define BUS_NAME "org.freedesktop.DBus"
+#define BUS_PATH "/org/freedesktop/DBus"
+#define BUS_INTERFACE "org.freedesktop.DBus"
+
+/* Flags and return values for RequestName and ReleaseName, from the D-Bus specification. */
+#define DBUS_NAME_FLAG_ALLOW_REPLACEMENT 0x1
+#define DBUS_NAME_FLAG_REPLACE_EXISTING 0x2
+
+#define DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER 1
+#define DBUS_REQUEST_NAME_REPLY_EXISTS 3
+#define DBUS_REQUEST_NAME_REPLY_ALREADY_OWNER 4
+
+#define DBUS_RELEASE_NAME_REPLY_RELEASED 1
+#define DBUS_RELEASE_NAME_REPLY_NON_EXISTENT 2
+#define DBUS_RELEASE_NAME_REPLY_NOT_OWNER 3
+
+/* Maximum N for argN keys in match rules. The D-Bus specification allows up to 63. */
+#define MAX_MATCH_ARGS 64
+
+typedef struct {
+	gchar *rule; /* the rule as passed to AddMatch, for RemoveMatch */
+	GDBusMessageType type; /* G_DBUS_MESSAGE_TYPE_INVALID to match all types */
+	gchar *sender;
+	gchar *interface;
+	gchar *member;
+	gchar *path;
+	gchar *path_namespace;
+	gchar *destination;
+	gchar *args[MAX_MATCH_ARGS]; /* NULL for unconstrained arguments */
+	guint num_args; /* one more than the highest constrained argument */
+} MatchRule;
+
+typedef struct {
+	GDBusConnection *connection;
+	gchar *unique_name;
+	gboolean said_hello;
+	GPtrArray/*<MatchRule>*/ *match_rules;
+	guint filter_id;
+	gulong closed_signal;
+} Peer;
+
+typedef struct {
+	Peer *owner; /* unowned */
+	gboolean allow_replacement;
+} NameOwner;
+
+typedef struct {
+	volatile gint ref_count;
+
+	GMutex lock; /* protects everything below */
+	GHashTable/*<string, Peer>*/ *peers; /* unique name → peer; owned */
+	GHashTable/*<GDBusConnection, Peer>*/ *peers_by_connection; /* unowned */
+	GHashTable/*<string, NameOwner>*/ *name_owners; /* well-known name → owner */
+	guint next_peer_id;
+	gchar *guid;
+} BrokerCore;
+
+static void
+match_rule_free (MatchRule *rule)
+{
+	guint i;
+
+	for (i = 0; i < rule->num_args; i++) {
+		g_free (rule->args[i]);
+	}
+
+	g_free (rule->destination);
+	g_free (rule->path_namespace);
+	g_free (rule->path);
+	g_free (rule->member);
+	g_free (rule->interface);
+	g_free (rule->sender);
+	g_free (rule->rule);
+
+	g_slice_free (MatchRule, rule);
+}
+
+/* Parse a match rule as described in the D-Bus specification: a comma-separated list of key='value' pairs. Inside single quotes there is no
+ * escaping; outside, \' is an apostrophe. Returns NULL if the rule is invalid or uses keys we don't support. */
+static MatchRule *
+match_rule_new (const gchar *rule_string)
+{
+	MatchRule *rule;
+	const gchar *i = rule_string;
+	GString *key, *value;
+
+	rule = g_slice_new0 (MatchRule);
+	rule->rule = g_strdup (rule_string);
+	rule->type = G_DBUS_MESSAGE_TYPE_INVALID;
+
+	key = g_string_new (NULL);
+	value = g_string_new (NULL);
+
+	while (*i != '\0') {
+		gboolean in_quotes = FALSE;
+		guint64 arg_index;
+		gchar *end;
+
+		g_string_truncate (key, 0);
+		g_string_truncate (value, 0);
+
+		/* Key. */
+		while (*i == ' ') {
+			i++;
+		}
+
+		while (*i != '\0' && *i != '=') {
+			g_string_append_c (key, *i);
+			i++;
+		}
+
+		if (*i != '=') {
+			goto error;
+		}
+
+		i++;
+
+		/* Value. */
+		for (; *i != '\0' && (in_quotes == TRUE || *i != ','); i++) {
+			if (*i == '\'') {
+				in_quotes = !in_quotes;
+			} else if (in_quotes == FALSE && *i == '\\' && *(i + 1) == '\'') {
+				g_string_append_c (value, '\'');
+				i++;
+			} else {
+				g_string_append_c (value, *i);
+			}
+		}
+
+		if (in_quotes == TRUE) {
+			goto error;
+		}
+
+		if (*i == ',') {
+			i++;
+		}
+
+		/* Store the pair. Duplicate keys are invalid. */
+		#define SET_STRING_KEY(Key) \
+			if (strcmp (key->str, #Key) == 0) { \
+				if (rule->Key != NULL) { \
+					goto error; \
+				} \
+				rule->Key = g_strdup (value->str); \
+				continue; \
+			}
+
+		SET_STRING_KEY (sender)
+		SET_STRING_KEY (interface)
+		SET_STRING_KEY (member)
+		SET_STRING_KEY (path)
+		SET_STRING_KEY (path_namespace)
+		SET_STRING_KEY (destination)
+
+		#undef SET_STRING_KEY
+
+		if (strcmp (key->str, "type") == 0) {
+			if (rule->type != G_DBUS_MESSAGE_TYPE_INVALID) {
+				goto error;
+			} else if (strcmp (value->str, "signal") == 0) {
+				rule->type = G_DBUS_MESSAGE_TYPE_SIGNAL;
+			} else if (strcmp (value->str, "method_call") == 0) {
+				rule->type = G_DBUS_MESSAGE_TYPE_METHOD_CALL;
+			} else if (strcmp (value->str, "method_return") == 0) {
+				rule->type = G_DBUS_MESSAGE_TYPE_METHOD_RETURN;
+			} else if (strcmp (value->str, "error") == 0) {
+				rule->type = G_DBUS_MESSAGE_TYPE_ERROR;
+			} else {
+				goto error;
+			}
+
+			continue;
+		}
+
+		/* argN. argNpath and arg0namespace aren't supported. */
+		if (g_str_has_prefix (key->str, "arg") == TRUE && g_ascii_isdigit (key->str[3]) == TRUE) {
+			arg_index = g_ascii_strtoull (key->str + 3, &end, 10);
+
+			if (*end != '\0' || arg_index >= MAX_MATCH_ARGS || rule->args[arg_index] != NULL) {
+				goto error;
+			}
+
+			rule->args[arg_index] = g_strdup (value->str);
+			rule->num_args = MAX (rule->num_args, arg_index + 1);
+
+			continue;
+		}
+
+		/* Unknown key. */
+		goto error;
+	}
+
+	g_string_free (value, TRUE);
+	g_string_free (key, TRUE);
+
+	return rule;
+
+error:
+	g_string_free (value, TRUE);
+	g_string_free (key, TRUE);
+	match_rule_free (rule);
+
+	return NULL;
+}
+
+static Peer *
+peer_new (GDBusConnection *connection, guint id)
+{
+	Peer *peer;
+
+	peer = g_slice_new0 (Peer);
+	peer->connection = g_object_ref (connection);
+	peer->unique_name = g_strdup_printf (":1.%u", id);
+	peer->match_rules = g_ptr_array_new_with_free_func ((GDestroyNotify) match_rule_free);
+
+	return peer;
+}
+
+static void
+peer_free (Peer *peer)
+{
+	/* Note that the filter may still be running in the worker thread after it's removed. It holds its own reference to the core, and will drop
+	 * any message whose connection isn't in the core's peer table. */
+	g_signal_handler_disconnect (peer->connection, peer->closed_signal);
+	g_dbus_connection_remove_filter (peer->connection, peer->filter_id);
+
+	g_ptr_array_unref (peer->match_rules);
+	g_free (peer->unique_name);
+	g_object_unref (peer->connection);
+
+	g_slice_free (Peer, peer);
+}
+
+static void
+name_owner_free (NameOwner *name_owner)
+{
+	g_slice_free (NameOwner, name_owner);
+}
+
+static BrokerCore *
+broker_core_new (const gchar *guid)
+{
+	BrokerCore *core;
+
+	core = g_slice_new0 (BrokerCore);
+	core->ref_count = 1;
+	g_mutex_init (&core->lock);
+	core->peers = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) peer_free);
+	core->peers_by_connection = g_hash_table_new (g_direct_hash, g_direct_equal);
+	core->name_owners = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) name_owner_free);
+	core->next_peer_id = 1;
+	core->guid = g_strdup (guid);
+
+	return core;
+}
+
+static BrokerCore *
+broker_core_ref (BrokerCore *core)
+{
+	g_atomic_int_inc (&core->ref_count);
+
+	return core;
+}
+
+static void
+broker_core_unref (BrokerCore *core)
+{
+	if (g_atomic_int_dec_and_test (&core->ref_count) == FALSE) {
+		return;
+	}
+
+	/* All the peers must have been removed by now, since their filters hold references to us. */
+	g_assert (g_hash_table_size (core->peers) == 0);
+
+	g_free (core->guid);
+	g_hash_table_unref (core->name_owners);
+	g_hash_table_unref (core->peers_by_connection);
+	g_hash_table_unref (core->peers);
+	g_mutex_clear (&core->lock);
+
+	g_slice_free (BrokerCore, core);
+}
+
+/* Must be called with the lock held. Returns the peer currently owning the given unique or well-known name, or NULL. */
+static Peer *
+lookup_peer_for_name (BrokerCore *core, const gchar *name)
+{
+	NameOwner *name_owner;
+
+	if (g_dbus_is_unique_name (name) == TRUE) {
+		return g_hash_table_lookup (core->peers, name);
+	}
+
+	name_owner = g_hash_table_lookup (core->name_owners, name);
+
+	return (name_owner != NULL) ? name_owner->owner : NULL;
+}
+
+/* Must be called with the lock held. */
+static gboolean
+match_rule_matches (BrokerCore *core, const MatchRule *rule, GDBusMessage *message)
+{
+	const gchar *path;
+	GVariant *body;
+	guint i;
+
+	if (rule->type != G_DBUS_MESSAGE_TYPE_INVALID && rule->type != g_dbus_message_get_message_type (message)) {
+		return FALSE;
+	}
+
+	if (rule->sender != NULL) {
+		const gchar *sender = g_dbus_message_get_sender (message);
+
+		if (sender == NULL) {
+			return FALSE;
+		}
+
+		/* Match well-known names against their current owner. */
+		if (g_dbus_is_unique_name (rule->sender) == TRUE || strcmp (rule->sender, BUS_NAME) == 0) {
+			if (strcmp (rule->sender, sender) != 0) {
+				return FALSE;
+			}
+		} else {
+			Peer *owner = lookup_peer_for_name (core, rule->sender);
+
+			if (owner == NULL || strcmp (owner->unique_name, sender) != 0) {
+				return FALSE;
+			}
+		}
+	}
+
+	if ((rule->interface != NULL && g_strcmp0 (rule->interface, g_dbus_message_get_interface (message)) != 0) ||
+	    (rule->member != NULL && g_strcmp0 (rule->member, g_dbus_message_get_member (message)) != 0) ||
+	    (rule->destination != NULL && g_strcmp0 (rule->destination, g_dbus_message_get_destination (message)) != 0)) {
+		return FALSE;
+	}
+
+	path = g_dbus_message_get_path (message);
+
+	if (rule->path != NULL && g_strcmp0 (rule->path, path) != 0) {
+		return FALSE;
+	}
+
+	if (rule->path_namespace != NULL) {
+		gsize namespace_length = strlen (rule->path_namespace);
+
+		if (path == NULL ||
+		    (strcmp (rule->path_namespace, "/") != 0 && (strncmp (path, rule->path_namespace, namespace_length) != 0 ||
+		                                                 (path[namespace_length] != '\0' && path[namespace_length] != '/')))) {
+			return FALSE;
+		}
+	}
+
+	if (rule->num_args == 0) {
+		return TRUE;
+	}
+
+	/* Argument matches only apply to string arguments. */
+	body = g_dbus_message_get_body (message);
+
+	for (i = 0; i < rule->num_args; i++) {
+		GVariant *arg;
+		gboolean arg_matches;
+
+		if (rule->args[i] == NULL) {
+			continue;
+		}
+
+		if (body == NULL || i >= g_variant_n_children (body)) {
+			return FALSE;
+		}
+
+		arg = g_variant_get_child_value (body, i);
+		arg_matches = (g_variant_is_of_type (arg, G_VARIANT_TYPE_STRING) == TRUE &&
+		               strcmp (g_variant_get_string (arg, NULL), rule->args[i]) == 0) ? TRUE : FALSE;
+		g_variant_unref (arg);
+
+		if (arg_matches == FALSE) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+send_message (Peer *recipient, GDBusMessage *message, gboolean preserve_serial)
+{
+	GError *error = NULL;
+
+	if (g_dbus_connection_send_message (recipient->connection, message,
+	                                    (preserve_serial == TRUE) ? G_DBUS_SEND_MESSAGE_FLAGS_PRESERVE_SERIAL : G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+	                                    NULL, &error) == FALSE) {
+		/* This typically happens if the recipient's just disconnected, which is not our problem. */
+		g_debug ("Error routing message to peer ‘%s’: %s", recipient->unique_name, error->message);
+		g_error_free (error);
+	}
+}
+
+/* Must be called with the lock held. Delivers a copy of the signal to every peer with a matching match rule. */
+static void
+broadcast_signal (BrokerCore *core, GDBusMessage *message, gboolean preserve_serial)
+{
+	GHashTableIter iter;
+	Peer *peer;
+
+	g_hash_table_iter_init (&iter, core->peers);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &peer) == TRUE) {
+		guint i;
+
+		if (peer->said_hello == FALSE) {
+			continue;
+		}
+
+		for (i = 0; i < peer->match_rules->len; i++) {
+			if (match_rule_matches (core, g_ptr_array_index (peer->match_rules, i), message) == TRUE) {
+				GDBusMessage *copy;
+				GError *error = NULL;
+
+				copy = g_dbus_message_copy (message, &error);
+
+				if (copy == NULL) {
+					g_debug ("Error copying message to broadcast: %s", error->message);
+					g_error_free (error);
+				} else {
+					send_message (peer, copy, preserve_serial);
+					g_object_unref (copy);
+				}
+
+				break;
+			}
+		}
+	}
+}
+
+/* Must be called with the lock held. Emits a signal from the bus itself, either to the given peer or (if it's NULL) to all interested peers.
+ * @parameters is consumed if floating. */
+static void
+emit_bus_signal (BrokerCore *core, Peer *destination, const gchar *member, GVariant *parameters)
+{
+	GDBusMessage *message;
+
+	message = g_dbus_message_new_signal (BUS_PATH, BUS_INTERFACE, member);
+	g_dbus_message_set_sender (message, BUS_NAME);
+	g_dbus_message_set_body (message, parameters);
+
+	if (destination != NULL) {
+		g_dbus_message_set_destination (message, destination->unique_name);
+		send_message (destination, message, FALSE);
+	} else {
+		broadcast_signal (core, message, FALSE);
+	}
+
+	g_object_unref (message);
+}
+
+static void
+emit_name_owner_changed (BrokerCore *core, const gchar *name, const gchar *old_owner, const gchar *new_owner)
+{
+	emit_bus_signal (core, NULL, "NameOwnerChanged", g_variant_new ("(sss)", name, old_owner, new_owner));
+}
+
+/* Must be called with the lock held. Takes ownership of @reply. */
+static void
+send_bus_reply (Peer *peer, GDBusMessage *call, GDBusMessage *reply)
+{
+	if ((g_dbus_message_get_flags (call) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0) {
+		g_dbus_message_set_sender (reply, BUS_NAME);
+		send_message (peer, reply, FALSE);
+	}
+
+	g_object_unref (reply);
+}
+
+static void
+return_value (Peer *peer, GDBusMessage *call, GVariant *parameters)
+{
+	GDBusMessage *reply;
+
+	reply = g_dbus_message_new_method_reply (call);
+	g_dbus_message_set_body (reply, parameters);
+	send_bus_reply (peer, call, reply);
+}
+
+static void
+return_error (Peer *peer, GDBusMessage *call, const gchar *error_name, const gchar *message)
+{
+	send_bus_reply (peer, call, g_dbus_message_new_method_error_literal (call, error_name, message));
+}
+
+/* Must be called with the lock held. Removes the peer from the core and frees it, releasing all the names it owned. */
+static void
+remove_peer (BrokerCore *core, Peer *peer)
+{
+	GHashTableIter iter;
+	NameOwner *name_owner;
+	gchar *name, *unique_name;
+	GPtrArray/*<string>*/ *released_names;
+	gboolean said_hello;
+	guint i;
+
+	released_names = g_ptr_array_new_with_free_func (g_free);
+
+	g_hash_table_iter_init (&iter, core->name_owners);
+
+	while (g_hash_table_iter_next (&iter, (gpointer*) &name, (gpointer*) &name_owner) == TRUE) {
+		if (name_owner->owner == peer) {
+			g_ptr_array_add (released_names, g_strdup (name));
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	unique_name = g_strdup (peer->unique_name);
+	said_hello = peer->said_hello;
+
+	g_hash_table_remove (core->peers_by_connection, peer->connection);
+	g_hash_table_remove (core->peers, unique_name); /* frees peer */
+
+	/* Tell everyone else. */
+	for (i = 0; i < released_names->len; i++) {
+		emit_name_owner_changed (core, g_ptr_array_index (released_names, i), unique_name, "");
+	}
+
+	if (said_hello == TRUE) {
+		emit_name_owner_changed (core, unique_name, unique_name, "");
+	}
+
+	g_free (unique_name);
+	g_ptr_array_unref (released_names);
+}
+
+/* Must be called with the lock held. */
+static void
+handle_request_name (BrokerCore *core, Peer *peer, GDBusMessage *call, const gchar *name, guint32 flags)
+{
+	NameOwner *name_owner;
+	Peer *old_owner;
+
+	if (g_dbus_is_name (name) == FALSE || g_dbus_is_unique_name (name) == TRUE || strcmp (name, BUS_NAME) == 0) {
+		return_error (peer, call, "org.freedesktop.DBus.Error.InvalidArgs", "Cannot acquire a service with an invalid or reserved name.");
+		return;
+	}
+
+	name_owner = g_hash_table_lookup (core->name_owners, name);
+
+	if (name_owner == NULL) {
+		name_owner = g_slice_new0 (NameOwner);
+		name_owner->owner = peer;
+		name_owner->allow_replacement = (flags & DBUS_NAME_FLAG_ALLOW_REPLACEMENT) ? TRUE : FALSE;
+		g_hash_table_insert (core->name_owners, g_strdup (name), name_owner);
+
+		return_value (peer, call, g_variant_new ("(u)", DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER));
+		emit_bus_signal (core, peer, "NameAcquired", g_variant_new ("(s)", name));
+		emit_name_owner_changed (core, name, "", peer->unique_name);
+
+		return;
+	} else if (name_owner->owner == peer) {
+		name_owner->allow_replacement = (flags & DBUS_NAME_FLAG_ALLOW_REPLACEMENT) ? TRUE : FALSE;
+		return_value (peer, call, g_variant_new ("(u)", DBUS_REQUEST_NAME_REPLY_ALREADY_OWNER));
+
+		return;
+	} else if ((flags & DBUS_NAME_FLAG_REPLACE_EXISTING) == 0 || name_owner->allow_replacement == FALSE) {
+		/* We don't support queueing, so treat everything as DBUS_NAME_FLAG_DO_NOT_QUEUE. */
+		return_value (peer, call, g_variant_new ("(u)", DBUS_REQUEST_NAME_REPLY_EXISTS));
+
+		return;
+	}
+
+	/* Replace the existing owner. */
+	old_owner = name_owner->owner;
+	name_owner->owner = peer;
+	name_owner->allow_replacement = (flags & DBUS_NAME_FLAG_ALLOW_REPLACEMENT) ? TRUE : FALSE;
+
+	return_value (peer, call, g_variant_new ("(u)", DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER));
+	emit_bus_signal (core, old_owner, "NameLost", g_variant_new ("(s)", name));
+	emit_bus_signal (core, peer, "NameAcquired", g_variant_new ("(s)", name));
+	emit_name_owner_changed (core, name, old_owner->unique_name, peer->unique_name);
+}
+
+/* Must be called with the lock held. */
+static void
+handle_release_name (BrokerCore *core, Peer *peer, GDBusMessage *call, const gchar *name)
+{
+	NameOwner *name_owner;
+
+	if (g_dbus_is_name (name) == FALSE || g_dbus_is_unique_name (name) == TRUE || strcmp (name, BUS_NAME) == 0) {
+		return_error (peer, call, "org.freedesktop.DBus.Error.InvalidArgs", "Cannot release a service with an invalid or reserved name.");
+		return;
+	}
+
+	name_owner = g_hash_table_lookup (core->name_owners, name);
+
+	if (name_owner == NULL) {
+		return_value (peer, call, g_variant_new ("(u)", DBUS_RELEASE_NAME_REPLY_NON_EXISTENT));
+	} else if (name_owner->owner != peer) {
+		return_value (peer, call, g_variant_new ("(u)", DBUS_RELEASE_NAME_REPLY_NOT_OWNER));
+	} else {
+		g_hash_table_remove (core->name_owners, name);
+
+		return_value (peer, call, g_variant_new ("(u)", DBUS_RELEASE_NAME_REPLY_RELEASED));
+		emit_bus_signal (core, peer, "NameLost", g_variant_new ("(s)", name));
+		emit_name_owner_changed (core, name, peer->unique_name, "");
+	}
+}
+
+/* Must be called with the lock held. */
+static void
+handle_get_connection_credentials (BrokerCore *core, Peer *peer, GDBusMessage *call, const gchar *method_name, const gchar *name)
+{
+	Peer *target;
+	GCredentials *credentials;
+
+	target = lookup_peer_for_name (core, name);
+
+	if (target == NULL) {
+		return_error (peer, call, "org.freedesktop.DBus.Error.NameHasNoOwner", "Could not get credentials of a name which has no owner.");
+		return;
+	}
+
+	credentials = g_dbus_connection_get_peer_credentials (target->connection);
+
+	if (credentials == NULL) {
+		return_error (peer, call, "org.freedesktop.DBus.Error.Failed", "Could not determine the credentials of the connection.");
+	} else if (strcmp (method_name, "GetConnectionUnixProcessID") == 0) {
+		return_value (peer, call, g_variant_new ("(u)", (guint32) g_credentials_get_unix_pid (credentials, NULL)));
+	} else {
+		return_value (peer, call, g_variant_new ("(u)", (guint32) g_credentials_get_unix_user (credentials, NULL)));
+	}
+}
+
+/* Must be called with the lock held. Handles a method call addressed to the bus itself. */
+static void
+handle_bus_method_call (BrokerCore *core, Peer *peer, GDBusMessage *call)
+{
+	const gchar *interface_name, *method_name, *signature;
+	GVariant *body;
+
+	interface_name = g_dbus_message_get_interface (call);
+	method_name = g_dbus_message_get_member (call);
+	body = g_dbus_message_get_body (call);
+	signature = (body != NULL) ? g_variant_get_type_string (body) : "()";
+
+	g_debug ("Bus method call from ‘%s’: %s.%s%s", peer->unique_name, interface_name, method_name, signature);
+
+	#define IS_METHOD(Name, Signature) (strcmp (method_name, (Name)) == 0 && strcmp (signature, (Signature)) == 0)
+
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Peer") == 0 && IS_METHOD ("Ping", "()")) {
+		return_value (peer, call, NULL);
+		return;
+	} else if (interface_name != NULL && strcmp (interface_name, BUS_INTERFACE) != 0) {
+		return_error (peer, call, "org.freedesktop.DBus.Error.UnknownInterface", "Unknown interface.");
+		return;
+	}
+
+	if (IS_METHOD ("Hello", "()")) {
+		if (peer->said_hello == TRUE) {
+			return_error (peer, call, "org.freedesktop.DBus.Error.Failed", "Already handled an Hello message.");
+			return;
+		}
+
+		peer->said_hello = TRUE;
+
+		return_value (peer, call, g_variant_new ("(s)", peer->unique_name));
+		emit_bus_signal (core, peer, "NameAcquired", g_variant_new ("(s)", peer->unique_name));
+		emit_name_owner_changed (core, peer->unique_name, "", peer->unique_name);
+	} else if (peer->said_hello == FALSE) {
+		/* As with dbus-daemon, nothing else is allowed until the peer has said hello. */
+		return_error (peer, call, "org.freedesktop.DBus.Error.AccessDenied", "Client tried to send a message other than Hello without being registered.");
+	} else if (IS_METHOD ("RequestName", "(su)")) {
+		const gchar *name;
+		guint32 flags;
+
+		g_variant_get (body, "(&su)", &name, &flags);
+		handle_request_name (core, peer, call, name, flags);
+	} else if (IS_METHOD ("ReleaseName", "(s)")) {
+		const gchar *name;
+
+		g_variant_get (body, "(&s)", &name);
+		handle_release_name (core, peer, call, name);
+	} else if (IS_METHOD ("GetNameOwner", "(s)")) {
+		const gchar *name;
+		Peer *owner;
+
+		g_variant_get (body, "(&s)", &name);
+
+		if (strcmp (name, BUS_NAME) == 0) {
+			return_value (peer, call, g_variant_new ("(s)", BUS_NAME));
+		} else if ((owner = lookup_peer_for_name (core, name)) != NULL) {
+			return_value (peer, call, g_variant_new ("(s)", owner->unique_name));
+		} else {
+			return_error (peer, call, "org.freedesktop.DBus.Error.NameHasNoOwner", "Could not get owner of name: no such name.");
+		}
+	} else if (IS_METHOD ("NameHasOwner", "(s)")) {
+		const gchar *name;
+
+		g_variant_get (body, "(&s)", &name);
+		return_value (peer, call, g_variant_new ("(b)", (strcmp (name, BUS_NAME) == 0 || lookup_peer_for_name (core, name) != NULL)));
+	} else if (IS_METHOD ("ListNames", "()")) {
+		GVariantBuilder builder;
+		GHashTableIter iter;
+		const gchar *name;
+		Peer *other_peer;
+
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+		g_variant_builder_add (&builder, "s", BUS_NAME);
+
+		g_hash_table_iter_init (&iter, core->name_owners);
+		while (g_hash_table_iter_next (&iter, (gpointer*) &name, NULL) == TRUE) {
+			g_variant_builder_add (&builder, "s", name);
+		}
+
+		g_hash_table_iter_init (&iter, core->peers);
+		while (g_hash_table_iter_next (&iter, (gpointer*) &name, (gpointer*) &other_peer) == TRUE) {
+			if (other_peer->said_hello == TRUE) {
+				g_variant_builder_add (&builder, "s", name);
+			}
+		}
+
+		return_value (peer, call, g_variant_new ("(as)", &builder));
+	} else if (IS_METHOD ("AddMatch", "(s)")) {
+		const gchar *rule_string;
+		MatchRule *rule;
+
+		g_variant_get (body, "(&s)", &rule_string);
+		rule = match_rule_new (rule_string);
+
+		if (rule == NULL) {
+			return_error (peer, call, "org.freedesktop.DBus.Error.MatchRuleInvalid", "Invalid or unsupported match rule.");
+		} else {
+			g_ptr_array_add (peer->match_rules, rule);
+			return_value (peer, call, NULL);
+		}
+	} else if (IS_METHOD ("RemoveMatch", "(s)")) {
+		const gchar *rule_string;
+		guint i;
+
+		g_variant_get (body, "(&s)", &rule_string);
+
+		for (i = 0; i < peer->match_rules->len; i++) {
+			if (strcmp (((MatchRule*) g_ptr_array_index (peer->match_rules, i))->rule, rule_string) == 0) {
+				break;
+			}
+		}
+
+		if (i < peer->match_rules->len) {
+			g_ptr_array_remove_index (peer->match_rules, i);
+			return_value (peer, call, NULL);
+		} else {
+			return_error (peer, call, "org.freedesktop.DBus.Error.MatchRuleNotFound", "The given match rule wasn't found.");
+		}
+	} else if (IS_METHOD ("GetId", "()")) {
+		return_value (peer, call, g_variant_new ("(s)", core->guid));
+	} else if (IS_METHOD ("GetConnectionUnixProcessID", "(s)") || IS_METHOD ("GetConnectionUnixUser", "(s)")) {
+		const gchar *name;
+
+		g_variant_get (body, "(&s)", &name);
+		handle_get_connection_credentials (core, peer, call, method_name, name);
+	} else {
+		return_error (peer, call, "org.freedesktop.DBus.Error.UnknownMethod", "Unknown or unsupported method, or invalid arguments.");
+	}
+
+	#undef IS_METHOD
+}
+
+/* Called in the GDBus worker thread for every message sent or received on every peer's connection. We consume all incoming messages and route them
+ * ourselves; outgoing messages are ones we're routing, so are passed straight through. */
+static GDBusMessage *
+peer_filter_cb (GDBusConnection *connection, GDBusMessage *message, gboolean incoming, BrokerCore *core)
+{
+	Peer *peer;
+	GDBusMessage *copy;
+	const gchar *destination;
+	GDBusMessageType message_type;
+	GError *error = NULL;
+
+	if (incoming == FALSE) {
+		return message;
+	}
+
+	g_mutex_lock (&core->lock);
+
+	peer = g_hash_table_lookup (core->peers_by_connection, connection);
+
+	if (peer == NULL) {
+		/* The peer's been removed and this is a stray message. */
+		goto done;
+	}
+
+	/* Stamp the message with its sender, as a real bus does, so that peers can't impersonate each other. GDBus locks incoming messages before
+	 * running filters, so this has to be done on an (unlocked) copy, which keeps the original's serial. */
+	copy = g_dbus_message_copy (message, &error);
+
+	if (copy == NULL) {
+		g_debug ("Dropping message from peer ‘%s’ which couldn't be copied: %s", peer->unique_name, error->message);
+		g_error_free (error);
+
+		goto done;
+	}
+
+	g_object_unref (message);
+	message = copy;
+
+	g_dbus_message_set_sender (message, peer->unique_name);
+
+	destination = g_dbus_message_get_destination (message);
+	message_type = g_dbus_message_get_message_type (message);
+
+	if (g_strcmp0 (destination, BUS_NAME) == 0) {
+		if (message_type == G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+			handle_bus_method_call (core, peer, message);
+		}
+	} else if (peer->said_hello == FALSE) {
+		if (message_type == G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+			return_error (peer, message, "org.freedesktop.DBus.Error.AccessDenied",
+			              "Client tried to send a message other than Hello without being registered.");
+		}
+	} else if (destination == NULL) {
+		/* Only signals may be broadcast. */
+		if (message_type == G_DBUS_MESSAGE_TYPE_SIGNAL) {
+			broadcast_signal (core, message, TRUE);
+		} else {
+			g_debug ("Dropping message without a destination from peer ‘%s’.", peer->unique_name);
+		}
+	} else {
+		Peer *recipient = lookup_peer_for_name (core, destination);
+
+		if (recipient != NULL) {
+			send_message (recipient, message, TRUE);
+		} else if (message_type == G_DBUS_MESSAGE_TYPE_METHOD_CALL) {
+			if (g_dbus_is_unique_name (destination) == TRUE) {
+				return_error (peer, message, "org.freedesktop.DBus.Error.NameHasNoOwner", "The destination name has no owner.");
+			} else {
+				return_error (peer, message, "org.freedesktop.DBus.Error.ServiceUnknown", "The destination name was not provided by any peer.");
+			}
+		}
+	}
+
+done:
+	g_mutex_unlock (&core->lock);
+	g_object_unref (message);
+
+	return NULL;
+}
+
+static void
+peer_closed_cb (GDBusConnection *connection, gboolean remote_peer_vanished, GError *error, BrokerCore *core)
+{
+	Peer *peer;
+
+	g_mutex_lock (&core->lock);
+
+	peer = g_hash_table_lookup (core->peers_by_connection, connection);
+
+	if (peer != NULL) {
+		g_debug ("Peer ‘%s’ disconnected from the bus broker.", peer->unique_name);
+		remove_peer (core, peer);
+	}
+
+	g_mutex_unlock (&core->lock);
+}
+
+static void dsim_bus_broker_dispose (GObject *object);
+static void dsim_bus_broker_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void dsim_bus_broker_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+
+struct _DsimBusBrokerPrivate {
+	GFile *working_directory;
+	GDBusServer *server;
+	BrokerCore *core;
+	gulong new_connection_signal;
+};
+
+enum {
+	PROP_WORKING_DIRECTORY = 1,
+	PROP_BUS_ADDRESS,
+};
+
+G_DEFINE_TYPE (DsimBusBroker, dsim_bus_broker, G_TYPE_OBJECT)
+
+static void
+dsim_bus_broker_class_init (DsimBusBrokerClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DsimBusBrokerPrivate));
+
+	gobject_class->get_property = dsim_bus_broker_get_property;
+	gobject_class->set_property = dsim_bus_broker_set_property;
+	gobject_class->dispose = dsim_bus_broker_dispose;
+
+	/**
+	 * DsimBusBroker:working-directory:
+	 *
+	 * Directory to create the bus' listening socket in.
+	 */
+	g_object_class_install_property (gobject_class, PROP_WORKING_DIRECTORY,
+	                                 g_param_spec_object ("working-directory",
+	                                                      "Working directory", "Directory to create the bus' listening socket in.",
+	                                                      G_TYPE_FILE,
+	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * DsimBusBroker:bus-address:
+	 *
+	 * The address clients should use to connect to the bus. It will be an address as
+	 * <ulink type="http" url="http://dbus.freedesktop.org/doc/dbus-specification.html#addresses">described in the D-Bus specification</ulink>.
+	 */
+	g_object_class_install_property (gobject_class, PROP_BUS_ADDRESS,
+	                                 g_param_spec_string ("bus-address",
+	                                                      "Bus address", "The address clients should use to connect to the bus.",
+	                                                      NULL,
+	                                                      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+dsim_bus_broker_init (DsimBusBroker *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DSIM_TYPE_BUS_BROKER, DsimBusBrokerPrivate);
+}
+
+static void
+dsim_bus_broker_dispose (GObject *object)
+{
+	DsimBusBrokerPrivate *priv = DSIM_BUS_BROKER (object)->priv;
+
+	if (priv->server != NULL) {
+		g_signal_handler_disconnect (priv->server, priv->new_connection_signal);
+		g_dbus_server_stop (priv->server);
+		g_clear_object (&priv->server);
+	}
+
+	/* Disconnect all the peers, breaking the reference cycles between the core and their connections' filters. */
+	if (priv->core != NULL) {
+		GHashTableIter iter;
+		Peer *peer;
+
+		g_mutex_lock (&priv->core->lock);
+
+		g_hash_table_iter_init (&iter, priv->core->peers);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &peer) == TRUE) {
+			g_dbus_connection_close (peer->connection, NULL, NULL, NULL);
+		}
+
+		g_hash_table_remove_all (priv->core->peers_by_connection);
+		g_hash_table_remove_all (priv->core->name_owners);
+		g_hash_table_remove_all (priv->core->peers);
+
+		g_mutex_unlock (&priv->core->lock);
+
+		broker_core_unref (priv->core);
+		priv->core = NULL;
+	}
+
+	g_clear_object (&priv->working_directory);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dsim_bus_broker_parent_class)->dispose (object);
+}
+
+static void
+dsim_bus_broker_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+	DsimBusBrokerPrivate *priv = DSIM_BUS_BROKER (object)->priv;
+
+	switch (property_id) {
+		case PROP_WORKING_DIRECTORY:
+			g_value_set_object (value, priv->working_directory);
+			break;
+		case PROP_BUS_ADDRESS:
+			g_value_set_string (value, dsim_bus_broker_get_bus_address (DSIM_BUS_BROKER (object)));
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static void
+dsim_bus_broker_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
+{
+	DsimBusBrokerPrivate *priv = DSIM_BUS_BROKER (object)->priv;
+
+	switch (property_id) {
+		case PROP_WORKING_DIRECTORY:
+			/* Construct-only */
+			priv->working_directory = g_value_dup_object (value);
+			break;
+		case PROP_BUS_ADDRESS:
+			/* Read-only */
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static gboolean
+new_connection_cb (GDBusServer *server, GDBusConnection *connection, DsimBusBroker *self)
+{
+	BrokerCore *core = self->priv->core;
+	Peer *peer;
+
+	g_mutex_lock (&core->lock);
+
+	peer = peer_new (connection, core->next_peer_id++);
+
+	/* The server delays message processing on new connections until after this signal's been handled, so no messages can be missed. */
+	peer->filter_id = g_dbus_connection_add_filter (connection, (GDBusMessageFilterFunction) peer_filter_cb, broker_core_ref (core),
+	                                                (GDestroyNotify) broker_core_unref);
+	peer->closed_signal = g_signal_connect (connection, "closed", (GCallback) peer_closed_cb, core);
+
+	g_hash_table_insert (core->peers, peer->unique_name, peer);
+	g_hash_table_insert (core->peers_by_connection, connection, peer);
+
+	g_debug ("New peer ‘%s’ connected to the bus broker.", peer->unique_name);
+
+	g_mutex_unlock (&core->lock);
+
+	return TRUE;
+}
+
+/**
+ * dsim_bus_broker_new:
+ * @working_directory: directory to create the bus' listening socket in
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Creates a new #DsimBusBroker and starts it listening for connections. Its address is available immediately from
+ * dsim_bus_broker_get_bus_address(). The bus stops when the #DsimBusBroker is destroyed.
+ *
+ * Return value: (transfer full): a new #DsimBusBroker, or %NULL on error
+ */
+DsimBusBroker *
+dsim_bus_broker_new (GFile *working_directory, GError **error)
+{
+	DsimBusBroker *broker;
+	DsimBusBrokerPrivate *priv;
+	gchar *working_directory_path, *escaped_path, *address, *guid;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (working_directory), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	broker = g_object_new (DSIM_TYPE_BUS_BROKER,
+	                       "working-directory", working_directory,
+	                       NULL);
+	priv = broker->priv;
+
+	working_directory_path = g_file_get_path (working_directory);
+	escaped_path = g_dbus_address_escape_value (working_directory_path);
+	address = g_strdup_printf ("unix:tmpdir=%s", escaped_path);
+	g_free (escaped_path);
+	g_free (working_directory_path);
+
+	guid = g_dbus_generate_guid ();
+	priv->core = broker_core_new (guid);
+	priv->server = g_dbus_server_new_sync (address, G_DBUS_SERVER_FLAGS_NONE, guid, NULL, NULL, &child_error);
+
+	g_free (guid);
+	g_free (address);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		g_object_unref (broker);
+
+		return NULL;
+	}
+
+	priv->new_connection_signal = g_signal_connect (priv->server, "new-connection", (GCallback) new_connection_cb, broker);
+	g_dbus_server_start (priv->server);
+
+	g_debug ("Bus broker listening on address: %s", g_dbus_server_get_client_address (priv->server));
+
+	return broker;
+}
+
+/**
+ * dsim_bus_broker_get_bus_address:
+ * @self: a #DsimBusBroker
+ *
+ * Gets the value of the #DsimBusBroker:bus-address property.
+ *
+ * Return value: address clients should use to connect to the bus
+ */
+const gchar *
+dsim_bus_broker_get_bus_address (DsimBusBroker *self)
+{
+	g_return_val_if_fail (DSIM_IS_BUS_BROKER (self), NULL);
+
+	return (self->priv->server != NULL) ? g_dbus_server_get_client_address (self->priv->server) : NULL;
+}
@@ -0,0 +1,55 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#ifndef DSIM_BUS_BROKER_H
+#define DSIM_BUS_BROKER_H
+
+G_BEGIN_DECLS
+
+#define DSIM_TYPE_BUS_BROKER		(dsim_bus_broker_get_type ())
+#define DSIM_BUS_BROKER(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DSIM_TYPE_BUS_BROKER, DsimBusBroker))
+#define DSIM_BUS_BROKER_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), DSIM_TYPE_BUS_BROKER, DsimBusBrokerClass))
+#define DSIM_IS_BUS_BROKER(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), DSIM_TYPE_BUS_BROKER))
+#define DSIM_IS_BUS_BROKER_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), DSIM_TYPE_BUS_BROKER))
+#define DSIM_BUS_BROKER_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), DSIM_TYPE_BUS_BROKER, DsimBusBrokerClass))
+
+typedef struct _DsimBusBrokerPrivate	DsimBusBrokerPrivate;
+
+typedef struct {
+	GObject parent;
+	DsimBusBrokerPrivate *priv;
+} DsimBusBroker;
+
+typedef struct {
+	GObjectClass parent;
+} DsimBusBrokerClass;
+
+GType dsim_bus_broker_get_type (void) G_GNUC_CONST;
+
+DsimBusBroker *dsim_bus_broker_new (GFile *working_directory, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+const gchar *dsim_bus_broker_get_bus_address (DsimBusBroker *self) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DSIM_BUS_BROKER_H */
@@ -0,0 +1,530 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:corpus
+ * @short_description: persistent corpus of interesting test runs
+ *
+ * A #DsimCorpus is a directory of test runs which were interesting (because they found new coverage, crashed the test program or timed out), kept
+ * across invocations of bendy-bus so that long fuzzing campaigns can be resumed.
+ *
+ * Everything random in a test run is driven by the simulation's random number generators, so a test run is saved as its <emphasis>seed
+ * stream</emphasis>: the seed the generators started the test run with, plus any seeds they were re-seeded with part way through the test run.
+ * Re-seeding happens after a given number of transitions rather than after a given time, so that a test run can be reproduced regardless of how
+ * quickly the test program happens to run. Each
+ * entry is a key file named after a hash of its seed stream, with the suffix <literal>.seeds</literal>, containing a single
+ * <literal>[Corpus Entry]</literal> group with the keys:
+ * <variablelist>
+ *  <varlistentry><term><literal>Seeds</literal></term><listitem><para>List of <literal><replaceable>transition</replaceable>:<replaceable>seed
+ *   </replaceable></literal> pairs, with transitions counted from the start of the test run.</para></listitem></varlistentry>
+ *  <varlistentry><term><literal>Length</literal></term><listitem><para>Number of transitions executed in the test run.</para></listitem>
+ *   </varlistentry>
+ *  <varlistentry><term><literal>Reasons</literal></term><listitem><para>List of <literal>coverage</literal>, <literal>crash</literal> and
+ *   <literal>timeout</literal>.</para></listitem></varlistentry>
+ * </variablelist>
+ *
+ * New test runs can be derived from an entry using dsim_corpus_entry_mutate(), which keeps a prefix of the entry's seed stream and re-seeds at a
+ * random point during it, so that the new test run starts off the same way as the entry and then diverges.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "corpus.h"
+
+#define ENTRY_SUFFIX ".seeds"
+#define ENTRY_GROUP "Corpus Entry"
+
+struct _DsimCorpus {
+	GFile *directory;
+	GPtrArray/*<DsimCorpusEntry>*/ *entries; /* in scheduling order */
+	GHashTable/*<string, DsimCorpusEntry>*/ *entries_by_name; /* unowned */
+};
+
+static const struct {
+	DsimCorpusReason reason;
+	const gchar *name;
+} reason_names[] = {
+	{ DSIM_CORPUS_REASON_CRASH, "crash" },
+	{ DSIM_CORPUS_REASON_TIMEOUT, "timeout" },
+	{ DSIM_CORPUS_REASON_COVERAGE, "coverage" },
+};
+
+static void
+corpus_entry_free (DsimCorpusEntry *entry)
+{
+	g_free (entry->name);
+	g_array_unref (entry->seeds);
+	g_slice_free (DsimCorpusEntry, entry);
+}
+
+/* Entries which crashed are scheduled first, then those which timed out, then the rest; ties are broken by name so that the order is stable. */
+static gint
+compare_entries (const DsimCorpusEntry **a, const DsimCorpusEntry **b)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (reason_names); i++) {
+		gboolean a_has_reason = ((*a)->reasons & reason_names[i].reason) != 0;
+		gboolean b_has_reason = ((*b)->reasons & reason_names[i].reason) != 0;
+
+		if (a_has_reason != b_has_reason) {
+			return (a_has_reason == TRUE) ? -1 : 1;
+		}
+	}
+
+	return strcmp ((*a)->name, (*b)->name);
+}
+
+static DsimCorpusEntry *
+load_entry (GFile *file, const gchar *name, GError **error)
+{
+	GKeyFile *key_file;
+	gchar *contents, **seed_strings = NULL, **reason_strings = NULL;
+	gsize length, i, j;
+	DsimCorpusEntry *entry = NULL;
+	GArray/*<DsimCorpusSeed>*/ *seeds;
+	DsimCorpusReason reasons = 0;
+	gint num_transitions;
+	GError *child_error = NULL;
+
+	if (g_file_load_contents (file, NULL, &contents, &length, NULL, error) == FALSE) {
+		return NULL;
+	}
+
+	key_file = g_key_file_new ();
+
+	if (g_key_file_load_from_data (key_file, contents, length, G_KEY_FILE_NONE, error) == FALSE) {
+		goto done;
+	}
+
+	seed_strings = g_key_file_get_string_list (key_file, ENTRY_GROUP, "Seeds", &length, error);
+
+	if (seed_strings == NULL) {
+		goto done;
+	}
+
+	num_transitions = g_key_file_get_integer (key_file, ENTRY_GROUP, "Length", &child_error);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		goto done;
+	} else if (num_transitions < 0) {
+		g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE, _("Length must be non-negative."));
+		goto done;
+	}
+
+	reason_strings = g_key_file_get_string_list (key_file, ENTRY_GROUP, "Reasons", NULL, NULL);
+
+	for (i = 0; reason_strings != NULL && reason_strings[i] != NULL; i++) {
+		for (j = 0; j < G_N_ELEMENTS (reason_names); j++) {
+			if (strcmp (reason_strings[i], reason_names[j].name) == 0) {
+				reasons |= reason_names[j].reason;
+			}
+		}
+	}
+
+	/* Parse the seed stream. Transition counts must be increasing, and the first must be 0. */
+	seeds = g_array_sized_new (FALSE, FALSE, sizeof (DsimCorpusSeed), length);
+
+	for (i = 0; i < length; i++) {
+		DsimCorpusSeed seed;
+		gchar *end;
+		guint64 transition, value = 0;
+
+		transition = g_ascii_strtoull (seed_strings[i], &end, 10);
+
+		if (*end == ':' && end != seed_strings[i]) {
+			value = g_ascii_strtoull (end + 1, &end, 10);
+		} else {
+			end = seed_strings[i];
+		}
+
+		if (*end != '\0' || end == seed_strings[i] || transition > G_MAXUINT32 || value > G_MAXUINT32 ||
+		    (i == 0 && transition != 0) || (i > 0 && transition <= g_array_index (seeds, DsimCorpusSeed, i - 1).transition)) {
+			g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE, _("Invalid seed ‘%s’."), seed_strings[i]);
+			g_array_unref (seeds);
+			goto done;
+		}
+
+		seed.transition = transition;
+		seed.seed = value;
+		g_array_append_val (seeds, seed);
+	}
+
+	if (seeds->len == 0) {
+		g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE, _("Seed stream is empty."));
+		g_array_unref (seeds);
+		goto done;
+	}
+
+	entry = g_slice_new (DsimCorpusEntry);
+	entry->name = g_strdup (name);
+	entry->seeds = seeds;
+	entry->length = num_transitions;
+	entry->reasons = reasons;
+
+done:
+	g_strfreev (reason_strings);
+	g_strfreev (seed_strings);
+	g_key_file_free (key_file);
+	g_free (contents);
+
+	return entry;
+}
+
+static gboolean
+load_entries (DsimCorpus *corpus, GError **error)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GError *child_error = NULL;
+
+	enumerator = g_file_enumerate_children (corpus->directory, G_FILE_ATTRIBUTE_STANDARD_NAME, G_FILE_QUERY_INFO_NONE, NULL, error);
+
+	if (enumerator == NULL) {
+		return FALSE;
+	}
+
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, &child_error)) != NULL) {
+		const gchar *file_name = g_file_info_get_name (info);
+
+		if (g_str_has_suffix (file_name, ENTRY_SUFFIX) == TRUE) {
+			GFile *file;
+			gchar *name;
+			DsimCorpusEntry *entry;
+
+			file = g_file_get_child (corpus->directory, file_name);
+			name = g_strndup (file_name, strlen (file_name) - strlen (ENTRY_SUFFIX));
+			entry = load_entry (file, name, &child_error);
+
+			if (entry != NULL) {
+				g_ptr_array_add (corpus->entries, entry);
+				g_hash_table_insert (corpus->entries_by_name, entry->name, entry);
+			} else {
+				/* Carry on with the rest of the corpus; one bad entry shouldn't lose a whole campaign's progress. */
+				g_message (_("Ignoring invalid corpus entry ‘%s’: %s"), file_name, child_error->message);
+				g_clear_error (&child_error);
+			}
+
+			g_free (name);
+			g_object_unref (file);
+		}
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return FALSE;
+	}
+
+	g_ptr_array_sort (corpus->entries, (GCompareFunc) compare_entries);
+
+	return TRUE;
+}
+
+/**
+ * dsim_corpus_new:
+ * @directory: the corpus directory
+ * @error: a #GError, or %NULL
+ *
+ * Opens the corpus in @directory, creating the directory if it doesn't exist, and loads its entries. Invalid entries are ignored (with a log
+ * message). The loaded entries are ordered so that those which crashed the test program come first, followed by those which timed out, followed by
+ * the rest.
+ *
+ * Return value: (transfer full): a new #DsimCorpus, or %NULL on error; free with dsim_corpus_free()
+ */
+DsimCorpus *
+dsim_corpus_new (GFile *directory, GError **error)
+{
+	DsimCorpus *corpus;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (directory), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (g_file_make_directory_with_parents (directory, NULL, &child_error) == FALSE &&
+	    g_error_matches (child_error, G_IO_ERROR, G_IO_ERROR_EXISTS) == FALSE) {
+		g_propagate_error (error, child_error);
+		return NULL;
+	}
+
+	g_clear_error (&child_error);
+
+	corpus = g_slice_new (DsimCorpus);
+	corpus->directory = g_object_ref (directory);
+	corpus->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) corpus_entry_free);
+	corpus->entries_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+
+	if (load_entries (corpus, error) == FALSE) {
+		dsim_corpus_free (corpus);
+		return NULL;
+	}
+
+	return corpus;
+}
+
+/**
+ * dsim_corpus_free:
+ * @corpus: (transfer full): a #DsimCorpus
+ *
+ * Frees a #DsimCorpus. Its entries stay on disk.
+ */
+void
+dsim_corpus_free (DsimCorpus *corpus)
+{
+	if (corpus == NULL) {
+		return;
+	}
+
+	g_hash_table_unref (corpus->entries_by_name);
+	g_ptr_array_unref (corpus->entries);
+	g_object_unref (corpus->directory);
+	g_slice_free (DsimCorpus, corpus);
+}
+
+/**
+ * dsim_corpus_get_size:
+ * @corpus: a #DsimCorpus
+ *
+ * Gets the number of entries in the corpus, including those added since it was loaded.
+ *
+ * Return value: number of corpus entries
+ */
+guint
+dsim_corpus_get_size (DsimCorpus *corpus)
+{
+	g_return_val_if_fail (corpus != NULL, 0);
+
+	return corpus->entries->len;
+}
+
+/**
+ * dsim_corpus_get_entry:
+ * @corpus: a #DsimCorpus
+ * @index: index of the entry to get
+ *
+ * Gets the entry at @index in the corpus. Entries loaded from disk come first, in the order described in dsim_corpus_new(), followed by those added
+ * using dsim_corpus_add(), in the order they were added.
+ *
+ * Return value: (transfer none): the corpus entry
+ */
+const DsimCorpusEntry *
+dsim_corpus_get_entry (DsimCorpus *corpus, guint index)
+{
+	g_return_val_if_fail (corpus != NULL, NULL);
+	g_return_val_if_fail (index < corpus->entries->len, NULL);
+
+	return g_ptr_array_index (corpus->entries, index);
+}
+
+static gchar **
+build_seed_strings (GArray/*<DsimCorpusSeed>*/ *seeds)
+{
+	gchar **seed_strings;
+	guint i;
+
+	seed_strings = g_new0 (gchar*, seeds->len + 1);
+
+	for (i = 0; i < seeds->len; i++) {
+		const DsimCorpusSeed *seed = &g_array_index (seeds, DsimCorpusSeed, i);
+
+		seed_strings[i] = g_strdup_printf ("%u:%u", seed->transition, seed->seed);
+	}
+
+	return seed_strings;
+}
+
+static gboolean
+save_entry (DsimCorpus *corpus, const DsimCorpusEntry *entry, GError **error)
+{
+	GKeyFile *key_file;
+	gchar **seed_strings, *file_name, *contents;
+	const gchar *reason_strings[G_N_ELEMENTS (reason_names)];
+	gsize length, num_reasons = 0, i;
+	GFile *file;
+	gboolean success;
+
+	key_file = g_key_file_new ();
+
+	seed_strings = build_seed_strings (entry->seeds);
+	g_key_file_set_string_list (key_file, ENTRY_GROUP, "Seeds", (const gchar * const *) seed_strings, entry->seeds->len);
+	g_strfreev (seed_strings);
+
+	g_key_file_set_integer (key_file, ENTRY_GROUP, "Length", entry->length);
+
+	for (i = 0; i < G_N_ELEMENTS (reason_names); i++) {
+		if ((entry->reasons & reason_names[i].reason) != 0) {
+			reason_strings[num_reasons++] = reason_names[i].name;
+		}
+	}
+
+	g_key_file_set_string_list (key_file, ENTRY_GROUP, "Reasons", reason_strings, num_reasons);
+
+	contents = g_key_file_to_data (key_file, &length, NULL);
+	g_key_file_free (key_file);
+
+	file_name = g_strconcat (entry->name, ENTRY_SUFFIX, NULL);
+	file = g_file_get_child (corpus->directory, file_name);
+	g_free (file_name);
+
+	success = g_file_replace_contents (file, contents, length, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, error);
+
+	g_object_unref (file);
+	g_free (contents);
+
+	return success;
+}
+
+/**
+ * dsim_corpus_add:
+ * @corpus: a #DsimCorpus
+ * @seeds: (element-type DsimCorpusSeed): the test run's seed stream
+ * @length: number of transitions executed in the test run so far
+ * @reason: the reason to save the test run
+ * @error: a #GError, or %NULL
+ *
+ * Adds a test run to the corpus and saves it to disk. If a test run with the same seed stream is already in the corpus, @reason is added to its
+ * reasons instead.
+ *
+ * Return value: (transfer none): the new or updated corpus entry, or %NULL on error
+ */
+const DsimCorpusEntry *
+dsim_corpus_add (DsimCorpus *corpus, GArray/*<DsimCorpusSeed>*/ *seeds, guint length, DsimCorpusReason reason, GError **error)
+{
+	DsimCorpusEntry *entry;
+	gchar *name;
+
+	g_return_val_if_fail (corpus != NULL, NULL);
+	g_return_val_if_fail (seeds != NULL && seeds->len > 0, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* Name the entry after its seed stream, so the same test run saved twice (e.g. by two campaigns sharing a corpus) is only stored once. */
+	name = g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *) seeds->data, seeds->len * sizeof (DsimCorpusSeed));
+	name[16] = '\0';
+
+	entry = g_hash_table_lookup (corpus->entries_by_name, name);
+
+	if (entry != NULL) {
+		g_free (name);
+
+		if ((entry->reasons & reason) == reason) {
+			return entry;
+		}
+
+		entry->reasons |= reason;
+		entry->length = MAX (entry->length, length);
+	} else {
+		entry = g_slice_new (DsimCorpusEntry);
+		entry->name = name; /* transfer ownership */
+		entry->seeds = g_array_sized_new (FALSE, FALSE, sizeof (DsimCorpusSeed), seeds->len);
+		g_array_append_vals (entry->seeds, seeds->data, seeds->len);
+		entry->length = length;
+		entry->reasons = reason;
+
+		g_ptr_array_add (corpus->entries, entry);
+		g_hash_table_insert (corpus->entries_by_name, entry->name, entry);
+	}
+
+	if (save_entry (corpus, entry, error) == FALSE) {
+		return NULL;
+	}
+
+	return entry;
+}
+
+/**
+ * dsim_corpus_entry_mutate:
+ * @entry: a corpus entry to mutate
+ * @rand: random number generator to mutate with
+ *
+ * Derives a new seed stream from @entry's by choosing a random point during the entry's test run, keeping the part of the seed stream before that
+ * point, and re-seeding with a new random seed at that point. A test run using the new seed stream will start off the same way as @entry's did,
+ * then diverge.
+ *
+ * @rand should be separate from the simulation's random number generators, since those are re-seeded by the seed streams.
+ *
+ * Return value: (transfer full) (element-type DsimCorpusSeed): the new seed stream
+ */
+GArray/*<DsimCorpusSeed>*/ *
+dsim_corpus_entry_mutate (const DsimCorpusEntry *entry, GRand *rand)
+{
+	GArray/*<DsimCorpusSeed>*/ *seeds;
+	DsimCorpusSeed new_seed;
+	guint32 divergence_point;
+	guint i;
+
+	g_return_val_if_fail (entry != NULL, NULL);
+	g_return_val_if_fail (rand != NULL, NULL);
+
+	/* Never diverge at 0, since that would just be a fresh seed stream. */
+	divergence_point = (entry->length > 1) ? (guint32) g_rand_int_range (rand, 1, MIN (entry->length, G_MAXINT32)) : 1;
+
+	seeds = g_array_new (FALSE, FALSE, sizeof (DsimCorpusSeed));
+
+	for (i = 0; i < entry->seeds->len; i++) {
+		const DsimCorpusSeed *seed = &g_array_index (entry->seeds, DsimCorpusSeed, i);
+
+		if (seed->transition >= divergence_point) {
+			break;
+		}
+
+		g_array_append_vals (seeds, seed, 1);
+	}
+
+	new_seed.transition = divergence_point;
+	new_seed.seed = g_rand_int (rand);
+	g_array_append_val (seeds, new_seed);
+
+	return seeds;
+}
+
+/**
+ * dsim_corpus_reasons_to_string:
+ * @reasons: reasons a test run was saved to the corpus
+ *
+ * Builds a human-readable, comma-separated list of @reasons, for logging.
+ *
+ * Return value: (transfer full): list of reasons; free with g_free()
+ */
+gchar *
+dsim_corpus_reasons_to_string (DsimCorpusReason reasons)
+{
+	GString *str;
+	guint i;
+
+	str = g_string_new (NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (reason_names); i++) {
+		if ((reasons & reason_names[i].reason) != 0) {
+			if (str->len > 0) {
+				g_string_append (str, ", ");
+			}
+
+			g_string_append (str, reason_names[i].name);
+		}
+	}
+
+	return g_string_free (str, FALSE);
+}
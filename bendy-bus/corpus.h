@@ -0,0 +1,87 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#ifndef DSIM_CORPUS_H
+#define DSIM_CORPUS_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimCorpusSeed:
+ * @transition: number of transitions executed since the start of the test run at which to apply the seed
+ * @seed: seed for the simulation’s random number generators
+ *
+ * One element of a seed stream: the simulation's random number generators are re-seeded with @seed once @transition transitions have been executed
+ * in the test run. The first element of a stream always has a @transition of 0.
+ */
+typedef struct {
+	guint32 transition;
+	guint32 seed;
+} DsimCorpusSeed;
+
+/**
+ * DsimCorpusReason:
+ * @DSIM_CORPUS_REASON_COVERAGE: the test run found new coverage in the test program
+ * @DSIM_CORPUS_REASON_CRASH: the test program crashed
+ * @DSIM_CORPUS_REASON_TIMEOUT: the test run hit the inactivity timeout
+ *
+ * Reasons a test run was saved to the corpus.
+ */
+typedef enum {
+	DSIM_CORPUS_REASON_COVERAGE = 1 << 0,
+	DSIM_CORPUS_REASON_CRASH = 1 << 1,
+	DSIM_CORPUS_REASON_TIMEOUT = 1 << 2,
+} DsimCorpusReason;
+
+/**
+ * DsimCorpusEntry:
+ * @name: name of the entry's file in the corpus directory
+ * @seeds: (element-type DsimCorpusSeed): the test run's seed stream
+ * @length: number of transitions executed in the test run up to the point it was saved
+ * @reasons: reasons the test run was saved
+ *
+ * A test run saved in a #DsimCorpus.
+ */
+typedef struct {
+	gchar *name;
+	GArray/*<DsimCorpusSeed>*/ *seeds;
+	guint length;
+	DsimCorpusReason reasons;
+} DsimCorpusEntry;
+
+typedef struct _DsimCorpus DsimCorpus;
+
+DsimCorpus *dsim_corpus_new (GFile *directory, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dsim_corpus_free (DsimCorpus *corpus);
+
+guint dsim_corpus_get_size (DsimCorpus *corpus) G_GNUC_PURE;
+const DsimCorpusEntry *dsim_corpus_get_entry (DsimCorpus *corpus, guint index) G_GNUC_PURE;
+
+const DsimCorpusEntry *dsim_corpus_add (DsimCorpus *corpus, GArray/*<DsimCorpusSeed>*/ *seeds, guint length, DsimCorpusReason reason,
+                                        GError **error);
+
+GArray/*<DsimCorpusSeed>*/ *dsim_corpus_entry_mutate (const DsimCorpusEntry *entry, GRand *rand) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+gchar *dsim_corpus_reasons_to_string (DsimCorpusReason reasons) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_END_DECLS
+
+#endif /* !DSIM_CORPUS_H */
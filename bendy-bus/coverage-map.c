@@ -0,0 +1,228 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:coverage-map
+ * @short_description: shared memory edge coverage map
+ *
+ * A #DsimCoverageMap is a shared memory segment of #DSIM_COVERAGE_MAP_SIZE 8-bit edge hit counters, which a test program built with
+ * <code class="literal">-fsanitize-coverage=trace-pc-guard</code> and linked against <filename>libbendy-bus-coverage</filename> increments as it
+ * runs. The segment's ID is passed to the test program in the #DSIM_COVERAGE_MAP_ENVIRONMENT_VARIABLE environment variable.
+ *
+ * Each call to dsim_coverage_map_update() folds the counters accumulated since the previous call into a map of the hit count buckets seen so far
+ * (the same power-of-two buckets AFL uses), and clears them. The number of newly-seen buckets is used as a reward for the simulation transitions
+ * which were executed in the meantime.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+
+#include "coverage-map.h"
+
+struct _DsimCoverageMap {
+	gint shm_id;
+	guint8 *trace_bits; /* shared with the test program; DSIM_COVERAGE_MAP_SIZE entries */
+	guint8 *seen_buckets; /* bitmask of hit count buckets seen for each edge; DSIM_COVERAGE_MAP_SIZE entries */
+	guint num_edges; /* number of edges with a non-zero entry in seen_buckets */
+};
+
+/**
+ * dsim_coverage_map_new:
+ * @error: a #GError, or %NULL
+ *
+ * Creates a new #DsimCoverageMap, allocating a private shared memory segment for it. The segment is marked for deletion as soon as it's attached, so
+ * it won't outlive bendy-bus, even if bendy-bus crashes.
+ *
+ * Return value: (transfer full): a new #DsimCoverageMap, or %NULL on error; free with dsim_coverage_map_free()
+ */
+DsimCoverageMap *
+dsim_coverage_map_new (GError **error)
+{
+	DsimCoverageMap *map;
+	gint shm_id, errsv;
+	gpointer trace_bits;
+
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	shm_id = shmget (IPC_PRIVATE, DSIM_COVERAGE_MAP_SIZE, IPC_CREAT | IPC_EXCL | 0600);
+
+	if (shm_id < 0) {
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv), _("Error allocating coverage map: %s"), g_strerror (errsv));
+		return NULL;
+	}
+
+	trace_bits = shmat (shm_id, NULL, 0);
+	errsv = errno;
+
+	/* Segments marked for removal stay alive until the last process detaches from them, and Linux still allows new attachments to them. We stay
+	 * attached until we're freed, so each test program can attach in turn. */
+	shmctl (shm_id, IPC_RMID, NULL);
+
+	if (trace_bits == (gpointer) -1) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv), _("Error attaching coverage map: %s"), g_strerror (errsv));
+		return NULL;
+	}
+
+	map = g_slice_new (DsimCoverageMap);
+	map->shm_id = shm_id;
+	map->trace_bits = trace_bits;
+	map->seen_buckets = g_malloc0 (DSIM_COVERAGE_MAP_SIZE);
+	map->num_edges = 0;
+
+	memset (map->trace_bits, 0, DSIM_COVERAGE_MAP_SIZE);
+
+	return map;
+}
+
+/**
+ * dsim_coverage_map_free:
+ * @map: (transfer full): a #DsimCoverageMap
+ *
+ * Frees a #DsimCoverageMap and detaches from its shared memory segment.
+ */
+void
+dsim_coverage_map_free (DsimCoverageMap *map)
+{
+	if (map == NULL) {
+		return;
+	}
+
+	shmdt (map->trace_bits);
+	g_free (map->seen_buckets);
+	g_slice_free (DsimCoverageMap, map);
+}
+
+/**
+ * dsim_coverage_map_build_envp_pair:
+ * @map: a #DsimCoverageMap
+ *
+ * Builds a <literal>KEY=VALUE</literal> environment variable pair which tells a test program linked against
+ * <filename>libbendy-bus-coverage</filename> where to record its coverage.
+ *
+ * Return value: (transfer full): environment variable pair; free with g_free()
+ */
+gchar *
+dsim_coverage_map_build_envp_pair (DsimCoverageMap *map)
+{
+	g_return_val_if_fail (map != NULL, NULL);
+
+	return g_strdup_printf (DSIM_COVERAGE_MAP_ENVIRONMENT_VARIABLE "=%i", map->shm_id);
+}
+
+/**
+ * dsim_coverage_map_clear:
+ * @map: a #DsimCoverageMap
+ *
+ * Discards any hit counters accumulated since the last call to dsim_coverage_map_update(), e.g. before a new test run starts. The set of hit count
+ * buckets seen so far is kept.
+ */
+void
+dsim_coverage_map_clear (DsimCoverageMap *map)
+{
+	g_return_if_fail (map != NULL);
+
+	memset (map->trace_bits, 0, DSIM_COVERAGE_MAP_SIZE);
+}
+
+/* Classify a hit count into one of 8 power-of-two buckets, returned as a single bit. */
+static guint8
+classify_hit_count (guint8 count)
+{
+	if (count == 0) {
+		return 0;
+	} else if (count <= 3) {
+		return 1 << (count - 1); /* 1, 2, 3 */
+	} else if (count <= 7) {
+		return 1 << 3;
+	} else if (count <= 15) {
+		return 1 << 4;
+	} else if (count <= 31) {
+		return 1 << 5;
+	} else if (count <= 127) {
+		return 1 << 6;
+	}
+
+	return 1 << 7;
+}
+
+/**
+ * dsim_coverage_map_update:
+ * @map: a #DsimCoverageMap
+ *
+ * Folds the hit counters accumulated by the test program since the last call into the set of hit count buckets seen so far, then clears the counters.
+ * The test program may be updating the counters concurrently, so a few hits may be lost; this is harmless.
+ *
+ * Return value: number of edges which hit a previously-unseen bucket
+ */
+guint
+dsim_coverage_map_update (DsimCoverageMap *map)
+{
+	const guint64 *words;
+	guint i, new_entries = 0;
+
+	g_return_val_if_fail (map != NULL, 0);
+
+	words = (const guint64 *) map->trace_bits;
+
+	for (i = 0; i < DSIM_COVERAGE_MAP_SIZE; i++) {
+		guint8 bucket;
+
+		/* The map is usually sparse, so skip over untouched regions a word at a time. */
+		if (i % sizeof (guint64) == 0 && words[i / sizeof (guint64)] == 0) {
+			i += sizeof (guint64) - 1;
+			continue;
+		}
+
+		bucket = classify_hit_count (map->trace_bits[i]);
+		map->trace_bits[i] = 0;
+
+		if ((bucket & ~map->seen_buckets[i]) != 0) {
+			if (map->seen_buckets[i] == 0) {
+				map->num_edges++;
+			}
+
+			map->seen_buckets[i] |= bucket;
+			new_entries++;
+		}
+	}
+
+	return new_entries;
+}
+
+/**
+ * dsim_coverage_map_get_num_edges:
+ * @map: a #DsimCoverageMap
+ *
+ * Gets the number of distinct edges (modulo hash collisions) the test program has covered across all updates so far.
+ *
+ * Return value: number of covered edges
+ */
+guint
+dsim_coverage_map_get_num_edges (DsimCoverageMap *map)
+{
+	g_return_val_if_fail (map != NULL, 0);
+
+	return map->num_edges;
+}
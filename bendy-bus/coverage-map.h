@@ -0,0 +1,54 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#ifndef DSIM_COVERAGE_MAP_H
+#define DSIM_COVERAGE_MAP_H
+
+G_BEGIN_DECLS
+
+/**
+ * DSIM_COVERAGE_MAP_SIZE:
+ *
+ * Number of edge counters in a coverage map. This must match <literal>MAP_SIZE</literal> in <filename>coverage-runtime.c</filename>.
+ */
+#define DSIM_COVERAGE_MAP_SIZE (1 << 16)
+
+/**
+ * DSIM_COVERAGE_MAP_ENVIRONMENT_VARIABLE:
+ *
+ * Name of the environment variable which passes the ID of the coverage map's shared memory segment to the test program.
+ */
+#define DSIM_COVERAGE_MAP_ENVIRONMENT_VARIABLE "BENDY_BUS_COVERAGE_SHM_ID"
+
+typedef struct _DsimCoverageMap DsimCoverageMap;
+
+DsimCoverageMap *dsim_coverage_map_new (GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dsim_coverage_map_free (DsimCoverageMap *map);
+
+gchar *dsim_coverage_map_build_envp_pair (DsimCoverageMap *map) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+void dsim_coverage_map_clear (DsimCoverageMap *map);
+guint dsim_coverage_map_update (DsimCoverageMap *map);
+guint dsim_coverage_map_get_num_edges (DsimCoverageMap *map) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DSIM_COVERAGE_MAP_H */
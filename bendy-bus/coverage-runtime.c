@@ -0,0 +1,102 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Coverage runtime for test programs, for use with bendy-bus' --coverage-guided option. Build the test program with
+ * -fsanitize-coverage=trace-pc-guard and link it against libbendy-bus-coverage. When run under bendy-bus, every edge the program executes increments
+ * a counter in bendy-bus' shared memory coverage map; when run outside bendy-bus, the counters go to a private dummy map.
+ *
+ * This deliberately doesn't use GLib: it's linked into arbitrary test programs, and its callbacks may be called before their constructors have run.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/shm.h>
+
+/* These must match DSIM_COVERAGE_MAP_SIZE and DSIM_COVERAGE_MAP_ENVIRONMENT_VARIABLE in coverage-map.h. */
+#define MAP_SIZE (1 << 16)
+#define ENVIRONMENT_VARIABLE "BENDY_BUS_COVERAGE_SHM_ID"
+
+static uint8_t dummy_map[MAP_SIZE];
+static uint8_t *coverage_map = dummy_map;
+static __thread uint32_t previous_location = 0;
+
+static void
+attach_coverage_map (void)
+{
+	static int attached = 0;
+	const char *shm_id_string;
+	void *map;
+
+	if (attached != 0) {
+		return;
+	}
+
+	attached = 1;
+	shm_id_string = getenv (ENVIRONMENT_VARIABLE);
+
+	if (shm_id_string == NULL) {
+		return;
+	}
+
+	map = shmat (atoi (shm_id_string), NULL, 0);
+
+	if (map != (void *) -1) {
+		coverage_map = map;
+	}
+}
+
+/* Called once per instrumented module (e.g. the program and each instrumented shared library) before any of its code runs. Assign each guard a
+ * random, non-zero location in the map so that edges (pairs of locations) hash evenly; SanitizerCoverage reserves zero to mean “disabled”. */
+void
+__sanitizer_cov_trace_pc_guard_init (uint32_t *start, uint32_t *stop)
+{
+	static uint32_t seed = 0x9e3779b9;
+	uint32_t *guard;
+
+	if (start == stop || *start != 0) {
+		return;
+	}
+
+	attach_coverage_map ();
+
+	for (guard = start; guard < stop; guard++) {
+		/* xorshift32 */
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+
+		*guard = seed % (MAP_SIZE - 1) + 1;
+	}
+}
+
+/* Called on every instrumented edge. As in AFL, the map entry is indexed by the current location XORed with the (shifted) previous location, so
+ * that A → B and B → A are distinguished. */
+void
+__sanitizer_cov_trace_pc_guard (uint32_t *guard)
+{
+	uint32_t location = *guard;
+
+	if (location == 0) {
+		return;
+	}
+
+	coverage_map[(location ^ previous_location) % MAP_SIZE]++;
+	previous_location = location >> 1;
+}
@@ -0,0 +1,496 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "crash-report.h"
+
+/* Maximum number of stack frames to include in a crash signature. Fewer frames means more crashes are considered duplicates of each other. */
+#define SIGNATURE_FRAMES 5
+
+/* Prefixes of the reserved names of functions in the sanitiser runtimes and the C library, which are part of the crash reporting machinery rather
+ * than the crash itself, so are skipped when building signatures. */
+static const gchar *ignored_function_prefixes[] = {
+	"__sanitizer",
+	"__asan",
+	"__ubsan",
+	"__tsan",
+	"__msan",
+	"__lsan",
+	"__interceptor",
+	"__GI_",
+	"__libc_",
+	"__pthread_kill",
+};
+
+/* Names of other functions which are skipped when building signatures. These are matched exactly, so that functions in the program under test
+ * which happen to share a prefix with them (e.g. “raise_volume”) are kept. */
+static const gchar *ignored_function_names[] = {
+	"raise",
+	"gsignal",
+	"abort",
+	"pthread_kill",
+	"g_assertion_message",
+	"g_assertion_message_expr",
+	"g_assertion_message_cmpnum",
+	"g_assertion_message_cmpstr",
+	"g_assertion_message_error",
+	"g_log",
+	"g_logv",
+	"g_log_default_handler",
+	"g_log_structured",
+	"g_log_structured_standard",
+	"g_log_writer_default",
+	"_g_log_abort",
+};
+
+/**
+ * dsim_crash_report_new:
+ * @signature: stack signature of the crash
+ * @status: wait status of the crashed test program
+ * @random_seed: seed of the simulation’s random number generator
+ * @iteration: (1-based) number of the test run which crashed
+ * @history: (element-type utf8) (allow-none): descriptions of the last few D-Bus conversation records before the crash, or %NULL
+ *
+ * Creates a new #DsimCrashReport for the first occurrence of a crash, with a hit count of 1.
+ *
+ * Return value: (transfer full): a new #DsimCrashReport; free with dsim_crash_report_free()
+ */
+DsimCrashReport *
+dsim_crash_report_new (const gchar *signature, gint status, gint64 random_seed, guint iteration, GPtrArray/*<string>*/ *history)
+{
+	DsimCrashReport *report;
+
+	g_return_val_if_fail (signature != NULL, NULL);
+
+	report = g_slice_new (DsimCrashReport);
+	report->signature = g_strdup (signature);
+	report->status = status;
+	report->random_seed = random_seed;
+	report->first_iteration = iteration;
+	report->last_iteration = iteration;
+	report->hit_count = 1;
+	report->history = (history != NULL) ? g_ptr_array_ref (history) : g_ptr_array_new_with_free_func (g_free);
+
+	return report;
+}
+
+/**
+ * dsim_crash_report_free:
+ * @report: (transfer full): a #DsimCrashReport
+ *
+ * Frees a #DsimCrashReport.
+ */
+void
+dsim_crash_report_free (DsimCrashReport *report)
+{
+	if (report == NULL) {
+		return;
+	}
+
+	g_ptr_array_unref (report->history);
+	g_free (report->signature);
+
+	g_slice_free (DsimCrashReport, report);
+}
+
+static gboolean
+is_ignored_function (const gchar *function_name)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (ignored_function_prefixes); i++) {
+		if (g_str_has_prefix (function_name, ignored_function_prefixes[i]) == TRUE) {
+			return TRUE;
+		}
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (ignored_function_names); i++) {
+		if (strcmp (function_name, ignored_function_names[i]) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Parse a single stack frame line as output by the sanitisers (“#0 0x4f1b2c in func /path/file.c:12:3” or “#0 0x4f1b2c (/lib/libfoo.so+0x1234)”)
+ * or gdb (“#0  0x00007f12 in func (args) at file.c:12” or “#1  func (args) at file.c:12”). Returns the frame number and the function name (or
+ * module and offset, if the function's unknown); or -1 if the line isn't a stack frame. */
+static gint
+parse_stack_frame (const gchar *line, gchar **function_name)
+{
+	gchar **tokens;
+	gint64 frame_number;
+	gchar *end;
+	guint i;
+
+	*function_name = NULL;
+
+	while (g_ascii_isspace (*line)) {
+		line++;
+	}
+
+	if (*line != '#' || g_ascii_isdigit (line[1]) == FALSE) {
+		return -1;
+	}
+
+	frame_number = g_ascii_strtoll (line + 1, &end, 10);
+
+	if (g_ascii_isspace (*end) == FALSE) {
+		return -1;
+	}
+
+	tokens = g_strsplit_set (end, " \t", -1);
+
+	for (i = 0; tokens[i] != NULL; i++) {
+		/* Skip empty tokens, the address and “in”. */
+		if (*tokens[i] == '\0' || g_str_has_prefix (tokens[i], "0x") == TRUE || strcmp (tokens[i], "in") == 0) {
+			continue;
+		}
+
+		/* Unknown function: use the module and offset instead. */
+		if (*tokens[i] == '(' && strchr (tokens[i], '+') != NULL) {
+			*function_name = g_strndup (tokens[i] + 1, strcspn (tokens[i] + 1, ")"));
+		} else if (*tokens[i] != '(') {
+			*function_name = g_strndup (tokens[i], strcspn (tokens[i], "("));
+		}
+
+		break;
+	}
+
+	g_strfreev (tokens);
+
+	if (*function_name == NULL || **function_name == '\0' || strcmp (*function_name, "??") == 0) {
+		g_free (*function_name);
+		*function_name = NULL;
+		return -1;
+	}
+
+	return (gint) frame_number;
+}
+
+/* Extract the top frames of the first stack trace in the given lines into frames, skipping any frames in the crash reporting machinery. */
+static void
+parse_stack_frames (const gchar * const *lines, GPtrArray/*<string>*/ *frames)
+{
+	const gchar * const *line;
+
+	for (line = lines; *line != NULL && frames->len < SIGNATURE_FRAMES; line++) {
+		gchar *function_name;
+		gint frame_number;
+
+		frame_number = parse_stack_frame (*line, &function_name);
+
+		if (frame_number < 0) {
+			continue;
+		} else if (frame_number == 0 && frames->len > 0) {
+			/* Start of a second stack trace (e.g. where the memory was freed, for a use-after-free). Only the first is interesting. */
+			g_free (function_name);
+			break;
+		}
+
+		if (is_ignored_function (function_name) == TRUE) {
+			g_free (function_name);
+			continue;
+		}
+
+		g_ptr_array_add (frames, function_name);
+	}
+}
+
+/* Find the kind of error reported by a sanitiser (e.g. “heap-use-after-free” from “ERROR: AddressSanitizer: heap-use-after-free on address …”,
+ * or from the report's “SUMMARY: …” line if the start of a long report has scrolled out of the tail), or the location of a failed GLib assertion
+ * or UBSan runtime error. Returns NULL if none was found. */
+static gchar *
+parse_error_kind (const gchar * const *lines)
+{
+	const gchar * const *line;
+
+	for (line = lines; *line != NULL; line++) {
+		const gchar *sanitizer, *runtime_error, *assertion;
+
+		sanitizer = strstr (*line, "Sanitizer: ");
+		runtime_error = strstr (*line, ": runtime error:");
+		assertion = g_str_has_prefix (*line, "ERROR:") ? *line + strlen ("ERROR:") : strstr (*line, ":ERROR:");
+
+		if (sanitizer != NULL && (strstr (*line, "ERROR: ") != NULL || strstr (*line, "WARNING: ") != NULL ||
+		                          g_str_has_prefix (*line, "SUMMARY: ") == TRUE)) {
+			const gchar *kind = sanitizer + strlen ("Sanitizer: ");
+
+			return g_strndup (kind, strcspn (kind, " "));
+		} else if (runtime_error != NULL) {
+			/* “file.c:12:3: runtime error: …” */
+			return g_strdup_printf ("runtime-error@%.*s", (gint) (runtime_error - *line), *line);
+		} else if (assertion != NULL) {
+			gchar **parts;
+			gchar *kind = NULL;
+
+			/* “ERROR:file.c:12:func: assertion failed: …” or “GLib:ERROR:file.c:12:func: …” */
+			if (*assertion == ':') {
+				assertion += strlen (":ERROR:");
+			}
+
+			parts = g_strsplit (assertion, ":", 4);
+
+			if (g_strv_length (parts) >= 3) {
+				kind = g_strdup_printf ("assertion@%s:%s:%s", parts[0], parts[1], parts[2]);
+			}
+
+			g_strfreev (parts);
+
+			if (kind != NULL) {
+				return kind;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* Find the test program's core dump, if it dumped one, and make sure its name includes the PID, so that it isn't mistaken for the core of a later
+ * crash. Depending on the kernel's core_pattern, the core may or may not have the PID appended already. Returns NULL if there's no core. */
+static GFile *
+claim_core_file (GFile *working_directory, GPid pid)
+{
+	GFile *core_file, *renamed_core_file;
+	gchar *core_filename;
+
+	core_filename = g_strdup_printf ("core.%i", (gint) pid);
+	renamed_core_file = g_file_get_child (working_directory, core_filename);
+	g_free (core_filename);
+
+	if (g_file_query_exists (renamed_core_file, NULL) == TRUE) {
+		return renamed_core_file;
+	}
+
+	/* Move the core out of the way. This fails if there's no core. */
+	core_file = g_file_get_child (working_directory, "core");
+
+	if (g_file_move (core_file, renamed_core_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, NULL) == FALSE) {
+		g_clear_object (&renamed_core_file);
+	}
+
+	g_object_unref (core_file);
+
+	return renamed_core_file;
+}
+
+/* Get a backtrace from the given core dump of the test program using gdb. This blocks until gdb exits, so must only be called in a worker thread.
+ * Returns NULL if gdb isn't available. */
+static gchar **
+dup_core_backtrace (GFile *core_file, const gchar *program_name)
+{
+	gchar *core_path, *program_path, *gdb_output = NULL;
+	gchar **lines = NULL;
+	gint exit_status;
+	const gchar *argv[] = { "gdb", "--batch", "--nx", "-ex", "bt", NULL /* program */, NULL /* core */, NULL };
+
+	core_path = g_file_get_path (core_file);
+	program_path = g_find_program_in_path (program_name);
+
+	if (core_path != NULL && program_path != NULL) {
+		argv[5] = program_path;
+		argv[6] = core_path;
+
+		if (g_spawn_sync (NULL, (gchar **) argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &gdb_output, NULL,
+		                  &exit_status, NULL) == TRUE) {
+			lines = g_strsplit (gdb_output, "\n", -1);
+		}
+	}
+
+	g_free (gdb_output);
+	g_free (program_path);
+	g_free (core_path);
+
+	return lines;
+}
+
+static gchar *
+build_signature (gint status, const gchar * const *stderr_lines, GFile *core_file, const gchar *program_name)
+{
+	GPtrArray/*<string>*/ *frames;
+	GString *signature;
+	gchar *error_kind;
+	guint i;
+
+	frames = g_ptr_array_new_with_free_func (g_free);
+
+	parse_stack_frames (stderr_lines, frames);
+	error_kind = parse_error_kind (stderr_lines);
+
+	/* Fall back to the core dump. */
+	if (frames->len == 0 && core_file != NULL) {
+		gchar **core_lines = dup_core_backtrace (core_file, program_name);
+
+		if (core_lines != NULL) {
+			parse_stack_frames ((const gchar * const *) core_lines, frames);
+			g_strfreev (core_lines);
+		}
+	}
+
+	/* Build the signature. */
+	signature = g_string_new (NULL);
+
+	if (WIFSIGNALED (status)) {
+		g_string_append_printf (signature, "signal %i", WTERMSIG (status));
+	} else {
+		g_string_append_printf (signature, "status %i", status);
+	}
+
+	if (error_kind != NULL) {
+		g_string_append_printf (signature, ": %s", error_kind);
+	}
+
+	for (i = 0; i < frames->len; i++) {
+		g_string_append (signature, (i == 0) ? ": " : " ← ");
+		g_string_append (signature, g_ptr_array_index (frames, i));
+	}
+
+	g_free (error_kind);
+	g_ptr_array_unref (frames);
+
+	return g_string_free (signature, FALSE);
+}
+
+typedef struct {
+	gint status;
+	gchar **stderr_lines;
+	GFile *core_file; /* NULL if the test program didn't dump core */
+	gchar *program_name;
+	gchar *signature; /* NULL until it's been built */
+} BuildSignatureData;
+
+static void
+build_signature_data_free (BuildSignatureData *data)
+{
+	g_free (data->signature);
+	g_free (data->program_name);
+	g_clear_object (&data->core_file);
+	g_strfreev (data->stderr_lines);
+
+	g_slice_free (BuildSignatureData, data);
+}
+
+static void
+build_signature_thread_cb (GSimpleAsyncResult *async_result, GObject *source_object, GCancellable *cancellable)
+{
+	BuildSignatureData *data;
+
+	data = g_simple_async_result_get_op_res_gpointer (async_result);
+	data->signature = build_signature (data->status, (const gchar * const *) data->stderr_lines, data->core_file, data->program_name);
+}
+
+/**
+ * dsim_crash_build_signature_async:
+ * @status: wait status of the crashed test program
+ * @stderr_lines: the last few lines of the test program’s stderr output
+ * @working_directory: working directory of the test program, where it may have dumped core
+ * @program_name: name or path of the test program
+ * @pid: process ID of the crashed test program
+ * @callback: callback to call once the signature has been built
+ * @user_data: (allow-none): data to pass to @callback
+ *
+ * Builds a signature which identifies the cause of a crash of the test program, so that crashes can be de-duplicated. The signature consists of the
+ * signal which killed the program (or its exit status), the kind of error reported by a sanitiser or failed assertion (if any), and the names of the
+ * top few functions on the crashed stack. The stack is taken from sanitiser output in @stderr_lines if possible; otherwise from the program’s core
+ * dump (using gdb) if there is one. If no stack can be found, the signature only identifies the signal.
+ *
+ * Any core dump is renamed to include @pid before this returns, so another test program may be spawned straight away. gdb is run in a worker thread,
+ * so it doesn't block the main loop.
+ */
+void
+dsim_crash_build_signature_async (gint status, const gchar * const *stderr_lines, GFile *working_directory, const gchar *program_name, GPid pid,
+                                  GAsyncReadyCallback callback, gpointer user_data)
+{
+	GSimpleAsyncResult *async_result;
+	BuildSignatureData *data;
+
+	g_return_if_fail (stderr_lines != NULL);
+	g_return_if_fail (G_IS_FILE (working_directory));
+	g_return_if_fail (program_name != NULL);
+
+	data = g_slice_new (BuildSignatureData);
+	data->status = status;
+	data->stderr_lines = g_strdupv ((gchar **) stderr_lines);
+	data->core_file = claim_core_file (working_directory, pid);
+	data->program_name = g_strdup (program_name);
+	data->signature = NULL;
+
+	async_result = g_simple_async_result_new (NULL, callback, user_data, dsim_crash_build_signature_async);
+	g_simple_async_result_set_op_res_gpointer (async_result, data, (GDestroyNotify) build_signature_data_free);
+	g_simple_async_result_run_in_thread (async_result, (GSimpleAsyncThreadFunc) build_signature_thread_cb, G_PRIORITY_DEFAULT, NULL);
+	g_object_unref (async_result);
+}
+
+/**
+ * dsim_crash_build_signature_finish:
+ * @async_result: result from the asynchronous callback
+ *
+ * Finishes building a crash signature started by dsim_crash_build_signature_async().
+ *
+ * Return value: (transfer full): the crash signature
+ */
+gchar *
+dsim_crash_build_signature_finish (GAsyncResult *async_result)
+{
+	BuildSignatureData *data;
+	gchar *signature;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (async_result, NULL, dsim_crash_build_signature_async), NULL);
+
+	data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (async_result));
+
+	/* Steal the signature. */
+	signature = data->signature;
+	data->signature = NULL;
+
+	return signature;
+}
+
+/**
+ * dsim_crash_has_sanitizer_report:
+ * @stderr_lines: the last few lines of the test program’s stderr output
+ *
+ * Checks whether a sanitiser (such as AddressSanitizer or UndefinedBehaviorSanitizer) reported an error in @stderr_lines. By default, the sanitisers
+ * report an error and then exit with a non-zero status rather than aborting, so this is needed to tell their crashes apart from the test program
+ * exiting with an error status of its own.
+ *
+ * Return value: %TRUE if a sanitiser error report was found, %FALSE otherwise
+ */
+gboolean
+dsim_crash_has_sanitizer_report (const gchar * const *stderr_lines)
+{
+	const gchar * const *line;
+
+	g_return_val_if_fail (stderr_lines != NULL, FALSE);
+
+	for (line = stderr_lines; *line != NULL; line++) {
+		if (strstr (*line, "Sanitizer: ") != NULL && (strstr (*line, "ERROR: ") != NULL || g_str_has_prefix (*line, "SUMMARY: ") == TRUE)) {
+			return TRUE;
+		} else if (strstr (*line, ": runtime error:") != NULL) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#ifndef DSIM_CRASH_REPORT_H
+#define DSIM_CRASH_REPORT_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimCrashReport:
+ * @signature: stack signature of the crash, as returned by dsim_crash_build_signature()
+ * @status: wait status of the test program when it first crashed this way
+ * @random_seed: seed of the simulation’s random number generator
+ * @first_iteration: (1-based) number of the test run in which the crash first happened
+ * @last_iteration: (1-based) number of the test run in which the crash most recently happened
+ * @hit_count: number of test runs which have crashed with this signature
+ * @history: (element-type utf8): descriptions of the last few D-Bus conversation records before the crash first happened, oldest first
+ *
+ * A report of a unique crash of the program under test, as identified by its stack signature. Later crashes with the same signature increase
+ * @hit_count rather than creating new reports.
+ */
+typedef struct {
+	gchar *signature;
+	gint status;
+	gint64 random_seed;
+	guint first_iteration;
+	guint last_iteration;
+	guint hit_count;
+	GPtrArray/*<string>*/ *history;
+} DsimCrashReport;
+
+DsimCrashReport *dsim_crash_report_new (const gchar *signature, gint status, gint64 random_seed, guint iteration,
+                                        GPtrArray/*<string>*/ *history) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dsim_crash_report_free (DsimCrashReport *report);
+
+void dsim_crash_build_signature_async (gint status, const gchar * const *stderr_lines, GFile *working_directory, const gchar *program_name, GPid pid,
+                                       GAsyncReadyCallback callback, gpointer user_data);
+gchar *dsim_crash_build_signature_finish (GAsyncResult *async_result) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+gboolean dsim_crash_has_sanitizer_report (const gchar * const *stderr_lines);
+
+G_END_DECLS
+
+#endif /* !DSIM_CRASH_REPORT_H */
@@ -0,0 +1,920 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gcov-tracker
+ * @short_description: incremental gcov coverage tracking
+ *
+ * A #DsimGcovTracker watches a directory tree of <filename>.gcda</filename> files written by a test program built with
+ * <code class="literal">--coverage</code>, and works out which source lines (and functions) each test run executed for the first time.
+ *
+ * The gcov runtime merges each process' counters into the existing <filename>.gcda</filename> files as it exits, so the files only ever accumulate
+ * coverage. On each update, the tracker only re-parses the files which have changed since the last one, and only re-solves the functions whose
+ * counters have changed. Each <filename>.gcda</filename> file's <filename>.gcno</filename> file (next to it, as the compiler writes them) gives the
+ * functions' flow graphs and the source lines in each basic block; it's loaded the first time the <filename>.gcda</filename> file is seen, and
+ * again if the test program has been rebuilt since.
+ *
+ * The <filename>.gcda</filename> files only count the arcs which aren't on a spanning tree of each function's flow graph, so the counts of the other
+ * arcs (and so of the basic blocks) are deduced from them the same way <command>gcov</command> does: repeatedly finding blocks with only one arc of
+ * unknown count on one side, and using the fact that the counts of a block's incoming and outgoing arcs both sum to the block's count. A line is
+ * covered once any basic block containing it has been executed. That's the same definition <command>gcov</command> and <command>lcov</command>
+ * use, so the number of covered lines matches theirs.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "gcov-tracker.h"
+
+#define GCOV_DATA_MAGIC 0x67636461 /* “gcda” */
+#define GCOV_NOTE_MAGIC 0x67636e6f /* “gcno” */
+#define GCOV_TAG_FUNCTION 0x01000000
+#define GCOV_TAG_BLOCKS 0x01410000
+#define GCOV_TAG_ARCS 0x01430000
+#define GCOV_TAG_LINES 0x01450000
+#define GCOV_TAG_ARC_COUNTS 0x01a10000
+#define GCOV_TAG_OBJECT_SUMMARY 0xa1000000
+#define GCOV_TAG_PROGRAM_SUMMARY 0xa3000000
+
+#define GCOV_ARC_ON_TREE (1 << 0)
+
+typedef struct {
+	guint32 src;
+	guint32 dest;
+	gboolean on_tree; /* on the spanning tree, so it has no counter and its count has to be deduced */
+} Arc;
+
+typedef struct {
+	guint32 block;
+	const gchar *source; /* interned */
+	guint32 line;
+} BlockLine;
+
+typedef struct {
+	guint32 cfg_checksum;
+	guint num_blocks;
+	GArray/*<Arc>*/ *arcs; /* in the order their counters (if they have them) appear in the .gcda file */
+	guint num_counters; /* number of arcs which aren't on the tree */
+	GArray/*<BlockLine>*/ *lines;
+	guint64 counter_sum; /* sum of the counters when the function was last solved */
+	gboolean covered; /* whether any of the function's blocks has ever been executed */
+} FunctionNotes;
+
+typedef struct {
+	gint64 mtime; /* ns; modification time of the .gcda file when it was last parsed */
+	goffset size;
+	gboolean notes_loaded; /* whether loading the .gcno file has been attempted */
+	guint32 data_stamp; /* compilation stamp of the .gcda file when the .gcno file was last loaded */
+	guint32 stamp; /* compilation stamp of the .gcno file */
+	GHashTable/*<guint32, FunctionNotes>*/ *functions; /* keyed by function ident; NULL if the .gcno file couldn't be loaded */
+} FileCoverage;
+
+struct _DsimGcovTracker {
+	gchar *directory;
+	GHashTable/*<string, FileCoverage>*/ *files; /* keyed by path of the .gcda file relative to directory */
+	GHashTable/*<interned string, GHashTable<guint32>>*/ *covered_lines; /* set of covered line numbers for each source file */
+	guint num_lines;
+	guint num_functions;
+};
+
+static void
+function_notes_free (FunctionNotes *function)
+{
+	g_array_unref (function->arcs);
+	g_array_unref (function->lines);
+	g_slice_free (FunctionNotes, function);
+}
+
+static void
+file_coverage_free (FileCoverage *file)
+{
+	if (file->functions != NULL) {
+		g_hash_table_unref (file->functions);
+	}
+
+	g_slice_free (FileCoverage, file);
+}
+
+/**
+ * dsim_gcov_delta_clear:
+ * @delta: a #DsimGcovDelta
+ *
+ * Frees the contents of a #DsimGcovDelta filled in by dsim_gcov_tracker_update(), and zeroes it.
+ */
+void
+dsim_gcov_delta_clear (DsimGcovDelta *delta)
+{
+	g_return_if_fail (delta != NULL);
+
+	if (delta->files != NULL) {
+		g_ptr_array_unref (delta->files);
+	}
+
+	memset (delta, 0, sizeof (*delta));
+}
+
+/**
+ * dsim_gcov_tracker_new:
+ * @directory: path of the directory to search for <filename>.gcda</filename> files
+ *
+ * Creates a new #DsimGcovTracker for the <filename>.gcda</filename> files anywhere under @directory. No files are read until
+ * dsim_gcov_tracker_update() is first called; that first call establishes the baseline coverage.
+ *
+ * Return value: (transfer full): a new #DsimGcovTracker; free with dsim_gcov_tracker_free()
+ */
+DsimGcovTracker *
+dsim_gcov_tracker_new (const gchar *directory)
+{
+	DsimGcovTracker *tracker;
+
+	g_return_val_if_fail (directory != NULL, NULL);
+
+	tracker = g_slice_new (DsimGcovTracker);
+	tracker->directory = g_strdup (directory);
+	tracker->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) file_coverage_free);
+	tracker->covered_lines = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_hash_table_unref);
+	tracker->num_lines = 0;
+	tracker->num_functions = 0;
+
+	return tracker;
+}
+
+/**
+ * dsim_gcov_tracker_free:
+ * @tracker: (transfer full): a #DsimGcovTracker
+ *
+ * Frees a #DsimGcovTracker.
+ */
+void
+dsim_gcov_tracker_free (DsimGcovTracker *tracker)
+{
+	if (tracker == NULL) {
+		return;
+	}
+
+	g_hash_table_unref (tracker->covered_lines);
+	g_hash_table_unref (tracker->files);
+	g_free (tracker->directory);
+	g_slice_free (DsimGcovTracker, tracker);
+}
+
+typedef struct {
+	const guint8 *data;
+	gsize length;
+	gsize pos;
+	gboolean swap;
+	gboolean lengths_in_bytes;
+} GcovReader;
+
+static gboolean
+read_word (GcovReader *reader, guint32 *value)
+{
+	if (reader->length - reader->pos < sizeof (*value)) {
+		return FALSE;
+	}
+
+	/* Records aren't aligned in GCC 12's format. */
+	memcpy (value, reader->data + reader->pos, sizeof (*value));
+	reader->pos += sizeof (*value);
+
+	if (reader->swap == TRUE) {
+		*value = GUINT32_SWAP_LE_BE (*value);
+	}
+
+	return TRUE;
+}
+
+/* Read a string, which is %NULL if it's empty. The returned string points into the reader's data. */
+static gboolean
+read_string (GcovReader *reader, const gchar **str)
+{
+	guint32 length;
+	gsize length_bytes;
+
+	if (read_word (reader, &length) == FALSE) {
+		return FALSE;
+	}
+
+	length_bytes = (reader->lengths_in_bytes == TRUE) ? length : (gsize) length * 4;
+
+	if (length_bytes == 0) {
+		*str = NULL;
+		return TRUE;
+	} else if (reader->length - reader->pos < length_bytes || memchr (reader->data + reader->pos, '\0', length_bytes) == NULL) {
+		return FALSE;
+	}
+
+	*str = (const gchar *) reader->data + reader->pos;
+	reader->pos += length_bytes;
+
+	return TRUE;
+}
+
+/* Reads the header common to .gcda and .gcno files. The format is described in gcc/gcov-io.h. It has changed over GCC versions: since GCC 12, the
+ * header has an extra checksum word, record and string lengths are in bytes rather than words, and records are no longer padded to a whole number of
+ * words. Returns the GCC major version, or 0 if the file doesn't start with @magic. */
+static guint
+read_header (GcovReader *reader, const gchar *contents, gsize length, guint32 magic, guint32 *stamp)
+{
+	guint32 word, version;
+	guint major;
+	gchar c0, c1;
+
+	reader->data = (const guint8 *) contents;
+	reader->length = length;
+	reader->pos = 0;
+	reader->swap = FALSE;
+	reader->lengths_in_bytes = FALSE;
+
+	if (read_word (reader, &word) == FALSE) {
+		return 0;
+	} else if (word == magic) {
+		reader->swap = FALSE;
+	} else if (GUINT32_SWAP_LE_BE (word) == magic) {
+		reader->swap = TRUE;
+	} else {
+		return 0;
+	}
+
+	if (read_word (reader, &version) == FALSE || read_word (reader, stamp) == FALSE) {
+		return 0;
+	}
+
+	/* The version is four characters: the major version (e.g. ‘408*’ for 4.8, or ‘B21*’ for 12.1), then the minor version, then a status. */
+	c0 = (version >> 24) & 0xff;
+	c1 = (version >> 16) & 0xff;
+	major = (c0 >= 'A') ? (c0 - 'A') * 10 + (c1 - '0') : (guint) (c0 - '0');
+	reader->lengths_in_bytes = (major >= 12);
+
+	/* Skip the checksum. */
+	if (major >= 12 && read_word (reader, &word) == FALSE) {
+		return 0;
+	}
+
+	return MAX (major, 1);
+}
+
+/* Read the next record's tag, and its length in bytes (or -1 for an elided all-zero counter record). */
+static gboolean
+read_record_header (GcovReader *reader, guint32 *tag, gssize *length_bytes)
+{
+	guint32 length;
+
+	if (read_word (reader, tag) == FALSE || read_word (reader, &length) == FALSE) {
+		return FALSE;
+	}
+
+	if ((gint32) length < 0) {
+		*length_bytes = -1;
+	} else {
+		*length_bytes = (reader->lengths_in_bytes == TRUE) ? (gssize) length : (gssize) length * 4;
+
+		if (reader->length - reader->pos < (gsize) *length_bytes) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Parse a .gcno file's function records, keyed by ident. Relative source file paths are resolved against the compiler's working directory, if the
+ * file records it. Returns NULL if the file isn't a .gcno file. */
+static GHashTable/*<guint32, FunctionNotes>*/ *
+parse_gcno_file (const gchar *contents, gsize length, guint32 *stamp)
+{
+	GcovReader reader;
+	GHashTable/*<guint32, FunctionNotes>*/ *functions;
+	FunctionNotes *function = NULL;
+	const gchar *cwd = NULL;
+	guint major;
+	guint32 word;
+
+	major = read_header (&reader, contents, length, GCOV_NOTE_MAGIC, stamp);
+
+	if (major == 0) {
+		return NULL;
+	}
+
+	/* Since GCC 9, the header records the compiler's working directory; and since GCC 8, whether the file has unexecuted block information. */
+	if ((major >= 9 && read_string (&reader, &cwd) == FALSE) || (major >= 8 && read_word (&reader, &word) == FALSE)) {
+		return NULL;
+	}
+
+	functions = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) function_notes_free);
+
+	while (reader.pos < reader.length) {
+		guint32 tag;
+		gssize record_length;
+		gsize end;
+
+		if (read_record_header (&reader, &tag, &record_length) == FALSE || record_length < 0) {
+			goto error;
+		}
+
+		end = reader.pos + record_length;
+
+		if (tag == GCOV_TAG_FUNCTION) {
+			guint32 ident, lineno_checksum;
+
+			function = g_slice_new0 (FunctionNotes);
+			function->arcs = g_array_new (FALSE, FALSE, sizeof (Arc));
+			function->lines = g_array_new (FALSE, FALSE, sizeof (BlockLine));
+
+			if (read_word (&reader, &ident) == FALSE || read_word (&reader, &lineno_checksum) == FALSE ||
+			    read_word (&reader, &function->cfg_checksum) == FALSE || reader.pos > end) {
+				function_notes_free (function);
+				goto error;
+			}
+
+			g_hash_table_replace (functions, GUINT_TO_POINTER (ident), function);
+		} else if (tag == GCOV_TAG_BLOCKS && function != NULL) {
+			/* Before GCC 8, there was a flags word for each block. */
+			if (major >= 8) {
+				if (read_word (&reader, &word) == FALSE || reader.pos > end) {
+					goto error;
+				}
+
+				function->num_blocks = word;
+			} else {
+				function->num_blocks = record_length / 4;
+			}
+		} else if (tag == GCOV_TAG_ARCS && function != NULL) {
+			guint32 src;
+
+			if (read_word (&reader, &src) == FALSE || reader.pos > end || src >= function->num_blocks) {
+				goto error;
+			}
+
+			while (end - reader.pos >= 8) {
+				Arc arc;
+				guint32 flags;
+
+				if (read_word (&reader, &arc.dest) == FALSE || read_word (&reader, &flags) == FALSE || arc.dest >= function->num_blocks) {
+					goto error;
+				}
+
+				arc.src = src;
+				arc.on_tree = ((flags & GCOV_ARC_ON_TREE) != 0);
+				g_array_append_val (function->arcs, arc);
+
+				if (arc.on_tree == FALSE) {
+					function->num_counters++;
+				}
+			}
+		} else if (tag == GCOV_TAG_LINES && function != NULL) {
+			BlockLine line;
+
+			line.source = NULL;
+
+			if (read_word (&reader, &line.block) == FALSE || line.block >= function->num_blocks) {
+				goto error;
+			}
+
+			/* Line numbers, with a 0 followed by a file name wherever the file changes, terminated by a 0 and an empty file name. */
+			while (reader.pos < end) {
+				const gchar *source;
+
+				if (read_word (&reader, &line.line) == FALSE) {
+					goto error;
+				} else if (line.line != 0) {
+					if (line.source != NULL) {
+						g_array_append_val (function->lines, line);
+					}
+
+					continue;
+				}
+
+				if (read_string (&reader, &source) == FALSE) {
+					goto error;
+				} else if (source == NULL) {
+					break;
+				}
+
+				if (cwd != NULL && g_path_is_absolute (source) == FALSE) {
+					gchar *path = g_build_filename (cwd, source, NULL);
+					line.source = g_intern_string (path);
+					g_free (path);
+				} else {
+					line.source = g_intern_string (source);
+				}
+			}
+		}
+
+		if (reader.pos > end) {
+			goto error;
+		}
+
+		reader.pos = end;
+	}
+
+	return functions;
+
+error:
+	g_hash_table_unref (functions);
+
+	return NULL;
+}
+
+/* Build adjacency lists of @function's arcs: the indices of the arcs leaving (or, if @incoming is %TRUE, entering) block b are
+ * list[first[b]] to list[first[b + 1] - 1]. */
+static void
+build_adjacency (const FunctionNotes *function, gboolean incoming, guint **first, guint **list)
+{
+	guint num_arcs = function->arcs->len, num_blocks = function->num_blocks, i;
+	guint *next;
+
+	*first = g_new0 (guint, num_blocks + 1);
+	*list = g_new (guint, num_arcs);
+
+	for (i = 0; i < num_arcs; i++) {
+		const Arc *arc = &g_array_index (function->arcs, Arc, i);
+		(*first)[((incoming == TRUE) ? arc->dest : arc->src) + 1]++;
+	}
+
+	for (i = 0; i < num_blocks; i++) {
+		(*first)[i + 1] += (*first)[i];
+	}
+
+	next = g_new (guint, num_blocks + 1);
+	memcpy (next, *first, (num_blocks + 1) * sizeof (guint));
+
+	for (i = 0; i < num_arcs; i++) {
+		const Arc *arc = &g_array_index (function->arcs, Arc, i);
+		(*list)[next[(incoming == TRUE) ? arc->dest : arc->src]++] = i;
+	}
+
+	g_free (next);
+}
+
+/* Sum the known counts of the arcs in list[start] to list[end - 1], returning the index of the last unknown one in @unknown_arc. */
+static guint64
+sum_arcs (const guint *list, guint start, guint end, const guint64 *arc_counts, const gboolean *arc_known, guint *unknown_arc)
+{
+	guint64 sum = 0;
+	guint i;
+
+	for (i = start; i < end; i++) {
+		if (arc_known[list[i]] == TRUE) {
+			sum += arc_counts[list[i]];
+		} else {
+			*unknown_arc = list[i];
+		}
+	}
+
+	return sum;
+}
+
+/* Deduce the execution count of each of @function's blocks from @counters, returning an array of them; blocks whose count couldn't be deduced
+ * (which only happens if the notes and the counters are inconsistent) are given a count of 0. */
+static guint64 *
+solve_block_counts (const FunctionNotes *function, const guint64 *counters)
+{
+	guint num_arcs = function->arcs->len, num_blocks = function->num_blocks, i, j;
+	guint64 *arc_counts, *block_counts;
+	gboolean *arc_known, *block_known;
+	guint *num_unknown_in, *num_unknown_out, *in_first, *in_list, *out_first, *out_list;
+	GArray/*<guint>*/ *pending;
+
+	arc_counts = g_new0 (guint64, num_arcs);
+	arc_known = g_new0 (gboolean, num_arcs);
+	block_counts = g_new0 (guint64, num_blocks);
+	block_known = g_new0 (gboolean, num_blocks);
+	num_unknown_in = g_new0 (guint, num_blocks);
+	num_unknown_out = g_new0 (guint, num_blocks);
+	pending = g_array_sized_new (FALSE, FALSE, sizeof (guint), num_blocks);
+
+	build_adjacency (function, TRUE, &in_first, &in_list);
+	build_adjacency (function, FALSE, &out_first, &out_list);
+
+	for (i = 0, j = 0; i < num_arcs; i++) {
+		const Arc *arc = &g_array_index (function->arcs, Arc, i);
+
+		if (arc->on_tree == FALSE) {
+			arc_counts[i] = counters[j++];
+			arc_known[i] = TRUE;
+		} else {
+			num_unknown_out[arc->src]++;
+			num_unknown_in[arc->dest]++;
+		}
+	}
+
+	for (i = 0; i < num_blocks; i++) {
+		g_array_append_val (pending, i);
+	}
+
+	/* Each time an arc's count is deduced, both of its blocks are re-examined, so this terminates after at most num_blocks + 2 * num_arcs steps. */
+	while (pending->len > 0) {
+		guint block = g_array_index (pending, guint, pending->len - 1);
+		guint num_in = in_first[block + 1] - in_first[block], num_out = out_first[block + 1] - out_first[block];
+		guint unknown_in_arc = G_MAXUINT, unknown_out_arc = G_MAXUINT, arc_index;
+		guint64 sum_in, sum_out, sum;
+		const Arc *arc;
+
+		g_array_set_size (pending, pending->len - 1);
+
+		if (block_known[block] == TRUE && num_unknown_in[block] != 1 && num_unknown_out[block] != 1) {
+			continue;
+		}
+
+		sum_in = sum_arcs (in_list, in_first[block], in_first[block + 1], arc_counts, arc_known, &unknown_in_arc);
+		sum_out = sum_arcs (out_list, out_first[block], out_first[block + 1], arc_counts, arc_known, &unknown_out_arc);
+
+		if (block_known[block] == FALSE) {
+			if (num_in > 0 && num_unknown_in[block] == 0) {
+				block_counts[block] = sum_in;
+			} else if (num_out > 0 && num_unknown_out[block] == 0) {
+				block_counts[block] = sum_out;
+			} else if (num_in > 0 || num_out > 0) {
+				continue;
+			}
+
+			block_known[block] = TRUE;
+		}
+
+		if (num_unknown_out[block] != 1 && num_unknown_in[block] != 1) {
+			continue;
+		}
+
+		/* The arc's count is whatever's left of the block's count. Its other block might now be deducible. */
+		arc_index = (num_unknown_out[block] == 1) ? unknown_out_arc : unknown_in_arc;
+		sum = (num_unknown_out[block] == 1) ? sum_out : sum_in;
+		arc = &g_array_index (function->arcs, Arc, arc_index);
+
+		arc_counts[arc_index] = (block_counts[block] > sum) ? block_counts[block] - sum : 0;
+		arc_known[arc_index] = TRUE;
+		num_unknown_out[arc->src]--;
+		num_unknown_in[arc->dest]--;
+
+		g_array_append_val (pending, arc->src);
+		g_array_append_val (pending, arc->dest);
+	}
+
+	g_array_unref (pending);
+	g_free (out_list);
+	g_free (out_first);
+	g_free (in_list);
+	g_free (in_first);
+	g_free (num_unknown_out);
+	g_free (num_unknown_in);
+	g_free (block_known);
+	g_free (arc_known);
+	g_free (arc_counts);
+
+	return block_counts;
+}
+
+/* Mark the lines in each of @function's executed blocks as covered, adding the sources of any newly covered lines to @gained_sources. */
+static void
+update_function (DsimGcovTracker *tracker, FunctionNotes *function, const guint64 *counters, GHashTable/*<interned string>*/ *gained_sources,
+                 guint *new_lines, guint *new_functions)
+{
+	guint64 *block_counts, counter_sum = 0;
+	gboolean executed = FALSE;
+	guint i;
+
+	/* Counters only ever accumulate, so if they haven't changed since the function was last solved, nothing new has been covered. */
+	for (i = 0; i < function->num_counters; i++) {
+		counter_sum += counters[i];
+	}
+
+	if (counter_sum == function->counter_sum) {
+		return;
+	}
+
+	function->counter_sum = counter_sum;
+	block_counts = solve_block_counts (function, counters);
+
+	for (i = 0; i < function->num_blocks; i++) {
+		executed = executed || (block_counts[i] > 0);
+	}
+
+	for (i = 0; i < function->lines->len; i++) {
+		const BlockLine *line = &g_array_index (function->lines, BlockLine, i);
+		GHashTable/*<guint32>*/ *lines;
+
+		if (block_counts[line->block] == 0) {
+			continue;
+		}
+
+		lines = g_hash_table_lookup (tracker->covered_lines, line->source);
+
+		if (lines == NULL) {
+			lines = g_hash_table_new (g_direct_hash, g_direct_equal);
+			g_hash_table_insert (tracker->covered_lines, (gpointer) line->source, lines);
+		}
+
+		if (g_hash_table_contains (lines, GUINT_TO_POINTER (line->line)) == FALSE) {
+			g_hash_table_add (lines, GUINT_TO_POINTER (line->line));
+			g_hash_table_add (gained_sources, (gpointer) line->source);
+			(*new_lines)++;
+		}
+	}
+
+	if (executed == TRUE && function->covered == FALSE) {
+		function->covered = TRUE;
+		(*new_functions)++;
+	}
+
+	g_free (block_counts);
+}
+
+/* Load the .gcno file for the .gcda file at @gcda_path into @file. */
+static void
+load_notes (FileCoverage *file, const gchar *gcda_path)
+{
+	gchar *path, *contents = NULL;
+	gsize length;
+	GError *error = NULL;
+
+	if (file->functions != NULL) {
+		g_hash_table_unref (file->functions);
+		file->functions = NULL;
+	}
+
+	path = g_strdup (gcda_path);
+	strcpy (path + strlen (path) - strlen ("gcda"), "gcno");
+
+	if (g_file_get_contents (path, &contents, &length, &error) == FALSE) {
+		g_message (_("Error reading gcov notes file ‘%s’; ignoring the coverage in ‘%s’: %s"), path, gcda_path, error->message);
+		g_error_free (error);
+	} else {
+		file->functions = parse_gcno_file (contents, length, &file->stamp);
+
+		if (file->functions == NULL) {
+			g_message (_("Invalid gcov notes file ‘%s’; ignoring the coverage in ‘%s’."), path, gcda_path);
+		}
+	}
+
+	g_free (contents);
+	g_free (path);
+}
+
+/* Parse the arc counters out of a .gcda file and merge them into the tracker's coverage, counting the lines and functions covered for the first
+ * time. Returns FALSE if the file isn't a .gcda file. */
+static gboolean
+parse_gcda_file (DsimGcovTracker *tracker, const gchar *contents, gsize length, FileCoverage *file, const gchar *path,
+                 GHashTable/*<interned string>*/ *gained_sources, guint *new_lines, guint *new_functions)
+{
+	GcovReader reader;
+	FunctionNotes *function = NULL;
+	GArray/*<guint64>*/ *counters;
+	guint32 stamp;
+
+	if (read_header (&reader, contents, length, GCOV_DATA_MAGIC, &stamp) == 0) {
+		return FALSE;
+	}
+
+	/* Load the notes the first time the file's seen, and reload them if the test program's been rebuilt since. */
+	if (file->notes_loaded == FALSE || file->data_stamp != stamp) {
+		load_notes (file, path);
+		file->notes_loaded = TRUE;
+		file->data_stamp = stamp;
+	}
+
+	if (file->functions == NULL) {
+		return TRUE;
+	} else if (file->stamp != stamp) {
+		g_debug ("Ignoring gcov data file ‘%s’, which doesn't match its notes file.", path);
+		return TRUE;
+	}
+
+	counters = g_array_new (FALSE, TRUE, sizeof (guint64));
+
+	while (reader.pos < reader.length) {
+		guint32 tag;
+		gssize record_length;
+		gsize end;
+
+		if (read_record_header (&reader, &tag, &record_length) == FALSE) {
+			break;
+		}
+
+		end = reader.pos + MAX (record_length, 0);
+
+		if (tag == GCOV_TAG_FUNCTION) {
+			guint32 ident, lineno_checksum, cfg_checksum;
+
+			/* An empty function record means the function wasn't emitted. */
+			function = NULL;
+
+			if (record_length >= 12 && read_word (&reader, &ident) == TRUE && read_word (&reader, &lineno_checksum) == TRUE &&
+			    read_word (&reader, &cfg_checksum) == TRUE) {
+				function = g_hash_table_lookup (file->functions, GUINT_TO_POINTER (ident));
+
+				if (function != NULL && function->cfg_checksum != cfg_checksum) {
+					g_debug ("Ignoring function %u in gcov data file ‘%s’, which doesn't match its notes.", ident, path);
+					function = NULL;
+				}
+			}
+		} else if (tag == GCOV_TAG_ARC_COUNTS && function != NULL && record_length >= 0) {
+			guint num_counters = record_length / 8, i;
+
+			if (num_counters != function->num_counters) {
+				g_debug ("Ignoring arc counters with the wrong length in gcov data file ‘%s’.", path);
+			} else {
+				g_array_set_size (counters, num_counters);
+
+				for (i = 0; i < num_counters; i++) {
+					guint32 low = 0, high = 0;
+
+					/* Counters are 64-bit, low word first. The record's length has already been checked. */
+					read_word (&reader, &low);
+					read_word (&reader, &high);
+					g_array_index (counters, guint64, i) = ((guint64) high << 32) | low;
+				}
+
+				update_function (tracker, function, (const guint64 *) counters->data, gained_sources, new_lines, new_functions);
+			}
+		}
+
+		/* All-zero counter records (with a negative length) can't have covered anything. */
+		reader.pos = end;
+	}
+
+	g_array_unref (counters);
+
+	return TRUE;
+}
+
+static void
+update_file (DsimGcovTracker *tracker, const gchar *relative_path, GHashTable/*<interned string>*/ *gained_sources, DsimGcovDelta *delta)
+{
+	gchar *path, *contents = NULL;
+	gsize length;
+	GStatBuf stat_buf;
+	FileCoverage *file;
+	gint64 mtime;
+	guint new_lines = 0, new_functions = 0;
+	GError *error = NULL;
+
+	path = g_build_filename (tracker->directory, relative_path, NULL);
+
+	if (g_stat (path, &stat_buf) != 0) {
+		goto done;
+	}
+
+	/* Skip files which haven't changed since the last update. Nanosecond precision is needed, since test runs can be much shorter than a second,
+	 * and the size of a .gcda file doesn't change when its counters do. */
+	mtime = (gint64) stat_buf.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + stat_buf.st_mtim.tv_nsec;
+	file = g_hash_table_lookup (tracker->files, relative_path);
+
+	if (file != NULL && file->mtime == mtime && file->size == stat_buf.st_size) {
+		goto done;
+	}
+
+	if (g_file_get_contents (path, &contents, &length, &error) == FALSE) {
+		g_debug ("Error reading gcov data file ‘%s’: %s", path, error->message);
+		g_error_free (error);
+		goto done;
+	}
+
+	if (file == NULL) {
+		file = g_slice_new0 (FileCoverage);
+		g_hash_table_insert (tracker->files, g_strdup (relative_path), file);
+	}
+
+	file->mtime = mtime;
+	file->size = stat_buf.st_size;
+
+	if (parse_gcda_file (tracker, contents, length, file, path, gained_sources, &new_lines, &new_functions) == FALSE) {
+		g_debug ("Ignoring invalid gcov data file ‘%s’.", path);
+	}
+
+	delta->new_lines += new_lines;
+	delta->new_functions += new_functions;
+
+	tracker->num_lines += new_lines;
+	tracker->num_functions += new_functions;
+
+done:
+	g_free (contents);
+	g_free (path);
+}
+
+static void
+update_directory (DsimGcovTracker *tracker, const gchar *relative_path, GHashTable/*<interned string>*/ *gained_sources, DsimGcovDelta *delta)
+{
+	gchar *path;
+	GDir *dir;
+	const gchar *name;
+
+	path = g_build_filename (tracker->directory, relative_path, NULL);
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir == NULL) {
+		g_free (path);
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *child_path, *child_relative_path;
+
+		child_relative_path = (*relative_path == '\0') ? g_strdup (name) : g_build_filename (relative_path, name, NULL);
+		child_path = g_build_filename (path, name, NULL);
+
+		if (g_str_has_suffix (name, ".gcda") == TRUE) {
+			update_file (tracker, child_relative_path, gained_sources, delta);
+		} else if (g_file_test (child_path, G_FILE_TEST_IS_SYMLINK) == FALSE && g_file_test (child_path, G_FILE_TEST_IS_DIR) == TRUE) {
+			/* Don't follow symlinks, to avoid loops. */
+			update_directory (tracker, child_relative_path, gained_sources, delta);
+		}
+
+		g_free (child_path);
+		g_free (child_relative_path);
+	}
+
+	g_dir_close (dir);
+	g_free (path);
+}
+
+static gint
+compare_strings (const gchar **a, const gchar **b)
+{
+	return strcmp (*a, *b);
+}
+
+/**
+ * dsim_gcov_tracker_update:
+ * @tracker: a #DsimGcovTracker
+ * @delta: (out caller-allocates): return location for the coverage gained since the last update
+ *
+ * Re-reads the <filename>.gcda</filename> files which have changed since the last update, and works out which source lines and functions have been
+ * executed for the first time since then. Files which can't be read or parsed are ignored (with a debug message), since the test program may be part
+ * way through writing them.
+ */
+void
+dsim_gcov_tracker_update (DsimGcovTracker *tracker, DsimGcovDelta *delta)
+{
+	GHashTable/*<interned string>*/ *gained_sources;
+	GHashTableIter iter;
+	gpointer source;
+
+	g_return_if_fail (tracker != NULL);
+	g_return_if_fail (delta != NULL);
+
+	delta->new_lines = 0;
+	delta->new_functions = 0;
+	delta->files = g_ptr_array_new_with_free_func (g_free);
+
+	gained_sources = g_hash_table_new (g_direct_hash, g_direct_equal);
+	update_directory (tracker, "", gained_sources, delta);
+
+	g_hash_table_iter_init (&iter, gained_sources);
+
+	while (g_hash_table_iter_next (&iter, &source, NULL) == TRUE) {
+		g_ptr_array_add (delta->files, g_strdup (source));
+	}
+
+	g_ptr_array_sort (delta->files, (GCompareFunc) compare_strings);
+	g_hash_table_unref (gained_sources);
+}
+
+/**
+ * dsim_gcov_tracker_get_num_lines:
+ * @tracker: a #DsimGcovTracker
+ *
+ * Gets the number of source lines which have been executed across all updates so far.
+ *
+ * Return value: number of covered lines
+ */
+guint
+dsim_gcov_tracker_get_num_lines (DsimGcovTracker *tracker)
+{
+	g_return_val_if_fail (tracker != NULL, 0);
+
+	return tracker->num_lines;
+}
+
+/**
+ * dsim_gcov_tracker_get_num_functions:
+ * @tracker: a #DsimGcovTracker
+ *
+ * Gets the number of functions which have been executed across all updates so far.
+ *
+ * Return value: number of covered functions
+ */
+guint
+dsim_gcov_tracker_get_num_functions (DsimGcovTracker *tracker)
+{
+	g_return_val_if_fail (tracker != NULL, 0);
+
+	return tracker->num_functions;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#ifndef DSIM_GCOV_TRACKER_H
+#define DSIM_GCOV_TRACKER_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimGcovDelta:
+ * @new_lines: number of source lines which were executed for the first time
+ * @new_functions: number of functions which were executed for the first time
+ * @files: (element-type filename): paths of the source files which gained coverage, as given in the <filename>.gcno</filename> files (made
+ *   absolute if the compiler recorded its working directory), sorted
+ *
+ * The coverage gained between two calls to dsim_gcov_tracker_update(). Clear it with dsim_gcov_delta_clear().
+ */
+typedef struct {
+	guint new_lines;
+	guint new_functions;
+	GPtrArray/*<string>*/ *files;
+} DsimGcovDelta;
+
+void dsim_gcov_delta_clear (DsimGcovDelta *delta);
+
+typedef struct _DsimGcovTracker DsimGcovTracker;
+
+DsimGcovTracker *dsim_gcov_tracker_new (const gchar *directory) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dsim_gcov_tracker_free (DsimGcovTracker *tracker);
+
+void dsim_gcov_tracker_update (DsimGcovTracker *tracker, DsimGcovDelta *delta);
+
+guint dsim_gcov_tracker_get_num_lines (DsimGcovTracker *tracker) G_GNUC_PURE;
+guint dsim_gcov_tracker_get_num_functions (DsimGcovTracker *tracker) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DSIM_GCOV_TRACKER_H */
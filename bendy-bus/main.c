@@ -23,14 +23,25 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib-unix.h>
 #include <glib/gi18n.h>
 #include <dfsm/dfsm.h>
 
+#include "bus-broker.h"
+#include "corpus.h"
+#include "coverage-map.h"
+#include "crash-report.h"
 #include "dbus-daemon.h"
+#include "gcov-tracker.h"
 #include "logging.h"
+#include "memory-trend.h"
+#include "recorder.h"
+#include "resource-usage.h"
 #include "test-program.h"
+#include "trace.h"
 
 enum StatusCodes {
 	STATUS_SUCCESS = 0,
@@ -42,6 +53,12 @@ enum StatusCodes {
 	STATUS_TEST_PROGRAM_SPAWN_ERROR = 6,
 	STATUS_LOGGING_PROBLEM = 7,
 	STATUS_TMP_DIR_ERROR = 8,
+	STATUS_RECORDING_ERROR = 9,
+	STATUS_RESOURCE_USAGE_ERROR = 10,
+	STATUS_TRACE_ERROR = 11,
+	STATUS_COVERAGE_ERROR = 12,
+	STATUS_CORPUS_ERROR = 13,
+	STATUS_GCOV_ERROR = 14,
 };
 
 static gint64 random_seed = 0;
@@ -51,6 +68,7 @@ static gchar *dbus_daemon_log_file = NULL;
 static gint dbus_daemon_log_fd = 0;
 static gchar *simulator_log_file = NULL;
 static gint simulator_log_fd = 0;
+static gchar *trace_file_path = NULL;
 static gint test_timeout = 0;
 static gint run_time = 0;
 static gint run_iters = 0;
@@ -59,7 +77,25 @@ static GPtrArray *test_program_environment = NULL;
 static gboolean pass_through_environment = FALSE;
 static gchar *dbus_daemon_config_file_path = NULL;
 static guint unfuzzed_transition_limit = 0;
+static gboolean exit_with_crash_status = FALSE;
+static gboolean continue_on_crash = FALSE;
+static gint crash_history_length = 20;
+static gchar *resource_usage_file_path = NULL;
+static gboolean detect_leaks = FALSE;
 static gboolean system_bus = FALSE;
+static gboolean use_bus_broker = FALSE;
+static gboolean worker_thread_dispatch = FALSE;
+static gboolean machine_cache = FALSE;
+static gint object_instances = 0;
+static gchar *target_state_name = NULL;
+static gboolean solve_preconditions = FALSE;
+static gboolean coverage_guided = FALSE;
+static gchar *corpus_directory_path = NULL;
+static gboolean resume_corpus = FALSE;
+static gchar *gcov_directory_path = NULL;
+static gchar *gcov_log_file_path = NULL;
+static gchar *record_file_path = NULL;
+static gchar *replay_file_path = NULL;
 
 static gboolean
 option_env_parse_cb (const gchar *option_name, const gchar *value, gpointer data, GError **error)
@@ -94,6 +130,8 @@ option_env_parse_cb (const gchar *option_name, const gchar *value, gpointer data
 
 static const GOptionEntry main_entries[] = {
 	{ "random-seed", 's', 0, G_OPTION_ARG_INT64, &random_seed, N_("Seed value for the simulation’s random number generator"), N_("SEED") },
+	{ "machine-cache", 0, 0, G_OPTION_ARG_NONE, &machine_cache,
+	  N_("Store the parsed simulation code in the compiled machine cache, and load it from there if it hasn't changed"), NULL },
 	{ NULL }
 };
 
@@ -107,6 +145,8 @@ static const GOptionEntry logging_entries[] = {
 	{ "simulator-log-file", 0, 0, G_OPTION_ARG_FILENAME, &simulator_log_file, N_("URI or path of a file to log simulator output to"),
 	  N_("FILE") },
 	{ "simulator-log-fd", 0, 0, G_OPTION_ARG_INT, &simulator_log_fd, N_("Open FD to log simulator output to"), N_("FD") },
+	{ "trace-file", 0, 0, G_OPTION_ARG_FILENAME, &trace_file_path,
+	  N_("URI or path of a file to write a trace of simulator events to, in Chrome trace event format"), N_("FILE") },
 	{ NULL }
 };
 
@@ -119,6 +159,34 @@ static const GOptionEntry testing_entries[] = {
 	{ "run-infinitely", 'i', 0, G_OPTION_ARG_NONE, &run_infinitely, N_("Run test runs in an infinite loop"), NULL },
 	{ "unfuzzed-transition-limit", 'u', 0, G_OPTION_ARG_INT, &unfuzzed_transition_limit,
 	  N_("Number of unfuzzed transitions to execute before enabling fuzzing (default: 0)"), N_("COUNT") },
+	{ "exit-with-crash-status", 0, 0, G_OPTION_ARG_NONE, &exit_with_crash_status,
+	  N_("Exit with status 128 plus the signal number if the test program crashes"), NULL },
+	{ "continue-on-crash", 'c', 0, G_OPTION_ARG_NONE, &continue_on_crash,
+	  N_("Record crashes of the test program and start a new test run, rather than stopping the simulation"), NULL },
+	{ "crash-history-length", 0, 0, G_OPTION_ARG_INT, &crash_history_length,
+	  N_("Number of D-Bus conversation records to report for each crash when continuing on crash (default: 20)"), N_("COUNT") },
+	{ "resource-usage-file", 0, 0, G_OPTION_ARG_FILENAME, &resource_usage_file_path,
+	  N_("Path of a file to write the test program’s resource usage in each test run, and a summary of it, to"), N_("FILE") },
+	{ "detect-leaks", 0, 0, G_OPTION_ARG_NONE, &detect_leaks,
+	  N_("Sample the test program’s memory usage and report test runs in which it grows superlinearly with simulation activity"), NULL },
+	{ "worker-thread-dispatch", 0, 0, G_OPTION_ARG_NONE, &worker_thread_dispatch,
+	  N_("Handle D-Bus method calls directly in the D-Bus worker thread, rather than in the main thread"), NULL },
+	{ "object-instances", 0, 0, G_OPTION_ARG_INT, &object_instances,
+	  N_("Number of additional instances of each simulated object to export, at object paths below the object’s own (default: 0)"), N_("COUNT") },
+	{ "target-state", 0, 0, G_OPTION_ARG_STRING, &target_state_name,
+	  N_("Drive each simulated object which has this state to it in as few transitions as possible, then continue randomly"), N_("STATE") },
+	{ "solve-preconditions", 0, 0, G_OPTION_ARG_NONE, &solve_preconditions,
+	  N_("Search for object variable values which satisfy the preconditions of arbitrary transitions which haven’t been executed yet"), NULL },
+	{ "coverage-guided", 0, 0, G_OPTION_ARG_NONE, &coverage_guided,
+	  N_("Favour arbitrary transitions which lead to new edge coverage in a test program linked against libbendy-bus-coverage"), NULL },
+	{ "corpus-dir", 0, 0, G_OPTION_ARG_FILENAME, &corpus_directory_path,
+	  N_("Directory to save the random seed streams of test runs which find new coverage, crash or time out to"), N_("DIR") },
+	{ "resume", 0, 0, G_OPTION_ARG_NONE, &resume_corpus,
+	  N_("Re-run the test runs saved in the --corpus-dir first, then derive new test runs from them"), NULL },
+	{ "gcov-dir", 0, 0, G_OPTION_ARG_FILENAME, &gcov_directory_path,
+	  N_("Directory containing the test program’s .gcda files, to track the coverage gained in each test run"), N_("DIR") },
+	{ "gcov-log-file", 0, 0, G_OPTION_ARG_FILENAME, &gcov_log_file_path,
+	  N_("Path of a file to write the coverage gained in each test run, and the random seeds which gained it, to"), N_("FILE") },
 	{ NULL }
 };
 
@@ -134,6 +202,16 @@ static const GOptionEntry dbus_daemon_entries[] = {
 	{ "dbus-daemon-config-file", 0, 0, G_OPTION_ARG_FILENAME, &dbus_daemon_config_file_path,
 	  N_("URI or path of a config.xml file for the dbus-daemon"), N_("FILE") },
 	{ "system-bus", 0, 0, G_OPTION_ARG_NONE, &system_bus, N_("Run local system instead of session bus"), NULL },
+	{ "bus-broker", 0, 0, G_OPTION_ARG_NONE, &use_bus_broker,
+	  N_("Use a minimal built-in bus broker rather than spawning a dbus-daemon instance"), NULL },
+	{ NULL }
+};
+
+static const GOptionEntry recording_entries[] = {
+	{ "record-file", 0, 0, G_OPTION_ARG_FILENAME, &record_file_path,
+	  N_("Path of a file to record the conversation with the test program to, for later replay"), N_("FILE") },
+	{ "replay-file", 0, 0, G_OPTION_ARG_FILENAME, &replay_file_path,
+	  N_("Path of a recording file to replay the conversation with the test program from, instead of simulating it"), N_("FILE") },
 	{ NULL }
 };
 
@@ -147,6 +225,17 @@ print_help_text (GOptionContext *context)
 	g_free (help_text);
 }
 
+/* Interval between samples of the test program's memory usage when detecting leaks. */
+#define MEMORY_SAMPLE_INTERVAL 200 /* ms */
+
+/* Probability of deriving a test run from a corpus entry, rather than starting it from a fresh seed, once any resumed entries have been re-run. */
+#define CORPUS_MUTATION_PROBABILITY 0.5
+
+typedef struct {
+	guint iteration;
+	DsimMemoryTrend trend;
+} LeakReport;
+
 typedef struct {
 	/* Program structure */
 	GMainLoop *main_loop;
@@ -159,7 +248,8 @@ typedef struct {
 	gchar *test_program_name;
 	GPtrArray/*<string>*/ *test_program_argv;
 	GFile *working_directory_file;
-	DsimDBusDaemon *dbus_daemon;
+	DsimDBusDaemon *dbus_daemon; /* NULL if using the built-in bus broker */
+	DsimBusBroker *bus_broker; /* NULL unless using the built-in bus broker */
 	gchar *dbus_address;
 	GDBusConnection *connection;
 	guint outstanding_registration_callbacks; /* number of calls to g_bus_own_name() which are outstanding */
@@ -169,9 +259,42 @@ typedef struct {
 	gulong test_program_spawn_end_signal;
 	gulong test_program_process_died_signal;
 	guint test_program_sigkill_timeout_id;
+	gboolean test_program_sigkilled; /* TRUE if bendy-bus itself sent the current test program SIGKILL */
+	int test_program_crash_signal; /* signal which killed the test program, or 0 if it hasn't crashed */
+	DsimRecorder *recorder; /* NULL unless recording, replaying or continuing on crash */
+	guint test_run_iteration; /* 1-based number of the current test run */
+	GHashTable/*<string, DsimCrashReport>*/ *crash_reports; /* unique crashes, keyed by signature; only used when continuing on crash */
+	GPtrArray/*<DsimCrashReport>*/ *crash_report_order; /* unowned; unique crashes in the order they were first seen */
+	guint num_crashes; /* total number of crashes, including duplicates */
+	guint num_pending_crashes; /* number of crashes whose signatures are still being built */
+	GArray/*<DsimResourceUsage>*/ *resource_usages; /* resource usage of the test program in each test run */
+	DsimMemorySampler *memory_sampler; /* NULL unless detecting leaks */
+	guint memory_sample_timeout_id;
+	GArray/*<LeakReport>*/ *leak_reports; /* test runs in which memory grew superlinearly */
+	DsimTraceWriter *trace_writer; /* NULL unless tracing */
+	DsimCoverageMap *coverage_map; /* NULL unless coverage guided */
+	guint coverage_run_new_entries; /* number of new coverage map entries found in the current test run */
+	guint num_coverage_runs; /* number of test runs which found new coverage */
+	DsimCorpus *corpus; /* NULL unless saving a corpus */
+	GRand *corpus_rand; /* chooses seed streams; separate from the simulation's generators, which the seed streams re-seed */
+	guint num_corpus_entries_to_resume; /* number of corpus entries to re-run before deriving new test runs */
+	guint next_corpus_entry_to_resume;
+	GArray/*<DsimCorpusSeed>*/ *iteration_seeds; /* seed stream for the current test run; NULL unless saving a corpus */
+	guint next_iteration_seed; /* index of the next seed in iteration_seeds to apply */
+	guint iteration_transitions; /* number of transitions executed in the current test run; only counted when saving a corpus */
+	guint num_new_corpus_entries; /* number of test runs saved to the corpus */
+	DsimGcovTracker *gcov_tracker; /* NULL unless tracking gcov coverage */
+	guint gcov_baseline_lines; /* number of lines covered before the first test run */
+	guint num_gcov_runs; /* number of test runs which gained gcov coverage */
+	gboolean gcov_unflushed_warning_shown; /* whether the test program has been warned about for not writing out its coverage when terminated */
+	GKeyFile *gcov_log; /* NULL unless logging gcov coverage */
 } MainData;
 
 static void remove_inactivity_timeout (MainData *data);
+static void machine_transition_executed_coverage_cb (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state,
+                                                    DfsmAstTransition *transition, const gchar *nickname, MainData *data);
+static void machine_transition_executed_corpus_cb (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state,
+                                                  DfsmAstTransition *transition, const gchar *nickname, MainData *data);
 
 static void
 main_data_clear (MainData *data)
@@ -180,6 +303,41 @@ main_data_clear (MainData *data)
 	g_clear_object (&data->connection);
 	g_free (data->dbus_address);
 	g_ptr_array_unref (data->simulated_objects);
+	g_clear_object (&data->recorder);
+	g_ptr_array_unref (data->crash_report_order);
+	g_hash_table_unref (data->crash_reports);
+	g_array_unref (data->resource_usages);
+	g_array_unref (data->leak_reports);
+
+	if (data->memory_sample_timeout_id != 0) {
+		g_source_remove (data->memory_sample_timeout_id);
+		data->memory_sample_timeout_id = 0;
+	}
+
+	dsim_memory_sampler_free (data->memory_sampler);
+
+	dsim_coverage_map_free (data->coverage_map);
+
+	if (data->iteration_seeds != NULL) {
+		g_array_unref (data->iteration_seeds);
+	}
+
+	if (data->corpus_rand != NULL) {
+		g_rand_free (data->corpus_rand);
+	}
+
+	dsim_corpus_free (data->corpus);
+	dsim_gcov_tracker_free (data->gcov_tracker);
+
+	if (data->gcov_log != NULL) {
+		g_key_file_free (data->gcov_log);
+	}
+
+	if (data->trace_writer != NULL) {
+		dfsm_trace_set_func (NULL, NULL);
+		dsim_trace_writer_free (data->trace_writer);
+		data->trace_writer = NULL;
+	}
 
 	remove_inactivity_timeout (data);
 
@@ -196,14 +354,20 @@ main_data_clear (MainData *data)
 		g_clear_object (&data->dbus_daemon);
 	}
 
+	g_clear_object (&data->bus_broker);
+
 	g_main_loop_unref (data->main_loop);
 }
 
 static void
 post_connection_closed (MainData *data)
 {
-	/* Kill the dbus-daemon instance. */
-	dsim_program_wrapper_kill (DSIM_PROGRAM_WRAPPER (data->dbus_daemon), FALSE);
+	/* Kill the dbus-daemon instance, or stop the built-in bus broker. */
+	if (data->dbus_daemon != NULL) {
+		dsim_program_wrapper_kill (DSIM_PROGRAM_WRAPPER (data->dbus_daemon), FALSE);
+	}
+
+	g_clear_object (&data->bus_broker);
 
 	/* Quit everything */
 	g_main_loop_quit (data->main_loop);
@@ -227,12 +391,155 @@ connection_close_cb (GObject *source_object, GAsyncResult *result, MainData *dat
 	post_connection_closed (data);
 }
 
+/* Seed the random number generators of all the simulated objects. Each object gets a different seed, so that identical objects don't behave
+ * identically. Object instances created by transitions are seeded from their template object when they're created. */
+static void
+seed_simulated_objects (MainData *data, guint32 seed)
+{
+	guint i;
+
+	for (i = 0; i < data->simulated_objects->len; i++) {
+		DfsmMachine *machine = dfsm_object_get_machine (g_ptr_array_index (data->simulated_objects, i));
+		dfsm_environment_set_random_seed (dfsm_machine_get_environment (machine), seed + i);
+	}
+}
+
+/* Apply any re-seedings in the current test run's seed stream which are due after the transitions executed so far. */
+static void
+apply_due_seeds (MainData *data)
+{
+	while (data->next_iteration_seed < data->iteration_seeds->len) {
+		const DsimCorpusSeed *seed = &g_array_index (data->iteration_seeds, DsimCorpusSeed, data->next_iteration_seed);
+
+		if (seed->transition > data->iteration_transitions) {
+			break;
+		}
+
+		g_debug ("Re-seeding random number generators with %u after %u transitions of test run %u.", seed->seed, seed->transition,
+		         data->test_run_iteration);
+		seed_simulated_objects (data, seed->seed);
+
+		data->next_iteration_seed++;
+	}
+}
+
+/* Seed streams are keyed on the number of transitions executed, rather than on time, so that re-running a corpus entry re-seeds at the same point
+ * in the simulation however quickly the test program runs. */
+static void
+machine_transition_executed_corpus_cb (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state,
+                                       DfsmAstTransition *transition, const gchar *nickname, MainData *data)
+{
+	if (data->iteration_seeds == NULL) {
+		return;
+	}
+
+	data->iteration_transitions++;
+	apply_due_seeds (data);
+}
+
+/* Choose the seed stream for a new test run when saving a corpus: re-run the next resumed corpus entry if there is one; otherwise either derive a
+ * new seed stream from a random corpus entry or start from a fresh seed. Then seed the simulation's random number generators from the stream. */
+static void
+start_iteration_seeds (MainData *data)
+{
+	const DsimCorpusEntry *entry;
+	DsimCorpusSeed seed;
+
+	if (data->corpus == NULL) {
+		return;
+	}
+
+	if (data->iteration_seeds != NULL) {
+		g_array_unref (data->iteration_seeds);
+	}
+
+	if (data->next_corpus_entry_to_resume < data->num_corpus_entries_to_resume) {
+		entry = dsim_corpus_get_entry (data->corpus, data->next_corpus_entry_to_resume++);
+		data->iteration_seeds = g_array_sized_new (FALSE, FALSE, sizeof (DsimCorpusSeed), entry->seeds->len);
+		g_array_append_vals (data->iteration_seeds, entry->seeds->data, entry->seeds->len);
+
+		g_message (_("Re-running corpus entry ‘%s’ (%u of %u) in test run %u."), entry->name, data->next_corpus_entry_to_resume,
+		           data->num_corpus_entries_to_resume, data->test_run_iteration);
+	} else if (dsim_corpus_get_size (data->corpus) > 0 && g_rand_double (data->corpus_rand) < CORPUS_MUTATION_PROBABILITY) {
+		entry = dsim_corpus_get_entry (data->corpus, g_rand_int_range (data->corpus_rand, 0, dsim_corpus_get_size (data->corpus)));
+		data->iteration_seeds = dsim_corpus_entry_mutate (entry, data->corpus_rand);
+
+		g_debug ("Deriving test run %u from corpus entry ‘%s’.", data->test_run_iteration, entry->name);
+	} else {
+		seed.transition = 0;
+		seed.seed = g_rand_int (data->corpus_rand);
+
+		data->iteration_seeds = g_array_new (FALSE, FALSE, sizeof (DsimCorpusSeed));
+		g_array_append_val (data->iteration_seeds, seed);
+	}
+
+	g_debug ("Seeding random number generators with %u for test run %u.", g_array_index (data->iteration_seeds, DsimCorpusSeed, 0).seed,
+	         data->test_run_iteration);
+
+	data->iteration_transitions = 0;
+	data->next_iteration_seed = 0;
+	apply_due_seeds (data);
+}
+
+/* Save the current test run to the corpus, if saving one. Returns the corpus entry it was saved as, or NULL. */
+static const DsimCorpusEntry *
+save_to_corpus (MainData *data, DsimCorpusReason reason)
+{
+	GArray/*<DsimCorpusSeed>*/ *applied_seeds;
+	const DsimCorpusEntry *entry;
+	guint old_size;
+	gchar *reasons;
+	GError *error = NULL;
+
+	if (data->corpus == NULL || data->iteration_seeds == NULL) {
+		return NULL;
+	}
+
+	/* Only the seeds which have been applied so far can have affected the test run. */
+	applied_seeds = g_array_sized_new (FALSE, FALSE, sizeof (DsimCorpusSeed), data->next_iteration_seed);
+	g_array_append_vals (applied_seeds, data->iteration_seeds->data, data->next_iteration_seed);
+
+	old_size = dsim_corpus_get_size (data->corpus);
+	entry = dsim_corpus_add (data->corpus, applied_seeds, data->iteration_transitions, reason, &error);
+
+	g_array_unref (applied_seeds);
+
+	if (error != NULL) {
+		g_message (_("Error saving test run %u to the corpus: %s"), data->test_run_iteration, error->message);
+		g_error_free (error);
+		return NULL;
+	}
+
+	if (dsim_corpus_get_size (data->corpus) > old_size) {
+		data->num_new_corpus_entries++;
+	}
+
+	reasons = dsim_corpus_reasons_to_string (entry->reasons);
+	g_message (_("Saved test run %u to corpus entry ‘%s’ (%s)."), data->test_run_iteration, entry->name, reasons);
+	g_free (reasons);
+
+	return entry;
+}
+
+static void
+print_corpus_summary (MainData *data)
+{
+	if (data->corpus == NULL) {
+		return;
+	}
+
+	g_print (_("Saved %u new test runs to the corpus, which now has %u entries."), data->num_new_corpus_entries,
+	         dsim_corpus_get_size (data->corpus));
+	g_print ("\n");
+}
+
 static void restart_simulation (MainData *data);
 
 static gboolean
 test_inactivity_timeout_cb (MainData *data)
 {
 	/* The current test run has hit a timeout; move on to the next test run. */
+	save_to_corpus (data, DSIM_CORPUS_REASON_TIMEOUT);
 	restart_simulation (data);
 	return FALSE;
 }
@@ -265,17 +572,42 @@ simulated_object_dbus_activity_count_notify_cb (GObject *obj, GParamSpec *pspec,
 	}
 }
 
+/* Log how well the arbitrary transitions in the last test run kept to their schedule, then reset the statistics for the next one. This has to be
+ * called before the objects are unregistered or reset, so that the per-object tick counts are still available. */
+static void
+log_scheduler_statistics (void)
+{
+	DfsmSchedulerStatistics statistics;
+
+	dfsm_scheduler_get_statistics (&statistics);
+
+	if (statistics.num_ticks > 0) {
+		g_message (_("Scheduled %" G_GUINT64_FORMAT " arbitrary transition ticks in %" G_GUINT64_FORMAT " wakeups (at most %u per wakeup); "
+		             "lateness mean %" G_GINT64_FORMAT " µs, max %" G_GINT64_FORMAT " µs, jitter %.0f µs; "
+		             "%" G_GUINT64_FORMAT "–%" G_GUINT64_FORMAT " ticks per object."),
+		           statistics.num_ticks, statistics.num_wakeups, statistics.max_batch_size,
+		           statistics.mean_lateness, statistics.max_lateness, statistics.lateness_stddev,
+		           statistics.min_ticks_per_object, statistics.max_ticks_per_object);
+	}
+
+	dfsm_scheduler_reset_statistics ();
+}
+
 static void
 unregister_objects_and_close_connection (MainData *data)
 {
 	guint i;
 
+	log_scheduler_statistics ();
+
 	/* Unregister all our DfsmObjects. */
 	for (i = 0; i < data->simulated_objects->len; i++) {
 		DfsmObject *simulated_object = g_ptr_array_index (data->simulated_objects, i);
 		dfsm_object_unregister_on_bus (simulated_object);
 
 		g_signal_handlers_disconnect_by_func (simulated_object, simulated_object_dbus_activity_count_notify_cb, data);
+		g_signal_handlers_disconnect_by_func (dfsm_object_get_machine (simulated_object), machine_transition_executed_coverage_cb, data);
+		g_signal_handlers_disconnect_by_func (dfsm_object_get_machine (simulated_object), machine_transition_executed_corpus_cb, data);
 	}
 
 	/* Disconnect from the bus. */
@@ -317,6 +649,7 @@ kill_program_cb (MainData *data)
 
 	g_message (_("Killing test program (with SIGKILL) due to it not responding to termination requests (SIGTERM)."));
 
+	data->test_program_sigkilled = TRUE;
 	dsim_program_wrapper_kill (DSIM_PROGRAM_WRAPPER (data->test_program), TRUE);
 
 done:
@@ -373,6 +706,15 @@ spawn_test_program (MainData *data)
 {
 	GError *error = NULL;
 
+	data->test_run_iteration++;
+
+	if (data->recorder != NULL) {
+		dsim_recorder_start_iteration (data->recorder, data->test_run_iteration);
+	}
+
+	start_iteration_seeds (data);
+
+	data->test_program_sigkilled = FALSE;
 	dsim_program_wrapper_spawn (DSIM_PROGRAM_WRAPPER (data->test_program), &error);
 
 	if (data->num_test_runs_remaining > 0) {
@@ -405,6 +747,7 @@ restart_simulation (MainData *data)
 		return;
 	}
 
+	log_scheduler_statistics ();
 	g_message (_("Restarting simulation."));
 
 	/* Stop the test program and reset all our simulation objects. */
@@ -428,20 +771,486 @@ restart_simulation_idle_cb (MainData *data)
 	return FALSE;
 }
 
+typedef struct {
+	MainData *data;
+	gint status;
+	guint iteration;
+	GPtrArray/*<string>*/ *history;
+} PendingCrash;
+
+static void
+crash_signature_built_cb (GObject *source_object, GAsyncResult *async_result, PendingCrash *crash)
+{
+	MainData *data = crash->data;
+	gchar *signature;
+	DsimCrashReport *report;
+
+	signature = dsim_crash_build_signature_finish (async_result);
+	report = g_hash_table_lookup (data->crash_reports, signature);
+
+	if (report != NULL) {
+		/* Signatures aren't necessarily built in the order the crashes happened. */
+		report->hit_count++;
+		report->first_iteration = MIN (report->first_iteration, crash->iteration);
+		report->last_iteration = MAX (report->last_iteration, crash->iteration);
+
+		g_message (_("Test program crashed in test run %u with a known signature (seen %u times): %s"), crash->iteration,
+		           report->hit_count, signature);
+	} else {
+		report = dsim_crash_report_new (signature, crash->status, random_seed, crash->iteration, crash->history);
+
+		g_hash_table_insert (data->crash_reports, report->signature, report);
+		g_ptr_array_add (data->crash_report_order, report);
+
+		g_message (_("Test program crashed in test run %u with a new signature: %s"), crash->iteration, signature);
+	}
+
+	g_free (signature);
+
+	data->num_pending_crashes--;
+
+	g_ptr_array_unref (crash->history);
+	g_slice_free (PendingCrash, crash);
+}
+
+static void
+record_crash (MainData *data, DsimProgramWrapper *wrapper, gint status)
+{
+	gchar **stderr_lines;
+	PendingCrash *crash;
+
+	data->num_crashes++;
+	data->num_pending_crashes++;
+
+	crash = g_slice_new (PendingCrash);
+	crash->data = data;
+	crash->status = status;
+	crash->iteration = data->test_run_iteration;
+
+	/* Describe the conversation leading up to the crash now, since the recorder's history is cleared when the next test run starts. */
+	crash->history = g_ptr_array_new_with_free_func (g_free);
+
+	if (data->recorder != NULL) {
+		GPtrArray/*<GVariant>*/ *records;
+		guint i;
+
+		records = dsim_recorder_dup_history (data->recorder);
+
+		for (i = 0; i < records->len; i++) {
+			g_ptr_array_add (crash->history, dsim_record_to_string (g_ptr_array_index (records, i)));
+		}
+
+		g_ptr_array_unref (records);
+	}
+
+	/* De-duplicate the crash by its stack signature. Building the signature may involve running gdb on a core dump, so it's done asynchronously
+	 * to avoid blocking the simulation. */
+	stderr_lines = dsim_program_wrapper_dup_stderr_tail (wrapper);
+	dsim_crash_build_signature_async (status, (const gchar * const *) stderr_lines, dsim_program_wrapper_get_working_directory (wrapper),
+	                                  dsim_program_wrapper_get_program_name (wrapper), dsim_program_wrapper_get_process_id (wrapper),
+	                                  (GAsyncReadyCallback) crash_signature_built_cb, crash);
+	g_strfreev (stderr_lines);
+}
+
+static void
+print_crash_summary (MainData *data)
+{
+	guint i, j;
+
+	if (data->num_crashes == 0) {
+		return;
+	}
+
+	g_print (_("Test program crashed %u times, with %u unique crash signatures:"), data->num_crashes, data->crash_report_order->len);
+	g_print ("\n");
+
+	for (i = 0; i < data->crash_report_order->len; i++) {
+		DsimCrashReport *report = g_ptr_array_index (data->crash_report_order, i);
+
+		g_print ("\n");
+		g_print (_("Crash %u: %s"), i + 1, report->signature);
+		g_print ("\n");
+		g_print (_("  Hit count: %u (first in test run %u, last in test run %u)"), report->hit_count, report->first_iteration,
+		         report->last_iteration);
+		g_print ("\n");
+		g_print (_("  Random seed: %" G_GINT64_FORMAT), report->random_seed);
+		g_print ("\n");
+		g_print (_("  Exit status: %i"), report->status);
+		g_print ("\n");
+
+		if (report->history->len > 0) {
+			g_print (_("  Last D-Bus conversation records before first crash:"));
+			g_print ("\n");
+
+			for (j = 0; j < report->history->len; j++) {
+				g_print ("    %s\n", (const gchar *) g_ptr_array_index (report->history, j));
+			}
+		}
+	}
+}
+
+static void
+test_program_resource_usage_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
+{
+	DsimResourceUsage usage;
+
+	/* This is connected for the whole simulation (unlike test_program_died_cb()), so sees every test run. */
+	usage = *dsim_program_wrapper_get_resource_usage (wrapper);
+	usage.iteration = data->test_run_iteration;
+
+	g_debug ("Test run %u resource usage: user time %f s, system time %f s, max. RSS %li KiB, %li voluntary and %li involuntary context "
+	         "switches, max. %u open FDs.", usage.iteration, usage.user_time, usage.system_time, usage.max_rss, usage.voluntary_context_switches,
+	         usage.involuntary_context_switches, usage.max_open_fds);
+
+	g_array_append_val (data->resource_usages, usage);
+}
+
+/* Count the simulation events which have happened so far: transitions executed by all the objects' machines, and D-Bus messages received by them.
+ * This is only meaningful relative to another count. */
+static guint64
+count_simulation_events (MainData *data)
+{
+	guint64 num_events = 0;
+	guint i;
+
+	for (i = 0; i < data->simulated_objects->len; i++) {
+		DfsmObject *simulated_object = g_ptr_array_index (data->simulated_objects, i);
+
+		num_events += dfsm_machine_get_transition_count (dfsm_object_get_machine (simulated_object));
+		num_events += dfsm_object_get_dbus_activity_count (simulated_object);
+	}
+
+	return num_events;
+}
+
+static gboolean
+memory_sample_cb (MainData *data)
+{
+	dsim_memory_sampler_add_sample (data->memory_sampler, dsim_program_wrapper_get_process_id (DSIM_PROGRAM_WRAPPER (data->test_program)),
+	                                count_simulation_events (data));
+
+	return TRUE;
+}
+
+static void
+test_program_memory_spawn_end_cb (DsimProgramWrapper *wrapper, GPid pid, MainData *data)
+{
+	if (pid == 0) {
+		return;
+	}
+
+	/* Start sampling the new test run's memory usage. */
+	dsim_memory_sampler_reset (data->memory_sampler);
+
+	if (data->memory_sample_timeout_id == 0) {
+		data->memory_sample_timeout_id = g_timeout_add (MEMORY_SAMPLE_INTERVAL, (GSourceFunc) memory_sample_cb, data);
+	}
+}
+
+static void
+test_program_memory_died_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
+{
+	LeakReport report;
+
+	if (data->memory_sample_timeout_id != 0) {
+		g_source_remove (data->memory_sample_timeout_id);
+		data->memory_sample_timeout_id = 0;
+	}
+
+	/* Fit a trend to the memory usage over the test run, and flag it if it's superlinear. */
+	if (dsim_memory_sampler_calculate_trend (data->memory_sampler, &report.trend) == FALSE) {
+		g_debug ("Too few memory samples to calculate a trend for test run %u.", data->test_run_iteration);
+		return;
+	}
+
+	g_debug ("Test run %u memory trend over %" G_GUINT64_FORMAT " events: RSS grew %li KiB (%f KiB/event, exponent %f); heap grew %li KiB "
+	         "(%f KiB/event, exponent %f).", data->test_run_iteration, report.trend.num_events, report.trend.rss_growth, report.trend.rss_slope,
+	         report.trend.rss_exponent, report.trend.heap_growth, report.trend.heap_slope, report.trend.heap_exponent);
+
+	if (report.trend.superlinear == TRUE) {
+		g_message (_("Test program memory usage grew superlinearly in test run %u (RSS exponent %.2f, heap exponent %.2f)."),
+		           data->test_run_iteration, report.trend.rss_exponent, report.trend.heap_exponent);
+
+		report.iteration = data->test_run_iteration;
+		g_array_append_val (data->leak_reports, report);
+	}
+}
+
+static void
+print_leak_summary (MainData *data)
+{
+	guint i;
+
+	if (data->leak_reports->len == 0) {
+		return;
+	}
+
+	g_print (_("Test program memory usage grew superlinearly in %u test runs (random seed: %" G_GINT64_FORMAT "):"), data->leak_reports->len,
+	         random_seed);
+	g_print ("\n");
+
+	for (i = 0; i < data->leak_reports->len; i++) {
+		const LeakReport *report = &g_array_index (data->leak_reports, LeakReport, i);
+
+		g_print (_("  Test run %u: RSS grew %li KiB (exponent %.2f), heap grew %li KiB (exponent %.2f) over %" G_GUINT64_FORMAT " events"),
+		         report->iteration, report->trend.rss_growth, report->trend.rss_exponent, report->trend.heap_growth, report->trend.heap_exponent,
+		         report->trend.num_events);
+		g_print ("\n");
+	}
+}
+
+/* Reward the transitions each simulated object has executed since the last update with the number of new coverage map entries the test program has
+ * hit since then. A reward of 0 just forgets the transitions. */
+static void
+reward_coverage (MainData *data)
+{
+	guint i, new_entries;
+
+	new_entries = dsim_coverage_map_update (data->coverage_map);
+	data->coverage_run_new_entries += new_entries;
+
+	for (i = 0; i < data->simulated_objects->len; i++) {
+		dfsm_machine_reward_recent_transitions (dfsm_object_get_machine (g_ptr_array_index (data->simulated_objects, i)), new_entries);
+	}
+}
+
+/* The coverage map is sampled after every transition, rather than periodically, so that new coverage is credited to the transitions which most
+ * recently had effects on the bus, and the weights are up to date whenever the next transition is chosen. The transition which was just executed
+ * isn't credited, since its effects haven't been output yet. */
+static void
+machine_transition_executed_coverage_cb (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state,
+                                         DfsmAstTransition *transition, const gchar *nickname, MainData *data)
+{
+	reward_coverage (data);
+}
+
+static void
+test_program_coverage_spawn_end_cb (DsimProgramWrapper *wrapper, GPid pid, MainData *data)
+{
+	guint i;
+
+	if (pid == 0) {
+		return;
+	}
+
+	/* Don't credit the new test run's coverage to transitions from the previous one. */
+	dsim_coverage_map_clear (data->coverage_map);
+	data->coverage_run_new_entries = 0;
+
+	for (i = 0; i < data->simulated_objects->len; i++) {
+		dfsm_machine_reward_recent_transitions (dfsm_object_get_machine (g_ptr_array_index (data->simulated_objects, i)), 0.0);
+	}
+}
+
+static void
+test_program_coverage_died_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
+{
+	/* Pick up anything the test program covered between the last transition and exiting. */
+	reward_coverage (data);
+
+	g_debug ("Test run %u found %u new coverage map entries; %u edges covered in total.", data->test_run_iteration,
+	         data->coverage_run_new_entries, dsim_coverage_map_get_num_edges (data->coverage_map));
+
+	if (data->coverage_run_new_entries > 0) {
+		data->num_coverage_runs++;
+		save_to_corpus (data, DSIM_CORPUS_REASON_COVERAGE);
+	}
+}
+
+static void
+print_coverage_summary (MainData *data)
+{
+	if (data->coverage_map == NULL) {
+		return;
+	}
+
+	g_print (_("Test program covered %u edges, with new coverage found in %u of %u test runs (random seed: %" G_GINT64_FORMAT ")."),
+	         dsim_coverage_map_get_num_edges (data->coverage_map), data->num_coverage_runs, data->test_run_iteration, random_seed);
+	g_print ("\n");
+}
+
+static void
+test_program_gcov_died_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
+{
+	DsimGcovDelta delta;
+	const DsimCorpusEntry *entry;
+	gchar *group_name;
+
+	/* gcov only writes out a program's coverage when it exits normally or calls __gcov_dump(), so a test program which is simply killed by the
+	 * SIGTERM bendy-bus sends at the end of each test run loses the whole test run's coverage. */
+	if (WIFSIGNALED (status) && WTERMSIG (status) == SIGTERM && data->gcov_unflushed_warning_shown == FALSE) {
+		g_message (_("Test program was killed by SIGTERM, so won’t have written out its gcov coverage. It should handle SIGTERM by calling "
+		             "__gcov_dump() and exiting."));
+		data->gcov_unflushed_warning_shown = TRUE;
+	}
+
+	/* The test program has written out its coverage as it exited, so see what it gained. */
+	dsim_gcov_tracker_update (data->gcov_tracker, &delta);
+
+	if (delta.new_lines == 0) {
+		g_debug ("Test run %u gained no gcov coverage.", data->test_run_iteration);
+		dsim_gcov_delta_clear (&delta);
+		return;
+	}
+
+	data->num_gcov_runs++;
+
+	g_message (_("Test run %u covered %u new lines and %u new functions in %u files."), data->test_run_iteration, delta.new_lines,
+	           delta.new_functions, delta.files->len);
+
+	entry = save_to_corpus (data, DSIM_CORPUS_REASON_COVERAGE);
+
+	/* Record which seeds gained the coverage. */
+	if (data->gcov_log != NULL) {
+		group_name = g_strdup_printf ("Iteration %u", data->test_run_iteration);
+
+		g_key_file_set_int64 (data->gcov_log, group_name, "RandomSeed", random_seed);
+
+		if (data->iteration_seeds != NULL) {
+			const DsimCorpusSeed *seed = &g_array_index (data->iteration_seeds, DsimCorpusSeed, 0);
+
+			g_key_file_set_uint64 (data->gcov_log, group_name, "IterationSeed", seed->seed);
+		}
+
+		if (entry != NULL) {
+			g_key_file_set_string (data->gcov_log, group_name, "CorpusEntry", entry->name);
+		}
+
+		g_key_file_set_integer (data->gcov_log, group_name, "NewLines", delta.new_lines);
+		g_key_file_set_integer (data->gcov_log, group_name, "NewFunctions", delta.new_functions);
+		g_key_file_set_string_list (data->gcov_log, group_name, "Files", (const gchar * const *) delta.files->pdata, delta.files->len);
+
+		g_free (group_name);
+	}
+
+	dsim_gcov_delta_clear (&delta);
+}
+
+static void
+print_gcov_summary (MainData *data)
+{
+	guint num_lines;
+
+	if (data->gcov_tracker == NULL) {
+		return;
+	}
+
+	num_lines = dsim_gcov_tracker_get_num_lines (data->gcov_tracker);
+
+	g_print (_("Test program covered %u lines (%u new) in %u functions, with new coverage found in %u of %u test runs (random seed: %"
+	           G_GINT64_FORMAT ")."), num_lines, num_lines - data->gcov_baseline_lines, dsim_gcov_tracker_get_num_functions (data->gcov_tracker),
+	         data->num_gcov_runs, data->test_run_iteration, random_seed);
+	g_print ("\n");
+}
+
+static void
+test_program_trace_spawn_end_cb (DsimProgramWrapper *wrapper, GPid pid, MainData *data)
+{
+	gchar *detail;
+
+	if (pid == 0) {
+		return;
+	}
+
+	detail = g_strdup_printf ("test run %u, PID %i", data->test_run_iteration, (gint) pid);
+	dsim_trace_writer_add_event (data->trace_writer, DFSM_TRACE_PHASE_INSTANT, "test-program", "spawn", detail);
+	g_free (detail);
+}
+
+static void
+test_program_trace_died_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
+{
+	gchar *detail;
+
+	if (WIFSIGNALED (status)) {
+		detail = g_strdup_printf ("test run %u, killed by signal %i", data->test_run_iteration, WTERMSIG (status));
+	} else {
+		detail = g_strdup_printf ("test run %u, exit status %i", data->test_run_iteration, WEXITSTATUS (status));
+	}
+
+	dsim_trace_writer_add_event (data->trace_writer, DFSM_TRACE_PHASE_INSTANT, "test-program", "exit", detail);
+	g_free (detail);
+}
+
+static gboolean
+write_resource_usage_file (GArray/*<DsimResourceUsage>*/ *resource_usages, const gchar *path, GError **error)
+{
+	GKeyFile *key_file;
+	guint i;
+	gboolean success;
+
+	key_file = g_key_file_new ();
+
+	dsim_resource_usage_summarise (resource_usages, key_file, "Summary");
+
+	for (i = 0; i < resource_usages->len; i++) {
+		const DsimResourceUsage *usage = &g_array_index (resource_usages, DsimResourceUsage, i);
+		gchar *group_name;
+
+		group_name = g_strdup_printf ("Iteration %u", usage->iteration);
+		dsim_resource_usage_to_key_file (usage, key_file, group_name);
+		g_free (group_name);
+	}
+
+	success = g_key_file_save_to_file (key_file, path, error);
+
+	g_key_file_free (key_file);
+
+	return success;
+}
+
+/* Work out whether the test program crashed, rather than exiting of its own accord or being terminated by us. */
+static gboolean
+test_program_crashed (MainData *data, DsimProgramWrapper *wrapper, gint status)
+{
+	gchar **stderr_lines;
+	gboolean crashed;
+
+	if (WIFSIGNALED (status)) {
+		return !(WTERMSIG (status) == SIGTERM || WTERMSIG (status) == SIGINT ||
+		         (WTERMSIG (status) == SIGKILL && data->test_program_sigkilled == TRUE));
+	} else if (WIFEXITED (status) == FALSE || WEXITSTATUS (status) == 0) {
+		return FALSE;
+	}
+
+	/* The sanitisers report errors and then exit with a non-zero status by default, rather than aborting. */
+	stderr_lines = dsim_program_wrapper_dup_stderr_tail (wrapper);
+	crashed = dsim_crash_has_sanitizer_report ((const gchar * const *) stderr_lines);
+	g_strfreev (stderr_lines);
+
+	return crashed;
+}
+
 static void
 test_program_died_cb (DsimProgramWrapper *wrapper, gint status, MainData *data)
 {
-	if (WIFEXITED (status) || (WIFSIGNALED (status) && (WTERMSIG (status) == SIGTERM || WTERMSIG (status) == SIGINT))) {
+	if (test_program_crashed (data, wrapper, status) == FALSE) {
 		/* Exited normally: proceed to the next test run. However, if bendy-bus was signalled beforehand, ignore the test program exiting
 		 * and continue to close ourselves. */
 		if (data->exit_signal == EXIT_SIGNAL_INVALID) {
 			/* We have to do this in an idle callback so that we don't try to re-spawn the test program while it's still closing. */
 			g_idle_add ((GSourceFunc) restart_simulation_idle_cb, data);
 		}
+	} else if (continue_on_crash == TRUE && data->exit_signal == EXIT_SIGNAL_INVALID) {
+		/* Crashed, but we've been asked to carry on: note the crash and move on to the next test run. The first crash's signal is kept for
+		 * --exit-with-crash-status. */
+		if (WIFSIGNALED (status) && data->test_program_crash_signal == 0) {
+			data->test_program_crash_signal = WTERMSIG (status);
+		}
+
+		record_crash (data, wrapper, status);
+		save_to_corpus (data, DSIM_CORPUS_REASON_CRASH);
+
+		g_idle_add ((GSourceFunc) restart_simulation_idle_cb, data);
 	} else {
 		/* Crashed: stop the entire simulation. */
 		g_message (_("Stopping simulation due to test program crashing (status: %i)."), status);
 
+		if (WIFSIGNALED (status)) {
+			data->test_program_crash_signal = WTERMSIG (status);
+		}
+
+		save_to_corpus (data, DSIM_CORPUS_REASON_CRASH);
 		stop_simulation (data);
 	}
 }
@@ -506,7 +1315,7 @@ start_simulation (MainData *data)
 	/* The simulation's finished when either:
 	 *  • We've run for at least run_time seconds (over all test runs).
 	 *  • We've run at least run_iters number of iterations.
-	 *  • The test program crashes.
+	 *  • The test program crashes (unless continue_on_crash is set).
 	 *  • The dbus-daemon crashes or exits normally (this should never happen).
 	 *
 	 * A single test run is finished when either:
@@ -601,6 +1410,17 @@ connection_created_cb (GObject *source_object, GAsyncResult *result, MainData *d
 		data->outstanding_registration_callbacks++;
 
 		g_signal_connect (simulated_object, "notify::dbus-activity-count", (GCallback) simulated_object_dbus_activity_count_notify_cb, data);
+
+		if (data->coverage_map != NULL) {
+			g_signal_connect (dfsm_object_get_machine (simulated_object), "transition-executed",
+			                  (GCallback) machine_transition_executed_coverage_cb, data);
+		}
+
+		if (data->corpus != NULL) {
+			g_signal_connect (dfsm_object_get_machine (simulated_object), "transition-executed",
+			                  (GCallback) machine_transition_executed_corpus_cb, data);
+		}
+
 		dfsm_object_register_on_bus (simulated_object, data->connection, (GAsyncReadyCallback) object_registered_cb, data);
 	}
 
@@ -622,14 +1442,16 @@ forward_envp_pair (GPtrArray/*<string>*/ *envp, const gchar *key)
 	}
 }
 
+/* Called once the bus is up and running (whether it's a dbus-daemon instance or the built-in broker) to set up the test program and connect the
+ * simulated objects to the bus. */
 static void
-dbus_daemon_notify_bus_address_cb (GObject *gobject, GParamSpec *pspec, MainData *data)
+bus_address_ready (MainData *data, const gchar *bus_address)
 {
 	GPtrArray/*<string>*/ *test_program_envp;
 	gchar *envp_pair;
 
 	g_assert (data->dbus_address == NULL);
-	data->dbus_address = g_strdup (dsim_dbus_daemon_get_bus_address (data->dbus_daemon));
+	data->dbus_address = g_strdup (bus_address);
 
 	g_message (_("Note: Simulated bus has address: %s"), data->dbus_address);
 
@@ -683,6 +1505,11 @@ dbus_daemon_notify_bus_address_cb (GObject *gobject, GParamSpec *pspec, MainData
 	}
 	g_ptr_array_add (test_program_envp, envp_pair);
 
+	/* Tell the test program where to record its coverage. */
+	if (data->coverage_map != NULL) {
+		g_ptr_array_add (test_program_envp, dsim_coverage_map_build_envp_pair (data->coverage_map));
+	}
+
 	/* Copy the environment pairs set on the command line. */
 	if (test_program_environment != NULL) {
 		guint i;
@@ -694,6 +1521,26 @@ dbus_daemon_notify_bus_address_cb (GObject *gobject, GParamSpec *pspec, MainData
 	}
 
 	data->test_program = dsim_test_program_new (data->working_directory_file, data->test_program_name, data->test_program_argv, test_program_envp);
+	g_signal_connect (data->test_program, "process-died", (GCallback) test_program_resource_usage_cb, data);
+
+	if (data->memory_sampler != NULL) {
+		g_signal_connect (data->test_program, "spawn-end", (GCallback) test_program_memory_spawn_end_cb, data);
+		g_signal_connect (data->test_program, "process-died", (GCallback) test_program_memory_died_cb, data);
+	}
+
+	if (data->coverage_map != NULL) {
+		g_signal_connect (data->test_program, "spawn-end", (GCallback) test_program_coverage_spawn_end_cb, data);
+		g_signal_connect (data->test_program, "process-died", (GCallback) test_program_coverage_died_cb, data);
+	}
+
+	if (data->gcov_tracker != NULL) {
+		g_signal_connect (data->test_program, "process-died", (GCallback) test_program_gcov_died_cb, data);
+	}
+
+	if (data->trace_writer != NULL) {
+		g_signal_connect (data->test_program, "spawn-end", (GCallback) test_program_trace_spawn_end_cb, data);
+		g_signal_connect (data->test_program, "process-died", (GCallback) test_program_trace_died_cb, data);
+	}
 
 	g_ptr_array_unref (test_program_envp);
 
@@ -701,6 +1548,12 @@ dbus_daemon_notify_bus_address_cb (GObject *gobject, GParamSpec *pspec, MainData
 	g_dbus_connection_new_for_address (data->dbus_address,
 	                                   G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION, NULL, NULL,
 	                                   (GAsyncReadyCallback) connection_created_cb, data);
+}
+
+static void
+dbus_daemon_notify_bus_address_cb (GObject *gobject, GParamSpec *pspec, MainData *data)
+{
+	bus_address_ready (data, dsim_dbus_daemon_get_bus_address (data->dbus_daemon));
 
 	/* We don't want this to fire again. */
 	g_signal_handlers_disconnect_by_func (gobject, dbus_daemon_notify_bus_address_cb, data);
@@ -877,7 +1730,11 @@ prepare_dbus_daemon_working_directory (GFile **test_program_working_directory_ou
 		goto error;
 	}
 
-	/* Create the default config.xml file. */
+	/* Create the default config.xml file. The built-in bus broker doesn't need one. */
+	if (use_bus_broker == TRUE) {
+		goto success;
+	}
+
 	tmp_dir_file_daemon_config = g_file_get_child (tmp_dir_file_daemon, "config.xml");
 
 	config_file = build_config_file (tmp_dir_file_daemon, &config_file_length, system_bus);
@@ -889,7 +1746,7 @@ prepare_dbus_daemon_working_directory (GFile **test_program_working_directory_ou
 		goto error;
 	}
 
-	/* Success! */
+success:
 	*test_program_working_directory_out = tmp_dir_file_test_program;
 	*dbus_daemon_working_directory_out = tmp_dir_file_daemon;
 	*config_file_out = tmp_dir_file_daemon_config;
@@ -921,6 +1778,87 @@ error:
 	}
 }
 
+/* Create num_instances instances of each object in simulated_objects, exported at object paths of the form ‘<object path>/Instance<N>’, and append
+ * them to simulated_objects. The instances share their simulation code with the original objects, so are cheap; the memory they take up is logged so
+ * that it can be checked. */
+static void
+instantiate_simulated_objects (GPtrArray/*<DfsmObject>*/ *simulated_objects, guint num_instances)
+{
+	guint i, j, num_templates;
+	glong rss_before, heap_before, rss_after, heap_after;
+	gboolean have_memory_usage;
+
+	num_templates = simulated_objects->len;
+
+	if (num_templates == 0 || num_instances == 0) {
+		return;
+	}
+
+	have_memory_usage = dsim_memory_usage_read (getpid (), &rss_before, &heap_before);
+
+	for (i = 0; i < num_templates; i++) {
+		DfsmObject *template_object = g_ptr_array_index (simulated_objects, i);
+		const gchar *template_path = dfsm_object_get_object_path (template_object);
+
+		for (j = 0; j < num_instances; j++) {
+			gchar *object_path;
+
+			/* Avoid a double slash if the template is at the root path. */
+			object_path = g_strdup_printf ("%s/Instance%u", (strcmp (template_path, "/") == 0) ? "" : template_path, j);
+			g_ptr_array_add (simulated_objects, dfsm_object_instantiate (template_object, object_path));
+			g_free (object_path);
+		}
+	}
+
+	if (have_memory_usage == TRUE && dsim_memory_usage_read (getpid (), &rss_after, &heap_after) == TRUE) {
+		guint total_instances = num_templates * num_instances;
+
+		g_message (_("Created %u object instances using %li KiB of memory (%.2f KiB per instance) and %li KiB of heap (%.2f KiB per instance)."),
+		           total_instances, rss_after - rss_before, (gdouble) (rss_after - rss_before) / total_instances,
+		           heap_after - heap_before, (gdouble) (heap_after - heap_before) / total_instances);
+	} else {
+		g_message (_("Created %u object instances."), num_templates * num_instances);
+	}
+}
+
+static void
+target_reached_cb (DfsmMachine *machine, GParamSpec *pspec, DfsmObject *simulated_object)
+{
+	if (dfsm_machine_get_target_reached (machine) == TRUE) {
+		g_message (_("Object ‘%s’ reached target state ‘%s’ after %u transitions."), dfsm_object_get_object_path (simulated_object),
+		           dfsm_machine_get_state_name (machine, dfsm_machine_get_target_state (machine)),
+		           dfsm_machine_get_transition_count (machine));
+	}
+}
+
+/* Set the target state of each simulated object which has a state called @state_name.
+ *
+ * Return value: %TRUE if at least one object has the state, %FALSE otherwise */
+static gboolean
+set_target_state (GPtrArray/*<DfsmObject>*/ *simulated_objects, const gchar *state_name)
+{
+	gboolean found = FALSE;
+	guint i;
+
+	for (i = 0; i < simulated_objects->len; i++) {
+		DfsmObject *simulated_object = g_ptr_array_index (simulated_objects, i);
+		DfsmMachine *machine = dfsm_object_get_machine (simulated_object);
+		DfsmMachineStateNumber state;
+
+		state = dfsm_machine_look_up_state (machine, state_name);
+
+		if (state == DFSM_MACHINE_INVALID_STATE) {
+			continue;
+		}
+
+		g_signal_connect (machine, "notify::target-reached", (GCallback) target_reached_cb, simulated_object);
+		dfsm_machine_set_target_state (machine, state);
+		found = TRUE;
+	}
+
+	return found;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -937,6 +1875,11 @@ main (int argc, char *argv[])
 	gchar *time_str, *command_line, *log_header, *seed_str;
 	GDateTime *date_time;
 	GFile *working_directory_file, *dbus_daemon_config_file;
+	DsimRecorder *recorder = NULL;
+	DsimTraceWriter *trace_writer = NULL;
+	DsimCoverageMap *coverage_map = NULL;
+	DsimCorpus *corpus = NULL;
+	DsimGcovTracker *gcov_tracker = NULL;
 
 	/* Set up localisation. */
 	setlocale (LC_ALL, "");
@@ -976,6 +1919,13 @@ main (int argc, char *argv[])
 	g_option_group_add_entries (option_group, test_program_entries);
 	g_option_context_add_group (context, option_group);
 
+	/* Recording option group */
+	option_group = g_option_group_new ("recording", _("Recording Options:"), _("Show help options for recording and replaying conversations"),
+	                                   NULL, NULL);
+	g_option_group_set_translation_domain (option_group, GETTEXT_PACKAGE);
+	g_option_group_add_entries (option_group, recording_entries);
+	g_option_context_add_group (context, option_group);
+
 	/* dbus-daemon option group */
 	option_group = g_option_group_new ("dbus-daemon", _("D-Bus Daemon Options:"), _("Show help options for the dbus-daemon"), NULL, NULL);
 	g_option_group_set_translation_domain (option_group, GETTEXT_PACKAGE);
@@ -995,6 +1945,111 @@ main (int argc, char *argv[])
 		exit (STATUS_INVALID_OPTIONS);
 	}
 
+	if (use_bus_broker == TRUE && dbus_daemon_config_file_path != NULL) {
+		g_printerr (_("Error parsing command line options: %s"), _("--dbus-daemon-config-file can’t be used with --bus-broker"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	if (record_file_path != NULL && replay_file_path != NULL) {
+		g_printerr (_("Error parsing command line options: %s"), _("Only one of --record-file and --replay-file may be provided"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* The recorder hooks the simulated objects' signals from the main thread only, so can't be used when method calls are handled in the worker
+	 * thread. */
+	if (worker_thread_dispatch == TRUE &&
+	    (record_file_path != NULL || replay_file_path != NULL || (continue_on_crash == TRUE && crash_history_length > 0))) {
+		g_printerr (_("Error parsing command line options: %s"),
+		            _("--worker-thread-dispatch can’t be used with --record-file, --replay-file or --continue-on-crash (unless "
+		              "--crash-history-length is 0)"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* Seed streams can only be saved when simulating, and only resumed if they're being saved. */
+	if ((corpus_directory_path != NULL && replay_file_path != NULL) || (resume_corpus == TRUE && corpus_directory_path == NULL)) {
+		g_printerr (_("Error parsing command line options: %s"),
+		            _("--corpus-dir can’t be used with --replay-file, and --resume can only be used with --corpus-dir"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	if (gcov_log_file_path != NULL && gcov_directory_path == NULL) {
+		g_printerr (_("Error parsing command line options: %s"), _("--gcov-log-file can only be used with --gcov-dir"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* Coverage rewards are given from the main thread, so would race with transitions executed in the worker thread. */
+	if (worker_thread_dispatch == TRUE && coverage_guided == TRUE) {
+		g_printerr (_("Error parsing command line options: %s"), _("--worker-thread-dispatch can’t be used with --coverage-guided"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* Seed streams re-seed every simulated object from within each transition, so would race with transitions executed in the worker thread. */
+	if (worker_thread_dispatch == TRUE && corpus_directory_path != NULL) {
+		g_printerr (_("Error parsing command line options: %s"), _("--worker-thread-dispatch can’t be used with --corpus-dir"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	if (target_state_name != NULL && dfsm_is_state_name (target_state_name) == FALSE) {
+		g_printerr (_("Error parsing command line options: %s"), _("--target-state must be a valid state name"));
+		g_printerr ("\n");
+
+		print_help_text (context);
+
+		g_option_context_free (context);
+		g_free (command_line);
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
 	/* Extract the simulation and the introspection filenames. */
 	if (argc < 3) {
 		g_printerr (_("Error parsing command line options: %s"), _("Simulation and introspection filenames must be provided"));
@@ -1069,7 +2124,32 @@ main (int argc, char *argv[])
 	g_free (time_str);
 	g_free (command_line);
 
-	/* Set up the random number generator. */
+	/* Load the recording to replay, if we're replaying. */
+	if (replay_file_path != NULL) {
+		GFile *replay_file;
+
+		replay_file = g_file_new_for_commandline_arg (replay_file_path);
+		recorder = dsim_recorder_new_for_replay (replay_file, &error);
+		g_object_unref (replay_file);
+
+		if (error != NULL) {
+			g_printerr (_("Error loading recording from file ‘%s’: %s"), replay_file_path, error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			dsim_logging_finalise ();
+
+			exit (STATUS_RECORDING_ERROR);
+		}
+
+		/* Use the recording's seed so that the timing of arbitrary transitions matches, unless it's been overridden. */
+		if (random_seed == 0) {
+			random_seed = dsim_recorder_get_random_seed (recorder);
+		}
+	}
+
+	/* Choose the random seed. When saving a corpus, this seeds the choice of seed streams, and so derives each test run's seed; otherwise it seeds
+	 * the simulated objects directly. */
 	if (random_seed == 0) {
 		random_seed = g_get_real_time ();
 	}
@@ -1078,7 +2158,33 @@ main (int argc, char *argv[])
 	g_message (_("Note: Setting random number generator seed to %s."), seed_str);
 	g_free (seed_str);
 
-	g_random_set_seed ((guint32) random_seed);
+	/* Start recording, if we're recording. */
+	if (record_file_path != NULL) {
+		GFile *record_file;
+
+		record_file = g_file_new_for_commandline_arg (record_file_path);
+		recorder = dsim_recorder_new_for_recording (record_file, random_seed, &error);
+		g_object_unref (record_file);
+
+		if (error != NULL) {
+			g_printerr (_("Error creating recording file ‘%s’: %s"), record_file_path, error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			dsim_logging_finalise ();
+
+			exit (STATUS_RECORDING_ERROR);
+		}
+	}
+
+	/* Keep a history of the conversation for crash reports, if we're continuing on crash. */
+	if (continue_on_crash == TRUE && crash_history_length > 0) {
+		if (recorder == NULL) {
+			recorder = dsim_recorder_new_for_history (random_seed, crash_history_length);
+		} else if (dsim_recorder_get_mode (recorder) == DSIM_RECORDER_MODE_RECORD) {
+			dsim_recorder_set_history_length (recorder, crash_history_length);
+		}
+	}
 
 	/* Load the files. */
 	g_file_get_contents (simulation_filename, &simulation_code, NULL, &error);
@@ -1104,6 +2210,15 @@ main (int argc, char *argv[])
 		exit (STATUS_UNREADABLE_FILE);
 	}
 
+	/* Cache the parsed simulation code between runs, to save re-parsing it if it hasn't changed, if requested. */
+	if (machine_cache == TRUE) {
+		gchar *cache_directory;
+
+		cache_directory = g_build_filename (g_get_user_cache_dir (), "bendy-bus", "machines", NULL);
+		dfsm_object_factory_set_cache_directory (cache_directory);
+		g_free (cache_directory);
+	}
+
 	/* Build the DfsmObjects. */
 	simulated_objects = dfsm_object_factory_from_data (simulation_code, introspection_xml, &error);
 
@@ -1119,18 +2234,179 @@ main (int argc, char *argv[])
 		exit (STATUS_INVALID_CODE);
 	}
 
+	/* Instantiate extra copies of the objects, if requested. This has to happen before anything else hooks up to the objects. */
+	if (object_instances > 0) {
+		instantiate_simulated_objects (simulated_objects, object_instances);
+	}
+
+	/* Hook the recorder up to the objects. */
+	if (recorder != NULL) {
+		for (i = 0; i < simulated_objects->len; i++) {
+			dsim_recorder_attach_object (recorder, g_ptr_array_index (simulated_objects, i));
+		}
+	}
+
+	/* Move method call handling to the worker thread, if requested. */
+	if (worker_thread_dispatch == TRUE) {
+		for (i = 0; i < simulated_objects->len; i++) {
+			dfsm_object_set_dispatch_in_worker_thread (g_ptr_array_index (simulated_objects, i), TRUE);
+		}
+	}
+
+	/* Solve the preconditions of transitions which haven't been executed yet, if requested. */
+	if (solve_preconditions == TRUE) {
+		for (i = 0; i < simulated_objects->len; i++) {
+			dfsm_machine_set_solve_preconditions (dfsm_object_get_machine (g_ptr_array_index (simulated_objects, i)), TRUE);
+		}
+	}
+
+	/* Favour transitions which lead to new coverage, if requested. */
+	if (coverage_guided == TRUE) {
+		coverage_map = dsim_coverage_map_new (&error);
+
+		if (error != NULL) {
+			g_printerr (_("Error setting up coverage guidance: %s"), error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			g_ptr_array_unref (simulated_objects);
+			g_clear_object (&recorder);
+			dsim_logging_finalise ();
+
+			exit (STATUS_COVERAGE_ERROR);
+		}
+
+		for (i = 0; i < simulated_objects->len; i++) {
+			dfsm_machine_set_transition_feedback (dfsm_object_get_machine (g_ptr_array_index (simulated_objects, i)), TRUE);
+		}
+	}
+
+	/* Load the corpus of interesting test runs, if requested. */
+	if (corpus_directory_path != NULL) {
+		GFile *corpus_directory;
+
+		corpus_directory = g_file_new_for_commandline_arg (corpus_directory_path);
+		corpus = dsim_corpus_new (corpus_directory, &error);
+		g_object_unref (corpus_directory);
+
+		if (error != NULL) {
+			g_printerr (_("Error loading corpus from directory ‘%s’: %s"), corpus_directory_path, error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			g_ptr_array_unref (simulated_objects);
+			g_clear_object (&recorder);
+			dsim_coverage_map_free (coverage_map);
+			dsim_logging_finalise ();
+
+			exit (STATUS_CORPUS_ERROR);
+		}
+
+		g_message (_("Loaded %u entries from corpus directory ‘%s’."), dsim_corpus_get_size (corpus), corpus_directory_path);
+	}
+
+	/* Establish the baseline gcov coverage, if requested. */
+	if (gcov_directory_path != NULL) {
+		DsimGcovDelta delta;
+
+		gcov_tracker = dsim_gcov_tracker_new (gcov_directory_path);
+		dsim_gcov_tracker_update (gcov_tracker, &delta);
+		dsim_gcov_delta_clear (&delta);
+
+		g_message (_("Baseline gcov coverage in ‘%s’ is %u lines in %u functions."), gcov_directory_path,
+		           dsim_gcov_tracker_get_num_lines (gcov_tracker), dsim_gcov_tracker_get_num_functions (gcov_tracker));
+	}
+
+	/* Drive the objects towards the target state, if requested. */
+	if (target_state_name != NULL && set_target_state (simulated_objects, target_state_name) == FALSE) {
+		g_printerr (_("Error parsing command line options: %s"), _("No simulated object has the state given by --target-state"));
+		g_printerr ("\n");
+
+		g_ptr_array_unref (simulated_objects);
+		g_clear_object (&recorder);
+		dsim_coverage_map_free (coverage_map);
+		dsim_corpus_free (corpus);
+		dsim_gcov_tracker_free (gcov_tracker);
+		dsim_logging_finalise ();
+
+		exit (STATUS_INVALID_OPTIONS);
+	}
+
+	/* Start tracing, if requested. */
+	if (trace_file_path != NULL) {
+		GFile *trace_file;
+
+		trace_file = g_file_new_for_commandline_arg (trace_file_path);
+		trace_writer = dsim_trace_writer_new (trace_file, &error);
+		g_object_unref (trace_file);
+
+		if (error != NULL) {
+			g_printerr (_("Error creating trace file ‘%s’: %s"), trace_file_path, error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			g_ptr_array_unref (simulated_objects);
+			g_clear_object (&recorder);
+			dsim_coverage_map_free (coverage_map);
+			dsim_corpus_free (corpus);
+			dsim_gcov_tracker_free (gcov_tracker);
+			dsim_logging_finalise ();
+
+			exit (STATUS_TRACE_ERROR);
+		}
+
+		dsim_trace_writer_install (trace_writer);
+	}
+
 	/* Prepare the main data struct, which will last for the lifetime of the program. */
 	data.main_loop = g_main_loop_new (NULL, FALSE);
 	data.exit_status = STATUS_SUCCESS;
 	data.exit_signal = EXIT_SIGNAL_INVALID;
 	data.test_program = NULL;
 	data.connection = NULL;
+	data.dbus_daemon = NULL;
+	data.bus_broker = NULL;
+	data.dbus_address = NULL;
 	data.simulated_objects = g_ptr_array_ref (simulated_objects);
 	data.outstanding_registration_callbacks = 0;
 	data.test_run_inactivity_timeout_id = 0;
 	data.test_program_spawn_end_signal = 0;
 	data.test_program_process_died_signal = 0;
 	data.test_program_sigkill_timeout_id = 0;
+	data.test_program_sigkilled = FALSE;
+	data.test_program_crash_signal = 0;
+	data.recorder = recorder; /* transfer ownership */
+	data.test_run_iteration = 0;
+	data.crash_reports = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) dsim_crash_report_free);
+	data.crash_report_order = g_ptr_array_new ();
+	data.num_crashes = 0;
+	data.num_pending_crashes = 0;
+	data.resource_usages = g_array_new (FALSE, FALSE, sizeof (DsimResourceUsage));
+	data.memory_sampler = (detect_leaks == TRUE) ? dsim_memory_sampler_new () : NULL;
+	data.memory_sample_timeout_id = 0;
+	data.leak_reports = g_array_new (FALSE, FALSE, sizeof (LeakReport));
+	data.trace_writer = trace_writer; /* transfer ownership */
+	data.coverage_map = coverage_map; /* transfer ownership */
+	data.coverage_run_new_entries = 0;
+	data.num_coverage_runs = 0;
+	data.corpus = corpus; /* transfer ownership */
+	data.corpus_rand = (corpus != NULL) ? g_rand_new_with_seed ((guint32) random_seed) : NULL;
+	data.num_corpus_entries_to_resume = (corpus != NULL && resume_corpus == TRUE) ? dsim_corpus_get_size (corpus) : 0;
+	data.next_corpus_entry_to_resume = 0;
+	data.iteration_seeds = NULL;
+	data.next_iteration_seed = 0;
+	data.iteration_transitions = 0;
+	data.num_new_corpus_entries = 0;
+	data.gcov_tracker = gcov_tracker; /* transfer ownership */
+	data.gcov_baseline_lines = (gcov_tracker != NULL) ? dsim_gcov_tracker_get_num_lines (gcov_tracker) : 0;
+	data.num_gcov_runs = 0;
+	data.gcov_unflushed_warning_shown = FALSE;
+	data.gcov_log = (gcov_log_file_path != NULL) ? g_key_file_new () : NULL;
+
+	/* With a corpus, the simulated objects are re-seeded at the start of each test run instead. */
+	if (corpus == NULL) {
+		seed_simulated_objects (&data, (guint32) random_seed);
+	}
 
 	if (run_infinitely == TRUE || (run_iters == 0 && run_time == 0)) {
 		data.num_test_runs_remaining = -1;
@@ -1164,32 +2440,99 @@ main (int argc, char *argv[])
 		exit (STATUS_TMP_DIR_ERROR);
 	}
 
-	/* Start up our own private dbus-daemon instance. */
-	data.dbus_daemon = dsim_dbus_daemon_new (working_directory_file, dbus_daemon_config_file);
-	data.dbus_address = NULL;
+	if (use_bus_broker == TRUE) {
+		/* Start up the built-in bus broker. Its address is available immediately. */
+		data.bus_broker = dsim_bus_broker_new (working_directory_file, &error);
 
-	g_object_unref (dbus_daemon_config_file);
-	g_object_unref (working_directory_file);
+		g_object_unref (working_directory_file);
 
-	g_signal_connect (data.dbus_daemon, "process-died", (GCallback) dbus_daemon_died_cb, &data);
-	g_signal_connect (data.dbus_daemon, "notify::bus-address", (GCallback) dbus_daemon_notify_bus_address_cb, &data);
+		if (error != NULL) {
+			g_printerr (_("Error starting built-in bus broker: %s"), error->message);
+			g_printerr ("\n");
 
-	dsim_program_wrapper_spawn (DSIM_PROGRAM_WRAPPER (data.dbus_daemon), &error);
+			g_error_free (error);
+			main_data_clear (&data);
+			dsim_logging_finalise ();
 
-	if (error != NULL) {
-		g_printerr (_("Error spawning private dbus-daemon instance: %s"), error->message);
-		g_printerr ("\n");
+			exit (STATUS_DAEMON_SPAWN_ERROR);
+		}
 
-		g_error_free (error);
-		main_data_clear (&data);
-		dsim_logging_finalise ();
+		bus_address_ready (&data, dsim_bus_broker_get_bus_address (data.bus_broker));
+	} else {
+		/* Start up our own private dbus-daemon instance. */
+		data.dbus_daemon = dsim_dbus_daemon_new (working_directory_file, dbus_daemon_config_file);
+
+		g_object_unref (dbus_daemon_config_file);
+		g_object_unref (working_directory_file);
+
+		g_signal_connect (data.dbus_daemon, "process-died", (GCallback) dbus_daemon_died_cb, &data);
+		g_signal_connect (data.dbus_daemon, "notify::bus-address", (GCallback) dbus_daemon_notify_bus_address_cb, &data);
+
+		dsim_program_wrapper_spawn (DSIM_PROGRAM_WRAPPER (data.dbus_daemon), &error);
+
+		if (error != NULL) {
+			g_printerr (_("Error spawning private dbus-daemon instance: %s"), error->message);
+			g_printerr ("\n");
+
+			g_error_free (error);
+			main_data_clear (&data);
+			dsim_logging_finalise ();
 
-		exit (STATUS_DAEMON_SPAWN_ERROR);
+			exit (STATUS_DAEMON_SPAWN_ERROR);
+		}
 	}
 
-	/* Start the main loop and wait for the dbus-daemon to send us its address. */
+	/* Start the main loop and (if using dbus-daemon) wait for it to send us its address. */
 	g_main_loop_run (data.main_loop);
 
+	/* Wait for the signatures of any recent crashes to be built. */
+	while (data.num_pending_crashes > 0) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	/* Summarise the unique crashes, if we were continuing on crash, and any leaks. */
+	print_crash_summary (&data);
+	print_leak_summary (&data);
+	print_coverage_summary (&data);
+	print_corpus_summary (&data);
+	print_gcov_summary (&data);
+
+	/* Write out the test program's resource usage, if requested. */
+	if (resource_usage_file_path != NULL && write_resource_usage_file (data.resource_usages, resource_usage_file_path, &error) == FALSE) {
+		g_printerr (_("Error writing resource usage to file ‘%s’: %s"), resource_usage_file_path, error->message);
+		g_printerr ("\n");
+
+		g_clear_error (&error);
+
+		if (data.exit_status == STATUS_SUCCESS) {
+			data.exit_status = STATUS_RESOURCE_USAGE_ERROR;
+		}
+	}
+
+	/* Write out which test runs gained gcov coverage, if requested. */
+	if (data.gcov_log != NULL && g_key_file_save_to_file (data.gcov_log, gcov_log_file_path, &error) == FALSE) {
+		g_printerr (_("Error writing gcov coverage log to file ‘%s’: %s"), gcov_log_file_path, error->message);
+		g_printerr ("\n");
+
+		g_clear_error (&error);
+
+		if (data.exit_status == STATUS_SUCCESS) {
+			data.exit_status = STATUS_GCOV_ERROR;
+		}
+	}
+
+	/* Finish the trace, if we were tracing. */
+	if (data.trace_writer != NULL && dsim_trace_writer_close (data.trace_writer, &error) == FALSE) {
+		g_printerr (_("Error writing trace to file ‘%s’: %s"), trace_file_path, error->message);
+		g_printerr ("\n");
+
+		g_clear_error (&error);
+
+		if (data.exit_status == STATUS_SUCCESS) {
+			data.exit_status = STATUS_TRACE_ERROR;
+		}
+	}
+
 	/* Free the main data struct. */
 	main_data_clear (&data);
 	dsim_logging_finalise ();
@@ -1207,5 +2550,10 @@ main (int argc, char *argv[])
 		kill (getpid (), data.exit_signal);
 	}
 
+	/* Let the caller know which signal the test program crashed with, if requested. */
+	if (exit_with_crash_status == TRUE && data.exit_status == STATUS_SUCCESS && data.test_program_crash_signal != 0) {
+		return 128 + data.test_program_crash_signal;
+	}
+
 	return data.exit_status;
 }
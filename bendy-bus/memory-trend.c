@@ -0,0 +1,294 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "memory-trend.h"
+
+/* Minimum number of samples (with distinct event counts) needed before a trend is calculated. */
+#define MIN_SAMPLES 8
+
+/* Minimum growth in memory usage before it's considered to be a leak at all, to filter out noise from allocator behaviour. */
+#define MIN_GROWTH 1024 /* KiB */
+
+/* Minimum power law exponent for growth to be considered superlinear. This is a little above 1 to allow for noise. */
+#define SUPERLINEAR_EXPONENT 1.2
+
+typedef struct {
+	guint64 num_events;
+	glong rss; /* KiB */
+	glong heap; /* KiB */
+} MemorySample;
+
+struct _DsimMemorySampler {
+	GArray/*<MemorySample>*/ *samples;
+};
+
+/**
+ * dsim_memory_sampler_new:
+ *
+ * Creates a new #DsimMemorySampler, which collects samples of a process' memory usage against the number of simulation events which have happened,
+ * and fits a growth trend to them.
+ *
+ * Return value: (transfer full): a new #DsimMemorySampler; free with dsim_memory_sampler_free()
+ */
+DsimMemorySampler *
+dsim_memory_sampler_new (void)
+{
+	DsimMemorySampler *sampler;
+
+	sampler = g_slice_new (DsimMemorySampler);
+	sampler->samples = g_array_new (FALSE, FALSE, sizeof (MemorySample));
+
+	return sampler;
+}
+
+/**
+ * dsim_memory_sampler_free:
+ * @sampler: (transfer full): a #DsimMemorySampler
+ *
+ * Frees a #DsimMemorySampler.
+ */
+void
+dsim_memory_sampler_free (DsimMemorySampler *sampler)
+{
+	if (sampler == NULL) {
+		return;
+	}
+
+	g_array_unref (sampler->samples);
+	g_slice_free (DsimMemorySampler, sampler);
+}
+
+/**
+ * dsim_memory_sampler_reset:
+ * @sampler: a #DsimMemorySampler
+ *
+ * Discards all the samples collected so far, ready for sampling a new period (e.g. a new test run).
+ */
+void
+dsim_memory_sampler_reset (DsimMemorySampler *sampler)
+{
+	g_return_if_fail (sampler != NULL);
+
+	g_array_set_size (sampler->samples, 0);
+}
+
+/* Parse a “Key:   1234 kB” line out of /proc/[pid]/status. */
+static glong
+parse_status_field (const gchar *status_contents, const gchar *key)
+{
+	const gchar *line;
+
+	line = strstr (status_contents, key);
+
+	if (line == NULL) {
+		return -1;
+	}
+
+	return g_ascii_strtoll (line + strlen (key), NULL, 10);
+}
+
+/**
+ * dsim_memory_usage_read:
+ * @pid: process ID of the process to read
+ * @rss: (out): return location for the process' resident set size, in KiB
+ * @heap: (out): return location for the process' data segment (heap and anonymous mappings) size, in KiB
+ *
+ * Reads the current resident set size and data segment size of process @pid from <filename>/proc</filename>.
+ *
+ * Return value: %TRUE if the memory usage was read; %FALSE if it couldn't be read (e.g. because the process has exited)
+ */
+gboolean
+dsim_memory_usage_read (GPid pid, glong *rss, glong *heap)
+{
+	gchar *path, *status_contents = NULL;
+	glong rss_value, heap_value;
+	gboolean success;
+
+	g_return_val_if_fail (rss != NULL, FALSE);
+	g_return_val_if_fail (heap != NULL, FALSE);
+
+	path = g_strdup_printf ("/proc/%i/status", (gint) pid);
+	success = g_file_get_contents (path, &status_contents, NULL, NULL);
+	g_free (path);
+
+	if (success == FALSE) {
+		return FALSE;
+	}
+
+	rss_value = parse_status_field (status_contents, "\nVmRSS:");
+	heap_value = parse_status_field (status_contents, "\nVmData:");
+
+	g_free (status_contents);
+
+	/* Zombie processes have no memory statistics. */
+	if (rss_value < 0 || heap_value < 0) {
+		return FALSE;
+	}
+
+	*rss = rss_value;
+	*heap = heap_value;
+
+	return TRUE;
+}
+
+/**
+ * dsim_memory_sampler_add_sample:
+ * @sampler: a #DsimMemorySampler
+ * @pid: process ID of the process to sample
+ * @num_events: number of simulation events (transitions and D-Bus messages) which have happened so far
+ *
+ * Samples the resident set size and data segment size of process @pid from <filename>/proc</filename>, and stores them against @num_events.
+ *
+ * Return value: %TRUE if a sample was taken; %FALSE if the process' memory usage couldn't be read (e.g. because it has exited)
+ */
+gboolean
+dsim_memory_sampler_add_sample (DsimMemorySampler *sampler, GPid pid, guint64 num_events)
+{
+	MemorySample sample;
+
+	g_return_val_if_fail (sampler != NULL, FALSE);
+
+	if (dsim_memory_usage_read (pid, &sample.rss, &sample.heap) == FALSE) {
+		return FALSE;
+	}
+
+	sample.num_events = num_events;
+
+	g_array_append_val (sampler->samples, sample);
+
+	return TRUE;
+}
+
+/* Least-squares fit of y = a + b·x, returning b. */
+static gdouble
+fit_slope (const gdouble *x, const gdouble *y, guint n)
+{
+	gdouble sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0, denominator;
+	guint i;
+
+	for (i = 0; i < n; i++) {
+		sum_x += x[i];
+		sum_y += y[i];
+		sum_xx += x[i] * x[i];
+		sum_xy += x[i] * y[i];
+	}
+
+	denominator = n * sum_xx - sum_x * sum_x;
+
+	return (denominator != 0.0) ? (n * sum_xy - sum_x * sum_y) / denominator : 0.0;
+}
+
+/* Fit memory usage against the number of events, both as a straight line (giving the slope) and as a power law of the growth since the first sample
+ * (giving the exponent: the slope of the line fitted in log–log space). Samples where memory hasn't grown are left out of the power law fit, since
+ * they have no logarithm. */
+static void
+fit_trend (GArray/*<MemorySample>*/ *samples, gsize value_offset, glong *growth, gdouble *slope, gdouble *exponent)
+{
+	const MemorySample *first, *last;
+	gdouble *x, *y, *log_x, *log_y;
+	guint i, n = 0;
+
+	first = &g_array_index (samples, MemorySample, 0);
+	last = &g_array_index (samples, MemorySample, samples->len - 1);
+
+	x = g_new (gdouble, samples->len);
+	y = g_new (gdouble, samples->len);
+	log_x = g_new (gdouble, samples->len);
+	log_y = g_new (gdouble, samples->len);
+
+	for (i = 0; i < samples->len; i++) {
+		const MemorySample *sample = &g_array_index (samples, MemorySample, i);
+		glong value, first_value;
+
+		value = G_STRUCT_MEMBER (glong, sample, value_offset);
+		first_value = G_STRUCT_MEMBER (glong, first, value_offset);
+
+		x[i] = sample->num_events - first->num_events;
+		y[i] = value;
+
+		if (sample->num_events > first->num_events && value > first_value) {
+			log_x[n] = log (x[i]);
+			log_y[n] = log (value - first_value);
+			n++;
+		}
+	}
+
+	*growth = G_STRUCT_MEMBER (glong, last, value_offset) - G_STRUCT_MEMBER (glong, first, value_offset);
+	*slope = fit_slope (x, y, samples->len);
+	*exponent = (n >= 2) ? fit_slope (log_x, log_y, n) : 0.0;
+
+	g_free (log_y);
+	g_free (log_x);
+	g_free (y);
+	g_free (x);
+}
+
+/**
+ * dsim_memory_sampler_calculate_trend:
+ * @sampler: a #DsimMemorySampler
+ * @trend: (out caller-allocates): return location for the trend
+ *
+ * Fits a growth trend to the samples collected so far. Growth is considered to be superlinear if either the resident set size or the data segment
+ * size grew by at least a megabyte, and the exponent of the best fitting power law of growth against the number of events is at least 1.2.
+ *
+ * If there aren't enough samples to fit a meaningful trend (for example, because the sampled period was too short, or because no events happened
+ * in it), %FALSE is returned and @trend is left undefined.
+ *
+ * Return value: %TRUE if a trend was calculated; %FALSE otherwise
+ */
+gboolean
+dsim_memory_sampler_calculate_trend (DsimMemorySampler *sampler, DsimMemoryTrend *trend)
+{
+	GArray/*<MemorySample>*/ *samples;
+	guint i, num_distinct_samples = 1;
+
+	g_return_val_if_fail (sampler != NULL, FALSE);
+	g_return_val_if_fail (trend != NULL, FALSE);
+
+	samples = sampler->samples;
+
+	if (samples->len == 0) {
+		return FALSE;
+	}
+
+	for (i = 1; i < samples->len; i++) {
+		if (g_array_index (samples, MemorySample, i).num_events != g_array_index (samples, MemorySample, i - 1).num_events) {
+			num_distinct_samples++;
+		}
+	}
+
+	if (num_distinct_samples < MIN_SAMPLES) {
+		return FALSE;
+	}
+
+	trend->num_samples = samples->len;
+	trend->num_events = g_array_index (samples, MemorySample, samples->len - 1).num_events - g_array_index (samples, MemorySample, 0).num_events;
+
+	fit_trend (samples, G_STRUCT_OFFSET (MemorySample, rss), &trend->rss_growth, &trend->rss_slope, &trend->rss_exponent);
+	fit_trend (samples, G_STRUCT_OFFSET (MemorySample, heap), &trend->heap_growth, &trend->heap_slope, &trend->heap_exponent);
+
+	trend->superlinear = (trend->rss_growth >= MIN_GROWTH && trend->rss_exponent >= SUPERLINEAR_EXPONENT) ||
+	                     (trend->heap_growth >= MIN_GROWTH && trend->heap_exponent >= SUPERLINEAR_EXPONENT);
+
+	return TRUE;
+}
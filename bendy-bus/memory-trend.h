@@ -0,0 +1,67 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#ifndef DSIM_MEMORY_TREND_H
+#define DSIM_MEMORY_TREND_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimMemoryTrend:
+ * @num_samples: number of memory samples the trend was fitted to
+ * @num_events: number of simulation events (transitions and D-Bus messages) over the sampled period
+ * @rss_growth: growth in resident set size over the sampled period, in KiB
+ * @rss_slope: least-squares growth rate of the resident set size, in KiB per event
+ * @rss_exponent: exponent of the power law best fitting the resident set size growth against the number of events
+ * @heap_growth: growth in the data segment (heap and anonymous mappings) size over the sampled period, in KiB
+ * @heap_slope: least-squares growth rate of the data segment size, in KiB per event
+ * @heap_exponent: exponent of the power law best fitting the data segment growth against the number of events
+ * @superlinear: %TRUE if memory usage grew superlinearly with the number of events
+ *
+ * A trend in the memory usage of a program over a period of simulation, such as a single test run. An exponent of 1 means memory usage grew linearly
+ * with the number of events (a typical leak of a fixed amount per event); more than 1 means it grew superlinearly.
+ */
+typedef struct {
+	guint num_samples;
+	guint64 num_events;
+	glong rss_growth;
+	gdouble rss_slope;
+	gdouble rss_exponent;
+	glong heap_growth;
+	gdouble heap_slope;
+	gdouble heap_exponent;
+	gboolean superlinear;
+} DsimMemoryTrend;
+
+typedef struct _DsimMemorySampler DsimMemorySampler;
+
+gboolean dsim_memory_usage_read (GPid pid, glong *rss, glong *heap);
+
+DsimMemorySampler *dsim_memory_sampler_new (void) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dsim_memory_sampler_free (DsimMemorySampler *sampler);
+
+void dsim_memory_sampler_reset (DsimMemorySampler *sampler);
+gboolean dsim_memory_sampler_add_sample (DsimMemorySampler *sampler, GPid pid, guint64 num_events);
+gboolean dsim_memory_sampler_calculate_trend (DsimMemorySampler *sampler, DsimMemoryTrend *trend);
+
+G_END_DECLS
+
+#endif /* !DSIM_MEMORY_TREND_H */
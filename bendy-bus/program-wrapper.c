@@ -18,7 +18,9 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
@@ -26,6 +28,12 @@
 #include "program-wrapper.h"
 #include "bendy-bus/marshal.h"
 
+/* Number of lines of the process' most recent stderr output to keep, for crash reports. */
+#define STDERR_TAIL_LENGTH 100
+
+/* Interval between samples of the process' RSS and open FD count from /proc. */
+#define RESOURCE_SAMPLE_INTERVAL 250 /* ms */
+
 static void dsim_program_wrapper_dispose (GObject *object);
 static void dsim_program_wrapper_finalize (GObject *object);
 static void dsim_program_wrapper_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
@@ -46,6 +54,14 @@ struct _DsimProgramWrapperPrivate {
 	/* Internal things */
 	guint stdout_watch_id;
 	guint stderr_watch_id;
+	GIOChannel *stdout_channel;
+	GIOChannel *stderr_channel;
+	GQueue/*<string>*/ stderr_tail; /* last STDERR_TAIL_LENGTH lines of stderr output from the most recent run, oldest first */
+
+	/* Resource accounting for the most recent run. */
+	DsimResourceUsage resource_usage;
+	struct rusage children_rusage_at_spawn;
+	guint resource_sample_id;
 };
 
 enum {
@@ -186,6 +202,7 @@ dsim_program_wrapper_init (DsimProgramWrapper *self)
 	self->priv->stdout_fd = -1;
 	self->priv->pid = -1;
 	self->priv->process_is_running = FALSE;
+	g_queue_init (&self->priv->stderr_tail);
 }
 
 static void
@@ -196,6 +213,11 @@ dsim_program_wrapper_dispose (GObject *object)
 	/* Ensure we kill the process first. */
 	dsim_program_wrapper_kill (DSIM_PROGRAM_WRAPPER (object), FALSE);
 
+	if (priv->resource_sample_id != 0) {
+		g_source_remove (priv->resource_sample_id);
+		priv->resource_sample_id = 0;
+	}
+
 	g_clear_object (&priv->working_directory);
 
 	/* Chain up to the parent class */
@@ -210,6 +232,17 @@ dsim_program_wrapper_finalize (GObject *object)
 	g_free (priv->program_name);
 	g_free (priv->logging_domain_name);
 
+	if (priv->stdout_channel != NULL) {
+		g_io_channel_unref (priv->stdout_channel);
+	}
+
+	if (priv->stderr_channel != NULL) {
+		g_io_channel_unref (priv->stderr_channel);
+	}
+
+	g_queue_foreach (&priv->stderr_tail, (GFunc) g_free, NULL);
+	g_queue_clear (&priv->stderr_tail);
+
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dsim_program_wrapper_parent_class)->dispose (object);
 }
@@ -271,6 +304,85 @@ dsim_program_wrapper_set_property (GObject *object, guint property_id, const GVa
 	}
 }
 
+static gboolean stdouterr_channel_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data);
+
+static gdouble
+timeval_difference (const struct timeval *later, const struct timeval *earlier)
+{
+	return (later->tv_sec - earlier->tv_sec) + (later->tv_usec - earlier->tv_usec) / (gdouble) G_USEC_PER_SEC;
+}
+
+/* Sample the parts of the process' resource usage which can only be read while it's running. */
+static gboolean
+resource_sample_cb (DsimProgramWrapper *self)
+{
+	DsimProgramWrapperPrivate *priv = self->priv;
+	gchar *path, *status_contents = NULL;
+	const gchar *vm_hwm;
+	GDir *fd_dir;
+
+	/* Peak RSS. */
+	path = g_strdup_printf ("/proc/%i/status", (gint) priv->pid);
+
+	if (g_file_get_contents (path, &status_contents, NULL, NULL) == TRUE &&
+	    (vm_hwm = strstr (status_contents, "\nVmHWM:")) != NULL) {
+		priv->resource_usage.max_rss = MAX (priv->resource_usage.max_rss, g_ascii_strtoll (vm_hwm + strlen ("\nVmHWM:"), NULL, 10));
+	}
+
+	g_free (status_contents);
+	g_free (path);
+
+	/* Open FDs. */
+	path = g_strdup_printf ("/proc/%i/fd", (gint) priv->pid);
+	fd_dir = g_dir_open (path, 0, NULL);
+
+	if (fd_dir != NULL) {
+		guint num_fds = 0;
+
+		while (g_dir_read_name (fd_dir) != NULL) {
+			num_fds++;
+		}
+
+		priv->resource_usage.max_open_fds = MAX (priv->resource_usage.max_open_fds, num_fds);
+
+		g_dir_close (fd_dir);
+	}
+
+	g_free (path);
+
+	return TRUE;
+}
+
+/* Work out the exact CPU times and context switch counts of the process, now that it's been reaped. GLib's child watch reaps the process using
+ * waitpid(), so we can't use wait4() to get its resource usage directly. Instead, we take the difference in the accumulated usage of all our reaped
+ * children since the process was spawned. Since only one instance of each wrapped program runs at once, and our other children live for the whole
+ * simulation, this is the same. */
+static void
+update_resource_usage_on_exit (DsimProgramWrapper *self)
+{
+	DsimProgramWrapperPrivate *priv = self->priv;
+	struct rusage children_rusage;
+
+	if (priv->resource_sample_id != 0) {
+		g_source_remove (priv->resource_sample_id);
+		priv->resource_sample_id = 0;
+	}
+
+	if (getrusage (RUSAGE_CHILDREN, &children_rusage) != 0) {
+		return;
+	}
+
+	priv->resource_usage.user_time = timeval_difference (&children_rusage.ru_utime, &priv->children_rusage_at_spawn.ru_utime);
+	priv->resource_usage.system_time = timeval_difference (&children_rusage.ru_stime, &priv->children_rusage_at_spawn.ru_stime);
+	priv->resource_usage.voluntary_context_switches = children_rusage.ru_nvcsw - priv->children_rusage_at_spawn.ru_nvcsw;
+	priv->resource_usage.involuntary_context_switches = children_rusage.ru_nivcsw - priv->children_rusage_at_spawn.ru_nivcsw;
+
+	/* ru_maxrss is the maximum over all reaped children, so only tells us anything if it's increased. If so, it's exact. */
+	if (children_rusage.ru_maxrss > priv->children_rusage_at_spawn.ru_maxrss) {
+		priv->resource_usage.max_rss = MAX (priv->resource_usage.max_rss, children_rusage.ru_maxrss);
+	}
+}
+
 static void
 child_watch_cb (GPid pid, gint status, DsimProgramWrapper *self)
 {
@@ -278,6 +390,13 @@ child_watch_cb (GPid pid, gint status, DsimProgramWrapper *self)
 
 	g_debug ("`%s` died.", priv->program_name);
 
+	/* Read any output which is still buffered in the pipes, so that it's all been logged (and the stderr tail is complete) by the time the
+	 * process-died signal is emitted. The channels are non-blocking, so this won't hang. */
+	stdouterr_channel_cb (priv->stdout_channel, G_IO_IN, (gpointer) ((gsize) self ^ 0 /* stdout */));
+	stdouterr_channel_cb (priv->stderr_channel, G_IO_IN, (gpointer) ((gsize) self ^ 1 /* stderr */));
+
+	update_resource_usage_on_exit (self);
+
 	priv->process_is_running = FALSE;
 	g_object_notify (G_OBJECT (self), "is-running");
 
@@ -289,6 +408,9 @@ child_watch_cb (GPid pid, gint status, DsimProgramWrapper *self)
 	g_source_remove (priv->stdout_watch_id); priv->stdout_watch_id = 0;
 	g_source_remove (priv->pid_watch_id); priv->pid_watch_id = 0;
 
+	g_io_channel_unref (priv->stderr_channel); priv->stderr_channel = NULL;
+	g_io_channel_unref (priv->stdout_channel); priv->stdout_channel = NULL;
+
 	close (priv->stderr_fd); priv->stderr_fd = -1;
 	close (priv->stdout_fd); priv->stdout_fd = -1;
 
@@ -342,6 +464,16 @@ stdouterr_channel_cb (GIOChannel *channel, GIOCondition condition, gpointer user
 					g_log (dsim_program_wrapper_get_logging_domain_name (self), G_LOG_LEVEL_MESSAGE, "%s: %s", channel_name,
 					       stdouterr_buf);
 
+					/* Keep the tail of stderr around, since it's where sanitisers and assertion failures report crashes. */
+					if (((gsize) user_data & 1) == 1) {
+						g_queue_push_tail (&self->priv->stderr_tail, stdouterr_buf);
+						stdouterr_buf = NULL;
+
+						if (self->priv->stderr_tail.length > STDERR_TAIL_LENGTH) {
+							g_free (g_queue_pop_head (&self->priv->stderr_tail));
+						}
+					}
+
 					g_free (stdouterr_buf);
 
 					if (status == G_IO_STATUS_EOF) {
@@ -456,7 +588,9 @@ dsim_program_wrapper_spawn (DsimProgramWrapper *self, GError **error)
 	g_free (environment);
 	g_free (command_line);
 
-	/* Spawn the program. */
+	/* Spawn the program. Snapshot our children's resource usage first, so that we can work out this run's usage when it exits. */
+	getrusage (RUSAGE_CHILDREN, &priv->children_rusage_at_spawn);
+
 	working_directory = g_file_get_path (self->priv->working_directory);
 
 	g_spawn_async_with_pipes (working_directory, (gchar**) argv->pdata, (gchar**) envp->pdata,
@@ -498,8 +632,6 @@ dsim_program_wrapper_spawn (DsimProgramWrapper *self, GError **error)
 
 	g_debug ("Listening to stdout pipe with watch ID %i.", child_stdout_watch_id);
 
-	g_io_channel_unref (child_stdout_channel);
-
 	child_stderr_channel = g_io_channel_unix_new (child_stderr);
 	g_io_channel_set_flags (child_stderr_channel, G_IO_FLAG_NONBLOCK, NULL);
 	g_io_channel_set_encoding (child_stderr_channel, locale_charset, NULL);
@@ -509,8 +641,6 @@ dsim_program_wrapper_spawn (DsimProgramWrapper *self, GError **error)
 
 	g_debug ("Listening to stderr pipe with watch ID %i.", child_stderr_watch_id);
 
-	g_io_channel_unref (child_stderr_channel);
-
 	/* Watch to see if the daemon exits */
 	child_watch_id = g_child_watch_add (child_pid, (GChildWatchFunc) child_watch_cb, self);
 
@@ -523,6 +653,15 @@ dsim_program_wrapper_spawn (DsimProgramWrapper *self, GError **error)
 	priv->pid_watch_id = child_watch_id;
 	priv->stdout_watch_id = child_stdout_watch_id;
 	priv->stderr_watch_id = child_stderr_watch_id;
+	priv->stdout_channel = child_stdout_channel; /* transfer ownership */
+	priv->stderr_channel = child_stderr_channel; /* transfer ownership */
+
+	/* Forget the previous run's output and resource usage. */
+	g_queue_foreach (&priv->stderr_tail, (GFunc) g_free, NULL);
+	g_queue_clear (&priv->stderr_tail);
+
+	memset (&priv->resource_usage, 0, sizeof (priv->resource_usage));
+	priv->resource_sample_id = g_timeout_add (RESOURCE_SAMPLE_INTERVAL, (GSourceFunc) resource_sample_cb, self);
 
 	/* Signal success. */
 	g_signal_emit (self, program_wrapper_signals[SIGNAL_SPAWN_END], 0, child_pid);
@@ -645,3 +784,50 @@ dsim_program_wrapper_is_running (DsimProgramWrapper *self)
 
 	return self->priv->process_is_running;
 }
+
+/**
+ * dsim_program_wrapper_dup_stderr_tail:
+ * @self: a #DsimProgramWrapper
+ *
+ * Gets the last few lines which the program wrote to stderr during its most recent run, oldest first. This is intended for use in crash reports, and
+ * remains available after the program has died, until it's next spawned.
+ *
+ * Return value: (transfer full): a %NULL-terminated array of lines of stderr output
+ */
+gchar **
+dsim_program_wrapper_dup_stderr_tail (DsimProgramWrapper *self)
+{
+	gchar **lines;
+	GList *l;
+	guint i = 0;
+
+	g_return_val_if_fail (DSIM_IS_PROGRAM_WRAPPER (self), NULL);
+
+	lines = g_new (gchar*, self->priv->stderr_tail.length + 1);
+
+	for (l = self->priv->stderr_tail.head; l != NULL; l = l->next) {
+		lines[i++] = g_strdup (l->data);
+	}
+
+	lines[i] = NULL;
+
+	return lines;
+}
+
+/**
+ * dsim_program_wrapper_get_resource_usage:
+ * @self: a #DsimProgramWrapper
+ *
+ * Gets the resource usage of the program's most recent run. This is only complete once the program has died (i.e. from the
+ * #DsimProgramWrapper::process-died signal onwards), and remains available until the program is next spawned. The
+ * #DsimResourceUsage.iteration field is not set.
+ *
+ * Return value: (transfer none): resource usage of the most recent run
+ */
+const DsimResourceUsage *
+dsim_program_wrapper_get_resource_usage (DsimProgramWrapper *self)
+{
+	g_return_val_if_fail (DSIM_IS_PROGRAM_WRAPPER (self), NULL);
+
+	return &self->priv->resource_usage;
+}
@@ -20,6 +20,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "resource-usage.h"
+
 #ifndef DSIM_PROGRAM_WRAPPER_H
 #define DSIM_PROGRAM_WRAPPER_H
 
@@ -62,6 +64,8 @@ GPid dsim_program_wrapper_get_process_id (DsimProgramWrapper *self);
 const gchar *dsim_program_wrapper_get_logging_domain_name (DsimProgramWrapper *self) G_GNUC_PURE;
 const gchar *dsim_program_wrapper_get_program_name (DsimProgramWrapper *self) G_GNUC_PURE;
 gboolean dsim_program_wrapper_is_running (DsimProgramWrapper *self) G_GNUC_PURE;
+gchar **dsim_program_wrapper_dup_stderr_tail (DsimProgramWrapper *self) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+const DsimResourceUsage *dsim_program_wrapper_get_resource_usage (DsimProgramWrapper *self) G_GNUC_PURE;
 
 G_END_DECLS
 
@@ -0,0 +1,1147 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:recorder
+ * @short_description: conversation recorder
+ *
+ * A #DsimRecorder records the entire conversation between the simulated objects and the program under test to a compact binary file, or replays a
+ * previously recorded conversation from such a file. Recorded are: every inbound method call, property get and property set; every reply, error
+ * reply and signal emission made in response (with their parameters serialised as #GVariant<!-- -->s); and every arbitrary transition tick of the
+ * simulation, whether or not it took a transition. Recording happens after the simulated objects have handled each activity, so it doesn't change
+ * how they handle it.
+ *
+ * When replaying, the recorded responses are fed back to the program under test without evaluating the simulated objects’ machines at all, so a
+ * crash which happened while recording can be reproduced exactly, and without the cost of running the simulation.
+ *
+ * The file format is designed to be appended to as the conversation progresses, and to be memory-mapped for replay. It consists of an 8 byte magic
+ * header followed by a sequence of records. Each record consists of an 8 byte prefix (a little-endian 32-bit payload length, followed by 4 reserved
+ * bytes), then the payload: a little-endian serialised #GVariant of type <code class="literal">(yxsssvba(yssv))</code>, padded to a multiple of 8 bytes so that the next record
+ * is correctly aligned for #GVariant deserialisation straight out of the mapped file.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#include "recorder.h"
+#include "recording-output-sequence.h"
+
+/* Magic bytes at the start of every recording file. The final byte is the file format version. */
+static const gchar recording_magic[8] = { 'B', 'B', 'U', 'S', 'R', 'E', 'C', 1 };
+
+/* Record payload: kind, timestamp (in µs since the recording started), object path, interface name, member name, value (method parameters,
+ * property value, iteration number or random seed; depending on the kind), handled flag (return value of the signal handler) and the recorded
+ * output sequence entries. Unused fields are empty. */
+#define RECORD_TYPE_STRING "(yxsssvba" DSIM_RECORDING_ENTRY_TYPE_STRING ")"
+
+enum {
+	RECORD_FIELD_KIND = 0,
+	RECORD_FIELD_TIMESTAMP,
+	RECORD_FIELD_OBJECT_PATH,
+	RECORD_FIELD_INTERFACE_NAME,
+	RECORD_FIELD_MEMBER_NAME,
+	RECORD_FIELD_VALUE,
+	RECORD_FIELD_HANDLED,
+	RECORD_FIELD_ENTRIES,
+};
+
+static void dsim_recorder_dispose (GObject *object);
+static void dsim_recorder_finalize (GObject *object);
+static void dsim_recorder_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void dsim_recorder_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+
+struct _DsimRecorderPrivate {
+	DsimRecorderMode mode;
+	GFile *file;
+	gint64 random_seed;
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+
+	/* Recording. */
+	GOutputStream *output_stream; /* NULL if recording has failed, or if only keeping a history */
+	gint64 start_time; /* monotonic time, in µs */
+	GQueue/*<GVariant>*/ history; /* most recent records in the current test run, oldest first */
+	guint history_length; /* maximum length of history; 0 to disable it */
+
+	/* Replay. */
+	GPtrArray/*<GHashTable<string, GQueue<GVariant>>>*/ *iterations; /* each maps object path to its queue of records for that iteration */
+	GHashTable/*<string, GQueue<GVariant>>*/ *current_iteration; /* unowned; NULL if the recording has been exhausted */
+	gboolean diverged; /* TRUE if the program under test has diverged from the recording in the current iteration */
+};
+
+enum {
+	PROP_MODE = 1,
+	PROP_FILE,
+};
+
+G_DEFINE_TYPE (DsimRecorder, dsim_recorder, G_TYPE_OBJECT)
+
+static void
+dsim_recorder_class_init (DsimRecorderClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DsimRecorderPrivate));
+
+	gobject_class->get_property = dsim_recorder_get_property;
+	gobject_class->set_property = dsim_recorder_set_property;
+	gobject_class->dispose = dsim_recorder_dispose;
+	gobject_class->finalize = dsim_recorder_finalize;
+
+	/**
+	 * DsimRecorder:mode:
+	 *
+	 * Whether the recorder is recording or replaying. This is a #DsimRecorderMode.
+	 */
+	g_object_class_install_property (gobject_class, PROP_MODE,
+	                                 g_param_spec_uint ("mode",
+	                                                    "Mode", "Whether the recorder is recording or replaying.",
+	                                                    DSIM_RECORDER_MODE_RECORD, DSIM_RECORDER_MODE_REPLAY, DSIM_RECORDER_MODE_RECORD,
+	                                                    G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * DsimRecorder:file:
+	 *
+	 * The recording file being written to or replayed from.
+	 */
+	g_object_class_install_property (gobject_class, PROP_FILE,
+	                                 g_param_spec_object ("file",
+	                                                      "File", "The recording file being written to or replayed from.",
+	                                                      G_TYPE_FILE,
+	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+dsim_recorder_init (DsimRecorder *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DSIM_TYPE_RECORDER, DsimRecorderPrivate);
+
+	self->priv->simulated_objects = g_ptr_array_new_with_free_func (g_object_unref);
+	g_queue_init (&self->priv->history);
+}
+
+static void
+dsim_recorder_dispose (GObject *object)
+{
+	DsimRecorder *self = DSIM_RECORDER (object);
+	DsimRecorderPrivate *priv = self->priv;
+	guint i;
+
+	/* Stop recording or replaying on all the objects. */
+	for (i = 0; i < priv->simulated_objects->len; i++) {
+		g_signal_handlers_disconnect_matched (g_ptr_array_index (priv->simulated_objects, i), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+	}
+
+	g_ptr_array_set_size (priv->simulated_objects, 0);
+
+	if (priv->output_stream != NULL) {
+		g_output_stream_close (priv->output_stream, NULL, NULL);
+		g_clear_object (&priv->output_stream);
+	}
+
+	g_clear_object (&priv->file);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dsim_recorder_parent_class)->dispose (object);
+}
+
+static void
+dsim_recorder_finalize (GObject *object)
+{
+	DsimRecorderPrivate *priv = DSIM_RECORDER (object)->priv;
+
+	if (priv->iterations != NULL) {
+		g_ptr_array_unref (priv->iterations);
+	}
+
+	g_queue_foreach (&priv->history, (GFunc) g_variant_unref, NULL);
+	g_queue_clear (&priv->history);
+
+	g_ptr_array_unref (priv->simulated_objects);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dsim_recorder_parent_class)->finalize (object);
+}
+
+static void
+dsim_recorder_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+	DsimRecorderPrivate *priv = DSIM_RECORDER (object)->priv;
+
+	switch (property_id) {
+		case PROP_MODE:
+			g_value_set_uint (value, priv->mode);
+			break;
+		case PROP_FILE:
+			g_value_set_object (value, priv->file);
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static void
+dsim_recorder_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
+{
+	DsimRecorderPrivate *priv = DSIM_RECORDER (object)->priv;
+
+	switch (property_id) {
+		case PROP_MODE:
+			/* Construct-only */
+			priv->mode = g_value_get_uint (value);
+			break;
+		case PROP_FILE:
+			/* Construct-only */
+			priv->file = g_value_dup_object (value);
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static gboolean
+write_serialised_record (GOutputStream *output_stream, GVariant *record, GError **error)
+{
+	GVariant *serialised_record;
+	guint32 prefix[2];
+	gsize payload_length;
+	gboolean success;
+	static const gchar padding[8] = { 0, };
+
+	/* Always store records as little-endian. */
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	serialised_record = g_variant_byteswap (record);
+#else
+	serialised_record = g_variant_ref (record);
+#endif
+
+	payload_length = g_variant_get_size (serialised_record);
+	prefix[0] = GUINT32_TO_LE ((guint32) payload_length);
+	prefix[1] = 0; /* reserved */
+
+	success = g_output_stream_write_all (output_stream, prefix, sizeof (prefix), NULL, NULL, error) == TRUE &&
+	          g_output_stream_write_all (output_stream, g_variant_get_data (serialised_record), payload_length, NULL, NULL, error) == TRUE &&
+	          g_output_stream_write_all (output_stream, padding, (8 - payload_length % 8) % 8, NULL, NULL, error) == TRUE;
+
+	g_variant_unref (serialised_record);
+
+	return success;
+}
+
+static void
+write_record (DsimRecorder *self, DsimRecordKind kind, const gchar *object_path, const gchar *interface_name, const gchar *member_name, GVariant *value,
+              gboolean handled, GVariant *entries)
+{
+	DsimRecorderPrivate *priv = self->priv;
+	GVariant *record;
+	GError *child_error = NULL;
+
+	/* Has recording failed previously (and we're not keeping a history)? */
+	if (priv->output_stream == NULL && priv->history_length == 0) {
+		return;
+	}
+
+	if (value == NULL) {
+		value = g_variant_new_tuple (NULL, 0);
+	}
+
+	if (entries == NULL) {
+		entries = g_variant_new_array (G_VARIANT_TYPE (DSIM_RECORDING_ENTRY_TYPE_STRING), NULL, 0);
+	}
+
+	record = g_variant_ref_sink (g_variant_new ("(yxsssvb@a" DSIM_RECORDING_ENTRY_TYPE_STRING ")", (guint8) kind,
+	                                            g_get_monotonic_time () - priv->start_time, object_path,
+	                                            (interface_name != NULL) ? interface_name : "", (member_name != NULL) ? member_name : "",
+	                                            value, handled, entries));
+
+	if (priv->history_length > 0) {
+		g_queue_push_tail (&priv->history, g_variant_ref (record));
+
+		while (priv->history.length > priv->history_length) {
+			g_variant_unref (g_queue_pop_head (&priv->history));
+		}
+	}
+
+	/* Flush after every record so that the recording is complete up to the point the program under test crashed. */
+	if (priv->output_stream != NULL &&
+	    (write_serialised_record (priv->output_stream, record, &child_error) == FALSE ||
+	     g_output_stream_flush (priv->output_stream, NULL, &child_error) == FALSE)) {
+		g_warning (_("Error writing to recording file; recording has been stopped: %s"), child_error->message);
+		g_error_free (child_error);
+
+		g_output_stream_close (priv->output_stream, NULL, NULL);
+		g_clear_object (&priv->output_stream);
+	}
+
+	g_variant_unref (record);
+}
+
+/* Wrap the output sequence for each dispatch so that its effects can be recorded by record_dispatched_cb(), after the dispatching signal's handlers
+ * (including the object's default handlers) have run. */
+static DfsmOutputSequence *
+record_wrap_output_sequence_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, DsimRecorder *self)
+{
+	return DFSM_OUTPUT_SEQUENCE (dsim_recording_output_sequence_new (output_sequence));
+}
+
+static void
+record_dispatched_cb (DfsmObject *simulated_object, DfsmObjectDispatchKind kind, DfsmOutputSequence *output_sequence, const gchar *interface_name,
+                      const gchar *member_name, GVariant *value, gboolean result, DsimRecorder *self)
+{
+	DsimRecordKind record_kind;
+	GVariant *entries = NULL;
+
+	switch (kind) {
+		case DFSM_OBJECT_DISPATCH_METHOD_CALL:
+			record_kind = DSIM_RECORD_METHOD_CALL;
+			break;
+		case DFSM_OBJECT_DISPATCH_GET_PROPERTY:
+			/* Nothing to replay if the property wasn't found. */
+			if (value == NULL) {
+				return;
+			}
+
+			record_kind = DSIM_RECORD_GET_PROPERTY;
+			break;
+		case DFSM_OBJECT_DISPATCH_SET_PROPERTY:
+			record_kind = DSIM_RECORD_SET_PROPERTY;
+			break;
+		case DFSM_OBJECT_DISPATCH_ARBITRARY_TRANSITION:
+			/* Ticks which didn't take a transition are recorded too, so that the replay consumes recorded ticks one-for-one with the
+			 * ticks the simulation makes, rather than replaying a later transition's output early. */
+			record_kind = DSIM_RECORD_ARBITRARY_TRANSITION;
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+
+	/* Another handler of DfsmObject::wrap-output-sequence could have won; in which case, the effects can't be recorded. */
+	if (output_sequence != NULL && DSIM_IS_RECORDING_OUTPUT_SEQUENCE (output_sequence) == TRUE) {
+		entries = dsim_recording_output_sequence_build_entries (DSIM_RECORDING_OUTPUT_SEQUENCE (output_sequence));
+	}
+
+	write_record (self, record_kind, dfsm_object_get_object_path (simulated_object), interface_name, member_name, value, result, entries);
+
+	if (entries != NULL) {
+		g_variant_unref (entries);
+	}
+}
+
+/* Find the queue of recorded records for the given object in the current iteration of the replay. Returns NULL if there's nothing (left) to replay
+ * in the current iteration, including if the replay has diverged from the recording. */
+static GQueue *
+get_replay_queue (DsimRecorder *self, DfsmObject *simulated_object)
+{
+	if (self->priv->current_iteration == NULL || self->priv->diverged == TRUE) {
+		return NULL;
+	}
+
+	return g_hash_table_lookup (self->priv->current_iteration, dfsm_object_get_object_path (simulated_object));
+}
+
+static void
+replay_record_entries (GVariant *record, DfsmOutputSequence *output_sequence)
+{
+	GVariant *entries;
+
+	entries = g_variant_get_child_value (record, RECORD_FIELD_ENTRIES);
+	dsim_recording_output_sequence_replay_entries (entries, output_sequence);
+	g_variant_unref (entries);
+}
+
+/* Pop the next record for the given object off the replay queue, if it's of the given kind and matches the given interface and member names.
+ * Any arbitrary transitions recorded before it are replayed into @output_sequence first (if it's non-NULL), so that signal emissions reach the
+ * program under test in the recorded order. Returns NULL (and warns) if the replay has diverged from the recording, in which case no more records
+ * are consumed for the rest of the iteration. */
+static GVariant *
+pop_replay_record (DsimRecorder *self, DfsmObject *simulated_object, DsimRecordKind kind, const gchar *interface_name, const gchar *member_name,
+                   DfsmOutputSequence *output_sequence)
+{
+	GQueue *queue;
+	GVariant *record;
+	guint8 record_kind;
+	const gchar *record_interface_name, *record_member_name;
+
+	queue = get_replay_queue (self, simulated_object);
+
+	if (queue == NULL) {
+		return NULL;
+	}
+
+	while ((record = g_queue_peek_head (queue)) != NULL) {
+		g_variant_get_child (record, RECORD_FIELD_KIND, "y", &record_kind);
+
+		if (record_kind != DSIM_RECORD_ARBITRARY_TRANSITION || output_sequence == NULL) {
+			break;
+		}
+
+		/* Replay the transition's output in-line. */
+		record = g_queue_pop_head (queue);
+		replay_record_entries (record, output_sequence);
+		g_variant_unref (record);
+	}
+
+	if (record == NULL) {
+		g_debug ("Replay for object ‘%s’ has been exhausted.", dfsm_object_get_object_path (simulated_object));
+		return NULL;
+	}
+
+	g_variant_get_child (record, RECORD_FIELD_INTERFACE_NAME, "&s", &record_interface_name);
+	g_variant_get_child (record, RECORD_FIELD_MEMBER_NAME, "&s", &record_member_name);
+
+	if (record_kind != kind || strcmp (record_interface_name, interface_name) != 0 || strcmp (record_member_name, member_name) != 0) {
+		g_message (_("Replay diverged from recording on object ‘%s’: expected ‘%s.%s’ but got ‘%s.%s’. Falling back to simulation."),
+		           dfsm_object_get_object_path (simulated_object), record_interface_name, record_member_name, interface_name, member_name);
+		self->priv->diverged = TRUE;
+		return NULL;
+	}
+
+	return g_queue_pop_head (queue);
+}
+
+static gboolean
+replay_method_call_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *method_name,
+                       GVariant *parameters, gboolean enable_fuzzing, DsimRecorder *self)
+{
+	GVariant *record;
+
+	record = pop_replay_record (self, simulated_object, DSIM_RECORD_METHOD_CALL, interface_name, method_name, output_sequence);
+
+	if (record == NULL) {
+		/* Let the simulation handle it. */
+		return FALSE;
+	}
+
+	replay_record_entries (record, output_sequence);
+	g_variant_unref (record);
+
+	return TRUE;
+}
+
+static GVariant *
+replay_get_property_cb (DfsmObject *simulated_object, const gchar *interface_name, const gchar *property_name, DsimRecorder *self)
+{
+	GVariant *record, *value;
+
+	record = pop_replay_record (self, simulated_object, DSIM_RECORD_GET_PROPERTY, interface_name, property_name, NULL);
+
+	if (record == NULL) {
+		/* Let the simulation handle it. */
+		return NULL;
+	}
+
+	g_variant_get_child (record, RECORD_FIELD_VALUE, "v", &value);
+	g_variant_unref (record);
+
+	return value;
+}
+
+static gboolean
+replay_set_property_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *property_name,
+                        GVariant *value, gboolean enable_fuzzing, DsimRecorder *self)
+{
+	GVariant *record;
+	gboolean changed;
+
+	record = pop_replay_record (self, simulated_object, DSIM_RECORD_SET_PROPERTY, interface_name, property_name, output_sequence);
+
+	if (record == NULL) {
+		/* Let the simulation handle it. */
+		return FALSE;
+	}
+
+	g_variant_get_child (record, RECORD_FIELD_HANDLED, "b", &changed);
+	replay_record_entries (record, output_sequence);
+	g_variant_unref (record);
+
+	return changed;
+}
+
+static gboolean
+replay_arbitrary_transition_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing, DsimRecorder *self)
+{
+	GQueue *queue;
+	GVariant *record;
+	guint8 record_kind;
+
+	/* Only replay a recorded arbitrary transition tick if it's next in the queue. Every tick was recorded, so each tick here consumes one
+	 * recorded tick; recorded ticks preceding method calls or property sets are replayed along with them if the ticks here fall behind. While
+	 * there are still records to replay the simulation itself never makes arbitrary transitions. Once the replay has been exhausted or has
+	 * diverged, the simulation runs normally. */
+	queue = get_replay_queue (self, simulated_object);
+	record = (queue != NULL) ? g_queue_peek_head (queue) : NULL;
+
+	if (record == NULL) {
+		/* Let the simulation handle it. */
+		return FALSE;
+	}
+
+	g_variant_get_child (record, RECORD_FIELD_KIND, "y", &record_kind);
+
+	if (record_kind == DSIM_RECORD_ARBITRARY_TRANSITION) {
+		record = g_queue_pop_head (queue);
+		replay_record_entries (record, output_sequence);
+		g_variant_unref (record);
+	}
+
+	return TRUE;
+}
+
+static void
+record_queue_free (GQueue *queue)
+{
+	g_queue_free_full (queue, (GDestroyNotify) g_variant_unref);
+}
+
+static gboolean
+load_replay (DsimRecorder *self, GError **error)
+{
+	DsimRecorderPrivate *priv = self->priv;
+	GPtrArray/*<GVariant>*/ *records;
+	GHashTable/*<string, GQueue<GVariant>>*/ *iteration = NULL;
+	guint i;
+	GError *child_error = NULL;
+
+	records = dsim_recorder_load_records (priv->file, &child_error);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return FALSE;
+	}
+
+	priv->iterations = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+
+	/* Split the records up by iteration and object. */
+	for (i = 0; i < records->len; i++) {
+		GVariant *record, *value;
+		const gchar *object_path;
+		GQueue *queue;
+
+		record = g_ptr_array_index (records, i);
+
+		switch (dsim_record_get_kind (record)) {
+			case DSIM_RECORD_HEADER:
+				g_variant_get_child (record, RECORD_FIELD_VALUE, "v", &value);
+
+				if (g_variant_is_of_type (value, G_VARIANT_TYPE_INT64) == TRUE) {
+					priv->random_seed = g_variant_get_int64 (value);
+				}
+
+				g_variant_unref (value);
+
+				break;
+			case DSIM_RECORD_ITERATION:
+				iteration = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) record_queue_free);
+				g_ptr_array_add (priv->iterations, iteration);
+
+				break;
+			case DSIM_RECORD_METHOD_CALL:
+			case DSIM_RECORD_GET_PROPERTY:
+			case DSIM_RECORD_SET_PROPERTY:
+			case DSIM_RECORD_ARBITRARY_TRANSITION:
+				/* Records from before the first iteration marker can only come from a corrupt file. */
+				if (iteration == NULL) {
+					break;
+				}
+
+				g_variant_get_child (record, RECORD_FIELD_OBJECT_PATH, "&s", &object_path);
+				queue = g_hash_table_lookup (iteration, object_path);
+
+				if (queue == NULL) {
+					queue = g_queue_new ();
+					g_hash_table_insert (iteration, g_strdup (object_path), queue);
+				}
+
+				g_queue_push_tail (queue, g_variant_ref (record));
+
+				break;
+			default:
+				/* Unknown record kind. Skip it. */
+				break;
+		}
+	}
+
+	g_ptr_array_unref (records);
+
+	return TRUE;
+}
+
+/**
+ * dsim_recorder_new_for_recording:
+ * @file: file to record the conversation to
+ * @random_seed: seed of the random number generator used for the simulation
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Creates a new #DsimRecorder which records the conversation of all objects attached using dsim_recorder_attach_object() to @file. If @file exists,
+ * it will be overwritten. @random_seed is stored in the recording for informational purposes.
+ *
+ * Return value: (transfer full): a new #DsimRecorder, or %NULL on error
+ */
+DsimRecorder *
+dsim_recorder_new_for_recording (GFile *file, gint64 random_seed, GError **error)
+{
+	DsimRecorder *recorder;
+	GFileOutputStream *output_stream;
+	GVariant *seed_value;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	output_stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, &child_error);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return NULL;
+	}
+
+	if (g_output_stream_write_all (G_OUTPUT_STREAM (output_stream), recording_magic, sizeof (recording_magic), NULL, NULL, &child_error) == FALSE) {
+		g_propagate_error (error, child_error);
+		g_object_unref (output_stream);
+		return NULL;
+	}
+
+	recorder = g_object_new (DSIM_TYPE_RECORDER,
+	                         "mode", DSIM_RECORDER_MODE_RECORD,
+	                         "file", file,
+	                         NULL);
+
+	recorder->priv->output_stream = G_OUTPUT_STREAM (output_stream);
+	recorder->priv->start_time = g_get_monotonic_time ();
+	recorder->priv->random_seed = random_seed;
+
+	seed_value = g_variant_new_int64 (random_seed);
+	write_record (recorder, DSIM_RECORD_HEADER, "/", NULL, NULL, seed_value, FALSE, NULL);
+
+	return recorder;
+}
+
+/**
+ * dsim_recorder_new_for_history:
+ * @random_seed: seed of the random number generator used for the simulation
+ * @history_length: number of records to keep
+ *
+ * Creates a new #DsimRecorder which doesn’t write a recording file, but keeps the most recent @history_length records of the current test run in
+ * memory so that they can be retrieved using dsim_recorder_dup_history(). This is useful for reporting what led up to a crash.
+ *
+ * Return value: (transfer full): a new #DsimRecorder
+ */
+DsimRecorder *
+dsim_recorder_new_for_history (gint64 random_seed, guint history_length)
+{
+	DsimRecorder *recorder;
+
+	g_return_val_if_fail (history_length > 0, NULL);
+
+	recorder = g_object_new (DSIM_TYPE_RECORDER,
+	                         "mode", DSIM_RECORDER_MODE_RECORD,
+	                         NULL);
+
+	recorder->priv->start_time = g_get_monotonic_time ();
+	recorder->priv->random_seed = random_seed;
+	recorder->priv->history_length = history_length;
+
+	return recorder;
+}
+
+/**
+ * dsim_recorder_new_for_replay:
+ * @file: file to replay the conversation from
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Creates a new #DsimRecorder which replays the conversation recorded in @file (by a #DsimRecorder created with
+ * dsim_recorder_new_for_recording()) to all objects attached using dsim_recorder_attach_object().
+ *
+ * Return value: (transfer full): a new #DsimRecorder, or %NULL on error
+ */
+DsimRecorder *
+dsim_recorder_new_for_replay (GFile *file, GError **error)
+{
+	DsimRecorder *recorder;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	recorder = g_object_new (DSIM_TYPE_RECORDER,
+	                         "mode", DSIM_RECORDER_MODE_REPLAY,
+	                         "file", file,
+	                         NULL);
+
+	if (load_replay (recorder, &child_error) == FALSE) {
+		g_propagate_error (error, child_error);
+		g_object_unref (recorder);
+		return NULL;
+	}
+
+	return recorder;
+}
+
+/**
+ * dsim_recorder_attach_object:
+ * @self: a #DsimRecorder
+ * @simulated_object: a simulated object to record or replay the conversation of
+ *
+ * Start recording or replaying (depending on #DsimRecorder:mode) the conversation between @simulated_object and the program under test. When
+ * replaying, the object’s machine will not be evaluated unless the program under test diverges from the recording.
+ */
+void
+dsim_recorder_attach_object (DsimRecorder *self, DfsmObject *simulated_object)
+{
+	g_return_if_fail (DSIM_IS_RECORDER (self));
+	g_return_if_fail (DFSM_IS_OBJECT (simulated_object));
+
+	g_ptr_array_add (self->priv->simulated_objects, g_object_ref (simulated_object));
+
+	/* When recording, the objects handle everything as normal, and we record what they did once they've done it. When replaying, these handlers
+	 * run before (and, by returning TRUE or non-NULL, instead of) the objects' default handlers. */
+	if (self->priv->mode == DSIM_RECORDER_MODE_RECORD) {
+		g_signal_connect (simulated_object, "wrap-output-sequence", (GCallback) record_wrap_output_sequence_cb, self);
+		g_signal_connect (simulated_object, "dispatched", (GCallback) record_dispatched_cb, self);
+	} else {
+		g_signal_connect (simulated_object, "dbus-method-call", (GCallback) replay_method_call_cb, self);
+		g_signal_connect (simulated_object, "dbus-get-property", (GCallback) replay_get_property_cb, self);
+		g_signal_connect (simulated_object, "dbus-set-property", (GCallback) replay_set_property_cb, self);
+		g_signal_connect (simulated_object, "arbitrary-transition", (GCallback) replay_arbitrary_transition_cb, self);
+	}
+}
+
+/**
+ * dsim_recorder_start_iteration:
+ * @self: a #DsimRecorder
+ * @iteration: the (1-based) number of the test run which is starting
+ *
+ * Mark the start of a new test run. When recording, this writes a marker to the recording. When replaying, this moves the replay on to the records
+ * for the given test run; if the recording doesn’t contain that many test runs, the simulation will run normally.
+ */
+void
+dsim_recorder_start_iteration (DsimRecorder *self, guint iteration)
+{
+	DsimRecorderPrivate *priv;
+
+	g_return_if_fail (DSIM_IS_RECORDER (self));
+	g_return_if_fail (iteration > 0);
+
+	priv = self->priv;
+
+	if (priv->mode == DSIM_RECORDER_MODE_RECORD) {
+		/* The history only covers the current test run. */
+		g_queue_foreach (&priv->history, (GFunc) g_variant_unref, NULL);
+		g_queue_clear (&priv->history);
+
+		write_record (self, DSIM_RECORD_ITERATION, "/", NULL, NULL, g_variant_new_uint32 (iteration), FALSE, NULL);
+	} else if (iteration <= priv->iterations->len) {
+		priv->current_iteration = g_ptr_array_index (priv->iterations, iteration - 1);
+		priv->diverged = FALSE;
+	} else {
+		if (priv->current_iteration != NULL) {
+			g_message (_("Recording contains only %u test runs; running the simulation normally from now on."), priv->iterations->len);
+		}
+
+		priv->current_iteration = NULL;
+	}
+}
+
+/**
+ * dsim_recorder_set_history_length:
+ * @self: a #DsimRecorder
+ * @history_length: number of records to keep, or <code class="literal">0</code> to not keep a history
+ *
+ * Sets the number of the most recent records in the current test run which the recorder keeps in memory, as well as writing them to the recording
+ * file. This is only meaningful when recording.
+ */
+void
+dsim_recorder_set_history_length (DsimRecorder *self, guint history_length)
+{
+	DsimRecorderPrivate *priv;
+
+	g_return_if_fail (DSIM_IS_RECORDER (self));
+
+	priv = self->priv;
+	priv->history_length = history_length;
+
+	while (priv->history.length > priv->history_length) {
+		g_variant_unref (g_queue_pop_head (&priv->history));
+	}
+}
+
+/**
+ * dsim_recorder_dup_history:
+ * @self: a #DsimRecorder
+ *
+ * Gets the most recent records in the current test run, oldest first. See dsim_recorder_set_history_length(). The array will be empty if the
+ * recorder isn’t keeping a history.
+ *
+ * Return value: (transfer full): an array of records
+ */
+GPtrArray/*<GVariant>*/ *
+dsim_recorder_dup_history (DsimRecorder *self)
+{
+	GPtrArray/*<GVariant>*/ *history;
+	GList *l;
+
+	g_return_val_if_fail (DSIM_IS_RECORDER (self), NULL);
+
+	history = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	for (l = self->priv->history.head; l != NULL; l = l->next) {
+		g_ptr_array_add (history, g_variant_ref (l->data));
+	}
+
+	return history;
+}
+
+/**
+ * dsim_recorder_get_mode:
+ * @self: a #DsimRecorder
+ *
+ * Gets the value of #DsimRecorder:mode.
+ *
+ * Return value: whether the recorder is recording or replaying
+ */
+DsimRecorderMode
+dsim_recorder_get_mode (DsimRecorder *self)
+{
+	g_return_val_if_fail (DSIM_IS_RECORDER (self), DSIM_RECORDER_MODE_RECORD);
+
+	return self->priv->mode;
+}
+
+/**
+ * dsim_recorder_get_random_seed:
+ * @self: a #DsimRecorder
+ *
+ * Gets the seed of the random number generator which was used for the recorded simulation.
+ *
+ * Return value: random number generator seed, or 0 if unknown
+ */
+gint64
+dsim_recorder_get_random_seed (DsimRecorder *self)
+{
+	g_return_val_if_fail (DSIM_IS_RECORDER (self), 0);
+
+	return self->priv->random_seed;
+}
+
+/**
+ * dsim_recorder_load_records:
+ * @file: recording file to load
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Loads all the records from the recording file @file, in the order they were recorded. The file is memory-mapped and the records are not copied out
+ * of it. If the final record in the file is truncated (e.g. because the simulator was killed while writing it), it is ignored.
+ *
+ * Return value: (transfer full): an array of records (as #GVariant<!-- -->s), or %NULL on error
+ */
+GPtrArray/*<GVariant>*/ *
+dsim_recorder_load_records (GFile *file, GError **error)
+{
+	GMappedFile *mapped_file;
+	GPtrArray/*<GVariant>*/ *records;
+	gchar *path;
+	const gchar *contents;
+	gsize length, offset;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* Map the file. */
+	path = g_file_get_path (file);
+
+	if (path == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, _("Recording files must be local."));
+		return NULL;
+	}
+
+	mapped_file = g_mapped_file_new (path, FALSE, &child_error);
+	g_free (path);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_contents (mapped_file);
+	length = g_mapped_file_get_length (mapped_file);
+
+	if (length < sizeof (recording_magic) || memcmp (contents, recording_magic, sizeof (recording_magic)) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("File is not a Bendy Bus recording, or is from an incompatible version."));
+		g_mapped_file_unref (mapped_file);
+		return NULL;
+	}
+
+	records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	for (offset = sizeof (recording_magic); offset + 8 <= length;) {
+		guint32 payload_length;
+		GVariant *record;
+
+		memcpy (&payload_length, contents + offset, sizeof (payload_length));
+		payload_length = GUINT32_FROM_LE (payload_length);
+		offset += 8;
+
+		if (payload_length > length - offset) {
+			g_message (_("Ignoring truncated record at the end of the recording."));
+			break;
+		}
+
+		/* Don't copy the record: it can be used straight out of the mapped file. The offset is always 8-aligned. Each record holds a reference
+		 * to the mapping, so it stays around as long as any of the records do. */
+		record = g_variant_new_from_data (G_VARIANT_TYPE (RECORD_TYPE_STRING), contents + offset, payload_length, FALSE,
+		                                  (GDestroyNotify) g_mapped_file_unref, g_mapped_file_ref (mapped_file));
+		g_variant_ref_sink (record);
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+		{
+			GVariant *swapped_record = g_variant_byteswap (record);
+			g_variant_unref (record);
+			record = swapped_record;
+		}
+#endif
+
+		g_ptr_array_add (records, record);
+
+		offset += payload_length + (8 - payload_length % 8) % 8;
+	}
+
+	g_mapped_file_unref (mapped_file);
+
+	return records;
+}
+
+/**
+ * dsim_recorder_save_records:
+ * @file: recording file to write
+ * @records: (element-type GVariant): an array of records
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Writes @records to a new recording file at @file, overwriting it if it already exists. The records are typically ones originally returned by
+ * dsim_recorder_load_records(), potentially with some removed or modified using dsim_record_new_with_entries().
+ *
+ * Return value: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+dsim_recorder_save_records (GFile *file, GPtrArray/*<GVariant>*/ *records, GError **error)
+{
+	GFileOutputStream *output_stream;
+	guint i;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+	g_return_val_if_fail (records != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	output_stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, &child_error);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return FALSE;
+	}
+
+	if (g_output_stream_write_all (G_OUTPUT_STREAM (output_stream), recording_magic, sizeof (recording_magic), NULL, NULL, &child_error) == FALSE) {
+		goto done;
+	}
+
+	for (i = 0; i < records->len; i++) {
+		if (write_serialised_record (G_OUTPUT_STREAM (output_stream), g_ptr_array_index (records, i), &child_error) == FALSE) {
+			goto done;
+		}
+	}
+
+	g_output_stream_close (G_OUTPUT_STREAM (output_stream), NULL, &child_error);
+
+done:
+	g_object_unref (output_stream);
+
+	if (child_error != NULL) {
+		g_propagate_error (error, child_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * dsim_record_get_kind:
+ * @record: a record from a recording
+ *
+ * Gets the kind of @record.
+ *
+ * Return value: the record’s kind
+ */
+DsimRecordKind
+dsim_record_get_kind (GVariant *record)
+{
+	guint8 kind;
+
+	g_return_val_if_fail (record != NULL, DSIM_RECORD_HEADER);
+
+	g_variant_get_child (record, RECORD_FIELD_KIND, "y", &kind);
+
+	return kind;
+}
+
+/**
+ * dsim_record_dup_entries:
+ * @record: a record from a recording
+ *
+ * Gets the output sequence entries recorded in @record, as an array of %DSIM_RECORDING_ENTRY_TYPE_STRING tuples.
+ *
+ * Return value: (transfer full): the record’s entries
+ */
+GVariant *
+dsim_record_dup_entries (GVariant *record)
+{
+	g_return_val_if_fail (record != NULL, NULL);
+
+	return g_variant_get_child_value (record, RECORD_FIELD_ENTRIES);
+}
+
+/**
+ * dsim_record_new_with_entries:
+ * @record: a record from a recording
+ * @entries: an array of %DSIM_RECORDING_ENTRY_TYPE_STRING tuples
+ *
+ * Creates a copy of @record with its output sequence entries replaced by @entries. All the other fields of the record are left unchanged.
+ *
+ * Return value: (transfer full): a new non-floating record
+ */
+GVariant *
+dsim_record_new_with_entries (GVariant *record, GVariant *entries)
+{
+	GVariant *children[RECORD_FIELD_ENTRIES + 1];
+	guint i;
+
+	g_return_val_if_fail (record != NULL, NULL);
+	g_return_val_if_fail (entries != NULL, NULL);
+
+	for (i = 0; i < RECORD_FIELD_ENTRIES; i++) {
+		children[i] = g_variant_get_child_value (record, i);
+	}
+
+	children[RECORD_FIELD_ENTRIES] = entries;
+
+	record = g_variant_ref_sink (g_variant_new_tuple (children, G_N_ELEMENTS (children)));
+
+	for (i = 0; i < RECORD_FIELD_ENTRIES; i++) {
+		g_variant_unref (children[i]);
+	}
+
+	return record;
+}
+
+/**
+ * dsim_record_to_string:
+ * @record: a record from a recording
+ *
+ * Builds a human-readable single-line description of @record and the output sequence entries recorded in it, suitable for log output.
+ *
+ * Return value: (transfer full): description of the record
+ */
+gchar *
+dsim_record_to_string (GVariant *record)
+{
+	GString *output;
+	guint8 kind;
+	gint64 timestamp;
+	const gchar *object_path, *interface_name, *member_name;
+	GVariant *value, *entries, *entry;
+	GVariantIter iter;
+	gchar *value_string;
+
+	g_return_val_if_fail (record != NULL, NULL);
+
+	g_variant_get (record, "(yx&s&s&sv@a" DSIM_RECORDING_ENTRY_TYPE_STRING ")", &kind, &timestamp, &object_path, &interface_name,
+	               &member_name, &value, NULL, &entries);
+
+	output = g_string_new (NULL);
+	value_string = g_variant_print (value, FALSE);
+
+	g_string_append_printf (output, "%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT " %s ", timestamp / G_USEC_PER_SEC, timestamp % G_USEC_PER_SEC,
+	                        object_path);
+
+	switch ((DsimRecordKind) kind) {
+		case DSIM_RECORD_HEADER:
+			g_string_append_printf (output, "header %s", value_string);
+			break;
+		case DSIM_RECORD_ITERATION:
+			g_string_append_printf (output, "test run %s", value_string);
+			break;
+		case DSIM_RECORD_METHOD_CALL:
+			g_string_append_printf (output, "call %s.%s%s", interface_name, member_name, value_string);
+			break;
+		case DSIM_RECORD_GET_PROPERTY:
+			g_string_append_printf (output, "get %s.%s = %s", interface_name, member_name, value_string);
+			break;
+		case DSIM_RECORD_SET_PROPERTY:
+			g_string_append_printf (output, "set %s.%s = %s", interface_name, member_name, value_string);
+			break;
+		case DSIM_RECORD_ARBITRARY_TRANSITION:
+			g_string_append (output, "arbitrary transition");
+			break;
+		default:
+			g_string_append_printf (output, "unknown record kind %u", (guint) kind);
+			break;
+	}
+
+	g_free (value_string);
+
+	/* Append the output sequence. */
+	g_variant_iter_init (&iter, entries);
+
+	while ((entry = g_variant_iter_next_value (&iter)) != NULL) {
+		guint8 entry_type;
+		const gchar *name, *detail;
+		GVariant *parameters;
+
+		g_variant_get (entry, "(y&s&sv)", &entry_type, &name, &detail, &parameters);
+		value_string = g_variant_print (parameters, FALSE);
+
+		switch ((DsimRecordingEntryType) entry_type) {
+			case DSIM_RECORDING_ENTRY_REPLY:
+				g_string_append_printf (output, " → reply %s", value_string);
+				break;
+			case DSIM_RECORDING_ENTRY_THROW:
+				g_string_append_printf (output, " → throw %s: %s", name, detail);
+				break;
+			case DSIM_RECORDING_ENTRY_EMIT:
+				g_string_append_printf (output, " → emit %s.%s%s", name, detail, value_string);
+				break;
+			default:
+				g_string_append_printf (output, " → unknown entry type %u", (guint) entry_type);
+				break;
+		}
+
+		g_free (value_string);
+		g_variant_unref (parameters);
+		g_variant_unref (entry);
+	}
+
+	g_variant_unref (entries);
+	g_variant_unref (value);
+
+	return g_string_free (output, FALSE);
+}
@@ -0,0 +1,105 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#ifndef DSIM_RECORDER_H
+#define DSIM_RECORDER_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimRecorderMode:
+ * @DSIM_RECORDER_MODE_RECORD: Record the conversation between the simulated objects and the program under test to a file.
+ * @DSIM_RECORDER_MODE_REPLAY: Replay a previously recorded conversation from a file, without evaluating the simulated objects’ machines.
+ *
+ * The direction in which a #DsimRecorder operates.
+ */
+typedef enum {
+	DSIM_RECORDER_MODE_RECORD = 0,
+	DSIM_RECORDER_MODE_REPLAY,
+} DsimRecorderMode;
+
+/**
+ * DsimRecordKind:
+ * @DSIM_RECORD_HEADER: Header of the recording, containing the random number generator seed.
+ * @DSIM_RECORD_ITERATION: Marker for the start of a new test run.
+ * @DSIM_RECORD_METHOD_CALL: A D-Bus method call, plus the output sequence produced in response.
+ * @DSIM_RECORD_GET_PROPERTY: A D-Bus property get, plus the property’s value.
+ * @DSIM_RECORD_SET_PROPERTY: A D-Bus property set, plus the output sequence produced in response.
+ * @DSIM_RECORD_ARBITRARY_TRANSITION: An arbitrary transition, plus the output sequence it produced.
+ *
+ * The kind of a record in a recording file. These values are written to recording files, so must not be renumbered.
+ */
+typedef enum {
+	DSIM_RECORD_HEADER = 0,
+	DSIM_RECORD_ITERATION = 1,
+	DSIM_RECORD_METHOD_CALL = 2,
+	DSIM_RECORD_GET_PROPERTY = 3,
+	DSIM_RECORD_SET_PROPERTY = 4,
+	DSIM_RECORD_ARBITRARY_TRANSITION = 5,
+} DsimRecordKind;
+
+#define DSIM_TYPE_RECORDER		(dsim_recorder_get_type ())
+#define DSIM_RECORDER(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DSIM_TYPE_RECORDER, DsimRecorder))
+#define DSIM_RECORDER_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), DSIM_TYPE_RECORDER, DsimRecorderClass))
+#define DSIM_IS_RECORDER(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), DSIM_TYPE_RECORDER))
+#define DSIM_IS_RECORDER_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), DSIM_TYPE_RECORDER))
+#define DSIM_RECORDER_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), DSIM_TYPE_RECORDER, DsimRecorderClass))
+
+typedef struct _DsimRecorderPrivate	DsimRecorderPrivate;
+
+typedef struct {
+	GObject parent;
+	DsimRecorderPrivate *priv;
+} DsimRecorder;
+
+typedef struct {
+	GObjectClass parent;
+} DsimRecorderClass;
+
+GType dsim_recorder_get_type (void) G_GNUC_CONST;
+
+DsimRecorder *dsim_recorder_new_for_recording (GFile *file, gint64 random_seed, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+DsimRecorder *dsim_recorder_new_for_replay (GFile *file, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+DsimRecorder *dsim_recorder_new_for_history (gint64 random_seed, guint history_length) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+void dsim_recorder_attach_object (DsimRecorder *self, DfsmObject *simulated_object);
+void dsim_recorder_start_iteration (DsimRecorder *self, guint iteration);
+
+void dsim_recorder_set_history_length (DsimRecorder *self, guint history_length);
+GPtrArray/*<GVariant>*/ *dsim_recorder_dup_history (DsimRecorder *self) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+DsimRecorderMode dsim_recorder_get_mode (DsimRecorder *self) G_GNUC_PURE;
+gint64 dsim_recorder_get_random_seed (DsimRecorder *self) G_GNUC_PURE;
+
+GPtrArray/*<GVariant>*/ *dsim_recorder_load_records (GFile *file, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+gboolean dsim_recorder_save_records (GFile *file, GPtrArray/*<GVariant>*/ *records, GError **error);
+
+DsimRecordKind dsim_record_get_kind (GVariant *record);
+GVariant *dsim_record_dup_entries (GVariant *record) G_GNUC_WARN_UNUSED_RESULT;
+GVariant *dsim_record_new_with_entries (GVariant *record, GVariant *entries) G_GNUC_WARN_UNUSED_RESULT;
+gchar *dsim_record_to_string (GVariant *record) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_END_DECLS
+
+#endif /* !DSIM_RECORDER_H */
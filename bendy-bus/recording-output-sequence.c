@@ -0,0 +1,381 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:recording-output-sequence
+ * @short_description: recording output sequence
+ *
+ * Implementation of #DfsmOutputSequence which wraps another output sequence, passing all actions through to it unchanged while keeping a
+ * serialisable copy of each of them. This allows the conversation between the simulator and the program under test to be recorded (and later
+ * replayed) without the simulated machines having to know anything about it.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#include "recording-output-sequence.h"
+
+static void dsim_recording_output_sequence_iface_init (DfsmOutputSequenceInterface *iface);
+static void dsim_recording_output_sequence_dispose (GObject *object);
+static void dsim_recording_output_sequence_finalize (GObject *object);
+static void dsim_recording_output_sequence_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void dsim_recording_output_sequence_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+static void dsim_recording_output_sequence_output (DfsmOutputSequence *sequence, GError **error);
+static void dsim_recording_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *parameters);
+static void dsim_recording_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error);
+static void dsim_recording_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
+                                                     GVariant *parameters);
+static void dsim_recording_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name,
+                                                                const gchar *property_name, GVariant *value);
+static void dsim_recording_output_sequence_add_constant_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
+                                                              GVariant *parameters);
+static void dsim_recording_output_sequence_add_constant_reply (DfsmOutputSequence *sequence, GVariant *parameters);
+static void dsim_recording_output_sequence_add_instantiate (DfsmOutputSequence *sequence, const gchar *object_path);
+static void dsim_recording_output_sequence_add_destroy (DfsmOutputSequence *sequence, const gchar *object_path);
+
+struct _DsimRecordingOutputSequencePrivate {
+	DfsmOutputSequence *inner_sequence;
+	GPtrArray/*<GVariant>*/ *entries; /* in the order they were added */
+};
+
+enum {
+	PROP_INNER_SEQUENCE = 1,
+};
+
+G_DEFINE_TYPE_EXTENDED (DsimRecordingOutputSequence, dsim_recording_output_sequence, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (DFSM_TYPE_OUTPUT_SEQUENCE, dsim_recording_output_sequence_iface_init))
+
+static void
+dsim_recording_output_sequence_class_init (DsimRecordingOutputSequenceClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DsimRecordingOutputSequencePrivate));
+
+	gobject_class->get_property = dsim_recording_output_sequence_get_property;
+	gobject_class->set_property = dsim_recording_output_sequence_set_property;
+	gobject_class->dispose = dsim_recording_output_sequence_dispose;
+	gobject_class->finalize = dsim_recording_output_sequence_finalize;
+
+	/**
+	 * DsimRecordingOutputSequence:inner-sequence:
+	 *
+	 * The output sequence which all actions are passed through to.
+	 */
+	g_object_class_install_property (gobject_class, PROP_INNER_SEQUENCE,
+	                                 g_param_spec_object ("inner-sequence",
+	                                                      "Inner sequence", "The output sequence which all actions are passed through to.",
+	                                                      DFSM_TYPE_OUTPUT_SEQUENCE,
+	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+dsim_recording_output_sequence_init (DsimRecordingOutputSequence *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE, DsimRecordingOutputSequencePrivate);
+
+	self->priv->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+}
+
+static void
+dsim_recording_output_sequence_iface_init (DfsmOutputSequenceInterface *iface)
+{
+	iface->output = dsim_recording_output_sequence_output;
+	iface->add_reply = dsim_recording_output_sequence_add_reply;
+	iface->add_throw = dsim_recording_output_sequence_add_throw;
+	iface->add_emit = dsim_recording_output_sequence_add_emit;
+	iface->add_property_change = dsim_recording_output_sequence_add_property_change;
+	iface->add_constant_emit = dsim_recording_output_sequence_add_constant_emit;
+	iface->add_constant_reply = dsim_recording_output_sequence_add_constant_reply;
+	iface->add_instantiate = dsim_recording_output_sequence_add_instantiate;
+	iface->add_destroy = dsim_recording_output_sequence_add_destroy;
+}
+
+static void
+dsim_recording_output_sequence_dispose (GObject *object)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (object)->priv;
+
+	g_clear_object (&priv->inner_sequence);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dsim_recording_output_sequence_parent_class)->dispose (object);
+}
+
+static void
+dsim_recording_output_sequence_finalize (GObject *object)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (object)->priv;
+
+	g_ptr_array_unref (priv->entries);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dsim_recording_output_sequence_parent_class)->finalize (object);
+}
+
+static void
+dsim_recording_output_sequence_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (object)->priv;
+
+	switch (property_id) {
+		case PROP_INNER_SEQUENCE:
+			g_value_set_object (value, priv->inner_sequence);
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static void
+dsim_recording_output_sequence_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (object)->priv;
+
+	switch (property_id) {
+		case PROP_INNER_SEQUENCE:
+			/* Construct-only */
+			priv->inner_sequence = g_value_dup_object (value);
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static void
+dsim_recording_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	dfsm_output_sequence_output (priv->inner_sequence, error);
+}
+
+static void
+dsim_recording_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *parameters)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_REPLY, "", "", parameters)));
+
+	dfsm_output_sequence_add_reply (priv->inner_sequence, parameters);
+}
+
+static void
+dsim_recording_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+	gchar *error_name;
+
+	/* Store the error as its D-Bus name, since that's what the program under test sees and it can be reconstituted into an equivalent GError. */
+	error_name = g_dbus_error_encode_gerror (throw_error);
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_THROW, error_name, throw_error->message,
+	                                                                   g_variant_new_tuple (NULL, 0))));
+	g_free (error_name);
+
+	dfsm_output_sequence_add_throw (priv->inner_sequence, throw_error);
+}
+
+static void
+dsim_recording_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name, GVariant *parameters)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_EMIT, interface_name, signal_name,
+	                                                                   parameters)));
+
+	dfsm_output_sequence_add_emit (priv->inner_sequence, interface_name, signal_name, parameters);
+}
+
+static void
+dsim_recording_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *property_name,
+                                                    GVariant *value)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+	GVariant *maybe_value;
+
+	/* Invalidations are recorded as Nothing. */
+	maybe_value = g_variant_new_maybe (G_VARIANT_TYPE_VARIANT, (value != NULL) ? g_variant_new_variant (value) : NULL);
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_PROPERTY_CHANGE, interface_name,
+	                                                                   property_name, maybe_value)));
+
+	dfsm_output_sequence_add_property_change (priv->inner_sequence, interface_name, property_name, value);
+}
+
+static void
+dsim_recording_output_sequence_add_constant_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
+                                                  GVariant *parameters)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	/* Recorded as a normal emission; only the inner sequence cares that the parameters are constant. */
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_EMIT, interface_name, signal_name,
+	                                                                   parameters)));
+
+	dfsm_output_sequence_add_constant_emit (priv->inner_sequence, interface_name, signal_name, parameters);
+}
+
+static void
+dsim_recording_output_sequence_add_constant_reply (DfsmOutputSequence *sequence, GVariant *parameters)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_REPLY, "", "", parameters)));
+
+	dfsm_output_sequence_add_constant_reply (priv->inner_sequence, parameters);
+}
+
+static void
+dsim_recording_output_sequence_add_instantiate (DfsmOutputSequence *sequence, const gchar *object_path)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_INSTANTIATE, object_path, "",
+	                                                                   g_variant_new ("()"))));
+
+	dfsm_output_sequence_add_instantiate (priv->inner_sequence, object_path);
+}
+
+static void
+dsim_recording_output_sequence_add_destroy (DfsmOutputSequence *sequence, const gchar *object_path)
+{
+	DsimRecordingOutputSequencePrivate *priv = DSIM_RECORDING_OUTPUT_SEQUENCE (sequence)->priv;
+
+	g_ptr_array_add (priv->entries, g_variant_ref_sink (g_variant_new ("(yssv)", DSIM_RECORDING_ENTRY_DESTROY, object_path, "",
+	                                                                   g_variant_new ("()"))));
+
+	dfsm_output_sequence_add_destroy (priv->inner_sequence, object_path);
+}
+
+/**
+ * dsim_recording_output_sequence_new:
+ * @inner_sequence: the output sequence to pass all actions through to
+ *
+ * Create a new #DsimRecordingOutputSequence wrapping @inner_sequence.
+ *
+ * Return value: (transfer full): a new #DsimRecordingOutputSequence
+ */
+DsimRecordingOutputSequence *
+dsim_recording_output_sequence_new (DfsmOutputSequence *inner_sequence)
+{
+	g_return_val_if_fail (DFSM_IS_OUTPUT_SEQUENCE (inner_sequence), NULL);
+
+	return g_object_new (DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE,
+	                     "inner-sequence", inner_sequence,
+	                     NULL);
+}
+
+/**
+ * dsim_recording_output_sequence_build_entries:
+ * @self: a #DsimRecordingOutputSequence
+ *
+ * Build a #GVariant array of all the actions which have been added to the output sequence so far, in the order they were added. Each element of
+ * the array is of type %DSIM_RECORDING_ENTRY_TYPE_STRING.
+ *
+ * Return value: (transfer full): a non-floating array of recorded entries
+ */
+GVariant *
+dsim_recording_output_sequence_build_entries (DsimRecordingOutputSequence *self)
+{
+	g_return_val_if_fail (DSIM_IS_RECORDING_OUTPUT_SEQUENCE (self), NULL);
+
+	return g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE (DSIM_RECORDING_ENTRY_TYPE_STRING),
+	                                                (GVariant * const *) self->priv->entries->pdata, self->priv->entries->len));
+}
+
+/**
+ * dsim_recording_output_sequence_replay_entries:
+ * @entries: an array of recorded entries, as returned by dsim_recording_output_sequence_build_entries()
+ * @output_sequence: the output sequence to add the entries to
+ *
+ * Add each of the recorded @entries to @output_sequence, in order, exactly as they were originally added to the #DsimRecordingOutputSequence which
+ * recorded them.
+ */
+void
+dsim_recording_output_sequence_replay_entries (GVariant *entries, DfsmOutputSequence *output_sequence)
+{
+	GVariantIter iter;
+	guint8 entry_type;
+	const gchar *first_name, *second_name;
+	GVariant *parameters;
+
+	g_return_if_fail (entries != NULL);
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (output_sequence));
+
+	g_variant_iter_init (&iter, entries);
+
+	while (g_variant_iter_loop (&iter, "(y&s&sv)", &entry_type, &first_name, &second_name, &parameters) == TRUE) {
+		switch (entry_type) {
+			case DSIM_RECORDING_ENTRY_REPLY:
+				dfsm_output_sequence_add_reply (output_sequence, parameters);
+				break;
+			case DSIM_RECORDING_ENTRY_THROW: {
+				GError *throw_error;
+
+				throw_error = g_dbus_error_new_for_dbus_error (first_name, second_name);
+				g_dbus_error_strip_remote_error (throw_error);
+
+				dfsm_output_sequence_add_throw (output_sequence, throw_error);
+
+				g_error_free (throw_error);
+
+				break;
+			}
+			case DSIM_RECORDING_ENTRY_EMIT:
+				dfsm_output_sequence_add_emit (output_sequence, first_name, second_name, parameters);
+				break;
+			case DSIM_RECORDING_ENTRY_PROPERTY_CHANGE: {
+				GVariant *value = NULL;
+
+				if (g_variant_is_of_type (parameters, G_VARIANT_TYPE ("mv")) == FALSE) {
+					g_warning ("Skipping recorded property change with invalid value type ‘%s’.", g_variant_get_type_string (parameters));
+					break;
+				}
+
+				g_variant_get (parameters, "mv", &value);
+				dfsm_output_sequence_add_property_change (output_sequence, first_name, second_name, value);
+
+				if (value != NULL) {
+					g_variant_unref (value);
+				}
+
+				break;
+			}
+			case DSIM_RECORDING_ENTRY_INSTANTIATE:
+			case DSIM_RECORDING_ENTRY_DESTROY:
+				if (g_variant_is_object_path (first_name) == FALSE) {
+					g_warning ("Skipping recorded instance entry with invalid object path ‘%s’.", first_name);
+				} else if (entry_type == DSIM_RECORDING_ENTRY_INSTANTIATE) {
+					dfsm_output_sequence_add_instantiate (output_sequence, first_name);
+				} else {
+					dfsm_output_sequence_add_destroy (output_sequence, first_name);
+				}
+
+				break;
+			default:
+				/* Corrupt or newer recording. Skip the entry rather than aborting the replay. */
+				g_warning ("Skipping recorded output entry of unknown type %u.", entry_type);
+				break;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <dfsm/dfsm.h>
+
+#ifndef DSIM_RECORDING_OUTPUT_SEQUENCE_H
+#define DSIM_RECORDING_OUTPUT_SEQUENCE_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimRecordingEntryType:
+ * @DSIM_RECORDING_ENTRY_REPLY: a successful reply to a D-Bus method call
+ * @DSIM_RECORDING_ENTRY_THROW: an error reply to a D-Bus method call
+ * @DSIM_RECORDING_ENTRY_EMIT: a D-Bus signal emission
+ * @DSIM_RECORDING_ENTRY_PROPERTY_CHANGE: a change to (or invalidation of) a D-Bus property
+ * @DSIM_RECORDING_ENTRY_INSTANTIATE: the creation of an instance of the simulated object
+ * @DSIM_RECORDING_ENTRY_DESTROY: the destruction of an instance of the simulated object
+ *
+ * The type of an entry recorded by a #DsimRecordingOutputSequence. These values are written to recording files, so must not be renumbered.
+ */
+typedef enum {
+	DSIM_RECORDING_ENTRY_REPLY = 0,
+	DSIM_RECORDING_ENTRY_THROW = 1,
+	DSIM_RECORDING_ENTRY_EMIT = 2,
+	DSIM_RECORDING_ENTRY_PROPERTY_CHANGE = 3,
+	DSIM_RECORDING_ENTRY_INSTANTIATE = 4,
+	DSIM_RECORDING_ENTRY_DESTROY = 5,
+} DsimRecordingEntryType;
+
+/**
+ * DSIM_RECORDING_ENTRY_TYPE_STRING:
+ *
+ * #GVariant type string for a single recorded output sequence entry: the entry type, two names and the entry’s parameters. For replies, both names
+ * are empty; for throws they’re the D-Bus error name and the error message (and the parameters are the unit tuple); and for emits they’re the
+ * interface and signal names. For property changes they’re the interface and property names, and the parameters are the property’s new value as
+ * a maybe-variant (Nothing if the property was only invalidated). For instantiations and destructions, the first name is the instance’s object path,
+ * the second is empty and the parameters are the unit tuple.
+ */
+#define DSIM_RECORDING_ENTRY_TYPE_STRING "(yssv)"
+
+#define DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE		(dsim_recording_output_sequence_get_type ())
+#define DSIM_RECORDING_OUTPUT_SEQUENCE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE, DsimRecordingOutputSequence))
+#define DSIM_RECORDING_OUTPUT_SEQUENCE_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE, DsimRecordingOutputSequenceClass))
+#define DSIM_IS_RECORDING_OUTPUT_SEQUENCE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE))
+#define DSIM_IS_RECORDING_OUTPUT_SEQUENCE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE))
+#define DSIM_RECORDING_OUTPUT_SEQUENCE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), DSIM_TYPE_RECORDING_OUTPUT_SEQUENCE, DsimRecordingOutputSequenceClass))
+
+typedef struct _DsimRecordingOutputSequencePrivate	DsimRecordingOutputSequencePrivate;
+
+typedef struct {
+	GObject parent;
+	DsimRecordingOutputSequencePrivate *priv;
+} DsimRecordingOutputSequence;
+
+typedef struct {
+	GObjectClass parent;
+} DsimRecordingOutputSequenceClass;
+
+GType dsim_recording_output_sequence_get_type (void) G_GNUC_CONST;
+
+DsimRecordingOutputSequence *dsim_recording_output_sequence_new (DfsmOutputSequence *inner_sequence) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+GVariant *dsim_recording_output_sequence_build_entries (DsimRecordingOutputSequence *self) G_GNUC_WARN_UNUSED_RESULT;
+
+void dsim_recording_output_sequence_replay_entries (GVariant *entries, DfsmOutputSequence *output_sequence);
+
+G_END_DECLS
+
+#endif /* !DSIM_RECORDING_OUTPUT_SEQUENCE_H */
@@ -0,0 +1,149 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include "resource-usage.h"
+
+/* Fields of DsimResourceUsage which are summarised, as key file key prefixes. */
+typedef enum {
+	FIELD_USER_TIME = 0,
+	FIELD_SYSTEM_TIME,
+	FIELD_MAX_RSS,
+	FIELD_VOLUNTARY_CONTEXT_SWITCHES,
+	FIELD_INVOLUNTARY_CONTEXT_SWITCHES,
+	FIELD_MAX_OPEN_FDS,
+} Field;
+
+static const gchar *field_names[] = {
+	"UserTime",
+	"SystemTime",
+	"MaxRSS",
+	"VoluntaryContextSwitches",
+	"InvoluntaryContextSwitches",
+	"MaxOpenFDs",
+};
+
+static gdouble
+get_field (const DsimResourceUsage *usage, Field field)
+{
+	switch (field) {
+		case FIELD_USER_TIME:
+			return usage->user_time;
+		case FIELD_SYSTEM_TIME:
+			return usage->system_time;
+		case FIELD_MAX_RSS:
+			return usage->max_rss;
+		case FIELD_VOLUNTARY_CONTEXT_SWITCHES:
+			return usage->voluntary_context_switches;
+		case FIELD_INVOLUNTARY_CONTEXT_SWITCHES:
+			return usage->involuntary_context_switches;
+		case FIELD_MAX_OPEN_FDS:
+			return usage->max_open_fds;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+static gint
+compare_doubles (const gdouble *a, const gdouble *b)
+{
+	return (*a < *b) ? -1 : (*a > *b) ? 1 : 0;
+}
+
+/**
+ * dsim_resource_usage_to_key_file:
+ * @usage: a #DsimResourceUsage
+ * @key_file: key file to add the usage to
+ * @group_name: name of the group to add the usage to
+ *
+ * Adds the fields of @usage to @key_file as keys in @group_name, in a machine-readable form.
+ */
+void
+dsim_resource_usage_to_key_file (const DsimResourceUsage *usage, GKeyFile *key_file, const gchar *group_name)
+{
+	guint i;
+
+	g_return_if_fail (usage != NULL);
+	g_return_if_fail (key_file != NULL);
+	g_return_if_fail (group_name != NULL);
+
+	g_key_file_set_integer (key_file, group_name, "Iteration", usage->iteration);
+
+	for (i = 0; i < G_N_ELEMENTS (field_names); i++) {
+		g_key_file_set_double (key_file, group_name, field_names[i], get_field (usage, i));
+	}
+}
+
+/**
+ * dsim_resource_usage_summarise:
+ * @usages: array of #DsimResourceUsage<!-- -->s, one per test run
+ * @key_file: key file to add the summary to
+ * @group_name: name of the group to add the summary to
+ *
+ * Summarises the resource usage over all the test runs in @usages, adding the number of test runs and the mean, 95th percentile and maximum of each
+ * field to @key_file as keys in @group_name (e.g. <literal>UserTimeMean</literal>, <literal>UserTimeP95</literal> and
+ * <literal>UserTimeMax</literal>). The 95th percentile uses the nearest-rank method.
+ */
+void
+dsim_resource_usage_summarise (GArray/*<DsimResourceUsage>*/ *usages, GKeyFile *key_file, const gchar *group_name)
+{
+	gdouble *values;
+	guint i, j;
+
+	g_return_if_fail (usages != NULL);
+	g_return_if_fail (key_file != NULL);
+	g_return_if_fail (group_name != NULL);
+
+	g_key_file_set_integer (key_file, group_name, "Iterations", usages->len);
+
+	if (usages->len == 0) {
+		return;
+	}
+
+	values = g_new (gdouble, usages->len);
+
+	for (i = 0; i < G_N_ELEMENTS (field_names); i++) {
+		gdouble total = 0.0;
+		gchar *key;
+
+		for (j = 0; j < usages->len; j++) {
+			values[j] = get_field (&g_array_index (usages, DsimResourceUsage, j), i);
+			total += values[j];
+		}
+
+		qsort (values, usages->len, sizeof (gdouble), (int (*) (const void *, const void *)) compare_doubles);
+
+		key = g_strconcat (field_names[i], "Mean", NULL);
+		g_key_file_set_double (key_file, group_name, key, total / usages->len);
+		g_free (key);
+
+		/* Nearest rank: the smallest value which is at least 95% of the values. */
+		key = g_strconcat (field_names[i], "P95", NULL);
+		g_key_file_set_double (key_file, group_name, key, values[MAX ((95 * usages->len + 99) / 100, 1) - 1]);
+		g_free (key);
+
+		key = g_strconcat (field_names[i], "Max", NULL);
+		g_key_file_set_double (key_file, group_name, key, values[usages->len - 1]);
+		g_free (key);
+	}
+
+	g_free (values);
+}
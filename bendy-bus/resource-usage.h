@@ -0,0 +1,56 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#ifndef DSIM_RESOURCE_USAGE_H
+#define DSIM_RESOURCE_USAGE_H
+
+G_BEGIN_DECLS
+
+/**
+ * DsimResourceUsage:
+ * @iteration: (1-based) number of the test run the usage is for
+ * @user_time: CPU time spent in user mode, in seconds
+ * @system_time: CPU time spent in kernel mode, in seconds
+ * @max_rss: peak resident set size, in KiB
+ * @voluntary_context_switches: number of voluntary context switches (e.g. blocking on I/O)
+ * @involuntary_context_switches: number of involuntary context switches (i.e. pre-emptions)
+ * @max_open_fds: peak number of open file descriptors
+ *
+ * Resource usage of a single run of a program. CPU times and context switch counts are exact (and include any children the program waited for), as
+ * returned by <function>wait4()</function>; the peak RSS and file descriptor count are sampled periodically from <filename>/proc</filename> while
+ * the program's running, so may miss short-lived peaks.
+ */
+typedef struct {
+	guint iteration;
+	gdouble user_time;
+	gdouble system_time;
+	glong max_rss;
+	glong voluntary_context_switches;
+	glong involuntary_context_switches;
+	guint max_open_fds;
+} DsimResourceUsage;
+
+void dsim_resource_usage_to_key_file (const DsimResourceUsage *usage, GKeyFile *key_file, const gchar *group_name);
+void dsim_resource_usage_summarise (GArray/*<DsimResourceUsage>*/ *usages, GKeyFile *key_file, const gchar *group_name);
+
+G_END_DECLS
+
+#endif /* !DSIM_RESOURCE_USAGE_H */
@@ -0,0 +1,237 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "bendy-bus/bus-broker.h"
+
+#define TEST_NAME "uk.ac.cam.cl.DBusSimulator.BrokerTest"
+#define TEST_PATH "/uk/ac/cam/cl/DBusSimulator/BrokerTest"
+#define TEST_INTERFACE "uk.ac.cam.cl.DBusSimulator.BrokerTest"
+
+static const gchar *introspection_xml =
+	"<node>"
+		"<interface name='" TEST_INTERFACE "'>"
+			"<method name='Echo'>"
+				"<arg type='s' name='Input' direction='in'/>"
+				"<arg type='s' name='Output' direction='out'/>"
+			"</method>"
+			"<signal name='Ping'>"
+				"<arg type='u' name='Count'/>"
+			"</signal>"
+		"</interface>"
+	"</node>";
+
+typedef struct {
+	GDBusConnection *service_connection;
+	GDBusConnection *client_connection;
+	gchar *echo_sender; /* sender of the most recent Echo call, as seen by the service */
+	GVariant *echo_reply; /* NULL until the client has received the reply */
+	gchar *ping_sender; /* NULL until the client has received the signal */
+	guint32 ping_count;
+	gboolean name_acquired;
+} BrokerTestData;
+
+static void
+wait_for_pointer (gpointer *pointer)
+{
+	while (*pointer == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+connection_ready_cb (GObject *source_object, GAsyncResult *async_result, GDBusConnection **connection)
+{
+	GError *error = NULL;
+
+	*connection = g_dbus_connection_new_for_address_finish (async_result, &error);
+	g_assert_no_error (error);
+}
+
+/* The connection has to be made asynchronously, since the broker only sees the new connection (and hence replies to Hello) once the main context
+ * is iterated. */
+static GDBusConnection *
+connect_to_broker (DsimBusBroker *broker)
+{
+	GDBusConnection *connection = NULL;
+
+	g_dbus_connection_new_for_address (dsim_bus_broker_get_bus_address (broker),
+	                                   G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION, NULL, NULL,
+	                                   (GAsyncReadyCallback) connection_ready_cb, &connection);
+	wait_for_pointer ((gpointer *) &connection);
+
+	return connection;
+}
+
+static void
+service_method_call_cb (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
+                        const gchar *method_name, GVariant *parameters, GDBusMethodInvocation *invocation, BrokerTestData *data)
+{
+	const gchar *input;
+
+	g_assert_cmpstr (method_name, ==, "Echo");
+
+	g_free (data->echo_sender);
+	data->echo_sender = g_strdup (sender);
+
+	g_variant_get (parameters, "(&s)", &input);
+	g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", input));
+}
+
+static const GDBusInterfaceVTable service_vtable = {
+	(GDBusInterfaceMethodCallFunc) service_method_call_cb,
+	NULL,
+	NULL,
+};
+
+static void
+name_acquired_cb (GDBusConnection *connection, const gchar *name, BrokerTestData *data)
+{
+	data->name_acquired = TRUE;
+}
+
+static void
+name_lost_cb (GDBusConnection *connection, const gchar *name, BrokerTestData *data)
+{
+	g_assert_not_reached ();
+}
+
+static void
+echo_reply_cb (GDBusConnection *connection, GAsyncResult *async_result, BrokerTestData *data)
+{
+	GError *error = NULL;
+
+	data->echo_reply = g_dbus_connection_call_finish (connection, async_result, &error);
+	g_assert_no_error (error);
+}
+
+static void
+ping_cb (GDBusConnection *connection, const gchar *sender_name, const gchar *object_path, const gchar *interface_name, const gchar *signal_name,
+         GVariant *parameters, BrokerTestData *data)
+{
+	g_assert_cmpstr (object_path, ==, TEST_PATH);
+	g_assert_cmpstr (signal_name, ==, "Ping");
+
+	g_variant_get (parameters, "(u)", &data->ping_count);
+	data->ping_sender = g_strdup (sender_name);
+}
+
+static void
+test_bus_broker_round_trip (void)
+{
+	DsimBusBroker *broker;
+	GFile *working_directory;
+	gchar *working_directory_path;
+	GDBusNodeInfo *node_info;
+	BrokerTestData data = { NULL, };
+	const gchar *service_unique_name, *client_unique_name, *output;
+	guint registration_id, name_id, subscription_id;
+	GError *error = NULL;
+
+	working_directory_path = g_dir_make_tmp ("bendy-bus-broker-test-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	working_directory = g_file_new_for_path (working_directory_path);
+	broker = dsim_bus_broker_new (working_directory, &error);
+	g_assert_no_error (error);
+
+	/* Connecting as a message bus connection calls Hello, which must give each peer a distinct unique name. */
+	data.service_connection = connect_to_broker (broker);
+	data.client_connection = connect_to_broker (broker);
+
+	service_unique_name = g_dbus_connection_get_unique_name (data.service_connection);
+	client_unique_name = g_dbus_connection_get_unique_name (data.client_connection);
+
+	g_assert (service_unique_name != NULL && g_dbus_is_unique_name (service_unique_name) == TRUE);
+	g_assert (client_unique_name != NULL && g_dbus_is_unique_name (client_unique_name) == TRUE);
+	g_assert_cmpstr (service_unique_name, !=, client_unique_name);
+
+	/* Export an object and own a well-known name for it on the service connection. */
+	node_info = g_dbus_node_info_new_for_xml (introspection_xml, &error);
+	g_assert_no_error (error);
+
+	registration_id = g_dbus_connection_register_object (data.service_connection, TEST_PATH, node_info->interfaces[0], &service_vtable, &data,
+	                                                     NULL, &error);
+	g_assert_no_error (error);
+
+	name_id = g_bus_own_name_on_connection (data.service_connection, TEST_NAME, G_BUS_NAME_OWNER_FLAGS_NONE,
+	                                        (GBusNameAcquiredCallback) name_acquired_cb, (GBusNameLostCallback) name_lost_cb, &data, NULL);
+
+	while (data.name_acquired == FALSE) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	/* Subscribe to the service's signals by its unique name, which relies on the broker stamping messages with their senders. */
+	subscription_id = g_dbus_connection_signal_subscribe (data.client_connection, service_unique_name, TEST_INTERFACE, "Ping", TEST_PATH, NULL,
+	                                                      G_DBUS_SIGNAL_FLAGS_NONE, (GDBusSignalCallback) ping_cb, &data, NULL);
+
+	/* Call a method on the service by its well-known name. The reply is addressed to the client's unique name, so this only gets back if the
+	 * broker set the call's sender. */
+	g_dbus_connection_call (data.client_connection, TEST_NAME, TEST_PATH, TEST_INTERFACE, "Echo", g_variant_new ("(s)", "Hello, world!"),
+	                        G_VARIANT_TYPE ("(s)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, (GAsyncReadyCallback) echo_reply_cb, &data);
+	wait_for_pointer ((gpointer *) &data.echo_reply);
+
+	g_assert_cmpstr (data.echo_sender, ==, client_unique_name);
+	g_variant_get (data.echo_reply, "(&s)", &output);
+	g_assert_cmpstr (output, ==, "Hello, world!");
+
+	/* Broadcast a signal from the service. */
+	g_dbus_connection_emit_signal (data.service_connection, NULL, TEST_PATH, TEST_INTERFACE, "Ping", g_variant_new ("(u)", 42), &error);
+	g_assert_no_error (error);
+
+	wait_for_pointer ((gpointer *) &data.ping_sender);
+
+	g_assert_cmpstr (data.ping_sender, ==, service_unique_name);
+	g_assert_cmpuint (data.ping_count, ==, 42);
+
+	/* Tidy up. */
+	g_dbus_connection_signal_unsubscribe (data.client_connection, subscription_id);
+	g_bus_unown_name (name_id);
+	g_dbus_connection_unregister_object (data.service_connection, registration_id);
+	g_dbus_node_info_unref (node_info);
+
+	g_dbus_connection_close_sync (data.client_connection, NULL, NULL);
+	g_dbus_connection_close_sync (data.service_connection, NULL, NULL);
+	g_object_unref (data.client_connection);
+	g_object_unref (data.service_connection);
+
+	g_variant_unref (data.echo_reply);
+	g_free (data.echo_sender);
+	g_free (data.ping_sender);
+
+	g_object_unref (broker);
+	g_object_unref (working_directory);
+
+	g_rmdir (working_directory_path);
+	g_free (working_directory_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/bus-broker/round-trip", test_bus_broker_round_trip);
+
+	return g_test_run ();
+}
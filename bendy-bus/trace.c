@@ -0,0 +1,286 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#include "trace.h"
+
+/* Trace files are written in the JSON trace event format understood by chrome://tracing and Perfetto (ui.perfetto.dev): a JSON array of event
+ * objects, each with a name, category, phase (‘B’egin, ‘E’nd or ‘i’nstant) and a timestamp in microseconds. Timestamps come from the monotonic
+ * clock (g_get_monotonic_time()), which is the same clock used by most logging systems on Linux, so the trace can be correlated with logs from the
+ * program under test.
+ *
+ * All events are attributed to the simulator's process. The simulation runs in the main thread, except for method calls dispatched in the GDBus
+ * worker thread (--worker-thread-dispatch), which are given a second thread ID so that their spans nest correctly in the trace viewer. */
+#define TRACE_THREAD_ID 1
+#define TRACE_WORKER_THREAD_ID 2
+
+struct _DsimTraceWriter {
+	GMutex lock; /* protects everything below, since events may be added from the GDBus worker thread */
+	GOutputStream *output_stream; /* buffered */
+	GString *buffer; /* scratch space for formatting an event */
+	GError *error; /* first error encountered while writing, reported by dsim_trace_writer_close() */
+	gint pid;
+};
+
+/* Append @str to @buffer as a quoted, escaped JSON string. */
+static void
+append_json_string (GString *buffer, const gchar *str)
+{
+	const gchar *i;
+
+	g_string_append_c (buffer, '"');
+
+	for (i = str; *i != '\0'; i++) {
+		switch (*i) {
+			case '"':
+				g_string_append (buffer, "\\\"");
+				break;
+			case '\\':
+				g_string_append (buffer, "\\\\");
+				break;
+			case '\n':
+				g_string_append (buffer, "\\n");
+				break;
+			case '\r':
+				g_string_append (buffer, "\\r");
+				break;
+			case '\t':
+				g_string_append (buffer, "\\t");
+				break;
+			default:
+				if ((guchar) *i < 0x20) {
+					g_string_append_printf (buffer, "\\u%04x", (guint) *i);
+				} else {
+					g_string_append_c (buffer, *i);
+				}
+				break;
+		}
+	}
+
+	g_string_append_c (buffer, '"');
+}
+
+/* Write out the event currently in self->buffer. Errors are stored and reported when the trace is closed, since they shouldn't stop the simulation. */
+static void
+write_buffer (DsimTraceWriter *self)
+{
+	if (self->error != NULL) {
+		return;
+	}
+
+	g_output_stream_write_all (self->output_stream, self->buffer->str, self->buffer->len, NULL, NULL, &self->error);
+}
+
+/**
+ * dsim_trace_writer_new:
+ * @file: file to write the trace to
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Create a new #DsimTraceWriter which writes trace events to @file, replacing any existing file. Events can be added using
+ * dsim_trace_writer_add_event(), or by installing the writer as the libdfsm trace function using dsim_trace_writer_install().
+ *
+ * Return value: (transfer full): a new #DsimTraceWriter, or %NULL on error
+ */
+DsimTraceWriter *
+dsim_trace_writer_new (GFile *file, GError **error)
+{
+	DsimTraceWriter *self;
+	GFileOutputStream *file_stream;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	file_stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL, error);
+
+	if (file_stream == NULL) {
+		return NULL;
+	}
+
+	self = g_slice_new0 (DsimTraceWriter);
+	g_mutex_init (&self->lock);
+	self->output_stream = g_buffered_output_stream_new (G_OUTPUT_STREAM (file_stream));
+	self->buffer = g_string_sized_new (256);
+	self->pid = getpid ();
+
+	g_object_unref (file_stream);
+
+	/* Open the array of events and name the process, so it's labelled nicely in the trace viewer. */
+	g_string_printf (self->buffer, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,\"args\":{\"name\":\"bendy-bus\"}}",
+	                 self->pid, TRACE_THREAD_ID);
+	write_buffer (self);
+
+	if (self->error != NULL) {
+		g_propagate_error (error, self->error);
+		self->error = NULL;
+		dsim_trace_writer_free (self);
+
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * dsim_trace_writer_close:
+ * @self: a #DsimTraceWriter
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Finish the trace and close its file. If any errors were encountered when writing events to the file, the first of them is returned. No more events
+ * may be added after closing the writer. If the writer is installed as the libdfsm trace function, it's uninstalled.
+ *
+ * Return value: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+dsim_trace_writer_close (DsimTraceWriter *self, GError **error)
+{
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	dfsm_trace_set_func (NULL, NULL);
+
+	g_mutex_lock (&self->lock);
+
+	g_string_assign (self->buffer, "\n]\n");
+	write_buffer (self);
+
+	if (self->error == NULL) {
+		g_output_stream_close (self->output_stream, NULL, &self->error);
+	}
+
+	g_mutex_unlock (&self->lock);
+
+	if (self->error != NULL) {
+		g_propagate_error (error, self->error);
+		self->error = NULL;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * dsim_trace_writer_free:
+ * @self: (allow-none): a #DsimTraceWriter, or %NULL
+ *
+ * Free a #DsimTraceWriter. If it hasn't been closed using dsim_trace_writer_close(), the trace file will be incomplete.
+ */
+void
+dsim_trace_writer_free (DsimTraceWriter *self)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	g_clear_error (&self->error);
+	g_string_free (self->buffer, TRUE);
+	g_object_unref (self->output_stream);
+	g_mutex_clear (&self->lock);
+
+	g_slice_free (DsimTraceWriter, self);
+}
+
+/**
+ * dsim_trace_writer_add_event:
+ * @self: a #DsimTraceWriter
+ * @phase: phase of the event
+ * @category: category of the event
+ * @name: name of the event
+ * @detail: (allow-none): further detail about the event, or %NULL
+ *
+ * Add an event to the trace, timestamped with the current monotonic time. %DFSM_TRACE_PHASE_INSTANT events are given global scope, so they're drawn
+ * across the whole timeline (e.g. to mark the test program being spawned).
+ *
+ * This may be called from any thread. Events from threads other than the one owning the global default main context are attributed to the GDBus
+ * worker thread.
+ */
+void
+dsim_trace_writer_add_event (DsimTraceWriter *self, DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail)
+{
+	const gchar *phase_string;
+	gint thread_id;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	switch (phase) {
+		case DFSM_TRACE_PHASE_BEGIN:
+			phase_string = "B";
+			break;
+		case DFSM_TRACE_PHASE_END:
+			phase_string = "E";
+			break;
+		case DFSM_TRACE_PHASE_INSTANT:
+			phase_string = "i\",\"s\":\"g";
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+
+	thread_id = (g_main_context_is_owner (g_main_context_default ()) == TRUE) ? TRACE_THREAD_ID : TRACE_WORKER_THREAD_ID;
+
+	g_mutex_lock (&self->lock);
+
+	/* The process name metadata event is always written first, so every event here needs a separator. */
+	g_string_assign (self->buffer, ",\n{\"name\":");
+	append_json_string (self->buffer, name);
+	g_string_append (self->buffer, ",\"cat\":");
+	append_json_string (self->buffer, category);
+	g_string_append_printf (self->buffer, ",\"ph\":\"%s\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%i,\"tid\":%i", phase_string, g_get_monotonic_time (),
+	                        self->pid, thread_id);
+
+	if (detail != NULL) {
+		g_string_append (self->buffer, ",\"args\":{\"detail\":");
+		append_json_string (self->buffer, detail);
+		g_string_append_c (self->buffer, '}');
+	}
+
+	g_string_append_c (self->buffer, '}');
+
+	write_buffer (self);
+
+	g_mutex_unlock (&self->lock);
+}
+
+static void
+trace_cb (DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail, gpointer user_data)
+{
+	dsim_trace_writer_add_event ((DsimTraceWriter*) user_data, phase, category, name, detail);
+}
+
+/**
+ * dsim_trace_writer_install:
+ * @self: a #DsimTraceWriter
+ *
+ * Install @self as the libdfsm trace function, so that all method calls, property accesses, transitions and output sequences in the simulation are
+ * added to the trace. See dfsm_trace_set_func().
+ */
+void
+dsim_trace_writer_install (DsimTraceWriter *self)
+{
+	g_return_if_fail (self != NULL);
+
+	dfsm_trace_set_func (trace_cb, self);
+}
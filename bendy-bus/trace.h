@@ -0,0 +1,41 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <dfsm/dfsm.h>
+
+#ifndef DSIM_TRACE_H
+#define DSIM_TRACE_H
+
+G_BEGIN_DECLS
+
+typedef struct _DsimTraceWriter DsimTraceWriter;
+
+DsimTraceWriter *dsim_trace_writer_new (GFile *file, GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+gboolean dsim_trace_writer_close (DsimTraceWriter *self, GError **error);
+void dsim_trace_writer_free (DsimTraceWriter *self);
+
+void dsim_trace_writer_add_event (DsimTraceWriter *self, DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail);
+
+void dsim_trace_writer_install (DsimTraceWriter *self);
+
+G_END_DECLS
+
+#endif /* !DSIM_TRACE_H */
@@ -0,0 +1,147 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "dfsm-internal.h"
+
+/* The arena is a list of chunks, most recently allocated first. Allocations are bumped out of the head chunk, and a new chunk is pushed when it's
+ * full. Resetting the arena rewinds the head chunk if it's the only one; otherwise all the chunks are freed and the next allocation gets a single
+ * chunk big enough for everything which was allocated before the reset (up to ARENA_MAX_CHUNK_SIZE), so an arena whose dispatches all allocate
+ * about the same amount settles down to never calling malloc(). */
+#define ARENA_MIN_CHUNK_SIZE 4096
+#define ARENA_MAX_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (2 * sizeof (gpointer))
+
+struct _DfsmArenaChunk {
+	DfsmArenaChunk *next;
+	gsize size; /* bytes of data following the header */
+	gsize used; /* bytes of data allocated */
+};
+
+/* Round up so that the data following the header is aligned. */
+#define CHUNK_HEADER_SIZE ((sizeof (DfsmArenaChunk) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+static inline gpointer
+chunk_data (DfsmArenaChunk *chunk)
+{
+	return (guint8*) chunk + CHUNK_HEADER_SIZE;
+}
+
+void
+dfsm_internal_arena_init (DfsmArena *arena)
+{
+	memset (arena, 0, sizeof (*arena));
+	arena->next_chunk_size = ARENA_MIN_CHUNK_SIZE;
+}
+
+static void
+free_chunks (DfsmArena *arena)
+{
+	DfsmArenaChunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		g_free (chunk);
+	}
+
+	arena->chunks = NULL;
+}
+
+/* Free all the memory held by @arena. It may be used again afterwards. The statistics are preserved. */
+void
+dfsm_internal_arena_clear (DfsmArena *arena)
+{
+	free_chunks (arena);
+	arena->bytes_in_use = 0;
+	arena->next_chunk_size = ARENA_MIN_CHUNK_SIZE;
+}
+
+/* Allocate @size bytes from @arena. The memory is aligned suitably for any type, isn't initialised, and is valid until @arena is next reset or
+ * cleared. It must not be freed. */
+gpointer
+dfsm_internal_arena_alloc (DfsmArena *arena, gsize size)
+{
+	DfsmArenaChunk *chunk = arena->chunks;
+	gpointer retval;
+
+	size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		gsize chunk_size = MAX (arena->next_chunk_size, size);
+
+		chunk = g_malloc (CHUNK_HEADER_SIZE + chunk_size);
+		chunk->next = arena->chunks;
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		arena->chunks = chunk;
+
+		arena->statistics.num_chunk_allocations++;
+	}
+
+	retval = (guint8*) chunk_data (chunk) + chunk->used;
+	chunk->used += size;
+
+	arena->bytes_in_use += size;
+	arena->statistics.num_allocations++;
+	arena->statistics.bytes_allocated += size;
+	arena->statistics.peak_bytes_in_use = MAX (arena->statistics.peak_bytes_in_use, arena->bytes_in_use);
+
+	return retval;
+}
+
+/* Like g_strndup(), but allocates from @arena. */
+gchar *
+dfsm_internal_arena_strndup (DfsmArena *arena, const gchar *str, gsize length)
+{
+	gchar *retval;
+
+	retval = dfsm_internal_arena_alloc (arena, length + 1);
+	memcpy (retval, str, length);
+	retval[length] = '\0';
+
+	return retval;
+}
+
+/* Like g_strdup(), but allocates from @arena. */
+gchar *
+dfsm_internal_arena_strdup (DfsmArena *arena, const gchar *str)
+{
+	return dfsm_internal_arena_strndup (arena, str, strlen (str));
+}
+
+/* Release everything allocated from @arena since it was last reset. Any pointers into the arena become invalid. */
+void
+dfsm_internal_arena_reset (DfsmArena *arena)
+{
+	DfsmArenaChunk *chunk = arena->chunks;
+
+	if (chunk != NULL && (chunk->next != NULL || chunk->size > ARENA_MAX_CHUNK_SIZE)) {
+		/* The arena overflowed its first chunk, so replace them all with a single larger chunk on the next allocation. Don't hang on to
+		 * huge chunks left over from one-off large allocations, though. */
+		arena->next_chunk_size = MIN (MAX (arena->bytes_in_use, ARENA_MIN_CHUNK_SIZE), ARENA_MAX_CHUNK_SIZE);
+		free_chunks (arena);
+	} else if (chunk != NULL) {
+		chunk->used = 0;
+	}
+
+	arena->bytes_in_use = 0;
+	arena->statistics.num_resets++;
+}
@@ -37,6 +37,7 @@
 #include "dfsm-ast-data-structure.h"
 #include "dfsm-ast-expression-data-structure.h"
 #include "dfsm-ast-variable.h"
+#include "dfsm-internal.h"
 #include "dfsm-parser.h"
 #include "dfsm-parser-internal.h"
 #include "dfsm-probabilities.h"
@@ -1015,6 +1016,237 @@ dfsm_ast_data_structure_set_nickname (DfsmAstDataStructure *self, const gchar *n
 	self->priv->nickname = g_strdup (nickname);
 }
 
+/*
+ * dfsm_ast_data_structure_serialise:
+ * @self: a #DfsmAstDataStructure which hasn't been checked yet
+ * @buffer: buffer to append the serialised data structure to
+ *
+ * Serialise @self and its children for the compiled machine cache. Numbers are stored in their unparsed form, and strings are stored as
+ * bytestrings, exactly as the parser produced them.
+ */
+void
+dfsm_ast_data_structure_serialise (DfsmAstDataStructure *self, GByteArray *buffer)
+{
+	DfsmAstDataStructurePrivate *priv;
+
+	g_return_if_fail (DFSM_IS_AST_DATA_STRUCTURE (self));
+
+	priv = self->priv;
+
+	dfsm_internal_serialise_uint32 (buffer, priv->data_structure_type);
+	dfsm_internal_serialise_double (buffer, priv->weight);
+	dfsm_internal_serialise_string (buffer, priv->type_annotation);
+	dfsm_internal_serialise_string (buffer, priv->nickname);
+
+	switch (priv->data_structure_type) {
+		case DFSM_AST_DATA_BOOLEAN:
+			dfsm_internal_serialise_byte (buffer, (priv->boolean_val == TRUE) ? 1 : 0);
+			break;
+		case DFSM_AST_DATA_BYTE:
+		case DFSM_AST_DATA_INT16:
+		case DFSM_AST_DATA_UINT16:
+		case DFSM_AST_DATA_INT32:
+		case DFSM_AST_DATA_UINT32:
+		case DFSM_AST_DATA_INT64:
+		case DFSM_AST_DATA_UINT64:
+		case DFSM_AST_DATA_DOUBLE:
+			g_assert (priv->unparsed_string != NULL);
+			dfsm_internal_serialise_string (buffer, priv->unparsed_string);
+			break;
+		case DFSM_AST_DATA_STRING:
+			dfsm_internal_serialise_string (buffer, priv->string_val);
+			break;
+		case DFSM_AST_DATA_OBJECT_PATH:
+			dfsm_internal_serialise_string (buffer, priv->object_path_val);
+			break;
+		case DFSM_AST_DATA_SIGNATURE:
+			dfsm_internal_serialise_string (buffer, priv->signature_val);
+			break;
+		case DFSM_AST_DATA_ARRAY:
+			dfsm_ast_expression_serialise_array (priv->array_val, buffer);
+			break;
+		case DFSM_AST_DATA_STRUCT:
+			dfsm_ast_expression_serialise_array (priv->struct_val, buffer);
+			break;
+		case DFSM_AST_DATA_VARIANT:
+			dfsm_ast_expression_serialise (priv->variant_val, buffer);
+			break;
+		case DFSM_AST_DATA_DICT: {
+			guint i;
+
+			dfsm_internal_serialise_uint32 (buffer, priv->dict_val->len);
+
+			for (i = 0; i < priv->dict_val->len; i++) {
+				DfsmAstDictionaryEntry *entry = g_ptr_array_index (priv->dict_val, i);
+
+				dfsm_ast_expression_serialise (entry->key, buffer);
+				dfsm_ast_expression_serialise (entry->value, buffer);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_VARIABLE:
+			dfsm_ast_variable_serialise (priv->variable_val, buffer);
+			break;
+		case DFSM_AST_DATA_UNIX_FD:
+			/* Note: not representable in the FSM language, so never produced by the parser. */
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+/*
+ * dfsm_ast_data_structure_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_data_structure_serialise()
+ *
+ * Rebuild a #DfsmAstDataStructure and its children from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstDataStructure *
+dfsm_ast_data_structure_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstDataStructure *data_structure = NULL;
+	guint32 data_structure_type;
+	gdouble weight;
+	const gchar *type_annotation, *nickname;
+
+	if (dfsm_internal_deserialise_uint32 (deserialiser, &data_structure_type) == FALSE ||
+	    dfsm_internal_deserialise_double (deserialiser, &weight) == FALSE ||
+	    dfsm_internal_deserialise_maybe_string (deserialiser, &type_annotation) == FALSE ||
+	    dfsm_internal_deserialise_maybe_string (deserialiser, &nickname) == FALSE) {
+		return NULL;
+	}
+
+	/* The weight was normalised when the data structure was first parsed. */
+	if (!(weight >= 0.0) || (type_annotation != NULL && *type_annotation == '\0') || (nickname != NULL && *nickname == '\0')) {
+		return NULL;
+	}
+
+	switch (data_structure_type) {
+		case DFSM_AST_DATA_BOOLEAN: {
+			guint8 boolean_val;
+
+			if (dfsm_internal_deserialise_byte (deserialiser, &boolean_val) == TRUE && boolean_val <= 1) {
+				data_structure = dfsm_ast_data_structure_new (DFSM_AST_DATA_BOOLEAN, GUINT_TO_POINTER (boolean_val));
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_BYTE:
+		case DFSM_AST_DATA_INT16:
+		case DFSM_AST_DATA_UINT16:
+		case DFSM_AST_DATA_INT32:
+		case DFSM_AST_DATA_UINT32:
+		case DFSM_AST_DATA_INT64:
+		case DFSM_AST_DATA_UINT64:
+		case DFSM_AST_DATA_DOUBLE:
+		case DFSM_AST_DATA_STRING:
+		case DFSM_AST_DATA_OBJECT_PATH:
+		case DFSM_AST_DATA_SIGNATURE: {
+			const gchar *value;
+
+			if (dfsm_internal_deserialise_bytestring (deserialiser, &value) == TRUE) {
+				data_structure = dfsm_ast_data_structure_new (data_structure_type, (gpointer) value);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_ARRAY:
+		case DFSM_AST_DATA_STRUCT: {
+			GPtrArray/*<DfsmAstExpression>*/ *expressions;
+
+			expressions = dfsm_ast_expression_deserialise_array (deserialiser);
+
+			if (expressions != NULL) {
+				data_structure = dfsm_ast_data_structure_new (data_structure_type, expressions);
+				g_ptr_array_unref (expressions);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_VARIANT: {
+			DfsmAstExpression *expression;
+
+			expression = dfsm_ast_expression_deserialise (deserialiser);
+
+			if (expression != NULL) {
+				data_structure = dfsm_ast_data_structure_new (DFSM_AST_DATA_VARIANT, expression);
+				g_object_unref (expression);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_DICT: {
+			GPtrArray/*<DfsmAstDictionaryEntry>*/ *entries;
+			guint32 n_entries, i;
+
+			if (dfsm_internal_deserialise_length (deserialiser, &n_entries) == FALSE) {
+				break;
+			}
+
+			entries = g_ptr_array_new_with_free_func ((GDestroyNotify) dfsm_ast_dictionary_entry_free);
+
+			for (i = 0; entries != NULL && i < n_entries; i++) {
+				DfsmAstExpression *key, *entry_value = NULL;
+
+				key = dfsm_ast_expression_deserialise (deserialiser);
+
+				if (key != NULL) {
+					entry_value = dfsm_ast_expression_deserialise (deserialiser);
+				}
+
+				if (key != NULL && entry_value != NULL) {
+					g_ptr_array_add (entries, dfsm_ast_dictionary_entry_new (key, entry_value));
+				} else {
+					g_ptr_array_unref (entries);
+					entries = NULL;
+				}
+
+				if (entry_value != NULL) {
+					g_object_unref (entry_value);
+				}
+
+				if (key != NULL) {
+					g_object_unref (key);
+				}
+			}
+
+			if (entries != NULL) {
+				data_structure = dfsm_ast_data_structure_new (DFSM_AST_DATA_DICT, entries);
+				g_ptr_array_unref (entries);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_VARIABLE: {
+			DfsmAstVariable *variable;
+
+			variable = dfsm_ast_variable_deserialise (deserialiser);
+
+			if (variable != NULL) {
+				data_structure = dfsm_ast_data_structure_new (DFSM_AST_DATA_VARIABLE, variable);
+				g_object_unref (variable);
+			}
+
+			break;
+		}
+		case DFSM_AST_DATA_UNIX_FD:
+		default:
+			/* Invalid */
+			break;
+	}
+
+	if (data_structure != NULL) {
+		/* Set the weight directly, since any warnings about it were emitted when the data structure was first parsed. */
+		data_structure->priv->weight = weight;
+		data_structure->priv->type_annotation = g_strdup (type_annotation);
+		data_structure->priv->nickname = g_strdup (nickname);
+	}
+
+	return data_structure;
+}
+
 /**
  * dfsm_ast_data_structure_calculate_type:
  * @self: a #DfsmAstDataStructure
@@ -1041,34 +1273,38 @@ dfsm_ast_data_structure_calculate_type (DfsmAstDataStructure *self, DfsmEnvironm
 	return retval;
 }
 
-/* NOTE: Not thread safe. */
-static gboolean enable_fuzzing = TRUE;
-
-/**
- * dfsm_ast_data_structure_set_fuzzing_enabled:
- * @enable: %TRUE to enable fuzzing, %FALSE to disable it
- *
- * Set whether fuzzing should be performed on any AST data structures. If this is set to %TRUE, fuzzing will be performed on all data structures with
- * a positive weight. If this is set to %FALSE, fuzzing will be performed on no data structures, and they will all just take their default value.
- */
-void
-dfsm_ast_data_structure_set_fuzzing_enabled (gboolean enable)
+/* Like dfsm_ast_data_structure_calculate_type(), but returns the cached type rather than a copy of it. This is used when evaluating data structures,
+ * which happens far more often than type checking, so it's worth avoiding the allocation. */
+static const GVariantType *
+peek_type (DfsmAstDataStructure *self, DfsmEnvironment *environment)
 {
-	enable_fuzzing = enable;
+	if (self->priv->variant_type == NULL) {
+		GVariantType *variant_type;
+
+		/* This caches the type in self->priv->variant_type. */
+		variant_type = _calculate_type (self, environment, NULL);
+		g_assert (variant_type != NULL);
+		g_variant_type_free (variant_type);
+	}
+
+	return self->priv->variant_type;
 }
 
+/* Fuzzing's only performed if it's enabled in @environment. @force_fuzzing treats the structure as if it had a positive weight, without modifying it
+ * (since the AST may be shared between threads). */
 static gboolean
-should_be_fuzzed (DfsmAstDataStructure *self)
+should_be_fuzzed (DfsmAstDataStructure *self, DfsmEnvironment *environment, gboolean force_fuzzing)
 {
-	return (enable_fuzzing == TRUE && self->priv->weight > 0.0) ? TRUE : FALSE;
+	return (dfsm_internal_environment_get_fuzzing_enabled (environment) == TRUE && (force_fuzzing == TRUE || self->priv->weight > 0.0)) ?
+	       TRUE : FALSE;
 }
 
 static gint64
-fuzz_signed_int (gint64 default_value, gint64 min_value, gint64 max_value)
+fuzz_signed_int (GRand *rand, gint64 default_value, gint64 min_value, gint64 max_value)
 {
 	g_assert (min_value <= default_value && default_value <= max_value);
 
-	DFSM_NONUNIFORM_DISTRIBUTION (4,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 4,
 		SMALL_RANGE, 0.3, /* a number in the range [-5, 5] */
 		DEFAULT, 0.3, /* keep our default value */
 		BOUNDARY, 0.1, /* a boundary number for the given range */
@@ -1076,13 +1312,13 @@ fuzz_signed_int (gint64 default_value, gint64 min_value, gint64 max_value)
 	)
 		case SMALL_RANGE:
 			/* Number in the range [-5, 5]. */
-			return g_random_int_range (-5, 6);
+			return g_rand_int_range (rand, -5, 6);
 		case DEFAULT:
 			/* Default value. */
 			return default_value;
 		case BOUNDARY:
 			/* Boundary number. */
-			if (g_random_boolean () == TRUE) {
+			if (g_rand_boolean (rand) == TRUE) {
 				/* Lower boundary. */
 				return min_value;
 			} else {
@@ -1090,28 +1326,28 @@ fuzz_signed_int (gint64 default_value, gint64 min_value, gint64 max_value)
 				return max_value;
 			}
 		case LARGE_RANGE:
-			/* Random int in the given range. If the range is large, we'll have to combine a g_random_int() call with a coin toss to
-			 * determine the sign, since g_random_int() only returns 32-bit integers. */
+			/* Random int in the given range. If the range is large, we'll have to combine a g_rand_int() call with a coin toss to
+			 * determine the sign, since g_rand_int() only returns 32-bit integers. */
 			if (min_value >= G_MININT32 && max_value <= G_MAXINT32) {
-				return g_random_int_range (min_value, max_value);
+				return g_rand_int_range (rand, min_value, max_value);
 			} else {
 				g_assert (min_value == G_MININT64 && max_value == G_MAXINT64);
 
-				if (g_random_boolean () == TRUE) {
-					return g_random_int ();
+				if (g_rand_boolean (rand) == TRUE) {
+					return g_rand_int (rand);
 				} else {
-					return (-1) - g_random_int (); /* shift it down by 1 so we don't cover 0 twice */
+					return (-1) - g_rand_int (rand); /* shift it down by 1 so we don't cover 0 twice */
 				}
 			}
 	DFSM_NONUNIFORM_DISTRIBUTION_END
 }
 
 static guint64
-fuzz_unsigned_int (guint64 default_value, guint64 min_value, guint64 max_value)
+fuzz_unsigned_int (GRand *rand, guint64 default_value, guint64 min_value, guint64 max_value)
 {
 	g_assert (min_value <= default_value && default_value <= max_value);
 
-	DFSM_NONUNIFORM_DISTRIBUTION (4,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 4,
 		SMALL_RANGE, 0.3, /* a number in the range [0, 10] */
 		DEFAULT, 0.3, /* keep our default value */
 		BOUNDARY, 0.1, /* a boundary number for the given range */
@@ -1119,13 +1355,13 @@ fuzz_unsigned_int (guint64 default_value, guint64 min_value, guint64 max_value)
 	)
 		case SMALL_RANGE:
 			/* Number in the range [0, 10]. */
-			return g_random_int_range (0, 11);
+			return g_rand_int_range (rand, 0, 11);
 		case DEFAULT:
 			/* Default value. */
 			return default_value;
 		case BOUNDARY:
 			/* Boundary number. */
-			if (g_random_boolean () == TRUE) {
+			if (g_rand_boolean (rand) == TRUE) {
 				/* Lower boundary. */
 				return min_value;
 			} else {
@@ -1133,24 +1369,24 @@ fuzz_unsigned_int (guint64 default_value, guint64 min_value, guint64 max_value)
 				return max_value;
 			}
 		case LARGE_RANGE:
-			/* Random int in the given range. If the range is large, we'll have to combine two g_random_int() calls to get a 64-bit integer,
-			 * since g_random_int() only returns 32-bit integers. */
+			/* Random int in the given range. If the range is large, we'll have to combine two g_rand_int() calls to get a 64-bit integer,
+			 * since g_rand_int() only returns 32-bit integers. */
 			if (/*min_value >= 0 && */ max_value <= G_MAXINT32) {
-				return g_random_int_range (min_value, max_value);
+				return g_rand_int_range (rand, min_value, max_value);
 			} else if (/*min_value >= 0 && */ max_value <= G_MAXUINT32) {
 				g_assert (min_value == 0 && max_value == G_MAXUINT32);
 
-				return g_random_int ();
+				return g_rand_int (rand);
 			} else {
 				g_assert (min_value == 0 && max_value == G_MAXUINT64);
 
-				return (((guint64) g_random_int () << 32) | (guint64) g_random_int ());
+				return (((guint64) g_rand_int (rand) << 32) | (guint64) g_rand_int (rand));
 			}
 	DFSM_NONUNIFORM_DISTRIBUTION_END
 }
 
 static void
-find_random_block_with_separator (const gchar *input, gsize input_length /* bytes */, const gchar separator, const gchar **block_start,
+find_random_block_with_separator (GRand *rand, const gchar *input, gsize input_length /* bytes */, const gchar separator, const gchar **block_start,
                                   const gchar **block_end)
 {
 	guint num_separators = 0;
@@ -1170,8 +1406,8 @@ find_random_block_with_separator (const gchar *input, gsize input_length /* byte
 
 	/* Randomly choose two separator instances to be the start and end of the block. We also consider the start and end of the string as
 	 * separators: this allows us to handle the situation of a single separator in the string. */
-	start_separator = g_random_int_range (0, num_separators + 1);
-	end_separator = (num_separators > 0) ? g_random_int_range (0, num_separators) : 0; /* sampling without replacement */
+	start_separator = g_rand_int_range (rand, 0, num_separators + 1);
+	end_separator = (num_separators > 0) ? g_rand_int_range (rand, 0, num_separators) : 0; /* sampling without replacement */
 
 	if (start_separator > end_separator) {
 		gint temp = start_separator;
@@ -1207,7 +1443,7 @@ find_random_block_with_separator (const gchar *input, gsize input_length /* byte
 static const gchar random_block_separators[] = { '/', '.', ':', ',', ';', '=', '\n' };
 
 static gsize
-find_random_block (const gchar *input, gsize input_length /* bytes */, const gchar **block_start_out, const gchar **block_end_out)
+find_random_block (GRand *rand, const gchar *input, gsize input_length /* bytes */, const gchar **block_start_out, const gchar **block_end_out)
 {
 	gboolean has_separator[G_N_ELEMENTS (random_block_separators)] = { FALSE, };
 	guint j, num_separators_found = 0 /* number of _distinct_ separators found */, distribution;
@@ -1242,9 +1478,9 @@ find_random_block (const gchar *input, gsize input_length /* bytes */, const gch
 		g_assert (input_length_unicode > 0);
 
 		/* Give up on interesting separators and just choose a block of characters at random. */
-		start_offset = g_random_int_range (0, input_length_unicode);
+		start_offset = g_rand_int_range (rand, 0, input_length_unicode);
 		block_start = g_utf8_offset_to_pointer (input, start_offset);
-		block_end = g_utf8_offset_to_pointer (block_start, g_random_int_range (0, input_length_unicode - start_offset + 1));
+		block_end = g_utf8_offset_to_pointer (block_start, g_rand_int_range (rand, 0, input_length_unicode - start_offset + 1));
 
 		goto done;
 	}
@@ -1252,13 +1488,13 @@ find_random_block (const gchar *input, gsize input_length /* bytes */, const gch
 	/* Since we know that there's at least one instance of at least one of the separator characters in the input, randomly choose a separator
 	 * character and find a block delimited by it. We do this by examining which separators were found, skipping over separators which weren't
 	 * found, and choosing the first separator whose probability interval the distribution random variable falls into. */
-	distribution = g_random_int ();
+	distribution = g_rand_int (rand);
 
 	for (j = 0; j < G_N_ELEMENTS (has_separator); j++) {
 		if (has_separator[j] == TRUE) {
 			if (distribution < G_MAXUINT32 / num_separators_found) {
 				/* RV falls into this separator's probability interval. We're done. */
-				find_random_block_with_separator (input, input_length, random_block_separators[j], &block_start, &block_end);
+				find_random_block_with_separator (rand, input, input_length, random_block_separators[j], &block_start, &block_end);
 				goto done;
 			}
 
@@ -1282,7 +1518,7 @@ done:
 }
 
 static void
-generate_whitespace (gchar *buffer, gsize whitespace_length)
+generate_whitespace (GRand *rand, gchar *buffer, gsize whitespace_length)
 {
 	const gchar whitespace_chars[] = {
 		' ',
@@ -1296,23 +1532,23 @@ generate_whitespace (gchar *buffer, gsize whitespace_length)
 	while (whitespace_length-- > 0) {
 		/* NOTE: This could be sped up if necessary by generating a full 32 bits of randomness then splitting it, bitwise, into ~10 groups of
 		 * three bits, which could each be used to index whitespace_chars. */
-		buffer[whitespace_length] = whitespace_chars[g_random_int_range (0, G_N_ELEMENTS (whitespace_chars))];
+		buffer[whitespace_length] = whitespace_chars[g_rand_int_range (rand, 0, G_N_ELEMENTS (whitespace_chars))];
 	}
 }
 
 static gunichar
-generate_character (void)
+generate_character (GRand *rand)
 {
 	gunichar output;
 
-	DFSM_NONUNIFORM_DISTRIBUTION (3,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 3,
 		ASCII, 0.5, /* any ASCII character (except NUL) */
 		VALID_UNICODE, 0.4, /* any other valid Unicode character (except NUL) */
 		INVALID_UNICODE, 0.1 /* any invalid Unicode character (such as the replacement character) */
 	)
 		case ASCII:
 			/* ASCII. */
-			output = g_random_int_range (0x01, 0xFF + 1); /* anything except NUL */
+			output = g_rand_int_range (rand, 0x01, 0xFF + 1); /* anything except NUL */
 
 			break;
 		case VALID_UNICODE:
@@ -1320,7 +1556,7 @@ generate_character (void)
 			 * probability of being chosen. Consequently, we just choose a random code point from planes 0, 1 and 2, and check whether it's
 			 * assigned and valid. If not, we choose another. Note that we never choose NUL. */
 			do {
-				output = g_random_int_range (0x01, 0x2FFFF + 1);
+				output = g_rand_int_range (rand, 0x01, 0x2FFFF + 1);
 			} while (g_unichar_isdefined (output) == FALSE || g_unichar_validate (output) == FALSE);
 
 			break;
@@ -1341,7 +1577,7 @@ generate_character (void)
 			 * This gives 137469 points in total.
 			 */
 
-			i = g_random_int_range (0, 137469);
+			i = g_rand_int_range (rand, 0, 137469);
 
 			if (i < 6400) {
 				/* Private Use Area */
@@ -1377,8 +1613,9 @@ generate_character (void)
 	return output;
 }
 
+/* The fuzzed string is allocated from @arena, so must be copied (e.g. by g_variant_new_string()) if it's to outlive the current dispatch. */
 static gchar *
-fuzz_string (const gchar *default_value)
+fuzz_string (GRand *rand, DfsmArena *arena, const gchar *default_value)
 {
 	gchar *fuzzy_string = NULL;
 	gsize default_value_length, fuzzy_string_length = 0; /* both in bytes */
@@ -1394,18 +1631,18 @@ fuzz_string (const gchar *default_value)
 	 */
 
 	if (default_value_length == 0) {
-		if (DFSM_BIASED_COIN_FLIP (0.4)) {
+		if (DFSM_BIASED_COIN_FLIP (rand, 0.4)) {
 			/* Generate a string between 1 and 256 characters (not bytes) long (inclusive). */
 			guint32 i;
 			gchar *j;
 
-			i = g_random_int_range (1, 257);
-			fuzzy_string = g_malloc (i * 6 /* max. byte length of a UTF-8 character */ + 1 /* nul terminator */);
+			i = g_rand_int_range (rand, 1, 257);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, i * 6 /* max. byte length of a UTF-8 character */ + 1 /* nul terminator */);
 
 			for (j = fuzzy_string; i > 0; i--) {
 				/* Generate a character. To be more efficient, we should really be generating larger chunks at a time than this.
 				 * Oh well. */
-				j += g_unichar_to_utf8 (generate_character (), j);
+				j += g_unichar_to_utf8 (generate_character (rand), j);
 			}
 
 			/* Nul terminator */
@@ -1419,7 +1656,7 @@ fuzz_string (const gchar *default_value)
 
 	g_assert (default_value_length > 0);
 
-	DFSM_NONUNIFORM_DISTRIBUTION (7,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 7,
 		CASE_CHANGE, 0.1, /* change the case of some letters */
 		REPLACE_LETTERS, 0.2, /* replace some letters with random replacements */
 		DELETE_BLOCK, 0.1, /* delete a random block of text */
@@ -1434,10 +1671,10 @@ fuzz_string (const gchar *default_value)
 
 			/* Case changing. Note that the probability of changing any given character position is ill-defined because it's dependent on
 			 * the indices of the previously flipped characters, and also whether the character in question is ASCII. */
-			fuzzy_string = g_strdup (default_value);
+			fuzzy_string = dfsm_internal_arena_strndup (arena, default_value, default_value_length);
 			fuzzy_string_length = default_value_length;
 
-			i = g_random_int_range (0, fuzzy_string_length + 1);
+			i = g_rand_int_range (rand, 0, fuzzy_string_length + 1);
 
 			while (i < fuzzy_string_length) {
 				if (g_ascii_isupper (fuzzy_string[i]) == TRUE) {
@@ -1446,7 +1683,7 @@ fuzz_string (const gchar *default_value)
 					fuzzy_string[i] = g_ascii_toupper (fuzzy_string[i]);
 				}
 
-				i += g_random_int_range (i + 1, fuzzy_string_length + 1);
+				i += g_rand_int_range (rand, i + 1, fuzzy_string_length + 1);
 			}
 
 			break;
@@ -1460,11 +1697,11 @@ fuzz_string (const gchar *default_value)
 			 * it's dependent on the indices of the previously replaced characters. Note that we have to perform this operation in terms
 			 * of Unicode characters, rather than bytes. */
 			default_value_length_unicode = g_utf8_strlen (default_value, -1);
-			fuzzy_string = g_malloc (default_value_length_unicode * 6 /* max. byte length of a UTF-8 character */ + 1);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, default_value_length_unicode * 6 /* max. byte length of a UTF-8 character */ + 1);
 			temp = fuzzy_string;
 
 			old_i = 0;
-			i = g_random_int_range (0, default_value_length_unicode + 1);
+			i = g_rand_int_range (rand, 0, default_value_length_unicode + 1);
 
 			while (i < default_value_length_unicode) {
 				/* Copy the chunk between the previously replaced character and the next character to replace
@@ -1478,12 +1715,12 @@ fuzz_string (const gchar *default_value)
 				}
 
 				/* Replace character i. */
-				temp += g_unichar_to_utf8 (generate_character (), temp);
+				temp += g_unichar_to_utf8 (generate_character (rand), temp);
 				default_value = g_utf8_next_char (default_value);
 
 				/* Choose the next character to replace. */
 				old_i = i + 1;
-				i = g_random_int_range (old_i, default_value_length_unicode + 1);
+				i = g_rand_int_range (rand, old_i, default_value_length_unicode + 1);
 			}
 
 			/* Copy the final chunk. */
@@ -1506,10 +1743,10 @@ fuzz_string (const gchar *default_value)
 			gsize block_length;
 
 			/* Block deletion. Find a random block and build a new string which doesn't include it. */
-			block_length = find_random_block (default_value, default_value_length, &block_start, &block_end);
+			block_length = find_random_block (rand, default_value, default_value_length, &block_start, &block_end);
 
 			fuzzy_string_length = default_value_length - block_length;
-			fuzzy_string = g_malloc (fuzzy_string_length + 1);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, fuzzy_string_length + 1);
 
 			strncpy (fuzzy_string, default_value, block_start - default_value);
 			strncpy (fuzzy_string + (block_start - default_value), block_end, default_value + default_value_length - block_end);
@@ -1521,10 +1758,10 @@ fuzz_string (const gchar *default_value)
 			gchar *block_start, *block_end, *i;
 
 			/* Block overwriting. Find a random block and build a new string which replaces it with the same number of bytes. */
-			fuzzy_string = g_strdup (default_value);
+			fuzzy_string = dfsm_internal_arena_strndup (arena, default_value, default_value_length);
 			fuzzy_string_length = default_value_length;
 
-			find_random_block (fuzzy_string, fuzzy_string_length, (const gchar**) &block_start, (const gchar**) &block_end);
+			find_random_block (rand, fuzzy_string, fuzzy_string_length, (const gchar**) &block_start, (const gchar**) &block_end);
 
 			for (i = block_start; i + 8 <= block_end;) {
 				*(i++) = 'd';
@@ -1566,10 +1803,10 @@ fuzz_string (const gchar *default_value)
 			gsize block_length;
 
 			/* Block cloning. Find a random block and clone it in the same position. */
-			block_length = find_random_block (default_value, default_value_length, &block_start, &block_end);
+			block_length = find_random_block (rand, default_value, default_value_length, &block_start, &block_end);
 
 			fuzzy_string_length = default_value_length + block_length;
-			fuzzy_string = g_malloc (fuzzy_string_length + 1);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, fuzzy_string_length + 1);
 
 			strncpy (fuzzy_string, default_value, block_end - default_value);
 			strncpy (fuzzy_string + (block_end - default_value), block_start, block_length);
@@ -1586,13 +1823,13 @@ fuzz_string (const gchar *default_value)
 
 			/* Block swapping. Find two random blocks and swap them. We have to be careful to make sure they don't overlap, so we take the
 			 * second block from the larger of the remaining portions after choosing the first block. */
-			block1_length = find_random_block (default_value, default_value_length, &block1_start, &block1_end);
+			block1_length = find_random_block (rand, default_value, default_value_length, &block1_start, &block1_end);
 
 			if (block1_start - default_value > default_value + default_value_length - block1_end) {
 				const gchar *temp_start, *temp_end;
 				gsize temp_length;
 
-				temp_length = find_random_block (default_value, block1_start - default_value, &temp_start, &temp_end);
+				temp_length = find_random_block (rand, default_value, block1_start - default_value, &temp_start, &temp_end);
 
 				/* Ensure block1 is always < block2. */
 				block2_start = block1_start;
@@ -1602,13 +1839,13 @@ fuzz_string (const gchar *default_value)
 				block1_end = temp_end;
 				block1_length = temp_length;
 			} else {
-				block2_length = find_random_block (block1_end, default_value + default_value_length - block1_end,
+				block2_length = find_random_block (rand, block1_end, default_value + default_value_length - block1_end,
 				                                   &block2_start, &block2_end);
 			}
 
 			/* Build the output string. */
 			fuzzy_string_length = default_value_length;
-			fuzzy_string = g_malloc (fuzzy_string_length + 1);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, fuzzy_string_length + 1);
 			i = fuzzy_string;
 
 			strncpy (i, default_value, block1_start - default_value);
@@ -1634,11 +1871,11 @@ fuzz_string (const gchar *default_value)
 			 * block separators only. The separators are only ever 1 byte long, so we can allocate a fuzzy string of the same length as
 			 * the original. */
 			default_value_length_unicode = g_utf8_strlen (default_value, -1);
-			fuzzy_string = g_malloc (default_value_length + 1);
+			fuzzy_string = dfsm_internal_arena_alloc (arena, default_value_length + 1);
 			temp = fuzzy_string;
 
 			old_i = 0;
-			i = g_random_int_range (0, default_value_length_unicode + 1);
+			i = g_rand_int_range (rand, 0, default_value_length_unicode + 1);
 
 			while (i < default_value_length_unicode) {
 				guint sep;
@@ -1654,13 +1891,13 @@ fuzz_string (const gchar *default_value)
 				}
 
 				/* Replace character i. */
-				sep = g_random_int_range (0, G_N_ELEMENTS (random_block_separators));
+				sep = g_rand_int_range (rand, 0, G_N_ELEMENTS (random_block_separators));
 				*(temp++) = random_block_separators[sep];
 				default_value = g_utf8_next_char (default_value);
 
 				/* Choose the next character to replace. */
 				old_i = i + 1;
-				i = g_random_int_range (old_i, default_value_length_unicode + 1);
+				i = g_rand_int_range (rand, old_i, default_value_length_unicode + 1);
 			}
 
 			/* Copy the final chunk. */
@@ -1682,42 +1919,41 @@ fuzz_string (const gchar *default_value)
 
 whitespace:
 	/* Whitespace addition. */
-	if (DFSM_BIASED_COIN_FLIP (0.2)) {
+	if (DFSM_BIASED_COIN_FLIP (rand, 0.2)) {
 		gchar *temp;
 		gsize prefix_length = 0, suffix_length = 0;
 
-		if (g_random_boolean () == TRUE) {
+		if (g_rand_boolean (rand) == TRUE) {
 			/* Add whitespace as a prefix. */
-			prefix_length = g_random_int_range (1, 6);
+			prefix_length = g_rand_int_range (rand, 1, 6);
 		}
 
-		if (g_random_boolean () == TRUE) {
+		if (g_rand_boolean (rand) == TRUE) {
 			/* Independently add whitespace to the end of the fuzzy string. */
-			suffix_length = g_random_int_range (1, 6);
+			suffix_length = g_rand_int_range (rand, 1, 6);
 		}
 
 		/* Move the fuzzy string to a larger chunk of memory with space for the whitespace. */
-		temp = g_malloc (prefix_length + fuzzy_string_length + suffix_length + 1);
+		temp = dfsm_internal_arena_alloc (arena, prefix_length + fuzzy_string_length + suffix_length + 1);
 		strncpy (temp + prefix_length, fuzzy_string, fuzzy_string_length);
 		temp[prefix_length + fuzzy_string_length + suffix_length] = '\0';
 
 		/* Generate some whitespace to fill the gaps. */
 		if (prefix_length > 0) {
-			generate_whitespace (temp + 0, prefix_length);
+			generate_whitespace (rand, temp + 0, prefix_length);
 		}
 
 		if (suffix_length > 0) {
-			generate_whitespace (temp + prefix_length + fuzzy_string_length, suffix_length);
+			generate_whitespace (rand, temp + prefix_length + fuzzy_string_length, suffix_length);
 		}
 
-		/* Store the new string. */
-		g_free (fuzzy_string);
+		/* Store the new string. The old one stays in the arena until it's next reset. */
 		fuzzy_string = temp;
 		fuzzy_string_length += prefix_length + suffix_length;
 	}
 
 	if (fuzzy_string == NULL) {
-		fuzzy_string = g_strdup (default_value);
+		fuzzy_string = dfsm_internal_arena_strndup (arena, default_value, default_value_length);
 		fuzzy_string_length = default_value_length;
 	}
 
@@ -1728,21 +1964,27 @@ whitespace:
 	return fuzzy_string;
 }
 
+/* As with fuzz_string(), the fuzzed object path is allocated from @arena. */
 static gchar *
-fuzz_object_path (const gchar *default_value)
+fuzz_object_path (GRand *rand, DfsmArena *arena, const gchar *default_value)
 {
 	gchar *output;
 
-	DFSM_NONUNIFORM_DISTRIBUTION (2,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 2,
 		DEFAULT, 0.7, /* default value */
 		APPENDED, 0.3 /* append a digit to the path */
 	)
 		case DEFAULT:
-			output = g_strdup (default_value);
+			output = dfsm_internal_arena_strdup (arena, default_value);
 			break;
-		case APPENDED:
-			output = g_strdup_printf ("%s%u", default_value, g_random_int_range (0, 100));
+		case APPENDED: {
+			gsize default_value_length = strlen (default_value);
+
+			output = dfsm_internal_arena_alloc (arena, default_value_length + 3 /* up to two digits */ + 1);
+			memcpy (output, default_value, default_value_length);
+			g_snprintf (output + default_value_length, 3 + 1, "%u", g_rand_int_range (rand, 0, 100));
 			break;
+		}
 	DFSM_NONUNIFORM_DISTRIBUTION_END
 
 	/* Sanity check. */
@@ -1752,12 +1994,12 @@ fuzz_object_path (const gchar *default_value)
 }
 
 static GVariantType *
-generate_basic_type_signature (void)
+generate_basic_type_signature (GRand *rand)
 {
 	GVariantType *type_signature;
 
 	/* Generate a basic type signature. */
-	DFSM_NONUNIFORM_DISTRIBUTION (12,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 12,
 		BOOLEAN, 0.05,
 		BYTE, 0.05,
 		INT16, 0.1,
@@ -1794,12 +2036,12 @@ generate_basic_type_signature (void)
 }
 
 static GVariantType *
-generate_type_signature (void)
+generate_type_signature (GRand *rand)
 {
 	GVariantType *type_signature;
 
 	/* Recursively generate a type signature. */
-	DFSM_NONUNIFORM_DISTRIBUTION (5,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 5,
 		BASIC, 0.6,
 		VARIANT, 0.1,
 		ARRAY, 0.1,
@@ -1807,13 +2049,13 @@ generate_type_signature (void)
 		DICTIONARY, 0.1
 	)
 		case BASIC:
-			type_signature = generate_basic_type_signature ();
+			type_signature = generate_basic_type_signature (rand);
 			break;
 		case VARIANT:
 			type_signature = g_variant_type_copy (G_VARIANT_TYPE_VARIANT);
 			break;
 		case ARRAY: {
-			GVariantType *element_type = generate_type_signature ();
+			GVariantType *element_type = generate_type_signature (rand);
 			type_signature = g_variant_type_new_array (element_type);
 			g_variant_type_free (element_type);
 
@@ -1823,12 +2065,12 @@ generate_type_signature (void)
 			guint i;
 			GPtrArray/*<GVariantType>*/ *element_types;
 
-			i = g_random_int_range (0, 6);
+			i = g_rand_int_range (rand, 0, 6);
 			element_types = g_ptr_array_sized_new (i);
 			g_ptr_array_set_free_func (element_types, (GDestroyNotify) g_variant_type_free);
 
 			while (i-- > 0) {
-				g_ptr_array_add (element_types, generate_type_signature ());
+				g_ptr_array_add (element_types, generate_type_signature (rand));
 			}
 
 			type_signature = g_variant_type_new_tuple ((const GVariantType* const*) element_types->pdata, element_types->len);
@@ -1840,8 +2082,8 @@ generate_type_signature (void)
 		case DICTIONARY: {
 			GVariantType *key_type, *value_type, *entry_type;
 
-			key_type = generate_basic_type_signature ();
-			value_type = generate_type_signature ();
+			key_type = generate_basic_type_signature (rand);
+			value_type = generate_type_signature (rand);
 			entry_type = g_variant_type_new_dict_entry (key_type, value_type);
 
 			type_signature = g_variant_type_new_array (entry_type);
@@ -1857,24 +2099,26 @@ generate_type_signature (void)
 	return type_signature;
 }
 
+/* As with fuzz_string(), the fuzzed type signature is allocated from @arena. */
 static gchar *
-fuzz_type_signature (const gchar *default_value)
+fuzz_type_signature (GRand *rand, DfsmArena *arena, const gchar *default_value)
 {
 	gchar *output;
 
-	DFSM_NONUNIFORM_DISTRIBUTION (2,
+	DFSM_NONUNIFORM_DISTRIBUTION (rand, 2,
 		DEFAULT, 0.6, /* default value */
 		GENERATED, 0.4 /* a randomly generated type signature */
 	)
 		case DEFAULT:
 			/* Default value. */
-			output = g_strdup (default_value);
+			output = dfsm_internal_arena_strdup (arena, default_value);
 
 			break;
 		case GENERATED: {
 			/* Generated type signature. */
-			GVariantType *type_signature = generate_type_signature ();
-			output = g_variant_type_dup_string (type_signature);
+			GVariantType *type_signature = generate_type_signature (rand);
+			output = dfsm_internal_arena_strndup (arena, g_variant_type_peek_string (type_signature),
+			                                      g_variant_type_get_string_length (type_signature));
 			g_variant_type_free (type_signature);
 
 			break;
@@ -1887,22 +2131,13 @@ fuzz_type_signature (const gchar *default_value)
 	return output;
 }
 
-/* Evaluate a data structure, ensuring that it's fuzzed in the process. A bit hacky. */
+static GVariant *data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment *environment, gboolean force_fuzzing);
+
+/* Evaluate a data structure, ensuring that it's fuzzed in the process (if fuzzing is enabled at all), even if its weight is zero. */
 static GVariant *
 fuzz_data_structure (DfsmAstDataStructure *data_structure, DfsmEnvironment *environment)
 {
-	gdouble old_weight;
-	GVariant *variant;
-
-	/* Temporarily set the child data structure's fuzzing weight to 1.0 (if it's not already) to ensure that evaluating it again will mutate it. */
-	old_weight = data_structure->priv->weight;
-	data_structure->priv->weight = MAX (1.0, old_weight);
-
-	variant = dfsm_ast_data_structure_to_variant (data_structure, environment);
-
-	data_structure->priv->weight = old_weight;
-
-	return variant;
+	return data_structure_to_variant (data_structure, environment, TRUE);
 }
 
 /**
@@ -1920,12 +2155,17 @@ fuzz_data_structure (DfsmAstDataStructure *data_structure, DfsmEnvironment *envi
 GVariant *
 dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment *environment)
 {
-	DfsmAstDataStructurePrivate *priv;
-
 	g_return_val_if_fail (DFSM_IS_AST_DATA_STRUCTURE (self), NULL);
 	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (environment), NULL);
 
-	priv = self->priv;
+	return data_structure_to_variant (self, environment, FALSE);
+}
+
+static GVariant *
+data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment *environment, gboolean force_fuzzing)
+{
+	DfsmAstDataStructurePrivate *priv = self->priv;
+	GRand *rand = dfsm_internal_environment_get_rand (environment);
 
 	/* NOTE: We have to sink all floating references from here to guarantee that we always return a value of the same floatiness. The alternative
 	 * is to always return a floating reference, but that would require modifying dfsm_ast_variable_to_variant() to somehow return a floating
@@ -1935,8 +2175,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_BYTE: {
 			guchar byte_val = priv->byte_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				byte_val = fuzz_unsigned_int (byte_val, 0, UCHAR_MAX);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				byte_val = fuzz_unsigned_int (rand, byte_val, 0, UCHAR_MAX);
 			}
 
 			return g_variant_ref_sink (g_variant_new_byte (byte_val));
@@ -1944,8 +2184,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_BOOLEAN: {
 			gboolean boolean_val = priv->boolean_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				DFSM_NONUNIFORM_DISTRIBUTION (2,
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				DFSM_NONUNIFORM_DISTRIBUTION (rand, 2,
 					DEFAULT, 0.6, /* keep the default value */
 					FLIP, 0.4 /* flip the default value */
 				)
@@ -1962,8 +2202,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_INT16: {
 			gint16 int16_val = priv->int16_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				int16_val = fuzz_signed_int (int16_val, G_MININT16, G_MAXINT16);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				int16_val = fuzz_signed_int (rand, int16_val, G_MININT16, G_MAXINT16);
 			}
 
 			return g_variant_ref_sink (g_variant_new_int16 (int16_val));
@@ -1971,8 +2211,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_UINT16: {
 			guint16 uint16_val = priv->uint16_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				uint16_val = fuzz_unsigned_int (uint16_val, 0, G_MAXUINT16);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				uint16_val = fuzz_unsigned_int (rand, uint16_val, 0, G_MAXUINT16);
 			}
 
 			return g_variant_ref_sink (g_variant_new_uint16 (uint16_val));
@@ -1980,8 +2220,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_INT32: {
 			gint32 int32_val = priv->int32_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				int32_val = fuzz_signed_int (int32_val, G_MININT32, G_MAXINT32);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				int32_val = fuzz_signed_int (rand, int32_val, G_MININT32, G_MAXINT32);
 			}
 
 			return g_variant_ref_sink (g_variant_new_int32 (int32_val));
@@ -1989,8 +2229,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_UINT32: {
 			guint32 uint32_val = priv->uint32_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				uint32_val = fuzz_unsigned_int (uint32_val, 0, G_MAXUINT32);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				uint32_val = fuzz_unsigned_int (rand, uint32_val, 0, G_MAXUINT32);
 			}
 
 			return g_variant_ref_sink (g_variant_new_uint32 (uint32_val));
@@ -1998,8 +2238,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_INT64: {
 			gint64 int64_val = priv->int64_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				int64_val = fuzz_signed_int (int64_val, G_MININT64, G_MAXINT64);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				int64_val = fuzz_signed_int (rand, int64_val, G_MININT64, G_MAXINT64);
 			}
 
 			return g_variant_ref_sink (g_variant_new_int64 (int64_val));
@@ -2007,8 +2247,8 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_UINT64: {
 			guint64 uint64_val = priv->uint64_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				uint64_val = fuzz_unsigned_int (uint64_val, 0, G_MAXUINT64);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				uint64_val = fuzz_unsigned_int (rand, uint64_val, 0, G_MAXUINT64);
 			}
 
 			return g_variant_ref_sink (g_variant_new_uint64 (uint64_val));
@@ -2016,15 +2256,15 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_DOUBLE: {
 			gdouble double_val = priv->double_val;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				DFSM_NONUNIFORM_DISTRIBUTION (3,
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				DFSM_NONUNIFORM_DISTRIBUTION (rand, 3,
 					SMALL_RANGE, 0.3, /* a number in the range [-5.0, 5.0) */
 					DEFAULT, 0.3, /* keep our default value */
 					LARGE_RANGE, 0.4 /* a random double in the given range */
 				)
 					case SMALL_RANGE:
 						/* Number in the range [-5.0, 5.0). */
-						double_val = g_random_double_range (-5.0, 5.0);
+						double_val = g_rand_double_range (rand, -5.0, 5.0);
 						break;
 					case DEFAULT:
 						/* Default value. */
@@ -2032,7 +2272,7 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 						break;
 					case LARGE_RANGE:
 						/* Random double in the maximum range. */
-						double_val = g_random_double_range (-G_MAXDOUBLE, G_MAXDOUBLE);
+						double_val = g_rand_double_range (rand, -G_MAXDOUBLE, G_MAXDOUBLE);
 						break;
 				DFSM_NONUNIFORM_DISTRIBUTION_END
 			}
@@ -2040,29 +2280,31 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			return g_variant_ref_sink (g_variant_new_double (double_val));
 		}
 		case DFSM_AST_DATA_STRING: {
-			GVariantType *data_structure_type;
+			const GVariantType *data_structure_type;
 			GVariant *variant;
-			gchar *fuzzed_val = priv->string_val;
+			DfsmArena *arena = dfsm_internal_environment_get_arena (environment);
+			const gchar *fuzzed_val = priv->string_val;
 
-			data_structure_type = dfsm_ast_data_structure_calculate_type (self, environment);
+			data_structure_type = peek_type (self, environment);
 
 			/* Slight irregularity: if we've calculated the data structure type to be an object path or D-Bus signature (i.e. because the
-			 * user added a type annotation), we need to create a GVariant of the appropriate type. */
+			 * user added a type annotation), we need to create a GVariant of the appropriate type. Fuzzed values are temporaries in the
+			 * environment's arena, and are copied into the variant. */
 			if (g_variant_type_equal (data_structure_type, G_VARIANT_TYPE_STRING) == TRUE) {
-				if (should_be_fuzzed (self) == TRUE) {
-					fuzzed_val = fuzz_string (priv->string_val);
+				if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+					fuzzed_val = fuzz_string (rand, arena, priv->string_val);
 				}
 
 				variant = g_variant_new_string (fuzzed_val);
 			} else if (g_variant_type_equal (data_structure_type, G_VARIANT_TYPE_OBJECT_PATH) == TRUE) {
-				if (should_be_fuzzed (self) == TRUE) {
-					fuzzed_val = fuzz_object_path (priv->string_val);
+				if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+					fuzzed_val = fuzz_object_path (rand, arena, priv->string_val);
 				}
 
 				variant = g_variant_new_object_path (fuzzed_val);
 			} else if (g_variant_type_equal (data_structure_type, G_VARIANT_TYPE_SIGNATURE) == TRUE) {
-				if (should_be_fuzzed (self) == TRUE) {
-					fuzzed_val = fuzz_type_signature (priv->string_val);
+				if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+					fuzzed_val = fuzz_type_signature (rand, arena, priv->string_val);
 				}
 
 				variant = g_variant_new_signature (fuzzed_val);
@@ -2070,21 +2312,14 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				g_assert_not_reached ();
 			}
 
-			if (should_be_fuzzed (self) == TRUE) {
-				g_free (fuzzed_val);
-			}
-
-			g_variant_type_free (data_structure_type);
-
 			return g_variant_ref_sink (variant);
 		}
 		case DFSM_AST_DATA_OBJECT_PATH: {
 			GVariant *variant;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				gchar *fuzzed_val = fuzz_object_path (priv->object_path_val);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				gchar *fuzzed_val = fuzz_object_path (rand, dfsm_internal_environment_get_arena (environment), priv->object_path_val);
 				variant = g_variant_new_object_path (fuzzed_val);
-				g_free (fuzzed_val);
 			} else {
 				variant = g_variant_new_object_path (priv->object_path_val);
 			}
@@ -2094,10 +2329,9 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 		case DFSM_AST_DATA_SIGNATURE: {
 			GVariant *variant;
 
-			if (should_be_fuzzed (self) == TRUE) {
-				gchar *fuzzed_val = fuzz_type_signature (priv->signature_val);
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE) {
+				gchar *fuzzed_val = fuzz_type_signature (rand, dfsm_internal_environment_get_arena (environment), priv->signature_val);
 				variant = g_variant_new_signature (fuzzed_val);
-				g_free (fuzzed_val);
 			} else {
 				variant = g_variant_new_signature (priv->signature_val);
 			}
@@ -2105,7 +2339,6 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			return g_variant_ref_sink (variant);
 		}
 		case DFSM_AST_DATA_ARRAY: {
-			GVariantType *data_structure_type;
 			GVariantBuilder builder;
 			guint i, effective_array_length;
 
@@ -2122,12 +2355,11 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			 * individual elements.
 			 */
 
-			data_structure_type = dfsm_ast_data_structure_calculate_type (self, environment);
-			g_variant_builder_init (&builder, data_structure_type);
-			g_variant_type_free (data_structure_type);
+			g_variant_builder_init (&builder, peek_type (self, environment));
 
 			/* Delete all entries? */
-			effective_array_length = (should_be_fuzzed (self) == FALSE || DFSM_BIASED_COIN_FLIP (0.95)) ? priv->array_val->len : 0;
+			effective_array_length = (should_be_fuzzed (self, environment, force_fuzzing) == FALSE || DFSM_BIASED_COIN_FLIP (rand, 0.95)) ?
+			                         priv->array_val->len : 0;
 
 			for (i = 0; i < effective_array_length; i++) {
 				GVariant *child_value;
@@ -2139,7 +2371,7 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				child_expression_weight = MAX (1.0, dfsm_ast_expression_calculate_weight (child_expression));
 
 				/* Delete this element? */
-				if (should_be_fuzzed (self) && DFSM_BIASED_COIN_FLIP (0.2 * child_expression_weight)) {
+				if (should_be_fuzzed (self, environment, force_fuzzing) && DFSM_BIASED_COIN_FLIP (rand, 0.2 * child_expression_weight)) {
 					continue;
 				}
 
@@ -2149,15 +2381,15 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				g_variant_builder_add_value (&builder, child_value);
 
 				/* Clone this element? */
-				if (should_be_fuzzed (self) && DFSM_BIASED_COIN_FLIP (0.2 * child_expression_weight)) {
+				if (should_be_fuzzed (self, environment, force_fuzzing) && DFSM_BIASED_COIN_FLIP (rand, 0.2 * child_expression_weight)) {
 					g_variant_builder_add_value (&builder, child_value);
 				}
 
 				g_variant_unref (child_value);
 
 				/* Clone and mutate the element?  We can only do this if the child expression is a data structure expression. */
-				if (should_be_fuzzed (self) && DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (child_expression) &&
-				    DFSM_BIASED_COIN_FLIP (0.4 * child_expression_weight)) {
+				if (should_be_fuzzed (self, environment, force_fuzzing) && DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (child_expression) &&
+				    DFSM_BIASED_COIN_FLIP (rand, 0.4 * child_expression_weight)) {
 					DfsmAstDataStructure *child_data_structure;
 
 					child_data_structure =
@@ -2174,15 +2406,12 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			return g_variant_ref_sink (g_variant_builder_end (&builder));
 		}
 		case DFSM_AST_DATA_STRUCT: {
-			GVariantType *data_structure_type;
 			GVariantBuilder builder;
 			guint i;
 
 			/* Note: Fuzzing structs doesn't make sense, so we ignore any fuzzing here. */
 
-			data_structure_type = dfsm_ast_data_structure_calculate_type (self, environment);
-			g_variant_builder_init (&builder, data_structure_type);
-			g_variant_type_free (data_structure_type);
+			g_variant_builder_init (&builder, peek_type (self, environment));
 
 			for (i = 0; i < priv->struct_val->len; i++) {
 				GVariant *child_value;
@@ -2217,12 +2446,14 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 
 			default_child_value = dfsm_ast_expression_evaluate (priv->variant_val, environment);
 
-			if (should_be_fuzzed (self) == TRUE && DFSM_BIASED_COIN_FLIP (0.2)) {
+			if (should_be_fuzzed (self, environment, force_fuzzing) == TRUE && DFSM_BIASED_COIN_FLIP (rand, 0.2)) {
 				/* Choose an arbitrary type and generate a value for it. See explanation above. */
 				if (g_variant_type_equal (g_variant_get_type (default_child_value), G_VARIANT_TYPE_UINT32) == TRUE) {
-					child_value = g_variant_ref_sink (g_variant_new_string (fuzz_string ("")));
+					DfsmArena *arena = dfsm_internal_environment_get_arena (environment);
+
+					child_value = g_variant_ref_sink (g_variant_new_string (fuzz_string (rand, arena, "")));
 				} else {
-					child_value = g_variant_ref_sink (g_variant_new_uint32 (fuzz_unsigned_int (0, 0, G_MAXUINT32)));
+					child_value = g_variant_ref_sink (g_variant_new_uint32 (fuzz_unsigned_int (rand, 0, 0, G_MAXUINT32)));
 				}
 			} else {
 				/* Leave the value unchanged. */
@@ -2237,7 +2468,7 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			return variant_value;
 		}
 		case DFSM_AST_DATA_DICT: {
-			GVariantType *data_structure_type;
+			const GVariantType *data_structure_type;
 			GVariantBuilder builder;
 			guint i, effective_dict_length;
 
@@ -2254,11 +2485,12 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 			 * individual elements.
 			 */
 
-			data_structure_type = dfsm_ast_data_structure_calculate_type (self, environment);
+			data_structure_type = peek_type (self, environment);
 			g_variant_builder_init (&builder, data_structure_type);
 
 			/* Delete all entries? */
-			effective_dict_length = (should_be_fuzzed (self) == FALSE || DFSM_BIASED_COIN_FLIP (0.95)) ? priv->dict_val->len : 0;
+			effective_dict_length = (should_be_fuzzed (self, environment, force_fuzzing) == FALSE || DFSM_BIASED_COIN_FLIP (rand, 0.95)) ?
+			                         priv->dict_val->len : 0;
 
 			for (i = 0; i < effective_dict_length; i++) {
 				GVariant *key_value, *value_value;
@@ -2273,7 +2505,7 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				value_weight = MAX (1.0, dfsm_ast_expression_calculate_weight (dict_entry->value));
 
 				/* Delete this entry? */
-				if (should_be_fuzzed (self) && DFSM_BIASED_COIN_FLIP (0.2 * key_weight)) {
+				if (should_be_fuzzed (self, environment, force_fuzzing) && DFSM_BIASED_COIN_FLIP (rand, 0.2 * key_weight)) {
 					continue;
 				}
 
@@ -2287,9 +2519,9 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				g_variant_builder_close (&builder);
 
 				/* Clone and mutate the entry?  We can only do this if the child expressions are data structure expressions. */
-				if (should_be_fuzzed (self) && DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (dict_entry->key) &&
+				if (should_be_fuzzed (self, environment, force_fuzzing) && DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (dict_entry->key) &&
 				    DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (dict_entry->value) &&
-				    DFSM_BIASED_COIN_FLIP (0.6 * key_weight)) {
+				    DFSM_BIASED_COIN_FLIP (rand, 0.6 * key_weight)) {
 					DfsmAstDataStructure *key_data_structure, *value_data_structure;
 
 					key_data_structure =
@@ -2302,7 +2534,7 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 					g_variant_unref (key_value);
 					key_value = fuzz_data_structure (key_data_structure, environment);
 
-					if (DFSM_BIASED_COIN_FLIP (0.5 * value_weight)) {
+					if (DFSM_BIASED_COIN_FLIP (rand, 0.5 * value_weight)) {
 						/* Mutate the value as well as the key. */
 						g_variant_unref (value_value);
 						value_value = fuzz_data_structure (value_data_structure, environment);
@@ -2319,7 +2551,6 @@ dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEnvironment
 				g_variant_unref (key_value);
 			}
 
-			g_variant_type_free (data_structure_type);
 
 			return g_variant_ref_sink (g_variant_builder_end (&builder));
 		}
@@ -2595,6 +2826,84 @@ dfsm_ast_data_structure_is_variable (DfsmAstDataStructure *self)
 	}
 }
 
+/**
+ * dfsm_ast_data_structure_is_constant:
+ * @self: a #DfsmAstDataStructure
+ *
+ * Check whether the given #DfsmAstDataStructure always evaluates to the same value: that is, it doesn't refer to any variables, and neither it nor
+ * any of its children can be fuzzed (they all have a zero fuzzing weight). See dfsm_ast_expression_is_constant().
+ *
+ * Return value: %TRUE if the data structure is constant, %FALSE otherwise
+ */
+gboolean
+dfsm_ast_data_structure_is_constant (DfsmAstDataStructure *self)
+{
+	DfsmAstDataStructurePrivate *priv;
+
+	g_return_val_if_fail (DFSM_IS_AST_DATA_STRUCTURE (self), FALSE);
+
+	priv = self->priv;
+
+	/* Anything which can be fuzzed may evaluate differently each time. */
+	if (priv->weight > 0.0) {
+		return FALSE;
+	}
+
+	switch (priv->data_structure_type) {
+		case DFSM_AST_DATA_ARRAY:
+		case DFSM_AST_DATA_STRUCT: {
+			GPtrArray/*<DfsmAstExpression>*/ *children;
+			guint i;
+
+			children = (priv->data_structure_type == DFSM_AST_DATA_ARRAY) ? priv->array_val : priv->struct_val;
+
+			for (i = 0; i < children->len; i++) {
+				if (dfsm_ast_expression_is_constant (DFSM_AST_EXPRESSION (g_ptr_array_index (children, i))) == FALSE) {
+					return FALSE;
+				}
+			}
+
+			return TRUE;
+		}
+		case DFSM_AST_DATA_DICT: {
+			guint i;
+
+			for (i = 0; i < priv->dict_val->len; i++) {
+				DfsmAstDictionaryEntry *child_entry = (DfsmAstDictionaryEntry*) g_ptr_array_index (priv->dict_val, i);
+
+				if (dfsm_ast_expression_is_constant (child_entry->key) == FALSE ||
+				    dfsm_ast_expression_is_constant (child_entry->value) == FALSE) {
+					return FALSE;
+				}
+			}
+
+			return TRUE;
+		}
+		case DFSM_AST_DATA_VARIANT:
+			return dfsm_ast_expression_is_constant (priv->variant_val);
+		case DFSM_AST_DATA_BYTE:
+		case DFSM_AST_DATA_BOOLEAN:
+		case DFSM_AST_DATA_INT16:
+		case DFSM_AST_DATA_UINT16:
+		case DFSM_AST_DATA_INT32:
+		case DFSM_AST_DATA_UINT32:
+		case DFSM_AST_DATA_INT64:
+		case DFSM_AST_DATA_UINT64:
+		case DFSM_AST_DATA_DOUBLE:
+		case DFSM_AST_DATA_STRING:
+		case DFSM_AST_DATA_OBJECT_PATH:
+		case DFSM_AST_DATA_SIGNATURE:
+			/* True base cases. */
+			return TRUE;
+		case DFSM_AST_DATA_VARIABLE:
+		case DFSM_AST_DATA_UNIX_FD:
+			/* False base cases. */
+			return FALSE;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
 /**
  * dfsm_ast_dictionary_entry_new:
  * @key: expression giving entry's key
@@ -2636,3 +2945,23 @@ dfsm_ast_dictionary_entry_free (DfsmAstDictionaryEntry *entry)
 		g_slice_free (DfsmAstDictionaryEntry, entry);
 	}
 }
+
+/*
+ * dfsm_ast_data_structure_get_variable:
+ * @self: a #DfsmAstDataStructure
+ *
+ * If the data structure is a direct reference to a variable (such as ‘object->foo’), rather than a literal value or a container, get the variable.
+ *
+ * Return value: (transfer none) (allow-none): the variable referenced by the data structure, or %NULL
+ */
+DfsmAstVariable *
+dfsm_ast_data_structure_get_variable (DfsmAstDataStructure *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_DATA_STRUCTURE (self), NULL);
+
+	if (self->priv->data_structure_type != DFSM_AST_DATA_VARIABLE) {
+		return NULL;
+	}
+
+	return self->priv->variable_val;
+}
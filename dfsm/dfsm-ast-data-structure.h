@@ -84,6 +84,7 @@ GVariant *dfsm_ast_data_structure_to_variant (DfsmAstDataStructure *self, DfsmEn
 void dfsm_ast_data_structure_set_from_variant (DfsmAstDataStructure *self, DfsmEnvironment *environment, GVariant *new_value);
 
 gboolean dfsm_ast_data_structure_is_variable (DfsmAstDataStructure *self);
+gboolean dfsm_ast_data_structure_is_constant (DfsmAstDataStructure *self);
 
 G_END_DECLS
 
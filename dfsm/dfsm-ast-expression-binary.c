@@ -42,6 +42,7 @@ static void dfsm_ast_expression_binary_check (DfsmAstNode *node, DfsmEnvironment
 static GVariantType *dfsm_ast_expression_binary_calculate_type (DfsmAstExpression *self, DfsmEnvironment *environment);
 static GVariant *dfsm_ast_expression_binary_evaluate (DfsmAstExpression *self, DfsmEnvironment *environment);
 static gdouble dfsm_ast_expression_binary_calculate_weight (DfsmAstExpression *self);
+static gboolean dfsm_ast_expression_binary_is_constant (DfsmAstExpression *self);
 
 struct _DfsmAstExpressionBinaryPrivate {
 	DfsmAstExpressionBinaryType expression_type;
@@ -69,6 +70,7 @@ dfsm_ast_expression_binary_class_init (DfsmAstExpressionBinaryClass *klass)
 	expression_class->calculate_type = dfsm_ast_expression_binary_calculate_type;
 	expression_class->evaluate = dfsm_ast_expression_binary_evaluate;
 	expression_class->calculate_weight = dfsm_ast_expression_binary_calculate_weight;
+	expression_class->is_constant = dfsm_ast_expression_binary_is_constant;
 }
 
 static void
@@ -404,6 +406,15 @@ dfsm_ast_expression_binary_calculate_weight (DfsmAstExpression *self)
 	return MAX (dfsm_ast_expression_calculate_weight (priv->left_node), dfsm_ast_expression_calculate_weight (priv->right_node));
 }
 
+static gboolean
+dfsm_ast_expression_binary_is_constant (DfsmAstExpression *self)
+{
+	DfsmAstExpressionBinaryPrivate *priv = DFSM_AST_EXPRESSION_BINARY (self)->priv;
+
+	return (dfsm_ast_expression_is_constant (priv->left_node) == TRUE &&
+	        dfsm_ast_expression_is_constant (priv->right_node) == TRUE) ? TRUE : FALSE;
+}
+
 /**
  * dfsm_ast_expression_binary_new:
  * @expression_type: the type of expression
@@ -452,3 +463,108 @@ dfsm_ast_expression_binary_new (DfsmAstExpressionBinaryType expression_type, Dfs
 
 	return DFSM_AST_EXPRESSION (expression);
 }
+
+/*
+ * dfsm_ast_expression_binary_serialise:
+ * @self: a #DfsmAstExpressionBinary
+ * @buffer: buffer to append the serialised expression to
+ *
+ * Serialise @self and its children for the compiled machine cache.
+ */
+void
+dfsm_ast_expression_binary_serialise (DfsmAstExpressionBinary *self, GByteArray *buffer)
+{
+	DfsmAstExpressionBinaryPrivate *priv;
+
+	g_return_if_fail (DFSM_IS_AST_EXPRESSION_BINARY (self));
+
+	priv = self->priv;
+
+	dfsm_internal_serialise_uint32 (buffer, priv->expression_type);
+	dfsm_ast_expression_serialise (priv->left_node, buffer);
+	dfsm_ast_expression_serialise (priv->right_node, buffer);
+}
+
+/*
+ * dfsm_ast_expression_binary_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_binary_serialise()
+ *
+ * Rebuild a #DfsmAstExpressionBinary and its children from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstExpression *
+dfsm_ast_expression_binary_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstExpression *expression = NULL, *left_node, *right_node;
+	guint32 expression_type;
+
+	if (dfsm_internal_deserialise_uint32 (deserialiser, &expression_type) == FALSE || expression_type > DFSM_AST_EXPRESSION_BINARY_OR) {
+		return NULL;
+	}
+
+	left_node = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (left_node == NULL) {
+		return NULL;
+	}
+
+	right_node = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (right_node != NULL) {
+		expression = dfsm_ast_expression_binary_new ((DfsmAstExpressionBinaryType) expression_type, left_node, right_node);
+		g_object_unref (right_node);
+	}
+
+	g_object_unref (left_node);
+
+	return expression;
+}
+
+/*
+ * dfsm_ast_expression_binary_get_expression_type:
+ * @self: a #DfsmAstExpressionBinary
+ *
+ * Get the operator of the expression.
+ *
+ * Return value: the expression's operator
+ */
+DfsmAstExpressionBinaryType
+dfsm_ast_expression_binary_get_expression_type (DfsmAstExpressionBinary *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION_BINARY (self), DFSM_AST_EXPRESSION_BINARY_TIMES);
+
+	return self->priv->expression_type;
+}
+
+/*
+ * dfsm_ast_expression_binary_get_left_node:
+ * @self: a #DfsmAstExpressionBinary
+ *
+ * Get the left-hand operand of the expression.
+ *
+ * Return value: (transfer none): the expression's left-hand operand
+ */
+DfsmAstExpression *
+dfsm_ast_expression_binary_get_left_node (DfsmAstExpressionBinary *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION_BINARY (self), NULL);
+
+	return self->priv->left_node;
+}
+
+/*
+ * dfsm_ast_expression_binary_get_right_node:
+ * @self: a #DfsmAstExpressionBinary
+ *
+ * Get the right-hand operand of the expression.
+ *
+ * Return value: (transfer none): the expression's right-hand operand
+ */
+DfsmAstExpression *
+dfsm_ast_expression_binary_get_right_node (DfsmAstExpressionBinary *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION_BINARY (self), NULL);
+
+	return self->priv->right_node;
+}
@@ -38,6 +38,7 @@ static void dfsm_ast_expression_data_structure_check (DfsmAstNode *node, DfsmEnv
 static GVariantType *dfsm_ast_expression_data_structure_calculate_type (DfsmAstExpression *self, DfsmEnvironment *environment);
 static GVariant *dfsm_ast_expression_data_structure_evaluate (DfsmAstExpression *self, DfsmEnvironment *environment);
 static gdouble dfsm_ast_expression_data_structure_calculate_weight (DfsmAstExpression *self);
+static gboolean dfsm_ast_expression_data_structure_is_constant (DfsmAstExpression *self);
 
 struct _DfsmAstExpressionDataStructurePrivate {
 	DfsmAstDataStructure *data_structure;
@@ -63,6 +64,7 @@ dfsm_ast_expression_data_structure_class_init (DfsmAstExpressionDataStructureCla
 	expression_class->calculate_type = dfsm_ast_expression_data_structure_calculate_type;
 	expression_class->evaluate = dfsm_ast_expression_data_structure_evaluate;
 	expression_class->calculate_weight = dfsm_ast_expression_data_structure_calculate_weight;
+	expression_class->is_constant = dfsm_ast_expression_data_structure_is_constant;
 }
 
 static void
@@ -138,6 +140,12 @@ dfsm_ast_expression_data_structure_calculate_weight (DfsmAstExpression *self)
 	return dfsm_ast_data_structure_get_weight (DFSM_AST_EXPRESSION_DATA_STRUCTURE (self)->priv->data_structure);
 }
 
+static gboolean
+dfsm_ast_expression_data_structure_is_constant (DfsmAstExpression *self)
+{
+	return dfsm_ast_data_structure_is_constant (DFSM_AST_EXPRESSION_DATA_STRUCTURE (self)->priv->data_structure);
+}
+
 /**
  * dfsm_ast_expression_data_structure_new:
  * @data_structure: a #DfsmAstDataStructure to wrap
@@ -162,6 +170,47 @@ dfsm_ast_expression_data_structure_new (DfsmAstDataStructure *data_structure)
 	return DFSM_AST_EXPRESSION (expression);
 }
 
+/*
+ * dfsm_ast_expression_data_structure_serialise:
+ * @self: a #DfsmAstExpressionDataStructure
+ * @buffer: buffer to append the serialised expression to
+ *
+ * Serialise @self for the compiled machine cache. This is just the serialised form of its data structure.
+ */
+void
+dfsm_ast_expression_data_structure_serialise (DfsmAstExpressionDataStructure *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (self));
+
+	dfsm_ast_data_structure_serialise (self->priv->data_structure, buffer);
+}
+
+/*
+ * dfsm_ast_expression_data_structure_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_data_structure_serialise()
+ *
+ * Rebuild a #DfsmAstExpressionDataStructure and its data structure from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstExpression *
+dfsm_ast_expression_data_structure_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstExpression *expression;
+	DfsmAstDataStructure *data_structure;
+
+	data_structure = dfsm_ast_data_structure_deserialise (deserialiser);
+
+	if (data_structure == NULL) {
+		return NULL;
+	}
+
+	expression = dfsm_ast_expression_data_structure_new (data_structure);
+	g_object_unref (data_structure);
+
+	return expression;
+}
+
 /**
  * dfsm_ast_expression_data_structure_to_variant:
  * @self: a #DfsmAstExpressionDataStructure
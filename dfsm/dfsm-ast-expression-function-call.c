@@ -210,3 +210,49 @@ dfsm_ast_expression_function_call_new (const gchar *function_name, DfsmAstExpres
 
 	return DFSM_AST_EXPRESSION (function_call);
 }
+
+/*
+ * dfsm_ast_expression_function_call_serialise:
+ * @self: a #DfsmAstExpressionFunctionCall
+ * @buffer: buffer to append the serialised expression to
+ *
+ * Serialise @self and its parameters for the compiled machine cache.
+ */
+void
+dfsm_ast_expression_function_call_serialise (DfsmAstExpressionFunctionCall *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_EXPRESSION_FUNCTION_CALL (self));
+
+	dfsm_internal_serialise_string (buffer, self->priv->function_name);
+	dfsm_ast_expression_serialise (self->priv->parameters, buffer);
+}
+
+/*
+ * dfsm_ast_expression_function_call_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_function_call_serialise()
+ *
+ * Rebuild a #DfsmAstExpressionFunctionCall and its parameters from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstExpression *
+dfsm_ast_expression_function_call_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstExpression *function_call, *parameters;
+	const gchar *function_name;
+
+	if (dfsm_internal_deserialise_string (deserialiser, &function_name) == FALSE || *function_name == '\0') {
+		return NULL;
+	}
+
+	parameters = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (parameters == NULL) {
+		return NULL;
+	}
+
+	function_call = dfsm_ast_expression_function_call_new (function_name, parameters);
+	g_object_unref (parameters);
+
+	return function_call;
+}
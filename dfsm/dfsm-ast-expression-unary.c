@@ -42,6 +42,7 @@ static void dfsm_ast_expression_unary_check (DfsmAstNode *node, DfsmEnvironment
 static GVariantType *dfsm_ast_expression_unary_calculate_type (DfsmAstExpression *self, DfsmEnvironment *environment);
 static GVariant *dfsm_ast_expression_unary_evaluate (DfsmAstExpression *self, DfsmEnvironment *environment);
 static gdouble dfsm_ast_expression_unary_calculate_weight (DfsmAstExpression *self);
+static gboolean dfsm_ast_expression_unary_is_constant (DfsmAstExpression *self);
 
 struct _DfsmAstExpressionUnaryPrivate {
 	DfsmAstExpressionUnaryType expression_type;
@@ -68,6 +69,7 @@ dfsm_ast_expression_unary_class_init (DfsmAstExpressionUnaryClass *klass)
 	expression_class->calculate_type = dfsm_ast_expression_unary_calculate_type;
 	expression_class->evaluate = dfsm_ast_expression_unary_evaluate;
 	expression_class->calculate_weight = dfsm_ast_expression_unary_calculate_weight;
+	expression_class->is_constant = dfsm_ast_expression_unary_is_constant;
 }
 
 static void
@@ -202,6 +204,12 @@ dfsm_ast_expression_unary_calculate_weight (DfsmAstExpression *self)
 	return dfsm_ast_expression_calculate_weight (DFSM_AST_EXPRESSION_UNARY (self)->priv->child_node);
 }
 
+static gboolean
+dfsm_ast_expression_unary_is_constant (DfsmAstExpression *self)
+{
+	return dfsm_ast_expression_is_constant (DFSM_AST_EXPRESSION_UNARY (self)->priv->child_node);
+}
+
 /**
  * dfsm_ast_expression_unary_new:
  * @expression_type: the type of expression
@@ -235,3 +243,81 @@ dfsm_ast_expression_unary_new (DfsmAstExpressionUnaryType expression_type, DfsmA
 
 	return DFSM_AST_EXPRESSION (expression);
 }
+
+/*
+ * dfsm_ast_expression_unary_serialise:
+ * @self: a #DfsmAstExpressionUnary
+ * @buffer: buffer to append the serialised expression to
+ *
+ * Serialise @self and its child for the compiled machine cache.
+ */
+void
+dfsm_ast_expression_unary_serialise (DfsmAstExpressionUnary *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_EXPRESSION_UNARY (self));
+
+	dfsm_internal_serialise_uint32 (buffer, self->priv->expression_type);
+	dfsm_ast_expression_serialise (self->priv->child_node, buffer);
+}
+
+/*
+ * dfsm_ast_expression_unary_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_unary_serialise()
+ *
+ * Rebuild a #DfsmAstExpressionUnary and its child from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstExpression *
+dfsm_ast_expression_unary_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstExpression *expression, *child_node;
+	guint32 expression_type;
+
+	if (dfsm_internal_deserialise_uint32 (deserialiser, &expression_type) == FALSE || expression_type != DFSM_AST_EXPRESSION_UNARY_NOT) {
+		return NULL;
+	}
+
+	child_node = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (child_node == NULL) {
+		return NULL;
+	}
+
+	expression = dfsm_ast_expression_unary_new ((DfsmAstExpressionUnaryType) expression_type, child_node);
+	g_object_unref (child_node);
+
+	return expression;
+}
+
+/*
+ * dfsm_ast_expression_unary_get_expression_type:
+ * @self: a #DfsmAstExpressionUnary
+ *
+ * Get the operator of the expression.
+ *
+ * Return value: the expression's operator
+ */
+DfsmAstExpressionUnaryType
+dfsm_ast_expression_unary_get_expression_type (DfsmAstExpressionUnary *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION_UNARY (self), DFSM_AST_EXPRESSION_UNARY_NOT);
+
+	return self->priv->expression_type;
+}
+
+/*
+ * dfsm_ast_expression_unary_get_child_node:
+ * @self: a #DfsmAstExpressionUnary
+ *
+ * Get the operand of the expression.
+ *
+ * Return value: (transfer none): the expression's operand
+ */
+DfsmAstExpression *
+dfsm_ast_expression_unary_get_child_node (DfsmAstExpressionUnary *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION_UNARY (self), NULL);
+
+	return self->priv->child_node;
+}
@@ -29,7 +29,12 @@
 #include <glib.h>
 
 #include "dfsm-ast-expression.h"
+#include "dfsm-ast-expression-binary.h"
+#include "dfsm-ast-expression-data-structure.h"
+#include "dfsm-ast-expression-function-call.h"
+#include "dfsm-ast-expression-unary.h"
 #include "dfsm-ast-object.h"
+#include "dfsm-parser-internal.h"
 
 G_DEFINE_ABSTRACT_TYPE (DfsmAstExpression, dfsm_ast_expression, DFSM_TYPE_AST_NODE)
 
@@ -130,3 +135,169 @@ dfsm_ast_expression_calculate_weight (DfsmAstExpression *self)
 
 	return return_value;
 }
+
+/**
+ * dfsm_ast_expression_is_constant:
+ * @self: a #DfsmAstExpression
+ *
+ * Determine whether the expression always evaluates to the same value, regardless of the environment and of whether fuzzing is enabled. This is
+ * conservative: an expression which refers to variables, calls functions or contains data structures with a positive fuzzing weight is never
+ * constant, even if its value happens not to change.
+ *
+ * This assumes that the expression has already been checked.
+ *
+ * Return value: %TRUE if the expression is constant, %FALSE otherwise
+ */
+gboolean
+dfsm_ast_expression_is_constant (DfsmAstExpression *self)
+{
+	DfsmAstExpressionClass *klass;
+
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION (self), FALSE);
+
+	klass = DFSM_AST_EXPRESSION_GET_CLASS (self);
+
+	/* Expression types which don't say are assumed not to be constant. */
+	if (klass->is_constant == NULL) {
+		return FALSE;
+	}
+
+	return klass->is_constant (self);
+}
+
+/* Tags identifying the subclass of a serialised expression. These are stored in the compiled machine cache, so must not be renumbered. */
+typedef enum {
+	SERIALISED_EXPRESSION_BINARY = 0,
+	SERIALISED_EXPRESSION_UNARY = 1,
+	SERIALISED_EXPRESSION_FUNCTION_CALL = 2,
+	SERIALISED_EXPRESSION_DATA_STRUCTURE = 3,
+} SerialisedExpressionKind;
+
+/*
+ * dfsm_ast_expression_serialise:
+ * @self: a #DfsmAstExpression which hasn't been checked yet
+ * @buffer: buffer to append the serialised expression to
+ *
+ * Serialise @self and its children for the compiled machine cache, tagged with the subclass of @self.
+ */
+void
+dfsm_ast_expression_serialise (DfsmAstExpression *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_EXPRESSION (self));
+
+	if (DFSM_IS_AST_EXPRESSION_BINARY (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_EXPRESSION_BINARY);
+		dfsm_ast_expression_binary_serialise (DFSM_AST_EXPRESSION_BINARY (self), buffer);
+	} else if (DFSM_IS_AST_EXPRESSION_UNARY (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_EXPRESSION_UNARY);
+		dfsm_ast_expression_unary_serialise (DFSM_AST_EXPRESSION_UNARY (self), buffer);
+	} else if (DFSM_IS_AST_EXPRESSION_FUNCTION_CALL (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_EXPRESSION_FUNCTION_CALL);
+		dfsm_ast_expression_function_call_serialise (DFSM_AST_EXPRESSION_FUNCTION_CALL (self), buffer);
+	} else if (DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_EXPRESSION_DATA_STRUCTURE);
+		dfsm_ast_expression_data_structure_serialise (DFSM_AST_EXPRESSION_DATA_STRUCTURE (self), buffer);
+	} else {
+		g_assert_not_reached ();
+	}
+}
+
+/*
+ * dfsm_ast_expression_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_serialise()
+ *
+ * Rebuild a #DfsmAstExpression of the appropriate subclass, and its children, from the compiled machine cache. Expressions which are nested too
+ * deeply are treated as invalid.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstExpression *
+dfsm_ast_expression_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstExpression *expression;
+	guint8 kind;
+
+	if (dfsm_internal_deserialise_byte (deserialiser, &kind) == FALSE || dfsm_internal_deserialiser_enter (deserialiser) == FALSE) {
+		return NULL;
+	}
+
+	switch (kind) {
+		case SERIALISED_EXPRESSION_BINARY:
+			expression = dfsm_ast_expression_binary_deserialise (deserialiser);
+			break;
+		case SERIALISED_EXPRESSION_UNARY:
+			expression = dfsm_ast_expression_unary_deserialise (deserialiser);
+			break;
+		case SERIALISED_EXPRESSION_FUNCTION_CALL:
+			expression = dfsm_ast_expression_function_call_deserialise (deserialiser);
+			break;
+		case SERIALISED_EXPRESSION_DATA_STRUCTURE:
+			expression = dfsm_ast_expression_data_structure_deserialise (deserialiser);
+			break;
+		default:
+			/* Invalid */
+			expression = NULL;
+			break;
+	}
+
+	dfsm_internal_deserialiser_leave (deserialiser);
+
+	return expression;
+}
+
+/*
+ * dfsm_ast_expression_serialise_array:
+ * @expressions: an array of #DfsmAstExpression<!-- -->s
+ * @buffer: buffer to append the serialised expressions to
+ *
+ * Serialise the length of @expressions, then each of the @expressions using dfsm_ast_expression_serialise().
+ */
+void
+dfsm_ast_expression_serialise_array (GPtrArray/*<DfsmAstExpression>*/ *expressions, GByteArray *buffer)
+{
+	guint i;
+
+	g_return_if_fail (expressions != NULL);
+
+	dfsm_internal_serialise_uint32 (buffer, expressions->len);
+
+	for (i = 0; i < expressions->len; i++) {
+		dfsm_ast_expression_serialise (g_ptr_array_index (expressions, i), buffer);
+	}
+}
+
+/*
+ * dfsm_ast_expression_deserialise_array:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_expression_serialise_array()
+ *
+ * Rebuild an array of #DfsmAstExpression<!-- -->s from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new array of AST nodes, or %NULL if the serialised data was invalid
+ */
+GPtrArray/*<DfsmAstExpression>*/ *
+dfsm_ast_expression_deserialise_array (DfsmDeserialiser *deserialiser)
+{
+	GPtrArray/*<DfsmAstExpression>*/ *expressions;
+	guint32 n_expressions, i;
+
+	if (dfsm_internal_deserialise_length (deserialiser, &n_expressions) == FALSE) {
+		return NULL;
+	}
+
+	expressions = g_ptr_array_new_full (n_expressions, g_object_unref);
+
+	for (i = 0; i < n_expressions; i++) {
+		DfsmAstExpression *expression;
+
+		expression = dfsm_ast_expression_deserialise (deserialiser);
+
+		if (expression == NULL) {
+			g_ptr_array_unref (expressions);
+			return NULL;
+		}
+
+		g_ptr_array_add (expressions, expression);
+	}
+
+	return expressions;
+}
@@ -52,6 +52,7 @@ typedef struct {
  * @calculate_type: calculates the static type of the #DfsmAstExpression given its children and an @environment to resolve variables in
  * @evaluate: evaluates the dynamic value of the #DfsmAstExpression given its children and an @environment to resolve variables in
  * @calculate_weight: calculates the fuzzing weight of the #DfsmAstExpression
+ * @is_constant: determines whether the #DfsmAstExpression always evaluates to the same value; see dfsm_ast_expression_is_constant()
  *
  * Class structure for #DfsmAstExpression.
  */
@@ -64,6 +65,7 @@ typedef struct {
 	GVariantType *(*calculate_type) (DfsmAstExpression *self, DfsmEnvironment *environment);
 	GVariant *(*evaluate) (DfsmAstExpression *self, DfsmEnvironment *environment);
 	gdouble (*calculate_weight) (DfsmAstExpression *self);
+	gboolean (*is_constant) (DfsmAstExpression *self);
 } DfsmAstExpressionClass;
 
 GType dfsm_ast_expression_get_type (void) G_GNUC_CONST;
@@ -71,6 +73,7 @@ GType dfsm_ast_expression_get_type (void) G_GNUC_CONST;
 GVariantType *dfsm_ast_expression_calculate_type (DfsmAstExpression *self, DfsmEnvironment *environment) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 GVariant *dfsm_ast_expression_evaluate (DfsmAstExpression *self, DfsmEnvironment *environment) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 gdouble dfsm_ast_expression_calculate_weight (DfsmAstExpression *self);
+gboolean dfsm_ast_expression_is_constant (DfsmAstExpression *self);
 
 G_END_DECLS
 
@@ -67,6 +67,13 @@ dfsm_ast_object_transition_new (DfsmMachineStateNumber from_state, DfsmMachineSt
 	object_transition->nickname = g_strdup (nickname);
 	object_transition->ref_count = 1;
 
+	/* The friendly name is needed for debug output and tracing every time the transition's considered for execution, so build it once. */
+	if (nickname != NULL) {
+		object_transition->friendly_name = g_strdup_printf (_("‘%s’ (%p)"), nickname, transition);
+	} else {
+		object_transition->friendly_name = g_strdup_printf ("%p", transition);
+	}
+
 	return object_transition;
 }
 
@@ -100,6 +107,7 @@ dfsm_ast_object_transition_unref (DfsmAstObjectTransition *object_transition)
 	g_assert (object_transition != NULL);
 
 	if (g_atomic_int_dec_and_test (&object_transition->ref_count) == TRUE) {
+		g_free (object_transition->friendly_name);
 		g_free (object_transition->nickname);
 		g_object_unref (object_transition->transition);
 
@@ -121,11 +129,23 @@ dfsm_ast_object_transition_build_friendly_name (DfsmAstObjectTransition *object_
 {
 	g_return_val_if_fail (object_transition != NULL, NULL);
 
-	if (object_transition->nickname != NULL) {
-		return g_strdup_printf (_("‘%s’ (%p)"), object_transition->nickname, object_transition->transition);
-	}
+	return g_strdup (object_transition->friendly_name);
+}
+
+/**
+ * dfsm_ast_object_transition_get_friendly_name:
+ * @object_transition: a #DfsmAstObjectTransition
+ *
+ * Get the friendly name for the @object_transition, as returned by dfsm_ast_object_transition_build_friendly_name(), without copying it.
+ *
+ * Return value: (transfer none): a friendly name for the @object_transition
+ */
+const gchar *
+dfsm_ast_object_transition_get_friendly_name (DfsmAstObjectTransition *object_transition)
+{
+	g_return_val_if_fail (object_transition != NULL, NULL);
 
-	return g_strdup_printf ("%p", object_transition->transition);
+	return object_transition->friendly_name;
 }
 
 static void dfsm_ast_object_dispose (GObject *object);
@@ -719,6 +739,261 @@ dfsm_ast_object_new (GDBusNodeInfo *dbus_node_info, const gchar *object_path, GP
 	return NULL;
 }
 
+static void
+serialise_string_array (GPtrArray/*<string>*/ *strings, GByteArray *buffer)
+{
+	guint i;
+
+	dfsm_internal_serialise_uint32 (buffer, strings->len);
+
+	for (i = 0; i < strings->len; i++) {
+		dfsm_internal_serialise_string (buffer, g_ptr_array_index (strings, i));
+	}
+}
+
+/* Returns NULL if the serialised data is invalid. */
+static GPtrArray/*<string>*/ *
+deserialise_string_array (DfsmDeserialiser *deserialiser)
+{
+	GPtrArray/*<string>*/ *strings;
+	guint32 n_strings, i;
+
+	if (dfsm_internal_deserialise_length (deserialiser, &n_strings) == FALSE) {
+		return NULL;
+	}
+
+	strings = g_ptr_array_new_full (n_strings, g_free);
+
+	for (i = 0; i < n_strings; i++) {
+		const gchar *str;
+
+		if (dfsm_internal_deserialise_string (deserialiser, &str) == FALSE) {
+			g_ptr_array_unref (strings);
+			return NULL;
+		}
+
+		g_ptr_array_add (strings, g_strdup (str));
+	}
+
+	return strings;
+}
+
+/*
+ * dfsm_ast_object_serialise:
+ * @self: a #DfsmAstObject which hasn't been checked yet
+ * @buffer: buffer to append the serialised object to
+ *
+ * Serialise @self and all its blocks for the compiled machine cache. This must be called before dfsm_ast_object_initial_check(), since that frees
+ * the data, state and transition blocks once it's processed them.
+ */
+void
+dfsm_ast_object_serialise (DfsmAstObject *self, GByteArray *buffer)
+{
+	DfsmAstObjectPrivate *priv;
+	guint i, j;
+
+	g_return_if_fail (DFSM_IS_AST_OBJECT (self));
+
+	priv = self->priv;
+
+	g_assert (priv->data_blocks != NULL && priv->state_blocks != NULL && priv->transition_blocks != NULL);
+
+	dfsm_internal_serialise_string (buffer, priv->object_path);
+	serialise_string_array (priv->bus_names, buffer);
+	serialise_string_array (priv->interface_names, buffer);
+
+	/* Data blocks */
+	dfsm_internal_serialise_uint32 (buffer, priv->data_blocks->len);
+
+	for (i = 0; i < priv->data_blocks->len; i++) {
+		GHashTable/*<string, DfsmAstDataStructure>*/ *data_block = g_ptr_array_index (priv->data_blocks, i);
+		GHashTableIter iter;
+		const gchar *variable_name;
+		DfsmAstDataStructure *data_structure;
+
+		dfsm_internal_serialise_uint32 (buffer, g_hash_table_size (data_block));
+		g_hash_table_iter_init (&iter, data_block);
+
+		while (g_hash_table_iter_next (&iter, (gpointer*) &variable_name, (gpointer*) &data_structure) == TRUE) {
+			dfsm_internal_serialise_string (buffer, variable_name);
+			dfsm_ast_data_structure_serialise (data_structure, buffer);
+		}
+	}
+
+	/* State blocks */
+	dfsm_internal_serialise_uint32 (buffer, priv->state_blocks->len);
+
+	for (i = 0; i < priv->state_blocks->len; i++) {
+		serialise_string_array (g_ptr_array_index (priv->state_blocks, i), buffer);
+	}
+
+	/* Transition blocks */
+	dfsm_internal_serialise_uint32 (buffer, priv->transition_blocks->len);
+
+	for (i = 0; i < priv->transition_blocks->len; i++) {
+		DfsmParserTransitionBlock *transition_block = g_ptr_array_index (priv->transition_blocks, i);
+
+		dfsm_ast_transition_serialise (transition_block->transition, buffer);
+		dfsm_internal_serialise_uint32 (buffer, transition_block->state_pairs->len);
+
+		for (j = 0; j < transition_block->state_pairs->len; j++) {
+			DfsmParserStatePair *state_pair = g_ptr_array_index (transition_block->state_pairs, j);
+
+			dfsm_internal_serialise_string (buffer, state_pair->from_state_name);
+			dfsm_internal_serialise_string (buffer, state_pair->to_state_name);
+			dfsm_internal_serialise_string (buffer, state_pair->nickname);
+		}
+	}
+}
+
+/*
+ * dfsm_ast_object_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_object_serialise()
+ * @dbus_node_info: introspection data for the object's interfaces
+ *
+ * Rebuild a #DfsmAstObject and all its blocks from the compiled machine cache. The object will need checking with dfsm_ast_object_initial_check()
+ * and dfsm_ast_node_check() as if it had just been parsed.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstObject *
+dfsm_ast_object_deserialise (DfsmDeserialiser *deserialiser, GDBusNodeInfo *dbus_node_info)
+{
+	DfsmAstObject *object = NULL;
+	const gchar *object_path;
+	GPtrArray/*<string>*/ *bus_names, *interface_names;
+	GPtrArray/*<GHashTable<string,DfsmAstDataStructure>>*/ *data_blocks;
+	GPtrArray/*<GPtrArray<string>>*/ *state_blocks;
+	GPtrArray/*<DfsmParserTransitionBlock>*/ *transition_blocks;
+	DfsmParserBlockList *block_list;
+	guint32 n_blocks, n_children, i, j;
+
+	g_return_val_if_fail (dbus_node_info != NULL, NULL);
+
+	if (dfsm_internal_deserialise_string (deserialiser, &object_path) == FALSE || *object_path == '\0') {
+		return NULL;
+	}
+
+	bus_names = deserialise_string_array (deserialiser);
+
+	if (bus_names == NULL) {
+		return NULL;
+	}
+
+	interface_names = deserialise_string_array (deserialiser);
+
+	if (interface_names == NULL) {
+		g_ptr_array_unref (bus_names);
+		return NULL;
+	}
+
+	/* Use a block list so the arrays get the same free functions as the parser gives them. */
+	block_list = dfsm_parser_block_list_new ();
+	data_blocks = block_list->data_blocks;
+	state_blocks = block_list->state_blocks;
+	transition_blocks = block_list->transitions;
+
+	/* Data blocks */
+	if (dfsm_internal_deserialise_length (deserialiser, &n_blocks) == FALSE) {
+		goto done;
+	}
+
+	for (i = 0; i < n_blocks; i++) {
+		GHashTable/*<string, DfsmAstDataStructure>*/ *data_block;
+
+		data_block = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_object_unref);
+		g_ptr_array_add (data_blocks, data_block);
+
+		if (dfsm_internal_deserialise_length (deserialiser, &n_children) == FALSE) {
+			goto done;
+		}
+
+		for (j = 0; j < n_children; j++) {
+			const gchar *variable_name;
+			DfsmAstDataStructure *data_structure;
+
+			if (dfsm_internal_deserialise_string (deserialiser, &variable_name) == FALSE) {
+				goto done;
+			}
+
+			data_structure = dfsm_ast_data_structure_deserialise (deserialiser);
+
+			if (data_structure == NULL) {
+				goto done;
+			}
+
+			g_hash_table_insert (data_block, g_strdup (variable_name), data_structure);
+		}
+	}
+
+	/* State blocks */
+	if (dfsm_internal_deserialise_length (deserialiser, &n_blocks) == FALSE) {
+		goto done;
+	}
+
+	for (i = 0; i < n_blocks; i++) {
+		GPtrArray/*<string>*/ *state_block = deserialise_string_array (deserialiser);
+
+		if (state_block == NULL) {
+			goto done;
+		}
+
+		g_ptr_array_add (state_blocks, state_block);
+	}
+
+	/* Transition blocks */
+	if (dfsm_internal_deserialise_length (deserialiser, &n_blocks) == FALSE) {
+		goto done;
+	}
+
+	for (i = 0; i < n_blocks; i++) {
+		DfsmAstTransition *transition;
+		GPtrArray/*<DfsmParserStatePair>*/ *state_pairs;
+		gboolean valid;
+
+		transition = dfsm_ast_transition_deserialise (deserialiser);
+
+		if (transition == NULL) {
+			goto done;
+		}
+
+		valid = dfsm_internal_deserialise_length (deserialiser, &n_children);
+		state_pairs = g_ptr_array_new_with_free_func ((GDestroyNotify) dfsm_parser_state_pair_free);
+
+		for (j = 0; valid == TRUE && j < n_children; j++) {
+			const gchar *from_state_name, *to_state_name, *nickname;
+
+			valid = dfsm_internal_deserialise_string (deserialiser, &from_state_name) == TRUE &&
+			        dfsm_internal_deserialise_string (deserialiser, &to_state_name) == TRUE &&
+			        dfsm_internal_deserialise_maybe_string (deserialiser, &nickname) == TRUE;
+
+			if (valid == TRUE) {
+				g_ptr_array_add (state_pairs, dfsm_parser_state_pair_new (from_state_name, to_state_name, nickname));
+			}
+		}
+
+		if (valid == TRUE) {
+			g_ptr_array_add (transition_blocks, dfsm_parser_transition_block_new (transition, state_pairs));
+		}
+
+		g_ptr_array_unref (state_pairs);
+		g_object_unref (transition);
+
+		if (valid == FALSE) {
+			goto done;
+		}
+	}
+
+	object = dfsm_ast_object_new (dbus_node_info, object_path, bus_names, interface_names, data_blocks, state_blocks, transition_blocks);
+
+done:
+	dfsm_parser_block_list_free (block_list);
+	g_ptr_array_unref (interface_names);
+	g_ptr_array_unref (bus_names);
+
+	return object;
+}
+
 /**
  * dfsm_ast_object_get_environment:
  * @self: a #DfsmAstObject
@@ -55,6 +55,7 @@ typedef struct {
 
 	/*< private >*/
 	gint ref_count;
+	gchar *friendly_name;
 } DfsmAstObjectTransition;
 
 DfsmAstObjectTransition *dfsm_ast_object_transition_new (DfsmAstObjectStateNumber from_state, DfsmAstObjectStateNumber to_state,
@@ -62,6 +63,7 @@ DfsmAstObjectTransition *dfsm_ast_object_transition_new (DfsmAstObjectStateNumbe
 DfsmAstObjectTransition *dfsm_ast_object_transition_ref (DfsmAstObjectTransition *object_transition);
 void dfsm_ast_object_transition_unref (DfsmAstObjectTransition *object_transition);
 gchar *dfsm_ast_object_transition_build_friendly_name (DfsmAstObjectTransition *object_transition) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+const gchar *dfsm_ast_object_transition_get_friendly_name (DfsmAstObjectTransition *object_transition) G_GNUC_PURE;
 
 #define DFSM_TYPE_AST_OBJECT		(dfsm_ast_object_get_type ())
 #define DFSM_AST_OBJECT(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DFSM_TYPE_AST_OBJECT, DfsmAstObject))
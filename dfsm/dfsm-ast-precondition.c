@@ -179,6 +179,53 @@ dfsm_ast_precondition_new (const gchar *error_name /* nullable */, DfsmAstExpres
 	return precondition;
 }
 
+/*
+ * dfsm_ast_precondition_serialise:
+ * @self: a #DfsmAstPrecondition
+ * @buffer: buffer to append the serialised precondition to
+ *
+ * Serialise @self and its condition for the compiled machine cache.
+ */
+void
+dfsm_ast_precondition_serialise (DfsmAstPrecondition *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_PRECONDITION (self));
+
+	dfsm_internal_serialise_string (buffer, self->priv->error_name);
+	dfsm_ast_expression_serialise (self->priv->condition, buffer);
+}
+
+/*
+ * dfsm_ast_precondition_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_precondition_serialise()
+ *
+ * Rebuild a #DfsmAstPrecondition and its condition from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstPrecondition *
+dfsm_ast_precondition_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstPrecondition *precondition;
+	DfsmAstExpression *condition;
+	const gchar *error_name;
+
+	if (dfsm_internal_deserialise_maybe_string (deserialiser, &error_name) == FALSE || (error_name != NULL && *error_name == '\0')) {
+		return NULL;
+	}
+
+	condition = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (condition == NULL) {
+		return NULL;
+	}
+
+	precondition = dfsm_ast_precondition_new (error_name, condition);
+	g_object_unref (condition);
+
+	return precondition;
+}
+
 /**
  * dfsm_ast_precondition_check_is_satisfied:
  * @self: a #DfsmAstPrecondition
@@ -252,3 +299,19 @@ dfsm_ast_precondition_get_error_name (DfsmAstPrecondition *self)
 
 	return self->priv->error_name;
 }
+
+/*
+ * dfsm_ast_precondition_get_condition:
+ * @self: a #DfsmAstPrecondition
+ *
+ * Get the expression which must evaluate to %TRUE for the precondition to be satisfied.
+ *
+ * Return value: (transfer none): the precondition's condition
+ */
+DfsmAstExpression *
+dfsm_ast_precondition_get_condition (DfsmAstPrecondition *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_PRECONDITION (self), NULL);
+
+	return self->priv->condition;
+}
@@ -209,6 +209,55 @@ dfsm_ast_statement_assignment_new (DfsmAstDataStructure *data_structure, DfsmAst
 	return DFSM_AST_STATEMENT (statement);
 }
 
+/*
+ * dfsm_ast_statement_assignment_serialise:
+ * @self: a #DfsmAstStatementAssignment
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self and its children for the compiled machine cache.
+ */
+void
+dfsm_ast_statement_assignment_serialise (DfsmAstStatementAssignment *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT_ASSIGNMENT (self));
+
+	dfsm_ast_data_structure_serialise (self->priv->data_structure, buffer);
+	dfsm_ast_expression_serialise (self->priv->expression, buffer);
+}
+
+/*
+ * dfsm_ast_statement_assignment_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_assignment_serialise()
+ *
+ * Rebuild a #DfsmAstStatementAssignment and its children from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_assignment_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstStatement *statement = NULL;
+	DfsmAstDataStructure *data_structure;
+	DfsmAstExpression *expression;
+
+	data_structure = dfsm_ast_data_structure_deserialise (deserialiser);
+
+	if (data_structure == NULL) {
+		return NULL;
+	}
+
+	expression = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (expression != NULL) {
+		statement = dfsm_ast_statement_assignment_new (data_structure, expression);
+		g_object_unref (expression);
+	}
+
+	g_object_unref (data_structure);
+
+	return statement;
+}
+
 /**
  * dfsm_ast_statement_assignment_get_variable:
  * @self: a #DfsmAstStatementAssignment
@@ -0,0 +1,232 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:dfsm-ast-statement-destroy
+ * @short_description: AST destroy statement node
+ * @stability: Unstable
+ * @include: dfsm/dfsm-ast-statement-destroy.h
+ *
+ * AST destroy statement implementation which supports destroying instances of the containing object at runtime, given the object path of an
+ * instance created by an instantiate statement. See #DfsmAstStatementInstantiate.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gi18n-lib.h>
+
+#include "dfsm-ast-statement-destroy.h"
+#include "dfsm-parser.h"
+#include "dfsm-parser-internal.h"
+
+static void dfsm_ast_statement_destroy_dispose (GObject *object);
+static void dfsm_ast_statement_destroy_sanity_check (DfsmAstNode *node);
+static void dfsm_ast_statement_destroy_pre_check_and_register (DfsmAstNode *node, DfsmEnvironment *environment, GError **error);
+static void dfsm_ast_statement_destroy_check (DfsmAstNode *node, DfsmEnvironment *environment, GError **error);
+static void dfsm_ast_statement_destroy_execute (DfsmAstStatement *statement, DfsmEnvironment *environment, DfsmOutputSequence *output_sequence);
+
+struct _DfsmAstStatementDestroyPrivate {
+	DfsmAstExpression *expression;
+};
+
+G_DEFINE_TYPE (DfsmAstStatementDestroy, dfsm_ast_statement_destroy, DFSM_TYPE_AST_STATEMENT)
+
+static void
+dfsm_ast_statement_destroy_class_init (DfsmAstStatementDestroyClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	DfsmAstNodeClass *node_class = DFSM_AST_NODE_CLASS (klass);
+	DfsmAstStatementClass *statement_class = DFSM_AST_STATEMENT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DfsmAstStatementDestroyPrivate));
+
+	gobject_class->dispose = dfsm_ast_statement_destroy_dispose;
+
+	node_class->sanity_check = dfsm_ast_statement_destroy_sanity_check;
+	node_class->pre_check_and_register = dfsm_ast_statement_destroy_pre_check_and_register;
+	node_class->check = dfsm_ast_statement_destroy_check;
+
+	statement_class->execute = dfsm_ast_statement_destroy_execute;
+}
+
+static void
+dfsm_ast_statement_destroy_init (DfsmAstStatementDestroy *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DFSM_TYPE_AST_STATEMENT_DESTROY, DfsmAstStatementDestroyPrivate);
+}
+
+static void
+dfsm_ast_statement_destroy_dispose (GObject *object)
+{
+	DfsmAstStatementDestroyPrivate *priv = DFSM_AST_STATEMENT_DESTROY (object)->priv;
+
+	g_clear_object (&priv->expression);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dfsm_ast_statement_destroy_parent_class)->dispose (object);
+}
+
+static void
+dfsm_ast_statement_destroy_sanity_check (DfsmAstNode *node)
+{
+	DfsmAstStatementDestroyPrivate *priv = DFSM_AST_STATEMENT_DESTROY (node)->priv;
+
+	g_assert (priv->expression != NULL);
+	dfsm_ast_node_sanity_check (DFSM_AST_NODE (priv->expression));
+}
+
+static void
+dfsm_ast_statement_destroy_pre_check_and_register (DfsmAstNode *node, DfsmEnvironment *environment, GError **error)
+{
+	DfsmAstStatementDestroyPrivate *priv = DFSM_AST_STATEMENT_DESTROY (node)->priv;
+
+	dfsm_ast_node_pre_check_and_register (DFSM_AST_NODE (priv->expression), environment, error);
+
+	if (*error != NULL) {
+		return;
+	}
+}
+
+static void
+dfsm_ast_statement_destroy_check (DfsmAstNode *node, DfsmEnvironment *environment, GError **error)
+{
+	DfsmAstStatementDestroyPrivate *priv = DFSM_AST_STATEMENT_DESTROY (node)->priv;
+	GVariantType *expression_type;
+
+	dfsm_ast_node_check (DFSM_AST_NODE (priv->expression), environment, error);
+
+	if (*error != NULL) {
+		return;
+	}
+
+	/* Check the expression gives the instance's object path. */
+	expression_type = dfsm_ast_expression_calculate_type (priv->expression, environment);
+
+	if (g_variant_type_equal (expression_type, G_VARIANT_TYPE_OBJECT_PATH) == FALSE) {
+		gchar *expression_type_string;
+
+		expression_type_string = g_variant_type_dup_string (expression_type);
+		g_variant_type_free (expression_type);
+
+		g_set_error (error, DFSM_PARSE_ERROR, DFSM_PARSE_ERROR_AST_INVALID,
+		             _("Type mismatch for ‘destroy’ statement: expected an object path but received type %s."), expression_type_string);
+
+		g_free (expression_type_string);
+
+		return;
+	}
+
+	g_variant_type_free (expression_type);
+}
+
+static void
+dfsm_ast_statement_destroy_execute (DfsmAstStatement *statement, DfsmEnvironment *environment, DfsmOutputSequence *output_sequence)
+{
+	DfsmAstStatementDestroyPrivate *priv = DFSM_AST_STATEMENT_DESTROY (statement)->priv;
+	GVariant *value;
+
+	/* Evaluate the object path. Whether it refers to an instance can only be determined when the output sequence is output. */
+	value = dfsm_ast_expression_evaluate (priv->expression, environment);
+	g_assert (value != NULL);
+
+	dfsm_output_sequence_add_destroy (output_sequence, g_variant_get_string (value, NULL));
+	g_variant_unref (value);
+}
+
+/**
+ * dfsm_ast_statement_destroy_new:
+ * @expression: expression to evaluate as the object path of the instance to destroy
+ *
+ * Create a new #DfsmAstStatement for destroying the instance of the containing object at the object path given by @expression.
+ *
+ * Return value: (transfer full): a new AST node
+ */
+DfsmAstStatement *
+dfsm_ast_statement_destroy_new (DfsmAstExpression *expression)
+{
+	DfsmAstStatementDestroy *statement;
+	DfsmAstStatementDestroyPrivate *priv;
+
+	g_return_val_if_fail (DFSM_IS_AST_EXPRESSION (expression), NULL);
+
+	statement = g_object_new (DFSM_TYPE_AST_STATEMENT_DESTROY, NULL);
+	priv = statement->priv;
+
+	priv->expression = g_object_ref (expression);
+
+	return DFSM_AST_STATEMENT (statement);
+}
+
+/*
+ * dfsm_ast_statement_destroy_serialise:
+ * @self: a #DfsmAstStatementDestroy
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self and its parameters for the compiled machine cache. This is just the serialised form of its expression.
+ */
+void
+dfsm_ast_statement_destroy_serialise (DfsmAstStatementDestroy *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT_DESTROY (self));
+
+	dfsm_ast_expression_serialise (self->priv->expression, buffer);
+}
+
+/*
+ * dfsm_ast_statement_destroy_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_destroy_serialise()
+ *
+ * Rebuild a #DfsmAstStatementDestroy and its parameters from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_destroy_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstStatement *statement;
+	DfsmAstExpression *expression;
+
+	expression = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (expression == NULL) {
+		return NULL;
+	}
+
+	statement = dfsm_ast_statement_destroy_new (expression);
+	g_object_unref (expression);
+
+	return statement;
+}
+
+/**
+ * dfsm_ast_statement_destroy_get_expression:
+ * @self: a #DfsmAstStatementDestroy
+ *
+ * Get the expression which gives the object path of the instance to destroy.
+ *
+ * Return value: (transfer none): the statement's expression
+ */
+DfsmAstExpression *
+dfsm_ast_statement_destroy_get_expression (DfsmAstStatementDestroy *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_STATEMENT_DESTROY (self), NULL);
+
+	return self->priv->expression;
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DFSM_AST_STATEMENT_DESTROY_H
+#define DFSM_AST_STATEMENT_DESTROY_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <dfsm/dfsm-ast-expression.h>
+#include <dfsm/dfsm-ast-statement.h>
+
+G_BEGIN_DECLS
+
+#define DFSM_TYPE_AST_STATEMENT_DESTROY		(dfsm_ast_statement_destroy_get_type ())
+#define DFSM_AST_STATEMENT_DESTROY(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DFSM_TYPE_AST_STATEMENT_DESTROY, DfsmAstStatementDestroy))
+#define DFSM_AST_STATEMENT_DESTROY_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), DFSM_TYPE_AST_STATEMENT_DESTROY, DfsmAstStatementDestroyClass))
+#define DFSM_IS_AST_STATEMENT_DESTROY(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), DFSM_TYPE_AST_STATEMENT_DESTROY))
+#define DFSM_IS_AST_STATEMENT_DESTROY_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), DFSM_TYPE_AST_STATEMENT_DESTROY))
+#define DFSM_AST_STATEMENT_DESTROY_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), DFSM_TYPE_AST_STATEMENT_DESTROY, DfsmAstStatementDestroyClass))
+
+typedef struct _DfsmAstStatementDestroyPrivate	DfsmAstStatementDestroyPrivate;
+
+/**
+ * DfsmAstStatementDestroy:
+ *
+ * All the fields in the #DfsmAstStatementDestroy structure are private and should never be accessed directly.
+ */
+typedef struct {
+	DfsmAstStatement parent;
+	DfsmAstStatementDestroyPrivate *priv;
+} DfsmAstStatementDestroy;
+
+/**
+ * DfsmAstStatementDestroyClass:
+ *
+ * All the fields in the #DfsmAstStatementDestroyClass structure are private and should never be accessed directly.
+ */
+typedef struct {
+	/*< private >*/
+	DfsmAstStatementClass parent;
+} DfsmAstStatementDestroyClass;
+
+GType dfsm_ast_statement_destroy_get_type (void) G_GNUC_CONST;
+
+DfsmAstExpression *dfsm_ast_statement_destroy_get_expression (DfsmAstStatementDestroy *self) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DFSM_AST_STATEMENT_DESTROY_H */
@@ -47,6 +47,7 @@ struct _DfsmAstStatementEmitPrivate {
 	gchar *signal_name;
 	gchar *interface_name; /* initially NULL; set in check() */
 	DfsmAstExpression *expression;
+	GVariant *constant_value; /* value of the expression if it's constant; NULL otherwise; set in check() */
 };
 
 G_DEFINE_TYPE (DfsmAstStatementEmit, dfsm_ast_statement_emit, DFSM_TYPE_AST_STATEMENT)
@@ -83,6 +84,11 @@ dfsm_ast_statement_emit_dispose (GObject *object)
 
 	g_clear_object (&priv->expression);
 
+	if (priv->constant_value != NULL) {
+		g_variant_unref (priv->constant_value);
+		priv->constant_value = NULL;
+	}
+
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_ast_statement_emit_parent_class)->dispose (object);
 }
@@ -191,6 +197,11 @@ dfsm_ast_statement_emit_check (DfsmAstNode *node, DfsmEnvironment *environment,
 
 	g_variant_type_free (signal_parameters_type);
 	g_variant_type_free (expr_parameters_type);
+
+	/* Many signals are emitted with constant parameters. Evaluate them once, so output sequences can cache anything derived from them. */
+	if (priv->constant_value == NULL && dfsm_ast_expression_is_constant (priv->expression) == TRUE) {
+		priv->constant_value = dfsm_ast_expression_evaluate (priv->expression, environment);
+	}
 }
 
 static void
@@ -199,6 +210,11 @@ dfsm_ast_statement_emit_execute (DfsmAstStatement *statement, DfsmEnvironment *e
 	DfsmAstStatementEmitPrivate *priv = DFSM_AST_STATEMENT_EMIT (statement)->priv;
 	GVariant *expression_value;
 
+	if (priv->constant_value != NULL) {
+		dfsm_output_sequence_add_constant_emit (output_sequence, priv->interface_name, priv->signal_name, priv->constant_value);
+		return;
+	}
+
 	/* Evaluate the child expression to get the signal parameters, then emit the signal. */
 	expression_value = dfsm_ast_expression_evaluate (priv->expression, environment);
 	dfsm_output_sequence_add_emit (output_sequence, priv->interface_name, priv->signal_name, expression_value);
@@ -231,3 +247,51 @@ dfsm_ast_statement_emit_new (const gchar *signal_name, DfsmAstExpression *expres
 
 	return DFSM_AST_STATEMENT (statement);
 }
+
+/*
+ * dfsm_ast_statement_emit_serialise:
+ * @self: a #DfsmAstStatementEmit which hasn't been checked yet
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self and its parameters for the compiled machine cache. The signal's interface name isn't serialised, since it's only set once the
+ * statement has been checked.
+ */
+void
+dfsm_ast_statement_emit_serialise (DfsmAstStatementEmit *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT_EMIT (self));
+
+	dfsm_internal_serialise_string (buffer, self->priv->signal_name);
+	dfsm_ast_expression_serialise (self->priv->expression, buffer);
+}
+
+/*
+ * dfsm_ast_statement_emit_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_emit_serialise()
+ *
+ * Rebuild a #DfsmAstStatementEmit and its parameters from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_emit_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstStatement *statement;
+	DfsmAstExpression *expression;
+	const gchar *signal_name;
+
+	if (dfsm_internal_deserialise_string (deserialiser, &signal_name) == FALSE || *signal_name == '\0') {
+		return NULL;
+	}
+
+	expression = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (expression == NULL) {
+		return NULL;
+	}
+
+	statement = dfsm_ast_statement_emit_new (signal_name, expression);
+	g_object_unref (expression);
+
+	return statement;
+}
@@ -39,6 +39,7 @@ static void dfsm_ast_statement_reply_execute (DfsmAstStatement *statement, DfsmE
 
 struct _DfsmAstStatementReplyPrivate {
 	DfsmAstExpression *expression;
+	GVariant *constant_value; /* value of the expression if it's constant; NULL otherwise; set in check() */
 };
 
 G_DEFINE_TYPE (DfsmAstStatementReply, dfsm_ast_statement_reply, DFSM_TYPE_AST_STATEMENT)
@@ -74,6 +75,11 @@ dfsm_ast_statement_reply_dispose (GObject *object)
 
 	g_clear_object (&priv->expression);
 
+	if (priv->constant_value != NULL) {
+		g_variant_unref (priv->constant_value);
+		priv->constant_value = NULL;
+	}
+
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_ast_statement_reply_parent_class)->dispose (object);
 }
@@ -113,6 +119,11 @@ dfsm_ast_statement_reply_check (DfsmAstNode *node, DfsmEnvironment *environment,
 	}
 
 	/* Whether the expression's type matches the method triggering the containing transition is checked by the transition itself, not us. */
+
+	/* As with emit statements, evaluate constant replies once, so output sequences can cache anything derived from them. */
+	if (priv->constant_value == NULL && dfsm_ast_expression_is_constant (priv->expression) == TRUE) {
+		priv->constant_value = dfsm_ast_expression_evaluate (priv->expression, environment);
+	}
 }
 
 static void
@@ -121,11 +132,17 @@ dfsm_ast_statement_reply_execute (DfsmAstStatement *statement, DfsmEnvironment *
 	DfsmAstStatementReplyPrivate *priv = DFSM_AST_STATEMENT_REPLY (statement)->priv;
 	GVariant *value;
 
+	if (priv->constant_value != NULL) {
+		dfsm_output_sequence_add_constant_reply (output_sequence, priv->constant_value);
+		return;
+	}
+
 	/* Evaluate the expression */
 	value = dfsm_ast_expression_evaluate (priv->expression, environment);
 	g_assert (value != NULL);
 
 	dfsm_output_sequence_add_reply (output_sequence, value);
+	g_variant_unref (value);
 }
 
 /**
@@ -152,6 +169,47 @@ dfsm_ast_statement_reply_new (DfsmAstExpression *expression)
 	return DFSM_AST_STATEMENT (statement);
 }
 
+/*
+ * dfsm_ast_statement_reply_serialise:
+ * @self: a #DfsmAstStatementReply
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self and its parameters for the compiled machine cache. This is just the serialised form of its expression.
+ */
+void
+dfsm_ast_statement_reply_serialise (DfsmAstStatementReply *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT_REPLY (self));
+
+	dfsm_ast_expression_serialise (self->priv->expression, buffer);
+}
+
+/*
+ * dfsm_ast_statement_reply_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_reply_serialise()
+ *
+ * Rebuild a #DfsmAstStatementReply and its parameters from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_reply_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstStatement *statement;
+	DfsmAstExpression *expression;
+
+	expression = dfsm_ast_expression_deserialise (deserialiser);
+
+	if (expression == NULL) {
+		return NULL;
+	}
+
+	statement = dfsm_ast_statement_reply_new (expression);
+	g_object_unref (expression);
+
+	return statement;
+}
+
 /**
  * dfsm_ast_statement_reply_get_expression:
  * @self: a #DfsmAstStatementReply
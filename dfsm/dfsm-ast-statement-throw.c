@@ -140,3 +140,38 @@ dfsm_ast_statement_throw_new (const gchar *error_name)
 
 	return DFSM_AST_STATEMENT (statement);
 }
+
+/*
+ * dfsm_ast_statement_throw_serialise:
+ * @self: a #DfsmAstStatementThrow
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self for the compiled machine cache.
+ */
+void
+dfsm_ast_statement_throw_serialise (DfsmAstStatementThrow *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT_THROW (self));
+
+	dfsm_internal_serialise_string (buffer, self->priv->error_name);
+}
+
+/*
+ * dfsm_ast_statement_throw_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_throw_serialise()
+ *
+ * Rebuild a #DfsmAstStatementThrow from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_throw_deserialise (DfsmDeserialiser *deserialiser)
+{
+	const gchar *error_name;
+
+	if (dfsm_internal_deserialise_string (deserialiser, &error_name) == FALSE || *error_name == '\0') {
+		return NULL;
+	}
+
+	return dfsm_ast_statement_throw_new (error_name);
+}
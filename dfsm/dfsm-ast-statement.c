@@ -29,6 +29,13 @@
 #include <glib.h>
 
 #include "dfsm-ast-statement.h"
+#include "dfsm-ast-statement-assignment.h"
+#include "dfsm-ast-statement-destroy.h"
+#include "dfsm-ast-statement-emit.h"
+#include "dfsm-ast-statement-instantiate.h"
+#include "dfsm-ast-statement-reply.h"
+#include "dfsm-ast-statement-throw.h"
+#include "dfsm-parser-internal.h"
 
 G_DEFINE_ABSTRACT_TYPE (DfsmAstStatement, dfsm_ast_statement, DFSM_TYPE_AST_NODE)
 
@@ -71,3 +78,84 @@ dfsm_ast_statement_execute (DfsmAstStatement *self, DfsmEnvironment *environment
 	g_assert (klass->execute != NULL);
 	klass->execute (self, environment, output_sequence);
 }
+
+/* Tags identifying the subclass of a serialised statement. These are stored in the compiled machine cache, so must not be renumbered. */
+typedef enum {
+	SERIALISED_STATEMENT_ASSIGNMENT = 0,
+	SERIALISED_STATEMENT_THROW = 1,
+	SERIALISED_STATEMENT_EMIT = 2,
+	SERIALISED_STATEMENT_REPLY = 3,
+	SERIALISED_STATEMENT_INSTANTIATE = 4,
+	SERIALISED_STATEMENT_DESTROY = 5,
+} SerialisedStatementKind;
+
+/*
+ * dfsm_ast_statement_serialise:
+ * @self: a #DfsmAstStatement which hasn't been checked yet
+ * @buffer: buffer to append the serialised statement to
+ *
+ * Serialise @self and its children for the compiled machine cache, tagged with the subclass of @self.
+ */
+void
+dfsm_ast_statement_serialise (DfsmAstStatement *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_STATEMENT (self));
+
+	if (DFSM_IS_AST_STATEMENT_ASSIGNMENT (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_ASSIGNMENT);
+		dfsm_ast_statement_assignment_serialise (DFSM_AST_STATEMENT_ASSIGNMENT (self), buffer);
+	} else if (DFSM_IS_AST_STATEMENT_THROW (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_THROW);
+		dfsm_ast_statement_throw_serialise (DFSM_AST_STATEMENT_THROW (self), buffer);
+	} else if (DFSM_IS_AST_STATEMENT_EMIT (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_EMIT);
+		dfsm_ast_statement_emit_serialise (DFSM_AST_STATEMENT_EMIT (self), buffer);
+	} else if (DFSM_IS_AST_STATEMENT_REPLY (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_REPLY);
+		dfsm_ast_statement_reply_serialise (DFSM_AST_STATEMENT_REPLY (self), buffer);
+	} else if (DFSM_IS_AST_STATEMENT_INSTANTIATE (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_INSTANTIATE);
+		dfsm_ast_statement_instantiate_serialise (DFSM_AST_STATEMENT_INSTANTIATE (self), buffer);
+	} else if (DFSM_IS_AST_STATEMENT_DESTROY (self)) {
+		dfsm_internal_serialise_byte (buffer, SERIALISED_STATEMENT_DESTROY);
+		dfsm_ast_statement_destroy_serialise (DFSM_AST_STATEMENT_DESTROY (self), buffer);
+	} else {
+		g_assert_not_reached ();
+	}
+}
+
+/*
+ * dfsm_ast_statement_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_statement_serialise()
+ *
+ * Rebuild a #DfsmAstStatement of the appropriate subclass, and its children, from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstStatement *
+dfsm_ast_statement_deserialise (DfsmDeserialiser *deserialiser)
+{
+	guint8 kind;
+
+	if (dfsm_internal_deserialise_byte (deserialiser, &kind) == FALSE) {
+		return NULL;
+	}
+
+	switch (kind) {
+		case SERIALISED_STATEMENT_ASSIGNMENT:
+			return dfsm_ast_statement_assignment_deserialise (deserialiser);
+		case SERIALISED_STATEMENT_THROW:
+			return dfsm_ast_statement_throw_deserialise (deserialiser);
+		case SERIALISED_STATEMENT_EMIT:
+			return dfsm_ast_statement_emit_deserialise (deserialiser);
+		case SERIALISED_STATEMENT_REPLY:
+			return dfsm_ast_statement_reply_deserialise (deserialiser);
+		case SERIALISED_STATEMENT_INSTANTIATE:
+			return dfsm_ast_statement_instantiate_deserialise (deserialiser);
+		case SERIALISED_STATEMENT_DESTROY:
+			return dfsm_ast_statement_destroy_deserialise (deserialiser);
+		default:
+			/* Invalid */
+			return NULL;
+	}
+}
@@ -508,6 +508,143 @@ dfsm_ast_transition_new (const DfsmParserTransitionDetails *details, GPtrArray/*
 	return transition;
 }
 
+/*
+ * dfsm_ast_transition_serialise:
+ * @self: a #DfsmAstTransition which hasn't been checked yet
+ * @buffer: buffer to append the serialised transition to
+ *
+ * Serialise @self, its preconditions and its statements for the compiled machine cache. The trigger name is the empty string for arbitrary
+ * transitions.
+ */
+void
+dfsm_ast_transition_serialise (DfsmAstTransition *self, GByteArray *buffer)
+{
+	DfsmAstTransitionPrivate *priv;
+	const gchar *trigger_name;
+	guint i;
+
+	g_return_if_fail (DFSM_IS_AST_TRANSITION (self));
+
+	priv = self->priv;
+
+	switch (priv->trigger) {
+		case DFSM_AST_TRANSITION_METHOD_CALL:
+			trigger_name = priv->trigger_params.method_name;
+			break;
+		case DFSM_AST_TRANSITION_PROPERTY_SET:
+			trigger_name = priv->trigger_params.property_name;
+			break;
+		case DFSM_AST_TRANSITION_ARBITRARY:
+			trigger_name = "";
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+
+	dfsm_internal_serialise_uint32 (buffer, priv->trigger);
+	dfsm_internal_serialise_string (buffer, trigger_name);
+
+	dfsm_internal_serialise_uint32 (buffer, priv->preconditions->len);
+
+	for (i = 0; i < priv->preconditions->len; i++) {
+		dfsm_ast_precondition_serialise (DFSM_AST_PRECONDITION (g_ptr_array_index (priv->preconditions, i)), buffer);
+	}
+
+	dfsm_internal_serialise_uint32 (buffer, priv->statements->len);
+
+	for (i = 0; i < priv->statements->len; i++) {
+		dfsm_ast_statement_serialise (DFSM_AST_STATEMENT (g_ptr_array_index (priv->statements, i)), buffer);
+	}
+}
+
+/*
+ * dfsm_ast_transition_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_transition_serialise()
+ *
+ * Rebuild a #DfsmAstTransition, its preconditions and its statements from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstTransition *
+dfsm_ast_transition_deserialise (DfsmDeserialiser *deserialiser)
+{
+	DfsmAstTransition *transition = NULL;
+	DfsmParserTransitionDetails *details;
+	GPtrArray/*<DfsmAstPrecondition>*/ *preconditions = NULL;
+	GPtrArray/*<DfsmAstStatement>*/ *statements = NULL;
+	guint32 trigger, n_children, i;
+	const gchar *trigger_name;
+
+	if (dfsm_internal_deserialise_uint32 (deserialiser, &trigger) == FALSE ||
+	    dfsm_internal_deserialise_string (deserialiser, &trigger_name) == FALSE) {
+		return NULL;
+	}
+
+	switch (trigger) {
+		case DFSM_AST_TRANSITION_METHOD_CALL:
+		case DFSM_AST_TRANSITION_PROPERTY_SET:
+			if (*trigger_name == '\0') {
+				return NULL;
+			}
+
+			break;
+		case DFSM_AST_TRANSITION_ARBITRARY:
+			trigger_name = NULL;
+			break;
+		default:
+			/* Invalid */
+			return NULL;
+	}
+
+	if (dfsm_internal_deserialise_length (deserialiser, &n_children) == FALSE) {
+		goto done;
+	}
+
+	preconditions = g_ptr_array_new_full (n_children, g_object_unref);
+
+	for (i = 0; i < n_children; i++) {
+		DfsmAstPrecondition *precondition = dfsm_ast_precondition_deserialise (deserialiser);
+
+		if (precondition == NULL) {
+			goto done;
+		}
+
+		g_ptr_array_add (preconditions, precondition);
+	}
+
+	if (dfsm_internal_deserialise_length (deserialiser, &n_children) == FALSE) {
+		goto done;
+	}
+
+	statements = g_ptr_array_new_full (n_children, g_object_unref);
+
+	for (i = 0; i < n_children; i++) {
+		DfsmAstStatement *statement = dfsm_ast_statement_deserialise (deserialiser);
+
+		if (statement == NULL) {
+			goto done;
+		}
+
+		g_ptr_array_add (statements, statement);
+	}
+
+	/* The parser's transition types and the AST's transition triggers are numbered identically. */
+	details = dfsm_parser_transition_details_new ((DfsmParserTransitionType) trigger, trigger_name);
+	transition = dfsm_ast_transition_new (details, preconditions, statements);
+	dfsm_parser_transition_details_free (details);
+
+done:
+	if (statements != NULL) {
+		g_ptr_array_unref (statements);
+	}
+
+	if (preconditions != NULL) {
+		g_ptr_array_unref (preconditions);
+	}
+
+	return transition;
+}
+
 /**
  * dfsm_ast_transition_get_preconditions:
  * @self: a #DfsmAstTransition
@@ -145,6 +145,48 @@ dfsm_ast_variable_new (DfsmVariableScope scope, const gchar *variable_name)
 	return variable;
 }
 
+/*
+ * dfsm_ast_variable_serialise:
+ * @self: a #DfsmAstVariable
+ * @buffer: buffer to append the serialised variable to
+ *
+ * Serialise @self for the compiled machine cache.
+ */
+void
+dfsm_ast_variable_serialise (DfsmAstVariable *self, GByteArray *buffer)
+{
+	g_return_if_fail (DFSM_IS_AST_VARIABLE (self));
+
+	dfsm_internal_serialise_uint32 (buffer, self->priv->scope);
+	dfsm_internal_serialise_string (buffer, self->priv->variable_name);
+}
+
+/*
+ * dfsm_ast_variable_deserialise:
+ * @deserialiser: a deserialiser positioned at data written by dfsm_ast_variable_serialise()
+ *
+ * Rebuild a #DfsmAstVariable from the compiled machine cache.
+ *
+ * Return value: (transfer full): a new AST node, or %NULL if the serialised data was invalid
+ */
+DfsmAstVariable *
+dfsm_ast_variable_deserialise (DfsmDeserialiser *deserialiser)
+{
+	guint32 scope;
+	const gchar *variable_name;
+
+	if (dfsm_internal_deserialise_uint32 (deserialiser, &scope) == FALSE ||
+	    dfsm_internal_deserialise_string (deserialiser, &variable_name) == FALSE) {
+		return NULL;
+	}
+
+	if ((scope != DFSM_VARIABLE_SCOPE_LOCAL && scope != DFSM_VARIABLE_SCOPE_OBJECT) || *variable_name == '\0') {
+		return NULL;
+	}
+
+	return dfsm_ast_variable_new ((DfsmVariableScope) scope, variable_name);
+}
+
 /**
  * dfsm_ast_variable_calculate_type:
  * @self: a #DfsmAstVariable
@@ -208,3 +250,35 @@ dfsm_ast_variable_set_from_variant (DfsmAstVariable *self, DfsmEnvironment *envi
 
 	dfsm_environment_set_variable_value (environment, self->priv->scope, self->priv->variable_name, new_value);
 }
+
+/*
+ * dfsm_ast_variable_get_scope:
+ * @self: a #DfsmAstVariable
+ *
+ * Get the scope of the variable referenced by this node.
+ *
+ * Return value: the variable's scope
+ */
+DfsmVariableScope
+dfsm_ast_variable_get_scope (DfsmAstVariable *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_VARIABLE (self), DFSM_VARIABLE_SCOPE_LOCAL);
+
+	return self->priv->scope;
+}
+
+/*
+ * dfsm_ast_variable_get_name:
+ * @self: a #DfsmAstVariable
+ *
+ * Get the name of the variable referenced by this node.
+ *
+ * Return value: the variable's name
+ */
+const gchar *
+dfsm_ast_variable_get_name (DfsmAstVariable *self)
+{
+	g_return_val_if_fail (DFSM_IS_AST_VARIABLE (self), NULL);
+
+	return self->priv->variable_name;
+}
@@ -34,4 +34,6 @@
 #include "dfsm-ast-statement-throw.h"
 #include "dfsm-ast-statement-emit.h"
 #include "dfsm-ast-statement-reply.h"
+#include "dfsm-ast-statement-instantiate.h"
+#include "dfsm-ast-statement-destroy.h"
 #include "dfsm-ast-variable.h"
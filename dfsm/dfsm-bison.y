@@ -102,6 +102,8 @@
 %token THROW
 %token EMIT
 %token REPLY
+%token INSTANTIATE
+%token DESTROY
 %token L_BRACE
 %token R_BRACE
 %token L_PAREN
@@ -365,6 +367,8 @@ Statement: DataStructure '=' Expression					{ $$ = dfsm_ast_statement_assignment
          | THROW DBusErrorName						{ $$ = dfsm_ast_statement_throw_new ($2); g_free ($2); }
          | EMIT DBusSignalName Expression				{ $$ = dfsm_ast_statement_emit_new ($2, $3); g_free ($2); g_object_unref ($3); }
          | REPLY Expression						{ $$ = dfsm_ast_statement_reply_new ($2); g_object_unref ($2); }
+         | INSTANTIATE Expression					{ $$ = dfsm_ast_statement_instantiate_new ($2); g_object_unref ($2); }
+         | DESTROY Expression						{ $$ = dfsm_ast_statement_destroy_new ($2); g_object_unref ($2); }
 ;
 
 /* Returns a new DfsmAstExpression. */
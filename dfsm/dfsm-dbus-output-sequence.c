@@ -26,18 +26,41 @@
  * D-Bus based implementation of #DfsmOutputSequence which allows for replies to method calls (successful or erroneous ones) and emits signals onto
  * the bus. All actions are queued up when added to the output sequence, and are only propagated to the bus when dfsm_output_sequence_output() is
  * called.
+ *
+ * Replies are sent either through a #GDBusMethodInvocation, for method calls dispatched by GDBus in the usual way, or directly in response to a
+ * method call #GDBusMessage, for method calls handled in a connection filter (see dfsm_object_set_dispatch_in_worker_thread()).
+ *
+ * Property changes are coalesced: all the changes to properties on a given interface are emitted as a single
+ * <code>org.freedesktop.DBus.Properties.PropertiesChanged</code> signal, at the position in the sequence of the first such change.
+ *
+ * Signals whose parameters are constant (see dfsm_output_sequence_add_constant_emit()) are assembled from cached templates of their header fields,
+ * keyed by the identity of their parameters and header fields. Simulations tend to emit the same few constant signals repeatedly, so this avoids
+ * re-validating and rebuilding their headers for each emission. The least recently used templates are evicted once too many are cached. Other
+ * signals are built afresh, since their contents vary.
+ *
+ * Constant replies (see dfsm_output_sequence_add_constant_reply()) share their body between sends, so it isn't re-evaluated for each method call.
+ * Their headers depend on the method call being replied to, so nothing else of them can be cached, and they're otherwise handled like other replies.
+ * Replies are completed through the #GDBusMethodInvocation, if there is one, so that GDBus checks their types.
+ *
+ * Instantiations and destructions of object instances (see dfsm_output_sequence_add_instantiate()) can't be performed by the output sequence itself,
+ * since it doesn't know about the object it's for. When a #DfsmDBusOutputSequence is used by a #DfsmObject, they're handed back to the object when
+ * they're output; otherwise they're ignored.
  */
 
 #include <string.h>
 #include <glib.h>
 
 #include "dfsm-dbus-output-sequence.h"
+#include "dfsm-internal.h"
 #include "dfsm-output-sequence.h"
 
 typedef enum {
 	ENTRY_REPLY,
 	ENTRY_THROW,
 	ENTRY_EMIT,
+	ENTRY_PROPERTIES_CHANGED,
+	ENTRY_INSTANTIATE,
+	ENTRY_DESTROY,
 } QueueEntryType;
 
 typedef struct {
@@ -50,15 +73,32 @@ typedef struct {
 			GError *error;
 		} throw;
 		struct {
-			gchar *interface_name;
-			gchar *signal_name;
+			const gchar *interface_name; /* interned */
+			const gchar *signal_name; /* interned */
 			GVariant *parameters;
+			gboolean constant_parameters; /* TRUE if added with dfsm_output_sequence_add_constant_emit() */
 		} emit;
+		struct {
+			const gchar *interface_name; /* interned */
+			GPtrArray/*<string>*/ *property_names; /* interned; in order of first change */
+			GHashTable/*<string, GVariant>*/ *values; /* NULL values are invalidated properties */
+		} properties_changed;
+		struct {
+			gchar *object_path;
+		} instance; /* for ENTRY_INSTANTIATE and ENTRY_DESTROY */
 	};
 } QueueEntry;
 
 static void
-queue_entry_free (QueueEntry *entry)
+variant_unref_if_set (GVariant *variant)
+{
+	if (variant != NULL) {
+		g_variant_unref (variant);
+	}
+}
+
+static void
+queue_entry_clear (QueueEntry *entry)
 {
 	switch (entry->entry_type) {
 		case ENTRY_REPLY:
@@ -68,17 +108,31 @@ queue_entry_free (QueueEntry *entry)
 			g_error_free (entry->throw.error);
 			break;
 		case ENTRY_EMIT:
-			g_free (entry->emit.interface_name);
-			g_free (entry->emit.signal_name);
 			g_variant_unref (entry->emit.parameters);
 			break;
+		case ENTRY_PROPERTIES_CHANGED:
+			g_ptr_array_unref (entry->properties_changed.property_names);
+			g_hash_table_unref (entry->properties_changed.values);
+			break;
+		case ENTRY_INSTANTIATE:
+		case ENTRY_DESTROY:
+			g_free (entry->instance.object_path);
+			break;
 		default:
 			g_assert_not_reached ();
 	}
-
-	g_slice_free (QueueEntry, entry);
 }
 
+/* Maximum number of message templates to cache. Once this is reached, the least recently used template is evicted for each new one. */
+#define MESSAGE_TEMPLATE_CACHE_SIZE 256
+
+/* Cache of message templates shared between all output sequences, since they're independent of the connection. message_templates_lru holds the
+ * same templates as message_templates, most recently used first. Both are protected by the lock, as output sequences may be output from the GDBus
+ * worker thread. */
+G_LOCK_DEFINE_STATIC (message_templates);
+static GHashTable/*<TemplateKey, MessageTemplate>*/ *message_templates = NULL;
+static GQueue/*<MessageTemplate>*/ message_templates_lru = G_QUEUE_INIT;
+
 static void dfsm_dbus_output_sequence_iface_init (DfsmOutputSequenceInterface *iface);
 static void dfsm_dbus_output_sequence_dispose (GObject *object);
 static void dfsm_dbus_output_sequence_finalize (GObject *object);
@@ -90,18 +144,31 @@ static void dfsm_dbus_output_sequence_add_reply (DfsmOutputSequence *sequence, G
 static void dfsm_dbus_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error);
 static void dfsm_dbus_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
                                                 GVariant *parameters);
+static void dfsm_dbus_output_sequence_add_constant_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
+                                                         GVariant *parameters);
+static void dfsm_dbus_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *property_name,
+                                                           GVariant *value);
+static void dfsm_dbus_output_sequence_add_instantiate (DfsmOutputSequence *sequence, const gchar *object_path);
+static void dfsm_dbus_output_sequence_add_destroy (DfsmOutputSequence *sequence, const gchar *object_path);
 
 struct _DfsmDBusOutputSequencePrivate {
 	GDBusConnection *connection;
-	gchar *object_path;
+	const gchar *object_path; /* interned */
 	GDBusMethodInvocation *invocation;
-	GQueue/*<QueueEntry>*/ output_queue; /* head is the oldest entry (i.e. the one to get executed first) */
+	GDBusMessage *method_call_message;
+	/* Entries are stored inline, and the array's allocation is kept when the sequence is reset, so a reused sequence doesn't allocate for them. */
+	GArray/*<QueueEntry>*/ *output_queue; /* first element is the oldest entry (i.e. the one to get executed first) */
+	guint output_queue_head; /* index of the next entry to be output */
+	GHashTable/*<string, uint>*/ *properties_changed_entries; /* interned interface name to 1 + index of its ENTRY_PROPERTIES_CHANGED entry */
+	DfsmInstanceFunc instance_func; /* NULL if instantiations and destructions should be ignored */
+	gpointer instance_func_user_data;
 };
 
 enum {
 	PROP_CONNECTION = 1,
 	PROP_OBJECT_PATH,
 	PROP_METHOD_INVOCATION,
+	PROP_METHOD_CALL_MESSAGE,
 };
 
 G_DEFINE_TYPE_EXTENDED (DfsmDBusOutputSequence, dfsm_dbus_output_sequence, G_TYPE_OBJECT, 0,
@@ -137,6 +204,13 @@ dfsm_dbus_output_sequence_class_init (DfsmDBusOutputSequenceClass *klass)
 	                                                      "Data about the D-Bus method invocation which triggered this output sequence.",
 	                                                      G_TYPE_DBUS_METHOD_INVOCATION,
 	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (gobject_class, PROP_METHOD_CALL_MESSAGE,
+	                                 g_param_spec_object ("method-call-message",
+	                                                      "Method Call Message",
+	                                                      "The D-Bus method call message which triggered this output sequence, if it has no method invocation.",
+	                                                      G_TYPE_DBUS_MESSAGE,
+	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -145,7 +219,8 @@ dfsm_dbus_output_sequence_init (DfsmDBusOutputSequence *self)
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DFSM_TYPE_DBUS_OUTPUT_SEQUENCE, DfsmDBusOutputSequencePrivate);
 
 	/* Initialise the queue. */
-	g_queue_init (&self->priv->output_queue);
+	self->priv->output_queue = g_array_new (FALSE, FALSE, sizeof (QueueEntry));
+	self->priv->properties_changed_entries = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 static void
@@ -155,6 +230,10 @@ dfsm_dbus_output_sequence_iface_init (DfsmOutputSequenceInterface *iface)
 	iface->add_reply = dfsm_dbus_output_sequence_add_reply;
 	iface->add_throw = dfsm_dbus_output_sequence_add_throw;
 	iface->add_emit = dfsm_dbus_output_sequence_add_emit;
+	iface->add_property_change = dfsm_dbus_output_sequence_add_property_change;
+	iface->add_constant_emit = dfsm_dbus_output_sequence_add_constant_emit;
+	iface->add_instantiate = dfsm_dbus_output_sequence_add_instantiate;
+	iface->add_destroy = dfsm_dbus_output_sequence_add_destroy;
 }
 
 static void
@@ -162,6 +241,7 @@ dfsm_dbus_output_sequence_dispose (GObject *object)
 {
 	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (object)->priv;
 
+	g_clear_object (&priv->method_call_message);
 	g_clear_object (&priv->invocation);
 	g_clear_object (&priv->connection);
 
@@ -169,18 +249,30 @@ dfsm_dbus_output_sequence_dispose (GObject *object)
 	G_OBJECT_CLASS (dfsm_dbus_output_sequence_parent_class)->dispose (object);
 }
 
+/* Clear any entries remaining in the queue (e.g. if outputting them failed part-way through), keeping its allocation. */
+static void
+clear_output_queue (DfsmDBusOutputSequencePrivate *priv)
+{
+	guint i;
+
+	for (i = priv->output_queue_head; i < priv->output_queue->len; i++) {
+		queue_entry_clear (&g_array_index (priv->output_queue, QueueEntry, i));
+	}
+
+	g_array_set_size (priv->output_queue, 0);
+	priv->output_queue_head = 0;
+	g_hash_table_remove_all (priv->properties_changed_entries);
+}
+
 static void
 dfsm_dbus_output_sequence_finalize (GObject *object)
 {
 	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (object)->priv;
-	QueueEntry *queue_entry;
 
 	/* Free any remaining entries in the queue. */
-	while ((queue_entry = g_queue_pop_head (&priv->output_queue)) != NULL) {
-		queue_entry_free (queue_entry);
-	}
-
-	g_free (priv->object_path);
+	clear_output_queue (priv);
+	g_array_free (priv->output_queue, TRUE);
+	g_hash_table_unref (priv->properties_changed_entries);
 
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_dbus_output_sequence_parent_class)->finalize (object);
@@ -201,6 +293,9 @@ dfsm_dbus_output_sequence_get_property (GObject *object, guint property_id, GVal
 		case PROP_METHOD_INVOCATION:
 			g_value_set_object (value, priv->invocation);
 			break;
+		case PROP_METHOD_CALL_MESSAGE:
+			g_value_set_object (value, priv->method_call_message);
+			break;
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -220,12 +315,17 @@ dfsm_dbus_output_sequence_set_property (GObject *object, guint property_id, cons
 			break;
 		case PROP_OBJECT_PATH:
 			/* Construct-only */
-			priv->object_path = g_value_dup_string (value);
+			/* Interned, since it forms part of the message_templates keys. */
+			priv->object_path = g_intern_string (g_value_get_string (value));
 			break;
 		case PROP_METHOD_INVOCATION:
 			/* Construct-only */
 			priv->invocation = g_value_dup_object (value);
 			break;
+		case PROP_METHOD_CALL_MESSAGE:
+			/* Construct-only */
+			priv->method_call_message = g_value_dup_object (value);
+			break;
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -233,6 +333,192 @@ dfsm_dbus_output_sequence_set_property (GObject *object, guint property_id, cons
 	}
 }
 
+/* Key for the message_templates cache. All the pointers are compared by identity: @parameters is the constant value held by the AST node which
+ * emitted the signal (see dfsm_output_sequence_add_constant_emit()), and the strings are interned. */
+typedef struct {
+	GVariant *parameters; /* owned */
+	const gchar *object_path; /* interned */
+	const gchar *interface_name; /* interned */
+	const gchar *signal_name; /* interned */
+} TemplateKey;
+
+/* The header fields of a signal, validated and built once. Messages are assembled from them by reference, outside the message_templates lock,
+ * so templates are reference counted in case they're evicted in the meantime. */
+typedef struct {
+	volatile gint ref_count;
+	TemplateKey key;
+	GList lru_link; /* in message_templates_lru; data points back to the template */
+	GVariant *path; /* owned */
+	GVariant *interface; /* owned */
+	GVariant *member; /* owned */
+} MessageTemplate;
+
+static guint
+template_key_hash (const TemplateKey *key)
+{
+	return g_direct_hash (key->parameters) ^ g_direct_hash (key->object_path) ^ g_direct_hash (key->interface_name) ^
+	       g_direct_hash (key->signal_name);
+}
+
+static gboolean
+template_key_equal (const TemplateKey *a, const TemplateKey *b)
+{
+	return (a->parameters == b->parameters && a->object_path == b->object_path && a->interface_name == b->interface_name &&
+	        a->signal_name == b->signal_name) ? TRUE : FALSE;
+}
+
+static MessageTemplate *
+message_template_ref (MessageTemplate *template)
+{
+	g_atomic_int_inc (&template->ref_count);
+
+	return template;
+}
+
+static void
+message_template_unref (MessageTemplate *template)
+{
+	if (g_atomic_int_dec_and_test (&template->ref_count) == FALSE) {
+		return;
+	}
+
+	g_variant_unref (template->member);
+	g_variant_unref (template->interface);
+	g_variant_unref (template->path);
+	g_variant_unref (template->key.parameters);
+	g_slice_free (MessageTemplate, template);
+}
+
+/* Return a new, unlocked signal message with the given header fields and constant @parameters, assembled from a cached template; the template is
+ * created if it doesn't exist yet. @object_path, @interface_name and @signal_name must be interned and valid. Looking up an existing template doesn't
+ * allocate or hash @parameters. */
+static GDBusMessage *
+new_signal_from_template (const gchar *object_path, const gchar *interface_name, const gchar *signal_name, GVariant *parameters)
+{
+	TemplateKey lookup_key = { parameters, object_path, interface_name, signal_name };
+	MessageTemplate *template;
+	GDBusMessage *message;
+
+	G_LOCK (message_templates);
+
+	if (message_templates == NULL) {
+		message_templates = g_hash_table_new_full ((GHashFunc) template_key_hash, (GEqualFunc) template_key_equal, NULL,
+		                                           (GDestroyNotify) message_template_unref);
+	}
+
+	template = g_hash_table_lookup (message_templates, &lookup_key);
+
+	if (template != NULL) {
+		/* Mark it as the most recently used. */
+		g_queue_unlink (&message_templates_lru, &template->lru_link);
+		g_queue_push_head_link (&message_templates_lru, &template->lru_link);
+	} else {
+		if (g_hash_table_size (message_templates) >= MESSAGE_TEMPLATE_CACHE_SIZE) {
+			MessageTemplate *evicted = g_queue_peek_tail (&message_templates_lru);
+
+			g_queue_unlink (&message_templates_lru, &evicted->lru_link);
+			g_hash_table_remove (message_templates, &evicted->key);
+		}
+
+		/* The key keeps @parameters alive, so its address can't be reused by another value while the template's cached. */
+		template = g_slice_new0 (MessageTemplate);
+		template->ref_count = 1;
+		template->key = lookup_key;
+		g_variant_ref (template->key.parameters);
+		template->lru_link.data = template;
+		template->path = g_variant_ref_sink (g_variant_new_object_path (object_path));
+		template->interface = g_variant_ref_sink (g_variant_new_string (interface_name));
+		template->member = g_variant_ref_sink (g_variant_new_string (signal_name));
+
+		g_hash_table_insert (message_templates, &template->key, template);
+		g_queue_push_head_link (&message_templates_lru, &template->lru_link);
+	}
+
+	message_template_ref (template);
+
+	G_UNLOCK (message_templates);
+
+	/* The message references the template's header values, rather than copying them. This is what g_dbus_message_new_signal() does, minus the
+	 * validation and the construction of the values. */
+	message = g_dbus_message_new ();
+	g_dbus_message_set_message_type (message, G_DBUS_MESSAGE_TYPE_SIGNAL);
+	g_dbus_message_set_flags (message, G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED);
+	g_dbus_message_set_header (message, G_DBUS_MESSAGE_HEADER_FIELD_PATH, template->path);
+	g_dbus_message_set_header (message, G_DBUS_MESSAGE_HEADER_FIELD_INTERFACE, template->interface);
+	g_dbus_message_set_header (message, G_DBUS_MESSAGE_HEADER_FIELD_MEMBER, template->member);
+	g_dbus_message_set_body (message, parameters);
+
+	message_template_unref (template);
+
+	return message;
+}
+
+/* Send a reply to priv->method_call_message directly on the connection, as GDBusMethodInvocation would. Consumes @reply. */
+static void
+send_reply_message (DfsmDBusOutputSequencePrivate *priv, GDBusMessage *reply)
+{
+	GError *child_error = NULL;
+
+	if ((g_dbus_message_get_flags (priv->method_call_message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0 &&
+	    g_dbus_connection_send_message (priv->connection, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, &child_error) == FALSE) {
+		/* Most likely the connection's been closed, which the caller will find out about soon enough. */
+		g_debug ("Error sending reply to D-Bus method call: %s", child_error->message);
+		g_error_free (child_error);
+	}
+
+	g_object_unref (reply);
+}
+
+/* If @constant_parameters is %TRUE, @parameters must have been passed to dfsm_output_sequence_add_constant_emit() and @interface_name and
+ * @signal_name must be interned; the signal is then assembled from a cached template. */
+static void
+emit_signal (DfsmDBusOutputSequencePrivate *priv, const gchar *interface_name, const gchar *signal_name, GVariant *parameters,
+             gboolean constant_parameters, GError **error)
+{
+	gchar *emit_parameters_string;
+
+	if (constant_parameters == FALSE || g_dbus_is_interface_name (interface_name) == FALSE || g_dbus_is_member_name (signal_name) == FALSE) {
+		/* If the names are invalid, this lets GDBus report the error. */
+		g_dbus_connection_emit_signal (priv->connection, NULL, priv->object_path, interface_name, signal_name, parameters, error);
+	} else {
+		GDBusMessage *message;
+
+		message = new_signal_from_template (priv->object_path, interface_name, signal_name, parameters);
+		g_dbus_connection_send_message (priv->connection, message, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, error);
+		g_object_unref (message);
+	}
+
+	/* Debug output. */
+	emit_parameters_string = g_variant_print (parameters, FALSE);
+	g_debug ("Emitting D-Bus signal ‘%s’ on interface ‘%s’ of object ‘%s’. Parameters: %s", signal_name, interface_name, priv->object_path,
+	         emit_parameters_string);
+	g_free (emit_parameters_string);
+}
+
+/* Build the parameters for a PropertiesChanged signal from a coalesced ENTRY_PROPERTIES_CHANGED entry. */
+static GVariant *
+build_properties_changed_parameters (QueueEntry *queue_entry)
+{
+	GVariantBuilder changed_builder, invalidated_builder;
+	guint i;
+
+	g_variant_builder_init (&changed_builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
+
+	for (i = 0; i < queue_entry->properties_changed.property_names->len; i++) {
+		const gchar *property_name = g_ptr_array_index (queue_entry->properties_changed.property_names, i);
+		GVariant *value = g_hash_table_lookup (queue_entry->properties_changed.values, property_name);
+
+		if (value != NULL) {
+			g_variant_builder_add (&changed_builder, "{sv}", property_name, value);
+		} else {
+			g_variant_builder_add (&invalidated_builder, "s", property_name);
+		}
+	}
+
+	return g_variant_new ("(sa{sv}as)", queue_entry->properties_changed.interface_name, &changed_builder, &invalidated_builder);
+}
+
 static void
 dfsm_dbus_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
 {
@@ -241,14 +527,23 @@ dfsm_dbus_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
 	GError *child_error = NULL;
 
 	/* Loop through the queue. */
-	while (child_error == NULL && (queue_entry = g_queue_pop_head (&priv->output_queue)) != NULL) {
+	while (child_error == NULL && priv->output_queue_head < priv->output_queue->len) {
+		queue_entry = &g_array_index (priv->output_queue, QueueEntry, priv->output_queue_head);
+
 		switch (queue_entry->entry_type) {
 			case ENTRY_REPLY: {
 				gchar *reply_parameters_string;
 
 				/* Reply to the method call. */
-				g_assert (priv->invocation != NULL);
-				g_dbus_method_invocation_return_value (priv->invocation, queue_entry->reply.parameters);
+				g_assert (priv->invocation != NULL || priv->method_call_message != NULL);
+
+				if (priv->invocation != NULL) {
+					g_dbus_method_invocation_return_value (priv->invocation, queue_entry->reply.parameters);
+				} else {
+					GDBusMessage *reply = g_dbus_message_new_method_reply (priv->method_call_message);
+					g_dbus_message_set_body (reply, queue_entry->reply.parameters);
+					send_reply_message (priv, reply);
+				}
 
 				/* Debug output. */
 				reply_parameters_string = g_variant_print (queue_entry->reply.parameters, FALSE);
@@ -259,7 +554,16 @@ dfsm_dbus_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
 			}
 			case ENTRY_THROW: {
 				/* Reply to the method call with an error. */
-				g_dbus_method_invocation_return_gerror (priv->invocation, queue_entry->throw.error);
+				g_assert (priv->invocation != NULL || priv->method_call_message != NULL);
+
+				if (priv->invocation != NULL) {
+					g_dbus_method_invocation_return_gerror (priv->invocation, queue_entry->throw.error);
+				} else {
+					gchar *error_name = g_dbus_error_encode_gerror (queue_entry->throw.error);
+					send_reply_message (priv, g_dbus_message_new_method_error_literal (priv->method_call_message, error_name,
+					                                                                   queue_entry->throw.error->message));
+					g_free (error_name);
+				}
 
 				/* Debug output. */
 				g_debug ("Throwing D-Bus error with domain ‘%s’ and code %i. Message: %s",
@@ -268,20 +572,25 @@ dfsm_dbus_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
 
 				break;
 			}
-			case ENTRY_EMIT: {
-				gchar *emit_parameters_string;
-
+			case ENTRY_EMIT:
+			case ENTRY_PROPERTIES_CHANGED: {
 				/* Emit a signal. */
-				g_dbus_connection_emit_signal (priv->connection, NULL, priv->object_path, queue_entry->emit.interface_name,
-				                               queue_entry->emit.signal_name, queue_entry->emit.parameters, &child_error);
-
-				/* Debug output. */
-				emit_parameters_string = g_variant_print (queue_entry->emit.parameters, FALSE);
-				g_debug ("Emitting D-Bus signal ‘%s’ on interface ‘%s’ of object ‘%s’. Parameters: %s", queue_entry->emit.signal_name,
-				         queue_entry->emit.interface_name, priv->object_path, emit_parameters_string);
-				g_free (emit_parameters_string);
+				if (queue_entry->entry_type == ENTRY_EMIT) {
+					emit_signal (priv, queue_entry->emit.interface_name, queue_entry->emit.signal_name,
+					             queue_entry->emit.parameters, queue_entry->emit.constant_parameters, &child_error);
+				} else {
+					GVariant *parameters;
+
+					/* Later changes to this interface's properties can no longer be coalesced into this entry. */
+					g_hash_table_remove (priv->properties_changed_entries, queue_entry->properties_changed.interface_name);
+
+					parameters = g_variant_ref_sink (build_properties_changed_parameters (queue_entry));
+					emit_signal (priv, "org.freedesktop.DBus.Properties", "PropertiesChanged", parameters, FALSE, &child_error);
+					g_variant_unref (parameters);
+				}
 
-				/* Error? Skip the rest of the output. The remaining entries will be cleaned up when the OutputSequence is finalised.
+				/* Error? Skip the rest of the output. The remaining entries will be cleaned up when the OutputSequence is reset or
+				 * finalised.
 				 * Note that we're only supposed to encounter errors here if the signal name is invalid (and similar such situations),
 				 * so it's debatable that this code will ever be called. */
 				if (child_error != NULL) {
@@ -291,12 +600,45 @@ dfsm_dbus_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
 
 				break;
 			}
+			case ENTRY_INSTANTIATE:
+			case ENTRY_DESTROY: {
+				gboolean destroy = (queue_entry->entry_type == ENTRY_DESTROY) ? TRUE : FALSE;
+
+				if (priv->instance_func != NULL) {
+					priv->instance_func (queue_entry->instance.object_path, destroy, priv->instance_func_user_data);
+				} else {
+					g_debug ("Ignoring %s of object instance ‘%s’.", (destroy == TRUE) ? "destruction" : "instantiation",
+					         queue_entry->instance.object_path);
+				}
+
+				break;
+			}
 			default:
 				g_assert_not_reached ();
 		}
 
-		queue_entry_free (queue_entry);
+		queue_entry_clear (queue_entry);
+		priv->output_queue_head++;
 	}
+
+	/* Everything's been output, so the queue's storage can be reused from the start. */
+	if (priv->output_queue_head == priv->output_queue->len) {
+		g_array_set_size (priv->output_queue, 0);
+		priv->output_queue_head = 0;
+	}
+}
+
+/* Append a new, uninitialised entry to the queue and return it. The pointer is only valid until the next entry is appended. */
+static QueueEntry *
+push_queue_entry (DfsmDBusOutputSequencePrivate *priv, QueueEntryType entry_type)
+{
+	QueueEntry *queue_entry;
+
+	g_array_set_size (priv->output_queue, priv->output_queue->len + 1);
+	queue_entry = &g_array_index (priv->output_queue, QueueEntry, priv->output_queue->len - 1);
+	queue_entry->entry_type = entry_type;
+
+	return queue_entry;
 }
 
 static void
@@ -305,11 +647,8 @@ dfsm_dbus_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *par
 	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
 	QueueEntry *queue_entry;
 
-	queue_entry = g_slice_new (QueueEntry);
-	queue_entry->entry_type = ENTRY_REPLY;
+	queue_entry = push_queue_entry (priv, ENTRY_REPLY);
 	queue_entry->reply.parameters = g_variant_ref (parameters);
-
-	g_queue_push_tail (&priv->output_queue, queue_entry);
 }
 
 static void
@@ -318,11 +657,8 @@ dfsm_dbus_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw
 	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
 	QueueEntry *queue_entry;
 
-	queue_entry = g_slice_new (QueueEntry);
-	queue_entry->entry_type = ENTRY_THROW;
+	queue_entry = push_queue_entry (priv, ENTRY_THROW);
 	queue_entry->throw.error = g_error_copy (throw_error);
-
-	g_queue_push_tail (&priv->output_queue, queue_entry);
 }
 
 static void
@@ -331,13 +667,131 @@ dfsm_dbus_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *i
 	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
 	QueueEntry *queue_entry;
 
-	queue_entry = g_slice_new (QueueEntry);
-	queue_entry->entry_type = ENTRY_EMIT;
-	queue_entry->emit.interface_name = g_strdup (interface_name);
-	queue_entry->emit.signal_name = g_strdup (signal_name);
+	queue_entry = push_queue_entry (priv, ENTRY_EMIT);
+	queue_entry->emit.interface_name = g_intern_string (interface_name);
+	queue_entry->emit.signal_name = g_intern_string (signal_name);
 	queue_entry->emit.parameters = g_variant_ref (parameters);
+	queue_entry->emit.constant_parameters = FALSE;
+}
+
+static void
+dfsm_dbus_output_sequence_add_constant_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name,
+                                             GVariant *parameters)
+{
+	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
+	QueueEntry *queue_entry;
+
+	queue_entry = push_queue_entry (priv, ENTRY_EMIT);
+	queue_entry->emit.interface_name = g_intern_string (interface_name);
+	queue_entry->emit.signal_name = g_intern_string (signal_name);
+	queue_entry->emit.parameters = g_variant_ref (parameters);
+	queue_entry->emit.constant_parameters = TRUE;
+}
+
+static void
+dfsm_dbus_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *property_name,
+                                               GVariant *value)
+{
+	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
+	QueueEntry *queue_entry;
+	guint entry_index;
+
+	interface_name = g_intern_string (interface_name);
+	property_name = g_intern_string (property_name);
+
+	/* Coalesce with any earlier changes to properties on the same interface. */
+	entry_index = GPOINTER_TO_UINT (g_hash_table_lookup (priv->properties_changed_entries, interface_name));
+
+	if (entry_index == 0) {
+		queue_entry = push_queue_entry (priv, ENTRY_PROPERTIES_CHANGED);
+		queue_entry->properties_changed.interface_name = interface_name;
+		queue_entry->properties_changed.property_names = g_ptr_array_new ();
+		queue_entry->properties_changed.values = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+		                                                                (GDestroyNotify) variant_unref_if_set);
+
+		g_hash_table_insert (priv->properties_changed_entries, (gpointer) interface_name, GUINT_TO_POINTER (priv->output_queue->len));
+	} else {
+		queue_entry = &g_array_index (priv->output_queue, QueueEntry, entry_index - 1);
+	}
+
+	/* If the value's been changed again, or invalidated, only the latest state is signalled. */
+	if (g_hash_table_contains (queue_entry->properties_changed.values, property_name) == FALSE) {
+		g_ptr_array_add (queue_entry->properties_changed.property_names, (gpointer) property_name);
+	}
+
+	g_hash_table_insert (queue_entry->properties_changed.values, (gpointer) property_name, (value != NULL) ? g_variant_ref (value) : NULL);
+}
+
+static void
+dfsm_dbus_output_sequence_add_instantiate (DfsmOutputSequence *sequence, const gchar *object_path)
+{
+	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
+	QueueEntry *queue_entry;
 
-	g_queue_push_tail (&priv->output_queue, queue_entry);
+	queue_entry = push_queue_entry (priv, ENTRY_INSTANTIATE);
+	queue_entry->instance.object_path = g_strdup (object_path);
+}
+
+static void
+dfsm_dbus_output_sequence_add_destroy (DfsmOutputSequence *sequence, const gchar *object_path)
+{
+	DfsmDBusOutputSequencePrivate *priv = DFSM_DBUS_OUTPUT_SEQUENCE (sequence)->priv;
+	QueueEntry *queue_entry;
+
+	queue_entry = push_queue_entry (priv, ENTRY_DESTROY);
+	queue_entry->instance.object_path = g_strdup (object_path);
+}
+
+/* Reset @self so that it can be reused for another method call, property set or arbitrary transition on the same object and connection, as if it
+ * had just been constructed with the given @invocation or @method_call_message (at most one of which may be non-NULL). Any entries which haven't
+ * been output are discarded. The queue's storage is kept, so in the steady state, reusing a sequence doesn't allocate memory for its entries. */
+void
+dfsm_internal_dbus_output_sequence_reset (DfsmDBusOutputSequence *self, GDBusMethodInvocation *invocation, GDBusMessage *method_call_message)
+{
+	DfsmDBusOutputSequencePrivate *priv;
+
+	g_return_if_fail (DFSM_IS_DBUS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (invocation == NULL || G_IS_DBUS_METHOD_INVOCATION (invocation));
+	g_return_if_fail (method_call_message == NULL || G_IS_DBUS_MESSAGE (method_call_message));
+	g_return_if_fail (invocation == NULL || method_call_message == NULL);
+
+	priv = self->priv;
+
+	clear_output_queue (priv);
+
+	if (invocation != NULL) {
+		g_object_ref (invocation);
+	}
+
+	if (method_call_message != NULL) {
+		g_object_ref (method_call_message);
+	}
+
+	g_clear_object (&priv->invocation);
+	g_clear_object (&priv->method_call_message);
+
+	priv->invocation = invocation;
+	priv->method_call_message = method_call_message;
+}
+
+/* Set the function which is called for each instantiation or destruction of an object instance as it's output, in place of ignoring them. This is
+ * kept when @self is reset. */
+void
+dfsm_internal_dbus_output_sequence_set_instance_func (DfsmDBusOutputSequence *self, DfsmInstanceFunc func, gpointer user_data)
+{
+	g_return_if_fail (DFSM_IS_DBUS_OUTPUT_SEQUENCE (self));
+
+	self->priv->instance_func = func;
+	self->priv->instance_func_user_data = user_data;
+}
+
+/* Get the connection @self outputs over, without taking a reference. */
+GDBusConnection *
+dfsm_internal_dbus_output_sequence_get_connection (DfsmDBusOutputSequence *self)
+{
+	g_return_val_if_fail (DFSM_IS_DBUS_OUTPUT_SEQUENCE (self), NULL);
+
+	return self->priv->connection;
 }
 
 /**
@@ -365,3 +819,31 @@ dfsm_dbus_output_sequence_new (GDBusConnection *connection, const gchar *object_
 	                     "method-invocation", invocation,
 	                     NULL);
 }
+
+/**
+ * dfsm_dbus_output_sequence_new_for_message:
+ * @connection: a D-Bus connection to output the sequence over
+ * @object_path: D-Bus path of the object the output sequence will occur on
+ * @method_call_message: the triggering method call message
+ *
+ * Create a new #DfsmDBusOutputSequence for a method call which wasn't dispatched through GDBus' object registration machinery, and so has no
+ * #GDBusMethodInvocation. Replies are sent directly in response to @method_call_message on @connection, unless it has the
+ * %G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED flag set.
+ *
+ * Return value: (transfer full): a new #DfsmDBusOutputSequence
+ */
+DfsmDBusOutputSequence *
+dfsm_dbus_output_sequence_new_for_message (GDBusConnection *connection, const gchar *object_path, GDBusMessage *method_call_message)
+{
+	g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), NULL);
+	g_return_val_if_fail (object_path != NULL && *object_path != '\0', NULL);
+	g_return_val_if_fail (G_IS_DBUS_MESSAGE (method_call_message), NULL);
+	g_return_val_if_fail (g_dbus_message_get_message_type (method_call_message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL, NULL);
+	g_return_val_if_fail (g_strcmp0 (object_path, g_dbus_message_get_path (method_call_message)) == 0, NULL);
+
+	return g_object_new (DFSM_TYPE_DBUS_OUTPUT_SEQUENCE,
+	                     "connection", connection,
+	                     "object-path", object_path,
+	                     "method-call-message", method_call_message,
+	                     NULL);
+}
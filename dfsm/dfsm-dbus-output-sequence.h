@@ -62,6 +62,8 @@ GType dfsm_dbus_output_sequence_get_type (void) G_GNUC_CONST;
 
 DfsmDBusOutputSequence *dfsm_dbus_output_sequence_new (GDBusConnection *connection, const gchar *object_path,
                                                        GDBusMethodInvocation *invocation) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+DfsmDBusOutputSequence *dfsm_dbus_output_sequence_new_for_message (GDBusConnection *connection, const gchar *object_path,
+                                                                   GDBusMessage *method_call_message) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
 G_END_DECLS
 
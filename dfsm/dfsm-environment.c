@@ -35,6 +35,7 @@
 
 #include "dfsm-environment.h"
 #include "dfsm-environment-functions.h"
+#include "dfsm-internal.h"
 #include "dfsm/dfsm-marshal.h"
 #include "dfsm-parser.h"
 #include "dfsm-parser-internal.h"
@@ -42,6 +43,7 @@
 typedef struct {
 	GVariantType *type;
 	GVariant *value;
+	guint serial; /* value of the scope's serial when the variable was last written */
 } VariableInfo;
 
 static VariableInfo *
@@ -53,6 +55,7 @@ variable_info_copy (VariableInfo *data)
 
 	new_data->type = g_variant_type_copy (data->type);
 	new_data->value = g_variant_ref (data->value);
+	new_data->serial = data->serial;
 
 	return new_data;
 }
@@ -69,6 +72,7 @@ variable_info_free (VariableInfo *data)
 }
 
 static void dfsm_environment_dispose (GObject *object);
+static void dfsm_environment_finalize (GObject *object);
 static void dfsm_environment_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void dfsm_environment_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 
@@ -76,6 +80,11 @@ struct _DfsmEnvironmentPrivate {
 	GHashTable/*<string, VariableInfo>*/ *local_variables, *local_variables_original; /* string for variable name → variable */
 	GHashTable/*<string, VariableInfo>*/ *object_variables, *object_variables_original; /* string for variable name → variable */
 	GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces;
+	guint local_serial, object_serial; /* incremented on every write to a variable in the given scope */
+	gboolean shares_reset_point; /* TRUE iff the *_original tables are shared with a template environment, and hence must not be modified */
+	DfsmArena arena; /* temporaries for the dispatch currently being executed; reset by the machine at the end of each dispatch */
+	gboolean fuzzing_enabled; /* whether data structures with positive weights are fuzzed when evaluated in this environment */
+	GRand *rand; /* generator for everything random done while executing transitions using this environment; NULL until first needed */
 };
 
 enum {
@@ -94,6 +103,7 @@ dfsm_environment_class_init (DfsmEnvironmentClass *klass)
 	gobject_class->get_property = dfsm_environment_get_property;
 	gobject_class->set_property = dfsm_environment_set_property;
 	gobject_class->dispose = dfsm_environment_dispose;
+	gobject_class->finalize = dfsm_environment_finalize;
 
 	/**
 	 * DfsmEnvironment:interfaces:
@@ -117,6 +127,8 @@ dfsm_environment_init (DfsmEnvironment *self)
 	self->priv->local_variables_original = NULL;
 	self->priv->object_variables = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) variable_info_free);
 	self->priv->object_variables_original = NULL;
+	dfsm_internal_arena_init (&self->priv->arena);
+	self->priv->fuzzing_enabled = TRUE;
 }
 
 static void
@@ -153,6 +165,21 @@ dfsm_environment_dispose (GObject *object)
 	G_OBJECT_CLASS (dfsm_environment_parent_class)->dispose (object);
 }
 
+static void
+dfsm_environment_finalize (GObject *object)
+{
+	DfsmEnvironmentPrivate *priv = DFSM_ENVIRONMENT (object)->priv;
+
+	dfsm_internal_arena_clear (&priv->arena);
+
+	if (priv->rand != NULL) {
+		g_rand_free (priv->rand);
+	}
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dfsm_environment_parent_class)->finalize (object);
+}
+
 static void
 dfsm_environment_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
 {
@@ -205,6 +232,42 @@ _dfsm_environment_new (GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces)
 	                     NULL);
 }
 
+/*
+ * dfsm_environment_new_instance:
+ * @template_environment: a #DfsmEnvironment whose reset point has been saved
+ *
+ * Creates a new #DfsmEnvironment for an instance of the object using @template_environment. The new environment shares its interfaces and its reset
+ * point with @template_environment (neither of which are ever modified), and its variables start with the values they have at that reset point. Only
+ * the variables' current values are stored per instance.
+ *
+ * Return value: (transfer full): a new #DfsmEnvironment
+ */
+DfsmEnvironment *
+_dfsm_environment_new_instance (DfsmEnvironment *template_environment)
+{
+	DfsmEnvironment *environment;
+	DfsmEnvironmentPrivate *template_priv, *priv;
+
+	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (template_environment), NULL);
+	g_return_val_if_fail (template_environment->priv->object_variables_original != NULL, NULL);
+
+	template_priv = template_environment->priv;
+
+	environment = g_object_new (DFSM_TYPE_ENVIRONMENT,
+	                            "interfaces", template_priv->interfaces,
+	                            NULL);
+	priv = environment->priv;
+
+	priv->local_variables_original = g_hash_table_ref (template_priv->local_variables_original);
+	priv->object_variables_original = g_hash_table_ref (template_priv->object_variables_original);
+	priv->shares_reset_point = TRUE;
+
+	/* Initialise the variables. */
+	dfsm_environment_reset (environment);
+
+	return environment;
+}
+
 static GHashTable *
 get_map_for_scope (DfsmEnvironment *self, DfsmVariableScope scope)
 {
@@ -219,6 +282,19 @@ get_map_for_scope (DfsmEnvironment *self, DfsmVariableScope scope)
 	}
 }
 
+static guint *
+get_serial_for_scope (DfsmEnvironment *self, DfsmVariableScope scope)
+{
+	switch (scope) {
+		case DFSM_VARIABLE_SCOPE_LOCAL:
+			return &self->priv->local_serial;
+		case DFSM_VARIABLE_SCOPE_OBJECT:
+			return &self->priv->object_serial;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
 static VariableInfo *
 look_up_variable_info (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name, gboolean create_if_nonexistent)
 {
@@ -301,16 +377,15 @@ void
 dfsm_environment_set_variable_type (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name, const GVariantType *new_type)
 {
 	VariableInfo *variable_info;
-	gchar *new_type_string;
 
 	g_return_if_fail (DFSM_IS_ENVIRONMENT (self));
 	g_return_if_fail (variable_name != NULL);
 	g_return_if_fail (new_type != NULL);
 	g_return_if_fail (g_variant_type_is_definite (new_type) == TRUE);
 
-	new_type_string = g_variant_type_dup_string (new_type);
-	g_debug ("Setting type of variable ‘%s’ (scope: %u) in environment %p to type: %s", variable_name, scope, self, new_type_string);
-	g_free (new_type_string);
+	/* Type strings aren't nul-terminated, so print the type string in place rather than duplicating it. */
+	g_debug ("Setting type of variable ‘%s’ (scope: %u) in environment %p to type: %.*s", variable_name, scope, self,
+	         (gint) g_variant_type_get_string_length (new_type), g_variant_type_peek_string (new_type));
 
 	variable_info = look_up_variable_info (self, scope, variable_name, TRUE);
 	g_assert (variable_info != NULL);
@@ -383,6 +458,7 @@ dfsm_environment_set_variable_value (DfsmEnvironment *self, DfsmVariableScope sc
 	}
 
 	variable_info->value = new_value;
+	variable_info->serial = ++(*get_serial_for_scope (self, scope));
 }
 
 /**
@@ -406,10 +482,58 @@ dfsm_environment_unset_variable_value (DfsmEnvironment *self, DfsmVariableScope
 	/* Remove the variable. */
 	variable_map = get_map_for_scope (self, scope);
 	g_hash_table_remove (variable_map, variable_name);
+
+	(*get_serial_for_scope (self, scope))++;
+}
+
+/**
+ * dfsm_environment_get_serial:
+ * @self: a #DfsmEnvironment
+ * @scope: the scope to query
+ *
+ * Get the modification serial of @scope. This is incremented every time a variable in @scope is written, unset or reset, so can be compared against a
+ * previously retrieved serial to cheaply check whether any variable in the scope may have changed. See dfsm_environment_get_variable_serial() to
+ * check individual variables.
+ *
+ * Return value: modification serial for @scope
+ */
+guint
+dfsm_environment_get_serial (DfsmEnvironment *self, DfsmVariableScope scope)
+{
+	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (self), 0);
+
+	return *get_serial_for_scope (self, scope);
+}
+
+/**
+ * dfsm_environment_get_variable_serial:
+ * @self: a #DfsmEnvironment
+ * @scope: the scope of the variable
+ * @variable_name: the name of the variable in the given @scope
+ *
+ * Get the modification serial of @scope at the time the variable named @variable_name was last written (or reset). If this is no greater than a
+ * serial previously retrieved using dfsm_environment_get_serial(), the variable's value hasn't changed since then. This allows caches of values
+ * derived from a few variables to be invalidated only when those variables change.
+ *
+ * Return value: modification serial of the variable
+ */
+guint
+dfsm_environment_get_variable_serial (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name)
+{
+	VariableInfo *variable_info;
+
+	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (self), 0);
+	g_return_val_if_fail (variable_name != NULL, 0);
+
+	variable_info = look_up_variable_info (self, scope, variable_name, FALSE);
+	g_assert (variable_info != NULL);
+
+	return variable_info->serial;
 }
 
+/* Copy @table. If @serial is non-zero, every variable in the copy is marked as written at @serial. */
 static GHashTable *
-copy_environment_hash_table (GHashTable *table)
+copy_environment_hash_table (GHashTable *table, guint serial)
 {
 	GHashTable *new_table;
 	GHashTableIter iter;
@@ -421,7 +545,13 @@ copy_environment_hash_table (GHashTable *table)
 	g_hash_table_iter_init (&iter, table);
 
 	while (g_hash_table_iter_next (&iter, (gpointer*) &key, (gpointer*) &value) == TRUE) {
-		g_hash_table_insert (new_table, g_strdup (key), variable_info_copy (value));
+		VariableInfo *new_value = variable_info_copy (value);
+
+		if (serial != 0) {
+			new_value->serial = serial;
+		}
+
+		g_hash_table_insert (new_table, g_strdup (key), new_value);
 	}
 
 	return new_table;
@@ -435,7 +565,8 @@ copy_environment_hash_table (GHashTable *table)
  * dfsm_environment_reset() is called later, these original values will then replace the current values of variables in the environment. This is
  * a useful but hacky way of allowing the simulation to be reset.
  *
- * This must only be called once in the lifetime of a given #DfsmEnvironment.
+ * This must only be called once in the lifetime of a given #DfsmEnvironment. It does nothing for environments belonging to instances of an object
+ * (see dfsm_object_instantiate()), which share their reset point with the object they were instantiated from.
  */
 void
 dfsm_environment_save_reset_point (DfsmEnvironment *self)
@@ -446,11 +577,15 @@ dfsm_environment_save_reset_point (DfsmEnvironment *self)
 
 	priv = self->priv;
 
+	if (priv->shares_reset_point == TRUE) {
+		return;
+	}
+
 	g_assert (priv->local_variables_original == NULL && priv->object_variables_original == NULL);
 
 	/* Copy local_variables into local_variables_original and the same for object_variables. */
-	priv->local_variables_original = copy_environment_hash_table (priv->local_variables);
-	priv->object_variables_original = copy_environment_hash_table (priv->object_variables);
+	priv->local_variables_original = copy_environment_hash_table (priv->local_variables, 0);
+	priv->object_variables_original = copy_environment_hash_table (priv->object_variables, 0);
 }
 
 /**
@@ -471,12 +606,107 @@ dfsm_environment_reset (DfsmEnvironment *self)
 
 	g_assert (priv->local_variables_original != NULL && priv->object_variables_original != NULL);
 
-	/* Copy local_variables_original over local_variables and the same for object_variables. */
+	/* Copy local_variables_original over local_variables and the same for object_variables. Every variable counts as having been written. */
 	g_hash_table_unref (priv->local_variables);
-	priv->local_variables = copy_environment_hash_table (priv->local_variables_original);
+	priv->local_variables = copy_environment_hash_table (priv->local_variables_original, ++priv->local_serial);
 
 	g_hash_table_unref (priv->object_variables);
-	priv->object_variables = copy_environment_hash_table (priv->object_variables_original);
+	priv->object_variables = copy_environment_hash_table (priv->object_variables_original, ++priv->object_serial);
+}
+
+/**
+ * dfsm_environment_save_snapshot:
+ * @self: a #DfsmEnvironment
+ *
+ * Save the current values of all the object-scoped variables in the environment as a snapshot, which can be restored later using
+ * dfsm_environment_restore_snapshot(). Unlike the reset point, any number of snapshots may be taken, and they may be restored into any environment
+ * for the same object (such as those of its instances). Local-scoped variables aren't included, since they only last for the duration of a
+ * transition.
+ *
+ * The snapshot is a dictionary of variable names to values, of type <literal>a{sv}</literal>, sorted by variable name and in normal form. Snapshots
+ * of environments whose variables have the same values are therefore byte-for-byte identical, so may be compared using g_variant_equal() and hashed
+ * using their serialised data.
+ *
+ * Return value: (transfer full): a snapshot of the object-scoped variables
+ */
+GVariant *
+dfsm_environment_save_snapshot (DfsmEnvironment *self)
+{
+	GList/*<string>*/ *variable_names, *l;
+	GVariantBuilder builder;
+	GVariant *snapshot, *normal_snapshot;
+
+	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (self), NULL);
+
+	variable_names = g_list_sort (g_hash_table_get_keys (self->priv->object_variables), (GCompareFunc) strcmp);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+	for (l = variable_names; l != NULL; l = l->next) {
+		VariableInfo *variable_info = look_up_variable_info (self, DFSM_VARIABLE_SCOPE_OBJECT, l->data, FALSE);
+
+		if (variable_info->value != NULL) {
+			g_variant_builder_add (&builder, "{sv}", l->data, variable_info->value);
+		}
+	}
+
+	g_list_free (variable_names);
+
+	snapshot = g_variant_ref_sink (g_variant_builder_end (&builder));
+	normal_snapshot = g_variant_get_normal_form (snapshot);
+	g_variant_unref (snapshot);
+
+	return normal_snapshot;
+}
+
+/**
+ * dfsm_environment_restore_snapshot:
+ * @self: a #DfsmEnvironment
+ * @snapshot: a snapshot returned by dfsm_environment_save_snapshot()
+ *
+ * Replace the values of all the object-scoped variables in the environment with those saved in @snapshot. Variables which didn't have a value when
+ * the snapshot was taken are left without one. Every object-scoped variable counts as having been written, as with dfsm_environment_reset().
+ */
+void
+dfsm_environment_restore_snapshot (DfsmEnvironment *self, GVariant *snapshot)
+{
+	DfsmEnvironmentPrivate *priv;
+	GHashTableIter iter;
+	GVariantIter snapshot_iter;
+	VariableInfo *variable_info;
+	const gchar *variable_name;
+	GVariant *value;
+	guint serial;
+
+	g_return_if_fail (DFSM_IS_ENVIRONMENT (self));
+	g_return_if_fail (snapshot != NULL && g_variant_is_of_type (snapshot, G_VARIANT_TYPE_VARDICT) == TRUE);
+
+	priv = self->priv;
+	serial = ++priv->object_serial;
+
+	/* Clear all the variables' values, then fill in the ones from the snapshot. */
+	g_hash_table_iter_init (&iter, priv->object_variables);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &variable_info) == TRUE) {
+		if (variable_info->value != NULL) {
+			g_variant_unref (variable_info->value);
+			variable_info->value = NULL;
+		}
+
+		variable_info->serial = serial;
+	}
+
+	g_variant_iter_init (&snapshot_iter, snapshot);
+
+	while (g_variant_iter_loop (&snapshot_iter, "{&sv}", &variable_name, &value) == TRUE) {
+		variable_info = look_up_variable_info (self, DFSM_VARIABLE_SCOPE_OBJECT, variable_name, TRUE);
+
+		if (variable_info->type == NULL) {
+			variable_info->type = g_variant_type_copy (g_variant_get_type (value));
+		}
+
+		variable_info->value = g_variant_ref (value);
+		variable_info->serial = serial;
+	}
 }
 
 static void
@@ -1480,3 +1710,79 @@ dfsm_environment_get_interfaces (DfsmEnvironment *self)
 
 	return self->priv->interfaces;
 }
+
+/**
+ * dfsm_environment_get_arena_statistics:
+ * @self: a #DfsmEnvironment
+ * @statistics: (out caller-allocates): return location for the statistics
+ *
+ * Get statistics about the arena used for temporaries (such as fuzzed strings) created while executing transitions using @self. The arena is reset
+ * after each method call, property set or arbitrary transition made by a #DfsmMachine.
+ */
+void
+dfsm_environment_get_arena_statistics (DfsmEnvironment *self, DfsmArenaStatistics *statistics)
+{
+	g_return_if_fail (DFSM_IS_ENVIRONMENT (self));
+	g_return_if_fail (statistics != NULL);
+
+	*statistics = self->priv->arena.statistics;
+}
+
+/**
+ * dfsm_environment_set_random_seed:
+ * @self: a #DfsmEnvironment
+ * @seed: seed for the random number generator
+ *
+ * Re-seed the random number generator used for everything random done while executing transitions using @self: choosing transitions, fuzzing data
+ * structures, solving preconditions and timing arbitrary transitions. Each environment has its own generator, so a sequence of transitions executed
+ * using @self after it's been seeded is reproducible regardless of what else in the process (including other environments and GLib itself) uses
+ * random numbers.
+ *
+ * If this is never called, the generator is seeded from GLib's global generator (see g_random_int()) when it's first needed.
+ */
+void
+dfsm_environment_set_random_seed (DfsmEnvironment *self, guint32 seed)
+{
+	g_return_if_fail (DFSM_IS_ENVIRONMENT (self));
+
+	if (self->priv->rand == NULL) {
+		self->priv->rand = g_rand_new_with_seed (seed);
+	} else {
+		g_rand_set_seed (self->priv->rand, seed);
+	}
+}
+
+/* Get the arena for temporaries which only live until the end of the current dispatch. See #DfsmArena. */
+DfsmArena *
+dfsm_internal_environment_get_arena (DfsmEnvironment *self)
+{
+	return &self->priv->arena;
+}
+
+/* Get whether data structures are fuzzed when evaluated in @self. If this is %TRUE, fuzzing is performed on all data structures with a positive
+ * weight. If it's %FALSE, fuzzing is performed on no data structures, and they all just take their default value. This is %TRUE by default. */
+gboolean
+dfsm_internal_environment_get_fuzzing_enabled (DfsmEnvironment *self)
+{
+	return self->priv->fuzzing_enabled;
+}
+
+/* Get the random number generator to use for everything random done while executing transitions using @self. See
+ * dfsm_environment_set_random_seed(). Like the rest of the environment, it's not thread safe. */
+GRand *
+dfsm_internal_environment_get_rand (DfsmEnvironment *self)
+{
+	if (G_UNLIKELY (self->priv->rand == NULL)) {
+		self->priv->rand = g_rand_new_with_seed (g_random_int ());
+	}
+
+	return self->priv->rand;
+}
+
+/* Set whether data structures are fuzzed when evaluated in @self. See dfsm_internal_environment_get_fuzzing_enabled(). Since this is per
+ * environment, machines in different threads can have fuzzing enabled independently. */
+void
+dfsm_internal_environment_set_fuzzing_enabled (DfsmEnvironment *self, gboolean enable)
+{
+	self->priv->fuzzing_enabled = enable;
+}
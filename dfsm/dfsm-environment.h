@@ -40,6 +40,25 @@ typedef enum {
 	DFSM_VARIABLE_SCOPE_OBJECT,
 } DfsmVariableScope;
 
+/**
+ * DfsmArenaStatistics:
+ * @num_allocations: number of temporaries allocated from the arena
+ * @bytes_allocated: total size of the temporaries allocated from the arena, in bytes
+ * @peak_bytes_in_use: largest number of bytes allocated from the arena between two resets
+ * @num_chunk_allocations: number of times the arena had to allocate a chunk of memory from the system allocator
+ * @num_resets: number of times the arena has been reset (typically once per dispatch)
+ *
+ * Statistics about the arena which a #DfsmEnvironment uses for temporaries created while executing transitions, accumulated over the lifetime of the
+ * environment. If @num_chunk_allocations is small compared to @num_allocations, the arena is saving calls to the system allocator.
+ */
+typedef struct {
+	guint64 num_allocations;
+	guint64 bytes_allocated;
+	gsize peak_bytes_in_use;
+	guint64 num_chunk_allocations;
+	guint64 num_resets;
+} DfsmArenaStatistics;
+
 #define DFSM_TYPE_ENVIRONMENT		(dfsm_environment_get_type ())
 #define DFSM_ENVIRONMENT(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DFSM_TYPE_ENVIRONMENT, DfsmEnvironment))
 #define DFSM_ENVIRONMENT_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), DFSM_TYPE_ENVIRONMENT, DfsmEnvironmentClass))
@@ -80,11 +99,21 @@ GVariant *dfsm_environment_dup_variable_value (DfsmEnvironment *self, DfsmVariab
 void dfsm_environment_set_variable_value (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name, GVariant *new_value);
 void dfsm_environment_unset_variable_value (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name);
 
+guint dfsm_environment_get_serial (DfsmEnvironment *self, DfsmVariableScope scope) G_GNUC_PURE;
+guint dfsm_environment_get_variable_serial (DfsmEnvironment *self, DfsmVariableScope scope, const gchar *variable_name) G_GNUC_PURE;
+
 void dfsm_environment_save_reset_point (DfsmEnvironment *self);
 void dfsm_environment_reset (DfsmEnvironment *self);
 
+GVariant *dfsm_environment_save_snapshot (DfsmEnvironment *self) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+void dfsm_environment_restore_snapshot (DfsmEnvironment *self, GVariant *snapshot);
+
 GPtrArray/*<GDBusInterfaceInfo>*/ *dfsm_environment_get_interfaces (DfsmEnvironment *self) G_GNUC_PURE;
 
+void dfsm_environment_get_arena_statistics (DfsmEnvironment *self, DfsmArenaStatistics *statistics);
+
+void dfsm_environment_set_random_seed (DfsmEnvironment *self, guint32 seed);
+
 G_END_DECLS
 
 #endif /* !DFSM_ENVIRONMENT_H */
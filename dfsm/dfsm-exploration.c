@@ -0,0 +1,1019 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * SECTION:dfsm-exploration
+ * @short_description: systematic state-space exploration
+ * @stability: Unstable
+ * @include: dfsm/dfsm-exploration.h
+ *
+ * Systematic exploration of the configurations a #DfsmMachine can reach from its starting state, as an alternative to the random walks taken by a
+ * running simulation. A configuration is a pair of a machine state and the values of the machine's object-scoped variables. Starting from the
+ * machine's starting state and the reset point of its environment, every transition whose preconditions are satisfied in a configuration is
+ * executed on a snapshot of that configuration's environment (see dfsm_environment_save_snapshot()), and each distinct resulting configuration is
+ * explored in turn, up to given limits on depth and on the number of configurations.
+ *
+ * Method- and property-triggered transitions are executed with default values for their D-Bus inputs (zero, the empty string, empty containers,
+ * etc.), and fuzzing is disabled, so the exploration is deterministic. Effects of the transitions on the bus (replies, errors, signal emissions) are
+ * discarded.
+ *
+ * After dfsm_exploration_run() has returned, the number of configurations found in each state and the number of times each transition was executed
+ * can be retrieved, as can a set of seed sequences: for each transition which was executed, the shortest sequence of transitions found which executes
+ * it from the starting state. These are suitable for priming a fuzzer.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "dfsm-ast.h"
+#include "dfsm-environment.h"
+#include "dfsm-exploration.h"
+#include "dfsm-internal.h"
+#include "dfsm-machine.h"
+#include "dfsm-output-sequence.h"
+#include "dfsm-parser-internal.h"
+
+/* Minimum number of configurations in a breadth-first frontier to give to each worker thread. Below this, it's not worth the overhead of handing the
+ * configurations to another thread. */
+#define MIN_CONFIGURATIONS_PER_WORKER 16
+
+/* An output sequence which discards everything appended to it, since exploration only cares about the effects transitions have on the environment. */
+typedef GObject DiscardOutputSequence;
+typedef GObjectClass DiscardOutputSequenceClass;
+
+static GType discard_output_sequence_get_type (void) G_GNUC_CONST;
+static void discard_output_sequence_iface_init (DfsmOutputSequenceInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (DiscardOutputSequence, discard_output_sequence, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (DFSM_TYPE_OUTPUT_SEQUENCE, discard_output_sequence_iface_init))
+
+static void
+discard_output_sequence_class_init (DiscardOutputSequenceClass *klass)
+{
+	/* Nothing to see here. */
+}
+
+static void
+discard_output_sequence_init (DiscardOutputSequence *self)
+{
+	/* Nothing to see here. */
+}
+
+static void
+discard_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
+{
+	/* Nothing to output. */
+}
+
+static void
+discard_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *parameters)
+{
+	/* Discard it. */
+}
+
+static void
+discard_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error)
+{
+	/* Discard it. */
+}
+
+static void
+discard_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name, GVariant *parameters)
+{
+	/* Discard it. */
+}
+
+static void
+discard_output_sequence_iface_init (DfsmOutputSequenceInterface *iface)
+{
+	iface->output = discard_output_sequence_output;
+	iface->add_reply = discard_output_sequence_add_reply;
+	iface->add_throw = discard_output_sequence_add_throw;
+	iface->add_emit = discard_output_sequence_add_emit;
+}
+
+/* A node in the graph of explored configurations. Configurations are owned by the exploration's configuration table, and aren't freed until the
+ * results of the exploration are, so parent pointers always remain valid. */
+typedef struct _Configuration Configuration;
+
+struct _Configuration {
+	DfsmMachineStateNumber state;
+	GVariant *snapshot; /* values of the object-scoped variables, as returned by dfsm_environment_save_snapshot() */
+	guint hash;
+	guint depth; /* number of transitions taken from the root configuration */
+	Configuration *parent; /* NULL for the root configuration */
+	guint branch_index; /* index of the branch taken from the parent; unused for the root configuration */
+};
+
+/* Hash the state and the serialised snapshot. Snapshots are in normal form, so equal snapshots have equal serialised data. */
+static guint
+calculate_configuration_hash (DfsmMachineStateNumber state, GVariant *snapshot)
+{
+	const guchar *data;
+	gsize i, size;
+	guint hash = 5381 + state;
+
+	data = g_variant_get_data (snapshot);
+	size = g_variant_get_size (snapshot);
+
+	for (i = 0; i < size; i++) {
+		hash = (hash << 5) + hash + data[i];
+	}
+
+	return hash;
+}
+
+static Configuration *
+configuration_new (DfsmMachineStateNumber state, GVariant *snapshot, guint hash, Configuration *parent, guint branch_index)
+{
+	Configuration *configuration;
+
+	configuration = g_slice_new (Configuration);
+
+	configuration->state = state;
+	configuration->snapshot = snapshot; /* transfer */
+	configuration->hash = hash;
+	configuration->depth = (parent != NULL) ? parent->depth + 1 : 0;
+	configuration->parent = parent;
+	configuration->branch_index = branch_index;
+
+	return configuration;
+}
+
+static void
+configuration_free (Configuration *configuration)
+{
+	g_variant_unref (configuration->snapshot);
+	g_slice_free (Configuration, configuration);
+}
+
+static guint
+configuration_hash (const Configuration *configuration)
+{
+	return configuration->hash;
+}
+
+static gboolean
+configuration_equal (const Configuration *a, const Configuration *b)
+{
+	return (a->hash == b->hash && a->state == b->state && g_variant_equal (a->snapshot, b->snapshot) == TRUE) ? TRUE : FALSE;
+}
+
+/* A transition which can be branched on, along with the local variables which have to be set to execute it: the in-arguments of the triggering
+ * method, or the new value of the triggering property. */
+typedef struct {
+	DfsmAstObjectTransition *object_transition;
+	GPtrArray/*<string>*/ *argument_names;
+	GPtrArray/*<GVariant>*/ *argument_values;
+} Branch;
+
+static void
+branch_clear (Branch *branch)
+{
+	g_ptr_array_unref (branch->argument_values);
+	g_ptr_array_unref (branch->argument_names);
+	dfsm_ast_object_transition_unref (branch->object_transition);
+}
+
+/* Build the default value of the given definite @type: zero, the empty string, an empty container, etc. */
+static GVariant *
+build_default_value (const GVariantType *type)
+{
+	if (g_variant_type_is_basic (type) == TRUE) {
+		switch (*g_variant_type_peek_string (type)) {
+			case 'b':
+				return g_variant_new_boolean (FALSE);
+			case 'y':
+				return g_variant_new_byte (0);
+			case 'n':
+				return g_variant_new_int16 (0);
+			case 'q':
+				return g_variant_new_uint16 (0);
+			case 'i':
+				return g_variant_new_int32 (0);
+			case 'u':
+				return g_variant_new_uint32 (0);
+			case 'x':
+				return g_variant_new_int64 (0);
+			case 't':
+				return g_variant_new_uint64 (0);
+			case 'h':
+				return g_variant_new_handle (0);
+			case 'd':
+				return g_variant_new_double (0.0);
+			case 's':
+				return g_variant_new_string ("");
+			case 'o':
+				return g_variant_new_object_path ("/");
+			case 'g':
+				return g_variant_new_signature ("");
+			default:
+				g_assert_not_reached ();
+		}
+	} else if (g_variant_type_is_variant (type) == TRUE) {
+		return g_variant_new_variant (g_variant_new_tuple (NULL, 0));
+	} else if (g_variant_type_is_maybe (type) == TRUE) {
+		return g_variant_new_maybe (g_variant_type_element (type), NULL);
+	} else if (g_variant_type_is_array (type) == TRUE) {
+		return g_variant_new_array (g_variant_type_element (type), NULL, 0);
+	} else if (g_variant_type_is_tuple (type) == TRUE || g_variant_type_is_dict_entry (type) == TRUE) {
+		GVariantBuilder builder;
+		const GVariantType *child_type;
+
+		g_variant_builder_init (&builder, type);
+
+		for (child_type = g_variant_type_first (type); child_type != NULL; child_type = g_variant_type_next (child_type)) {
+			g_variant_builder_add_value (&builder, build_default_value (child_type));
+		}
+
+		return g_variant_builder_end (&builder);
+	}
+
+	g_assert_not_reached ();
+}
+
+static void
+add_branch_argument (Branch *branch, const gchar *name, const gchar *signature)
+{
+	GVariantType *type;
+
+	type = g_variant_type_new (signature);
+	g_ptr_array_add (branch->argument_names, g_strdup (name));
+	g_ptr_array_add (branch->argument_values, g_variant_ref_sink (build_default_value (type)));
+	g_variant_type_free (type);
+}
+
+/* Work out which local variables have to be set to execute @object_transition. Unknown methods and properties can't happen, since the simulation code
+ * has been checked against the interfaces. */
+static void
+branch_init (Branch *branch, DfsmAstObjectTransition *object_transition, GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces)
+{
+	DfsmAstTransition *transition = object_transition->transition;
+	guint i, j;
+
+	branch->object_transition = dfsm_ast_object_transition_ref (object_transition);
+	branch->argument_names = g_ptr_array_new_with_free_func (g_free);
+	branch->argument_values = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	for (i = 0; i < interfaces->len; i++) {
+		GDBusInterfaceInfo *interface_info = g_ptr_array_index (interfaces, i);
+
+		switch (dfsm_ast_transition_get_trigger (transition)) {
+			case DFSM_AST_TRANSITION_METHOD_CALL: {
+				GDBusMethodInfo *method_info;
+
+				method_info = g_dbus_interface_info_lookup_method (interface_info,
+				                                                   dfsm_ast_transition_get_trigger_method_name (transition));
+
+				if (method_info == NULL) {
+					continue;
+				}
+
+				for (j = 0; method_info->in_args != NULL && method_info->in_args[j] != NULL; j++) {
+					add_branch_argument (branch, method_info->in_args[j]->name, method_info->in_args[j]->signature);
+				}
+
+				return;
+			}
+			case DFSM_AST_TRANSITION_PROPERTY_SET: {
+				GDBusPropertyInfo *property_info;
+
+				property_info = g_dbus_interface_info_lookup_property (interface_info,
+				                                                       dfsm_ast_transition_get_trigger_property_name (transition));
+
+				if (property_info == NULL) {
+					continue;
+				}
+
+				add_branch_argument (branch, "value", property_info->signature);
+
+				return;
+			}
+			case DFSM_AST_TRANSITION_ARBITRARY:
+				/* No arguments. */
+				return;
+			default:
+				g_assert_not_reached ();
+		}
+	}
+}
+
+/* A successor of a configuration, found by a worker. Successors are only turned into configurations (or discarded as duplicates) once they've been
+ * handed back to the main thread. */
+typedef struct {
+	Configuration *parent;
+	guint branch_index;
+	DfsmMachineStateNumber state;
+	GVariant *snapshot;
+	guint hash;
+} Successor;
+
+/* Each worker has its own scratch environment into which configurations' snapshots are restored, so workers can expand configurations
+ * independently. Everything else they touch (the branches, the ASTs and the configurations being expanded) is only read. */
+typedef struct {
+	GArray/*<Branch>*/ *branches;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	GPtrArray/*<Configuration>*/ *frontier;
+	guint frontier_start, frontier_end; /* range of the frontier to expand */
+	GArray/*<Successor>*/ *successors;
+} ExplorationWorker;
+
+static void
+exploration_worker_init (ExplorationWorker *worker, GArray/*<Branch>*/ *branches, DfsmEnvironment *template_environment)
+{
+	worker->branches = branches;
+	worker->environment = _dfsm_environment_new_instance (template_environment);
+	dfsm_internal_environment_set_fuzzing_enabled (worker->environment, FALSE); /* exploration must be deterministic */
+	worker->output_sequence = DFSM_OUTPUT_SEQUENCE (g_object_new (discard_output_sequence_get_type (), NULL));
+	worker->frontier = NULL;
+	worker->frontier_start = worker->frontier_end = 0;
+	worker->successors = g_array_new (FALSE, FALSE, sizeof (Successor));
+}
+
+static void
+exploration_worker_clear (ExplorationWorker *worker)
+{
+	guint i;
+
+	/* Any successors left over are from a cancelled exploration. */
+	for (i = 0; i < worker->successors->len; i++) {
+		g_variant_unref (g_array_index (worker->successors, Successor, i).snapshot);
+	}
+
+	g_array_unref (worker->successors);
+	g_object_unref (worker->output_sequence);
+	g_object_unref (worker->environment);
+}
+
+/* Execute every eligible branch out of @configuration, appending a successor to the worker's array for each. */
+static void
+expand_configuration (ExplorationWorker *worker, Configuration *configuration)
+{
+	DfsmEnvironment *environment = worker->environment;
+	gboolean environment_is_current = FALSE;
+	guint i, j;
+
+	for (i = 0; i < worker->branches->len; i++) {
+		Branch *branch = &g_array_index (worker->branches, Branch, i);
+		DfsmAstObjectTransition *object_transition = branch->object_transition;
+		Successor successor;
+
+		if (object_transition->from_state != configuration->state) {
+			continue;
+		}
+
+		/* Checking preconditions doesn't modify the environment, so it only needs restoring after a transition's been executed in it. */
+		if (environment_is_current == FALSE) {
+			dfsm_environment_restore_snapshot (environment, configuration->snapshot);
+			environment_is_current = TRUE;
+		}
+
+		for (j = 0; j < branch->argument_names->len; j++) {
+			const gchar *name = g_ptr_array_index (branch->argument_names, j);
+			GVariant *value = g_ptr_array_index (branch->argument_values, j);
+
+			dfsm_environment_set_variable_type (environment, DFSM_VARIABLE_SCOPE_LOCAL, name, g_variant_get_type (value));
+			dfsm_environment_set_variable_value (environment, DFSM_VARIABLE_SCOPE_LOCAL, name, value);
+		}
+
+		if (dfsm_ast_transition_check_preconditions (object_transition->transition, environment, NULL, NULL) == TRUE) {
+			dfsm_ast_transition_execute (object_transition->transition, environment, worker->output_sequence);
+			environment_is_current = FALSE;
+
+			/* As in the machine, transitions which throw errors don't change state. */
+			successor.parent = configuration;
+			successor.branch_index = i;
+			successor.state = (dfsm_ast_transition_contains_throw_statement (object_transition->transition) == TRUE) ?
+			                  configuration->state : object_transition->to_state;
+			successor.snapshot = dfsm_environment_save_snapshot (environment);
+			successor.hash = calculate_configuration_hash (successor.state, successor.snapshot);
+
+			g_array_append_val (worker->successors, successor);
+		}
+
+		for (j = 0; j < branch->argument_names->len; j++) {
+			dfsm_environment_unset_variable_value (environment, DFSM_VARIABLE_SCOPE_LOCAL, g_ptr_array_index (branch->argument_names, j));
+		}
+
+		dfsm_internal_arena_reset (dfsm_internal_environment_get_arena (environment));
+	}
+}
+
+static void
+exploration_worker_thread_cb (ExplorationWorker *worker, gpointer user_data)
+{
+	guint i;
+
+	for (i = worker->frontier_start; i < worker->frontier_end; i++) {
+		expand_configuration (worker, g_ptr_array_index (worker->frontier, i));
+	}
+}
+
+static void dfsm_exploration_dispose (GObject *object);
+static void dfsm_exploration_finalize (GObject *object);
+static void dfsm_exploration_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
+static void dfsm_exploration_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
+
+struct _DfsmExplorationPrivate {
+	DfsmMachine *machine;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *transitions;
+	GArray/*<Branch>*/ *branches; /* indexed in the same order as transitions; NULL until the first run */
+	guint num_states;
+
+	/* Results of the last run */
+	GHashTable/*<Configuration, Configuration>*/ *configurations; /* owns the configurations */
+	GArray/*<guint>*/ *state_coverage; /* number of configurations in each state (indexed by DfsmMachineStateNumber) */
+	GArray/*<guint>*/ *transition_coverage; /* number of times each transition was executed (indexed as for transitions) */
+	GPtrArray/*<GPtrArray<DfsmAstObjectTransition>>*/ *seeds;
+	guint depth;
+	gboolean is_exhaustive;
+};
+
+enum {
+	PROP_MACHINE = 1,
+};
+
+G_DEFINE_TYPE (DfsmExploration, dfsm_exploration, G_TYPE_OBJECT)
+
+static void
+dfsm_exploration_class_init (DfsmExplorationClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (DfsmExplorationPrivate));
+
+	gobject_class->get_property = dfsm_exploration_get_property;
+	gobject_class->set_property = dfsm_exploration_set_property;
+	gobject_class->dispose = dfsm_exploration_dispose;
+	gobject_class->finalize = dfsm_exploration_finalize;
+
+	/**
+	 * DfsmExploration:machine:
+	 *
+	 * The machine whose configurations are explored. The machine itself is never modified by the exploration.
+	 */
+	g_object_class_install_property (gobject_class, PROP_MACHINE,
+	                                 g_param_spec_object ("machine",
+	                                                      "Machine", "The machine whose configurations are explored.",
+	                                                      DFSM_TYPE_MACHINE,
+	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+dfsm_exploration_init (DfsmExploration *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DFSM_TYPE_EXPLORATION, DfsmExplorationPrivate);
+
+	self->priv->configurations = g_hash_table_new_full ((GHashFunc) configuration_hash, (GEqualFunc) configuration_equal,
+	                                                    (GDestroyNotify) configuration_free, NULL);
+	self->priv->state_coverage = g_array_new (FALSE, TRUE, sizeof (guint));
+	self->priv->transition_coverage = g_array_new (FALSE, TRUE, sizeof (guint));
+	self->priv->seeds = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+dfsm_exploration_dispose (GObject *object)
+{
+	DfsmExplorationPrivate *priv = DFSM_EXPLORATION (object)->priv;
+
+	if (priv->branches != NULL) {
+		g_array_unref (priv->branches);
+		priv->branches = NULL;
+	}
+
+	if (priv->transitions != NULL) {
+		g_ptr_array_unref (priv->transitions);
+		priv->transitions = NULL;
+	}
+
+	if (priv->machine != NULL) {
+		g_object_unref (priv->machine);
+		priv->machine = NULL;
+	}
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dfsm_exploration_parent_class)->dispose (object);
+}
+
+static void
+dfsm_exploration_finalize (GObject *object)
+{
+	DfsmExplorationPrivate *priv = DFSM_EXPLORATION (object)->priv;
+
+	g_ptr_array_unref (priv->seeds);
+	g_array_unref (priv->transition_coverage);
+	g_array_unref (priv->state_coverage);
+	g_hash_table_unref (priv->configurations);
+
+	/* Chain up to the parent class */
+	G_OBJECT_CLASS (dfsm_exploration_parent_class)->finalize (object);
+}
+
+static void
+dfsm_exploration_get_property (GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
+{
+	DfsmExplorationPrivate *priv = DFSM_EXPLORATION (object)->priv;
+
+	switch (property_id) {
+		case PROP_MACHINE:
+			g_value_set_object (value, priv->machine);
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+static void
+dfsm_exploration_set_property (GObject *object, guint property_id, const GValue *value, GParamSpec *pspec)
+{
+	DfsmExplorationPrivate *priv = DFSM_EXPLORATION (object)->priv;
+
+	switch (property_id) {
+		case PROP_MACHINE:
+			/* Construct-only */
+			priv->machine = g_value_dup_object (value);
+			priv->transitions = _dfsm_machine_dup_transitions (priv->machine);
+
+			for (priv->num_states = 0; dfsm_machine_get_state_name (priv->machine, priv->num_states) != NULL; priv->num_states++);
+
+			break;
+		default:
+			/* We don't have any other property... */
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
+}
+
+/**
+ * dfsm_exploration_new:
+ * @machine: the #DfsmMachine to explore
+ *
+ * Creates a new #DfsmExploration for @machine. Nothing is explored until dfsm_exploration_run() is called.
+ *
+ * Return value: (transfer full): a new #DfsmExploration
+ */
+DfsmExploration *
+dfsm_exploration_new (DfsmMachine *machine)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (machine), NULL);
+
+	return g_object_new (DFSM_TYPE_EXPLORATION,
+	                     "machine", machine,
+	                     NULL);
+}
+
+static void
+build_branches (DfsmExploration *self)
+{
+	DfsmExplorationPrivate *priv = self->priv;
+	GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces;
+	guint i;
+
+	interfaces = dfsm_environment_get_interfaces (dfsm_machine_get_environment (priv->machine));
+
+	priv->branches = g_array_sized_new (FALSE, FALSE, sizeof (Branch), priv->transitions->len);
+	g_array_set_clear_func (priv->branches, (GDestroyNotify) branch_clear);
+	g_array_set_size (priv->branches, priv->transitions->len);
+
+	for (i = 0; i < priv->transitions->len; i++) {
+		branch_init (&g_array_index (priv->branches, Branch, i), g_ptr_array_index (priv->transitions, i), interfaces);
+	}
+}
+
+static void
+reset_results (DfsmExploration *self)
+{
+	DfsmExplorationPrivate *priv = self->priv;
+
+	g_hash_table_remove_all (priv->configurations);
+	g_ptr_array_set_size (priv->seeds, 0);
+
+	g_array_set_size (priv->state_coverage, 0);
+	g_array_set_size (priv->state_coverage, priv->num_states);
+	g_array_set_size (priv->transition_coverage, 0);
+	g_array_set_size (priv->transition_coverage, priv->transitions->len);
+
+	priv->depth = 0;
+	priv->is_exhaustive = TRUE;
+}
+
+/* Add @configuration to the results, taking ownership of it. */
+static void
+add_configuration (DfsmExploration *self, Configuration *configuration)
+{
+	DfsmExplorationPrivate *priv = self->priv;
+
+	g_hash_table_insert (priv->configurations, configuration, configuration);
+	g_array_index (priv->state_coverage, guint, configuration->state)++;
+	priv->depth = MAX (priv->depth, configuration->depth);
+}
+
+/* Build the sequence of transitions which leads from the root configuration to @parent and then executes the given branch. */
+static GPtrArray/*<DfsmAstObjectTransition>*/ *
+build_seed (DfsmExploration *self, Configuration *parent, guint branch_index)
+{
+	DfsmExplorationPrivate *priv = self->priv;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *seed;
+	Configuration *configuration;
+	guint i;
+
+	seed = g_ptr_array_new_full (parent->depth + 1, (GDestroyNotify) dfsm_ast_object_transition_unref);
+	g_ptr_array_set_size (seed, parent->depth + 1);
+
+	g_ptr_array_index (seed, parent->depth) = dfsm_ast_object_transition_ref (g_ptr_array_index (priv->transitions, branch_index));
+
+	for (configuration = parent, i = parent->depth; configuration->parent != NULL; configuration = configuration->parent) {
+		g_ptr_array_index (seed, --i) = dfsm_ast_object_transition_ref (g_ptr_array_index (priv->transitions, configuration->branch_index));
+	}
+
+	return seed;
+}
+
+/* Turn the successors found by a worker into new configurations, in the order they were found, appending them to @new_configurations. Successors
+ * which duplicate an existing configuration, or which would take the exploration over its configuration limit, are discarded. */
+static void
+merge_successors (DfsmExploration *self, GArray/*<Successor>*/ *successors, guint max_configurations,
+                  GPtrArray/*<Configuration>*/ *new_configurations)
+{
+	DfsmExplorationPrivate *priv = self->priv;
+	guint i;
+
+	for (i = 0; i < successors->len; i++) {
+		Successor *successor = &g_array_index (successors, Successor, i);
+		Configuration key, *configuration;
+		guint *transition_count;
+
+		/* Record the coverage of the transition, and keep the path to its first execution as a seed. Since configurations are merged in order
+		 * of depth when exploring breadth-first, this is a shortest path. */
+		transition_count = &g_array_index (priv->transition_coverage, guint, successor->branch_index);
+
+		if (*transition_count == 0) {
+			g_ptr_array_add (priv->seeds, build_seed (self, successor->parent, successor->branch_index));
+		}
+
+		(*transition_count)++;
+
+		/* Have we seen this configuration before? */
+		key.state = successor->state;
+		key.snapshot = successor->snapshot;
+		key.hash = successor->hash;
+
+		if (g_hash_table_lookup (priv->configurations, &key) != NULL) {
+			g_variant_unref (successor->snapshot);
+			continue;
+		} else if (max_configurations != 0 && g_hash_table_size (priv->configurations) >= max_configurations) {
+			priv->is_exhaustive = FALSE;
+			g_variant_unref (successor->snapshot);
+			continue;
+		}
+
+		configuration = configuration_new (successor->state, successor->snapshot, successor->hash, successor->parent,
+		                                   successor->branch_index);
+		add_configuration (self, configuration);
+		g_ptr_array_add (new_configurations, configuration);
+	}
+
+	g_array_set_size (successors, 0);
+}
+
+/* Return whether any branches lead out of @state, i.e. whether a configuration in @state could have successors. */
+static gboolean
+state_has_branches (DfsmExploration *self, DfsmMachineStateNumber state)
+{
+	GArray/*<Branch>*/ *branches = self->priv->branches;
+	guint i;
+
+	for (i = 0; i < branches->len; i++) {
+		if (g_array_index (branches, Branch, i).object_transition->from_state == state) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Expand every configuration in @frontier, splitting the frontier between as many workers as it's worth using. The first worker runs in this
+ * thread. */
+static void
+expand_frontier (ExplorationWorker *workers, guint num_workers, GPtrArray/*<Configuration>*/ *frontier)
+{
+	GThreadPool *pool = NULL;
+	guint i, num_used_workers, chunk_size;
+
+	num_used_workers = CLAMP (frontier->len / MIN_CONFIGURATIONS_PER_WORKER, 1, num_workers);
+	chunk_size = (frontier->len + num_used_workers - 1) / num_used_workers;
+
+	/* If the thread pool can't be created, fall back to expanding sequentially. */
+	if (num_used_workers > 1) {
+		pool = g_thread_pool_new ((GFunc) exploration_worker_thread_cb, NULL, num_used_workers - 1, FALSE, NULL);
+	}
+
+	for (i = 0; i < num_used_workers; i++) {
+		workers[i].frontier = frontier;
+		workers[i].frontier_start = MIN (i * chunk_size, frontier->len);
+		workers[i].frontier_end = MIN ((i + 1) * chunk_size, frontier->len);
+
+		if (i > 0 && pool != NULL) {
+			g_thread_pool_push (pool, &workers[i], NULL);
+		} else {
+			exploration_worker_thread_cb (&workers[i], NULL);
+		}
+	}
+
+	if (pool != NULL) {
+		/* Wait for the other workers to finish. */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+}
+
+/**
+ * dfsm_exploration_run:
+ * @self: a #DfsmExploration
+ * @order: the order to visit configurations in
+ * @max_depth: the maximum number of transitions to take from the starting state, or 0 for no limit
+ * @max_configurations: the maximum number of distinct configurations to visit, or 0 for no limit
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Explore the configurations of the machine, starting from its starting state with its environment at its reset point, and visiting configurations in
+ * the given @order until there are none left or the @max_depth or @max_configurations limits are reached. The machine itself is not modified. Any
+ * results from a previous run are discarded.
+ *
+ * Since machines with unbounded variables (such as counters) have an unbounded number of configurations, at least one of the limits should normally
+ * be given. dfsm_exploration_is_exhaustive() can be used afterwards to find out whether either limit was reached.
+ *
+ * If @cancellable is cancelled, the exploration stops at the next depth (when exploring breadth-first) or configuration (when exploring depth-first),
+ * %G_IO_ERROR_CANCELLED is returned, and the results are those of the partial exploration.
+ *
+ * Return value: %TRUE on success, %FALSE if the exploration was cancelled
+ */
+gboolean
+dfsm_exploration_run (DfsmExploration *self, DfsmExplorationOrder order, guint max_depth, guint max_configurations,
+                      GCancellable *cancellable, GError **error)
+{
+	DfsmExplorationPrivate *priv;
+	ExplorationWorker *workers;
+	guint i, num_workers;
+	GPtrArray/*<Configuration>*/ *pending, *new_configurations;
+	GVariant *snapshot;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), FALSE);
+	g_return_val_if_fail (order == DFSM_EXPLORATION_BREADTH_FIRST || order == DFSM_EXPLORATION_DEPTH_FIRST, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	priv = self->priv;
+
+	if (priv->branches == NULL) {
+		build_branches (self);
+	}
+
+	reset_results (self);
+
+	/* Depth-first exploration is inherently sequential; breadth-first exploration can expand each depth in parallel. */
+	num_workers = (order == DFSM_EXPLORATION_BREADTH_FIRST) ? MAX (g_get_num_processors (), 1) : 1;
+	workers = g_new (ExplorationWorker, num_workers);
+
+	for (i = 0; i < num_workers; i++) {
+		exploration_worker_init (&workers[i], priv->branches, dfsm_machine_get_environment (priv->machine));
+	}
+
+	/* The root configuration. The workers' environments start at the reset point. */
+	snapshot = dfsm_environment_save_snapshot (workers[0].environment);
+
+	pending = g_ptr_array_new ();
+	g_ptr_array_add (pending, configuration_new (DFSM_MACHINE_STARTING_STATE, snapshot,
+	                                             calculate_configuration_hash (DFSM_MACHINE_STARTING_STATE, snapshot), NULL, 0));
+	add_configuration (self, g_ptr_array_index (pending, 0));
+	new_configurations = g_ptr_array_new ();
+
+	while (pending->len > 0) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error) == TRUE) {
+			success = FALSE;
+			break;
+		}
+
+		if (order == DFSM_EXPLORATION_BREADTH_FIRST) {
+			GPtrArray/*<Configuration>*/ *frontier;
+
+			/* All the configurations in the frontier have the same depth. */
+			frontier = pending;
+			pending = new_configurations;
+
+			if (max_depth != 0 && ((Configuration*) g_ptr_array_index (frontier, 0))->depth >= max_depth) {
+				/* Don't expand the frontier. The exploration's only incomplete if some of the frontier could have been expanded. */
+				for (i = 0; i < frontier->len; i++) {
+					if (state_has_branches (self, ((Configuration*) g_ptr_array_index (frontier, i))->state) == TRUE) {
+						priv->is_exhaustive = FALSE;
+						break;
+					}
+				}
+			} else {
+				expand_frontier (workers, num_workers, frontier);
+
+				for (i = 0; i < num_workers; i++) {
+					merge_successors (self, workers[i].successors, max_configurations, pending);
+				}
+			}
+
+			g_ptr_array_set_size (frontier, 0);
+			new_configurations = frontier;
+		} else {
+			Configuration *configuration;
+
+			configuration = g_ptr_array_index (pending, pending->len - 1);
+			g_ptr_array_remove_index (pending, pending->len - 1);
+
+			if (max_depth != 0 && configuration->depth >= max_depth) {
+				if (state_has_branches (self, configuration->state) == TRUE) {
+					priv->is_exhaustive = FALSE;
+				}
+
+				continue;
+			}
+
+			expand_configuration (&workers[0], configuration);
+			merge_successors (self, workers[0].successors, max_configurations, new_configurations);
+
+			/* Push the successors in reverse so that the first one is explored first. */
+			for (i = new_configurations->len; i > 0; i--) {
+				g_ptr_array_add (pending, g_ptr_array_index (new_configurations, i - 1));
+			}
+
+			g_ptr_array_set_size (new_configurations, 0);
+		}
+	}
+
+	g_ptr_array_unref (new_configurations);
+	g_ptr_array_unref (pending);
+
+	for (i = 0; i < num_workers; i++) {
+		exploration_worker_clear (&workers[i]);
+	}
+
+	g_free (workers);
+
+	return success;
+}
+
+/**
+ * dfsm_exploration_get_machine:
+ * @self: a #DfsmExploration
+ *
+ * Gets the value of the #DfsmExploration:machine property.
+ *
+ * Return value: (transfer none): the machine being explored
+ */
+DfsmMachine *
+dfsm_exploration_get_machine (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), NULL);
+
+	return self->priv->machine;
+}
+
+/**
+ * dfsm_exploration_get_transitions:
+ * @self: a #DfsmExploration
+ *
+ * Gets all the transitions of the machine being explored, in the order used to index the array returned by
+ * dfsm_exploration_get_transition_coverage().
+ *
+ * Return value: (transfer none) (element-type DfsmAstObjectTransition): array of the machine's transitions
+ */
+GPtrArray/*<DfsmAstObjectTransition>*/ *
+dfsm_exploration_get_transitions (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), NULL);
+
+	return self->priv->transitions;
+}
+
+/**
+ * dfsm_exploration_get_num_configurations:
+ * @self: a #DfsmExploration
+ *
+ * Gets the number of distinct configurations visited by the last run, including the starting configuration.
+ *
+ * Return value: number of configurations visited
+ */
+guint
+dfsm_exploration_get_num_configurations (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), 0);
+
+	return g_hash_table_size (self->priv->configurations);
+}
+
+/**
+ * dfsm_exploration_get_depth:
+ * @self: a #DfsmExploration
+ *
+ * Gets the largest number of transitions taken from the starting state to reach any of the configurations visited by the last run. When exploring
+ * depth-first, this isn't necessarily the smallest number of transitions needed to reach that configuration.
+ *
+ * Return value: depth of the deepest configuration visited
+ */
+guint
+dfsm_exploration_get_depth (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), 0);
+
+	return self->priv->depth;
+}
+
+/**
+ * dfsm_exploration_is_exhaustive:
+ * @self: a #DfsmExploration
+ *
+ * Gets whether the last run visited every configuration reachable from the starting state, i.e. whether it finished without reaching its depth or
+ * configuration limits. If so, any state with no configurations in dfsm_exploration_get_state_coverage() and any transition which was never executed
+ * can't be reached with the default D-Bus inputs used by the exploration.
+ *
+ * Return value: %TRUE if the exploration was exhaustive, %FALSE otherwise
+ */
+gboolean
+dfsm_exploration_is_exhaustive (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), FALSE);
+
+	return self->priv->is_exhaustive;
+}
+
+/**
+ * dfsm_exploration_get_state_coverage:
+ * @self: a #DfsmExploration
+ *
+ * Gets the number of distinct configurations visited by the last run in each of the machine's states. A state with no configurations was never
+ * reached.
+ *
+ * Return value: (transfer none) (element-type guint): array of configuration counts, indexed by #DfsmMachineStateNumber
+ */
+GArray/*<guint>*/ *
+dfsm_exploration_get_state_coverage (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), NULL);
+
+	return self->priv->state_coverage;
+}
+
+/**
+ * dfsm_exploration_get_transition_coverage:
+ * @self: a #DfsmExploration
+ *
+ * Gets the number of times each of the machine's transitions was executed by the last run. A transition which was executed zero times was never found
+ * with its preconditions satisfied.
+ *
+ * Return value: (transfer none) (element-type guint): array of execution counts, indexed as for dfsm_exploration_get_transitions()
+ */
+GArray/*<guint>*/ *
+dfsm_exploration_get_transition_coverage (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), NULL);
+
+	return self->priv->transition_coverage;
+}
+
+/**
+ * dfsm_exploration_get_seeds:
+ * @self: a #DfsmExploration
+ *
+ * Gets the seed sequences found by the last run. For each transition which was executed, there is one seed: the sequence of transitions which first
+ * executed it, starting from the starting state. When exploring breadth-first, this is one of the shortest such sequences. Seeds are in the order
+ * they were found.
+ *
+ * Executing a seed's transitions in order (with default D-Bus inputs and fuzzing disabled) on a freshly reset machine will reproduce the path taken
+ * by the exploration, making seeds suitable for priming a fuzzer with paths to every part of the machine the exploration reached.
+ *
+ * Return value: (transfer none) (element-type GPtrArray): array of seeds, each of which is an array of #DfsmAstObjectTransition<!-- -->s
+ */
+GPtrArray/*<GPtrArray<DfsmAstObjectTransition>>*/ *
+dfsm_exploration_get_seeds (DfsmExploration *self)
+{
+	g_return_val_if_fail (DFSM_IS_EXPLORATION (self), NULL);
+
+	return self->priv->seeds;
+}
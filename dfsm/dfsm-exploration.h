@@ -0,0 +1,95 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DFSM_EXPLORATION_H
+#define DFSM_EXPLORATION_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "dfsm-machine.h"
+
+G_BEGIN_DECLS
+
+/**
+ * DfsmExplorationOrder:
+ * @DFSM_EXPLORATION_BREADTH_FIRST: explore all the configurations at one depth before moving on to the next; this finds the shortest transition
+ * sequence to each configuration, and spreads each depth across several threads
+ * @DFSM_EXPLORATION_DEPTH_FIRST: follow each sequence of transitions as deep as possible before backtracking; this uses a single thread, but reaches
+ * deep configurations sooner if the number of configurations is limited
+ *
+ * The order in which a #DfsmExploration visits the configurations of a #DfsmMachine.
+ */
+typedef enum {
+	DFSM_EXPLORATION_BREADTH_FIRST = 0,
+	DFSM_EXPLORATION_DEPTH_FIRST,
+} DfsmExplorationOrder;
+
+#define DFSM_TYPE_EXPLORATION		(dfsm_exploration_get_type ())
+#define DFSM_EXPLORATION(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), DFSM_TYPE_EXPLORATION, DfsmExploration))
+#define DFSM_EXPLORATION_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), DFSM_TYPE_EXPLORATION, DfsmExplorationClass))
+#define DFSM_IS_EXPLORATION(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), DFSM_TYPE_EXPLORATION))
+#define DFSM_IS_EXPLORATION_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), DFSM_TYPE_EXPLORATION))
+#define DFSM_EXPLORATION_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), DFSM_TYPE_EXPLORATION, DfsmExplorationClass))
+
+typedef struct _DfsmExplorationPrivate	DfsmExplorationPrivate;
+
+/**
+ * DfsmExploration:
+ *
+ * All the fields in the #DfsmExploration structure are private and should never be accessed directly.
+ */
+typedef struct {
+	GObject parent;
+	DfsmExplorationPrivate *priv;
+} DfsmExploration;
+
+/**
+ * DfsmExplorationClass:
+ *
+ * All the fields in the #DfsmExplorationClass structure are private and should never be accessed directly.
+ */
+typedef struct {
+	/*< private >*/
+	GObjectClass parent;
+} DfsmExplorationClass;
+
+GType dfsm_exploration_get_type (void) G_GNUC_CONST;
+
+DfsmExploration *dfsm_exploration_new (DfsmMachine *machine) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+gboolean dfsm_exploration_run (DfsmExploration *self, DfsmExplorationOrder order, guint max_depth, guint max_configurations,
+                               GCancellable *cancellable, GError **error);
+
+DfsmMachine *dfsm_exploration_get_machine (DfsmExploration *self) G_GNUC_PURE;
+GPtrArray/*<DfsmAstObjectTransition>*/ *dfsm_exploration_get_transitions (DfsmExploration *self) G_GNUC_PURE;
+
+guint dfsm_exploration_get_num_configurations (DfsmExploration *self) G_GNUC_PURE;
+guint dfsm_exploration_get_depth (DfsmExploration *self) G_GNUC_PURE;
+gboolean dfsm_exploration_is_exhaustive (DfsmExploration *self) G_GNUC_PURE;
+
+GArray/*<guint>*/ *dfsm_exploration_get_state_coverage (DfsmExploration *self) G_GNUC_PURE;
+GArray/*<guint>*/ *dfsm_exploration_get_transition_coverage (DfsmExploration *self) G_GNUC_PURE;
+GPtrArray/*<GPtrArray<DfsmAstObjectTransition>>*/ *dfsm_exploration_get_seeds (DfsmExploration *self) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DFSM_EXPLORATION_H */
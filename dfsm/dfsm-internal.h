@@ -20,6 +20,11 @@
 #include <glib.h>
 #include <gio/gio.h>
 
+#include "dfsm-ast-transition.h"
+#include "dfsm-dbus-output-sequence.h"
+#include "dfsm-environment.h"
+#include "dfsm-scheduler.h"
+#include "dfsm-trace.h"
 #include "dfsm-utils.h"
 
 #ifndef DFSM_INTERNAL_H
@@ -29,6 +34,62 @@ G_BEGIN_DECLS
 
 G_GNUC_INTERNAL GVariantType *dfsm_internal_dbus_arg_info_array_to_variant_type (const GDBusArgInfo **args) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
+G_GNUC_INTERNAL void dfsm_internal_dbus_output_sequence_reset (DfsmDBusOutputSequence *self, GDBusMethodInvocation *invocation,
+                                                               GDBusMessage *method_call_message);
+G_GNUC_INTERNAL GDBusConnection *dfsm_internal_dbus_output_sequence_get_connection (DfsmDBusOutputSequence *self) G_GNUC_PURE;
+
+/* Called when an instantiation (or destruction, if @destroy is %TRUE) of the object instance at @object_path is output. */
+typedef void (*DfsmInstanceFunc) (const gchar *object_path, gboolean destroy, gpointer user_data);
+
+G_GNUC_INTERNAL void dfsm_internal_dbus_output_sequence_set_instance_func (DfsmDBusOutputSequence *self, DfsmInstanceFunc func,
+                                                                           gpointer user_data);
+
+G_GNUC_INTERNAL void dfsm_internal_trace (DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail);
+
+G_GNUC_INTERNAL gboolean dfsm_internal_solve_preconditions (DfsmAstTransition *transition, DfsmEnvironment *environment);
+
+typedef void (*DfsmSchedulerFunc) (gpointer user_data);
+
+/* An entry in the arbitrary transition scheduler's timer heap. These are embedded in the structures of the things being scheduled, so that
+ * (re)scheduling doesn't allocate. All the fields are private to dfsm-scheduler.c. */
+typedef struct {
+	gint64 due_time; /* monotonic time, in microseconds */
+	guint64 sequence; /* order in which the entry was scheduled, to break ties between equal due times */
+	guint heap_index; /* index of the entry in the heap plus one, or 0 if the entry isn't scheduled */
+	guint64 num_ticks; /* number of times the entry has fired since it was initialised */
+	DfsmSchedulerFunc func;
+	gpointer user_data;
+} DfsmSchedulerEntry;
+
+G_GNUC_INTERNAL void dfsm_internal_scheduler_entry_init (DfsmSchedulerEntry *entry, DfsmSchedulerFunc func, gpointer user_data);
+G_GNUC_INTERNAL void dfsm_internal_scheduler_add (DfsmSchedulerEntry *entry, guint timeout_period);
+G_GNUC_INTERNAL void dfsm_internal_scheduler_remove (DfsmSchedulerEntry *entry);
+G_GNUC_INTERNAL gboolean dfsm_internal_scheduler_entry_is_scheduled (const DfsmSchedulerEntry *entry) G_GNUC_PURE;
+
+typedef struct _DfsmArenaChunk DfsmArenaChunk;
+
+/* A bump allocator for temporaries which only live for the duration of a single dispatch (such as fuzzed strings), so they don't each need a trip
+ * to the system allocator. Anything which outlives the dispatch (for example, by being stored in the environment or sent on the bus) must be copied
+ * out of the arena first. All the fields are private to dfsm-arena.c. Not thread safe. */
+typedef struct {
+	DfsmArenaChunk *chunks; /* most recently allocated first */
+	gsize bytes_in_use; /* bytes allocated since the last reset */
+	gsize next_chunk_size; /* size of the next chunk to allocate, unless a larger allocation is needed */
+	DfsmArenaStatistics statistics;
+} DfsmArena;
+
+G_GNUC_INTERNAL void dfsm_internal_arena_init (DfsmArena *arena);
+G_GNUC_INTERNAL void dfsm_internal_arena_clear (DfsmArena *arena);
+G_GNUC_INTERNAL gpointer dfsm_internal_arena_alloc (DfsmArena *arena, gsize size) G_GNUC_MALLOC G_GNUC_ALLOC_SIZE(2);
+G_GNUC_INTERNAL gchar *dfsm_internal_arena_strdup (DfsmArena *arena, const gchar *str) G_GNUC_MALLOC;
+G_GNUC_INTERNAL gchar *dfsm_internal_arena_strndup (DfsmArena *arena, const gchar *str, gsize length) G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_internal_arena_reset (DfsmArena *arena);
+
+G_GNUC_INTERNAL DfsmArena *dfsm_internal_environment_get_arena (DfsmEnvironment *self) G_GNUC_PURE;
+G_GNUC_INTERNAL gboolean dfsm_internal_environment_get_fuzzing_enabled (DfsmEnvironment *self) G_GNUC_PURE;
+G_GNUC_INTERNAL void dfsm_internal_environment_set_fuzzing_enabled (DfsmEnvironment *self, gboolean enable);
+G_GNUC_INTERNAL GRand *dfsm_internal_environment_get_rand (DfsmEnvironment *self);
+
 G_END_DECLS
 
 #endif /* !DFSM_INTERNAL_H */
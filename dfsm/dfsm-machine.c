@@ -29,13 +29,16 @@
 
 #include "config.h"
 
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
 #include "dfsm-ast.h"
 #include "dfsm-environment.h"
+#include "dfsm-internal.h"
 #include "dfsm-machine.h"
 #include "dfsm/dfsm-marshal.h"
 #include "dfsm-output-sequence.h"
@@ -50,10 +53,45 @@ static void dfsm_machine_set_gobject_property (GObject *object, guint property_i
 static gboolean dfsm_machine_check_transition_default (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state,
                                                        DfsmAstTransition *transition, const gchar *nickname);
 
+static DfsmStateReachability *build_transition_matrix (DfsmMachine *self);
+
+#define TRANSITION_MATRIX_ASSIGN(M, S, F, T) \
+	g_assert ((F) < (S)); \
+	g_assert ((T) < (S)); \
+	TRANSITION_MATRIX_INDEX(M, S, F, T)
+#define TRANSITION_MATRIX_INDEX(M, S, F, T) M[(S) * (F) + (T)]
+
+/* Maximum number of transitions remembered for dfsm_machine_reward_recent_transitions(). */
+#define MAX_RECENT_TRANSITIONS 64
+
+/* Maximum weight a transition can be given by dfsm_machine_reward_recent_transitions(), relative to the default weight of 1. This stops one
+ * transition crowding out all the others. */
+#define MAX_TRANSITION_WEIGHT 64.0
+
 struct _DfsmMachinePrivate {
 	/* Simulation data */
 	DfsmMachineStateNumber machine_state;
 	DfsmEnvironment *environment;
+	guint transition_count; /* number of transitions executed since the machine was created */
+	guint property_snapshot_serial; /* object serial of the environment when property_snapshot_values was taken */
+	GPtrArray/*<GVariant>*/ *property_snapshot_values; /* cached by snapshot_properties(); NULL until the first snapshot */
+
+	/* Directed mode; see dfsm_machine_set_target_state() */
+	DfsmMachineStateNumber target_state; /* DFSM_MACHINE_INVALID_STATE if not in directed mode */
+	gboolean target_reached;
+	DfsmStateReachability *transition_matrix; /* built lazily; num_states × num_states */
+	gboolean *blocked_edges; /* num_states × num_states; edges whose transitions all failed their preconditions during the current choice */
+	guint num_blocked_edges;
+	guint *target_distances; /* (indexed by DfsmMachineStateNumber) length of the shortest path to the target state, or G_MAXUINT; built lazily */
+
+	/* Precondition solving; see dfsm_machine_set_solve_preconditions() */
+	gboolean solve_preconditions;
+	GHashTable/*<DfsmAstObjectTransition>*/ *executed_transitions; /* set of transitions executed since solving was enabled; NULL if disabled */
+
+	/* Transition feedback; see dfsm_machine_reward_recent_transitions() */
+	gboolean transition_feedback;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *recent_transitions; /* unowned; executed since the last reward; NULL if feedback is disabled */
+	GHashTable/*<DfsmAstObjectTransition, gdouble>*/ *transition_weights; /* NULL until a transition is first rewarded */
 
 	/* Static data */
 	GPtrArray/*<string>*/ *state_names; /* (indexed by DfsmMachineStateNumber) */
@@ -67,10 +105,15 @@ struct _DfsmMachinePrivate {
 enum {
 	PROP_MACHINE_STATE = 1,
 	PROP_ENVIRONMENT,
+	PROP_TARGET_STATE,
+	PROP_TARGET_REACHED,
+	PROP_SOLVE_PRECONDITIONS,
+	PROP_TRANSITION_FEEDBACK,
 };
 
 enum {
 	SIGNAL_CHECK_TRANSITION,
+	SIGNAL_TRANSITION_EXECUTED,
 	LAST_SIGNAL,
 };
 
@@ -113,6 +156,54 @@ dfsm_machine_class_init (DfsmMachineClass *klass)
 	                                                      DFSM_TYPE_ENVIRONMENT,
 	                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+	/**
+	 * DfsmMachine:target-state:
+	 *
+	 * The index of the state the machine is being driven towards, or %DFSM_MACHINE_INVALID_STATE if it's not being driven anywhere. See
+	 * dfsm_machine_set_target_state().
+	 */
+	g_object_class_install_property (gobject_class, PROP_TARGET_STATE,
+	                                 g_param_spec_uint ("target-state",
+	                                                    "Target state", "The index of the state the machine is being driven towards.",
+	                                                    0, G_MAXUINT, DFSM_MACHINE_INVALID_STATE,
+	                                                    G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * DfsmMachine:target-reached:
+	 *
+	 * Whether the machine has reached its #DfsmMachine:target-state since the target was last set or the machine was last reset. This is always
+	 * %FALSE if there is no target state.
+	 */
+	g_object_class_install_property (gobject_class, PROP_TARGET_REACHED,
+	                                 g_param_spec_boolean ("target-reached",
+	                                                       "Target reached?", "Whether the machine has reached its target state.",
+	                                                       FALSE,
+	                                                       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * DfsmMachine:solve-preconditions:
+	 *
+	 * Whether to search for object variable values which satisfy the preconditions of arbitrary transitions which haven't been executed yet. See
+	 * dfsm_machine_set_solve_preconditions().
+	 */
+	g_object_class_install_property (gobject_class, PROP_SOLVE_PRECONDITIONS,
+	                                 g_param_spec_boolean ("solve-preconditions",
+	                                                       "Solve preconditions?", "Whether to search for values which satisfy preconditions.",
+	                                                       FALSE,
+	                                                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * DfsmMachine:transition-feedback:
+	 *
+	 * Whether to keep track of the transitions executed since dfsm_machine_reward_recent_transitions() was last called, so that they can be
+	 * rewarded. See dfsm_machine_set_transition_feedback().
+	 */
+	g_object_class_install_property (gobject_class, PROP_TRANSITION_FEEDBACK,
+	                                 g_param_spec_boolean ("transition-feedback",
+	                                                       "Transition feedback?", "Whether to track transitions for rewarding.",
+	                                                       FALSE,
+	                                                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
 	/**
 	 * DfsmMachine::check-transition:
 	 *
@@ -125,6 +216,26 @@ dfsm_machine_class_init (DfsmMachineClass *klass)
 	                                                         g_signal_accumulator_first_wins, NULL,
 	                                                         dfsm_marshal_BOOLEAN__UINT_UINT_OBJECT_STRING,
 	                                                         G_TYPE_BOOLEAN, 4, G_TYPE_UINT, G_TYPE_UINT, DFSM_TYPE_AST_TRANSITION, G_TYPE_STRING);
+
+	/**
+	 * DfsmMachine::transition-executed:
+	 * @from_state: the state the transition was executed from
+	 * @to_state: the state the transition leads to (which the machine won't have changed to if the transition threw an error)
+	 * @transition: the transition which was executed
+	 * @nickname: (allow-none): the transition's nickname, or %NULL
+	 *
+	 * Emitted after each transition has been executed, but before its effects on the bus have been output, and before it's remembered for
+	 * dfsm_machine_reward_recent_transitions(). Calling dfsm_machine_reward_recent_transitions() from a handler therefore rewards only the
+	 * transitions executed before this one, whose effects the program under test has had a chance to react to. This makes the signal suitable
+	 * for driving a feedback loop which samples the program under test after every transition.
+	 *
+	 * This is emitted in the thread which executed the transition.
+	 */
+	machine_signals[SIGNAL_TRANSITION_EXECUTED] = g_signal_new ("transition-executed",
+	                                                            G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+	                                                            0, NULL, NULL,
+	                                                            dfsm_marshal_VOID__UINT_UINT_OBJECT_STRING,
+	                                                            G_TYPE_NONE, 4, G_TYPE_UINT, G_TYPE_UINT, DFSM_TYPE_AST_TRANSITION, G_TYPE_STRING);
 }
 
 static void
@@ -132,6 +243,7 @@ dfsm_machine_init (DfsmMachine *self)
 {
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DFSM_TYPE_MACHINE, DfsmMachinePrivate);
 	self->priv->machine_state = DFSM_MACHINE_STARTING_STATE;
+	self->priv->target_state = DFSM_MACHINE_INVALID_STATE;
 }
 
 static void
@@ -145,6 +257,11 @@ dfsm_machine_dispose (GObject *object)
 		priv->environment = NULL;
 	}
 
+	if (priv->property_snapshot_values != NULL) {
+		g_ptr_array_unref (priv->property_snapshot_values);
+		priv->property_snapshot_values = NULL;
+	}
+
 	if (priv->state_names != NULL) {
 		g_ptr_array_unref (priv->state_names);
 		priv->state_names = NULL;
@@ -165,6 +282,28 @@ dfsm_machine_dispose (GObject *object)
 		priv->transitions.arbitrarily_triggered = NULL;
 	}
 
+	g_free (priv->transition_matrix);
+	priv->transition_matrix = NULL;
+	g_free (priv->blocked_edges);
+	priv->blocked_edges = NULL;
+	g_free (priv->target_distances);
+	priv->target_distances = NULL;
+
+	if (priv->executed_transitions != NULL) {
+		g_hash_table_unref (priv->executed_transitions);
+		priv->executed_transitions = NULL;
+	}
+
+	if (priv->recent_transitions != NULL) {
+		g_ptr_array_unref (priv->recent_transitions);
+		priv->recent_transitions = NULL;
+	}
+
+	if (priv->transition_weights != NULL) {
+		g_hash_table_unref (priv->transition_weights);
+		priv->transition_weights = NULL;
+	}
+
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_machine_parent_class)->dispose (object);
 }
@@ -181,6 +320,18 @@ dfsm_machine_get_gobject_property (GObject *object, guint property_id, GValue *v
 		case PROP_ENVIRONMENT:
 			g_value_set_object (value, priv->environment);
 			break;
+		case PROP_TARGET_STATE:
+			g_value_set_uint (value, priv->target_state);
+			break;
+		case PROP_TARGET_REACHED:
+			g_value_set_boolean (value, priv->target_reached);
+			break;
+		case PROP_SOLVE_PRECONDITIONS:
+			g_value_set_boolean (value, priv->solve_preconditions);
+			break;
+		case PROP_TRANSITION_FEEDBACK:
+			g_value_set_boolean (value, priv->transition_feedback);
+			break;
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -199,7 +350,17 @@ dfsm_machine_set_gobject_property (GObject *object, guint property_id, const GVa
 			priv->environment = g_value_dup_object (value);
 			dfsm_environment_save_reset_point (priv->environment);
 			break;
+		case PROP_TARGET_STATE:
+			dfsm_machine_set_target_state (DFSM_MACHINE (object), g_value_get_uint (value));
+			break;
+		case PROP_SOLVE_PRECONDITIONS:
+			dfsm_machine_set_solve_preconditions (DFSM_MACHINE (object), g_value_get_boolean (value));
+			break;
+		case PROP_TRANSITION_FEEDBACK:
+			dfsm_machine_set_transition_feedback (DFSM_MACHINE (object), g_value_get_boolean (value));
+			break;
 		case PROP_MACHINE_STATE:
+		case PROP_TARGET_REACHED:
 			/* Read-only */
 		default:
 			/* We don't have any other property... */
@@ -214,20 +375,198 @@ get_state_name (DfsmMachine *self, DfsmMachineStateNumber state_number)
 	return (const gchar*) g_ptr_array_index (self->priv->state_names, state_number);
 }
 
-/* Return value: whether the machine changed state */
+static void
+set_target_reached (DfsmMachine *self, gboolean target_reached)
+{
+	if (self->priv->target_reached != target_reached) {
+		self->priv->target_reached = target_reached;
+		g_object_notify (G_OBJECT (self), "target-reached");
+	}
+}
+
+/* Values of the object's property-backing variables as of a given object serial, so add_property_changes() can tell which properties have actually
+ * changed (rather than just been written). */
+typedef struct {
+	guint serial;
+	GPtrArray/*<GVariant>*/ *values; /* one entry per property, in interface then property order; NULL entries for unbacked properties */
+} PropertySnapshot;
+
+static void
+variant_unref_if_set (GVariant *variant)
+{
+	if (variant != NULL) {
+		g_variant_unref (variant);
+	}
+}
+
+/* Take a snapshot of the current values of all the object's properties into @snapshot. The values are only referenced, not copied. The snapshot must
+ * be passed to add_property_changes() to free it.
+ *
+ * Most dispatches don't write to any object variables, so the last snapshot taken is cached and shared until the environment's object serial
+ * changes. */
+static void
+snapshot_properties (DfsmMachine *self, PropertySnapshot *snapshot)
+{
+	DfsmMachinePrivate *priv = self->priv;
+	GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces;
+	guint serial, i, j;
+
+	serial = dfsm_environment_get_serial (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT);
+
+	if (priv->property_snapshot_values != NULL && priv->property_snapshot_serial == serial) {
+		goto done;
+	}
+
+	if (priv->property_snapshot_values != NULL) {
+		g_ptr_array_unref (priv->property_snapshot_values);
+	}
+
+	priv->property_snapshot_serial = serial;
+	priv->property_snapshot_values = g_ptr_array_new_with_free_func ((GDestroyNotify) variant_unref_if_set);
+
+	interfaces = dfsm_environment_get_interfaces (priv->environment);
+
+	for (i = 0; i < interfaces->len; i++) {
+		GDBusInterfaceInfo *interface_info = g_ptr_array_index (interfaces, i);
+
+		for (j = 0; interface_info->properties != NULL && interface_info->properties[j] != NULL; j++) {
+			const gchar *property_name = interface_info->properties[j]->name;
+			GVariant *value = NULL;
+
+			if (dfsm_environment_has_variable (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT, property_name) == TRUE) {
+				value = dfsm_environment_dup_variable_value (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT, property_name);
+			}
+
+			g_ptr_array_add (priv->property_snapshot_values, value);
+		}
+	}
+
+done:
+	snapshot->serial = serial;
+	snapshot->values = g_ptr_array_ref (priv->property_snapshot_values);
+}
+
+/* Add a change notification to @output_sequence for each property whose backing object variable has been written since @snapshot was taken, and
+ * whose value differs from the one in @snapshot. Properties annotated with org.freedesktop.DBus.Property.EmitsChangedSignal (or on an interface
+ * annotated with it) are handled according to the annotation: ‘invalidates’ properties are only invalidated, and ‘const’ and ‘false’ properties are
+ * skipped. @snapshot is freed. */
+static void
+add_property_changes (DfsmMachine *self, DfsmOutputSequence *output_sequence, PropertySnapshot *snapshot)
+{
+	DfsmMachinePrivate *priv = self->priv;
+	GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces;
+	guint i, j, k;
+
+	/* Fast path: nothing's been written. */
+	if (dfsm_environment_get_serial (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT) == snapshot->serial) {
+		goto done;
+	}
+
+	interfaces = dfsm_environment_get_interfaces (priv->environment);
+
+	for (i = 0, k = 0; i < interfaces->len; i++) {
+		GDBusInterfaceInfo *interface_info = g_ptr_array_index (interfaces, i);
+		const gchar *interface_emits_changed_signal;
+
+		if (interface_info->properties == NULL) {
+			continue;
+		}
+
+		interface_emits_changed_signal = g_dbus_annotation_info_lookup (interface_info->annotations,
+		                                                                "org.freedesktop.DBus.Property.EmitsChangedSignal");
+
+		for (j = 0; interface_info->properties[j] != NULL; j++, k++) {
+			GDBusPropertyInfo *property_info = interface_info->properties[j];
+			const gchar *emits_changed_signal;
+			GVariant *old_value, *value;
+
+			if (dfsm_environment_has_variable (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT, property_info->name) == FALSE ||
+			    dfsm_environment_get_variable_serial (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT,
+			                                          property_info->name) <= snapshot->serial) {
+				continue;
+			}
+
+			emits_changed_signal = g_dbus_annotation_info_lookup (property_info->annotations,
+			                                                      "org.freedesktop.DBus.Property.EmitsChangedSignal");
+			if (emits_changed_signal == NULL) {
+				emits_changed_signal = interface_emits_changed_signal;
+			}
+
+			if (g_strcmp0 (emits_changed_signal, "false") == 0 || g_strcmp0 (emits_changed_signal, "const") == 0) {
+				continue;
+			}
+
+			/* The variable's been written, but may have been written with its existing value. */
+			g_assert (k < snapshot->values->len);
+			old_value = g_ptr_array_index (snapshot->values, k);
+			value = dfsm_environment_dup_variable_value (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT, property_info->name);
+
+			if (old_value == NULL || g_variant_equal (old_value, value) == FALSE) {
+				gboolean invalidate_only = (g_strcmp0 (emits_changed_signal, "invalidates") == 0) ? TRUE : FALSE;
+
+				dfsm_output_sequence_add_property_change (output_sequence, interface_info->name, property_info->name,
+				                                          (invalidate_only == TRUE) ? NULL : value);
+			}
+
+			g_variant_unref (value);
+		}
+	}
+
+done:
+	g_ptr_array_unref (snapshot->values);
+	snapshot->values = NULL;
+}
+
+/* If @snapshot is non-NULL, property changes are notified relative to it (and it's freed); otherwise they're notified relative to the property values
+ * before the transition was executed.
+ *
+ * Return value: whether the machine changed state */
 static gboolean
-execute_transition (DfsmMachine *self, DfsmAstObjectTransition *object_transition, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing)
+execute_transition (DfsmMachine *self, DfsmAstObjectTransition *object_transition, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing,
+                    PropertySnapshot *snapshot)
 {
 	DfsmMachinePrivate *priv = self->priv;
-	gchar *friendly_transition_name;
+	const gchar *friendly_transition_name;
+	PropertySnapshot transition_snapshot;
 
-	friendly_transition_name = dfsm_ast_object_transition_build_friendly_name (object_transition);
+	friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (object_transition);
 	g_debug ("…Executing transition %s from ‘%s’ to ‘%s’.", friendly_transition_name, get_state_name (self, object_transition->from_state),
 	         get_state_name (self, object_transition->to_state));
-	g_free (friendly_transition_name);
 
-	dfsm_ast_data_structure_set_fuzzing_enabled (enable_fuzzing);
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "transition", friendly_transition_name, get_state_name (self, object_transition->to_state));
+
+	if (snapshot == NULL) {
+		snapshot_properties (self, &transition_snapshot);
+		snapshot = &transition_snapshot;
+	}
+
+	dfsm_internal_environment_set_fuzzing_enabled (priv->environment, enable_fuzzing);
 	dfsm_ast_transition_execute (object_transition->transition, priv->environment, output_sequence);
+	priv->transition_count++;
+
+	if (priv->executed_transitions != NULL) {
+		g_hash_table_add (priv->executed_transitions, object_transition);
+	}
+
+	/* This isn't a detailed signal, since looking up the detail's quark for every transition would be too costly. */
+	if (g_signal_has_handler_pending (self, machine_signals[SIGNAL_TRANSITION_EXECUTED], 0, TRUE) == TRUE) {
+		g_signal_emit (self, machine_signals[SIGNAL_TRANSITION_EXECUTED], 0, object_transition->from_state, object_transition->to_state,
+		               object_transition->transition, object_transition->nickname);
+	}
+
+	if (priv->recent_transitions != NULL) {
+		/* Forget the oldest transition if nobody's been rewarding them, so the window doesn't grow without bound. */
+		if (priv->recent_transitions->len >= MAX_RECENT_TRANSITIONS) {
+			g_ptr_array_remove_index (priv->recent_transitions, 0);
+		}
+
+		g_ptr_array_add (priv->recent_transitions, object_transition);
+	}
+
+	/* Notify of any properties the transition changed. */
+	add_property_changes (self, output_sequence, snapshot);
+
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "transition", friendly_transition_name, get_state_name (self, object_transition->to_state));
 
 	/* Various possibilities for return values. */
 	if (dfsm_ast_transition_contains_throw_statement (object_transition->transition) == FALSE) {
@@ -238,6 +577,12 @@ execute_transition (DfsmMachine *self, DfsmAstObjectTransition *object_transitio
 		priv->machine_state = object_transition->to_state;
 		g_object_notify (G_OBJECT (self), "machine-state");
 
+		/* Once we've reached the target state, we leave directed mode and go back to choosing transitions randomly. */
+		if (priv->machine_state == priv->target_state && priv->target_reached == FALSE) {
+			g_debug ("…Reached target state ‘%s’. Reverting to random transitions.", get_state_name (self, priv->target_state));
+			set_target_reached (self, TRUE);
+		}
+
 		return TRUE;
 	} else {
 		/* A ‘throw’ statement was executed. Don't change states. */
@@ -255,14 +600,220 @@ dfsm_machine_check_transition_default (DfsmMachine *machine, DfsmMachineStateNum
 	return TRUE;
 }
 
+/* Recalculate the length of the shortest path from each state to the target state, using a breadth-first search backwards from the target along the
+ * edges of the transition matrix which aren't blocked. The next hop out of a state s is then any state t with an unblocked edge from s and
+ * distance[t] == distance[s] - 1. */
+static void
+update_target_distances (DfsmMachine *self)
+{
+	DfsmMachinePrivate *priv = self->priv;
+	GQueue/*<DfsmMachineStateNumber>*/ queue = G_QUEUE_INIT;
+	DfsmMachineStateNumber i;
+	guint num_states;
+
+	num_states = priv->state_names->len;
+
+	for (i = 0; i < num_states; i++) {
+		priv->target_distances[i] = G_MAXUINT;
+	}
+
+	priv->target_distances[priv->target_state] = 0;
+	g_queue_push_tail (&queue, GUINT_TO_POINTER (priv->target_state));
+
+	while (g_queue_is_empty (&queue) == FALSE) {
+		DfsmMachineStateNumber to_state = GPOINTER_TO_UINT (g_queue_pop_head (&queue));
+
+		for (i = 0; i < num_states; i++) {
+			if (priv->target_distances[i] != G_MAXUINT ||
+			    TRANSITION_MATRIX_INDEX (priv->transition_matrix, num_states, i, to_state) == DFSM_STATE_UNREACHABLE ||
+			    TRANSITION_MATRIX_INDEX (priv->blocked_edges, num_states, i, to_state) == TRUE) {
+				continue;
+			}
+
+			priv->target_distances[i] = priv->target_distances[to_state] + 1;
+			g_queue_push_tail (&queue, GUINT_TO_POINTER (i));
+		}
+	}
+}
+
+/* In directed mode, try to execute a transition from @possible_transitions which lies on a shortest path from the current state to the target state.
+ * If all the transitions along the next hops fail their preconditions, those edges are blocked for the rest of this choice and the shortest paths are
+ * recalculated around them, until either a transition is executed or there are no paths left. Edges are only blocked once all the transitions along
+ * them have been tried, since there may be several parallel transitions with different preconditions.
+ *
+ * Return value: %TRUE if a transition was executed, %FALSE otherwise */
+static gboolean
+find_and_execute_directed_transition (DfsmMachine *self, DfsmOutputSequence *output_sequence,
+                                      GPtrArray/*<DfsmAstObjectTransition>*/ *possible_transitions, gboolean enable_fuzzing)
+{
+	DfsmMachinePrivate *priv = self->priv;
+	guint i, rand_offset, num_states;
+	GArray/*<DfsmMachineStateNumber>*/ *failed_to_states;
+	gboolean executed = FALSE;
+
+	num_states = priv->state_names->len;
+
+	/* Lazily build the transition matrix and shortest paths. Edges blocked during the previous choice are unblocked again, as the environment
+	 * may have changed in the meantime. */
+	if (priv->transition_matrix == NULL) {
+		priv->transition_matrix = build_transition_matrix (self);
+		priv->blocked_edges = g_new0 (gboolean, num_states * num_states);
+	}
+
+	if (priv->num_blocked_edges > 0) {
+		memset (priv->blocked_edges, 0, sizeof (gboolean) * num_states * num_states);
+		priv->num_blocked_edges = 0;
+
+		if (priv->target_distances != NULL) {
+			update_target_distances (self);
+		}
+	}
+
+	if (priv->target_distances == NULL) {
+		priv->target_distances = g_new (guint, num_states);
+		update_target_distances (self);
+	}
+
+	failed_to_states = g_array_new (FALSE, FALSE, sizeof (DfsmMachineStateNumber));
+
+	do {
+		guint current_distance = priv->target_distances[priv->machine_state];
+
+		/* The target is unreachable from here, at least without the blocked edges. */
+		if (current_distance == G_MAXUINT) {
+			g_debug ("…No path from ‘%s’ to target state ‘%s’.", get_state_name (self, priv->machine_state),
+			         get_state_name (self, priv->target_state));
+			break;
+		}
+
+		g_assert (current_distance > 0);
+		g_array_set_size (failed_to_states, 0);
+		rand_offset = g_rand_int_range (dfsm_internal_environment_get_rand (priv->environment), 0, possible_transitions->len);
+
+		for (i = 0; i < possible_transitions->len; i++) {
+			DfsmAstObjectTransition *object_transition;
+			gboolean transition_is_executable = FALSE;
+
+			object_transition = g_ptr_array_index (possible_transitions, (i + rand_offset) % possible_transitions->len);
+
+			/* Only consider transitions along the next hop which will actually change state. */
+			if (object_transition->from_state != priv->machine_state ||
+			    priv->target_distances[object_transition->to_state] != current_distance - 1 ||
+			    TRANSITION_MATRIX_INDEX (priv->blocked_edges, num_states, priv->machine_state, object_transition->to_state) == TRUE ||
+			    dfsm_ast_transition_contains_throw_statement (object_transition->transition) == TRUE) {
+				continue;
+			}
+
+			g_signal_emit (self, machine_signals[SIGNAL_CHECK_TRANSITION], g_quark_from_string (object_transition->nickname),
+			               object_transition->from_state, object_transition->to_state, object_transition->transition,
+			               object_transition->nickname, &transition_is_executable);
+
+			if (transition_is_executable == FALSE) {
+				continue;
+			}
+
+			if (dfsm_ast_transition_check_preconditions (object_transition->transition, priv->environment, NULL, NULL) == TRUE) {
+				g_debug ("…Taking transition %s towards target state ‘%s’ (%u transitions away).",
+				         dfsm_ast_object_transition_get_friendly_name (object_transition), get_state_name (self, priv->target_state),
+				         current_distance);
+
+				execute_transition (self, object_transition, output_sequence, enable_fuzzing, NULL);
+				executed = TRUE;
+
+				break;
+			}
+
+			g_array_append_val (failed_to_states, object_transition->to_state);
+		}
+
+		/* None of the transitions along the failed edges had their preconditions satisfied, so block the edges and recalculate the paths. */
+		for (i = 0; executed == FALSE && i < failed_to_states->len; i++) {
+			DfsmMachineStateNumber to_state = g_array_index (failed_to_states, DfsmMachineStateNumber, i);
+
+			if (TRANSITION_MATRIX_INDEX (priv->blocked_edges, num_states, priv->machine_state, to_state) == FALSE) {
+				TRANSITION_MATRIX_INDEX (priv->blocked_edges, num_states, priv->machine_state, to_state) = TRUE;
+				priv->num_blocked_edges++;
+			}
+		}
+
+		if (executed == FALSE && failed_to_states->len > 0) {
+			update_target_distances (self);
+		}
+	} while (executed == FALSE && failed_to_states->len > 0);
+
+	g_array_unref (failed_to_states);
+
+	return executed;
+}
+
+static gdouble
+get_transition_weight (DfsmMachine *self, DfsmAstObjectTransition *object_transition)
+{
+	gdouble *weight = g_hash_table_lookup (self->priv->transition_weights, object_transition);
+
+	return (weight != NULL) ? *weight : 1.0;
+}
+
+typedef struct {
+	guint index; /* into possible_transitions */
+	gdouble key;
+} WeightedTransition;
+
+static gint
+weighted_transition_compare_keys (const WeightedTransition *a, const WeightedTransition *b)
+{
+	/* Highest key first. */
+	return (a->key > b->key) ? -1 : (a->key < b->key) ? 1 : 0;
+}
+
+/* Order the transitions out of the current state in @possible_transitions by sampling them at random, without replacement, with probability
+ * proportional to their weights. The first transition in this order which passes any deterministic check (such as its preconditions) is therefore
+ * chosen with probability proportional to its weight among the transitions which pass the check. This uses the method of Efraimidis and Spirakis:
+ * each transition gets the key log(u) / weight for a uniform random u, and the transitions are sorted by descending key. Transitions out of other
+ * states aren't included, and transitions with no weight come last. */
+static WeightedTransition *
+build_weighted_order (DfsmMachine *self, GPtrArray/*<DfsmAstObjectTransition>*/ *possible_transitions, guint *num_weighted_transitions)
+{
+	DfsmMachinePrivate *priv = self->priv;
+	GRand *rand = dfsm_internal_environment_get_rand (priv->environment);
+	WeightedTransition *order;
+	guint i, n = 0;
+
+	/* The order only lives for the duration of the dispatch, so it comes from the arena. */
+	order = dfsm_internal_arena_alloc (dfsm_internal_environment_get_arena (priv->environment),
+	                                   sizeof (WeightedTransition) * possible_transitions->len);
+
+	for (i = 0; i < possible_transitions->len; i++) {
+		DfsmAstObjectTransition *object_transition = g_ptr_array_index (possible_transitions, i);
+		gdouble weight;
+
+		if (object_transition->from_state != priv->machine_state) {
+			continue;
+		}
+
+		weight = get_transition_weight (self, object_transition);
+
+		order[n].index = i;
+		order[n].key = (weight > 0.0) ? log (g_rand_double_range (rand, G_MINDOUBLE, 1.0)) / weight : -INFINITY;
+		n++;
+	}
+
+	qsort (order, n, sizeof (WeightedTransition), (GCompareFunc) weighted_transition_compare_keys);
+	*num_weighted_transitions = n;
+
+	return order;
+}
+
 static gboolean
 find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *output_sequence, GPtrArray/*<DfsmAstObjectTransition>*/ *possible_transitions,
                                     gboolean enable_fuzzing)
 {
 	DfsmMachinePrivate *priv = self->priv;
-	guint i, rand_offset;
-	DfsmAstObjectTransition *candidate_object_transition = NULL, *precondition_failure_transition = NULL;
+	guint i, rand_offset = 0, num_candidates;
+	WeightedTransition *weighted_order = NULL;
+	DfsmAstObjectTransition *candidate_object_transition = NULL, *precondition_failure_transition = NULL, *unsolved_object_transition = NULL;
 	gboolean outputted = FALSE; /* have we outputted a reply or thrown an error? */
+	gboolean solving = FALSE;
 
 	g_debug ("Finding a transition out of %u possibles.", possible_transitions->len);
 
@@ -272,6 +823,17 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 		goto done;
 	}
 
+	/* In directed mode, prefer transitions along a shortest path to the target state, falling back to random selection if there are none. */
+	if (priv->target_state != DFSM_MACHINE_INVALID_STATE && priv->target_reached == FALSE &&
+	    find_and_execute_directed_transition (self, output_sequence, possible_transitions, enable_fuzzing) == TRUE) {
+		outputted = TRUE;
+		goto done;
+	}
+
+	/* Precondition solving only applies to arbitrary transitions, since method calls and property sets have to pick a transition anyway; and only
+	 * when fuzzing, since it changes object variables behind the simulation code's back. */
+	solving = (priv->solve_preconditions == TRUE && enable_fuzzing == TRUE && possible_transitions == priv->transitions.arbitrarily_triggered);
+
 	/* Arbitrarily choose a transition to perform. We do this by taking a random start index into the array of transitions, and then sequentially
 	 * checking preconditions of transitions until we find one which is satisfied. We then execute that transition.
 	 *
@@ -283,24 +845,40 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 	 * those which contain ‘throw’ statements; but we *must* pick a transition. We can't just ignore the method call/property change.
 	 *
 	 * If we're trying to find a transition as a result of a random timeout, we can prioritise non-throwing transitions over those which contain
-	 * ‘throw’ statements to the extent that we may not actually execute a transition. That's fine. */
-	rand_offset = g_random_int_range (0, possible_transitions->len);
-	for (i = 0; i < possible_transitions->len; i++) {
+	 * ‘throw’ statements to the extent that we may not actually execute a transition. That's fine.
+	 *
+	 * If any transitions have been rewarded, the transitions are instead checked in a random order weighted by their weights, so that the one
+	 * which is executed is chosen in proportion to its weight among those whose preconditions pass. */
+	if (priv->transition_weights != NULL) {
+		weighted_order = build_weighted_order (self, possible_transitions, &num_candidates);
+	} else {
+		rand_offset = g_rand_int_range (dfsm_internal_environment_get_rand (priv->environment), 0, possible_transitions->len);
+		num_candidates = possible_transitions->len;
+	}
+
+	for (i = 0; i < num_candidates; i++) {
 		DfsmAstObjectTransition *object_transition;
 		DfsmAstTransition *transition;
 		gboolean will_throw_error = FALSE;
 		gboolean transition_is_executable = FALSE;
+		gboolean preconditions_satisfied;
+		guint transition_index;
+
+		if (weighted_order != NULL) {
+			transition_index = weighted_order[i].index;
+		} else {
+			transition_index = (i + rand_offset) % possible_transitions->len;
+		}
 
-		object_transition = g_ptr_array_index (possible_transitions, (i + rand_offset) % possible_transitions->len);
+		object_transition = g_ptr_array_index (possible_transitions, transition_index);
 		transition = object_transition->transition;
 
 		/* Check we're in the right starting state. */
 		if (object_transition->from_state != priv->machine_state) {
-			gchar *friendly_transition_name = dfsm_ast_object_transition_build_friendly_name (object_transition);
+			const gchar *friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (object_transition);
 			g_debug ("…Skipping transition %s from ‘%s’ to ‘%s’ due to being in the wrong state (‘%s’).", friendly_transition_name,
 			         get_state_name (self, object_transition->from_state), get_state_name (self, object_transition->to_state),
 			         get_state_name (self, priv->machine_state));
-			g_free (friendly_transition_name);
 
 			continue;
 		}
@@ -312,19 +890,22 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 		               &transition_is_executable);
 
 		if (transition_is_executable == FALSE) {
-			gchar *friendly_transition_name;
+			const gchar *friendly_transition_name;
 
-			friendly_transition_name = dfsm_ast_object_transition_build_friendly_name (object_transition);
+			friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (object_transition);
 			g_debug ("…Skipping transition %s from ‘%s’ to ‘%s’ due to being manually overridden.", friendly_transition_name,
 			         get_state_name (self, object_transition->from_state), get_state_name (self, object_transition->to_state));
-			g_free (friendly_transition_name);
 
 			continue;
 		}
 
 		/* If this transition's preconditions are satisfied, continue down to execute it. Otherwise, loop round and try the next transition. */
-		if (dfsm_ast_transition_check_preconditions (transition, priv->environment, NULL, &will_throw_error) == FALSE) {
-			gchar *friendly_transition_name;
+		dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "precondition-check", dfsm_ast_object_transition_get_friendly_name (object_transition), NULL);
+		preconditions_satisfied = dfsm_ast_transition_check_preconditions (transition, priv->environment, NULL, &will_throw_error);
+		dfsm_internal_trace (DFSM_TRACE_PHASE_END, "precondition-check", dfsm_ast_object_transition_get_friendly_name (object_transition), NULL);
+
+		if (preconditions_satisfied == FALSE) {
+			const gchar *friendly_transition_name;
 
 			/* If the transition will throw a D-Bus error as a result of its precondition failures, store it. If we don't find any
 			 * transitions which have no precondition failures, we can come back to the first one _with_ precondition failures and
@@ -333,28 +914,32 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 				precondition_failure_transition = object_transition;
 			}
 
-			friendly_transition_name = dfsm_ast_object_transition_build_friendly_name (object_transition);
+			/* Remember the first transition we haven't executed yet, so we can try solving its preconditions if nothing else works. */
+			if (solving == TRUE && unsolved_object_transition == NULL &&
+			    g_hash_table_contains (priv->executed_transitions, object_transition) == FALSE) {
+				unsolved_object_transition = object_transition;
+			}
+
+			friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (object_transition);
 			g_debug ("…Skipping transition %s from ‘%s’ to ‘%s’ due to precondition failures.", friendly_transition_name,
 			         get_state_name (self, object_transition->from_state), get_state_name (self, object_transition->to_state));
-			g_free (friendly_transition_name);
 
 			continue;
 		}
 
 		/* If this transition contains a ‘throw’ statement, check if we really want to execute it. */
 		if (dfsm_ast_transition_contains_throw_statement (transition) == TRUE &&
-		    (enable_fuzzing == FALSE || DFSM_BIASED_COIN_FLIP (0.8))) {
-			gchar *friendly_transition_name;
+		    (enable_fuzzing == FALSE || DFSM_BIASED_COIN_FLIP (dfsm_internal_environment_get_rand (priv->environment), 0.8))) {
+			const gchar *friendly_transition_name;
 
 			/* Skip the transition, but keep a record of it in case we find there are no other transitions whose preconditions pass and
 			 * which don't contain ‘throw’ statements. */
 			candidate_object_transition = object_transition;
 			precondition_failure_transition = NULL;
 
-			friendly_transition_name = dfsm_ast_object_transition_build_friendly_name (object_transition);
+			friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (object_transition);
 			g_debug ("…Skipping transition %s from ‘%s’ to ‘%s’ due to it containing a throw statement.", friendly_transition_name,
 			         get_state_name (self, object_transition->from_state), get_state_name (self, object_transition->to_state));
-			g_free (friendly_transition_name);
 
 			continue;
 		}
@@ -363,12 +948,39 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 		precondition_failure_transition = NULL;
 		candidate_object_transition = NULL;
 
-		execute_transition (self, object_transition, output_sequence, enable_fuzzing);
+		execute_transition (self, object_transition, output_sequence, enable_fuzzing, NULL);
 		outputted = TRUE;
 
 		break;
 	}
 
+	/* If we didn't manage to find/execute any transitions, try to satisfy the preconditions of one we haven't executed yet by changing the
+	 * values of object variables. Any properties changed by this are notified along with the transition's own changes. */
+	if (outputted == FALSE && candidate_object_transition == NULL && precondition_failure_transition == NULL &&
+	    unsolved_object_transition != NULL) {
+		const gchar *friendly_transition_name;
+		PropertySnapshot snapshot;
+
+		friendly_transition_name = dfsm_ast_object_transition_get_friendly_name (unsolved_object_transition);
+		snapshot_properties (self, &snapshot);
+
+		dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "precondition-solve", friendly_transition_name, NULL);
+
+		if (dfsm_internal_solve_preconditions (unsolved_object_transition->transition, priv->environment) == TRUE) {
+			g_debug ("…Solved preconditions of transition %s from ‘%s’ to ‘%s’.", friendly_transition_name,
+			         get_state_name (self, unsolved_object_transition->from_state),
+			         get_state_name (self, unsolved_object_transition->to_state));
+
+			/* Notify the solver's changes together with the transition's, so a property the transition sets back isn't notified. */
+			execute_transition (self, unsolved_object_transition, output_sequence, enable_fuzzing, &snapshot);
+			outputted = TRUE;
+		} else {
+			add_property_changes (self, output_sequence, &snapshot);
+		}
+
+		dfsm_internal_trace (DFSM_TRACE_PHASE_END, "precondition-solve", friendly_transition_name, NULL);
+	}
+
 	/* If we didn't manage to find/execute any transitions, return the error from the first precondition failure. */
 	if (precondition_failure_transition != NULL) {
 		dfsm_ast_transition_check_preconditions (precondition_failure_transition->transition, priv->environment, output_sequence, NULL);
@@ -378,7 +990,7 @@ find_and_execute_random_transition (DfsmMachine *self, DfsmOutputSequence *outpu
 	/* If we found a candidate transition but then skipped it due to it containing ‘throw’ statements, and didn't subsequently find a better
 	 * transition, execute the previous candidate transition now. */
 	if (candidate_object_transition != NULL) {
-		execute_transition (self, candidate_object_transition, output_sequence, enable_fuzzing);
+		execute_transition (self, candidate_object_transition, output_sequence, enable_fuzzing, NULL);
 		outputted = TRUE;
 	}
 
@@ -418,6 +1030,7 @@ dfsm_machine_make_arbitrary_transition (DfsmMachine *self, DfsmOutputSequence *o
 
 	/* Find and potentially execute a transition. */
 	executed_transition = find_and_execute_random_transition (self, output_sequence, possible_transitions, enable_fuzzing);
+	dfsm_internal_arena_reset (dfsm_internal_environment_get_arena (priv->environment));
 
 	if (executed_transition == FALSE) {
 		/* If we failed to execute a transition, log it and ignore it. */
@@ -512,12 +1125,96 @@ _dfsm_machine_new (DfsmEnvironment *environment, GPtrArray/*<string>*/ *state_na
 	return machine;
 }
 
+/*
+ * dfsm_machine_new_instance:
+ * @template_machine: a #DfsmMachine to instantiate
+ * @environment: a #DfsmEnvironment for the instance, as returned by dfsm_environment_new_instance()
+ *
+ * Creates a new #DfsmMachine for an instance of the object using @template_machine. The new machine shares its state names and transition index with
+ * @template_machine (neither of which are ever modified), but has its own @environment and machine state, which starts as the starting state.
+ *
+ * Return value: (transfer full): a new #DfsmMachine
+ */
+DfsmMachine *
+_dfsm_machine_new_instance (DfsmMachine *template_machine, DfsmEnvironment *environment)
+{
+	DfsmMachine *machine;
+	DfsmMachinePrivate *template_priv;
+
+	g_return_val_if_fail (DFSM_IS_MACHINE (template_machine), NULL);
+	g_return_val_if_fail (DFSM_IS_ENVIRONMENT (environment), NULL);
+
+	template_priv = template_machine->priv;
+
+	machine = g_object_new (DFSM_TYPE_MACHINE,
+	                        "environment", environment,
+	                        NULL);
+
+	machine->priv->state_names = g_ptr_array_ref (template_priv->state_names);
+	machine->priv->transitions.method_call_triggered = g_hash_table_ref (template_priv->transitions.method_call_triggered);
+	machine->priv->transitions.property_set_triggered = g_hash_table_ref (template_priv->transitions.property_set_triggered);
+	machine->priv->transitions.arbitrarily_triggered = g_ptr_array_ref (template_priv->transitions.arbitrarily_triggered);
+
+	return machine;
+}
+
+static void
+append_transitions (GPtrArray/*<DfsmAstObjectTransition>*/ *dest, GPtrArray/*<DfsmAstObjectTransition>*/ *src)
+{
+	guint i;
+
+	for (i = 0; i < src->len; i++) {
+		g_ptr_array_add (dest, dfsm_ast_object_transition_ref (g_ptr_array_index (src, i)));
+	}
+}
+
+/*
+ * dfsm_machine_dup_transitions:
+ * @self: a #DfsmMachine
+ *
+ * Get all the transitions in the machine, regardless of what triggers them. The arbitrarily-triggered transitions come first, followed by the
+ * method-triggered and then the property-triggered transitions. The order is fixed for the lifetime of the machine, and is shared with any instances
+ * of it.
+ *
+ * Return value: (transfer full) (element-type DfsmAstObjectTransition): a new array of all the machine's transitions
+ */
+GPtrArray/*<DfsmAstObjectTransition>*/ *
+_dfsm_machine_dup_transitions (DfsmMachine *self)
+{
+	DfsmMachinePrivate *priv;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *transitions, *object_transition_array;
+	GHashTableIter iter;
+
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), NULL);
+
+	priv = self->priv;
+	transitions = g_ptr_array_new_with_free_func ((GDestroyNotify) dfsm_ast_object_transition_unref);
+
+	append_transitions (transitions, priv->transitions.arbitrarily_triggered);
+
+	g_hash_table_iter_init (&iter, priv->transitions.method_call_triggered);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &object_transition_array) == TRUE) {
+		append_transitions (transitions, object_transition_array);
+	}
+
+	g_hash_table_iter_init (&iter, priv->transitions.property_set_triggered);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &object_transition_array) == TRUE) {
+		append_transitions (transitions, object_transition_array);
+	}
+
+	return transitions;
+}
+
 /**
  * dfsm_machine_reset_state:
  * @self: a #DfsmMachine
  *
  * Reset the simulation's state. This can be called whether the simulation is currently running or stopped. In both cases, it resets the DFSM to its
  * starting state and resets the environment.
+ *
+ * If a target state has been set using dfsm_machine_set_target_state(), the machine will be driven towards it again.
  */
 void
 dfsm_machine_reset_state (DfsmMachine *self)
@@ -534,6 +1231,9 @@ dfsm_machine_reset_state (DfsmMachine *self)
 	priv->machine_state = DFSM_MACHINE_STARTING_STATE;
 	g_object_notify (G_OBJECT (self), "machine-state");
 
+	/* Re-arm directed mode, if it's enabled. */
+	set_target_reached (self, priv->target_state == priv->machine_state);
+
 	/* Reset the environment. */
 	dfsm_environment_reset (priv->environment);
 }
@@ -608,17 +1308,15 @@ dfsm_machine_call_method (DfsmMachine *self, DfsmOutputSequence *output_sequence
 	if (method_info->in_args != NULL) {
 		for (i = 0; method_info->in_args[i] != NULL && i < g_variant_n_children (parameters); i++) {
 			GVariant *parameter;
-			GVariantType *parameter_type;
 
 			/* Add the (i)th tuple child of the input parameters to the environment with the name given by the (i)th in argument in the
-			 * method info. */
+			 * method info. A GVariantType is just its type string, so the signature can be used as the type without copying it. */
 			parameter = g_variant_get_child_value (parameters, i);
-			parameter_type = g_variant_type_new (method_info->in_args[i]->signature);
 
-			dfsm_environment_set_variable_type (priv->environment, DFSM_VARIABLE_SCOPE_LOCAL, method_info->in_args[i]->name, parameter_type);
+			dfsm_environment_set_variable_type (priv->environment, DFSM_VARIABLE_SCOPE_LOCAL, method_info->in_args[i]->name,
+			                                    G_VARIANT_TYPE (method_info->in_args[i]->signature));
 			dfsm_environment_set_variable_value (priv->environment, DFSM_VARIABLE_SCOPE_LOCAL, method_info->in_args[i]->name, parameter);
 
-			g_variant_type_free (parameter_type);
 			g_variant_unref (parameter);
 		}
 	}
@@ -638,6 +1336,9 @@ dfsm_machine_call_method (DfsmMachine *self, DfsmOutputSequence *output_sequence
 		}
 	}
 
+	/* Free the dispatch's temporaries. */
+	dfsm_internal_arena_reset (dfsm_internal_environment_get_arena (priv->environment));
+
 done:
 	/* If we failed to find and execute a transition, warn and return the unit tuple. */
 	if (executed_transition == FALSE) {
@@ -662,8 +1363,8 @@ done:
  *
  * Set the given @property_name to @value on the DFSM machine. The property will be set synchronously.
  *
- * Any signal emissions which occur as a result of the property being set will be appended to @output_sequence. Any additional property changes will
- * be made while the function's running (but signalled in @output_sequence, if anywhere).
+ * Any signal emissions which occur as a result of the property being set will be appended to @output_sequence, as will change notifications for any
+ * properties which are changed (including @property_name itself); see dfsm_output_sequence_add_property_change().
  *
  * Return value: %TRUE if @property_name was changed (not just set) to @value, %FALSE otherwise
  */
@@ -701,6 +1402,7 @@ dfsm_machine_set_property (DfsmMachine *self, DfsmOutputSequence *output_sequenc
 
 	/* Restore the environment. */
 	dfsm_environment_unset_variable_value (priv->environment, DFSM_VARIABLE_SCOPE_LOCAL, "value");
+	dfsm_internal_arena_reset (dfsm_internal_environment_get_arena (priv->environment));
 
 	/* Swallow the return value. */
 	if (return_value != NULL) {
@@ -712,6 +1414,7 @@ done:
 	 * a transition was found and run successfully. */
 	if (executed_transition == FALSE) {
 		GVariant *old_value;
+		PropertySnapshot snapshot;
 
 		g_debug ("Couldn't find any DFSM transitions eligible to be executed as a result of setting property ‘%s’. Running default transition.",
 		         property_name);
@@ -727,7 +1430,9 @@ done:
 		g_variant_unref (old_value);
 
 		/* Set the variable's new value in the environment. */
+		snapshot_properties (self, &snapshot);
 		dfsm_environment_set_variable_value (priv->environment, DFSM_VARIABLE_SCOPE_OBJECT, property_name, value);
+		add_property_changes (self, output_sequence, &snapshot);
 
 		return TRUE;
 	}
@@ -768,12 +1473,6 @@ done:
 	return highest_state;
 }
 
-#define TRANSITION_MATRIX_ASSIGN(M, S, F, T) \
-	g_assert ((F) < (S)); \
-	g_assert ((T) < (S)); \
-	TRANSITION_MATRIX_INDEX(M, S, F, T)
-#define TRANSITION_MATRIX_INDEX(M, S, F, T) M[(S) * (F) + (T)]
-
 static void
 set_transition_matrix_entries (DfsmStateReachability *matrix, guint num_states, GPtrArray/*<DfsmAstObjectTransition>*/ *object_transition_array)
 {
@@ -1009,3 +1708,266 @@ dfsm_machine_get_environment (DfsmMachine *self)
 
 	return self->priv->environment;
 }
+
+/**
+ * dfsm_machine_get_transition_count:
+ * @self: a #DfsmMachine
+ *
+ * Gets the number of transitions the machine has executed since it was created, including those which threw errors. This isn't reset by
+ * dfsm_machine_reset_state(), so callers interested in a particular period should take the difference between two counts.
+ *
+ * Return value: number of transitions executed
+ */
+guint
+dfsm_machine_get_transition_count (DfsmMachine *self)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), 0);
+
+	return self->priv->transition_count;
+}
+
+/**
+ * dfsm_machine_get_target_state:
+ * @self: a #DfsmMachine
+ *
+ * Gets the value of the #DfsmMachine:target-state property.
+ *
+ * Return value: the state the machine is being driven towards, or %DFSM_MACHINE_INVALID_STATE
+ */
+DfsmMachineStateNumber
+dfsm_machine_get_target_state (DfsmMachine *self)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), DFSM_MACHINE_INVALID_STATE);
+
+	return self->priv->target_state;
+}
+
+/**
+ * dfsm_machine_set_target_state:
+ * @self: a #DfsmMachine
+ * @target_state: the state to drive the machine towards, or %DFSM_MACHINE_INVALID_STATE
+ *
+ * Set the state to drive the machine towards. Until @target_state is reached, whenever the machine chooses a transition to execute it will prefer
+ * one which lies on a shortest path to @target_state in the machine's transition graph, so the target is reached in as few transitions as the
+ * machine's preconditions allow. If none of the transitions on a shortest path have their preconditions satisfied, the paths are recalculated to
+ * avoid them; and if no path remains, a transition is chosen randomly as normal. Once @target_state is reached, #DfsmMachine:target-reached is
+ * set and the machine reverts to choosing all transitions randomly.
+ *
+ * Setting the target state again, or resetting the machine with dfsm_machine_reset_state(), re-arms the target. Pass %DFSM_MACHINE_INVALID_STATE
+ * to disable directed mode.
+ */
+void
+dfsm_machine_set_target_state (DfsmMachine *self, DfsmMachineStateNumber target_state)
+{
+	DfsmMachinePrivate *priv;
+
+	g_return_if_fail (DFSM_IS_MACHINE (self));
+	g_return_if_fail (target_state == DFSM_MACHINE_INVALID_STATE || target_state < self->priv->state_names->len);
+
+	priv = self->priv;
+
+	g_object_freeze_notify (G_OBJECT (self));
+
+	if (priv->target_state != target_state) {
+		priv->target_state = target_state;
+
+		/* Invalidate the shortest paths. They're recalculated lazily. */
+		g_free (priv->target_distances);
+		priv->target_distances = NULL;
+
+		g_object_notify (G_OBJECT (self), "target-state");
+	}
+
+	set_target_reached (self, target_state != DFSM_MACHINE_INVALID_STATE && priv->machine_state == target_state);
+
+	g_object_thaw_notify (G_OBJECT (self));
+}
+
+/**
+ * dfsm_machine_get_target_reached:
+ * @self: a #DfsmMachine
+ *
+ * Gets the value of the #DfsmMachine:target-reached property.
+ *
+ * Return value: %TRUE if the machine has reached its target state, %FALSE otherwise
+ */
+gboolean
+dfsm_machine_get_target_reached (DfsmMachine *self)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), FALSE);
+
+	return self->priv->target_reached;
+}
+
+/**
+ * dfsm_machine_get_solve_preconditions:
+ * @self: a #DfsmMachine
+ *
+ * Gets the value of the #DfsmMachine:solve-preconditions property.
+ *
+ * Return value: %TRUE if precondition solving is enabled, %FALSE otherwise
+ */
+gboolean
+dfsm_machine_get_solve_preconditions (DfsmMachine *self)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), FALSE);
+
+	return self->priv->solve_preconditions;
+}
+
+/**
+ * dfsm_machine_set_solve_preconditions:
+ * @self: a #DfsmMachine
+ * @solve_preconditions: %TRUE to enable precondition solving, %FALSE to disable it
+ *
+ * Set whether to solve the preconditions of arbitrary transitions. If enabled, whenever fuzzing is enabled and no arbitrary transition from the
+ * current state has its preconditions satisfied, the machine will look for values of object variables which satisfy the preconditions of one of
+ * those transitions which hasn't been executed since solving was enabled. If values are found, they're assigned (and notified as property changes
+ * where appropriate) and the transition is executed. This allows transitions guarded by preconditions which the simulation code rarely satisfies by
+ * itself to be fuzzed.
+ *
+ * The search uses simple interval and equality constraints derived from comparisons between object variables and other expressions in the
+ * preconditions, so it won't find values for all preconditions.
+ */
+void
+dfsm_machine_set_solve_preconditions (DfsmMachine *self, gboolean solve_preconditions)
+{
+	DfsmMachinePrivate *priv;
+
+	g_return_if_fail (DFSM_IS_MACHINE (self));
+
+	priv = self->priv;
+	solve_preconditions = (solve_preconditions == TRUE) ? TRUE : FALSE;
+
+	if (priv->solve_preconditions == solve_preconditions) {
+		return;
+	}
+
+	priv->solve_preconditions = solve_preconditions;
+
+	if (solve_preconditions == TRUE) {
+		priv->executed_transitions = g_hash_table_new (g_direct_hash, g_direct_equal);
+	} else {
+		g_hash_table_unref (priv->executed_transitions);
+		priv->executed_transitions = NULL;
+	}
+
+	g_object_notify (G_OBJECT (self), "solve-preconditions");
+}
+
+/**
+ * dfsm_machine_get_transition_feedback:
+ * @self: a #DfsmMachine
+ *
+ * Gets the value of the #DfsmMachine:transition-feedback property.
+ *
+ * Return value: %TRUE if transition feedback is enabled, %FALSE otherwise
+ */
+gboolean
+dfsm_machine_get_transition_feedback (DfsmMachine *self)
+{
+	g_return_val_if_fail (DFSM_IS_MACHINE (self), FALSE);
+
+	return self->priv->transition_feedback;
+}
+
+/**
+ * dfsm_machine_set_transition_feedback:
+ * @self: a #DfsmMachine
+ * @transition_feedback: %TRUE to enable transition feedback, %FALSE to disable it
+ *
+ * Set whether to keep track of the transitions the machine executes, so that they can be rewarded using dfsm_machine_reward_recent_transitions().
+ * Disabling feedback forgets the recently executed transitions, but keeps any weights they've already been given.
+ */
+void
+dfsm_machine_set_transition_feedback (DfsmMachine *self, gboolean transition_feedback)
+{
+	DfsmMachinePrivate *priv;
+
+	g_return_if_fail (DFSM_IS_MACHINE (self));
+
+	priv = self->priv;
+	transition_feedback = (transition_feedback == TRUE) ? TRUE : FALSE;
+
+	if (priv->transition_feedback == transition_feedback) {
+		return;
+	}
+
+	priv->transition_feedback = transition_feedback;
+
+	if (transition_feedback == TRUE) {
+		priv->recent_transitions = g_ptr_array_new ();
+	} else {
+		g_ptr_array_unref (priv->recent_transitions);
+		priv->recent_transitions = NULL;
+	}
+
+	g_object_notify (G_OBJECT (self), "transition-feedback");
+}
+
+/**
+ * dfsm_machine_reward_recent_transitions:
+ * @self: a #DfsmMachine
+ * @reward: non-negative reward to share between the recently executed transitions
+ *
+ * Reward the transitions the machine has executed since this was last called (or since #DfsmMachine:transition-feedback was enabled), then forget
+ * them. This is intended to be called regularly by a feedback loop which measures the effect of the transitions on the program under test; for
+ * example, with the number of new code paths the program has taken since the last call.
+ *
+ * The @reward is shared equally between the distinct transitions executed, and added to their weights (which start at 1). Once any transition has
+ * been rewarded, whenever the machine chooses a transition at random, the probability of each transition being considered first is proportional to
+ * its weight. Weights are capped, so rarely rewarded transitions are still chosen. A @reward of 0 just forgets the recent transitions.
+ *
+ * Transition feedback must be enabled using dfsm_machine_set_transition_feedback() first.
+ */
+void
+dfsm_machine_reward_recent_transitions (DfsmMachine *self, gdouble reward)
+{
+	DfsmMachinePrivate *priv;
+	GHashTable/*<DfsmAstObjectTransition>*/ *distinct_transitions;
+	GHashTableIter iter;
+	DfsmAstObjectTransition *object_transition;
+	guint i;
+
+	g_return_if_fail (DFSM_IS_MACHINE (self));
+	g_return_if_fail (reward >= 0.0);
+	g_return_if_fail (self->priv->transition_feedback == TRUE);
+
+	priv = self->priv;
+
+	if (reward == 0.0 || priv->recent_transitions->len == 0) {
+		g_ptr_array_set_size (priv->recent_transitions, 0);
+		return;
+	}
+
+	/* A transition executed several times in the window only gets one share. */
+	distinct_transitions = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (i = 0; i < priv->recent_transitions->len; i++) {
+		g_hash_table_add (distinct_transitions, g_ptr_array_index (priv->recent_transitions, i));
+	}
+
+	if (priv->transition_weights == NULL) {
+		priv->transition_weights = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	}
+
+	reward /= g_hash_table_size (distinct_transitions);
+	g_hash_table_iter_init (&iter, distinct_transitions);
+
+	while (g_hash_table_iter_next (&iter, (gpointer*) &object_transition, NULL) == TRUE) {
+		gdouble *weight = g_hash_table_lookup (priv->transition_weights, object_transition);
+
+		if (weight == NULL) {
+			weight = g_new (gdouble, 1);
+			*weight = 1.0;
+			g_hash_table_insert (priv->transition_weights, object_transition, weight);
+		}
+
+		*weight = MIN (*weight + reward, MAX_TRANSITION_WEIGHT);
+
+		g_debug ("Rewarded transition %s; its weight is now %f.", dfsm_ast_object_transition_get_friendly_name (object_transition), *weight);
+	}
+
+	g_hash_table_unref (distinct_transitions);
+	g_ptr_array_set_size (priv->recent_transitions, 0);
+}
@@ -114,7 +114,19 @@ GArray/*<DfsmStateReachability>*/ *dfsm_machine_calculate_state_reachability (Df
 DfsmMachineStateNumber dfsm_machine_look_up_state (DfsmMachine *self, const gchar *state_name) G_GNUC_PURE;
 const gchar *dfsm_machine_get_state_name (DfsmMachine *self, DfsmMachineStateNumber state_number) G_GNUC_PURE;
 
+DfsmMachineStateNumber dfsm_machine_get_target_state (DfsmMachine *self) G_GNUC_PURE;
+void dfsm_machine_set_target_state (DfsmMachine *self, DfsmMachineStateNumber target_state);
+gboolean dfsm_machine_get_target_reached (DfsmMachine *self) G_GNUC_PURE;
+
+gboolean dfsm_machine_get_solve_preconditions (DfsmMachine *self) G_GNUC_PURE;
+void dfsm_machine_set_solve_preconditions (DfsmMachine *self, gboolean solve_preconditions);
+
+gboolean dfsm_machine_get_transition_feedback (DfsmMachine *self) G_GNUC_PURE;
+void dfsm_machine_set_transition_feedback (DfsmMachine *self, gboolean transition_feedback);
+void dfsm_machine_reward_recent_transitions (DfsmMachine *self, gdouble reward);
+
 DfsmEnvironment *dfsm_machine_get_environment (DfsmMachine *self) G_GNUC_PURE;
+guint dfsm_machine_get_transition_count (DfsmMachine *self);
 
 G_END_DECLS
 
@@ -28,13 +28,17 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <math.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
 #include "dfsm-object.h"
 #include "dfsm-ast.h"
 #include "dfsm-dbus-output-sequence.h"
+#include "dfsm-internal.h"
 #include "dfsm-machine.h"
 #include "dfsm/dfsm-marshal.h"
 #include "dfsm-parser.h"
@@ -71,6 +75,7 @@ static void dfsm_object_set_property (GObject *object, guint property_id, const
 
 static gboolean dfsm_object_dbus_method_call_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name,
                                                       const gchar *method_name, GVariant *parameters, gboolean enable_fuzzing);
+static GVariant *dfsm_object_dbus_get_property_default (DfsmObject *obj, const gchar *interface_name, const gchar *property_name);
 static gboolean dfsm_object_dbus_set_property_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name,
                                                        const gchar *property_name, GVariant *value, gboolean enable_fuzzing);
 static gboolean dfsm_object_arbitrary_transition_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing);
@@ -88,22 +93,62 @@ static const GDBusInterfaceVTable dbus_interface_vtable = {
 	dfsm_object_dbus_set_property,
 };
 
+typedef struct {
+	GVariant *reply_body; /* (a{sv}), serialised; NULL if it needs rebuilding */
+	guint serial; /* object variable serial of the environment when ->reply_body was last known to be valid */
+} PropertiesCacheEntry;
+
+static void
+properties_cache_entry_free (PropertiesCacheEntry *entry)
+{
+	if (entry->reply_body != NULL) {
+		g_variant_unref (entry->reply_body);
+	}
+
+	g_slice_free (PropertiesCacheEntry, entry);
+}
+
 struct _DfsmObjectPrivate {
 	GDBusConnection *connection; /* NULL if the object isn't registered on a bus */
 	DfsmMachine *machine;
 	DfsmSimulationStatus simulation_status;
-	guint timeout_id;
+	DfsmSchedulerEntry arbitrary_transition_entry; /* scheduled while the simulation's running */
 	gchar *object_path;
 	GPtrArray/*<string>*/ *bus_names;
 	GPtrArray/*<string>*/ *interfaces;
 	GArray/*<uint>*/ *registration_ids; /* IDs for all the D-Bus interface registrations we've made, in the same order as ->interfaces. */
 	GHashTable/*<string, uint>*/ *bus_name_ids; /* map from well-known bus name to its ownership ID */
-	guint dbus_activity_count;
+	volatile gint dbus_activity_count; /* accessed atomically, since it may be incremented from the GDBus worker thread */
+
+	/* Worker thread dispatch. */
+	gboolean dispatch_in_worker_thread;
+	guint filter_id; /* ID of the connection filter which handles calls in the worker thread; 0 unless registered with dispatch_in_worker_thread */
+	GMainContext *main_context; /* context the object was registered in; NULL if the object isn't registered on a bus */
+	volatile gint activity_notify_pending; /* TRUE iff a dbus-activity-count notification is queued in ->main_context */
+	GMutex machine_lock; /* held while the machine is executing, since it may be executed from the main thread and the worker thread */
+
+	/* Property cache. Protected by ->machine_lock. */
+	GHashTable/*<string, PropertiesCacheEntry>*/ *properties_cache; /* map from interface name to cached GetAll reply */
+
+	/* Output sequence reuse. Protected by ->machine_lock. Since the lock's held for the whole of each dispatch, at most one output sequence is
+	 * in use at once, so a single spare is enough to avoid constructing one per dispatch. */
+	DfsmDBusOutputSequence *spare_output_sequence; /* NULL if the object isn't registered on a bus */
+	/* Whether anything other than our toggle reference holds the in-flight output sequence (such as a signal handler which has kept it). Accessed
+	 * atomically, since the reference may be taken or dropped from any thread. */
+	volatile gint output_sequence_shared;
+
+	/* Instances created and destroyed by instantiate and destroy statements. These are only accessed from ->main_context. */
+	DfsmObject *template_object; /* unowned; the object this instance was created from by a transition, or NULL */
+	GHashTable/*<string, DfsmObject>*/ *instances; /* map from object path to instance created from this object by a transition; NULL if none */
 };
 
-/* HACK: Apply to all DfsmObjects. Not thread-safe. */
-static guint unfuzzed_transition_count = 0;
-static guint unfuzzed_transition_limit = 0;
+/* HACK: Apply to all DfsmObjects. Accessed atomically, since objects may be dispatching method calls in the worker thread while others make arbitrary
+ * transitions in the main thread. */
+static volatile gint unfuzzed_transition_count = 0;
+static volatile gint unfuzzed_transition_limit = 0;
+
+/* Directory for the compiled machine cache, or NULL if it's disabled. Not thread-safe. */
+static gchar *cache_directory = NULL;
 
 enum {
 	PROP_CONNECTION = 1,
@@ -113,12 +158,18 @@ enum {
 	PROP_INTERFACES,
 	PROP_DBUS_ACTIVITY_COUNT,
 	PROP_SIMULATION_STATUS,
+	PROP_DISPATCH_IN_WORKER_THREAD,
 };
 
 enum {
 	SIGNAL_DBUS_METHOD_CALL,
+	SIGNAL_DBUS_GET_PROPERTY,
 	SIGNAL_DBUS_SET_PROPERTY,
 	SIGNAL_ARBITRARY_TRANSITION,
+	SIGNAL_WRAP_OUTPUT_SEQUENCE,
+	SIGNAL_DISPATCHED,
+	SIGNAL_INSTANCE_CREATED,
+	SIGNAL_INSTANCE_DESTROYED,
 	LAST_SIGNAL,
 };
 
@@ -126,6 +177,30 @@ static guint object_signals[LAST_SIGNAL] = { 0, };
 
 G_DEFINE_TYPE (DfsmObject, dfsm_object, G_TYPE_OBJECT)
 
+/* Accumulator for #DfsmObject::dbus-get-property: the first handler to return a non-%NULL value wins. */
+static gboolean
+variant_accumulator_first_non_null (GSignalInvocationHint *ihint, GValue *return_accu, const GValue *handler_return, gpointer user_data)
+{
+	GVariant *value;
+
+	value = g_value_get_variant (handler_return);
+	g_value_set_variant (return_accu, value);
+
+	return (value == NULL) ? TRUE : FALSE;
+}
+
+/* Accumulator for #DfsmObject::wrap-output-sequence: the first handler to return a non-%NULL output sequence wins. */
+static gboolean
+object_accumulator_first_non_null (GSignalInvocationHint *ihint, GValue *return_accu, const GValue *handler_return, gpointer user_data)
+{
+	GObject *object;
+
+	object = g_value_get_object (handler_return);
+	g_value_set_object (return_accu, object);
+
+	return (object == NULL) ? TRUE : FALSE;
+}
+
 static void
 dfsm_object_class_init (DfsmObjectClass *klass)
 {
@@ -139,6 +214,7 @@ dfsm_object_class_init (DfsmObjectClass *klass)
 	gobject_class->finalize = dfsm_object_finalize;
 
 	klass->dbus_method_call = dfsm_object_dbus_method_call_default;
+	klass->dbus_get_property = dfsm_object_dbus_get_property_default;
 	klass->dbus_set_property = dfsm_object_dbus_set_property_default;
 	klass->arbitrary_transition = dfsm_object_arbitrary_transition_default;
 
@@ -225,12 +301,38 @@ dfsm_object_class_init (DfsmObjectClass *klass)
 	                                                    DFSM_TYPE_SIMULATION_STATUS, DFSM_SIMULATION_STATUS_STOPPED,
 	                                                    G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+	/**
+	 * DfsmObject:dispatch-in-worker-thread:
+	 *
+	 * Whether D-Bus method calls to this object should be dispatched directly in the GDBus worker thread, rather than being queued to the main
+	 * context which the object was registered in. This saves a context switch for every method call, at the cost of emitting
+	 * #DfsmObject::dbus-method-call (and executing the #DfsmObject:machine) in the worker thread. Property gets and sets are handled in the
+	 * worker thread too, so that they're handled in the same order as the method calls they were sent amongst;
+	 * <literal>org.freedesktop.DBus.Properties.GetAll</literal> calls are answered there from a cache of the property values. Arbitrary
+	 * transitions are still made in the main context; access to the machine is serialised between the two threads.
+	 *
+	 * Handlers of #DfsmObject::dbus-method-call, #DfsmObject::dbus-get-property, #DfsmObject::dbus-set-property,
+	 * #DfsmObject::wrap-output-sequence, #DfsmObject::dispatched and #DfsmMachine::check-transition must therefore be thread-safe if this is
+	 * set. Property change notifications from the #DfsmObject:machine are still emitted in the main context, after the method call or property
+	 * set has been handled.
+	 *
+	 * This may only be changed while the object isn't registered on a bus.
+	 */
+	g_object_class_install_property (gobject_class, PROP_DISPATCH_IN_WORKER_THREAD,
+	                                 g_param_spec_boolean ("dispatch-in-worker-thread",
+	                                                       "Dispatch in worker thread",
+	                                                       "Whether D-Bus method calls should be dispatched directly in the GDBus worker thread.",
+	                                                       FALSE,
+	                                                       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
 	/**
 	 * DfsmObject::dbus-method-call:
 	 *
 	 * Handle an incoming D-Bus method call. The default implementation for this signal will pass the method call through to this #DfsmObject's
 	 * #DfsmObject:machine. However, other consumers of the signal may elect to handle the method call themselves, then return %TRUE to prevent
 	 * others from doing so.
+	 *
+	 * If #DfsmObject:dispatch-in-worker-thread is %TRUE, this signal is emitted in the GDBus worker thread, so handlers must be thread-safe.
 	 */
 	object_signals[SIGNAL_DBUS_METHOD_CALL] = g_signal_new ("dbus-method-call",
 	                                                        G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
@@ -240,12 +342,32 @@ dfsm_object_class_init (DfsmObjectClass *klass)
 	                                                        G_TYPE_BOOLEAN, 5, DFSM_TYPE_OUTPUT_SEQUENCE, G_TYPE_STRING, G_TYPE_STRING,
 	                                                        G_TYPE_VARIANT, G_TYPE_BOOLEAN);
 
+	/**
+	 * DfsmObject::dbus-get-property:
+	 *
+	 * Handle an incoming D-Bus property get. The default implementation for this signal will return the value of the corresponding object
+	 * variable from this #DfsmObject's #DfsmObject:machine. However, other consumers of the signal may elect to provide the value themselves by
+	 * returning a non-%NULL #GVariant, which prevents others from doing so.
+	 *
+	 * If #DfsmObject:dispatch-in-worker-thread is set, this signal is emitted in the GDBus worker thread, so handlers must be thread-safe.
+	 * <literal>org.freedesktop.DBus.Properties.GetAll</literal> calls are then answered from a cache of the object variables' values, without
+	 * emitting this signal. The cache is bypassed for interfaces with handlers connected to this signal for any of their properties.
+	 */
+	object_signals[SIGNAL_DBUS_GET_PROPERTY] = g_signal_new ("dbus-get-property",
+	                                                         G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
+	                                                         G_STRUCT_OFFSET (DfsmObjectClass, dbus_get_property),
+	                                                         variant_accumulator_first_non_null, NULL,
+	                                                         dfsm_marshal_VARIANT__STRING_STRING,
+	                                                         G_TYPE_VARIANT, 2, G_TYPE_STRING, G_TYPE_STRING);
+
 	/**
 	 * DfsmObject::dbus-set-property:
 	 *
 	 * Handle an incoming D-Bus property value to be set. The default implementation for this signal will pass the property set through to this
 	 * #DfsmObject's #DfsmObject:machine. However, other consumers of the signal may elect to handle the property set themselves, then return
 	 * %TRUE to prevent others from doing so.
+	 *
+	 * If #DfsmObject:dispatch-in-worker-thread is %TRUE, this signal is emitted in the GDBus worker thread, so handlers must be thread-safe.
 	 */
 	object_signals[SIGNAL_DBUS_SET_PROPERTY] = g_signal_new ("dbus-set-property",
 	                                                         G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
@@ -269,12 +391,92 @@ dfsm_object_class_init (DfsmObjectClass *klass)
 	                                                            g_signal_accumulator_true_handled, NULL,
 	                                                            dfsm_marshal_BOOLEAN__OBJECT_BOOLEAN,
 	                                                            G_TYPE_BOOLEAN, 2, DFSM_TYPE_OUTPUT_SEQUENCE, G_TYPE_BOOLEAN);
+
+	/**
+	 * DfsmObject::wrap-output-sequence:
+	 * @output_sequence: the output sequence which the dispatch's effects would be added to
+	 *
+	 * Emitted before each D-Bus method call, property set or arbitrary transition is dispatched, to allow the output sequence the dispatch's
+	 * effects are added to to be replaced. A typical use for this is to return a #DfsmOutputSequence which wraps @output_sequence, recording the
+	 * effects while passing them through to it. The first handler to return a non-%NULL output sequence wins; the returned sequence is then
+	 * passed to the dispatching signal and #DfsmObject::dispatched, and is outputted in place of @output_sequence.
+	 *
+	 * Like #DfsmObject::dbus-method-call, this is emitted in the GDBus worker thread for method calls and property sets if
+	 * #DfsmObject:dispatch-in-worker-thread is set.
+	 *
+	 * Return value: (transfer full) (allow-none): an output sequence to use instead of @output_sequence, or %NULL
+	 */
+	object_signals[SIGNAL_WRAP_OUTPUT_SEQUENCE] = g_signal_new ("wrap-output-sequence",
+	                                                            G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+	                                                            0,
+	                                                            object_accumulator_first_non_null, NULL,
+	                                                            dfsm_marshal_OBJECT__OBJECT,
+	                                                            DFSM_TYPE_OUTPUT_SEQUENCE, 1, DFSM_TYPE_OUTPUT_SEQUENCE);
+
+	/**
+	 * DfsmObject::dispatched:
+	 * @kind: the kind of activity which was dispatched, as a #DfsmObjectDispatchKind
+	 * @output_sequence: (allow-none): the output sequence the activity's effects were added to, or %NULL for property gets
+	 * @interface_name: (allow-none): the D-Bus interface name of the method or property, or %NULL for arbitrary transitions
+	 * @member_name: (allow-none): the name of the method or property, or %NULL for arbitrary transitions
+	 * @value: (allow-none): the method call's parameters, the property's new value for sets, or its returned value for gets; or %NULL
+	 * @result: the value returned from the dispatching signal: whether a property set changed the property, or whether a property get found a
+	 * value; %TRUE for method calls and arbitrary transitions
+	 *
+	 * Emitted after each D-Bus method call, property get, property set or arbitrary transition has been handled by #DfsmObject::dbus-method-call,
+	 * #DfsmObject::dbus-get-property, #DfsmObject::dbus-set-property or #DfsmObject::arbitrary-transition (including by their default handlers),
+	 * but before the effects in @output_sequence are outputted. Every arbitrary transition tick is reported, even if no transition was taken.
+	 *
+	 * This is emitted in the same thread as the dispatching signal.
+	 */
+	object_signals[SIGNAL_DISPATCHED] = g_signal_new ("dispatched",
+	                                                  G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+	                                                  0, NULL, NULL,
+	                                                  dfsm_marshal_VOID__UINT_OBJECT_STRING_STRING_VARIANT_BOOLEAN,
+	                                                  G_TYPE_NONE, 6, G_TYPE_UINT, DFSM_TYPE_OUTPUT_SEQUENCE, G_TYPE_STRING, G_TYPE_STRING,
+	                                                  G_TYPE_VARIANT, G_TYPE_BOOLEAN);
+
+	/**
+	 * DfsmObject::instance-created:
+	 * @instance: the new instance
+	 *
+	 * Emitted when an <code>instantiate</code> statement in a transition of this object (or of one of its instances) has created a new instance
+	 * of it. The instance has been registered on #DfsmObject:connection, but its simulation may not have started yet.
+	 *
+	 * The statement's effects are applied after the output sequence containing it has been outputted, so this is always emitted in the main
+	 * context the object was registered in, even if the transition was dispatched in the GDBus worker thread.
+	 */
+	object_signals[SIGNAL_INSTANCE_CREATED] = g_signal_new ("instance-created",
+	                                                        G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+	                                                        0, NULL, NULL,
+	                                                        g_cclosure_marshal_VOID__OBJECT,
+	                                                        G_TYPE_NONE, 1, DFSM_TYPE_OBJECT);
+
+	/**
+	 * DfsmObject::instance-destroyed:
+	 * @instance: the instance being destroyed
+	 *
+	 * Emitted when a <code>destroy</code> statement in a transition of this object (or of one of its instances) has destroyed an instance
+	 * previously created by an <code>instantiate</code> statement, after @instance has been unregistered from the bus. It's also emitted for
+	 * each remaining instance when this object is unregistered from the bus. As with #DfsmObject::instance-created, this is always emitted in the
+	 * main context the object was registered in.
+	 */
+	object_signals[SIGNAL_INSTANCE_DESTROYED] = g_signal_new ("instance-destroyed",
+	                                                          G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+	                                                          0, NULL, NULL,
+	                                                          g_cclosure_marshal_VOID__OBJECT,
+	                                                          G_TYPE_NONE, 1, DFSM_TYPE_OBJECT);
 }
 
+static void arbitrary_transition_tick_cb (DfsmObject *self);
+
 static void
 dfsm_object_init (DfsmObject *self)
 {
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, DFSM_TYPE_OBJECT, DfsmObjectPrivate);
+	g_mutex_init (&self->priv->machine_lock);
+	dfsm_internal_scheduler_entry_init (&self->priv->arbitrary_transition_entry, (DfsmSchedulerFunc) arbitrary_transition_tick_cb, self);
+	self->priv->properties_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) properties_cache_entry_free);
 }
 
 static void
@@ -304,11 +506,13 @@ dfsm_object_dispose (GObject *object)
 	g_clear_object (&priv->connection);
 
 	/* Shouldn't leak these. */
+	g_assert (priv->instances == NULL || g_hash_table_size (priv->instances) == 0);
 	g_assert (priv->registration_ids == NULL);
 	g_assert (priv->bus_name_ids == NULL);
+	g_assert (priv->spare_output_sequence == NULL);
 
 	/* Make sure we're not leaking a callback. */
-	g_assert (priv->timeout_id == 0);
+	g_assert (dfsm_internal_scheduler_entry_is_scheduled (&priv->arbitrary_transition_entry) == FALSE);
 
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_object_parent_class)->dispose (object);
@@ -320,6 +524,13 @@ dfsm_object_finalize (GObject *object)
 	DfsmObjectPrivate *priv = DFSM_OBJECT (object)->priv;
 
 	g_free (priv->object_path);
+	g_hash_table_unref (priv->properties_cache);
+
+	if (priv->instances != NULL) {
+		g_hash_table_unref (priv->instances);
+	}
+
+	g_mutex_clear (&priv->machine_lock);
 
 	/* Chain up to the parent class */
 	G_OBJECT_CLASS (dfsm_object_parent_class)->finalize (object);
@@ -347,11 +558,14 @@ dfsm_object_get_property (GObject *object, guint property_id, GValue *value, GPa
 			g_value_set_boxed (value, priv->interfaces);
 			break;
 		case PROP_DBUS_ACTIVITY_COUNT:
-			g_value_set_uint (value, priv->dbus_activity_count);
+			g_value_set_uint (value, (guint) g_atomic_int_get (&priv->dbus_activity_count));
 			break;
 		case PROP_SIMULATION_STATUS:
 			g_value_set_enum (value, priv->simulation_status);
 			break;
+		case PROP_DISPATCH_IN_WORKER_THREAD:
+			g_value_set_boolean (value, priv->dispatch_in_worker_thread);
+			break;
 		default:
 			/* We don't have any other property... */
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -365,6 +579,9 @@ dfsm_object_set_property (GObject *object, guint property_id, const GValue *valu
 	DfsmObjectPrivate *priv = DFSM_OBJECT (object)->priv;
 
 	switch (property_id) {
+		case PROP_DISPATCH_IN_WORKER_THREAD:
+			dfsm_object_set_dispatch_in_worker_thread (DFSM_OBJECT (object), g_value_get_boolean (value));
+			break;
 		case PROP_MACHINE:
 			/* Construct-only */
 			priv->machine = g_value_dup_object (value);
@@ -426,16 +643,37 @@ _dfsm_object_new (DfsmMachine *machine, const gchar *object_path, GPtrArray/*<st
 typedef struct {
 	gchar *simulation_code;
 	gchar *introspection_xml;
+	GCancellable *cancellable; /* may be NULL */
+	GPtrArray/*<DfsmObject>*/ *object_array; /* NULL until the objects have been built */
 } FactoryFromFilesData;
 
 static void
 factory_from_files_data_free (FactoryFromFilesData *data)
 {
+	if (data->object_array != NULL) {
+		g_ptr_array_unref (data->object_array);
+	}
+
+	g_clear_object (&data->cancellable);
 	g_free (data->simulation_code);
 	g_free (data->introspection_xml);
 	g_slice_free (FactoryFromFilesData, data);
 }
 
+static void
+factory_from_files_thread_cb (GSimpleAsyncResult *async_result, GObject *source_object, GCancellable *cancellable)
+{
+	FactoryFromFilesData *data;
+	GError *error = NULL;
+
+	data = g_simple_async_result_get_op_res_gpointer (async_result);
+	data->object_array = dfsm_object_factory_from_data (data->simulation_code, data->introspection_xml, &error);
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (async_result, error);
+	}
+}
+
 static void
 cancelled_cb (GCancellable *cancelland, GCancellable *cancellee)
 {
@@ -461,8 +699,9 @@ simulation_code_file_loaded_cb (GFile *simulation_code_file, GAsyncResult *async
 
 		g_simple_async_result_complete_in_idle (parent_async_result);
 	} else if (data->simulation_code != NULL && data->introspection_xml != NULL) {
-		/* Success! */
-		g_simple_async_result_complete_in_idle (parent_async_result);
+		/* Both files have been loaded. Parse and check them in a worker thread so that large machines don't block the main loop. */
+		g_simple_async_result_run_in_thread (parent_async_result, (GSimpleAsyncThreadFunc) factory_from_files_thread_cb, G_PRIORITY_DEFAULT,
+		                                     data->cancellable);
 	}
 }
 
@@ -485,8 +724,9 @@ introspection_xml_file_loaded_cb (GFile *introspection_xml_file, GAsyncResult *a
 
 		g_simple_async_result_complete_in_idle (parent_async_result);
 	} else if (data->simulation_code != NULL && data->introspection_xml != NULL) {
-		/* Success! */
-		g_simple_async_result_complete_in_idle (parent_async_result);
+		/* Both files have been loaded. Parse and check them in a worker thread so that large machines don't block the main loop. */
+		g_simple_async_result_run_in_thread (parent_async_result, (GSimpleAsyncThreadFunc) factory_from_files_thread_cb, G_PRIORITY_DEFAULT,
+		                                     data->cancellable);
 	}
 }
 
@@ -502,6 +742,8 @@ introspection_xml_file_loaded_cb (GFile *introspection_xml_file, GAsyncResult *a
  * #DfsmAstObject<!-- -->s from it, each of which is the AST of the code representing that simulated D-Bus object. The XML in the given
  * @introspection_xml_file should be a fully formed introspection XML document which, at a minimum, describes all the D-Bus interfaces implemented by
  * all the objects defined in @simulation_code_file.
+ *
+ * The two files are loaded concurrently, and the code is then parsed and checked in a worker thread.
  */
 void
 dfsm_object_factory_from_files (GFile *simulation_code_file, GFile *introspection_xml_file, GCancellable *cancellable,
@@ -530,6 +772,8 @@ dfsm_object_factory_from_files (GFile *simulation_code_file, GFile *introspectio
 	data = g_slice_new (FactoryFromFilesData);
 	data->simulation_code = NULL;
 	data->introspection_xml = NULL;
+	data->cancellable = (cancellable != NULL) ? g_object_ref (cancellable) : NULL;
+	data->object_array = NULL;
 
 	g_simple_async_result_set_op_res_gpointer (async_result, data, (GDestroyNotify) factory_from_files_data_free);
 
@@ -559,250 +803,1462 @@ dfsm_object_factory_from_files_finish (GAsyncResult *async_result, GError **erro
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 	g_return_val_if_fail (g_simple_async_result_is_valid (async_result, NULL, dfsm_object_factory_from_files) == TRUE, NULL);
 
-	if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (async_result), error) == TRUE) {
-		return NULL;
+	if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (async_result), error) == TRUE) {
+		return NULL;
+	}
+
+	data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (async_result));
+
+	return g_ptr_array_ref (data->object_array);
+}
+
+/* The compiled machine cache stores the ASTs produced by the parser for a given pair of simulation code and introspection XML, serialised using
+ * dfsm_ast_object_serialise() after a header of the magic string, format version, both inputs and the number of objects. Files are named after a
+ * hash of the format version, the simulation code and the length of the introspection XML, and both inputs are compared in full when a file's
+ * loaded, so edited inputs or a new format simply miss the cache. (Introspection XML can be hundreds of kilobytes, and hashing it took longer than
+ * parsing the simulation code it was meant to save, whereas comparing it is cheap.) The ASTs are serialised before they're checked (since checking
+ * rewrites them), and are still checked after being loaded, but a cache hit saves lexing and parsing the simulation code. Files are only written for
+ * code which passed checking. The cache holds at most COMPILED_MACHINE_CACHE_SIZE files: the least recently used ones are deleted when a new one is
+ * written. */
+#define COMPILED_MACHINE_MAGIC "dfsm-compiled-machine"
+#define COMPILED_MACHINE_VERSION 3
+#define COMPILED_MACHINE_CACHE_SIZE 32
+#define COMPILED_MACHINE_SUFFIX ".machine"
+
+static gchar *
+build_compiled_machine_key (const gchar *simulation_code, const gchar *introspection_xml)
+{
+	GChecksum *checksum;
+	gchar *header, *cache_key;
+
+	header = g_strdup_printf ("%s %u %" G_GSIZE_FORMAT, COMPILED_MACHINE_MAGIC, (guint) COMPILED_MACHINE_VERSION, strlen (introspection_xml));
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+	/* Include the nul terminators so the inputs can't run into each other. */
+	g_checksum_update (checksum, (const guchar*) header, strlen (header) + 1);
+	g_checksum_update (checksum, (const guchar*) simulation_code, strlen (simulation_code) + 1);
+
+	cache_key = g_strdup (g_checksum_get_string (checksum));
+
+	g_checksum_free (checksum);
+	g_free (header);
+
+	return cache_key;
+}
+
+/* Returns NULL if the cache file doesn't exist, is stale or is invalid. The returned ASTs haven't been checked. */
+static GPtrArray/*<DfsmAstObject>*/ *
+load_compiled_machine (const gchar *cache_path, const gchar *simulation_code, const gchar *introspection_xml, GDBusNodeInfo *dbus_node_info)
+{
+	GMappedFile *mapped_file;
+	DfsmDeserialiser deserialiser;
+	const gchar *magic, *cached_simulation_code, *cached_introspection_xml;
+	guint32 version, n_objects, i;
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array = NULL;
+	GError *child_error = NULL;
+
+	mapped_file = g_mapped_file_new (cache_path, FALSE, &child_error);
+
+	if (child_error != NULL) {
+		/* A missing file is just a cache miss. */
+		if (g_error_matches (child_error, G_FILE_ERROR, G_FILE_ERROR_NOENT) == FALSE) {
+			g_debug ("Error mapping compiled machine ‘%s’: %s", cache_path, child_error->message);
+		}
+
+		g_error_free (child_error);
+
+		return NULL;
+	}
+
+	/* The deserialisers copy everything they keep out of the mapping, so it can be unmapped once they're done. */
+	dfsm_internal_deserialiser_init (&deserialiser, (const guint8*) g_mapped_file_get_contents (mapped_file),
+	                                 g_mapped_file_get_length (mapped_file));
+
+	if (dfsm_internal_deserialise_string (&deserialiser, &magic) == FALSE || strcmp (magic, COMPILED_MACHINE_MAGIC) != 0 ||
+	    dfsm_internal_deserialise_uint32 (&deserialiser, &version) == FALSE || version != COMPILED_MACHINE_VERSION ||
+	    dfsm_internal_deserialise_bytestring (&deserialiser, &cached_simulation_code) == FALSE ||
+	    strcmp (cached_simulation_code, simulation_code) != 0 ||
+	    dfsm_internal_deserialise_bytestring (&deserialiser, &cached_introspection_xml) == FALSE ||
+	    strcmp (cached_introspection_xml, introspection_xml) != 0) {
+		g_debug ("Ignoring stale compiled machine ‘%s’.", cache_path);
+		goto done;
+	}
+
+	if (dfsm_internal_deserialise_length (&deserialiser, &n_objects) == FALSE) {
+		g_debug ("Ignoring invalid compiled machine ‘%s’.", cache_path);
+		goto done;
+	}
+
+	ast_object_array = g_ptr_array_new_full (n_objects, g_object_unref);
+
+	for (i = 0; i < n_objects; i++) {
+		DfsmAstObject *ast_object;
+
+		ast_object = dfsm_ast_object_deserialise (&deserialiser, dbus_node_info);
+
+		if (ast_object == NULL) {
+			break;
+		}
+
+		g_ptr_array_add (ast_object_array, ast_object);
+	}
+
+	/* Trailing garbage means the file's corrupt, too. */
+	if (i < n_objects || dfsm_internal_deserialiser_is_finished (&deserialiser) == FALSE) {
+		g_debug ("Ignoring invalid compiled machine ‘%s’.", cache_path);
+
+		g_ptr_array_unref (ast_object_array);
+		ast_object_array = NULL;
+	}
+
+done:
+	g_mapped_file_unref (mapped_file);
+
+	return ast_object_array;
+}
+
+/* Must be called before the ASTs are checked. */
+static GByteArray *
+serialise_compiled_machine (const gchar *simulation_code, const gchar *introspection_xml, GPtrArray/*<DfsmAstObject>*/ *ast_object_array)
+{
+	GByteArray *compiled_machine;
+	guint i;
+
+	compiled_machine = g_byte_array_new ();
+
+	dfsm_internal_serialise_string (compiled_machine, COMPILED_MACHINE_MAGIC);
+	dfsm_internal_serialise_uint32 (compiled_machine, COMPILED_MACHINE_VERSION);
+	dfsm_internal_serialise_string (compiled_machine, simulation_code);
+	dfsm_internal_serialise_string (compiled_machine, introspection_xml);
+	dfsm_internal_serialise_uint32 (compiled_machine, ast_object_array->len);
+
+	for (i = 0; i < ast_object_array->len; i++) {
+		dfsm_ast_object_serialise (g_ptr_array_index (ast_object_array, i), compiled_machine);
+	}
+
+	return compiled_machine;
+}
+
+typedef struct {
+	gchar *path;
+	time_t mtime;
+} CacheFile;
+
+static gint
+cache_file_compare_mtime (const CacheFile *a, const CacheFile *b)
+{
+	return (a->mtime < b->mtime) ? -1 : (a->mtime > b->mtime) ? 1 : 0;
+}
+
+/* Delete the least recently used compiled machines from @directory until it holds at most COMPILED_MACHINE_CACHE_SIZE of them. A file's
+ * modification time is updated whenever it's loaded, so this is the time it was last used. Other files in @directory are left alone. */
+static void
+prune_compiled_machine_cache (const gchar *directory)
+{
+	GDir *dir;
+	const gchar *name;
+	GArray/*<CacheFile>*/ *files;
+	guint i;
+
+	dir = g_dir_open (directory, 0, NULL);
+
+	if (dir == NULL) {
+		return;
+	}
+
+	files = g_array_new (FALSE, FALSE, sizeof (CacheFile));
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		CacheFile file;
+		GStatBuf stat_buf;
+
+		if (g_str_has_suffix (name, COMPILED_MACHINE_SUFFIX) == FALSE) {
+			continue;
+		}
+
+		file.path = g_build_filename (directory, name, NULL);
+
+		if (g_stat (file.path, &stat_buf) != 0) {
+			g_free (file.path);
+			continue;
+		}
+
+		file.mtime = stat_buf.st_mtime;
+		g_array_append_val (files, file);
+	}
+
+	g_dir_close (dir);
+
+	if (files->len > COMPILED_MACHINE_CACHE_SIZE) {
+		g_array_sort (files, (GCompareFunc) cache_file_compare_mtime);
+
+		for (i = 0; i < files->len - COMPILED_MACHINE_CACHE_SIZE; i++) {
+			const gchar *path = g_array_index (files, CacheFile, i).path;
+
+			if (g_unlink (path) != 0) {
+				g_debug ("Error deleting compiled machine ‘%s’: %s", path, g_strerror (errno));
+			}
+		}
+	}
+
+	for (i = 0; i < files->len; i++) {
+		g_free (g_array_index (files, CacheFile, i).path);
+	}
+
+	g_array_free (files, TRUE);
+}
+
+/* Failing to write to the cache isn't fatal: the machine will just be parsed from scratch next time. */
+static void
+save_compiled_machine (const gchar *cache_path, GByteArray *compiled_machine)
+{
+	gchar *directory;
+	GError *child_error = NULL;
+
+	directory = g_path_get_dirname (cache_path);
+
+	if (g_mkdir_with_parents (directory, 0700) != 0) {
+		g_debug ("Error creating compiled machine cache directory ‘%s’: %s", directory, g_strerror (errno));
+		g_free (directory);
+
+		return;
+	}
+
+	/* This writes to a temporary file and renames it over the old one, so a concurrent reader's mapping is never modified underneath it. */
+	if (g_file_set_contents (cache_path, (const gchar*) compiled_machine->data, compiled_machine->len, &child_error) == FALSE) {
+		g_debug ("Error writing compiled machine ‘%s’: %s", cache_path, child_error->message);
+		g_error_free (child_error);
+	} else {
+		prune_compiled_machine_cache (directory);
+	}
+
+	g_free (directory);
+}
+
+/* Each object has its own environment, so the objects can be checked independently, in parallel. The checks are split into the same two phases as
+ * when checking sequentially: every object must pass dfsm_ast_object_initial_check() before any is passed to dfsm_ast_node_check(). Within a phase,
+ * the error from the first failing object in the array is reported, so the error doesn't depend on how the checks were scheduled. */
+typedef struct {
+	DfsmAstObject *ast_object;
+	GError *error;
+} ObjectCheckData;
+
+static void
+initial_check_cb (ObjectCheckData *data, gpointer user_data)
+{
+	dfsm_ast_object_initial_check (data->ast_object, &data->error);
+}
+
+static void
+node_check_cb (ObjectCheckData *data, gpointer user_data)
+{
+	dfsm_ast_node_check (DFSM_AST_NODE (data->ast_object), dfsm_ast_object_get_environment (data->ast_object), &data->error);
+}
+
+static gboolean
+run_check_phase (ObjectCheckData *check_data, guint n_objects, GFunc check_func, GError **error)
+{
+	GThreadPool *pool = NULL;
+	guint i;
+	gboolean success = TRUE;
+
+	/* There's no point spinning up the thread pool for a single object. If it can't be created, fall back to checking sequentially. */
+	if (n_objects > 1) {
+		pool = g_thread_pool_new (check_func, NULL, MIN (n_objects, g_get_num_processors ()), FALSE, NULL);
+	}
+
+	for (i = 0; i < n_objects; i++) {
+		if (pool != NULL) {
+			g_thread_pool_push (pool, &check_data[i], NULL);
+		} else {
+			check_func (&check_data[i], NULL);
+		}
+	}
+
+	if (pool != NULL) {
+		/* Wait for all the checks to finish. */
+		g_thread_pool_free (pool, FALSE, TRUE);
+	}
+
+	for (i = 0; i < n_objects; i++) {
+		if (check_data[i].error == NULL) {
+			continue;
+		}
+
+		if (success == TRUE) {
+			/* Error! */
+			g_propagate_error (error, check_data[i].error);
+			success = FALSE;
+		} else {
+			g_error_free (check_data[i].error);
+		}
+
+		check_data[i].error = NULL;
+	}
+
+	return success;
+}
+
+static gboolean
+check_ast_objects (GPtrArray/*<DfsmAstObject>*/ *ast_object_array, GError **error)
+{
+	ObjectCheckData *check_data;
+	guint i;
+	gboolean success;
+
+	check_data = g_new0 (ObjectCheckData, ast_object_array->len);
+
+	for (i = 0; i < ast_object_array->len; i++) {
+		check_data[i].ast_object = g_ptr_array_index (ast_object_array, i);
+	}
+
+	success = run_check_phase (check_data, ast_object_array->len, (GFunc) initial_check_cb, error) == TRUE &&
+	          run_check_phase (check_data, ast_object_array->len, (GFunc) node_check_cb, error) == TRUE;
+
+	g_free (check_data);
+
+	return success;
+}
+
+/* Build the ASTs for @simulation_code against the interfaces in @dbus_node_info. @introspection_xml is only used to look up the ASTs in the compiled
+ * machine cache, so may be %NULL if the cache is disabled. */
+static GPtrArray/*<DfsmAstObject>*/ *
+asts_from_node_info (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info, const gchar *introspection_xml, GError **error)
+{
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	gchar *cache_path = NULL;
+	GByteArray *compiled_machine = NULL;
+	GError *child_error = NULL;
+
+	/* Try the compiled machine cache first. Its contents were checked successfully before being written, so if they fail checking now the file
+	 * must be corrupt, and it's ignored. */
+	if (cache_directory != NULL && introspection_xml != NULL) {
+		gchar *cache_key, *cache_filename;
+
+		cache_key = build_compiled_machine_key (simulation_code, introspection_xml);
+		cache_filename = g_strconcat (cache_key, COMPILED_MACHINE_SUFFIX, NULL);
+		cache_path = g_build_filename (cache_directory, cache_filename, NULL);
+		g_free (cache_filename);
+		g_free (cache_key);
+
+		ast_object_array = load_compiled_machine (cache_path, simulation_code, introspection_xml, dbus_node_info);
+
+		/* The checks still have to be run in full on a cache hit: as well as validating the file, they compute state which isn't serialised,
+		 * such as which expressions are constant. */
+		if (ast_object_array != NULL) {
+			if (check_ast_objects (ast_object_array, NULL) == TRUE) {
+				/* Mark the file as recently used, so it's not the next to be pruned. */
+				g_utime (cache_path, NULL);
+
+				g_free (cache_path);
+
+				return ast_object_array;
+			}
+
+			g_debug ("Ignoring compiled machine ‘%s’ which failed checking.", cache_path);
+			g_ptr_array_unref (ast_object_array);
+		}
+	}
+
+	/* Parse the source code to get an array of ASTs. */
+	ast_object_array = dfsm_bison_parse (dbus_node_info, simulation_code, &child_error);
+
+	if (child_error != NULL) {
+		/* Error! */
+		g_propagate_error (error, child_error);
+
+		g_free (cache_path);
+
+		return NULL;
+	}
+
+	/* Serialise the ASTs before checking them, since checking modifies them. */
+	if (cache_path != NULL) {
+		compiled_machine = serialise_compiled_machine (simulation_code, introspection_xml, ast_object_array);
+	}
+
+	/* Check all the objects. */
+	if (check_ast_objects (ast_object_array, &child_error) == FALSE) {
+		/* Error! */
+		g_propagate_error (error, child_error);
+
+		g_ptr_array_unref (ast_object_array);
+		ast_object_array = NULL;
+	} else if (compiled_machine != NULL) {
+		save_compiled_machine (cache_path, compiled_machine);
+	}
+
+	if (compiled_machine != NULL) {
+		g_byte_array_unref (compiled_machine);
+	}
+
+	g_free (cache_path);
+
+	return ast_object_array;
+}
+
+/* Build a DfsmObject for each of the checked ASTs in @ast_object_array. */
+static GPtrArray/*<DfsmObject>*/ *
+objects_from_asts (GPtrArray/*<DfsmAstObject>*/ *ast_object_array)
+{
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	guint i;
+
+	object_array = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (i = 0; i < ast_object_array->len; i++) {
+		DfsmAstObject *ast_object;
+		DfsmMachine *machine;
+		DfsmObject *object;
+
+		ast_object = g_ptr_array_index (ast_object_array, i);
+
+		/* Build the machine and object wrapper. */
+		machine = _dfsm_machine_new (dfsm_ast_object_get_environment (ast_object), dfsm_ast_object_get_state_names (ast_object),
+		                             dfsm_ast_object_get_transitions (ast_object));
+		object = _dfsm_object_new (machine, dfsm_ast_object_get_object_path (ast_object), dfsm_ast_object_get_well_known_bus_names (ast_object),
+		                           dfsm_ast_object_get_interface_names (ast_object));
+
+		g_ptr_array_add (object_array, g_object_ref (object));
+
+		g_object_unref (object);
+		g_object_unref (machine);
+	}
+
+	return object_array;
+}
+
+/**
+ * dfsm_object_factory_asts_from_data:
+ * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
+ * @introspection_xml: D-Bus introspection XML describing all the interfaces referenced by @simulation_code
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Parses the given @simulation_code and constructs one or more #DfsmAstObject<!-- -->s from it, each of which is the AST of the code representing that
+ * simulated D-Bus object. The given @introspection_xml should be a fully formed introspection XML document which, at a minimum, describes all the
+ * D-Bus interfaces implemented by all the objects defined in @simulation_code.
+ *
+ * If a cache directory has been set using dfsm_object_factory_set_cache_directory(), the ASTs are loaded from the compiled machine cache instead of
+ * parsing @simulation_code, if possible. They are still checked in full.
+ *
+ * Return value: (transfer full): an array of #DfsmAstObject<!-- -->s, each of which must be freed using g_object_unref()
+ */
+GPtrArray/*<DfsmAstObject>*/ *
+dfsm_object_factory_asts_from_data (const gchar *simulation_code, const gchar *introspection_xml, GError **error)
+{
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	GDBusNodeInfo *dbus_node_info;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (simulation_code != NULL, NULL);
+	g_return_val_if_fail (introspection_xml != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* Load the D-Bus interface introspection info. */
+	dbus_node_info = g_dbus_node_info_new_for_xml (introspection_xml, &child_error);
+
+	if (child_error != NULL) {
+		/* Error! */
+		g_propagate_error (error, child_error);
+		return NULL;
+	}
+
+	ast_object_array = asts_from_node_info (simulation_code, dbus_node_info, introspection_xml, error);
+
+	g_dbus_node_info_unref (dbus_node_info);
+
+	return ast_object_array;
+}
+
+/**
+ * dfsm_object_factory_asts_from_node_info:
+ * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
+ * @dbus_node_info: parsed D-Bus introspection data describing all the interfaces referenced by @simulation_code
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Equivalent to dfsm_object_factory_asts_from_data(), but takes introspection data which has already been parsed, so that it can be shared
+ * between several calls. @dbus_node_info isn't modified, so it may be used from several threads at once.
+ *
+ * Return value: (transfer full): an array of #DfsmAstObject<!-- -->s, each of which must be freed using g_object_unref()
+ */
+GPtrArray/*<DfsmAstObject>*/ *
+dfsm_object_factory_asts_from_node_info (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info, GError **error)
+{
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	gchar *introspection_xml = NULL;
+
+	g_return_val_if_fail (simulation_code != NULL, NULL);
+	g_return_val_if_fail (dbus_node_info != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* The compiled machine cache is keyed on the introspection XML, so regenerate it from the node info. */
+	if (cache_directory != NULL) {
+		GString *xml_builder = g_string_new (NULL);
+
+		g_dbus_node_info_generate_xml (dbus_node_info, 0, xml_builder);
+		introspection_xml = g_string_free (xml_builder, FALSE);
+	}
+
+	ast_object_array = asts_from_node_info (simulation_code, dbus_node_info, introspection_xml, error);
+
+	g_free (introspection_xml);
+
+	return ast_object_array;
+}
+
+/**
+ * dfsm_object_factory_from_data:
+ * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
+ * @introspection_xml: D-Bus introspection XML describing all the interfaces referenced by @simulation_code
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Parses the given @simulation_code and constructs one or more #DfsmObject<!-- -->s from it, each of which will simulate a single D-Bus object on the
+ * bus once started using dfsm_object_register_on_bus(). The given @introspection_xml should be a fully formed introspection XML
+ * document which, at a minimum, describes all the D-Bus interfaces implemented by all the objects defined in @simulation_code.
+ *
+ * Return value: (transfer full): an array of #DfsmObject<!-- -->s, each of which must be freed using g_object_unref()
+ */
+GPtrArray/*<DfsmObject>*/ *
+dfsm_object_factory_from_data (const gchar *simulation_code, const gchar *introspection_xml, GError **error)
+{
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (simulation_code != NULL, NULL);
+	g_return_val_if_fail (introspection_xml != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* Load and parse the files into DfsmAstObjects. */
+	ast_object_array = dfsm_object_factory_asts_from_data (simulation_code, introspection_xml, &child_error);
+
+	if (child_error != NULL) {
+		/* Error! */
+		g_propagate_error (error, child_error);
+
+		return NULL;
+	}
+
+	/* For each of the AST objects, build a proper DfsmObject. */
+	object_array = objects_from_asts (ast_object_array);
+	g_ptr_array_unref (ast_object_array);
+
+	return object_array;
+}
+
+/**
+ * dfsm_object_factory_from_node_info:
+ * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
+ * @dbus_node_info: parsed D-Bus introspection data describing all the interfaces referenced by @simulation_code
+ * @error: (allow-none): a #GError, or %NULL
+ *
+ * Equivalent to dfsm_object_factory_from_data(), but takes introspection data which has already been parsed, so that it can be shared between
+ * several calls. See dfsm_object_factory_asts_from_node_info().
+ *
+ * Return value: (transfer full): an array of #DfsmObject<!-- -->s, each of which must be freed using g_object_unref()
+ */
+GPtrArray/*<DfsmObject>*/ *
+dfsm_object_factory_from_node_info (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info, GError **error)
+{
+	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	GError *child_error = NULL;
+
+	g_return_val_if_fail (simulation_code != NULL, NULL);
+	g_return_val_if_fail (dbus_node_info != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	ast_object_array = dfsm_object_factory_asts_from_node_info (simulation_code, dbus_node_info, &child_error);
+
+	if (child_error != NULL) {
+		/* Error! */
+		g_propagate_error (error, child_error);
+
+		return NULL;
+	}
+
+	object_array = objects_from_asts (ast_object_array);
+	g_ptr_array_unref (ast_object_array);
+
+	return object_array;
+}
+
+/**
+ * dfsm_object_factory_set_unfuzzed_transition_limit:
+ * @transition_limit: number of unfuzzed transitions to execute before enabling fuzzing and error-throwing transitions
+ *
+ * Set the number of unfuzzed transitions to execute before enabling fuzzing and error-throwing transitions, across all #DfsmObject<!-- -->s as an
+ * aggregate. May be zero.
+ */
+void
+dfsm_object_factory_set_unfuzzed_transition_limit (guint transition_limit)
+{
+	g_atomic_int_set (&unfuzzed_transition_limit, MIN (transition_limit, G_MAXINT));
+	g_atomic_int_set (&unfuzzed_transition_count, 0);
+}
+
+/* Decide whether to enable fuzzing for a transition which is about to be executed, counting it towards the unfuzzed transition limit if not. The
+ * check and the increment are a single atomic operation, so that two objects executing transitions concurrently can't both take the last unfuzzed
+ * transition. */
+static gboolean
+begin_transition (void)
+{
+	gint count;
+
+	do {
+		count = g_atomic_int_get (&unfuzzed_transition_count);
+
+		if (count >= g_atomic_int_get (&unfuzzed_transition_limit)) {
+			return TRUE;
+		}
+	} while (g_atomic_int_compare_and_exchange (&unfuzzed_transition_count, count, count + 1) == FALSE);
+
+	return FALSE;
+}
+
+/**
+ * dfsm_object_factory_set_cache_directory:
+ * @directory: (allow-none): directory to store compiled machines in, or %NULL to disable the compiled machine cache
+ *
+ * Set the directory used by the compiled machine cache. The cache is disabled by default. When it's enabled, dfsm_object_factory_asts_from_data()
+ * (and hence all the other factory functions) stores the parsed form of each set of simulation code and introspection XML which passes checking in
+ * a file in @directory, named after a hash of both inputs. When the same inputs are next loaded, the file is memory-mapped and the ASTs are rebuilt
+ * from it directly, rather than by parsing the simulation code. The ASTs are still checked in full, so a cache hit only saves lexing and parsing.
+ * Missing, stale and corrupt files are ignored. @directory is created if it doesn't exist. The least recently used compiled machines in
+ * @directory are deleted as new ones are written, so that it holds a bounded number of them.
+ *
+ * This is not thread safe, and should be called before any objects are created.
+ */
+void
+dfsm_object_factory_set_cache_directory (const gchar *directory)
+{
+	g_return_if_fail (directory == NULL || *directory != '\0');
+
+	g_free (cache_directory);
+	cache_directory = g_strdup (directory);
+}
+
+/**
+ * dfsm_object_instantiate:
+ * @self: a #DfsmObject to use as a template
+ * @object_path: the D-Bus object path for the new instance
+ *
+ * Create a new instance of @self, which will be exported as @object_path. The instance shares @self's checked simulation code, states and transitions,
+ * so is much cheaper to create than an object parsed from its own simulation code: it only stores its own machine state and the current values of its
+ * object variables, which start with the initial values given in the simulation code (regardless of the current values of @self's variables). This
+ * allows thousands of similar objects (such as contacts or channels) to be simulated from a single object definition. The shared code isn't modified
+ * when it's executed, so instances may be dispatched in the worker thread (see #DfsmObject:dispatch-in-worker-thread) independently of @self.
+ *
+ * The instance implements the same interfaces as @self, but doesn't own any well-known bus names. It may be created and destroyed at any time: call
+ * dfsm_object_register_on_bus() to export it and start its simulation, and dfsm_object_unregister_on_bus() to stop it again before destroying it.
+ *
+ * Instances may also be created and destroyed by the simulation itself, using <code>instantiate</code> and <code>destroy</code> statements in its
+ * transitions. Those instances are registered on the same connection as @self, and are unregistered along with it; see
+ * #DfsmObject::instance-created.
+ *
+ * Return value: (transfer full): a new #DfsmObject
+ */
+DfsmObject *
+dfsm_object_instantiate (DfsmObject *self, const gchar *object_path)
+{
+	DfsmObjectPrivate *priv;
+	DfsmEnvironment *environment;
+	DfsmMachine *machine;
+	GPtrArray/*<string>*/ *bus_names;
+	DfsmObject *instance;
+	guint32 seed;
+
+	g_return_val_if_fail (DFSM_IS_OBJECT (self), NULL);
+	g_return_val_if_fail (object_path != NULL && g_variant_is_object_path (object_path) == TRUE, NULL);
+
+	priv = self->priv;
+
+	environment = _dfsm_environment_new_instance (dfsm_machine_get_environment (priv->machine));
+
+	/* Seed the instance from this object's generator, so that it behaves reproducibly if this object's been seeded. The generator's also used
+	 * by the machine, which may be executing in the worker thread. */
+	g_mutex_lock (&priv->machine_lock);
+	seed = g_rand_int (dfsm_internal_environment_get_rand (dfsm_machine_get_environment (priv->machine)));
+	g_mutex_unlock (&priv->machine_lock);
+
+	dfsm_environment_set_random_seed (environment, seed);
+
+	machine = _dfsm_machine_new_instance (priv->machine, environment);
+	bus_names = g_ptr_array_new_with_free_func (g_free);
+
+	instance = _dfsm_object_new (machine, object_path, bus_names, priv->interfaces);
+	instance->priv->dispatch_in_worker_thread = priv->dispatch_in_worker_thread;
+
+	g_ptr_array_unref (bus_names);
+	g_object_unref (machine);
+	g_object_unref (environment);
+
+	return instance;
+}
+
+static gboolean
+dfsm_object_dbus_method_call_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *method_name,
+                                      GVariant *parameters, gboolean enable_fuzzing)
+{
+	dfsm_machine_call_method (obj->priv->machine, output_sequence, interface_name, method_name, parameters, enable_fuzzing);
+	return TRUE;
+}
+
+static gboolean
+notify_dbus_activity_count_cb (DfsmObject *self)
+{
+	g_atomic_int_set (&self->priv->activity_notify_pending, FALSE);
+	g_object_notify (G_OBJECT (self), "dbus-activity-count");
+
+	return FALSE;
+}
+
+/* Count a D-Bus activity. If this is called from the GDBus worker thread, the property notification is deferred to the main context the object
+ * was registered in (so that signal handlers don't have to be thread-safe), and is coalesced with any other notifications already queued. */
+static void
+count_dbus_activity (DfsmObject *self, gboolean in_worker_thread)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	GSource *source;
+
+	g_atomic_int_inc (&priv->dbus_activity_count);
+
+	if (in_worker_thread == FALSE) {
+		g_object_notify (G_OBJECT (self), "dbus-activity-count");
+		return;
+	}
+
+	if (g_atomic_int_compare_and_exchange (&priv->activity_notify_pending, FALSE, TRUE) == FALSE) {
+		/* Already queued. */
+		return;
+	}
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, (GSourceFunc) notify_dbus_activity_count_cb, g_object_ref (self), g_object_unref);
+	g_source_attach (source, priv->main_context);
+	g_source_unref (source);
+}
+
+static gboolean
+thaw_machine_notify_cb (DfsmMachine *machine)
+{
+	g_object_thaw_notify (G_OBJECT (machine));
+
+	return FALSE;
+}
+
+/* Undo a g_object_freeze_notify() on the machine from the worker thread, emitting any queued notifications in the main context. */
+static void
+thaw_machine_notify_in_main_context (DfsmObject *self)
+{
+	GSource *source;
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, (GSourceFunc) thaw_machine_notify_cb, g_object_ref (self->priv->machine), g_object_unref);
+	g_source_attach (source, self->priv->main_context);
+	g_source_unref (source);
+}
+
+typedef struct {
+	DfsmObject *object; /* the object whose transition instantiated or destroyed the instance */
+	gchar *object_path;
+	gboolean destroy;
+} InstanceChange;
+
+static void
+instance_change_free (InstanceChange *change)
+{
+	g_object_unref (change->object);
+	g_free (change->object_path);
+	g_slice_free (InstanceChange, change);
+}
+
+/* Unregister @instance and forget about it. It must have been created from @template_object by apply_instance_change(). */
+static void
+destroy_instance (DfsmObject *template_object, DfsmObject *instance)
+{
+	g_object_ref (instance);
+
+	g_hash_table_remove (template_object->priv->instances, instance->priv->object_path);
+	instance->priv->template_object = NULL;
+	dfsm_object_unregister_on_bus (instance);
+
+	g_signal_emit (template_object, object_signals[SIGNAL_INSTANCE_DESTROYED], 0, instance);
+
+	g_object_unref (instance);
+}
+
+static void
+destroy_all_instances (DfsmObject *self)
+{
+	GHashTableIter iter;
+	DfsmObject *instance;
+
+	if (self->priv->instances == NULL) {
+		return;
+	}
+
+	/* destroy_instance() removes the instance from the table, so restart the iteration each time. */
+	while (g_hash_table_size (self->priv->instances) > 0) {
+		g_hash_table_iter_init (&iter, self->priv->instances);
+		g_hash_table_iter_next (&iter, NULL, (gpointer*) &instance);
+		destroy_instance (self, instance);
+	}
+}
+
+static void
+instance_registered_cb (DfsmObject *instance, GAsyncResult *async_result, gpointer user_data)
+{
+	DfsmObject *template_object = instance->priv->template_object;
+	GError *child_error = NULL;
+
+	dfsm_object_register_on_bus_finish (instance, async_result, &child_error);
+
+	if (child_error != NULL) {
+		g_warning (_("Runtime error in simulation: couldn't register object instance ‘%s’: %s"), instance->priv->object_path,
+		           child_error->message);
+		g_error_free (child_error);
+
+		/* Forget about the instance, unless it's already been destroyed. */
+		if (template_object != NULL) {
+			destroy_instance (template_object, instance);
+		}
+	}
+}
+
+/* Apply an instantiate or destroy statement's effect. This is always called in the main context the object was registered in. */
+static gboolean
+apply_instance_change (InstanceChange *change)
+{
+	DfsmObject *template_object, *instance;
+	DfsmObjectPrivate *priv;
+
+	/* Instances created by transitions in other instances belong to the object they were all created from, so that they share a single
+	 * namespace of object paths and are all destroyed with it. */
+	template_object = (change->object->priv->template_object != NULL) ? change->object->priv->template_object : change->object;
+	priv = template_object->priv;
+
+	/* Drop changes made just before the object was unregistered (or destroyed). */
+	if (priv->connection == NULL) {
+		g_debug ("Ignoring %s of object instance ‘%s’ after the simulation stopped.", (change->destroy == TRUE) ? "destruction" : "instantiation",
+		         change->object_path);
+		return FALSE;
+	}
+
+	instance = (priv->instances != NULL) ? g_hash_table_lookup (priv->instances, change->object_path) : NULL;
+
+	if (change->destroy == TRUE) {
+		if (instance == NULL) {
+			g_warning (_("Runtime error in simulation: couldn't destroy object ‘%s’: it isn't an instance created by a transition."),
+			           change->object_path);
+			return FALSE;
+		}
+
+		g_debug ("Destroying object instance ‘%s’.", change->object_path);
+		destroy_instance (template_object, instance);
+
+		return FALSE;
+	}
+
+	if (instance != NULL || strcmp (change->object_path, priv->object_path) == 0) {
+		g_warning (_("Runtime error in simulation: couldn't instantiate object ‘%s’: an object already exists at that path."),
+		           change->object_path);
+		return FALSE;
+	}
+
+	if (priv->instances == NULL) {
+		priv->instances = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+	}
+
+	g_debug ("Instantiating object ‘%s’ as ‘%s’.", priv->object_path, change->object_path);
+
+	instance = dfsm_object_instantiate (template_object, change->object_path);
+	instance->priv->template_object = template_object;
+	g_hash_table_insert (priv->instances, instance->priv->object_path, instance);
+
+	dfsm_object_register_on_bus (instance, priv->connection, (GAsyncReadyCallback) instance_registered_cb, NULL);
+	g_signal_emit (template_object, object_signals[SIGNAL_INSTANCE_CREATED], 0, instance);
+
+	return FALSE;
+}
+
+/* Called by the object's output sequences for each instantiate or destroy statement they output. This may be called from the GDBus worker thread,
+ * and registering objects has to be done in the main context anyway, so the change is applied from an idle callback. ->machine_lock is held. */
+static void
+queue_instance_change (const gchar *object_path, gboolean destroy, DfsmObject *self)
+{
+	InstanceChange *change;
+	GSource *source;
+
+	if (self->priv->main_context == NULL) {
+		g_debug ("Ignoring %s of object instance ‘%s’ on an unregistered object.", (destroy == TRUE) ? "destruction" : "instantiation",
+		         object_path);
+		return;
+	}
+
+	change = g_slice_new (InstanceChange);
+	change->object = g_object_ref (self);
+	change->object_path = g_strdup (object_path);
+	change->destroy = destroy;
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, (GSourceFunc) apply_instance_change, change, (GDestroyNotify) instance_change_free);
+	g_source_attach (source, self->priv->main_context);
+	g_source_unref (source);
+}
+
+/* Toggle notification for the in-flight output sequence, called whenever a reference other than ours is taken or the last such reference is
+ * dropped. This may be called from any thread. */
+static void
+output_sequence_toggle_notify_cb (DfsmObject *self, GObject *output_sequence, gboolean is_last_ref)
+{
+	g_atomic_int_set (&self->priv->output_sequence_shared, (is_last_ref == TRUE) ? FALSE : TRUE);
+}
+
+/* Get an output sequence for a dispatch, reusing the spare one if possible. At most one of @invocation and @message may be non-%NULL. Our reference
+ * to the sequence is a toggle reference, so that release_output_sequence() can tell whether anything else has kept hold of it.
+ * ->machine_lock must be held. */
+static DfsmOutputSequence *
+acquire_output_sequence (DfsmObject *self, GDBusMethodInvocation *invocation, GDBusMessage *message)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	DfsmDBusOutputSequence *output_sequence;
+
+	if (priv->spare_output_sequence != NULL) {
+		output_sequence = priv->spare_output_sequence;
+		priv->spare_output_sequence = NULL;
+
+		dfsm_internal_dbus_output_sequence_reset (output_sequence, invocation, message);
+	} else {
+		if (message != NULL) {
+			output_sequence = dfsm_dbus_output_sequence_new_for_message (priv->connection, priv->object_path, message);
+		} else {
+			output_sequence = dfsm_dbus_output_sequence_new (priv->connection, priv->object_path, invocation);
+		}
+
+		dfsm_internal_dbus_output_sequence_set_instance_func (output_sequence, (DfsmInstanceFunc) queue_instance_change, self);
+	}
+
+	g_atomic_int_set (&priv->output_sequence_shared, FALSE);
+	g_object_add_toggle_ref (G_OBJECT (output_sequence), (GToggleNotify) output_sequence_toggle_notify_cb, self);
+	g_object_unref (output_sequence);
+
+	return DFSM_OUTPUT_SEQUENCE (output_sequence);
+}
+
+/* Release an output sequence returned by acquire_output_sequence(), keeping it as the spare if nothing else (such as a signal handler) still holds a
+ * reference to it, and if it's for the connection the object's currently registered on. ->machine_lock must be held. */
+static void
+release_output_sequence (DfsmObject *self, DfsmOutputSequence *output_sequence)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	DfsmDBusOutputSequence *dbus_output_sequence = DFSM_DBUS_OUTPUT_SEQUENCE (output_sequence);
+
+	if (priv->spare_output_sequence == NULL && g_atomic_int_get (&priv->output_sequence_shared) == FALSE && priv->connection != NULL &&
+	    dfsm_internal_dbus_output_sequence_get_connection (dbus_output_sequence) == priv->connection) {
+		/* Swap the toggle reference for a normal one. */
+		priv->spare_output_sequence = g_object_ref (dbus_output_sequence);
+		g_object_remove_toggle_ref (G_OBJECT (output_sequence), (GToggleNotify) output_sequence_toggle_notify_cb, self);
+
+		/* Drop the invocation or message now, rather than keeping it alive until the next dispatch. */
+		dfsm_internal_dbus_output_sequence_reset (dbus_output_sequence, NULL, NULL);
+	} else {
+		g_object_remove_toggle_ref (G_OBJECT (output_sequence), (GToggleNotify) output_sequence_toggle_notify_cb, self);
+	}
+}
+
+/* Give handlers of #DfsmObject::wrap-output-sequence the chance to replace @output_sequence for a dispatch. Returns a reference to the replacement,
+ * which must be dropped before @output_sequence is released; or %NULL if @output_sequence should be used as-is. The common case of nothing being
+ * connected doesn't touch @output_sequence's reference count, so doesn't mark it as shared. ->machine_lock must be held. */
+static DfsmOutputSequence *
+wrap_output_sequence (DfsmObject *self, DfsmOutputSequence *output_sequence)
+{
+	DfsmOutputSequence *wrapped_sequence = NULL;
+
+	if (g_signal_has_handler_pending (self, object_signals[SIGNAL_WRAP_OUTPUT_SEQUENCE], 0, TRUE) == TRUE) {
+		g_signal_emit (self, object_signals[SIGNAL_WRAP_OUTPUT_SEQUENCE], 0, output_sequence, &wrapped_sequence);
+	}
+
+	return wrapped_sequence;
+}
+
+/* Emit #DfsmObject::dispatched, if anything's listening. ->machine_lock must be held. */
+static void
+emit_dispatched (DfsmObject *self, DfsmObjectDispatchKind kind, DfsmOutputSequence *output_sequence, const gchar *interface_name,
+                 const gchar *member_name, GVariant *value, gboolean result)
+{
+	if (g_signal_has_handler_pending (self, object_signals[SIGNAL_DISPATCHED], 0, TRUE) == TRUE) {
+		g_signal_emit (self, object_signals[SIGNAL_DISPATCHED], 0, (guint) kind, output_sequence, interface_name, member_name, value, result);
+	}
+}
+
+/* Handle a method call, either from the GDBus vtable (in which case @invocation is non-%NULL and we're in the main context) or from the worker
+ * thread filter (in which case @message is non-%NULL and replies have to be sent manually). */
+static void
+handle_method_call (DfsmObject *self, GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
+                    const gchar *method_name, GVariant *parameters, GDBusMethodInvocation *invocation, GDBusMessage *message)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	gchar *parameters_string;
+	DfsmOutputSequence *output_sequence, *wrapped_sequence, *dispatch_sequence;
+	gboolean method_call_handled = FALSE;
+	GError *child_error = NULL;
+
+	g_assert ((invocation == NULL) != (message == NULL));
+
+	/* Debug output. */
+	parameters_string = g_variant_print (parameters, FALSE);
+	g_debug ("Method call from ‘%s’ to method ‘%s’ of interface ‘%s’ on object ‘%s’. Parameters: %s", sender, method_name, interface_name,
+	         object_path, parameters_string);
+	g_free (parameters_string);
+
+	/* Count the activity. */
+	count_dbus_activity (self, (message != NULL) ? TRUE : FALSE);
+
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "method-call", method_name, object_path);
+
+	/* Property notifications from the machine (such as DfsmMachine:target-reached) must only be emitted in the main context, since their handlers
+	 * needn't be thread-safe. When dispatching in the worker thread, queue them up and emit them from an idle callback afterwards. */
+	if (message != NULL) {
+		g_object_freeze_notify (G_OBJECT (priv->machine));
+	}
+
+	/* Pass the method call through to the DFSM. */
+	g_mutex_lock (&priv->machine_lock);
+
+	output_sequence = acquire_output_sequence (self, invocation, message);
+	wrapped_sequence = wrap_output_sequence (self, output_sequence);
+	dispatch_sequence = (wrapped_sequence != NULL) ? wrapped_sequence : output_sequence;
+
+	g_signal_emit (self, object_signals[SIGNAL_DBUS_METHOD_CALL], g_quark_from_string (method_name),
+	               dispatch_sequence, interface_name, method_name, parameters, begin_transition (), &method_call_handled);
+
+	/* In any case, the method call should fall through to this class' default implementation. */
+	g_assert (method_call_handled == TRUE);
+
+	emit_dispatched (self, DFSM_OBJECT_DISPATCH_METHOD_CALL, dispatch_sequence, interface_name, method_name, parameters, method_call_handled);
+
+	/* Output the effect sequence resulting from the method call. */
+	dfsm_output_sequence_output (dispatch_sequence, &child_error);
+
+	g_clear_object (&wrapped_sequence);
+	release_output_sequence (self, output_sequence);
+
+	g_mutex_unlock (&priv->machine_lock);
+
+	if (message != NULL) {
+		thaw_machine_notify_in_main_context (self);
+	}
+
+	if (child_error != NULL) {
+		/* Runtime error. Replace it with a generic D-Bus error so as not to expose internals of the
+		 * simulator to programs under test. */
+		g_warning (_("Runtime error in simulation while handling D-Bus method call ‘%s’: %s"), method_name, child_error->message);
+
+		if (invocation != NULL) {
+			g_dbus_method_invocation_return_dbus_error (invocation, "org.freedesktop.DBus.Error.Failed", child_error->message);
+		} else if ((g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0) {
+			GDBusMessage *reply;
+
+			reply = g_dbus_message_new_method_error_literal (message, "org.freedesktop.DBus.Error.Failed", child_error->message);
+			g_dbus_connection_send_message (connection, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+			g_object_unref (reply);
+		}
+
+		g_clear_error (&child_error);
+	}
+
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "method-call", method_name, object_path);
+}
+
+static void
+dfsm_object_dbus_method_call (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
+                              const gchar *method_name, GVariant *parameters, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	handle_method_call (DFSM_OBJECT (user_data), connection, sender, object_path, interface_name, method_name, parameters, invocation, NULL);
+}
+
+/* Look up the introspection data for one of the object's interfaces, or return %NULL if the object doesn't implement @interface_name. The environment's
+ * interfaces are instantiated from priv->interfaces and are immutable, so this is safe to call from the worker thread. */
+static GDBusInterfaceInfo *
+look_up_interface_info (DfsmObject *self, const gchar *interface_name)
+{
+	GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces;
+	guint i;
+
+	interfaces = dfsm_environment_get_interfaces (dfsm_machine_get_environment (self->priv->machine));
+
+	for (i = 0; i < interfaces->len; i++) {
+		if (strcmp (interface_name, ((GDBusInterfaceInfo*) g_ptr_array_index (interfaces, i))->name) == 0) {
+			return (GDBusInterfaceInfo*) g_ptr_array_index (interfaces, i);
+		}
+	}
+
+	return NULL;
+}
+
+/* Return a reference to the cached body of a GetAll reply for @interface_info, rebuilding it first if any of the object variables backing the
+ * interface's readable properties have been written since it was built. Writes to other variables don't invalidate the cache. Must be called with
+ * priv->machine_lock held. */
+static GVariant *
+dup_get_all_reply_body (DfsmObject *self, GDBusInterfaceInfo *interface_info)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	DfsmEnvironment *environment;
+	PropertiesCacheEntry *entry;
+	GVariantBuilder builder;
+	guint serial, i;
+
+	environment = dfsm_machine_get_environment (priv->machine);
+	serial = dfsm_environment_get_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT);
+
+	entry = g_hash_table_lookup (priv->properties_cache, interface_info->name);
+
+	if (entry == NULL) {
+		entry = g_slice_new0 (PropertiesCacheEntry);
+		g_hash_table_insert (priv->properties_cache, g_strdup (interface_info->name), entry);
+	}
+
+	/* If any object variables have been written since the cache was last validated, check whether they back any of our properties. */
+	if (entry->reply_body != NULL && entry->serial != serial && interface_info->properties != NULL) {
+		for (i = 0; interface_info->properties[i] != NULL; i++) {
+			GDBusPropertyInfo *property_info = interface_info->properties[i];
+
+			if ((property_info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE) != 0 &&
+			    dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, property_info->name) > entry->serial) {
+				g_variant_unref (entry->reply_body);
+				entry->reply_body = NULL;
+				break;
+			}
+		}
+	}
+
+	if (entry->reply_body == NULL) {
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("(a{sv})"));
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+
+		for (i = 0; interface_info->properties != NULL && interface_info->properties[i] != NULL; i++) {
+			GDBusPropertyInfo *property_info = interface_info->properties[i];
+			GVariant *value;
+
+			if ((property_info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE) == 0) {
+				continue;
+			}
+
+			value = dfsm_environment_dup_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, property_info->name);
+			g_variant_builder_add (&builder, "{sv}", property_info->name, value);
+			g_variant_unref (value);
+		}
+
+		g_variant_builder_close (&builder);
+		entry->reply_body = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+		/* Serialise the body now, so that each reply only has to copy the serialised data. */
+		g_variant_get_data (entry->reply_body);
+	}
+
+	entry->serial = serial;
+
+	return g_variant_ref (entry->reply_body);
+}
+
+static GVariant *handle_get_property (DfsmObject *self, const gchar *sender, const gchar *interface_name, const gchar *property_name,
+                                     gboolean in_worker_thread, GError **error);
+static gboolean handle_set_property (DfsmObject *self, const gchar *sender, const gchar *interface_name, const gchar *property_name, GVariant *value,
+                                     gboolean in_worker_thread, GError **error);
+
+/* Send the reply to a method call handled by the connection filter: an error reply if @error is non-%NULL, or a normal reply with the given @body
+ * (which may be %NULL) otherwise. Nothing is sent if the caller didn't want a reply. A floating @body is consumed. */
+static void
+send_filter_reply (GDBusConnection *connection, GDBusMessage *message, GVariant *body, const GError *error)
+{
+	GDBusMessage *reply;
+
+	if (body != NULL) {
+		g_variant_ref_sink (body);
 	}
 
-	data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (async_result));
+	if ((g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0) {
+		if (error != NULL) {
+			reply = g_dbus_message_new_method_error_literal (message, "org.freedesktop.DBus.Error.Failed", error->message);
+		} else {
+			reply = g_dbus_message_new_method_reply (message);
+			g_dbus_message_set_body (reply, body);
+		}
+
+		g_dbus_connection_send_message (connection, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+		g_object_unref (reply);
+	}
 
-	return dfsm_object_factory_from_data (data->simulation_code, data->introspection_xml, error);
+	if (body != NULL) {
+		g_variant_unref (body);
+	}
 }
 
-/**
- * dfsm_object_factory_asts_from_data:
- * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
- * @introspection_xml: D-Bus introspection XML describing all the interfaces referenced by @simulation_code
- * @error: (allow-none): a #GError, or %NULL
- *
- * Parses the given @simulation_code and constructs one or more #DfsmAstObject<!-- -->s from it, each of which is the AST of the code representing that
- * simulated D-Bus object. The given @introspection_xml should be a fully formed introspection XML document which, at a minimum, describes all the
- * D-Bus interfaces implemented by all the objects defined in @simulation_code.
- *
- * Return value: (transfer full): an array of #DfsmAstObject<!-- -->s, each of which must be freed using g_object_unref()
- */
-GPtrArray/*<DfsmAstObject>*/ *
-dfsm_object_factory_asts_from_data (const gchar *simulation_code, const gchar *introspection_xml, GError **error)
+/* Handle an org.freedesktop.DBus.Properties.GetAll call from the connection filter by replying with the cached property values. If anything's
+ * connected to #DfsmObject::dbus-get-property for one of the properties, the cache is bypassed and the signal is emitted for each property
+ * instead, as GDBus would do. Either way, the call is answered in the worker thread so that it can't be overtaken by later method calls. */
+static GDBusMessage *
+filter_get_all_properties (DfsmObject *self, GDBusConnection *connection, GDBusMessage *message)
 {
-	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+	DfsmObjectPrivate *priv = self->priv;
+	GVariant *body, *reply_body = NULL;
+	const gchar *interface_name;
+	GDBusInterfaceInfo *interface_info;
+	gboolean use_cache = TRUE;
 	guint i;
-	GDBusNodeInfo *dbus_node_info;
 	GError *child_error = NULL;
 
-	g_return_val_if_fail (simulation_code != NULL, NULL);
-	g_return_val_if_fail (introspection_xml != NULL, NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* Load the D-Bus interface introspection info. */
-	dbus_node_info = g_dbus_node_info_new_for_xml (introspection_xml, &child_error);
+	body = g_dbus_message_get_body (message);
 
-	if (child_error != NULL) {
-		/* Error! */
-		g_propagate_error (error, child_error);
-		return NULL;
+	if (body == NULL || g_variant_is_of_type (body, G_VARIANT_TYPE ("(s)")) == FALSE) {
+		return message;
 	}
 
-	/* Parse the source code to get an array of ASTs. */
-	ast_object_array = dfsm_bison_parse (dbus_node_info, simulation_code, &child_error);
-
-	g_dbus_node_info_unref (dbus_node_info);
+	g_variant_get (body, "(&s)", &interface_name);
+	interface_info = look_up_interface_info (self, interface_name);
 
-	if (child_error != NULL) {
-		/* Error! */
-		g_propagate_error (error, child_error);
+	if (interface_info == NULL) {
+		return message;
+	}
 
-		return NULL;
+	for (i = 0; interface_info->properties != NULL && interface_info->properties[i] != NULL; i++) {
+		if (g_signal_has_handler_pending (self, object_signals[SIGNAL_DBUS_GET_PROPERTY], g_quark_from_string (interface_info->properties[i]->name),
+		                                  FALSE) == TRUE) {
+			use_cache = FALSE;
+			break;
+		}
 	}
 
-	/* Check all the objects. */
-	for (i = 0; i < ast_object_array->len; i++) {
-		DfsmAstObject *ast_object;
+	if (use_cache == FALSE) {
+		GVariantBuilder builder;
 
-		ast_object = g_ptr_array_index (ast_object_array, i);
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
 
-		dfsm_ast_object_initial_check (ast_object, &child_error);
+		for (i = 0; interface_info->properties != NULL && interface_info->properties[i] != NULL; i++) {
+			GDBusPropertyInfo *property_info = interface_info->properties[i];
+			GVariant *value;
 
-		if (child_error != NULL) {
-			/* Error! */
-			g_propagate_error (error, child_error);
+			if ((property_info->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE) == 0) {
+				continue;
+			}
 
-			g_ptr_array_unref (ast_object_array);
+			value = handle_get_property (self, g_dbus_message_get_sender (message), interface_name, property_info->name, TRUE,
+			                             &child_error);
+
+			if (value == NULL) {
+				break;
+			}
+
+			g_variant_builder_add (&builder, "{sv}", property_info->name, value);
+			g_variant_unref (value);
+		}
 
-			return NULL;
+		if (child_error == NULL) {
+			reply_body = g_variant_new ("(@a{sv})", g_variant_builder_end (&builder));
+		} else {
+			g_variant_builder_clear (&builder);
 		}
+
+		send_filter_reply (connection, message, reply_body, child_error);
+		g_clear_error (&child_error);
+		g_object_unref (message);
+
+		return NULL;
 	}
 
-	for (i = 0; i < ast_object_array->len; i++) {
-		DfsmAstObject *ast_object;
+	g_debug ("Getting all D-Bus properties of interface ‘%s’ on object ‘%s’ for sender ‘%s’ from the cache.", interface_name, priv->object_path,
+	         g_dbus_message_get_sender (message));
 
-		ast_object = g_ptr_array_index (ast_object_array, i);
+	/* Count the activity. */
+	count_dbus_activity (self, TRUE);
 
-		dfsm_ast_node_check (DFSM_AST_NODE (ast_object), dfsm_ast_object_get_environment (ast_object), &child_error);
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "get-all-properties", interface_name, priv->object_path);
 
-		if (child_error != NULL) {
-			/* Error! */
-			g_propagate_error (error, child_error);
+	g_mutex_lock (&priv->machine_lock);
+	reply_body = dup_get_all_reply_body (self, interface_info);
+	g_mutex_unlock (&priv->machine_lock);
 
-			g_ptr_array_unref (ast_object_array);
+	send_filter_reply (connection, message, reply_body, NULL);
+	g_variant_unref (reply_body);
 
-			return NULL;
-		}
-	}
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "get-all-properties", interface_name, priv->object_path);
 
-	return ast_object_array;
+	g_object_unref (message);
+
+	return NULL;
 }
 
-/**
- * dfsm_object_factory_from_data:
- * @simulation_code: code describing the DFSM of one or more D-Bus objects to be simulated
- * @introspection_xml: D-Bus introspection XML describing all the interfaces referenced by @simulation_code
- * @error: (allow-none): a #GError, or %NULL
- *
- * Parses the given @simulation_code and constructs one or more #DfsmObject<!-- -->s from it, each of which will simulate a single D-Bus object on the
- * bus once started using dfsm_object_register_on_bus(). The given @introspection_xml should be a fully formed introspection XML
- * document which, at a minimum, describes all the D-Bus interfaces implemented by all the objects defined in @simulation_code.
- *
- * Return value: (transfer full): an array of #DfsmObject<!-- -->s, each of which must be freed using g_object_unref()
- */
-GPtrArray/*<DfsmObject>*/ *
-dfsm_object_factory_from_data (const gchar *simulation_code, const gchar *introspection_xml, GError **error)
+/* Handle an org.freedesktop.DBus.Properties Get or Set call from the connection filter. These have to be handled in the worker thread too, since
+ * otherwise a method call handled there could overtake a Get or Set sent before it which was still queued in the main context. Calls for unknown
+ * properties, or with invalid parameters, are passed through (returning @message) so that GDBus can return the appropriate errors for them. */
+static GDBusMessage *
+filter_get_or_set_property (DfsmObject *self, GDBusConnection *connection, GDBusMessage *message, gboolean is_set)
 {
-	GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
-	GPtrArray/*<DfsmObject>*/ *object_array;
-	guint i;
+	GVariant *body, *value, *reply_body = NULL;
+	const gchar *interface_name, *property_name;
+	GDBusInterfaceInfo *interface_info;
+	GDBusPropertyInfo *property_info;
+	GDBusPropertyInfoFlags required_flags;
 	GError *child_error = NULL;
 
-	g_return_val_if_fail (simulation_code != NULL, NULL);
-	g_return_val_if_fail (introspection_xml != NULL, NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* Load and parse the files into DfsmAstObjects. */
-	ast_object_array = dfsm_object_factory_asts_from_data (simulation_code, introspection_xml, &child_error);
-
-	if (child_error != NULL) {
-		/* Error! */
-		g_propagate_error (error, child_error);
+	body = g_dbus_message_get_body (message);
 
-		return NULL;
+	if (body == NULL || g_variant_is_of_type (body, G_VARIANT_TYPE ((is_set == TRUE) ? "(ssv)" : "(ss)")) == FALSE) {
+		return message;
 	}
 
-	/* For each of the AST objects, build a proper DfsmObject. */
-	object_array = g_ptr_array_new_with_free_func (g_object_unref);
+	g_variant_get_child (body, 0, "&s", &interface_name);
+	g_variant_get_child (body, 1, "&s", &property_name);
 
-	for (i = 0; i < ast_object_array->len; i++) {
-		DfsmAstObject *ast_object;
-		DfsmMachine *machine;
-		DfsmObject *object;
+	interface_info = look_up_interface_info (self, interface_name);
+	property_info = (interface_info != NULL) ? g_dbus_interface_info_lookup_property (interface_info, property_name) : NULL;
+	required_flags = (is_set == TRUE) ? G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE : G_DBUS_PROPERTY_INFO_FLAGS_READABLE;
 
-		ast_object = g_ptr_array_index (ast_object_array, i);
+	if (property_info == NULL || (property_info->flags & required_flags) == 0) {
+		return message;
+	}
 
-		/* Build the machine and object wrapper. */
-		machine = _dfsm_machine_new (dfsm_ast_object_get_environment (ast_object), dfsm_ast_object_get_state_names (ast_object),
-		                             dfsm_ast_object_get_transitions (ast_object));
-		object = _dfsm_object_new (machine, dfsm_ast_object_get_object_path (ast_object), dfsm_ast_object_get_well_known_bus_names (ast_object),
-		                           dfsm_ast_object_get_interface_names (ast_object));
+	if (is_set == TRUE) {
+		g_variant_get_child (body, 2, "v", &value);
 
-		g_ptr_array_add (object_array, g_object_ref (object));
+		if (g_variant_is_of_type (value, G_VARIANT_TYPE (property_info->signature)) == FALSE) {
+			g_variant_unref (value);
+			return message;
+		}
 
-		g_object_unref (object);
-		g_object_unref (machine);
+		handle_set_property (self, g_dbus_message_get_sender (message), interface_name, property_name, value, TRUE, &child_error);
+		g_variant_unref (value);
+	} else {
+		value = handle_get_property (self, g_dbus_message_get_sender (message), interface_name, property_name, TRUE, &child_error);
+
+		if (value != NULL) {
+			reply_body = g_variant_new ("(v)", value);
+			g_variant_unref (value);
+		}
 	}
 
-	g_ptr_array_unref (ast_object_array);
+	send_filter_reply (connection, message, reply_body, child_error);
+	g_clear_error (&child_error);
+	g_object_unref (message);
 
-	return object_array;
+	return NULL;
 }
 
-/**
- * dfsm_object_factory_set_unfuzzed_transition_limit:
- * @transition_limit: number of unfuzzed transitions to execute before enabling fuzzing and error-throwing transitions
- *
- * Set the number of unfuzzed transitions to execute before enabling fuzzing and error-throwing transitions, across all #DfsmObject<!-- -->s as an
- * aggregate. May be zero.
- */
-void
-dfsm_object_factory_set_unfuzzed_transition_limit (guint transition_limit)
+/* Handle a method call to one of the object's interfaces from the connection filter, if it's valid. Invalid method calls are passed through (returning
+ * @message) so that GDBus can return the appropriate errors for them. */
+static GDBusMessage *
+filter_method_call (DfsmObject *self, GDBusConnection *connection, GDBusMessage *message, const gchar *interface_name, const gchar *method_name)
 {
-	unfuzzed_transition_count = 0;
-	unfuzzed_transition_limit = transition_limit;
-}
+	DfsmObjectPrivate *priv = self->priv;
+	GDBusInterfaceInfo *interface_info;
+	GDBusMethodInfo *method_info;
+	GVariant *body, *parameters;
+	GVariantType *in_type;
+	gboolean parameters_valid;
 
-static gboolean
-dfsm_object_dbus_method_call_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *method_name,
-                                      GVariant *parameters, gboolean enable_fuzzing)
-{
-	dfsm_machine_call_method (obj->priv->machine, output_sequence, interface_name, method_name, parameters, enable_fuzzing);
-	return TRUE;
-}
+	/* Look up the method. */
+	interface_info = look_up_interface_info (self, interface_name);
 
-static void
-dfsm_object_dbus_method_call (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
-                              const gchar *method_name, GVariant *parameters, GDBusMethodInvocation *invocation, gpointer user_data)
-{
-	DfsmObject *self = DFSM_OBJECT (user_data);
-	DfsmObjectPrivate *priv = self->priv;
-	gchar *parameters_string;
-	DfsmOutputSequence *output_sequence;
-	gboolean method_call_handled = FALSE;
-	GError *child_error = NULL;
+	if (interface_info == NULL) {
+		return message;
+	}
 
-	/* Debug output. */
-	parameters_string = g_variant_print (parameters, FALSE);
-	g_debug ("Method call from ‘%s’ to method ‘%s’ of interface ‘%s’ on object ‘%s’. Parameters: %s", sender, method_name, interface_name,
-	         object_path, parameters_string);
-	g_free (parameters_string);
+	method_info = g_dbus_interface_info_lookup_method (interface_info, method_name);
 
-	/* Count the activity. */
-	priv->dbus_activity_count++;
-	g_object_notify (G_OBJECT (user_data), "dbus-activity-count");
+	if (method_info == NULL) {
+		return message;
+	}
 
-	/* Pass the method call through to the DFSM. */
-	output_sequence = DFSM_OUTPUT_SEQUENCE (dfsm_dbus_output_sequence_new (connection, object_path, invocation));
+	/* Check the parameters' type. */
+	body = g_dbus_message_get_body (message);
+	parameters = (body != NULL) ? g_variant_ref (body) : g_variant_ref_sink (g_variant_new_tuple (NULL, 0));
 
-	g_signal_emit (self, object_signals[SIGNAL_DBUS_METHOD_CALL], g_quark_from_string (method_name),
-	               output_sequence, interface_name, method_name, parameters,
-	               (unfuzzed_transition_count >= unfuzzed_transition_limit) ? TRUE : FALSE,
-	               &method_call_handled);
+	in_type = dfsm_internal_dbus_arg_info_array_to_variant_type ((const GDBusArgInfo**) method_info->in_args);
+	parameters_valid = g_variant_is_of_type (parameters, in_type);
+	g_variant_type_free (in_type);
 
-	/* In any case, the method call should fall through to this class' default implementation. */
-	g_assert (method_call_handled == TRUE);
+	if (parameters_valid == FALSE) {
+		g_variant_unref (parameters);
+		return message;
+	}
+
+	handle_method_call (self, connection, g_dbus_message_get_sender (message), priv->object_path, interface_name, method_name, parameters,
+	                    NULL, message);
+
+	g_variant_unref (parameters);
+	g_object_unref (message);
+
+	return NULL;
+}
 
-	if (unfuzzed_transition_count < unfuzzed_transition_limit) {
-		unfuzzed_transition_count++;
+/* Called in the GDBus worker thread for every message on the connection while the object's registered with #DfsmObject:dispatch-in-worker-thread
+ * set. Valid method calls and property gets and sets for this object are handled immediately (with GetAll calls answered from the property
+ * cache), in the order they were received, then dropped from the connection's queue. Everything else is passed through to be dispatched in the
+ * main context as normal. */
+static GDBusMessage *
+connection_filter_cb (GDBusConnection *connection, GDBusMessage *message, gboolean incoming, DfsmObject *self)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	const gchar *interface_name, *method_name;
+
+	if (incoming == FALSE || g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL ||
+	    g_strcmp0 (g_dbus_message_get_path (message), priv->object_path) != 0) {
+		return message;
 	}
 
-	/* Output the effect sequence resulting from the method call. */
-	dfsm_output_sequence_output (output_sequence, &child_error);
+	interface_name = g_dbus_message_get_interface (message);
+	method_name = g_dbus_message_get_member (message);
 
-	g_object_unref (output_sequence);
+	if (interface_name == NULL || method_name == NULL) {
+		return message;
+	}
 
-	if (child_error != NULL) {
-		/* Runtime error. Replace it with a generic D-Bus error so as not to expose internals of the
-		 * simulator to programs under test. */
-		g_warning (_("Runtime error in simulation while handling D-Bus method call ‘%s’: %s"), method_name, child_error->message);
-		g_dbus_method_invocation_return_dbus_error (invocation, "org.freedesktop.DBus.Error.Failed", child_error->message);
+	if (strcmp (interface_name, "org.freedesktop.DBus.Properties") == 0) {
+		if (strcmp (method_name, "GetAll") == 0) {
+			return filter_get_all_properties (self, connection, message);
+		} else if (strcmp (method_name, "Get") == 0) {
+			return filter_get_or_set_property (self, connection, message, FALSE);
+		} else if (strcmp (method_name, "Set") == 0) {
+			return filter_get_or_set_property (self, connection, message, TRUE);
+		}
 
-		g_clear_error (&child_error);
+		return message;
 	}
+
+	return filter_method_call (self, connection, message, interface_name, method_name);
 }
 
 static GVariant *
-dfsm_object_dbus_get_property (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
-                               const gchar *property_name, GError **error, gpointer user_data)
+dfsm_object_dbus_get_property_default (DfsmObject *obj, const gchar *interface_name, const gchar *property_name)
 {
-	DfsmObjectPrivate *priv = DFSM_OBJECT (user_data)->priv;
-	GVariant *value;
+	return dfsm_environment_dup_variable_value (dfsm_machine_get_environment (obj->priv->machine), DFSM_VARIABLE_SCOPE_OBJECT, property_name);
+}
+
+/* Get a property's value, either from the GDBus vtable (in the main context) or from the worker thread filter. */
+static GVariant *
+handle_get_property (DfsmObject *self, const gchar *sender, const gchar *interface_name, const gchar *property_name, gboolean in_worker_thread,
+                     GError **error)
+{
+	DfsmObjectPrivate *priv = self->priv;
+	GVariant *value = NULL;
 	gchar *value_string;
 
 	/* Count the activity. */
-	priv->dbus_activity_count++;
-	g_object_notify (G_OBJECT (user_data), "dbus-activity-count");
+	count_dbus_activity (self, in_worker_thread);
 
-	/* Grab the value from the environment and be done with it. */
-	value = dfsm_environment_dup_variable_value (dfsm_machine_get_environment (priv->machine), DFSM_VARIABLE_SCOPE_OBJECT, property_name);
+	/* Grab the value from the environment (or whoever else handles the signal) and be done with it. */
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "get-property", property_name, priv->object_path);
+	g_mutex_lock (&priv->machine_lock);
+	g_signal_emit (self, object_signals[SIGNAL_DBUS_GET_PROPERTY], g_quark_from_string (property_name), interface_name, property_name, &value);
+	emit_dispatched (self, DFSM_OBJECT_DISPATCH_GET_PROPERTY, NULL, interface_name, property_name, value, (value != NULL) ? TRUE : FALSE);
+	g_mutex_unlock (&priv->machine_lock);
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "get-property", property_name, priv->object_path);
 
 	value_string = (value != NULL) ? g_variant_print (value, FALSE) : g_strdup ("(null)");
-	g_debug ("Getting D-Bus property ‘%s’ of interface ‘%s’ on object ‘%s’ for sender ‘%s’, value: %s", property_name, interface_name, object_path,
-	         sender, value_string);
+	g_debug ("Getting D-Bus property ‘%s’ of interface ‘%s’ on object ‘%s’ for sender ‘%s’, value: %s", property_name, interface_name,
+	         priv->object_path, sender, value_string);
 	g_free (value_string);
 
 	if (value == NULL) {
@@ -813,6 +2269,13 @@ dfsm_object_dbus_get_property (GDBusConnection *connection, const gchar *sender,
 	return value;
 }
 
+static GVariant *
+dfsm_object_dbus_get_property (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
+                               const gchar *property_name, GError **error, gpointer user_data)
+{
+	return handle_get_property (DFSM_OBJECT (user_data), sender, interface_name, property_name, FALSE, error);
+}
+
 static gboolean
 dfsm_object_dbus_set_property_default (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *property_name,
                                        GVariant *value, gboolean enable_fuzzing)
@@ -820,55 +2283,63 @@ dfsm_object_dbus_set_property_default (DfsmObject *obj, DfsmOutputSequence *outp
 	return dfsm_machine_set_property (obj->priv->machine, output_sequence, interface_name, property_name, value, enable_fuzzing);
 }
 
+/* Set a property, either from the GDBus vtable (in the main context) or from the worker thread filter. */
 static gboolean
-dfsm_object_dbus_set_property (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
-                               const gchar *property_name, GVariant *value, GError **error, gpointer user_data)
+handle_set_property (DfsmObject *self, const gchar *sender, const gchar *interface_name, const gchar *property_name, GVariant *value,
+                     gboolean in_worker_thread, GError **error)
 {
-	DfsmObject *self = DFSM_OBJECT (user_data);
 	DfsmObjectPrivate *priv = self->priv;
 	gchar *value_string;
-	DfsmOutputSequence *output_sequence;
+	DfsmOutputSequence *output_sequence, *wrapped_sequence, *dispatch_sequence;
 	gboolean property_set_handled_and_changed = FALSE;
 	GError *child_error = NULL;
 
 	value_string = g_variant_print (value, FALSE);
 	g_debug ("Setting D-Bus property ‘%s’ of interface ‘%s’ on object ‘%s’ for sender ‘%s’ to value: %s", property_name, interface_name,
-	         object_path, sender, value_string);
+	         priv->object_path, sender, value_string);
 	g_free (value_string);
 
 	/* Count the activity. */
-	priv->dbus_activity_count++;
-	g_object_notify (G_OBJECT (user_data), "dbus-activity-count");
+	count_dbus_activity (self, in_worker_thread);
+
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "set-property", property_name, priv->object_path);
+
+	/* As with method calls, defer the machine's property notifications to the main context. */
+	if (in_worker_thread == TRUE) {
+		g_object_freeze_notify (G_OBJECT (priv->machine));
+	}
 
 	/* Set the property on the machine. */
-	output_sequence = DFSM_OUTPUT_SEQUENCE (dfsm_dbus_output_sequence_new (connection, object_path, NULL));
+	g_mutex_lock (&priv->machine_lock);
+
+	output_sequence = acquire_output_sequence (self, NULL, NULL);
+	wrapped_sequence = wrap_output_sequence (self, output_sequence);
+	dispatch_sequence = (wrapped_sequence != NULL) ? wrapped_sequence : output_sequence;
 
 	g_signal_emit (self, object_signals[SIGNAL_DBUS_SET_PROPERTY], g_quark_from_string (property_name),
-	               output_sequence, interface_name, property_name, value, (unfuzzed_transition_count >= unfuzzed_transition_limit) ? TRUE : FALSE,
-	               &property_set_handled_and_changed);
+	               dispatch_sequence, interface_name, property_name, value, begin_transition (), &property_set_handled_and_changed);
+
+	emit_dispatched (self, DFSM_OBJECT_DISPATCH_SET_PROPERTY, dispatch_sequence, interface_name, property_name, value,
+	                 property_set_handled_and_changed);
 
+	/* Any PropertiesChanged notification has been scheduled on the output sequence by the machine, coalesced with changes to other properties. */
 	if (property_set_handled_and_changed == TRUE) {
-		GVariantBuilder *builder;
-		GVariant *parameters;
+		g_debug ("Property ‘%s’ changed.", property_name);
+	}
 
-		/* Schedule a notification. */
-		builder = g_variant_builder_new (G_VARIANT_TYPE_ARRAY);
-		g_variant_builder_add (builder, "{sv}", property_name, value);
-		parameters = g_variant_ref_sink (g_variant_new ("(sa{sv}as)", interface_name, builder, NULL));
+	/* Output effects of the transition. */
+	dfsm_output_sequence_output (dispatch_sequence, &child_error);
 
-		dfsm_output_sequence_add_emit (output_sequence, "org.freedesktop.DBus.Properties", "PropertiesChanged", parameters);
+	g_clear_object (&wrapped_sequence);
+	release_output_sequence (self, output_sequence);
 
-		g_variant_unref (parameters);
-	}
+	g_mutex_unlock (&priv->machine_lock);
 
-	if (unfuzzed_transition_count < unfuzzed_transition_limit) {
-		unfuzzed_transition_count++;
+	if (in_worker_thread == TRUE) {
+		thaw_machine_notify_in_main_context (self);
 	}
 
-	/* Output effects of the transition. */
-	dfsm_output_sequence_output (output_sequence, &child_error);
-
-	g_object_unref (output_sequence);
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "set-property", property_name, priv->object_path);
 
 	if (child_error != NULL) {
 		g_propagate_error (error, child_error);
@@ -878,6 +2349,13 @@ dfsm_object_dbus_set_property (GDBusConnection *connection, const gchar *sender,
 	return TRUE;
 }
 
+static gboolean
+dfsm_object_dbus_set_property (GDBusConnection *connection, const gchar *sender, const gchar *object_path, const gchar *interface_name,
+                               const gchar *property_name, GVariant *value, GError **error, gpointer user_data)
+{
+	return handle_set_property (DFSM_OBJECT (user_data), sender, interface_name, property_name, value, FALSE, error);
+}
+
 static void schedule_arbitrary_transition (DfsmObject *self);
 
 static gboolean
@@ -887,58 +2365,69 @@ dfsm_object_arbitrary_transition_default (DfsmObject *obj, DfsmOutputSequence *o
 	return TRUE;
 }
 
-/* This gets called continuously at random intervals while the simulation's running. It checks whether any arbitrary transitions can be taken,
- * and if so, follows one of them. */
-static gboolean
-arbitrary_transition_timeout_cb (DfsmObject *self)
+/* This gets called continuously at random intervals by the scheduler while the simulation's running. It checks whether any arbitrary transitions
+ * can be taken, and if so, follows one of them. */
+static void
+arbitrary_transition_tick_cb (DfsmObject *self)
 {
 	DfsmObjectPrivate *priv = self->priv;
-	DfsmOutputSequence *output_sequence;
+	DfsmOutputSequence *output_sequence, *wrapped_sequence, *dispatch_sequence;
 	gboolean arbitrary_transition_handled = FALSE;
 	GError *child_error = NULL;
 
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "arbitrary-transition", "tick", priv->object_path);
+
 	/* Make an arbitrary transition. */
-	output_sequence = DFSM_OUTPUT_SEQUENCE (dfsm_dbus_output_sequence_new (priv->connection, priv->object_path, NULL));
+	g_mutex_lock (&priv->machine_lock);
 
-	g_signal_emit (self, object_signals[SIGNAL_ARBITRARY_TRANSITION], 0,
-	               output_sequence, (unfuzzed_transition_count >= unfuzzed_transition_limit) ? TRUE : FALSE,
-	               &arbitrary_transition_handled);
+	output_sequence = acquire_output_sequence (self, NULL, NULL);
+	wrapped_sequence = wrap_output_sequence (self, output_sequence);
+	dispatch_sequence = (wrapped_sequence != NULL) ? wrapped_sequence : output_sequence;
+
+	g_signal_emit (self, object_signals[SIGNAL_ARBITRARY_TRANSITION], 0, dispatch_sequence, begin_transition (), &arbitrary_transition_handled);
 
 	/* In any case, the transition should fall through to this class' default implementation. */
 	g_assert (arbitrary_transition_handled == TRUE);
 
-	if (unfuzzed_transition_count < unfuzzed_transition_limit) {
-		unfuzzed_transition_count++;
-	}
+	emit_dispatched (self, DFSM_OBJECT_DISPATCH_ARBITRARY_TRANSITION, dispatch_sequence, NULL, NULL, NULL, arbitrary_transition_handled);
 
 	/* Output the transition's effects. */
-	dfsm_output_sequence_output (output_sequence, &child_error);
+	dfsm_output_sequence_output (dispatch_sequence, &child_error);
 
-	g_object_unref (output_sequence);
+	g_clear_object (&wrapped_sequence);
+	release_output_sequence (self, output_sequence);
+
+	g_mutex_unlock (&priv->machine_lock);
 
 	if (child_error != NULL) {
 		g_warning ("Runtime error when outputting the effects of an arbitrary transition: %s", child_error->message);
 		g_error_free (child_error);
 	}
 
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "arbitrary-transition", "tick", priv->object_path);
+
 	/* Schedule the next arbitrary transition. */
-	priv->timeout_id = 0;
 	schedule_arbitrary_transition (self);
-
-	return FALSE; /* rescheduled with a different timeout above */
 }
 
 static void
 schedule_arbitrary_transition (DfsmObject *self)
 {
+	DfsmObjectPrivate *priv = self->priv;
+	GRand *rand;
 	guint32 timeout_period;
 
-	g_assert (self->priv->timeout_id == 0);
+	g_assert (dfsm_internal_scheduler_entry_is_scheduled (&priv->arbitrary_transition_entry) == FALSE);
+
+	/* Add a random timeout to the next potential arbitrary transition. All objects share a single scheduler, rather than each having a main
+	 * loop source of its own. The timeout comes from the machine's generator, which may be in use by the worker thread. */
+	g_mutex_lock (&priv->machine_lock);
+	rand = dfsm_internal_environment_get_rand (dfsm_machine_get_environment (priv->machine));
+	timeout_period = fabs (floor (dfsm_random_normal_distribution (rand, TRANSITION_TIMEOUT_MU, TRANSITION_TIMEOUT_SIGMA)));
+	g_mutex_unlock (&priv->machine_lock);
 
-	/* Add a random timeout to the next potential arbitrary transition. */
-	timeout_period = fabs (floor (dfsm_random_normal_distribution (TRANSITION_TIMEOUT_MU, TRANSITION_TIMEOUT_SIGMA)));
 	g_debug ("Scheduling the next arbitrary transition in %u ms.", timeout_period);
-	self->priv->timeout_id = g_timeout_add (timeout_period, (GSourceFunc) arbitrary_transition_timeout_cb, self);
+	dfsm_internal_scheduler_add (&priv->arbitrary_transition_entry, timeout_period);
 }
 
 static void
@@ -952,15 +2441,20 @@ start_simulation (DfsmObject *self, GDBusConnection *connection)
 	g_object_notify (G_OBJECT (self), "connection");
 
 	/* Reset the activity counter. */
-	priv->dbus_activity_count = 0;
+	g_atomic_int_set (&priv->dbus_activity_count, 0);
 	g_object_notify (G_OBJECT (self), "dbus-activity-count");
 
-	unfuzzed_transition_count = 0;
+	/* Instances created by transitions join a simulation which is already running, so shouldn't restart its unfuzzed period. */
+	if (priv->template_object == NULL) {
+		g_atomic_int_set (&unfuzzed_transition_count, 0);
+	}
 
 	/* Start the DFSM. */
-	g_debug ("Starting the simulation. %u unfuzzed transitions to go.", unfuzzed_transition_limit);
+	g_debug ("Starting the simulation. %i unfuzzed transitions to go.", g_atomic_int_get (&unfuzzed_transition_limit));
 
-	/* Add a random timeout to the next potential arbitrary transition. */
+	/* Add a random timeout to the next potential arbitrary transition. This also resets the count of ticks used for the scheduler's
+	 * fairness statistics. */
+	dfsm_internal_scheduler_entry_init (&priv->arbitrary_transition_entry, (DfsmSchedulerFunc) arbitrary_transition_tick_cb, self);
 	schedule_arbitrary_transition (self);
 
 	/* Change simulation status. */
@@ -1136,6 +2630,14 @@ dfsm_object_register_on_bus (DfsmObject *self, GDBusConnection *connection, GAsy
 
 	/* Success! Save the array of registration IDs so that we can unregister later. */
 	priv->registration_ids = registration_ids;
+	priv->main_context = g_main_context_ref_thread_default ();
+
+	/* Intercept method calls and property calls in the worker thread, if requested. The connection holds a reference to the object until the
+	 * filter is removed in dfsm_object_unregister_on_bus(), since the filter may still be running in the worker thread after it's been removed. */
+	if (priv->dispatch_in_worker_thread == TRUE) {
+		priv->filter_id = g_dbus_connection_add_filter (connection, (GDBusMessageFilterFunction) connection_filter_cb, g_object_ref (self),
+		                                                g_object_unref);
+	}
 
 	/* Register the process for all the object's well-known names. */
 	bus_names = dfsm_object_get_well_known_bus_names (self);
@@ -1255,13 +2757,15 @@ dfsm_object_unregister_on_bus (DfsmObject *self)
 		return;
 	}
 
+	/* Instances created by transitions don't outlive the simulation. */
+	destroy_all_instances (self);
+
 	/* Stop the DFSM. */
 	g_debug ("Stopping the simulation.");
 
 	/* Cancel any outstanding potential arbitrary transition. */
 	g_debug ("Cancelling outstanding arbitrary transitions.");
-	g_source_remove (priv->timeout_id);
-	priv->timeout_id = 0;
+	dfsm_internal_scheduler_remove (&priv->arbitrary_transition_entry);
 
 	/* Change simulation status. */
 	priv->simulation_status = DFSM_SIMULATION_STATUS_STOPPED;
@@ -1277,6 +2781,12 @@ dfsm_object_unregister_on_bus (DfsmObject *self)
 	g_hash_table_unref (priv->bus_name_ids);
 	priv->bus_name_ids = NULL;
 
+	/* Stop intercepting calls in the worker thread. */
+	if (priv->filter_id != 0) {
+		g_dbus_connection_remove_filter (priv->connection, priv->filter_id);
+		priv->filter_id = 0;
+	}
+
 	/* Unregister all the interfaces from the bus. */
 	for (i = 0; i < priv->registration_ids->len; i++) {
 		guint registration_id = g_array_index (priv->registration_ids, guint, i);
@@ -1286,7 +2796,15 @@ dfsm_object_unregister_on_bus (DfsmObject *self)
 	g_array_free (priv->registration_ids, TRUE);
 	priv->registration_ids = NULL;
 
+	/* The spare output sequence is tied to the connection. Clear the connection while holding the lock too, so that a dispatch which is still
+	 * running in the worker thread can't put its output sequence back as the spare afterwards, or queue instance changes in the main context. */
+	g_mutex_lock (&priv->machine_lock);
+	g_clear_object (&priv->spare_output_sequence);
 	g_clear_object (&priv->connection);
+	g_main_context_unref (priv->main_context);
+	priv->main_context = NULL;
+	g_mutex_unlock (&priv->machine_lock);
+
 	g_object_notify (G_OBJECT (self), "connection");
 }
 
@@ -1306,19 +2824,19 @@ dfsm_object_reset (DfsmObject *self)
 	priv = self->priv;
 
 	if (priv->simulation_status == DFSM_SIMULATION_STATUS_STARTED) {
-		if (priv->timeout_id != 0) {
+		if (dfsm_internal_scheduler_entry_is_scheduled (&priv->arbitrary_transition_entry) == TRUE) {
 			g_debug ("Cancelling outstanding arbitrary transitions.");
-			g_source_remove (priv->timeout_id);
-			priv->timeout_id = 0;
+			dfsm_internal_scheduler_remove (&priv->arbitrary_transition_entry);
 		}
 
+		dfsm_internal_scheduler_entry_init (&priv->arbitrary_transition_entry, (DfsmSchedulerFunc) arbitrary_transition_tick_cb, self);
 		schedule_arbitrary_transition (self);
 	}
 
-	self->priv->dbus_activity_count = 0;
+	g_atomic_int_set (&self->priv->dbus_activity_count, 0);
 	g_object_notify (G_OBJECT (self), "dbus-activity-count");
 
-	unfuzzed_transition_count = 0;
+	g_atomic_int_set (&unfuzzed_transition_count, 0);
 }
 
 /**
@@ -1398,5 +2916,45 @@ dfsm_object_get_dbus_activity_count (DfsmObject *self)
 {
 	g_return_val_if_fail (DFSM_IS_OBJECT (self), 0);
 
-	return self->priv->dbus_activity_count;
+	return (guint) g_atomic_int_get (&self->priv->dbus_activity_count);
+}
+
+/**
+ * dfsm_object_get_dispatch_in_worker_thread:
+ * @self: a #DfsmObject
+ *
+ * Gets the value of the #DfsmObject:dispatch-in-worker-thread property.
+ *
+ * Return value: %TRUE if method calls are dispatched in the GDBus worker thread, %FALSE otherwise
+ */
+gboolean
+dfsm_object_get_dispatch_in_worker_thread (DfsmObject *self)
+{
+	g_return_val_if_fail (DFSM_IS_OBJECT (self), FALSE);
+
+	return self->priv->dispatch_in_worker_thread;
+}
+
+/**
+ * dfsm_object_set_dispatch_in_worker_thread:
+ * @self: a #DfsmObject
+ * @dispatch_in_worker_thread: %TRUE to dispatch method calls in the GDBus worker thread, %FALSE otherwise
+ *
+ * Sets the value of the #DfsmObject:dispatch-in-worker-thread property. This must be called before dfsm_object_register_on_bus() (or after
+ * dfsm_object_unregister_on_bus()).
+ */
+void
+dfsm_object_set_dispatch_in_worker_thread (DfsmObject *self, gboolean dispatch_in_worker_thread)
+{
+	g_return_if_fail (DFSM_IS_OBJECT (self));
+	g_return_if_fail (self->priv->registration_ids == NULL);
+
+	dispatch_in_worker_thread = (dispatch_in_worker_thread == TRUE) ? TRUE : FALSE;
+
+	if (self->priv->dispatch_in_worker_thread == dispatch_in_worker_thread) {
+		return;
+	}
+
+	self->priv->dispatch_in_worker_thread = dispatch_in_worker_thread;
+	g_object_notify (G_OBJECT (self), "dispatch-in-worker-thread");
 }
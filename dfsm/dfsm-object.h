@@ -42,6 +42,22 @@ typedef enum {
 #define DFSM_TYPE_SIMULATION_STATUS dfsm_simulation_status_get_type ()
 GType dfsm_simulation_status_get_type (void) G_GNUC_CONST;
 
+/**
+ * DfsmObjectDispatchKind:
+ * @DFSM_OBJECT_DISPATCH_METHOD_CALL: a D-Bus method call
+ * @DFSM_OBJECT_DISPATCH_GET_PROPERTY: a D-Bus property get
+ * @DFSM_OBJECT_DISPATCH_SET_PROPERTY: a D-Bus property set
+ * @DFSM_OBJECT_DISPATCH_ARBITRARY_TRANSITION: a scheduled arbitrary transition
+ *
+ * The kind of activity a #DfsmObject has dispatched, as passed to #DfsmObject::dispatched.
+ */
+typedef enum {
+	DFSM_OBJECT_DISPATCH_METHOD_CALL = 0,
+	DFSM_OBJECT_DISPATCH_GET_PROPERTY,
+	DFSM_OBJECT_DISPATCH_SET_PROPERTY,
+	DFSM_OBJECT_DISPATCH_ARBITRARY_TRANSITION,
+} DfsmObjectDispatchKind;
+
 #define DFSM_TYPE_OBJECT		(dfsm_object_get_type ())
 #define DFSM_OBJECT(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), DFSM_TYPE_OBJECT, DfsmObject))
 #define DFSM_OBJECT_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), DFSM_TYPE_OBJECT, DfsmObjectClass))
@@ -66,6 +82,7 @@ typedef struct {
  * @dbus_method_call: default handler for the #DfsmObject::dbus-method-call signal
  * @dbus_set_property: default handler for the #DfsmObject::dbus-set-property signal
  * @arbitrary_transition: default handler for the #DfsmObject::arbitrary-transition signal
+ * @dbus_get_property: default handler for the #DfsmObject::dbus-get-property signal
  *
  * Class structure for #DfsmObject.
  */
@@ -79,6 +96,7 @@ typedef struct {
 	gboolean (*dbus_set_property) (DfsmObject *obj, DfsmOutputSequence *output_sequence, const gchar *interface_name, const gchar *property_name,
 	                               GVariant *value, gboolean enable_fuzzing);
 	gboolean (*arbitrary_transition) (DfsmObject *obj, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing);
+	GVariant *(*dbus_get_property) (DfsmObject *obj, const gchar *interface_name, const gchar *property_name);
 } DfsmObjectClass;
 
 GType dfsm_object_get_type (void) G_GNUC_CONST;
@@ -87,6 +105,10 @@ GPtrArray *dfsm_object_factory_asts_from_data (const gchar *simulation_code, con
                                                GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC; /* array of DfsmAstObjects */
 GPtrArray *dfsm_object_factory_from_data (const gchar *simulation_code, const gchar *introspection_xml,
                                           GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC; /* array of DfsmObjects */
+GPtrArray *dfsm_object_factory_asts_from_node_info (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info,
+                                                    GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC; /* array of DfsmAstObjects */
+GPtrArray *dfsm_object_factory_from_node_info (const gchar *simulation_code, GDBusNodeInfo *dbus_node_info,
+                                               GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC; /* array of DfsmObjects */
 
 void dfsm_object_factory_from_files (GFile *simulation_code_file, GFile *introspection_xml_file, GCancellable *cancellable,
                                      GAsyncReadyCallback callback, gpointer user_data);
@@ -94,6 +116,9 @@ GPtrArray *dfsm_object_factory_from_files_finish (GAsyncResult *async_result,
                                                   GError **error) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC; /* array of DfsmObjects */
 
 void dfsm_object_factory_set_unfuzzed_transition_limit (guint transition_limit);
+void dfsm_object_factory_set_cache_directory (const gchar *directory);
+
+DfsmObject *dfsm_object_instantiate (DfsmObject *self, const gchar *object_path) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
 void dfsm_object_register_on_bus (DfsmObject *self, GDBusConnection *connection, GAsyncReadyCallback callback, gpointer user_data);
 void dfsm_object_register_on_bus_finish (DfsmObject *self, GAsyncResult *async_result, GError **error);
@@ -106,6 +131,9 @@ const gchar *dfsm_object_get_object_path (DfsmObject *self) G_GNUC_PURE;
 GPtrArray/*<string>*/ *dfsm_object_get_well_known_bus_names (DfsmObject *self) G_GNUC_PURE;
 guint dfsm_object_get_dbus_activity_count (DfsmObject *self);
 
+gboolean dfsm_object_get_dispatch_in_worker_thread (DfsmObject *self) G_GNUC_PURE;
+void dfsm_object_set_dispatch_in_worker_thread (DfsmObject *self, gboolean dispatch_in_worker_thread);
+
 G_END_DECLS
 
 #endif /* !DFSM_OBJECT_H */
@@ -29,6 +29,7 @@
 #include <glib.h>
 
 #include "dfsm-output-sequence.h"
+#include "dfsm-internal.h"
 
 G_DEFINE_INTERFACE (DfsmOutputSequence, dfsm_output_sequence, G_TYPE_OBJECT)
 
@@ -60,7 +61,9 @@ dfsm_output_sequence_output (DfsmOutputSequence *self, GError **error)
 	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
 	g_assert (iface->output != NULL);
 
+	dfsm_internal_trace (DFSM_TRACE_PHASE_BEGIN, "output", G_OBJECT_TYPE_NAME (self), NULL);
 	iface->output (self, &child_error);
+	dfsm_internal_trace (DFSM_TRACE_PHASE_END, "output", G_OBJECT_TYPE_NAME (self), NULL);
 
 	if (child_error != NULL) {
 		g_propagate_error (error, child_error);
@@ -88,6 +91,33 @@ dfsm_output_sequence_add_reply (DfsmOutputSequence *self, GVariant *parameters)
 	iface->add_reply (self, parameters);
 }
 
+/**
+ * dfsm_output_sequence_add_constant_reply:
+ * @self: a #DfsmOutputSequence
+ * @parameters: constant out parameters from the method invocation
+ *
+ * Add an event to the output sequence to reply to the ongoing method call with return values given as out @parameters, as
+ * dfsm_output_sequence_add_reply() does. As with dfsm_output_sequence_add_constant_emit(), the caller guarantees that @parameters is constant, so
+ * implementations may cache anything derived from it, keyed by its identity.
+ */
+void
+dfsm_output_sequence_add_constant_reply (DfsmOutputSequence *self, GVariant *parameters)
+{
+	DfsmOutputSequenceInterface *iface;
+
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (parameters != NULL);
+
+	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
+
+	if (iface->add_constant_reply != NULL) {
+		iface->add_constant_reply (self, parameters);
+	} else {
+		g_assert (iface->add_reply != NULL);
+		iface->add_reply (self, parameters);
+	}
+}
+
 /**
  * dfsm_output_sequence_add_throw:
  * @self: a #DfsmOutputSequence
@@ -133,3 +163,115 @@ dfsm_output_sequence_add_emit (DfsmOutputSequence *self, const gchar *interface_
 
 	iface->add_emit (self, interface_name, signal_name, parameters);
 }
+
+/**
+ * dfsm_output_sequence_add_constant_emit:
+ * @self: a #DfsmOutputSequence
+ * @interface_name: name of the D-Bus interface defining @signal_name
+ * @signal_name: name of the D-Bus signal to emit
+ * @parameters: constant parameters to the signal
+ *
+ * Add an event to the output sequence to emit @signal_name with the given @parameters, as dfsm_output_sequence_add_emit() does. The caller guarantees
+ * that @parameters is constant: the same #GVariant instance is passed every time the same signal emission is added (for example, it's held by an AST
+ * node whose expression was found to be constant when the simulation was checked). Implementations may therefore cache anything derived from
+ * @parameters, keyed by its identity rather than its value.
+ */
+void
+dfsm_output_sequence_add_constant_emit (DfsmOutputSequence *self, const gchar *interface_name, const gchar *signal_name, GVariant *parameters)
+{
+	DfsmOutputSequenceInterface *iface;
+
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (interface_name != NULL && *interface_name != '\0');
+	g_return_if_fail (signal_name != NULL && *signal_name != '\0');
+	g_return_if_fail (parameters != NULL);
+
+	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
+
+	if (iface->add_constant_emit != NULL) {
+		iface->add_constant_emit (self, interface_name, signal_name, parameters);
+	} else {
+		g_assert (iface->add_emit != NULL);
+		iface->add_emit (self, interface_name, signal_name, parameters);
+	}
+}
+
+/**
+ * dfsm_output_sequence_add_property_change:
+ * @self: a #DfsmOutputSequence
+ * @interface_name: name of the D-Bus interface defining @property_name
+ * @property_name: name of the D-Bus property which has changed
+ * @value: (allow-none): new value of the property, or %NULL to only invalidate it
+ *
+ * Add a change to @property_name to the output sequence, so that a change notification for it is output. Unlike other events, property changes may be
+ * coalesced: for example, #DfsmDBusOutputSequence emits a single <literal>org.freedesktop.DBus.Properties.PropertiesChanged</literal> signal per
+ * interface, giving the latest value of each property changed in the sequence. If @value is %NULL, the property is listed as invalidated rather
+ * than giving its new value, which is useful for large values.
+ *
+ * If the output sequence doesn't support property change notifications, this does nothing.
+ */
+void
+dfsm_output_sequence_add_property_change (DfsmOutputSequence *self, const gchar *interface_name, const gchar *property_name, GVariant *value)
+{
+	DfsmOutputSequenceInterface *iface;
+
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (interface_name != NULL && *interface_name != '\0');
+	g_return_if_fail (property_name != NULL && *property_name != '\0');
+
+	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
+
+	if (iface->add_property_change != NULL) {
+		iface->add_property_change (self, interface_name, property_name, value);
+	}
+}
+
+/**
+ * dfsm_output_sequence_add_instantiate:
+ * @self: a #DfsmOutputSequence
+ * @object_path: D-Bus object path for the new instance
+ *
+ * Add an event to the output sequence to create a new instance of the simulated object the sequence is for, exported at @object_path. The instance
+ * shares the object's simulation code, but has its own state and object variables, as if created by dfsm_object_instantiate().
+ *
+ * If the output sequence doesn't support creating instances, this does nothing.
+ */
+void
+dfsm_output_sequence_add_instantiate (DfsmOutputSequence *self, const gchar *object_path)
+{
+	DfsmOutputSequenceInterface *iface;
+
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (object_path != NULL && g_variant_is_object_path (object_path) == TRUE);
+
+	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
+
+	if (iface->add_instantiate != NULL) {
+		iface->add_instantiate (self, object_path);
+	}
+}
+
+/**
+ * dfsm_output_sequence_add_destroy:
+ * @self: a #DfsmOutputSequence
+ * @object_path: D-Bus object path of the instance to destroy
+ *
+ * Add an event to the output sequence to destroy the instance at @object_path, which must have been created by
+ * dfsm_output_sequence_add_instantiate() from the same simulated object (or another instance of it).
+ *
+ * If the output sequence doesn't support destroying instances, this does nothing.
+ */
+void
+dfsm_output_sequence_add_destroy (DfsmOutputSequence *self, const gchar *object_path)
+{
+	DfsmOutputSequenceInterface *iface;
+
+	g_return_if_fail (DFSM_IS_OUTPUT_SEQUENCE (self));
+	g_return_if_fail (object_path != NULL && g_variant_is_object_path (object_path) == TRUE);
+
+	iface = DFSM_OUTPUT_SEQUENCE_GET_IFACE (self);
+
+	if (iface->add_destroy != NULL) {
+		iface->add_destroy (self, object_path);
+	}
+}
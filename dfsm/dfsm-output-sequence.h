@@ -46,6 +46,17 @@ typedef struct _DfsmOutputSequence		DfsmOutputSequence; /* dummy typedef */
  * the #DfsmOutputSequence
  * @add_emit: add a D-Bus signal emission for the given @signal_name on the given @interface_name with the given @parameters tuple to the sequence of
  * actions queued up in the #DfsmOutputSequence.
+ * @add_property_change: record that the D-Bus property @property_name on @interface_name has changed to @value (or has been invalidated, if @value
+ * is %NULL), so that a change notification can be output; implementations may coalesce multiple changes. This may be %NULL, in which case property
+ * changes are ignored.
+ * @add_constant_emit: like @add_emit, but @parameters is guaranteed to be constant, so implementations may cache anything derived from it; see
+ * dfsm_output_sequence_add_constant_emit(). This may be %NULL, in which case @add_emit is used instead.
+ * @add_constant_reply: like @add_reply, but @parameters is guaranteed to be constant; see dfsm_output_sequence_add_constant_reply(). This may be
+ * %NULL, in which case @add_reply is used instead.
+ * @add_instantiate: add the creation of a new instance of the object the sequence is for, at @object_path, to the sequence of actions queued up in
+ * the #DfsmOutputSequence; see dfsm_output_sequence_add_instantiate(). This may be %NULL, in which case instantiations are ignored.
+ * @add_destroy: add the destruction of the instance at @object_path to the sequence of actions queued up in the #DfsmOutputSequence; see
+ * dfsm_output_sequence_add_destroy(). This may be %NULL, in which case destructions are ignored.
  *
  * Interface structure for #DfsmOutputSequence.
  */
@@ -59,6 +70,11 @@ typedef struct {
 	void (*add_reply) (DfsmOutputSequence *self, GVariant *parameters);
 	void (*add_throw) (DfsmOutputSequence *self, GError *throw_error);
 	void (*add_emit) (DfsmOutputSequence *self, const gchar *interface_name, const gchar *signal_name, GVariant *parameters);
+	void (*add_property_change) (DfsmOutputSequence *self, const gchar *interface_name, const gchar *property_name, GVariant *value);
+	void (*add_constant_emit) (DfsmOutputSequence *self, const gchar *interface_name, const gchar *signal_name, GVariant *parameters);
+	void (*add_constant_reply) (DfsmOutputSequence *self, GVariant *parameters);
+	void (*add_instantiate) (DfsmOutputSequence *self, const gchar *object_path);
+	void (*add_destroy) (DfsmOutputSequence *self, const gchar *object_path);
 } DfsmOutputSequenceInterface;
 
 GType dfsm_output_sequence_get_type (void) G_GNUC_CONST;
@@ -66,8 +82,13 @@ GType dfsm_output_sequence_get_type (void) G_GNUC_CONST;
 void dfsm_output_sequence_output (DfsmOutputSequence *self, GError **error);
 
 void dfsm_output_sequence_add_reply (DfsmOutputSequence *self, GVariant *parameters);
+void dfsm_output_sequence_add_constant_reply (DfsmOutputSequence *self, GVariant *parameters);
 void dfsm_output_sequence_add_throw (DfsmOutputSequence *self, GError *throw_error);
 void dfsm_output_sequence_add_emit (DfsmOutputSequence *self, const gchar *interface_name, const gchar *signal_name, GVariant *parameters);
+void dfsm_output_sequence_add_constant_emit (DfsmOutputSequence *self, const gchar *interface_name, const gchar *signal_name, GVariant *parameters);
+void dfsm_output_sequence_add_property_change (DfsmOutputSequence *self, const gchar *interface_name, const gchar *property_name, GVariant *value);
+void dfsm_output_sequence_add_instantiate (DfsmOutputSequence *self, const gchar *object_path);
+void dfsm_output_sequence_add_destroy (DfsmOutputSequence *self, const gchar *object_path);
 
 G_END_DECLS
 
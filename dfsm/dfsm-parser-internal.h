@@ -28,6 +28,8 @@
 
 G_BEGIN_DECLS
 
+#define DFSM_PARSER_MAX_STRING_CONST_SIZE 4096
+
 typedef struct {
 	/* Gubbins */
 	void *yyscanner;
@@ -40,6 +42,13 @@ typedef struct {
 	const gchar *source_buf; /* UTF-8 */
 	glong source_len; /* in characters, not bytes */
 	glong source_pos; /* in characters, not bytes */
+
+	/* Scanner state. This is kept here rather than in static variables so that several threads can parse at once. */
+	int comment_caller;
+	int string_caller;
+	char string_buf[DFSM_PARSER_MAX_STRING_CONST_SIZE + 1 /* nul delimiter */];
+	char *string_buf_ptr;
+	unsigned int tab_width;
 } DfsmParserData;
 
 G_GNUC_INTERNAL GPtrArray *dfsm_bison_parse (GDBusNodeInfo *dbus_node_info, const gchar *source_buf,
@@ -93,8 +102,12 @@ G_GNUC_INTERNAL void dfsm_parser_state_pair_free (DfsmParserStatePair *state_pai
 
 /* AST node constructors */
 G_GNUC_INTERNAL DfsmEnvironment *_dfsm_environment_new (GPtrArray/*<GDBusInterfaceInfo>*/ *interfaces) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL DfsmEnvironment *_dfsm_environment_new_instance (DfsmEnvironment *template_environment) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 G_GNUC_INTERNAL DfsmMachine *_dfsm_machine_new (DfsmEnvironment *environment, GPtrArray/*<string>*/ *state_names,
                                                 GPtrArray/*<DfsmAstTransition>*/ *transitions) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL DfsmMachine *_dfsm_machine_new_instance (DfsmMachine *template_machine,
+                                                         DfsmEnvironment *environment) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL GPtrArray/*<DfsmAstObjectTransition>*/ *_dfsm_machine_dup_transitions (DfsmMachine *self) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
 #include "dfsm-ast-data-structure.h"
 
@@ -149,8 +162,6 @@ G_GNUC_INTERNAL void dfsm_ast_data_structure_set_weight (DfsmAstDataStructure *s
 G_GNUC_INTERNAL void dfsm_ast_data_structure_set_type_annotation (DfsmAstDataStructure *self, const gchar *type_annotation);
 G_GNUC_INTERNAL void dfsm_ast_data_structure_set_nickname (DfsmAstDataStructure *self, const gchar *nickname);
 
-G_GNUC_INTERNAL void dfsm_ast_data_structure_set_fuzzing_enabled (gboolean enable);
-
 #include "dfsm-ast-expression-binary.h"
 
 G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_binary_new (DfsmAstExpressionBinaryType expression_type, DfsmAstExpression *left_node,
@@ -192,6 +203,10 @@ G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_reply_new (DfsmAstExpressio
 
 G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_throw_new (const gchar *error_name) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_instantiate_new (DfsmAstExpression *expression) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_destroy_new (DfsmAstExpression *expression) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
 G_GNUC_INTERNAL DfsmAstTransition *dfsm_ast_transition_new (const DfsmParserTransitionDetails *details,
                                                             GPtrArray/*<DfsmAstPrecondition>*/ *preconditions,
                                                             GPtrArray/*<DfsmAstStatement>*/ *statements) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
@@ -200,6 +215,103 @@ G_GNUC_INTERNAL DfsmAstTransition *dfsm_ast_transition_new (const DfsmParserTran
 
 G_GNUC_INTERNAL DfsmAstVariable *dfsm_ast_variable_new (DfsmVariableScope scope, const gchar *variable_name) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 
+/* AST node accessors, for analyses of the AST (such as the precondition solver) which have to walk it. */
+G_GNUC_INTERNAL DfsmVariableScope dfsm_ast_variable_get_scope (DfsmAstVariable *self) G_GNUC_PURE;
+G_GNUC_INTERNAL const gchar *dfsm_ast_variable_get_name (DfsmAstVariable *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstVariable *dfsm_ast_data_structure_get_variable (DfsmAstDataStructure *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpressionBinaryType dfsm_ast_expression_binary_get_expression_type (DfsmAstExpressionBinary *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_binary_get_left_node (DfsmAstExpressionBinary *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_binary_get_right_node (DfsmAstExpressionBinary *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpressionUnaryType dfsm_ast_expression_unary_get_expression_type (DfsmAstExpressionUnary *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_unary_get_child_node (DfsmAstExpressionUnary *self) G_GNUC_PURE;
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_precondition_get_condition (DfsmAstPrecondition *self) G_GNUC_PURE;
+
+/* AST node (de)serialisation for the compiled machine cache. Nodes are serialised as the parser built them, before they're checked, since checking
+ * rewrites some of their fields. The deserialisers validate their input and return %NULL if it's invalid, rather than asserting. See
+ * dfsm-serialisation.c for the format. */
+G_GNUC_INTERNAL void dfsm_internal_serialise_byte (GByteArray *buffer, guint8 value);
+G_GNUC_INTERNAL void dfsm_internal_serialise_uint32 (GByteArray *buffer, guint32 value);
+G_GNUC_INTERNAL void dfsm_internal_serialise_double (GByteArray *buffer, gdouble value);
+G_GNUC_INTERNAL void dfsm_internal_serialise_string (GByteArray *buffer, const gchar *str);
+
+/* A cursor over serialised data being read back from the compiled machine cache. All the fields are private to dfsm-serialisation.c. */
+typedef struct {
+	const guint8 *data;
+	gsize length;
+	gsize offset; /* bytes read so far */
+	guint depth; /* current nesting of expressions */
+} DfsmDeserialiser;
+
+G_GNUC_INTERNAL void dfsm_internal_deserialiser_init (DfsmDeserialiser *self, const guint8 *data, gsize length);
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialiser_is_finished (const DfsmDeserialiser *self) G_GNUC_PURE;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialiser_enter (DfsmDeserialiser *self) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL void dfsm_internal_deserialiser_leave (DfsmDeserialiser *self);
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_byte (DfsmDeserialiser *self, guint8 *value) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_uint32 (DfsmDeserialiser *self, guint32 *value) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_length (DfsmDeserialiser *self, guint32 *length) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_double (DfsmDeserialiser *self, gdouble *value) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_string (DfsmDeserialiser *self, const gchar **str) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_maybe_string (DfsmDeserialiser *self, const gchar **str) G_GNUC_WARN_UNUSED_RESULT;
+G_GNUC_INTERNAL gboolean dfsm_internal_deserialise_bytestring (DfsmDeserialiser *self, const gchar **str) G_GNUC_WARN_UNUSED_RESULT;
+
+#include "dfsm-ast-expression-data-structure.h"
+#include "dfsm-ast-expression-function-call.h"
+#include "dfsm-ast-statement-assignment.h"
+#include "dfsm-ast-statement-destroy.h"
+#include "dfsm-ast-statement-emit.h"
+#include "dfsm-ast-statement-instantiate.h"
+#include "dfsm-ast-statement-reply.h"
+#include "dfsm-ast-statement-throw.h"
+
+G_GNUC_INTERNAL void dfsm_ast_variable_serialise (DfsmAstVariable *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstVariable *dfsm_ast_variable_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_data_structure_serialise (DfsmAstDataStructure *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstDataStructure *dfsm_ast_data_structure_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_expression_serialise (DfsmAstExpression *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_expression_serialise_array (GPtrArray/*<DfsmAstExpression>*/ *expressions, GByteArray *buffer);
+G_GNUC_INTERNAL GPtrArray/*<DfsmAstExpression>*/ *dfsm_ast_expression_deserialise_array (DfsmDeserialiser *deserialiser)
+                                                                        G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_expression_binary_serialise (DfsmAstExpressionBinary *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_binary_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_expression_data_structure_serialise (DfsmAstExpressionDataStructure *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_data_structure_deserialise (DfsmDeserialiser *deserialiser)
+                                                                                   G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_expression_function_call_serialise (DfsmAstExpressionFunctionCall *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_function_call_deserialise (DfsmDeserialiser *deserialiser)
+                                                                                  G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_expression_unary_serialise (DfsmAstExpressionUnary *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstExpression *dfsm_ast_expression_unary_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_precondition_serialise (DfsmAstPrecondition *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstPrecondition *dfsm_ast_precondition_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_statement_serialise (DfsmAstStatement *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_statement_assignment_serialise (DfsmAstStatementAssignment *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_assignment_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_statement_destroy_serialise (DfsmAstStatementDestroy *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_destroy_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_statement_emit_serialise (DfsmAstStatementEmit *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_emit_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_statement_instantiate_serialise (DfsmAstStatementInstantiate *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_instantiate_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_statement_reply_serialise (DfsmAstStatementReply *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_reply_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+G_GNUC_INTERNAL void dfsm_ast_statement_throw_serialise (DfsmAstStatementThrow *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstStatement *dfsm_ast_statement_throw_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_transition_serialise (DfsmAstTransition *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstTransition *dfsm_ast_transition_deserialise (DfsmDeserialiser *deserialiser) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
+G_GNUC_INTERNAL void dfsm_ast_object_serialise (DfsmAstObject *self, GByteArray *buffer);
+G_GNUC_INTERNAL DfsmAstObject *dfsm_ast_object_deserialise (DfsmDeserialiser *deserialiser,
+                                                            GDBusNodeInfo *dbus_node_info) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
+
 G_END_DECLS
 
 #endif /* !DFSM_PARSER_INTERNAL_H */
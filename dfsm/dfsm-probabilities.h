@@ -27,13 +27,14 @@ G_BEGIN_DECLS
 
 /**
  * DFSM_BIASED_COIN_FLIP:
+ * @R: the #GRand to use
  * @p: probability of success (in the range [0..1.0])
  *
  * Perform a single biased coin flip with probability of success @p.
  *
  * Return value: %TRUE with probability @p, %FALSE otherwise
  */
-#define DFSM_BIASED_COIN_FLIP(p) (g_random_int () < G_MAXUINT32 * CLAMP ((gdouble) (p), 0.0, 1.0))
+#define DFSM_BIASED_COIN_FLIP(R, p) (g_rand_int (R) < G_MAXUINT32 * CLAMP ((gdouble) (p), 0.0, 1.0))
 
 #define _DFSM_DISTRIBUTION_SEQ(N, OP, TERM, ...) _DFSM_DISTRIBUTION_SEQ##N(OP, TERM, __VA_ARGS__)
 #define _DFSM_DISTRIBUTION_SEQ1(OP, TERM, first_name, first_p) TERM(first_name)
@@ -63,6 +64,7 @@ G_BEGIN_DECLS
 
 /**
  * DFSM_NONUNIFORM_DISTRIBUTION:
+ * @R: the #GRand to use
  * @N: number of intervals in the distribution
  * @first_name: name of the first interval
  * @...: probability of the first interval being chosen, followed by more interval-name–probability pairs
@@ -73,7 +75,7 @@ G_BEGIN_DECLS
  * This macro opens a switch statement between the different possible intervals. Calling code should provide all the necessary case statements (but not
  * a default case statement), then use the %DFSM_NONUNIFORM_DISTRIBUTION_END macro to close the block.
  */
-#define DFSM_NONUNIFORM_DISTRIBUTION(N, first_name, ...) { \
+#define DFSM_NONUNIFORM_DISTRIBUTION(R, N, first_name, ...) { \
 	enum TempEnum { \
 		_DFSM_DISTRIBUTION_LIST(N, first_name, __VA_ARGS__) \
 	}; \
@@ -84,7 +86,7 @@ G_BEGIN_DECLS
 	gdouble diff = (_DFSM_DISTRIBUTION_SUM(N, __VA_ARGS__,)) - 1.0; \
 	G_STATIC_ASSERT (diff < DBL_EPSILON && -diff > DBL_EPSILON); \
 \
-	switch ((enum TempEnum) dfsm_random_nonuniform_distribution (intervals, N)) { \
+	switch ((enum TempEnum) dfsm_random_nonuniform_distribution ((R), intervals, N)) { \
 		default: \
 			g_assert_not_reached (); \
 
@@ -97,8 +99,8 @@ G_BEGIN_DECLS
 	} \
 }
 
-G_GNUC_INTERNAL guint dfsm_random_nonuniform_distribution (guint32 intervals[], gsize intervals_len);
-G_GNUC_INTERNAL gdouble dfsm_random_normal_distribution (gdouble mu, gdouble sigma);
+G_GNUC_INTERNAL guint dfsm_random_nonuniform_distribution (GRand *rand, guint32 intervals[], gsize intervals_len);
+G_GNUC_INTERNAL gdouble dfsm_random_normal_distribution (GRand *rand, gdouble mu, gdouble sigma);
 
 G_END_DECLS
 
@@ -0,0 +1,361 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+
+#include "dfsm-scheduler.h"
+#include "dfsm-internal.h"
+
+/* The scheduler is a binary min-heap of entries, ordered by due time and then by the order they were scheduled in. A single GSource in the global
+ * default main context (the same context g_timeout_add() uses) is kept ready at the due time of the heap's root. The source and the heap only exist
+ * while at least one entry is scheduled.
+ *
+ * None of this is thread safe: entries must only be added and removed from the thread running the global default main context. */
+static GPtrArray/*<DfsmSchedulerEntry>*/ *heap = NULL;
+static GSource *source = NULL;
+static guint64 next_sequence = 0;
+static gboolean dispatching = FALSE;
+
+static void update_source (void);
+
+/* Statistics since the last reset. */
+static guint64 num_wakeups = 0;
+static guint64 num_ticks = 0;
+static guint max_batch_size = 0;
+static gdouble lateness_sum = 0.0, lateness_sum_squares = 0.0; /* microseconds and square microseconds */
+static gint64 max_lateness = 0;
+
+static inline DfsmSchedulerEntry *
+heap_entry (guint i)
+{
+	return (DfsmSchedulerEntry*) g_ptr_array_index (heap, i);
+}
+
+static inline gboolean
+entry_is_earlier (const DfsmSchedulerEntry *a, const DfsmSchedulerEntry *b)
+{
+	return (a->due_time < b->due_time || (a->due_time == b->due_time && a->sequence < b->sequence)) ? TRUE : FALSE;
+}
+
+static inline void
+heap_set (guint i, DfsmSchedulerEntry *entry)
+{
+	heap->pdata[i] = entry;
+	entry->heap_index = i + 1;
+}
+
+static void
+heap_sift_up (guint i)
+{
+	DfsmSchedulerEntry *entry = heap_entry (i);
+
+	while (i > 0) {
+		guint parent = (i - 1) / 2;
+
+		if (entry_is_earlier (entry, heap_entry (parent)) == FALSE) {
+			break;
+		}
+
+		heap_set (i, heap_entry (parent));
+		i = parent;
+	}
+
+	heap_set (i, entry);
+}
+
+static void
+heap_sift_down (guint i)
+{
+	DfsmSchedulerEntry *entry = heap_entry (i);
+
+	while (TRUE) {
+		guint child = 2 * i + 1;
+
+		if (child >= heap->len) {
+			break;
+		}
+
+		/* Pick the earlier of the two children. */
+		if (child + 1 < heap->len && entry_is_earlier (heap_entry (child + 1), heap_entry (child)) == TRUE) {
+			child++;
+		}
+
+		if (entry_is_earlier (heap_entry (child), entry) == FALSE) {
+			break;
+		}
+
+		heap_set (i, heap_entry (child));
+		i = child;
+	}
+
+	heap_set (i, entry);
+}
+
+static void
+heap_remove (DfsmSchedulerEntry *entry)
+{
+	guint i = entry->heap_index - 1;
+
+	/* Move the last entry into the hole and restore the heap property around it. */
+	g_ptr_array_remove_index_fast (heap, i);
+	entry->heap_index = 0;
+
+	if (i < heap->len) {
+		DfsmSchedulerEntry *moved_entry = heap_entry (i);
+
+		heap_set (i, moved_entry);
+		heap_sift_down (i);
+		heap_sift_up (moved_entry->heap_index - 1);
+	}
+}
+
+static gboolean
+scheduler_source_dispatch (GSource *dispatched_source, GSourceFunc callback, gpointer user_data)
+{
+	gint64 now;
+	guint64 dispatch_sequence;
+	guint batch_size = 0;
+
+	now = g_source_get_time (dispatched_source);
+	dispatch_sequence = next_sequence;
+	dispatching = TRUE;
+
+	num_wakeups++;
+
+	/* Fire all the entries which are due, earliest first. Entries which are (re)scheduled by the callbacks are left until the next wakeup, even if
+	 * they're due immediately, so that the batch is bounded. */
+	while (heap != NULL && heap->len > 0) {
+		DfsmSchedulerEntry *entry = heap_entry (0);
+		gint64 lateness;
+
+		if (entry->due_time > now || entry->sequence >= dispatch_sequence) {
+			break;
+		}
+
+		heap_remove (entry);
+
+		lateness = MAX (g_get_monotonic_time () - entry->due_time, 0);
+		lateness_sum += lateness;
+		lateness_sum_squares += (gdouble) lateness * (gdouble) lateness;
+		max_lateness = MAX (max_lateness, lateness);
+
+		num_ticks++;
+		entry->num_ticks++;
+		batch_size++;
+
+		entry->func (entry->user_data);
+	}
+
+	max_batch_size = MAX (max_batch_size, batch_size);
+
+	dispatching = FALSE;
+	update_source ();
+
+	return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs scheduler_source_funcs = {
+	NULL, /* prepare; the ready time is used instead */
+	NULL, /* check */
+	scheduler_source_dispatch,
+	NULL, /* finalize */
+};
+
+/* Make sure the source is ready at the due time of the earliest entry, creating or destroying the source and heap as necessary. While the entries
+ * are being dispatched, this is deferred until the end of the batch. */
+static void
+update_source (void)
+{
+	if (dispatching == TRUE) {
+		return;
+	}
+
+	if (heap == NULL || heap->len == 0) {
+		if (source != NULL) {
+			g_source_destroy (source);
+			g_source_unref (source);
+			source = NULL;
+		}
+
+		if (heap != NULL) {
+			g_ptr_array_unref (heap);
+			heap = NULL;
+		}
+
+		return;
+	}
+
+	if (source == NULL) {
+		source = g_source_new (&scheduler_source_funcs, sizeof (GSource));
+		g_source_set_name (source, "dfsm-scheduler");
+		g_source_attach (source, NULL);
+	}
+
+	g_source_set_ready_time (source, heap_entry (0)->due_time);
+}
+
+/*
+ * dfsm_internal_scheduler_entry_init:
+ * @entry: an unscheduled #DfsmSchedulerEntry
+ * @func: function to call when the entry fires
+ * @user_data: user data to pass to @func
+ *
+ * Initialise @entry so that it calls @func when it fires, and reset its count of ticks. @entry must not currently be scheduled.
+ */
+void
+dfsm_internal_scheduler_entry_init (DfsmSchedulerEntry *entry, DfsmSchedulerFunc func, gpointer user_data)
+{
+	g_return_if_fail (entry != NULL);
+	g_return_if_fail (func != NULL);
+	g_return_if_fail (entry->heap_index == 0);
+
+	memset (entry, 0, sizeof (*entry));
+	entry->func = func;
+	entry->user_data = user_data;
+}
+
+/*
+ * dfsm_internal_scheduler_add:
+ * @entry: an unscheduled #DfsmSchedulerEntry
+ * @timeout_period: time until @entry should fire, in milliseconds
+ *
+ * Schedule @entry to fire once, after @timeout_period. It will be unscheduled just before its function is called, so may be rescheduled from
+ * within the function.
+ */
+void
+dfsm_internal_scheduler_add (DfsmSchedulerEntry *entry, guint timeout_period)
+{
+	g_return_if_fail (entry != NULL);
+	g_return_if_fail (entry->func != NULL);
+	g_return_if_fail (entry->heap_index == 0);
+
+	entry->due_time = g_get_monotonic_time () + (gint64) timeout_period * 1000;
+	entry->sequence = next_sequence++;
+
+	if (heap == NULL) {
+		heap = g_ptr_array_new ();
+	}
+
+	g_ptr_array_add (heap, entry);
+	entry->heap_index = heap->len;
+	heap_sift_up (heap->len - 1);
+
+	update_source ();
+}
+
+/*
+ * dfsm_internal_scheduler_remove:
+ * @entry: a #DfsmSchedulerEntry
+ *
+ * Unschedule @entry, if it's scheduled. Its function won't be called.
+ */
+void
+dfsm_internal_scheduler_remove (DfsmSchedulerEntry *entry)
+{
+	g_return_if_fail (entry != NULL);
+
+	if (entry->heap_index == 0) {
+		return;
+	}
+
+	heap_remove (entry);
+	update_source ();
+}
+
+/*
+ * dfsm_internal_scheduler_entry_is_scheduled:
+ * @entry: a #DfsmSchedulerEntry
+ *
+ * Return value: %TRUE if @entry is currently scheduled, %FALSE otherwise
+ */
+gboolean
+dfsm_internal_scheduler_entry_is_scheduled (const DfsmSchedulerEntry *entry)
+{
+	g_return_val_if_fail (entry != NULL, FALSE);
+
+	return (entry->heap_index != 0) ? TRUE : FALSE;
+}
+
+/**
+ * dfsm_scheduler_get_statistics:
+ * @statistics: (out caller-allocates): return location for the statistics
+ *
+ * Get statistics about the scheduling of arbitrary transitions since the last call to dfsm_scheduler_reset_statistics() (or since the program
+ * started).
+ *
+ * This is not thread safe, and must be called from the thread running the global default main context.
+ */
+void
+dfsm_scheduler_get_statistics (DfsmSchedulerStatistics *statistics)
+{
+	guint i;
+
+	g_return_if_fail (statistics != NULL);
+
+	statistics->num_wakeups = num_wakeups;
+	statistics->num_ticks = num_ticks;
+	statistics->max_batch_size = max_batch_size;
+	statistics->max_lateness = max_lateness;
+
+	if (num_ticks > 0) {
+		gdouble mean = lateness_sum / num_ticks;
+
+		statistics->mean_lateness = (gint64) mean;
+		statistics->lateness_stddev = sqrt (MAX (lateness_sum_squares / num_ticks - mean * mean, 0.0));
+	} else {
+		statistics->mean_lateness = 0;
+		statistics->lateness_stddev = 0.0;
+	}
+
+	/* Fairness between the currently scheduled objects. */
+	statistics->num_scheduled = (heap != NULL) ? heap->len : 0;
+	statistics->min_ticks_per_object = 0;
+	statistics->max_ticks_per_object = 0;
+
+	for (i = 0; i < statistics->num_scheduled; i++) {
+		guint64 entry_ticks = heap_entry (i)->num_ticks;
+
+		if (i == 0 || entry_ticks < statistics->min_ticks_per_object) {
+			statistics->min_ticks_per_object = entry_ticks;
+		}
+
+		statistics->max_ticks_per_object = MAX (statistics->max_ticks_per_object, entry_ticks);
+	}
+}
+
+/**
+ * dfsm_scheduler_reset_statistics:
+ *
+ * Reset the statistics returned by dfsm_scheduler_get_statistics(). The per-object tick counts aren't reset; they're reset each time an object's
+ * simulation is started or reset.
+ *
+ * This is not thread safe, and must be called from the thread running the global default main context.
+ */
+void
+dfsm_scheduler_reset_statistics (void)
+{
+	num_wakeups = 0;
+	num_ticks = 0;
+	max_batch_size = 0;
+	lateness_sum = 0.0;
+	lateness_sum_squares = 0.0;
+	max_lateness = 0;
+}
@@ -0,0 +1,73 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:dfsm-scheduler
+ * @short_description: arbitrary transition scheduling
+ * @stability: Unstable
+ * @include: dfsm/dfsm-scheduler.h
+ *
+ * The arbitrary transitions of all running #DfsmObject<!-- -->s are scheduled by a single timer heap, which is driven by one main loop source in
+ * the global default main context. All the ticks which are due when the source is dispatched are fired as a batch, earliest first, with ties broken
+ * in the order the ticks were scheduled in, so no object can starve another.
+ *
+ * Statistics about how closely the ticks kept to their schedule, and how evenly they were shared between objects, can be retrieved using
+ * dfsm_scheduler_get_statistics().
+ */
+
+#include <glib.h>
+
+#ifndef DFSM_SCHEDULER_H
+#define DFSM_SCHEDULER_H
+
+G_BEGIN_DECLS
+
+/**
+ * DfsmSchedulerStatistics:
+ * @num_wakeups: number of times the scheduler's main loop source has been dispatched
+ * @num_ticks: number of arbitrary transition ticks fired
+ * @max_batch_size: largest number of ticks fired in a single wakeup
+ * @num_scheduled: number of objects which currently have a tick scheduled
+ * @mean_lateness: mean delay between a tick being due and it being fired, in microseconds
+ * @max_lateness: largest delay between a tick being due and it being fired, in microseconds
+ * @lateness_stddev: standard deviation of the delay between a tick being due and it being fired (the jitter), in microseconds
+ * @min_ticks_per_object: smallest number of ticks fired for any currently scheduled object since its simulation was started or reset
+ * @max_ticks_per_object: largest number of ticks fired for any currently scheduled object since its simulation was started or reset
+ *
+ * Statistics about the scheduling of arbitrary transitions, accumulated since the last call to dfsm_scheduler_reset_statistics(). The per-object
+ * tick counts give a measure of fairness: if all objects were started at the same time, they should be similar.
+ */
+typedef struct {
+	guint64 num_wakeups;
+	guint64 num_ticks;
+	guint max_batch_size;
+	guint num_scheduled;
+	gint64 mean_lateness;
+	gint64 max_lateness;
+	gdouble lateness_stddev;
+	guint64 min_ticks_per_object;
+	guint64 max_ticks_per_object;
+} DfsmSchedulerStatistics;
+
+void dfsm_scheduler_get_statistics (DfsmSchedulerStatistics *statistics);
+void dfsm_scheduler_reset_statistics (void);
+
+G_END_DECLS
+
+#endif /* !DFSM_SCHEDULER_H */
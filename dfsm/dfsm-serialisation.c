@@ -0,0 +1,226 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "dfsm-parser-internal.h"
+
+/* The compiled machine cache stores ASTs as a flat stream of values, written in the order the AST is walked, rather than as a tree of GVariants:
+ * unpacking a GVariant tree allocates a new GVariant (and looks up its type) for every child, which made loading a machine from the cache slower than
+ * parsing it. Integers and doubles are little endian and unaligned. Strings are a uint32 of their length plus one (or 0 for a NULL string), followed
+ * by their bytes and a nul terminator. Since the data's untrusted, every read is bounds checked, and fails rather than running off the end. */
+
+/* Maximum nesting of expressions in a serialised AST. Anything deeper is rejected, rather than risking overflowing the stack while rebuilding it. */
+#define MAX_DEPTH 1000
+
+void
+dfsm_internal_serialise_byte (GByteArray *buffer, guint8 value)
+{
+	g_byte_array_append (buffer, &value, sizeof (value));
+}
+
+void
+dfsm_internal_serialise_uint32 (GByteArray *buffer, guint32 value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (buffer, (const guint8*) &value, sizeof (value));
+}
+
+void
+dfsm_internal_serialise_double (GByteArray *buffer, gdouble value)
+{
+	guint64 bits;
+
+	G_STATIC_ASSERT (sizeof (bits) == sizeof (value));
+
+	memcpy (&bits, &value, sizeof (bits));
+	bits = GUINT64_TO_LE (bits);
+	g_byte_array_append (buffer, (const guint8*) &bits, sizeof (bits));
+}
+
+/* @str may be %NULL. */
+void
+dfsm_internal_serialise_string (GByteArray *buffer, const gchar *str)
+{
+	gsize length;
+
+	if (str == NULL) {
+		dfsm_internal_serialise_uint32 (buffer, 0);
+		return;
+	}
+
+	length = strlen (str);
+	g_assert (length < G_MAXUINT32);
+
+	dfsm_internal_serialise_uint32 (buffer, length + 1);
+	g_byte_array_append (buffer, (const guint8*) str, length + 1);
+}
+
+/* @data must remain valid until the deserialiser's finished with. */
+void
+dfsm_internal_deserialiser_init (DfsmDeserialiser *self, const guint8 *data, gsize length)
+{
+	self->data = data;
+	self->length = length;
+	self->offset = 0;
+	self->depth = 0;
+}
+
+/* Whether all the data has been read. */
+gboolean
+dfsm_internal_deserialiser_is_finished (const DfsmDeserialiser *self)
+{
+	return (self->offset == self->length) ? TRUE : FALSE;
+}
+
+/* Enter a nested node. Returns %FALSE if the nesting is too deep; otherwise, dfsm_internal_deserialiser_leave() must be called after reading it. */
+gboolean
+dfsm_internal_deserialiser_enter (DfsmDeserialiser *self)
+{
+	if (self->depth >= MAX_DEPTH) {
+		return FALSE;
+	}
+
+	self->depth++;
+
+	return TRUE;
+}
+
+void
+dfsm_internal_deserialiser_leave (DfsmDeserialiser *self)
+{
+	g_assert (self->depth > 0);
+	self->depth--;
+}
+
+static const guint8 *
+read_bytes (DfsmDeserialiser *self, gsize length)
+{
+	const guint8 *retval;
+
+	if (self->length - self->offset < length) {
+		return NULL;
+	}
+
+	retval = self->data + self->offset;
+	self->offset += length;
+
+	return retval;
+}
+
+gboolean
+dfsm_internal_deserialise_byte (DfsmDeserialiser *self, guint8 *value)
+{
+	const guint8 *data = read_bytes (self, sizeof (*value));
+
+	if (data == NULL) {
+		return FALSE;
+	}
+
+	*value = *data;
+
+	return TRUE;
+}
+
+gboolean
+dfsm_internal_deserialise_uint32 (DfsmDeserialiser *self, guint32 *value)
+{
+	const guint8 *data = read_bytes (self, sizeof (*value));
+
+	if (data == NULL) {
+		return FALSE;
+	}
+
+	memcpy (value, data, sizeof (*value));
+	*value = GUINT32_FROM_LE (*value);
+
+	return TRUE;
+}
+
+/* Read the number of elements in an array. Each element takes at least one byte, so lengths longer than the remaining data are rejected up front. */
+gboolean
+dfsm_internal_deserialise_length (DfsmDeserialiser *self, guint32 *length)
+{
+	return (dfsm_internal_deserialise_uint32 (self, length) == TRUE && *length <= self->length - self->offset) ? TRUE : FALSE;
+}
+
+gboolean
+dfsm_internal_deserialise_double (DfsmDeserialiser *self, gdouble *value)
+{
+	const guint8 *data = read_bytes (self, sizeof (guint64));
+	guint64 bits;
+
+	if (data == NULL) {
+		return FALSE;
+	}
+
+	memcpy (&bits, data, sizeof (bits));
+	bits = GUINT64_FROM_LE (bits);
+	memcpy (value, &bits, sizeof (*value));
+
+	return TRUE;
+}
+
+/* Read a string which may be %NULL, without validating it as UTF-8. The returned string points into the deserialiser's data. */
+static gboolean
+read_string (DfsmDeserialiser *self, const gchar **str)
+{
+	guint32 length;
+	const gchar *data;
+
+	if (dfsm_internal_deserialise_uint32 (self, &length) == FALSE) {
+		return FALSE;
+	} else if (length == 0) {
+		*str = NULL;
+		return TRUE;
+	}
+
+	data = (const gchar*) read_bytes (self, length);
+
+	/* The string must be nul-terminated, with no embedded nuls. */
+	if (data == NULL || data[length - 1] != '\0' || memchr (data, '\0', length - 1) != NULL) {
+		return FALSE;
+	}
+
+	*str = data;
+
+	return TRUE;
+}
+
+/* Read a non-%NULL UTF-8 string. The returned string points into the deserialiser's data. */
+gboolean
+dfsm_internal_deserialise_string (DfsmDeserialiser *self, const gchar **str)
+{
+	return (read_string (self, str) == TRUE && *str != NULL && g_utf8_validate (*str, -1, NULL) == TRUE) ? TRUE : FALSE;
+}
+
+/* Like dfsm_internal_deserialise_string(), but the string may be %NULL. */
+gboolean
+dfsm_internal_deserialise_maybe_string (DfsmDeserialiser *self, const gchar **str)
+{
+	return (read_string (self, str) == TRUE && (*str == NULL || g_utf8_validate (*str, -1, NULL) == TRUE)) ? TRUE : FALSE;
+}
+
+/* Like dfsm_internal_deserialise_string(), but the string isn't validated as UTF-8. */
+gboolean
+dfsm_internal_deserialise_bytestring (DfsmDeserialiser *self, const gchar **str)
+{
+	return (read_string (self, str) == TRUE && *str != NULL) ? TRUE : FALSE;
+}
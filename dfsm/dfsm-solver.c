@@ -0,0 +1,760 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Precondition solver. This looks for values of object variables which satisfy a transition's preconditions, so that transitions guarded by
+ * preconditions which the simulation rarely satisfies by itself can be fuzzed.
+ *
+ * The preconditions' conditions are walked to build a conjunction of simple constraints on individual object variables: intervals for numeric
+ * variables (from comparisons against expressions which don't involve the variable, optionally with a constant added to or subtracted from the
+ * variable), and equalities and inequalities for all other types. Negations are pushed down through the tree, and one side of each disjunction is
+ * chosen at random. Sub-expressions which don't fit these forms (such as function calls or other arithmetic) are ignored. Values are then picked
+ * within the constraints, preferring values on the boundaries of intervals, and the preconditions are checked against them for real. Since the
+ * disjunctions and values are chosen randomly, several attempts are made before giving up.
+ */
+
+#include <math.h>
+#include <glib.h>
+
+#include "dfsm-ast.h"
+#include "dfsm-environment.h"
+#include "dfsm-internal.h"
+#include "dfsm-parser-internal.h"
+
+/* Number of attempts to make at finding values which satisfy a transition's preconditions. */
+#define MAX_ATTEMPTS 8
+
+/* Maximum distance from the boundary of an interval to pick values at. */
+#define MAX_BOUNDARY_OFFSET 16.0
+
+typedef struct {
+	const gchar *variable_name; /* owned by the AST */
+	GVariantType *variable_type;
+	gboolean is_numeric;
+
+	/* Numeric variables. Bounds are inclusive, and are only tightened from the bounds of the variable's type. Doubles can't represent all 64-bit
+	 * integers, but the preconditions are checked for real afterwards, so any imprecision just results in a failed attempt. */
+	gdouble lower_bound, upper_bound;
+	gboolean has_lower_bound, has_upper_bound;
+	GArray/*<gdouble>*/ *excluded_numbers;
+
+	/* Other variables. */
+	GVariant *required_value; /* NULL if unconstrained */
+	GPtrArray/*<GVariant>*/ *excluded_values;
+
+	gboolean unsatisfiable;
+} VariableConstraint;
+
+static VariableConstraint *
+variable_constraint_new (const gchar *variable_name, GVariantType *variable_type /* transfer full */)
+{
+	VariableConstraint *constraint;
+
+	constraint = g_slice_new0 (VariableConstraint);
+	constraint->variable_name = variable_name;
+	constraint->variable_type = variable_type;
+	constraint->is_numeric = TRUE;
+
+	if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_BYTE) == TRUE) {
+		constraint->lower_bound = 0;
+		constraint->upper_bound = G_MAXUINT8;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_INT16) == TRUE) {
+		constraint->lower_bound = G_MININT16;
+		constraint->upper_bound = G_MAXINT16;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_UINT16) == TRUE) {
+		constraint->lower_bound = 0;
+		constraint->upper_bound = G_MAXUINT16;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_INT32) == TRUE) {
+		constraint->lower_bound = G_MININT32;
+		constraint->upper_bound = G_MAXINT32;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_UINT32) == TRUE) {
+		constraint->lower_bound = 0;
+		constraint->upper_bound = G_MAXUINT32;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_INT64) == TRUE) {
+		constraint->lower_bound = G_MININT64;
+		constraint->upper_bound = G_MAXINT64;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_UINT64) == TRUE) {
+		constraint->lower_bound = 0;
+		constraint->upper_bound = G_MAXUINT64;
+	} else if (g_variant_type_equal (variable_type, G_VARIANT_TYPE_DOUBLE) == TRUE) {
+		constraint->lower_bound = -G_MAXDOUBLE;
+		constraint->upper_bound = G_MAXDOUBLE;
+	} else {
+		constraint->is_numeric = FALSE;
+	}
+
+	constraint->excluded_numbers = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	constraint->excluded_values = g_ptr_array_new_with_free_func ((GDestroyNotify) g_variant_unref);
+
+	return constraint;
+}
+
+static void
+variable_constraint_free (VariableConstraint *constraint)
+{
+	if (constraint->required_value != NULL) {
+		g_variant_unref (constraint->required_value);
+	}
+
+	g_ptr_array_unref (constraint->excluded_values);
+	g_array_unref (constraint->excluded_numbers);
+	g_variant_type_free (constraint->variable_type);
+
+	g_slice_free (VariableConstraint, constraint);
+}
+
+static gboolean
+variant_to_number (GVariant *value, gdouble *number)
+{
+	switch (g_variant_classify (value)) {
+		case G_VARIANT_CLASS_BYTE:
+			*number = g_variant_get_byte (value);
+			return TRUE;
+		case G_VARIANT_CLASS_INT16:
+			*number = g_variant_get_int16 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_UINT16:
+			*number = g_variant_get_uint16 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_INT32:
+			*number = g_variant_get_int32 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_UINT32:
+			*number = g_variant_get_uint32 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_INT64:
+			*number = g_variant_get_int64 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_UINT64:
+			*number = g_variant_get_uint64 (value);
+			return TRUE;
+		case G_VARIANT_CLASS_DOUBLE:
+			*number = g_variant_get_double (value);
+			return TRUE;
+		case G_VARIANT_CLASS_BOOLEAN:
+		case G_VARIANT_CLASS_STRING:
+		case G_VARIANT_CLASS_OBJECT_PATH:
+		case G_VARIANT_CLASS_SIGNATURE:
+		case G_VARIANT_CLASS_VARIANT:
+		case G_VARIANT_CLASS_MAYBE:
+		case G_VARIANT_CLASS_ARRAY:
+		case G_VARIANT_CLASS_TUPLE:
+		case G_VARIANT_CLASS_DICT_ENTRY:
+		case G_VARIANT_CLASS_HANDLE:
+		default:
+			return FALSE;
+	}
+}
+
+static GVariant *
+number_to_variant (gdouble number, const GVariantType *variant_type)
+{
+	/* Clamp and round the number to fit the type. */
+	#define INTEGER_TO_VARIANT(type, TYPE, gtype, TYPE_MIN, TYPE_MAX) \
+		if (g_variant_type_equal (variant_type, G_VARIANT_TYPE_##TYPE) == TRUE) { \
+			return g_variant_new_##type ((gtype) CLAMP (round (number), (gdouble) (TYPE_MIN), (gdouble) (TYPE_MAX))); \
+		}
+
+	INTEGER_TO_VARIANT (byte, BYTE, guchar, 0, G_MAXUINT8)
+	INTEGER_TO_VARIANT (int16, INT16, gint16, G_MININT16, G_MAXINT16)
+	INTEGER_TO_VARIANT (uint16, UINT16, guint16, 0, G_MAXUINT16)
+	INTEGER_TO_VARIANT (int32, INT32, gint32, G_MININT32, G_MAXINT32)
+	INTEGER_TO_VARIANT (uint32, UINT32, guint32, 0, G_MAXUINT32)
+	INTEGER_TO_VARIANT (int64, INT64, gint64, G_MININT64, G_MAXINT64)
+	INTEGER_TO_VARIANT (uint64, UINT64, guint64, 0, G_MAXUINT64)
+
+	#undef INTEGER_TO_VARIANT
+
+	g_assert (g_variant_type_equal (variant_type, G_VARIANT_TYPE_DOUBLE) == TRUE);
+
+	return g_variant_new_double (number);
+}
+
+/* If @expression is a direct reference to an object variable, return the variable's name. Otherwise, return NULL. */
+static const gchar *
+get_object_variable_name (DfsmAstExpression *expression)
+{
+	DfsmAstVariable *variable;
+
+	if (DFSM_IS_AST_EXPRESSION_DATA_STRUCTURE (expression) == FALSE) {
+		return NULL;
+	}
+
+	variable = dfsm_ast_data_structure_get_variable (
+		dfsm_ast_expression_data_structure_get_data_structure (DFSM_AST_EXPRESSION_DATA_STRUCTURE (expression)));
+
+	if (variable == NULL || dfsm_ast_variable_get_scope (variable) != DFSM_VARIABLE_SCOPE_OBJECT) {
+		return NULL;
+	}
+
+	return dfsm_ast_variable_get_name (variable);
+}
+
+/* If @expression is of the form ‘object->x’, ‘object->x + c’, ‘c + object->x’ or ‘object->x - c’, where c is numeric, return x's name
+ * and set @offset to the value added to x. Otherwise, return NULL. c is evaluated in @environment, so may reference other variables. */
+static const gchar *
+get_offset_object_variable_name (DfsmAstExpression *expression, DfsmEnvironment *environment, gdouble *offset)
+{
+	DfsmAstExpressionBinary *binary_expression;
+	DfsmAstExpressionBinaryType expression_type;
+	DfsmAstExpression *variable_node, *constant_node;
+	const gchar *variable_name;
+	GVariant *constant_value;
+	gboolean is_number;
+
+	variable_name = get_object_variable_name (expression);
+
+	if (variable_name != NULL) {
+		*offset = 0.0;
+		return variable_name;
+	}
+
+	if (DFSM_IS_AST_EXPRESSION_BINARY (expression) == FALSE) {
+		return NULL;
+	}
+
+	binary_expression = DFSM_AST_EXPRESSION_BINARY (expression);
+	expression_type = dfsm_ast_expression_binary_get_expression_type (binary_expression);
+
+	if (expression_type != DFSM_AST_EXPRESSION_BINARY_PLUS && expression_type != DFSM_AST_EXPRESSION_BINARY_MINUS) {
+		return NULL;
+	}
+
+	variable_node = dfsm_ast_expression_binary_get_left_node (binary_expression);
+	constant_node = dfsm_ast_expression_binary_get_right_node (binary_expression);
+	variable_name = get_object_variable_name (variable_node);
+
+	if (variable_name == NULL && expression_type == DFSM_AST_EXPRESSION_BINARY_PLUS) {
+		variable_node = dfsm_ast_expression_binary_get_right_node (binary_expression);
+		constant_node = dfsm_ast_expression_binary_get_left_node (binary_expression);
+		variable_name = get_object_variable_name (variable_node);
+	}
+
+	if (variable_name == NULL) {
+		return NULL;
+	}
+
+	constant_value = dfsm_ast_expression_evaluate (constant_node, environment);
+	is_number = variant_to_number (constant_value, offset);
+	g_variant_unref (constant_value);
+
+	if (is_number == FALSE) {
+		return NULL;
+	}
+
+	if (expression_type == DFSM_AST_EXPRESSION_BINARY_MINUS) {
+		*offset = -*offset;
+	}
+
+	return variable_name;
+}
+
+static VariableConstraint *
+look_up_constraint (GHashTable/*<string, VariableConstraint>*/ *constraints, const gchar *variable_name, DfsmEnvironment *environment)
+{
+	VariableConstraint *constraint;
+
+	constraint = g_hash_table_lookup (constraints, variable_name);
+
+	if (constraint == NULL) {
+		constraint = variable_constraint_new (variable_name,
+		                                      dfsm_environment_dup_variable_type (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name));
+		g_hash_table_insert (constraints, (gpointer) variable_name, constraint);
+	}
+
+	return constraint;
+}
+
+/* Constrain the variable in @constraint so that ‘variable @comparison_type @value’ holds. @value must not be floating. */
+static void
+add_comparison (VariableConstraint *constraint, DfsmAstExpressionBinaryType comparison_type, GVariant *value)
+{
+	gdouble number;
+
+	if (constraint->is_numeric == FALSE) {
+		/* Only equality comparisons make sense for non-numeric types. */
+		if (g_variant_is_of_type (value, constraint->variable_type) == FALSE) {
+			return;
+		}
+
+		if (comparison_type == DFSM_AST_EXPRESSION_BINARY_NEQ && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN) == TRUE) {
+			/* Booleans only have one other value. */
+			GVariant *other_value = g_variant_ref_sink (g_variant_new_boolean (!g_variant_get_boolean (value)));
+			add_comparison (constraint, DFSM_AST_EXPRESSION_BINARY_EQ, other_value);
+			g_variant_unref (other_value);
+		} else if (comparison_type == DFSM_AST_EXPRESSION_BINARY_EQ) {
+			if (constraint->required_value == NULL) {
+				constraint->required_value = g_variant_ref (value);
+			} else if (g_variant_equal (constraint->required_value, value) == FALSE) {
+				constraint->unsatisfiable = TRUE;
+			}
+		} else if (comparison_type == DFSM_AST_EXPRESSION_BINARY_NEQ) {
+			g_ptr_array_add (constraint->excluded_values, g_variant_ref (value));
+		}
+
+		return;
+	}
+
+	if (variant_to_number (value, &number) == FALSE) {
+		return;
+	}
+
+	/* Integers are rounded inwards. Strict comparisons of doubles use the next representable double. */
+	if (g_variant_type_equal (constraint->variable_type, G_VARIANT_TYPE_DOUBLE) == FALSE) {
+		switch (comparison_type) {
+			case DFSM_AST_EXPRESSION_BINARY_LT:
+				number = ceil (number) - 1.0;
+				comparison_type = DFSM_AST_EXPRESSION_BINARY_LTE;
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_LTE:
+				number = floor (number);
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_GT:
+				number = floor (number) + 1.0;
+				comparison_type = DFSM_AST_EXPRESSION_BINARY_GTE;
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_GTE:
+				number = ceil (number);
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_EQ:
+			case DFSM_AST_EXPRESSION_BINARY_NEQ:
+			case DFSM_AST_EXPRESSION_BINARY_TIMES:
+			case DFSM_AST_EXPRESSION_BINARY_DIVIDE:
+			case DFSM_AST_EXPRESSION_BINARY_MODULUS:
+			case DFSM_AST_EXPRESSION_BINARY_PLUS:
+			case DFSM_AST_EXPRESSION_BINARY_MINUS:
+			case DFSM_AST_EXPRESSION_BINARY_AND:
+			case DFSM_AST_EXPRESSION_BINARY_OR:
+			default:
+				break;
+		}
+	} else if (comparison_type == DFSM_AST_EXPRESSION_BINARY_LT) {
+		number = nextafter (number, -G_MAXDOUBLE);
+		comparison_type = DFSM_AST_EXPRESSION_BINARY_LTE;
+	} else if (comparison_type == DFSM_AST_EXPRESSION_BINARY_GT) {
+		number = nextafter (number, G_MAXDOUBLE);
+		comparison_type = DFSM_AST_EXPRESSION_BINARY_GTE;
+	}
+
+	switch (comparison_type) {
+		case DFSM_AST_EXPRESSION_BINARY_LTE:
+			constraint->upper_bound = MIN (constraint->upper_bound, number);
+			constraint->has_upper_bound = TRUE;
+			break;
+		case DFSM_AST_EXPRESSION_BINARY_GTE:
+			constraint->lower_bound = MAX (constraint->lower_bound, number);
+			constraint->has_lower_bound = TRUE;
+			break;
+		case DFSM_AST_EXPRESSION_BINARY_EQ:
+			constraint->lower_bound = MAX (constraint->lower_bound, number);
+			constraint->upper_bound = MIN (constraint->upper_bound, number);
+			constraint->has_lower_bound = TRUE;
+			constraint->has_upper_bound = TRUE;
+			break;
+		case DFSM_AST_EXPRESSION_BINARY_NEQ:
+			g_array_append_val (constraint->excluded_numbers, number);
+			break;
+		case DFSM_AST_EXPRESSION_BINARY_LT:
+		case DFSM_AST_EXPRESSION_BINARY_GT:
+		case DFSM_AST_EXPRESSION_BINARY_TIMES:
+		case DFSM_AST_EXPRESSION_BINARY_DIVIDE:
+		case DFSM_AST_EXPRESSION_BINARY_MODULUS:
+		case DFSM_AST_EXPRESSION_BINARY_PLUS:
+		case DFSM_AST_EXPRESSION_BINARY_MINUS:
+		case DFSM_AST_EXPRESSION_BINARY_AND:
+		case DFSM_AST_EXPRESSION_BINARY_OR:
+		default:
+			g_assert_not_reached ();
+	}
+
+	if (constraint->lower_bound > constraint->upper_bound) {
+		constraint->unsatisfiable = TRUE;
+	}
+}
+
+static DfsmAstExpressionBinaryType
+negate_comparison (DfsmAstExpressionBinaryType comparison_type)
+{
+	switch (comparison_type) {
+		case DFSM_AST_EXPRESSION_BINARY_LT:
+			return DFSM_AST_EXPRESSION_BINARY_GTE;
+		case DFSM_AST_EXPRESSION_BINARY_LTE:
+			return DFSM_AST_EXPRESSION_BINARY_GT;
+		case DFSM_AST_EXPRESSION_BINARY_GT:
+			return DFSM_AST_EXPRESSION_BINARY_LTE;
+		case DFSM_AST_EXPRESSION_BINARY_GTE:
+			return DFSM_AST_EXPRESSION_BINARY_LT;
+		case DFSM_AST_EXPRESSION_BINARY_EQ:
+			return DFSM_AST_EXPRESSION_BINARY_NEQ;
+		case DFSM_AST_EXPRESSION_BINARY_NEQ:
+			return DFSM_AST_EXPRESSION_BINARY_EQ;
+		case DFSM_AST_EXPRESSION_BINARY_TIMES:
+		case DFSM_AST_EXPRESSION_BINARY_DIVIDE:
+		case DFSM_AST_EXPRESSION_BINARY_MODULUS:
+		case DFSM_AST_EXPRESSION_BINARY_PLUS:
+		case DFSM_AST_EXPRESSION_BINARY_MINUS:
+		case DFSM_AST_EXPRESSION_BINARY_AND:
+		case DFSM_AST_EXPRESSION_BINARY_OR:
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+/* Swap the operands of a comparison: ‘a < b’ is equivalent to ‘b > a’. */
+static DfsmAstExpressionBinaryType
+swap_comparison (DfsmAstExpressionBinaryType comparison_type)
+{
+	switch (comparison_type) {
+		case DFSM_AST_EXPRESSION_BINARY_LT:
+			return DFSM_AST_EXPRESSION_BINARY_GT;
+		case DFSM_AST_EXPRESSION_BINARY_LTE:
+			return DFSM_AST_EXPRESSION_BINARY_GTE;
+		case DFSM_AST_EXPRESSION_BINARY_GT:
+			return DFSM_AST_EXPRESSION_BINARY_LT;
+		case DFSM_AST_EXPRESSION_BINARY_GTE:
+			return DFSM_AST_EXPRESSION_BINARY_LTE;
+		case DFSM_AST_EXPRESSION_BINARY_EQ:
+		case DFSM_AST_EXPRESSION_BINARY_NEQ:
+			return comparison_type;
+		case DFSM_AST_EXPRESSION_BINARY_TIMES:
+		case DFSM_AST_EXPRESSION_BINARY_DIVIDE:
+		case DFSM_AST_EXPRESSION_BINARY_MODULUS:
+		case DFSM_AST_EXPRESSION_BINARY_PLUS:
+		case DFSM_AST_EXPRESSION_BINARY_MINUS:
+		case DFSM_AST_EXPRESSION_BINARY_AND:
+		case DFSM_AST_EXPRESSION_BINARY_OR:
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+static void
+collect_comparison_constraints (DfsmAstExpressionBinary *expression, DfsmAstExpressionBinaryType comparison_type,
+                                GHashTable/*<string, VariableConstraint>*/ *constraints, DfsmEnvironment *environment)
+{
+	DfsmAstExpression *variable_node, *value_node;
+	const gchar *variable_name;
+	VariableConstraint *constraint;
+	GVariant *value;
+	gdouble offset;
+
+	/* Find which side the variable's on. */
+	variable_node = dfsm_ast_expression_binary_get_left_node (expression);
+	value_node = dfsm_ast_expression_binary_get_right_node (expression);
+	variable_name = get_offset_object_variable_name (variable_node, environment, &offset);
+
+	if (variable_name == NULL) {
+		variable_node = dfsm_ast_expression_binary_get_right_node (expression);
+		value_node = dfsm_ast_expression_binary_get_left_node (expression);
+		variable_name = get_offset_object_variable_name (variable_node, environment, &offset);
+		comparison_type = swap_comparison (comparison_type);
+	}
+
+	if (variable_name == NULL || dfsm_environment_has_variable (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name) == FALSE) {
+		return;
+	}
+
+	constraint = look_up_constraint (constraints, variable_name, environment);
+	value = dfsm_ast_expression_evaluate (value_node, environment);
+
+	if (offset != 0.0) {
+		gdouble number;
+
+		/* ‘x + offset OP value’ is equivalent to ‘x OP value - offset’. */
+		if (constraint->is_numeric == TRUE && variant_to_number (value, &number) == TRUE) {
+			GVariant *offset_value = g_variant_ref_sink (g_variant_new_double (number - offset));
+			add_comparison (constraint, comparison_type, offset_value);
+			g_variant_unref (offset_value);
+		}
+	} else {
+		add_comparison (constraint, comparison_type, value);
+	}
+
+	g_variant_unref (value);
+}
+
+/* Walk @expression, adding constraints to @constraints which (if satisfied) would make @expression evaluate to TRUE, or to FALSE if @negated is
+ * TRUE. Sub-expressions which can't be handled are ignored. */
+static void
+collect_constraints (DfsmAstExpression *expression, gboolean negated, GHashTable/*<string, VariableConstraint>*/ *constraints,
+                     DfsmEnvironment *environment)
+{
+	if (DFSM_IS_AST_EXPRESSION_UNARY (expression) == TRUE) {
+		DfsmAstExpressionUnary *unary_expression = DFSM_AST_EXPRESSION_UNARY (expression);
+
+		if (dfsm_ast_expression_unary_get_expression_type (unary_expression) == DFSM_AST_EXPRESSION_UNARY_NOT) {
+			collect_constraints (dfsm_ast_expression_unary_get_child_node (unary_expression), !negated, constraints, environment);
+		}
+	} else if (DFSM_IS_AST_EXPRESSION_BINARY (expression) == TRUE) {
+		DfsmAstExpressionBinary *binary_expression = DFSM_AST_EXPRESSION_BINARY (expression);
+		DfsmAstExpressionBinaryType expression_type;
+
+		expression_type = dfsm_ast_expression_binary_get_expression_type (binary_expression);
+
+		switch (expression_type) {
+			case DFSM_AST_EXPRESSION_BINARY_AND:
+			case DFSM_AST_EXPRESSION_BINARY_OR:
+				/* Conjunctions (including negated disjunctions, by De Morgan's laws) need both sides to hold. For disjunctions, only
+				 * one side needs to hold, so pick one at random. */
+				if ((expression_type == DFSM_AST_EXPRESSION_BINARY_AND) != negated) {
+					collect_constraints (dfsm_ast_expression_binary_get_left_node (binary_expression), negated, constraints,
+					                     environment);
+					collect_constraints (dfsm_ast_expression_binary_get_right_node (binary_expression), negated, constraints,
+					                     environment);
+				} else if (g_rand_boolean (dfsm_internal_environment_get_rand (environment)) == TRUE) {
+					collect_constraints (dfsm_ast_expression_binary_get_left_node (binary_expression), negated, constraints,
+					                     environment);
+				} else {
+					collect_constraints (dfsm_ast_expression_binary_get_right_node (binary_expression), negated, constraints,
+					                     environment);
+				}
+
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_LT:
+			case DFSM_AST_EXPRESSION_BINARY_LTE:
+			case DFSM_AST_EXPRESSION_BINARY_GT:
+			case DFSM_AST_EXPRESSION_BINARY_GTE:
+			case DFSM_AST_EXPRESSION_BINARY_EQ:
+			case DFSM_AST_EXPRESSION_BINARY_NEQ:
+				collect_comparison_constraints (binary_expression,
+				                                (negated == TRUE) ? negate_comparison (expression_type) : expression_type,
+				                                constraints, environment);
+				break;
+			case DFSM_AST_EXPRESSION_BINARY_TIMES:
+			case DFSM_AST_EXPRESSION_BINARY_DIVIDE:
+			case DFSM_AST_EXPRESSION_BINARY_MODULUS:
+			case DFSM_AST_EXPRESSION_BINARY_PLUS:
+			case DFSM_AST_EXPRESSION_BINARY_MINUS:
+			default:
+				/* Not a Boolean expression. */
+				break;
+		}
+	} else {
+		const gchar *variable_name = get_object_variable_name (expression);
+
+		/* A bare Boolean variable. */
+		if (variable_name != NULL && dfsm_environment_has_variable (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name) == TRUE) {
+			GVariant *value = g_variant_ref_sink (g_variant_new_boolean (!negated));
+			add_comparison (look_up_constraint (constraints, variable_name, environment), DFSM_AST_EXPRESSION_BINARY_EQ, value);
+			g_variant_unref (value);
+		}
+	}
+}
+
+static gboolean
+number_is_excluded (VariableConstraint *constraint, gdouble number)
+{
+	guint i;
+
+	for (i = 0; i < constraint->excluded_numbers->len; i++) {
+		if (g_array_index (constraint->excluded_numbers, gdouble, i) == number) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+value_is_excluded (VariableConstraint *constraint, GVariant *value)
+{
+	guint i;
+
+	for (i = 0; i < constraint->excluded_values->len; i++) {
+		if (g_variant_equal (g_ptr_array_index (constraint->excluded_values, i), value) == TRUE) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Pick a value for the variable which satisfies @constraint, or return NULL if one couldn't be found. */
+static GVariant *
+pick_value (VariableConstraint *constraint, DfsmEnvironment *environment)
+{
+	GRand *rand = dfsm_internal_environment_get_rand (environment);
+	GVariant *current_value;
+	gdouble number, width, offset;
+	gboolean is_integer;
+	guint i;
+
+	if (constraint->unsatisfiable == TRUE) {
+		return NULL;
+	}
+
+	current_value = dfsm_environment_dup_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, constraint->variable_name);
+
+	if (constraint->is_numeric == FALSE) {
+		/* Use the required value, or keep the current value if it isn't excluded. There's no general way to pick another value. */
+		if (constraint->required_value != NULL) {
+			g_variant_unref (current_value);
+			current_value = g_variant_ref (constraint->required_value);
+		}
+
+		if (value_is_excluded (constraint, current_value) == TRUE) {
+			g_variant_unref (current_value);
+			return NULL;
+		}
+
+		return current_value;
+	}
+
+	/* Numeric variables. Prefer values near whichever bounds were set by the preconditions, since the values on either side of a boundary are the
+	 * most interesting. If there are no such bounds, start from the current value. */
+	is_integer = !g_variant_type_equal (constraint->variable_type, G_VARIANT_TYPE_DOUBLE);
+	width = MIN (constraint->upper_bound - constraint->lower_bound, MAX_BOUNDARY_OFFSET);
+	offset = (is_integer == TRUE) ? floor (g_rand_double_range (rand, 0.0, width + 1.0)) : g_rand_double_range (rand, 0.0, width);
+
+	if (constraint->has_lower_bound == TRUE && (constraint->has_upper_bound == FALSE || g_rand_boolean (rand) == TRUE)) {
+		number = constraint->lower_bound + offset;
+	} else if (constraint->has_upper_bound == TRUE) {
+		number = constraint->upper_bound - offset;
+	} else {
+		variant_to_number (current_value, &number);
+	}
+
+	g_variant_unref (current_value);
+
+	/* Step away from any excluded values, staying within the bounds. */
+	for (i = 0; number_is_excluded (constraint, number) == TRUE && i < constraint->excluded_numbers->len; i++) {
+		gdouble step = (is_integer == TRUE) ? 1.0 : MAX (fabs (number) * G_DOUBLE_EPSILON, G_MINDOUBLE);
+
+		number = (number + step <= constraint->upper_bound) ? number + step : number - step;
+	}
+
+	if (number < constraint->lower_bound || number > constraint->upper_bound || number_is_excluded (constraint, number) == TRUE) {
+		return NULL;
+	}
+
+	return g_variant_ref_sink (number_to_variant (number, constraint->variable_type));
+}
+
+/* Pick values for all the constrained variables and assign them in @environment, storing the old values in @old_values so they can be restored.
+ * Return FALSE if a value couldn't be picked for any of the variables, in which case @environment is left unchanged. */
+static gboolean
+assign_values (GHashTable/*<string, VariableConstraint>*/ *constraints, DfsmEnvironment *environment,
+               GHashTable/*<string, GVariant>*/ *old_values)
+{
+	GHashTable/*<string, GVariant>*/ *new_values;
+	GHashTableIter iter;
+	const gchar *variable_name;
+	VariableConstraint *constraint;
+	GVariant *value;
+
+	new_values = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_variant_unref);
+	g_hash_table_iter_init (&iter, constraints);
+
+	while (g_hash_table_iter_next (&iter, (gpointer*) &variable_name, (gpointer*) &constraint) == TRUE) {
+		value = pick_value (constraint, environment);
+
+		if (value == NULL) {
+			g_hash_table_unref (new_values);
+			return FALSE;
+		}
+
+		g_hash_table_insert (new_values, (gpointer) variable_name, value);
+	}
+
+	g_hash_table_iter_init (&iter, new_values);
+
+	while (g_hash_table_iter_next (&iter, (gpointer*) &variable_name, (gpointer*) &value) == TRUE) {
+		g_hash_table_insert (old_values, (gpointer) variable_name,
+		                     dfsm_environment_dup_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name));
+		dfsm_environment_set_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name, value);
+	}
+
+	g_hash_table_unref (new_values);
+
+	return TRUE;
+}
+
+/*
+ * dfsm_internal_solve_preconditions:
+ * @transition: a transition whose preconditions aren't currently satisfied
+ * @environment: the environment to check the preconditions against
+ *
+ * Try to find values for the object variables in @environment which satisfy all of @transition's preconditions, using simple constraint
+ * propagation over the preconditions' conditions. If values are found, they're assigned in @environment and %TRUE is returned. Otherwise,
+ * @environment's variables are left with their current values (though their serials may have changed) and %FALSE is returned.
+ *
+ * Return value: %TRUE if @transition's preconditions are now satisfied, %FALSE otherwise
+ */
+gboolean
+dfsm_internal_solve_preconditions (DfsmAstTransition *transition, DfsmEnvironment *environment)
+{
+	GPtrArray/*<DfsmAstPrecondition>*/ *preconditions;
+	guint attempt, i;
+	gboolean solved = FALSE, fuzzing_was_enabled;
+
+	preconditions = dfsm_ast_transition_get_preconditions (transition);
+
+	if (preconditions->len == 0) {
+		return FALSE;
+	}
+
+	/* Evaluate any constants in the preconditions as they're written. Fuzzing's re-enabled afterwards if it was enabled before. */
+	fuzzing_was_enabled = dfsm_internal_environment_get_fuzzing_enabled (environment);
+	dfsm_internal_environment_set_fuzzing_enabled (environment, FALSE);
+
+	for (attempt = 0; attempt < MAX_ATTEMPTS && solved == FALSE; attempt++) {
+		GHashTable/*<string, VariableConstraint>*/ *constraints;
+		GHashTable/*<string, GVariant>*/ *old_values;
+
+		constraints = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) variable_constraint_free);
+
+		for (i = 0; i < preconditions->len; i++) {
+			DfsmAstPrecondition *precondition = g_ptr_array_index (preconditions, i);
+
+			collect_constraints (dfsm_ast_precondition_get_condition (precondition), FALSE, constraints, environment);
+		}
+
+		/* If the preconditions don't constrain any object variables, changing them won't help. */
+		if (g_hash_table_size (constraints) == 0) {
+			g_hash_table_unref (constraints);
+			break;
+		}
+
+		old_values = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_variant_unref);
+
+		if (assign_values (constraints, environment, old_values) == TRUE) {
+			solved = dfsm_ast_transition_check_preconditions (transition, environment, NULL, NULL);
+
+			/* Restore the old values if the preconditions still don't hold, since the constraints missed something. */
+			if (solved == FALSE) {
+				GHashTableIter iter;
+				const gchar *variable_name;
+				GVariant *old_value;
+
+				g_hash_table_iter_init (&iter, old_values);
+
+				while (g_hash_table_iter_next (&iter, (gpointer*) &variable_name, (gpointer*) &old_value) == TRUE) {
+					dfsm_environment_set_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name, old_value);
+				}
+			}
+		}
+
+		g_hash_table_unref (old_values);
+		g_hash_table_unref (constraints);
+	}
+
+	dfsm_internal_environment_set_fuzzing_enabled (environment, fuzzing_was_enabled);
+
+	return solved;
+}
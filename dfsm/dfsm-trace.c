@@ -0,0 +1,79 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "dfsm-trace.h"
+#include "dfsm-internal.h"
+
+static DfsmTraceFunc trace_func = NULL;
+static gpointer trace_func_user_data = NULL;
+
+/**
+ * dfsm_trace_set_func:
+ * @func: (allow-none): function to call for each trace event, or %NULL to disable tracing
+ * @user_data: user data to pass to @func
+ *
+ * Set the function which is called for every trace event emitted by the library, replacing any function set previously. If @func is %NULL,
+ * tracing is disabled.
+ *
+ * This is not thread safe, and should be called before any simulations are started.
+ */
+void
+dfsm_trace_set_func (DfsmTraceFunc func, gpointer user_data)
+{
+	trace_func = func;
+	trace_func_user_data = (func != NULL) ? user_data : NULL;
+}
+
+/**
+ * dfsm_trace_is_enabled:
+ *
+ * Check whether a trace function has been set using dfsm_trace_set_func(). This can be used to avoid building expensive event details if tracing
+ * is disabled.
+ *
+ * Return value: %TRUE if tracing is enabled, %FALSE otherwise
+ */
+gboolean
+dfsm_trace_is_enabled (void)
+{
+	return (trace_func != NULL) ? TRUE : FALSE;
+}
+
+/*
+ * dfsm_internal_trace:
+ * @phase: phase of the event
+ * @category: category of the event
+ * @name: name of the event
+ * @detail: (allow-none): further detail about the event, or %NULL
+ *
+ * Emit a trace event to the function set by dfsm_trace_set_func(), if any. This is a no-op if tracing is disabled.
+ */
+void
+dfsm_internal_trace (DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail)
+{
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	if (trace_func == NULL) {
+		return;
+	}
+
+	trace_func (phase, category, name, detail, trace_func_user_data);
+}
@@ -0,0 +1,72 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ * 
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:dfsm-trace
+ * @short_description: simulation tracing
+ * @stability: Unstable
+ * @include: dfsm/dfsm-trace.h
+ *
+ * Hooks for tracing the execution of simulations, for example to export a timeline of the simulation to a trace viewer. Tracing is disabled by
+ * default, and costs a single pointer comparison per trace point when disabled.
+ *
+ * Spans are reported as a %DFSM_TRACE_PHASE_BEGIN event followed later by a matching %DFSM_TRACE_PHASE_END event from the same thread; spans nest
+ * strictly within each thread. Most events are reported from the thread running the simulation's main context, but method calls to objects with
+ * #DfsmObject:dispatch-in-worker-thread set are reported from the GDBus worker thread, so trace functions must be thread-safe.
+ */
+
+#include <glib.h>
+
+#ifndef DFSM_TRACE_H
+#define DFSM_TRACE_H
+
+G_BEGIN_DECLS
+
+/**
+ * DfsmTracePhase:
+ * @DFSM_TRACE_PHASE_BEGIN: start of a span
+ * @DFSM_TRACE_PHASE_END: end of the most recently begun span
+ * @DFSM_TRACE_PHASE_INSTANT: an instantaneous event
+ *
+ * The phase of a trace event.
+ */
+typedef enum {
+	DFSM_TRACE_PHASE_BEGIN = 0,
+	DFSM_TRACE_PHASE_END,
+	DFSM_TRACE_PHASE_INSTANT,
+} DfsmTracePhase;
+
+/**
+ * DfsmTraceFunc:
+ * @phase: phase of the event
+ * @category: category of the event, such as <literal>method-call</literal> or <literal>transition</literal>
+ * @name: name of the event, such as the name of the method being called
+ * @detail: (allow-none): further detail about the event, such as the path of the object being called, or %NULL
+ * @user_data: user data passed to dfsm_trace_set_func()
+ *
+ * Function called for each trace event. The timestamp of the event is the time the function is called; see g_get_monotonic_time().
+ */
+typedef void (*DfsmTraceFunc) (DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail, gpointer user_data);
+
+void dfsm_trace_set_func (DfsmTraceFunc func, gpointer user_data);
+gboolean dfsm_trace_is_enabled (void) G_GNUC_PURE;
+
+G_END_DECLS
+
+#endif /* !DFSM_TRACE_H */
@@ -25,10 +25,13 @@
 #include <dfsm/dfsm-parser.h>
 #include <dfsm/dfsm-ast.h>
 #include <dfsm/dfsm-environment.h>
+#include <dfsm/dfsm-exploration.h>
 #include <dfsm/dfsm-machine.h>
 #include <dfsm/dfsm-object.h>
 #include <dfsm/dfsm-dbus-output-sequence.h>
 #include <dfsm/dfsm-output-sequence.h>
+#include <dfsm/dfsm-scheduler.h>
+#include <dfsm/dfsm-trace.h>
 #include <dfsm/dfsm-utils.h>
 
 #endif /* !DFSM_H */
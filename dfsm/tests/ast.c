@@ -17,6 +17,7 @@
  * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <glib/gstdio.h>
 #include <dfsm/dfsm.h>
 
 #include "test-output-sequence.h"
@@ -157,6 +158,10 @@ test_ast_parser (void)
 
 	/* Multiple assignment. */
 	ASSERT_TRANSITION_PARSES ("transition inside Main on random { (object->UnicodeString, object->NonEmptyString) = (\"…\", \"Test string\"); }");
+
+	/* Object instantiation and destruction. */
+	ASSERT_TRANSITION_PARSES ("transition inside Main on random { instantiate @o \"/instance\"; destroy @o \"/instance\"; }");
+	ASSERT_TRANSITION_PARSES ("transition inside Main on method TwoStateEcho { instantiate @o \"/instance\"; reply (\"\"); }");
 }
 
 #define ASSERT_TRANSITION_FAILS(ErrorCode, Snippet) G_STMT_START { \
@@ -211,6 +216,11 @@ test_ast_parser_errors (void)
 	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { emit SingleStateSignal (@u 5); }");
 	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { emit SingleStateSignal \"not in a struct\"; }");
 
+	/* Instantiate and destroy statements: no object path, incorrect type. */
+	ASSERT_TRANSITION_FAILS (SYNTAX, "transition inside Main on random { instantiate; }");
+	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { instantiate \"/not/an/object/path\"; }");
+	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { destroy (@o \"/in/a/struct\"); }");
+
 	/* Assignments: type mismatches, assignments to non-variables and structures of non-variables. */
 	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { object->ArbitraryProperty = false; }");
 	ASSERT_TRANSITION_FAILS (AST_INVALID, "transition inside Main on random { false = true; }");
@@ -245,6 +255,139 @@ test_ast_parser_errors (void)
 	"}");
 }
 
+/* Build a machine description containing @n_objects objects, all with a valid transition except for those whose indices are listed in
+ * @bad_object_indices (terminated by -1), which instead contain an invalid transition referencing a variable named after their index. */
+static GPtrArray/*<DfsmObject>*/ *
+build_multiple_object_machine_description (guint n_objects, const gint *bad_object_indices, GError **error)
+{
+	GString *machine_description;
+	gchar *introspection_xml;
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	guint i;
+
+	machine_description = g_string_new ("");
+
+	for (i = 0; i < n_objects; i++) {
+		gboolean is_bad = FALSE;
+		const gint *j;
+
+		for (j = bad_object_indices; *j >= 0; j++) {
+			is_bad = is_bad || ((guint) *j == i);
+		}
+
+		g_string_append_printf (machine_description,
+			"object at /uk/ac/cam/cl/DBusSimulator/ParserTest%u implements uk.ac.cam.cl.DBusSimulator.SimpleTest {"
+				"data {"
+					"ArbitraryProperty = \"foo\";"
+				"}"
+				"states {"
+					"Main;"
+				"}", i);
+
+		if (is_bad == TRUE) {
+			g_string_append_printf (machine_description,
+				"transition inside Main on random { object->ArbitraryProperty = fake_variable%u; }", i);
+		} else {
+			g_string_append (machine_description, "transition inside Main on random { emit CounterSignal (1); }");
+		}
+
+		g_string_append (machine_description, "}");
+	}
+
+	introspection_xml = load_test_file ("simple-test.xml");
+
+	object_array = dfsm_object_factory_from_data (machine_description->str, introspection_xml, error);
+
+	g_free (introspection_xml);
+	g_string_free (machine_description, TRUE);
+
+	return object_array;
+}
+
+static void
+test_ast_multiple_objects (void)
+{
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	GError *error = NULL, *expected_error = NULL;
+	const gint no_bad_objects[] = { -1 };
+	const gint first_bad_object[] = { 3, -1 };
+	const gint several_bad_objects[] = { 3, 7, 12, -1 };
+	guint i, attempt;
+
+	/* All objects are valid, and are returned in the order they were defined in, however they were checked. */
+	object_array = build_multiple_object_machine_description (16, no_bad_objects, &error);
+
+	g_assert_no_error (error);
+	g_assert (object_array != NULL);
+	g_assert_cmpuint (object_array->len, ==, 16);
+
+	for (i = 0; i < object_array->len; i++) {
+		gchar *object_path = g_strdup_printf ("/uk/ac/cam/cl/DBusSimulator/ParserTest%u", i);
+		g_assert_cmpstr (dfsm_object_get_object_path (g_ptr_array_index (object_array, i)), ==, object_path);
+		g_free (object_path);
+	}
+
+	g_ptr_array_unref (object_array);
+
+	/* With several invalid objects, the error from the first one is always reported. */
+	object_array = build_multiple_object_machine_description (16, first_bad_object, &expected_error);
+
+	g_assert_error (expected_error, DFSM_PARSE_ERROR, DFSM_PARSE_ERROR_AST_INVALID);
+	g_assert (object_array == NULL);
+
+	for (attempt = 0; attempt < 10; attempt++) {
+		object_array = build_multiple_object_machine_description (16, several_bad_objects, &error);
+
+		g_assert_error (error, DFSM_PARSE_ERROR, DFSM_PARSE_ERROR_AST_INVALID);
+		g_assert_cmpstr (error->message, ==, expected_error->message);
+		g_assert (object_array == NULL);
+
+		g_clear_error (&error);
+	}
+
+	g_error_free (expected_error);
+}
+
+static gpointer
+parse_in_thread_cb (gpointer user_data)
+{
+	guint i;
+
+	/* Parse code containing long strings and comments, which exercise the scanner's state. */
+	for (i = 0; i < 20; i++) {
+		GPtrArray/*<DfsmObject>*/ *object_array;
+		GError *error = NULL;
+
+		object_array = build_machine_description_from_transition_snippet (
+			"/* A comment which is long enough to span several of the scanner's reads. */"
+			"transition inside Main on random {"
+				"object->ArbitraryProperty = \"A string which is long enough to be interleaved with other threads' strings.\";"
+			"}", &error);
+
+		g_assert_no_error (error);
+		g_assert (object_array != NULL);
+
+		g_ptr_array_unref (object_array);
+	}
+
+	return NULL;
+}
+
+static void
+test_ast_parser_threads (void)
+{
+	GThread *threads[4];
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (threads); i++) {
+		threads[i] = g_thread_new ("parser", parse_in_thread_cb, NULL);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (threads); i++) {
+		g_thread_join (threads[i]);
+	}
+}
+
 static void
 test_ast_execution_output_sequence (void)
 {
@@ -464,6 +607,138 @@ test_ast_execution_integer_saturation (void)
 #undef ASSERT_ARITHMETIC_EXPRESSION
 }
 
+static guint
+count_cached_machines (const gchar *cache_directory)
+{
+	GDir *dir;
+	guint count = 0;
+
+	dir = g_dir_open (cache_directory, 0, NULL);
+
+	if (dir != NULL) {
+		while (g_dir_read_name (dir) != NULL) {
+			count++;
+		}
+
+		g_dir_close (dir);
+	}
+
+	return count;
+}
+
+static void
+assert_ast_objects_equal (GPtrArray/*<DfsmAstObject>*/ *a, GPtrArray/*<DfsmAstObject>*/ *b)
+{
+	guint i, j;
+
+	g_assert_cmpuint (a->len, ==, b->len);
+
+	for (i = 0; i < a->len; i++) {
+		DfsmAstObject *object_a = g_ptr_array_index (a, i), *object_b = g_ptr_array_index (b, i);
+		GPtrArray *names_a, *names_b;
+
+		g_assert_cmpstr (dfsm_ast_object_get_object_path (object_a), ==, dfsm_ast_object_get_object_path (object_b));
+		g_assert_cmpuint (dfsm_ast_object_get_transitions (object_a)->len, ==, dfsm_ast_object_get_transitions (object_b)->len);
+
+		names_a = dfsm_ast_object_get_state_names (object_a);
+		names_b = dfsm_ast_object_get_state_names (object_b);
+		g_assert_cmpuint (names_a->len, ==, names_b->len);
+
+		for (j = 0; j < names_a->len; j++) {
+			g_assert_cmpstr (g_ptr_array_index (names_a, j), ==, g_ptr_array_index (names_b, j));
+		}
+
+		names_a = dfsm_ast_object_get_interface_names (object_a);
+		names_b = dfsm_ast_object_get_interface_names (object_b);
+		g_assert_cmpuint (names_a->len, ==, names_b->len);
+
+		for (j = 0; j < names_a->len; j++) {
+			g_assert_cmpstr (g_ptr_array_index (names_a, j), ==, g_ptr_array_index (names_b, j));
+		}
+	}
+}
+
+static void
+test_ast_compiled_machine_cache (void)
+{
+	gchar *machine_description, *introspection_xml, *cache_directory, *cache_path, *compiled_machine;
+	const gchar *cache_filename;
+	gsize compiled_machine_length, length;
+	GPtrArray/*<DfsmAstObject>*/ *parsed_objects, *cached_objects;
+	GDir *dir;
+	GError *error = NULL;
+
+	machine_description = load_test_file ("simple-test.machine");
+	introspection_xml = load_test_file ("simple-test.xml");
+
+	cache_directory = g_dir_make_tmp ("dfsm-ast-test-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	dfsm_object_factory_set_cache_directory (cache_directory);
+
+	/* The first load should parse the code and write it to the cache. */
+	parsed_objects = dfsm_object_factory_asts_from_data (machine_description, introspection_xml, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (count_cached_machines (cache_directory), ==, 1);
+
+	/* The second should load it from the cache and give the same objects. */
+	cached_objects = dfsm_object_factory_asts_from_data (machine_description, introspection_xml, &error);
+	g_assert_no_error (error);
+	assert_ast_objects_equal (parsed_objects, cached_objects);
+	g_ptr_array_unref (cached_objects);
+
+	/* Corrupt cache files should be ignored. */
+	dir = g_dir_open (cache_directory, 0, &error);
+	g_assert_no_error (error);
+	cache_filename = g_dir_read_name (dir);
+	cache_path = g_build_filename (cache_directory, cache_filename, NULL);
+	g_dir_close (dir);
+
+	g_file_set_contents (cache_path, "not a compiled machine", -1, &error);
+	g_assert_no_error (error);
+
+	cached_objects = dfsm_object_factory_asts_from_data (machine_description, introspection_xml, &error);
+	g_assert_no_error (error);
+	assert_ast_objects_equal (parsed_objects, cached_objects);
+	g_ptr_array_unref (cached_objects);
+
+	/* As should truncated ones. Loading the code above will have rewritten the file. */
+	g_file_get_contents (cache_path, &compiled_machine, &compiled_machine_length, &error);
+	g_assert_no_error (error);
+
+	for (length = 0; length < compiled_machine_length; length += MAX (compiled_machine_length / 100, 1)) {
+		g_file_set_contents (cache_path, compiled_machine, length, &error);
+		g_assert_no_error (error);
+
+		cached_objects = dfsm_object_factory_asts_from_data (machine_description, introspection_xml, &error);
+		g_assert_no_error (error);
+		assert_ast_objects_equal (parsed_objects, cached_objects);
+		g_ptr_array_unref (cached_objects);
+	}
+
+	g_free (compiled_machine);
+
+	/* Code which fails checking shouldn't be cached. */
+	cached_objects = dfsm_object_factory_asts_from_data ("object at /foo implements uk.ac.cam.cl.DBusSimulator.SimpleTest {"
+	                                                     "states { Main; } transition inside Main on random { object->Undeclared = 1; } }",
+	                                                     introspection_xml, &error);
+	g_assert (error != NULL);
+	g_assert (cached_objects == NULL);
+	g_clear_error (&error);
+	g_assert_cmpuint (count_cached_machines (cache_directory), ==, 1);
+
+	dfsm_object_factory_set_cache_directory (NULL);
+
+	g_unlink (cache_path);
+	g_rmdir (cache_directory);
+
+	g_ptr_array_unref (parsed_objects);
+	g_free (cache_path);
+	g_free (cache_directory);
+	g_free (introspection_xml);
+	g_free (machine_description);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -478,8 +753,11 @@ main (int argc, char *argv[])
 	g_test_add_func ("/ast/single-object", test_ast_single_object);
 	g_test_add_func ("/ast/parser", test_ast_parser);
 	g_test_add_func ("/ast/parser/errors", test_ast_parser_errors);
+	g_test_add_func ("/ast/parser/threads", test_ast_parser_threads);
+	g_test_add_func ("/ast/multiple-objects", test_ast_multiple_objects);
 	g_test_add_func ("/ast/execution/output-sequence", test_ast_execution_output_sequence);
 	g_test_add_func ("/ast/execution/integer-saturation", test_ast_execution_integer_saturation);
+	g_test_add_func ("/ast/compiled-machine-cache", test_ast_compiled_machine_cache);
 
 	return g_test_run ();
 }
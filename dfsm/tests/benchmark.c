@@ -0,0 +1,549 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * D-Bus Simulator
+ * Copyright (C) Philip Withnall 2012 <philip@tecnocode.co.uk>
+ *
+ * D-Bus Simulator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * D-Bus Simulator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Benchmarks of simulated objects' dispatch paths. Run with "-m perf" to get meaningful numbers; otherwise each benchmark only does a handful of
+ * iterations, to check that it works. */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <dfsm/dfsm.h>
+
+#include "test-utils.h"
+
+/* Number of method calls to make in each benchmark over D-Bus, and how many of them to have in flight at once. */
+#define PERF_ITERATIONS 20000
+#define QUICK_ITERATIONS 100
+#define CALL_WINDOW 32
+
+/* Number of method calls to make in each benchmark which calls the machine directly. */
+#define MACHINE_PERF_ITERATIONS 500000
+#define MACHINE_QUICK_ITERATIONS 1000
+
+/* Number of times to load each machine in the compiled machine cache benchmarks. */
+#define FACTORY_PERF_ITERATIONS 200
+#define FACTORY_QUICK_ITERATIONS 2
+
+/* An output sequence which discards everything added to it, so that only the machine's side of a dispatch is measured. */
+#define NULL_TYPE_OUTPUT_SEQUENCE (null_output_sequence_get_type ())
+
+typedef struct {
+	GObject parent;
+} NullOutputSequence;
+
+typedef struct {
+	GObjectClass parent;
+} NullOutputSequenceClass;
+
+static GType null_output_sequence_get_type (void) G_GNUC_CONST;
+static void null_output_sequence_iface_init (DfsmOutputSequenceInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (NullOutputSequence, null_output_sequence, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (DFSM_TYPE_OUTPUT_SEQUENCE, null_output_sequence_iface_init))
+
+static void
+null_output_sequence_class_init (NullOutputSequenceClass *klass)
+{
+	/* Nothing to see here. */
+}
+
+static void
+null_output_sequence_init (NullOutputSequence *self)
+{
+	/* Nothing to see here. */
+}
+
+static void
+null_output_sequence_output (DfsmOutputSequence *sequence, GError **error)
+{
+	/* Nothing to output. */
+}
+
+static void
+null_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *parameters)
+{
+	/* Discard the reply. */
+}
+
+static void
+null_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error)
+{
+	/* Discard the error. */
+}
+
+static void
+null_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name, GVariant *parameters)
+{
+	/* Discard the signal. */
+}
+
+static void
+null_output_sequence_iface_init (DfsmOutputSequenceInterface *iface)
+{
+	iface->output = null_output_sequence_output;
+	iface->add_reply = null_output_sequence_add_reply;
+	iface->add_throw = null_output_sequence_add_throw;
+	iface->add_emit = null_output_sequence_add_emit;
+}
+
+typedef struct {
+	const gchar *snippet; /* transitions for the simulated object */
+	gboolean dispatch_in_worker_thread;
+	gboolean enable_fuzzing; /* only used when calling the machine directly */
+} BenchmarkCase;
+
+typedef struct {
+	GDBusServer *server;
+	gchar *tmp_directory;
+	GDBusConnection *server_connection;
+	GDBusConnection *client_connection;
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmObject *simulated_object;
+	gboolean registered;
+
+	/* Method call progress */
+	guint calls_remaining; /* calls not yet made */
+	guint replies_pending; /* calls made but not yet replied to */
+} BenchmarkData;
+
+static gboolean
+new_connection_cb (GDBusServer *server, GDBusConnection *connection, BenchmarkData *data)
+{
+	data->server_connection = g_object_ref (connection);
+
+	return TRUE;
+}
+
+static void
+client_connection_ready_cb (GObject *source_object, GAsyncResult *async_result, BenchmarkData *data)
+{
+	GError *error = NULL;
+
+	data->client_connection = g_dbus_connection_new_for_address_finish (async_result, &error);
+	g_assert_no_error (error);
+}
+
+static void
+register_on_bus_cb (DfsmObject *simulated_object, GAsyncResult *async_result, BenchmarkData *data)
+{
+	GError *error = NULL;
+
+	dfsm_object_register_on_bus_finish (simulated_object, async_result, &error);
+	g_assert_no_error (error);
+
+	data->registered = TRUE;
+}
+
+static gboolean
+disable_arbitrary_transition_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing, gpointer user_data)
+{
+	/* Handled (by doing nothing). */
+	return TRUE;
+}
+
+/* Build a simulated object from the case's snippet. */
+static void
+setup_machine_benchmark (BenchmarkData *data, gconstpointer user_data)
+{
+	const BenchmarkCase *benchmark_case = user_data;
+	gchar *machine_description, *introspection_xml;
+	GError *error = NULL;
+
+	machine_description = g_strdup_printf (
+		"object at /uk/ac/cam/cl/DBusSimulator/Benchmark implements uk.ac.cam.cl.DBusSimulator.SimpleTest {"
+			"data {"
+				"ArbitraryProperty = \"foo\";"
+			"}"
+			"states {"
+				"Main;"
+			"}"
+			"%s"
+		"}", benchmark_case->snippet);
+	introspection_xml = load_test_file ("simple-test.xml");
+
+	data->simulated_objects = dfsm_object_factory_from_data (machine_description, introspection_xml, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (data->simulated_objects->len, ==, 1);
+	data->simulated_object = g_ptr_array_index (data->simulated_objects, 0);
+
+	g_free (introspection_xml);
+	g_free (machine_description);
+}
+
+static void
+teardown_machine_benchmark (BenchmarkData *data, gconstpointer user_data)
+{
+	g_ptr_array_unref (data->simulated_objects);
+}
+
+/* Export a simulated object built from the case's snippet over a new peer-to-peer connection. */
+static void
+setup_benchmark (BenchmarkData *data, gconstpointer user_data)
+{
+	const BenchmarkCase *benchmark_case = user_data;
+	gchar *address, *guid;
+	GError *error = NULL;
+
+	setup_machine_benchmark (data, user_data);
+
+	/* Set up the connection. */
+	data->tmp_directory = g_dir_make_tmp ("dfsm-benchmark-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	address = g_strdup_printf ("unix:tmpdir=%s", data->tmp_directory);
+	guid = g_dbus_generate_guid ();
+
+	data->server = g_dbus_server_new_sync (address, G_DBUS_SERVER_FLAGS_NONE, guid, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	g_free (guid);
+	g_free (address);
+
+	g_signal_connect (data->server, "new-connection", (GCallback) new_connection_cb, data);
+	g_dbus_server_start (data->server);
+
+	g_dbus_connection_new_for_address (g_dbus_server_get_client_address (data->server), G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL, NULL,
+	                                   (GAsyncReadyCallback) client_connection_ready_cb, data);
+
+	while (data->server_connection == NULL || data->client_connection == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	/* Export the object, with arbitrary transitions disabled so that only the method calls are measured. */
+	dfsm_object_set_dispatch_in_worker_thread (data->simulated_object, benchmark_case->dispatch_in_worker_thread);
+	g_signal_connect (data->simulated_object, "arbitrary-transition", (GCallback) disable_arbitrary_transition_cb, NULL);
+	dfsm_object_register_on_bus (data->simulated_object, data->server_connection, (GAsyncReadyCallback) register_on_bus_cb, data);
+
+	while (data->registered == FALSE) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+teardown_benchmark (BenchmarkData *data, gconstpointer user_data)
+{
+	dfsm_object_unregister_on_bus (data->simulated_object);
+
+	g_dbus_connection_close_sync (data->client_connection, NULL, NULL);
+	g_dbus_connection_close_sync (data->server_connection, NULL, NULL);
+	g_object_unref (data->client_connection);
+	g_object_unref (data->server_connection);
+
+	g_dbus_server_stop (data->server);
+	g_object_unref (data->server);
+
+	g_rmdir (data->tmp_directory);
+	g_free (data->tmp_directory);
+
+	teardown_machine_benchmark (data, user_data);
+}
+
+static void make_call (BenchmarkData *data);
+
+static void
+call_reply_cb (GDBusConnection *connection, GAsyncResult *async_result, BenchmarkData *data)
+{
+	GVariant *reply;
+	GError *error = NULL;
+
+	reply = g_dbus_connection_call_finish (connection, async_result, &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	data->replies_pending--;
+
+	if (data->calls_remaining > 0) {
+		make_call (data);
+	}
+}
+
+static void
+make_call (BenchmarkData *data)
+{
+	data->calls_remaining--;
+	data->replies_pending++;
+
+	g_dbus_connection_call (data->client_connection, NULL, dfsm_object_get_object_path (data->simulated_object),
+	                        "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", g_variant_new ("(s)", "Greeting"), G_VARIANT_TYPE ("(s)"),
+	                        G_DBUS_CALL_FLAGS_NONE, -1, NULL, (GAsyncReadyCallback) call_reply_cb, data);
+}
+
+/* Make a lot of calls to SingleStateEcho, keeping several in flight at once, and report the mean wall clock time taken for each. */
+static void
+benchmark_method_calls (BenchmarkData *data, gconstpointer user_data)
+{
+	guint iterations, i;
+	gdouble elapsed;
+
+	iterations = g_test_perf () ? PERF_ITERATIONS : QUICK_ITERATIONS;
+	data->calls_remaining = iterations;
+
+	g_test_timer_start ();
+
+	for (i = 0; i < CALL_WINDOW && data->calls_remaining > 0; i++) {
+		make_call (data);
+	}
+
+	while (data->calls_remaining > 0 || data->replies_pending > 0) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+
+	g_test_minimized_result (elapsed * G_USEC_PER_SEC / iterations, "%.2f µs per method call", elapsed * G_USEC_PER_SEC / iterations);
+}
+
+/* Call SingleStateEcho on the object's machine directly a lot of times, and report the mean time taken for each call, plus how the arena for the
+ * calls' temporaries was used. */
+static void
+benchmark_machine_method_calls (BenchmarkData *data, gconstpointer user_data)
+{
+	const BenchmarkCase *benchmark_case = user_data;
+	DfsmMachine *machine;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	DfsmArenaStatistics statistics_before, statistics_after;
+	GVariant *parameters;
+	guint iterations, i;
+	gdouble elapsed;
+
+	machine = dfsm_object_get_machine (data->simulated_object);
+	environment = dfsm_machine_get_environment (machine);
+	output_sequence = g_object_new (NULL_TYPE_OUTPUT_SEQUENCE, NULL);
+	parameters = g_variant_ref_sink (g_variant_new ("(s)", "Greeting"));
+
+	iterations = g_test_perf () ? MACHINE_PERF_ITERATIONS : MACHINE_QUICK_ITERATIONS;
+
+	dfsm_environment_get_arena_statistics (environment, &statistics_before);
+	g_test_timer_start ();
+
+	for (i = 0; i < iterations; i++) {
+		dfsm_machine_call_method (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", parameters,
+		                          benchmark_case->enable_fuzzing);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	dfsm_environment_get_arena_statistics (environment, &statistics_after);
+
+	g_test_minimized_result (elapsed * G_USEC_PER_SEC / iterations, "%.3f µs per method call", elapsed * G_USEC_PER_SEC / iterations);
+
+	/* Every call resets the arena. */
+	g_assert_cmpuint (statistics_after.num_resets - statistics_before.num_resets, ==, iterations);
+
+	g_test_message ("Arena: %.2f allocations (%.1f bytes) per method call; %" G_GUINT64_FORMAT " chunk allocations in total; peak %" G_GSIZE_FORMAT
+	                " bytes in use", (gdouble) (statistics_after.num_allocations - statistics_before.num_allocations) / iterations,
+	                (gdouble) (statistics_after.bytes_allocated - statistics_before.bytes_allocated) / iterations,
+	                statistics_after.num_chunk_allocations - statistics_before.num_chunk_allocations, statistics_after.peak_bytes_in_use);
+
+	g_variant_unref (parameters);
+	g_object_unref (output_sequence);
+}
+
+/* A machine to load in the compiled machine cache benchmarks, relative to the test directory. */
+typedef struct {
+	const gchar *machine_filename;
+	const gchar *introspection_filename;
+} FactoryBenchmarkCase;
+
+static gdouble
+time_factory_loads (const gchar *simulation_code, const gchar *introspection_xml, guint iterations)
+{
+	guint i;
+
+	g_test_timer_start ();
+
+	for (i = 0; i < iterations; i++) {
+		GPtrArray/*<DfsmAstObject>*/ *ast_object_array;
+		GError *error = NULL;
+
+		ast_object_array = dfsm_object_factory_asts_from_data (simulation_code, introspection_xml, &error);
+		g_assert_no_error (error);
+		g_ptr_array_unref (ast_object_array);
+	}
+
+	return g_test_timer_elapsed () * G_USEC_PER_SEC / iterations;
+}
+
+/* Load the case's machine a lot of times with the compiled machine cache disabled, and then with it enabled and primed, and report the mean time
+ * taken for each load in both cases. */
+static void
+benchmark_compiled_machine_cache (gconstpointer user_data)
+{
+	const FactoryBenchmarkCase *benchmark_case = user_data;
+	gchar *simulation_code, *introspection_xml, *cache_directory;
+	GDir *dir;
+	const gchar *filename;
+	guint iterations;
+	gdouble uncached, cached;
+	GError *error = NULL;
+
+	simulation_code = load_test_file (benchmark_case->machine_filename);
+	introspection_xml = load_test_file (benchmark_case->introspection_filename);
+	iterations = g_test_perf () ? FACTORY_PERF_ITERATIONS : FACTORY_QUICK_ITERATIONS;
+
+	cache_directory = g_dir_make_tmp ("dfsm-benchmark-cache-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	/* Without the cache. */
+	dfsm_object_factory_set_cache_directory (NULL);
+	uncached = time_factory_loads (simulation_code, introspection_xml, iterations);
+
+	/* With the cache. The first load writes the compiled machine, so isn't timed. */
+	dfsm_object_factory_set_cache_directory (cache_directory);
+	time_factory_loads (simulation_code, introspection_xml, 1);
+	cached = time_factory_loads (simulation_code, introspection_xml, iterations);
+	dfsm_object_factory_set_cache_directory (NULL);
+
+	g_test_message ("Without cache: %.1f µs per load", uncached);
+	g_test_minimized_result (cached, "With cache: %.1f µs per load (%.2f× faster)", cached, uncached / cached);
+
+	/* Clean up the cache. */
+	dir = g_dir_open (cache_directory, 0, &error);
+	g_assert_no_error (error);
+
+	while ((filename = g_dir_read_name (dir)) != NULL) {
+		gchar *path = g_build_filename (cache_directory, filename, NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+
+	g_dir_close (dir);
+	g_rmdir (cache_directory);
+
+	g_free (cache_directory);
+	g_free (introspection_xml);
+	g_free (simulation_code);
+}
+
+static const FactoryBenchmarkCase simple_test_machine = {
+	"simple-test.machine",
+	"simple-test.xml",
+};
+
+static const FactoryBenchmarkCase eds_address_book_machine = {
+	"../../machines/eds-address-book_full.machine",
+	"../../machines/eds-address-book.xml",
+};
+
+static const FactoryBenchmarkCase telepathy_cm_machine = {
+	"../../machines/telepathy-cm_full.machine",
+	"../../machines/telepathy-cm.xml",
+};
+
+static const BenchmarkCase constant_reply = {
+	"transition inside Main on method SingleStateEcho {"
+		"reply (\"Constant greeting\");"
+	"}",
+	FALSE,
+};
+
+static const BenchmarkCase constant_reply_worker_thread = {
+	"transition inside Main on method SingleStateEcho {"
+		"reply (\"Constant greeting\");"
+	"}",
+	TRUE,
+};
+
+static const BenchmarkCase evaluated_reply = {
+	"transition inside Main on method SingleStateEcho {"
+		"reply (greeting);"
+	"}",
+	FALSE,
+};
+
+static const BenchmarkCase evaluated_reply_worker_thread = {
+	"transition inside Main on method SingleStateEcho {"
+		"reply (greeting);"
+	"}",
+	TRUE,
+};
+
+static const BenchmarkCase constant_signals = {
+	"transition inside Main on method SingleStateEcho {"
+		"emit SingleStateSignal (\"Constant message 1\");"
+		"emit SingleStateSignal (\"Constant message 2\");"
+		"emit SingleStateSignal (\"Constant message 3\");"
+		"emit SingleStateSignal (\"Constant message 4\");"
+		"reply (greeting);"
+	"}",
+	FALSE,
+};
+
+static const BenchmarkCase evaluated_signals = {
+	"transition inside Main on method SingleStateEcho {"
+		"emit SingleStateSignal (greeting);"
+		"emit SingleStateSignal (greeting);"
+		"emit SingleStateSignal (greeting);"
+		"emit SingleStateSignal (greeting);"
+		"reply (greeting);"
+	"}",
+	FALSE,
+};
+
+static const BenchmarkCase fuzzed_reply = {
+	"transition inside Main on method SingleStateEcho {"
+		"reply (\"Fuzzed greeting, which has a few words in it\"?);"
+	"}",
+	FALSE,
+	TRUE,
+};
+
+static void
+discard_log_message_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data)
+{
+	/* Discard the message. */
+}
+
+#define ADD_BENCHMARK(P, C, F) g_test_add (P, BenchmarkData, &C, setup_benchmark, F, teardown_benchmark)
+#define ADD_MACHINE_BENCHMARK(P, C) g_test_add (P, BenchmarkData, &C, setup_machine_benchmark, benchmark_machine_method_calls, \
+                                                teardown_machine_benchmark)
+
+int
+main (int argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+	g_type_init ();
+#endif
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+	g_thread_init (NULL);
+#endif
+	g_test_init (&argc, &argv, NULL);
+
+	/* Drop libdfsm's debug messages, as bendy-bus does unless they're enabled, so that printing them isn't what's measured. */
+	g_log_set_handler ("libdfsm", G_LOG_LEVEL_DEBUG, discard_log_message_cb, NULL);
+
+	ADD_MACHINE_BENCHMARK ("/benchmark/machine/constant-reply", constant_reply);
+	ADD_MACHINE_BENCHMARK ("/benchmark/machine/evaluated-reply", evaluated_reply);
+	ADD_MACHINE_BENCHMARK ("/benchmark/machine/constant-signals", constant_signals);
+	ADD_MACHINE_BENCHMARK ("/benchmark/machine/evaluated-signals", evaluated_signals);
+	ADD_MACHINE_BENCHMARK ("/benchmark/machine/fuzzed-reply", fuzzed_reply);
+
+	ADD_BENCHMARK ("/benchmark/method-call/constant-reply", constant_reply, benchmark_method_calls);
+	ADD_BENCHMARK ("/benchmark/method-call/constant-reply/worker-thread", constant_reply_worker_thread, benchmark_method_calls);
+	ADD_BENCHMARK ("/benchmark/method-call/evaluated-reply", evaluated_reply, benchmark_method_calls);
+	ADD_BENCHMARK ("/benchmark/method-call/evaluated-reply/worker-thread", evaluated_reply_worker_thread, benchmark_method_calls);
+	ADD_BENCHMARK ("/benchmark/signal/constant", constant_signals, benchmark_method_calls);
+	ADD_BENCHMARK ("/benchmark/signal/evaluated", evaluated_signals, benchmark_method_calls);
+
+	g_test_add_data_func ("/benchmark/factory/compiled-machine-cache/simple-test", &simple_test_machine, benchmark_compiled_machine_cache);
+	g_test_add_data_func ("/benchmark/factory/compiled-machine-cache/eds-address-book", &eds_address_book_machine,
+	                      benchmark_compiled_machine_cache);
+	g_test_add_data_func ("/benchmark/factory/compiled-machine-cache/telepathy-cm", &telepathy_cm_machine, benchmark_compiled_machine_cache);
+
+	return g_test_run ();
+}
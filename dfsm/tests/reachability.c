@@ -19,6 +19,7 @@
 
 #include <dfsm/dfsm.h>
 
+#include "test-output-sequence.h"
 #include "test-utils.h"
 
 static void
@@ -82,6 +83,237 @@ test_reachability (void)
 	g_free (machine_description);
 }
 
+static DfsmObject *
+build_single_object (const gchar *machine_filename, GPtrArray/*<DfsmObject>*/ **object_array)
+{
+	gchar *machine_description, *introspection_xml;
+	GError *error = NULL;
+
+	machine_description = load_test_file (machine_filename);
+	introspection_xml = load_test_file ("simple-test.xml");
+
+	*object_array = dfsm_object_factory_from_data (machine_description, introspection_xml, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint ((*object_array)->len, ==, 1);
+
+	g_free (introspection_xml);
+	g_free (machine_description);
+
+	return DFSM_OBJECT (g_ptr_array_index (*object_array, 0));
+}
+
+static void
+test_exploration_exhaustive (gconstpointer user_data)
+{
+	DfsmExplorationOrder order = GPOINTER_TO_UINT (user_data);
+	struct {
+		const gchar *state_name;
+		guint num_configurations;
+	} expected_coverage[] = {
+		{ "State0", 1 },
+		{ "State1", 1 },
+		{ "State2", 1 },
+		{ "State3", 1 },
+		{ "State4", 1 },
+		{ "State5", 1 },
+		{ "State6", 0 }, /* only reachable through false preconditions */
+		{ "State7", 0 },
+		{ "State8", 0 },
+	};
+
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	DfsmMachine *machine;
+	DfsmExploration *exploration;
+	GArray/*<guint>*/ *state_coverage, *transition_coverage;
+	GPtrArray/*<DfsmAstObjectTransition>*/ *transitions;
+	GPtrArray/*<GPtrArray<DfsmAstObjectTransition>>*/ *seeds;
+	guint i, num_covered_transitions = 0;
+	GError *error = NULL;
+
+	machine = dfsm_object_get_machine (build_single_object ("reachability-test.machine", &object_array));
+
+	exploration = dfsm_exploration_new (machine);
+	dfsm_exploration_run (exploration, order, 0, 0, NULL, &error);
+	g_assert_no_error (error);
+
+	/* The object's only variable never changes, so there's one configuration per reachable state. */
+	g_assert (dfsm_exploration_is_exhaustive (exploration) == TRUE);
+	g_assert_cmpuint (dfsm_exploration_get_num_configurations (exploration), ==, 6);
+
+	state_coverage = dfsm_exploration_get_state_coverage (exploration);
+	g_assert_cmpuint (state_coverage->len, ==, G_N_ELEMENTS (expected_coverage));
+
+	for (i = 0; i < G_N_ELEMENTS (expected_coverage); i++) {
+		DfsmMachineStateNumber state;
+
+		state = dfsm_machine_look_up_state (machine, expected_coverage[i].state_name);
+		g_assert_cmpuint (g_array_index (state_coverage, guint, state), ==, expected_coverage[i].num_configurations);
+	}
+
+	/* All the transitions except the three with false preconditions and the one out of State8 should have been executed, and each should have a
+	 * seed which starts in the starting state and ends with the transition. */
+	transitions = dfsm_exploration_get_transitions (exploration);
+	transition_coverage = dfsm_exploration_get_transition_coverage (exploration);
+	g_assert_cmpuint (transitions->len, ==, 13);
+	g_assert_cmpuint (transition_coverage->len, ==, transitions->len);
+
+	for (i = 0; i < transition_coverage->len; i++) {
+		if (g_array_index (transition_coverage, guint, i) > 0) {
+			num_covered_transitions++;
+		}
+	}
+
+	g_assert_cmpuint (num_covered_transitions, ==, 9);
+
+	seeds = dfsm_exploration_get_seeds (exploration);
+	g_assert_cmpuint (seeds->len, ==, num_covered_transitions);
+
+	for (i = 0; i < seeds->len; i++) {
+		GPtrArray/*<DfsmAstObjectTransition>*/ *seed = g_ptr_array_index (seeds, i);
+		DfsmAstObjectTransition *first, *last;
+
+		g_assert_cmpuint (seed->len, >, 0);
+
+		first = g_ptr_array_index (seed, 0);
+		last = g_ptr_array_index (seed, seed->len - 1);
+
+		g_assert_cmpuint (first->from_state, ==, DFSM_MACHINE_STARTING_STATE);
+		g_assert_cmpuint (last->to_state, !=, dfsm_machine_look_up_state (machine, "State6"));
+	}
+
+	/* The machine itself shouldn't have been touched. */
+	g_assert_cmpuint (dfsm_machine_get_transition_count (machine), ==, 0);
+
+	g_object_unref (exploration);
+	g_ptr_array_unref (object_array);
+}
+
+static void
+test_exploration_limits (void)
+{
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	DfsmMachine *machine;
+	DfsmExploration *exploration;
+	GArray/*<guint>*/ *state_coverage;
+	GError *error = NULL;
+
+	/* simple-test.machine has an unbounded counter, so exploration can never be exhaustive. */
+	machine = dfsm_object_get_machine (build_single_object ("simple-test.machine", &object_array));
+	exploration = dfsm_exploration_new (machine);
+
+	/* Breadth-first to depth 3. Configurations are (state, stored_greeting, counter) tuples, and method inputs take their default values:
+	 *  • depth 0: (Main, "Initial", 0)
+	 *  • depth 1: (Other, "", 0), (Main, "Initial", 1)
+	 *  • depth 2: (Main, "", 0), (Other, "", 1), (Main, "Initial", 2)
+	 *  • depth 3: (Main, "", 1), (Other, "", 2), (Main, "Initial", 3) */
+	dfsm_exploration_run (exploration, DFSM_EXPLORATION_BREADTH_FIRST, 3, 0, NULL, &error);
+	g_assert_no_error (error);
+
+	g_assert (dfsm_exploration_is_exhaustive (exploration) == FALSE);
+	g_assert_cmpuint (dfsm_exploration_get_num_configurations (exploration), ==, 9);
+	g_assert_cmpuint (dfsm_exploration_get_depth (exploration), ==, 3);
+
+	state_coverage = dfsm_exploration_get_state_coverage (exploration);
+	g_assert_cmpuint (g_array_index (state_coverage, guint, dfsm_machine_look_up_state (machine, "Main")), ==, 6);
+	g_assert_cmpuint (g_array_index (state_coverage, guint, dfsm_machine_look_up_state (machine, "Other")), ==, 3);
+
+	/* Limit the number of configurations instead. Re-running discards the previous results. */
+	dfsm_exploration_run (exploration, DFSM_EXPLORATION_BREADTH_FIRST, 0, 5, NULL, &error);
+	g_assert_no_error (error);
+
+	g_assert (dfsm_exploration_is_exhaustive (exploration) == FALSE);
+	g_assert_cmpuint (dfsm_exploration_get_num_configurations (exploration), ==, 5);
+	g_assert_cmpuint (dfsm_exploration_get_depth (exploration), ==, 2);
+
+	/* Depth-first, the counter should be followed all the way down. */
+	dfsm_exploration_run (exploration, DFSM_EXPLORATION_DEPTH_FIRST, 10, 0, NULL, &error);
+	g_assert_no_error (error);
+
+	g_assert (dfsm_exploration_is_exhaustive (exploration) == FALSE);
+	g_assert_cmpuint (dfsm_exploration_get_depth (exploration), ==, 10);
+
+	g_object_unref (exploration);
+	g_ptr_array_unref (object_array);
+}
+
+static void
+make_arbitrary_transitions (DfsmMachine *machine, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		DfsmOutputSequence *output_sequence;
+
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, TRUE);
+		g_object_unref (output_sequence);
+	}
+}
+
+static DfsmMachineStateNumber
+get_machine_state (DfsmMachine *machine)
+{
+	DfsmMachineStateNumber state;
+
+	g_object_get (machine, "machine-state", &state, NULL);
+
+	return state;
+}
+
+static void
+test_directed (void)
+{
+	GPtrArray/*<DfsmObject>*/ *object_array;
+	DfsmMachine *machine;
+	DfsmMachineStateNumber target_state, trap_state;
+
+	machine = dfsm_object_get_machine (build_single_object ("directed-test.machine", &object_array));
+	target_state = dfsm_machine_look_up_state (machine, "Target");
+	trap_state = dfsm_machine_look_up_state (machine, "Trap");
+
+	g_assert_cmpuint (dfsm_machine_get_target_state (machine), ==, DFSM_MACHINE_INVALID_STATE);
+
+	dfsm_machine_set_target_state (machine, target_state);
+	g_assert_cmpuint (dfsm_machine_get_target_state (machine), ==, target_state);
+	g_assert (dfsm_machine_get_target_reached (machine) == FALSE);
+
+	/* Start → Step1 → Step2 → Target. The shortest path goes straight from Step1 to Target, but its precondition fails so the detour has to be
+	 * taken. None of the transitions into Trap should be taken. */
+	make_arbitrary_transitions (machine, 3);
+
+	g_assert_cmpuint (dfsm_machine_get_transition_count (machine), ==, 3);
+	g_assert_cmpuint (get_machine_state (machine), ==, target_state);
+	g_assert (dfsm_machine_get_target_reached (machine) == TRUE);
+
+	/* Once the target's been reached, transitions are chosen randomly again. The only one out of Target leads to Trap. */
+	make_arbitrary_transitions (machine, 1);
+	g_assert_cmpuint (get_machine_state (machine), ==, trap_state);
+	g_assert (dfsm_machine_get_target_reached (machine) == TRUE);
+
+	/* Resetting the machine re-arms the target. The environment is reset too, so the detour has to be taken again. */
+	dfsm_machine_reset_state (machine);
+	g_assert (dfsm_machine_get_target_reached (machine) == FALSE);
+
+	make_arbitrary_transitions (machine, 3);
+	g_assert_cmpuint (get_machine_state (machine), ==, target_state);
+	g_assert (dfsm_machine_get_target_reached (machine) == TRUE);
+
+	/* With a target which can't be reached, transitions are chosen randomly. The longest path into Trap is four transitions long. */
+	dfsm_machine_set_target_state (machine, dfsm_machine_look_up_state (machine, "Unreachable"));
+	dfsm_machine_reset_state (machine);
+
+	make_arbitrary_transitions (machine, 5);
+	g_assert_cmpuint (get_machine_state (machine), ==, trap_state);
+	g_assert (dfsm_machine_get_target_reached (machine) == FALSE);
+
+	/* Disable directed mode again. */
+	dfsm_machine_set_target_state (machine, DFSM_MACHINE_INVALID_STATE);
+	g_assert_cmpuint (dfsm_machine_get_target_state (machine), ==, DFSM_MACHINE_INVALID_STATE);
+	g_assert (dfsm_machine_get_target_reached (machine) == FALSE);
+
+	g_ptr_array_unref (object_array);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -94,6 +326,12 @@ main (int argc, char *argv[])
 	g_test_init (&argc, &argv, NULL);
 
 	g_test_add_func ("/reachability", test_reachability);
+	g_test_add_data_func ("/reachability/exploration/breadth-first", GUINT_TO_POINTER (DFSM_EXPLORATION_BREADTH_FIRST),
+	                      test_exploration_exhaustive);
+	g_test_add_data_func ("/reachability/exploration/depth-first", GUINT_TO_POINTER (DFSM_EXPLORATION_DEPTH_FIRST),
+	                      test_exploration_exhaustive);
+	g_test_add_func ("/reachability/exploration/limits", test_exploration_limits);
+	g_test_add_func ("/reachability/directed", test_directed);
 
 	return g_test_run ();
 }
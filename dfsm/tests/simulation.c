@@ -17,6 +17,8 @@
  * along with D-Bus Simulator.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <glib/gstdio.h>
 #include <dfsm/dfsm.h>
 
 #include "test-output-sequence.h"
@@ -132,7 +134,14 @@ test_simulation_probabilities (void)
 		dfsm_machine_call_method (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "TwoStateEcho", params, TRUE);
 		g_object_unref (output_sequence);
 
-		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		/* Only the first set actually changes the property's value, so only it should be notified. */
+		if (i == 0) {
+			output_sequence = test_output_sequence_new (ENTRY_PROPERTY_CHANGE, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty",
+			                                            val, ENTRY_NONE);
+		} else {
+			output_sequence = test_output_sequence_new (ENTRY_NONE);
+		}
+
 		dfsm_machine_set_property (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty", val, TRUE);
 		g_object_unref (output_sequence);
 	}
@@ -174,6 +183,965 @@ test_simulation_probabilities (void)
 	g_object_unref (environment);
 }
 
+typedef struct {
+	guint depth;
+	guint num_transition_spans;
+	guint num_precondition_spans;
+} TraceData;
+
+static void
+trace_cb (DfsmTracePhase phase, const gchar *category, const gchar *name, const gchar *detail, TraceData *data)
+{
+	switch (phase) {
+		case DFSM_TRACE_PHASE_BEGIN:
+			data->depth++;
+
+			if (strcmp (category, "transition") == 0) {
+				data->num_transition_spans++;
+			} else if (strcmp (category, "precondition-check") == 0) {
+				data->num_precondition_spans++;
+			}
+
+			break;
+		case DFSM_TRACE_PHASE_END:
+			g_assert_cmpuint (data->depth, >, 0);
+			data->depth--;
+			break;
+		case DFSM_TRACE_PHASE_INSTANT:
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+static void
+test_simulation_trace (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmOutputSequence *output_sequence;
+	GVariant *params;
+	TraceData data = { 0, };
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition SingleEcho inside Main on method SingleStateEcho {"
+			"precondition { object->Counter == @u 100 }"
+			"reply (\"reply\");"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+	params = g_variant_ref_sink (new_unary_tuple (g_variant_new_string ("param")));
+
+	/* Tracing is disabled by default. */
+	g_assert (dfsm_trace_is_enabled () == FALSE);
+
+	dfsm_trace_set_func ((DfsmTraceFunc) trace_cb, &data);
+	g_assert (dfsm_trace_is_enabled () == TRUE);
+
+	/* Calling the method should check the transition's preconditions and execute it, with properly nested spans. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	g_assert_cmpuint (data.depth, ==, 0);
+	g_assert_cmpuint (data.num_precondition_spans, ==, 1);
+	g_assert_cmpuint (data.num_transition_spans, ==, 1);
+
+	/* Once disabled, no more events should be emitted. */
+	dfsm_trace_set_func (NULL, NULL);
+	g_assert (dfsm_trace_is_enabled () == FALSE);
+
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	g_assert_cmpuint (data.num_transition_spans, ==, 1);
+
+	g_variant_unref (params);
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_environment_serials (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	GVariant *params;
+	guint serial, counter_serial, property_serial;
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition SingleEcho inside Main on method SingleStateEcho {"
+			"object->Counter = object->Counter + @u 1;"
+			"reply (\"reply\");"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+	environment = dfsm_machine_get_environment (machine);
+	params = g_variant_ref_sink (new_unary_tuple (g_variant_new_string ("param")));
+
+	serial = dfsm_environment_get_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT);
+	counter_serial = dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	property_serial = dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, "ArbitraryProperty");
+
+	g_assert_cmpuint (counter_serial, <=, serial);
+	g_assert_cmpuint (property_serial, <=, serial);
+
+	/* Writing Counter should bump its serial and the scope's serial, but not ArbitraryProperty's. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	g_assert_cmpuint (dfsm_environment_get_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT), >, serial);
+	g_assert_cmpuint (dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter"), >, serial);
+	g_assert_cmpuint (dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, "ArbitraryProperty"), ==, property_serial);
+
+	/* Resetting counts as writing every variable. */
+	serial = dfsm_environment_get_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT);
+	dfsm_machine_reset_state (machine);
+
+	g_assert_cmpuint (dfsm_environment_get_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT), >, serial);
+	g_assert_cmpuint (dfsm_environment_get_variable_serial (environment, DFSM_VARIABLE_SCOPE_OBJECT, "ArbitraryProperty"), >, serial);
+
+	g_variant_unref (params);
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_property_changes (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmOutputSequence *output_sequence;
+	GVariant *params, *value;
+	GError *error = NULL;
+
+	#define INTERFACE_NAME "uk.ac.cam.cl.DBusSimulator.SimpleTest"
+
+	/* SingleStateEcho sets ArbitraryProperty to its parameter; TwoStateEcho writes it twice, leaving it with its original value. */
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition SingleEcho inside Main on method SingleStateEcho {"
+			"object->ArbitraryProperty = greeting;"
+			"reply (\"reply\");"
+		"}"
+		"transition TwoEcho inside Main on method TwoStateEcho {"
+			"object->ArbitraryProperty = \"temporary\";"
+			"object->ArbitraryProperty = \"foo\";"
+			"reply (\"reply\");"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+
+	/* Writing the property's existing value shouldn't notify it. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	params = g_variant_ref_sink (new_unary_tuple (g_variant_new_string ("foo")));
+	dfsm_machine_call_method (machine, output_sequence, INTERFACE_NAME, "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	/* Nor should changing it and then changing it back within one transition. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (machine, output_sequence, INTERFACE_NAME, "TwoStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+	g_variant_unref (params);
+
+	/* Actually changing it should notify it, after the transition's other output. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")),
+	                                            ENTRY_PROPERTY_CHANGE, INTERFACE_NAME, "ArbitraryProperty", g_variant_new_string ("bar"),
+	                                            ENTRY_NONE);
+	params = g_variant_ref_sink (new_unary_tuple (g_variant_new_string ("bar")));
+	dfsm_machine_call_method (machine, output_sequence, INTERFACE_NAME, "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+	g_variant_unref (params);
+
+	/* The same goes for the default property setter. */
+	value = g_variant_ref_sink (g_variant_new_string ("bar"));
+	output_sequence = test_output_sequence_new (ENTRY_NONE);
+	g_assert (dfsm_machine_set_property (machine, output_sequence, INTERFACE_NAME, "ArbitraryProperty", value, FALSE) == FALSE);
+	g_object_unref (output_sequence);
+	g_variant_unref (value);
+
+	value = g_variant_ref_sink (g_variant_new_string ("baz"));
+	output_sequence = test_output_sequence_new (ENTRY_PROPERTY_CHANGE, INTERFACE_NAME, "ArbitraryProperty", value, ENTRY_NONE);
+	g_assert (dfsm_machine_set_property (machine, output_sequence, INTERFACE_NAME, "ArbitraryProperty", value, FALSE) == TRUE);
+	g_object_unref (output_sequence);
+	g_variant_unref (value);
+
+	#undef INTERFACE_NAME
+
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_object_instances (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmObject *template_object, *instance;
+	DfsmMachine *template_machine, *instance_machine;
+	DfsmEnvironment *template_environment, *instance_environment;
+	DfsmOutputSequence *output_sequence;
+	GVariant *params, *value;
+	guint machine_state;
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition SingleEcho inside Main on method SingleStateEcho {"
+			"object->Counter = object->Counter + @u 1;"
+			"reply (\"reply\");"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	template_object = g_ptr_array_index (simulated_objects, 0);
+	template_machine = dfsm_object_get_machine (template_object);
+	template_environment = dfsm_machine_get_environment (template_machine);
+	params = g_variant_ref_sink (new_unary_tuple (g_variant_new_string ("param")));
+
+	/* Modify the template before instantiating it; the instance should start from the initial values, not the current ones. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (template_machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	instance = dfsm_object_instantiate (template_object, "/uk/ac/cam/cl/DBusSimulator/ParserTest/Instance0");
+	instance_machine = dfsm_object_get_machine (instance);
+	instance_environment = dfsm_machine_get_environment (instance_machine);
+
+	g_assert_cmpstr (dfsm_object_get_object_path (instance), ==, "/uk/ac/cam/cl/DBusSimulator/ParserTest/Instance0");
+	g_assert_cmpuint (dfsm_object_get_well_known_bus_names (instance)->len, ==, 0);
+	g_assert (instance_machine != template_machine);
+	g_assert (instance_environment != template_environment);
+	g_object_get (instance_machine, "machine-state", &machine_state, NULL);
+	g_assert_cmpuint (machine_state, ==, DFSM_MACHINE_STARTING_STATE);
+
+	value = dfsm_environment_dup_variable_value (instance_environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 100);
+	g_variant_unref (value);
+
+	/* The instance should share the template's transitions, but modify only its own variables. */
+	output_sequence = test_output_sequence_new (ENTRY_REPLY, new_unary_tuple (g_variant_new_string ("reply")), ENTRY_NONE);
+	dfsm_machine_call_method (instance_machine, output_sequence, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho", params, FALSE);
+	g_object_unref (output_sequence);
+
+	value = dfsm_environment_dup_variable_value (instance_environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 101);
+	g_variant_unref (value);
+
+	value = dfsm_environment_dup_variable_value (template_environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 101);
+	g_variant_unref (value);
+
+	/* Resetting the instance should restore the shared initial values without touching the template. */
+	dfsm_machine_reset_state (instance_machine);
+
+	value = dfsm_environment_dup_variable_value (instance_environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 100);
+	g_variant_unref (value);
+
+	value = dfsm_environment_dup_variable_value (template_environment, DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 101);
+	g_variant_unref (value);
+
+	/* The template should outlive its instance and vice versa. */
+	g_ptr_array_unref (simulated_objects);
+	g_object_unref (instance);
+	g_variant_unref (params);
+}
+
+static guint
+get_counter (DfsmEnvironment *environment, const gchar *variable_name)
+{
+	GVariant *value;
+	guint counter;
+
+	value = dfsm_environment_dup_variable_value (environment, DFSM_VARIABLE_SCOPE_OBJECT, variable_name);
+	counter = g_variant_get_uint32 (value);
+	g_variant_unref (value);
+
+	return counter;
+}
+
+static void
+test_simulation_solve_preconditions (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	guint i;
+	GError *error = NULL;
+
+	/* Two arbitrary transitions whose preconditions the simulation never satisfies by itself: one needing a bounded interval, and one needing a
+	 * negated comparison and one of two equalities. */
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition Guarded1 inside Main on random {"
+			"precondition { object->Counter ~> @u 1000 && object->Counter <= @u 1002 }"
+			"object->Counter = @u 0;"
+			"object->Random1Counter = object->Random1Counter + @u 1;"
+		"}"
+		"transition Guarded2 inside Main on random {"
+			"precondition { !⟨object->Random2Counter <~ @u 5⟩ && ⟨object->SingleEcho1Counter == @u 7 || object->SingleEcho1Counter == @u 9⟩ }"
+			"object->SingleEcho1Counter = @u 0;"
+			"object->TwoEchoCounter = object->TwoEchoCounter + @u 1;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+	environment = dfsm_machine_get_environment (machine);
+
+	/* Without solving, neither transition can be executed. */
+	g_assert (dfsm_machine_get_solve_preconditions (machine) == FALSE);
+
+	for (i = 0; i < 10; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, TRUE);
+		g_object_unref (output_sequence);
+	}
+
+	g_assert_cmpuint (get_counter (environment, "Random1Counter"), ==, 0);
+	g_assert_cmpuint (get_counter (environment, "TwoEchoCounter"), ==, 0);
+
+	/* With solving, each transition should be executed once, in some order. */
+	dfsm_machine_set_solve_preconditions (machine, TRUE);
+
+	for (i = 0; i < 2; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, TRUE);
+		g_object_unref (output_sequence);
+	}
+
+	g_assert_cmpuint (get_counter (environment, "Random1Counter"), ==, 1);
+	g_assert_cmpuint (get_counter (environment, "TwoEchoCounter"), ==, 1);
+	g_assert_cmpuint (get_counter (environment, "Counter"), ==, 0);
+	g_assert_cmpuint (get_counter (environment, "SingleEcho1Counter"), ==, 0);
+	g_assert_cmpuint (get_counter (environment, "Random2Counter"), >=, 5);
+
+	/* Transitions which have already been executed shouldn't be solved for again. */
+	output_sequence = test_output_sequence_new (ENTRY_NONE);
+	dfsm_machine_make_arbitrary_transition (machine, output_sequence, TRUE);
+	g_object_unref (output_sequence);
+
+	g_assert_cmpuint (get_counter (environment, "Random1Counter"), ==, 1);
+	g_assert_cmpuint (get_counter (environment, "TwoEchoCounter"), ==, 1);
+
+	/* Solving is only done when fuzzing. */
+	dfsm_machine_set_solve_preconditions (machine, FALSE);
+	dfsm_machine_set_solve_preconditions (machine, TRUE);
+
+	output_sequence = test_output_sequence_new (ENTRY_NONE);
+	dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+	g_object_unref (output_sequence);
+
+	g_assert_cmpuint (get_counter (environment, "Random1Counter"), ==, 1);
+	g_assert_cmpuint (get_counter (environment, "TwoEchoCounter"), ==, 1);
+
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_transition_feedback (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	guint i, random1_count, random2_count;
+	GError *error = NULL;
+
+	#define FEEDBACK_TEST_COUNT 1000
+
+	/* Two arbitrary transitions which are equally likely to be chosen until one's rewarded. */
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition Random1 inside Main on random {"
+			"object->Random1Counter = object->Random1Counter + @u 1;"
+		"}"
+		"transition Random2 inside Main on random {"
+			"object->Random2Counter = object->Random2Counter + @u 1;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+	environment = dfsm_machine_get_environment (machine);
+
+	dfsm_machine_set_transition_feedback (machine, TRUE);
+	g_assert (dfsm_machine_get_transition_feedback (machine) == TRUE);
+
+	/* Execute Random1 (and possibly Random2 first), then reward only Random1. Rewarding nothing forgets any executions of Random2. */
+	do {
+		dfsm_machine_reward_recent_transitions (machine, 0.0);
+
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+		g_object_unref (output_sequence);
+	} while (get_counter (environment, "Random1Counter") == 0);
+
+	dfsm_machine_reward_recent_transitions (machine, 1000.0);
+
+	random1_count = get_counter (environment, "Random1Counter");
+	random2_count = get_counter (environment, "Random2Counter");
+
+	/* Random1's weight should now be capped, but still far above Random2's, so it should be chosen much more often. */
+	for (i = 0; i < FEEDBACK_TEST_COUNT; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+		g_object_unref (output_sequence);
+
+		dfsm_machine_reward_recent_transitions (machine, 0.0);
+	}
+
+	random1_count = get_counter (environment, "Random1Counter") - random1_count;
+	random2_count = get_counter (environment, "Random2Counter") - random2_count;
+
+	g_assert_cmpuint (random1_count + random2_count, ==, FEEDBACK_TEST_COUNT);
+	g_assert_cmpuint (random1_count, >, FEEDBACK_TEST_COUNT * 9 / 10);
+	g_assert_cmpuint (random2_count, >, 0);
+
+	#undef FEEDBACK_TEST_COUNT
+
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_random_seed (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects1, *simulated_objects2;
+	DfsmMachine *machine1, *machine2;
+	DfsmOutputSequence *output_sequence;
+	guint i;
+	GError *error = NULL;
+
+	#define SEED_TEST_COUNT 100
+
+	/* Two arbitrary transitions, one of which fuzzes a variable. */
+	#define SEED_TEST_SNIPPET \
+		"transition Random1 inside Main on random {" \
+			"object->Random1Counter = object->Random1Counter + @u 1;" \
+			"object->Counter = @u 5?;" \
+		"}" \
+		"transition Random2 inside Main on random {" \
+			"object->Random2Counter = object->Random2Counter + @u 1;" \
+		"}"
+
+	simulated_objects1 = build_machine_description_from_transition_snippet (SEED_TEST_SNIPPET, &error);
+	g_assert_no_error (error);
+	simulated_objects2 = build_machine_description_from_transition_snippet (SEED_TEST_SNIPPET, &error);
+	g_assert_no_error (error);
+
+	machine1 = dfsm_object_get_machine (g_ptr_array_index (simulated_objects1, 0));
+	machine2 = dfsm_object_get_machine (g_ptr_array_index (simulated_objects2, 0));
+
+	dfsm_environment_set_random_seed (dfsm_machine_get_environment (machine1), 42);
+	dfsm_environment_set_random_seed (dfsm_machine_get_environment (machine2), 42);
+
+	/* The machines should make the same choices and fuzz the same values, even with other users of GLib's global generator interleaved. */
+	for (i = 0; i < SEED_TEST_COUNT; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine1, output_sequence, TRUE);
+		g_object_unref (output_sequence);
+
+		g_random_int ();
+
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine2, output_sequence, TRUE);
+		g_object_unref (output_sequence);
+
+		g_assert_cmpuint (get_counter (dfsm_machine_get_environment (machine1), "Random1Counter"), ==,
+		                  get_counter (dfsm_machine_get_environment (machine2), "Random1Counter"));
+		g_assert_cmpuint (get_counter (dfsm_machine_get_environment (machine1), "Counter"), ==,
+		                  get_counter (dfsm_machine_get_environment (machine2), "Counter"));
+	}
+
+	/* Both transitions should have been taken. */
+	g_assert_cmpuint (get_counter (dfsm_machine_get_environment (machine1), "Random1Counter"), >, 0);
+	g_assert_cmpuint (get_counter (dfsm_machine_get_environment (machine1), "Random2Counter"), >, 0);
+
+	#undef SEED_TEST_SNIPPET
+	#undef SEED_TEST_COUNT
+
+	g_ptr_array_unref (simulated_objects2);
+	g_ptr_array_unref (simulated_objects1);
+}
+
+static void
+transition_executed_cb (DfsmMachine *machine, DfsmMachineStateNumber from_state, DfsmMachineStateNumber to_state, DfsmAstTransition *transition,
+                        const gchar *nickname, guint *num_emissions)
+{
+	DfsmMachineStateNumber main_state = dfsm_machine_look_up_state (machine, "Main");
+
+	g_assert_cmpuint (from_state, ==, main_state);
+	g_assert_cmpuint (to_state, ==, main_state);
+	g_assert (DFSM_IS_AST_TRANSITION (transition));
+
+	/* Only count Random1. */
+	if (g_strcmp0 (nickname, "Random1") != 0) {
+		g_assert_cmpstr (nickname, ==, "Random2");
+		return;
+	}
+
+	/* The transition should already have been executed. */
+	*num_emissions = *num_emissions + 1;
+	g_assert_cmpuint (get_counter (dfsm_machine_get_environment (machine), "Random1Counter"), ==, *num_emissions);
+}
+
+static void
+test_simulation_transition_feedback_transition_executed (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmOutputSequence *output_sequence;
+	guint i, num_emissions = 0;
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition Random1 inside Main on random {"
+			"object->Random1Counter = object->Random1Counter + @u 1;"
+		"}"
+		"transition Random2 inside Main on random {"
+			"object->Random2Counter = object->Random2Counter + @u 1;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+
+	g_signal_connect (machine, "transition-executed", (GCallback) transition_executed_cb, &num_emissions);
+
+	for (i = 0; i < 100; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+		g_object_unref (output_sequence);
+	}
+
+	g_assert_cmpuint (num_emissions, >, 0);
+	g_assert_cmpuint (num_emissions, ==, get_counter (dfsm_machine_get_environment (machine), "Random1Counter"));
+	g_assert_cmpuint (num_emissions + get_counter (dfsm_machine_get_environment (machine), "Random2Counter"), ==, 100);
+
+	g_signal_handlers_disconnect_by_func (machine, transition_executed_cb, &num_emissions);
+	g_ptr_array_unref (simulated_objects);
+}
+
+static void
+test_simulation_transition_feedback_preconditions (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmMachine *machine;
+	DfsmEnvironment *environment;
+	DfsmOutputSequence *output_sequence;
+	guint i, random1_count, random2_count;
+	GError *error = NULL;
+
+	#define FEEDBACK_TEST_COUNT 1000
+
+	/* A transition which can only be executed once, and two others which can always be executed. */
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition Once inside Main on random {"
+			"precondition { object->Counter == @u 100 }"
+			"object->Counter = object->Counter + @u 1;"
+		"}"
+		"transition Random1 inside Main on random {"
+			"object->Random1Counter = object->Random1Counter + @u 1;"
+		"}"
+		"transition Random2 inside Main on random {"
+			"object->Random2Counter = object->Random2Counter + @u 1;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	machine = dfsm_object_get_machine (g_ptr_array_index (simulated_objects, 0));
+	environment = dfsm_machine_get_environment (machine);
+
+	dfsm_machine_set_transition_feedback (machine, TRUE);
+
+	/* Execute Once, then reward only it. */
+	do {
+		dfsm_machine_reward_recent_transitions (machine, 0.0);
+
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+		g_object_unref (output_sequence);
+	} while (get_counter (environment, "Counter") == 100);
+
+	dfsm_machine_reward_recent_transitions (machine, 1000.0);
+
+	random1_count = get_counter (environment, "Random1Counter");
+	random2_count = get_counter (environment, "Random2Counter");
+
+	/* Once's preconditions now always fail, so its weight shouldn't make either of the other transitions more likely to be chosen than the
+	 * other. */
+	for (i = 0; i < FEEDBACK_TEST_COUNT; i++) {
+		output_sequence = test_output_sequence_new (ENTRY_NONE);
+		dfsm_machine_make_arbitrary_transition (machine, output_sequence, FALSE);
+		g_object_unref (output_sequence);
+
+		dfsm_machine_reward_recent_transitions (machine, 0.0);
+	}
+
+	random1_count = get_counter (environment, "Random1Counter") - random1_count;
+	random2_count = get_counter (environment, "Random2Counter") - random2_count;
+
+	g_assert_cmpuint (get_counter (environment, "Counter"), ==, 101);
+	g_assert_cmpuint (random1_count + random2_count, ==, FEEDBACK_TEST_COUNT);
+	g_assert_cmpuint (random1_count, >, FEEDBACK_TEST_COUNT / 4);
+	g_assert_cmpuint (random2_count, >, FEEDBACK_TEST_COUNT / 4);
+
+	#undef FEEDBACK_TEST_COUNT
+
+	g_ptr_array_unref (simulated_objects);
+}
+
+typedef struct {
+	GDBusServer *server;
+	gchar *tmp_directory;
+	GDBusConnection *server_connection;
+	GDBusConnection *client_connection;
+	gboolean registered;
+} PeerData;
+
+static gboolean
+new_connection_cb (GDBusServer *server, GDBusConnection *connection, PeerData *data)
+{
+	data->server_connection = g_object_ref (connection);
+
+	return TRUE;
+}
+
+static void
+client_connection_ready_cb (GObject *source_object, GAsyncResult *async_result, PeerData *data)
+{
+	GError *error = NULL;
+
+	data->client_connection = g_dbus_connection_new_for_address_finish (async_result, &error);
+	g_assert_no_error (error);
+}
+
+static void
+register_on_bus_cb (DfsmObject *simulated_object, GAsyncResult *async_result, PeerData *data)
+{
+	GError *error = NULL;
+
+	dfsm_object_register_on_bus_finish (simulated_object, async_result, &error);
+	g_assert_no_error (error);
+
+	data->registered = TRUE;
+}
+
+static gboolean
+disable_arbitrary_transition_cb (DfsmObject *simulated_object, DfsmOutputSequence *output_sequence, gboolean enable_fuzzing, gpointer user_data)
+{
+	/* Handled (by doing nothing). */
+	return TRUE;
+}
+
+/* Set up a peer-to-peer connection and export @simulated_object on it, with arbitrary transitions disabled so that only the client changes its
+ * state. */
+static void
+set_up_peer (PeerData *data, DfsmObject *simulated_object)
+{
+	gchar *guid, *address;
+	GError *error = NULL;
+
+	data->tmp_directory = g_dir_make_tmp ("dfsm-simulation-test-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	address = g_strdup_printf ("unix:tmpdir=%s", data->tmp_directory);
+	guid = g_dbus_generate_guid ();
+
+	data->server = g_dbus_server_new_sync (address, G_DBUS_SERVER_FLAGS_NONE, guid, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	g_free (guid);
+	g_free (address);
+
+	g_signal_connect (data->server, "new-connection", (GCallback) new_connection_cb, data);
+	g_dbus_server_start (data->server);
+
+	g_dbus_connection_new_for_address (g_dbus_server_get_client_address (data->server), G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL,
+	                                   NULL, (GAsyncReadyCallback) client_connection_ready_cb, data);
+
+	while (data->server_connection == NULL || data->client_connection == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_signal_connect (simulated_object, "arbitrary-transition", (GCallback) disable_arbitrary_transition_cb, NULL);
+	dfsm_object_register_on_bus (simulated_object, data->server_connection, (GAsyncReadyCallback) register_on_bus_cb, data);
+
+	while (data->registered == FALSE) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+tear_down_peer (PeerData *data, DfsmObject *simulated_object)
+{
+	dfsm_object_unregister_on_bus (simulated_object);
+
+	g_dbus_connection_close_sync (data->client_connection, NULL, NULL);
+	g_dbus_connection_close_sync (data->server_connection, NULL, NULL);
+	g_object_unref (data->client_connection);
+	g_object_unref (data->server_connection);
+
+	g_dbus_server_stop (data->server);
+	g_object_unref (data->server);
+
+	g_rmdir (data->tmp_directory);
+	g_free (data->tmp_directory);
+}
+
+static void
+call_reply_cb (GDBusConnection *connection, GAsyncResult *async_result, GVariant **reply)
+{
+	GError *error = NULL;
+
+	*reply = g_dbus_connection_call_finish (connection, async_result, &error);
+	g_assert_no_error (error);
+}
+
+/* With #DfsmObject:dispatch-in-worker-thread set, a method call mustn't overtake a property set which was sent before it. */
+static void
+test_simulation_worker_thread_ordering (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmObject *simulated_object;
+	const gchar *object_path, *echoed_value;
+	GVariant *value, *set_reply = NULL, *echo_reply = NULL, *get_reply = NULL;
+	PeerData data = { NULL, };
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition EchoProperty inside Main on method SingleStateEcho {"
+			"reply (object->ArbitraryProperty);"
+		"}"
+		"transition SetProperty inside Main on property ArbitraryProperty {"
+			"object->ArbitraryProperty = value;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	simulated_object = g_ptr_array_index (simulated_objects, 0);
+	object_path = dfsm_object_get_object_path (simulated_object);
+
+	dfsm_object_set_dispatch_in_worker_thread (simulated_object, TRUE);
+	set_up_peer (&data, simulated_object);
+
+	/* Set the property and then call a method which returns its value, without iterating the main context in between. */
+	g_dbus_connection_call (data.client_connection, NULL, object_path, "org.freedesktop.DBus.Properties", "Set",
+	                        g_variant_new ("(ssv)", "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty", g_variant_new_string ("set")),
+	                        NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, (GAsyncReadyCallback) call_reply_cb, &set_reply);
+	g_dbus_connection_call (data.client_connection, NULL, object_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho",
+	                        g_variant_new ("(s)", "greeting"), G_VARIANT_TYPE ("(s)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+	                        (GAsyncReadyCallback) call_reply_cb, &echo_reply);
+
+	while (set_reply == NULL || echo_reply == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_variant_get (echo_reply, "(&s)", &echoed_value);
+	g_assert_cmpstr (echoed_value, ==, "set");
+
+	/* Property gets are handled in the worker thread too. */
+	g_dbus_connection_call (data.client_connection, NULL, object_path, "org.freedesktop.DBus.Properties", "Get",
+	                        g_variant_new ("(ss)", "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty"), G_VARIANT_TYPE ("(v)"),
+	                        G_DBUS_CALL_FLAGS_NONE, -1, NULL, (GAsyncReadyCallback) call_reply_cb, &get_reply);
+
+	while (get_reply == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_variant_get (get_reply, "(v)", &value);
+	g_assert_cmpstr (g_variant_get_string (value, NULL), ==, "set");
+	g_variant_unref (value);
+
+	/* Tidy up. */
+	tear_down_peer (&data, simulated_object);
+
+	g_variant_unref (get_reply);
+	g_variant_unref (echo_reply);
+	g_variant_unref (set_reply);
+
+	g_ptr_array_unref (simulated_objects);
+}
+
+typedef struct {
+	GDBusConnection *connection;
+	GVariant *reply;
+	GError *error;
+	gboolean finished;
+} CallData;
+
+static void
+call_cb (GDBusConnection *connection, GAsyncResult *async_result, CallData *call_data)
+{
+	call_data->reply = g_dbus_connection_call_finish (connection, async_result, &call_data->error);
+	call_data->finished = TRUE;
+}
+
+/* Synchronously call @method_name on @object_path, iterating the main context (in which the simulated objects are registered) while waiting. */
+static GVariant *
+call_method (GDBusConnection *connection, const gchar *object_path, const gchar *interface_name, const gchar *method_name, GVariant *parameters,
+             GError **error)
+{
+	CallData call_data = { NULL, };
+
+	g_dbus_connection_call (connection, NULL, object_path, interface_name, method_name, parameters, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+	                        (GAsyncReadyCallback) call_cb, &call_data);
+
+	while (call_data.finished == FALSE) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	if (call_data.error != NULL) {
+		g_propagate_error (error, call_data.error);
+	}
+
+	return call_data.reply;
+}
+
+static void
+instance_changed_cb (DfsmObject *template_object, DfsmObject *instance, DfsmObject **instance_out)
+{
+	g_assert (*instance_out == NULL);
+	*instance_out = g_object_ref (instance);
+}
+
+/* Instantiate and destroy statements should create and destroy instances of the object on its connection, even when executed in the worker thread
+ * or by one of the instances. */
+static void
+test_simulation_instance_statements (void)
+{
+	GPtrArray/*<DfsmObject>*/ *simulated_objects;
+	DfsmObject *simulated_object, *created_instance = NULL, *destroyed_instance = NULL;
+	const gchar *object_path, *instance_path = "/uk/ac/cam/cl/DBusSimulator/ParserTest/Instance1";
+	GVariant *reply, *value;
+	PeerData data = { NULL, };
+	GError *error = NULL;
+
+	simulated_objects = build_machine_description_from_transition_snippet (
+		"transition Instantiate inside Main on method SingleStateEcho {"
+			"object->Counter = object->Counter + @u 1;"
+			"instantiate @o \"/uk/ac/cam/cl/DBusSimulator/ParserTest/Instance1\";"
+			"reply (\"instantiated\");"
+		"}"
+		"transition Destroy inside Main on method TwoStateEcho {"
+			"destroy @o \"/uk/ac/cam/cl/DBusSimulator/ParserTest/Instance1\";"
+			"reply (\"destroyed\");"
+		"}"
+		"transition SetProperty inside Main on property ArbitraryProperty {"
+			"object->ArbitraryProperty = value;"
+		"}", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (simulated_objects->len, ==, 1);
+
+	simulated_object = g_ptr_array_index (simulated_objects, 0);
+	object_path = dfsm_object_get_object_path (simulated_object);
+
+	g_signal_connect (simulated_object, "instance-created", (GCallback) instance_changed_cb, &created_instance);
+	g_signal_connect (simulated_object, "instance-destroyed", (GCallback) instance_changed_cb, &destroyed_instance);
+
+	dfsm_object_set_dispatch_in_worker_thread (simulated_object, TRUE);
+	set_up_peer (&data, simulated_object);
+
+	/* Instantiate the object. */
+	reply = call_method (data.client_connection, object_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	while (created_instance == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_assert_cmpstr (dfsm_object_get_object_path (created_instance), ==, instance_path);
+	g_assert (dfsm_object_get_connection (created_instance) == data.server_connection);
+	g_assert (dfsm_object_get_dispatch_in_worker_thread (created_instance) == TRUE);
+
+	/* The instance should be on the bus, with its own object variables starting from their initial values. */
+	reply = call_method (data.client_connection, instance_path, "org.freedesktop.DBus.Properties", "Set",
+	                     g_variant_new ("(ssv)", "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty", g_variant_new_string ("set")),
+	                     &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	reply = call_method (data.client_connection, object_path, "org.freedesktop.DBus.Properties", "Get",
+	                     g_variant_new ("(ss)", "uk.ac.cam.cl.DBusSimulator.SimpleTest", "ArbitraryProperty"), &error);
+	g_assert_no_error (error);
+	g_variant_get (reply, "(v)", &value);
+	g_assert_cmpstr (g_variant_get_string (value, NULL), ==, "foo");
+	g_variant_unref (value);
+	g_variant_unref (reply);
+
+	value = dfsm_environment_dup_variable_value (dfsm_machine_get_environment (dfsm_object_get_machine (created_instance)),
+	                                             DFSM_VARIABLE_SCOPE_OBJECT, "Counter");
+	g_assert_cmpuint (g_variant_get_uint32 (value), ==, 100);
+	g_variant_unref (value);
+
+	/* Instantiating it at the same path again is a runtime error. */
+	g_test_expect_message ("libdfsm", G_LOG_LEVEL_WARNING, "*couldn't instantiate object*already exists*");
+	reply = call_method (data.client_connection, object_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	while (g_main_context_iteration (NULL, FALSE) == TRUE);
+	g_test_assert_expected_messages ();
+
+	/* Destroy the instance from one of its own transitions. */
+	reply = call_method (data.client_connection, instance_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "TwoStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	while (destroyed_instance == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_assert (destroyed_instance == created_instance);
+	g_assert (dfsm_object_get_connection (destroyed_instance) == NULL);
+	g_clear_object (&created_instance);
+	g_clear_object (&destroyed_instance);
+
+	reply = call_method (data.client_connection, instance_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "TwoStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert (reply == NULL);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+
+	/* Destroying it again is a runtime error. */
+	g_test_expect_message ("libdfsm", G_LOG_LEVEL_WARNING, "*couldn't destroy object*");
+	reply = call_method (data.client_connection, object_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "TwoStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	while (g_main_context_iteration (NULL, FALSE) == TRUE);
+	g_test_assert_expected_messages ();
+
+	/* Instances should be destroyed when the object is unregistered. */
+	reply = call_method (data.client_connection, object_path, "uk.ac.cam.cl.DBusSimulator.SimpleTest", "SingleStateEcho",
+	                     g_variant_new ("(s)", "greeting"), &error);
+	g_assert_no_error (error);
+	g_variant_unref (reply);
+
+	while (created_instance == NULL) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	tear_down_peer (&data, simulated_object);
+
+	g_assert (destroyed_instance == created_instance);
+	g_clear_object (&created_instance);
+	g_clear_object (&destroyed_instance);
+
+	g_ptr_array_unref (simulated_objects);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -186,6 +1154,17 @@ main (int argc, char *argv[])
 	g_test_init (&argc, &argv, NULL);
 
 	g_test_add_func ("/simulation/probabilities", test_simulation_probabilities);
+	g_test_add_func ("/simulation/trace", test_simulation_trace);
+	g_test_add_func ("/simulation/environment-serials", test_simulation_environment_serials);
+	g_test_add_func ("/simulation/property-changes", test_simulation_property_changes);
+	g_test_add_func ("/simulation/object-instances", test_simulation_object_instances);
+	g_test_add_func ("/simulation/solve-preconditions", test_simulation_solve_preconditions);
+	g_test_add_func ("/simulation/transition-feedback", test_simulation_transition_feedback);
+	g_test_add_func ("/simulation/transition-feedback/preconditions", test_simulation_transition_feedback_preconditions);
+	g_test_add_func ("/simulation/transition-feedback/transition-executed", test_simulation_transition_feedback_transition_executed);
+	g_test_add_func ("/simulation/random-seed", test_simulation_random_seed);
+	g_test_add_func ("/simulation/worker-thread-ordering", test_simulation_worker_thread_ordering);
+	g_test_add_func ("/simulation/instance-statements", test_simulation_instance_statements);
 
 	return g_test_run ();
 }
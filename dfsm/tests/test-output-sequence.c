@@ -36,6 +36,11 @@ typedef struct {
 			gchar *signal_name;
 			GVariant *parameters;
 		} emit;
+		struct {
+			gchar *interface_name;
+			gchar *property_name;
+			GVariant *value; /* NULL for an invalidation */
+		} property_change;
 	};
 } QueueEntry;
 
@@ -54,6 +59,13 @@ queue_entry_free (QueueEntry *entry)
 			g_free (entry->emit.signal_name);
 			g_variant_unref (entry->emit.parameters);
 			break;
+		case ENTRY_PROPERTY_CHANGE:
+			g_free (entry->property_change.interface_name);
+			g_free (entry->property_change.property_name);
+			if (entry->property_change.value != NULL) {
+				g_variant_unref (entry->property_change.value);
+			}
+			break;
 		case ENTRY_NONE:
 		default:
 			g_assert_not_reached ();
@@ -68,6 +80,8 @@ static void test_output_sequence_output (DfsmOutputSequence *sequence, GError **
 static void test_output_sequence_add_reply (DfsmOutputSequence *sequence, GVariant *parameters);
 static void test_output_sequence_add_throw (DfsmOutputSequence *sequence, GError *throw_error);
 static void test_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *signal_name, GVariant *parameters);
+static void test_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *property_name,
+                                                      GVariant *value);
 
 struct _TestOutputSequencePrivate {
 	GQueue/*<QueueEntry>*/ expected_queue; /* head is the oldest entry (i.e. the one to get executed first) */
@@ -98,6 +112,7 @@ test_output_sequence_iface_init (DfsmOutputSequenceInterface *iface)
 	iface->add_reply = test_output_sequence_add_reply;
 	iface->add_throw = test_output_sequence_add_throw;
 	iface->add_emit = test_output_sequence_add_emit;
+	iface->add_property_change = test_output_sequence_add_property_change;
 }
 
 static void
@@ -162,6 +177,30 @@ test_output_sequence_add_emit (DfsmOutputSequence *sequence, const gchar *interf
 	queue_entry_free (queue_entry);
 }
 
+static void
+test_output_sequence_add_property_change (DfsmOutputSequence *sequence, const gchar *interface_name, const gchar *property_name, GVariant *value)
+{
+	TestOutputSequencePrivate *priv = TEST_OUTPUT_SEQUENCE (sequence)->priv;
+	QueueEntry *queue_entry;
+
+	/* Pop an entry off the head of the expected queue and compare it to the incoming entry. */
+	queue_entry = g_queue_pop_head (&priv->expected_queue);
+	g_assert (queue_entry != NULL);
+
+	/* Compare the entries. */
+	g_assert_cmpuint (queue_entry->entry_type, ==, ENTRY_PROPERTY_CHANGE);
+	g_assert_cmpstr (queue_entry->property_change.interface_name, ==, interface_name);
+	g_assert_cmpstr (queue_entry->property_change.property_name, ==, property_name);
+
+	if (queue_entry->property_change.value == NULL) {
+		g_assert (value == NULL);
+	} else {
+		g_assert (value != NULL && g_variant_equal (queue_entry->property_change.value, value) == TRUE);
+	}
+
+	queue_entry_free (queue_entry);
+}
+
 DfsmOutputSequence *
 test_output_sequence_new (QueueEntryType first_entry_type, ...)
 {
@@ -194,6 +233,16 @@ test_output_sequence_new (QueueEntryType first_entry_type, ...)
 				queue_entry->emit.parameters = g_variant_ref_sink (va_arg (ap, GVariant*));
 
 				break;
+			case ENTRY_PROPERTY_CHANGE: {
+				GVariant *value;
+
+				queue_entry->property_change.interface_name = g_strdup (va_arg (ap, gchar*));
+				queue_entry->property_change.property_name = g_strdup (va_arg (ap, gchar*));
+				value = va_arg (ap, GVariant*);
+				queue_entry->property_change.value = (value != NULL) ? g_variant_ref_sink (value) : NULL;
+
+				break;
+			}
 			case ENTRY_NONE:
 			default:
 				g_assert_not_reached ();
@@ -33,6 +33,7 @@ typedef enum {
 	ENTRY_REPLY,
 	ENTRY_THROW,
 	ENTRY_EMIT,
+	ENTRY_PROPERTY_CHANGE,
 } QueueEntryType;
 
 #define TEST_TYPE_OUTPUT_SEQUENCE		(test_output_sequence_get_type ())
@@ -28,10 +28,19 @@ load_test_file (const gchar *filename)
 {
 	guint8 *contents = NULL;
 	gsize length;
+	gchar *path;
 	GFile *machine_file;
 	GError *error = NULL;
 
-	machine_file = g_file_new_for_path (filename);
+	/* Look in the source directory if we're being run by "make check"; otherwise, assume we're being run from the source directory. */
+	if (g_getenv ("G_TEST_SRCDIR") != NULL) {
+		path = g_test_build_filename (G_TEST_DIST, filename, NULL);
+	} else {
+		path = g_strdup (filename);
+	}
+
+	machine_file = g_file_new_for_path (path);
+	g_free (path);
 
 	/* Load the file. */
 	g_file_load_contents (machine_file, NULL, (gchar**) &contents, &length, NULL, &error);